@@ -0,0 +1,255 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Comprueba que NativeRequestFactory genera, byte a byte, los mismos cuerpos
+// que XmlRequestFactory seguido de Api.base64UrlSafeEncode, y que rechaza las
+// mismas entradas con las mismas excepciones. Necesita el plugin nativo, así
+// que se ejecuta en Windows:
+//
+//   flutter test integration_test/native_request_factory_test.dart -d windows
+
+import 'dart:async';
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:integration_test/integration_test.dart';
+import 'package:portafirmas/api/api.dart';
+import 'package:portafirmas/api/native_request_factory.dart';
+import 'package:portafirmas/api/xml_request_factory.dart';
+import 'package:portafirmas/model/sign_request.dart';
+import 'package:portafirmas/model/sign_request_document.dart';
+import 'package:portafirmas/model/triphase_request.dart';
+import 'package:portafirmas/model/triphase_sign_request_document.dart';
+import 'package:portafirmas_native/portafirmas_native.dart';
+
+const String operation = '0';
+
+/// Caracteres con significado en XML, que ninguna de las dos factorías escapa.
+const String xmlSpecial = '<a href="x">&amp;\'</a>';
+
+/// Texto fuera de ASCII, con caracteres de dos, tres y cuatro bytes en UTF-8.
+const String nonAscii = 'Firma inválida: año 2022 — 5 € 😀';
+
+/// El cuerpo que envía Api sin el constructor nativo.
+Uint8List dartBody(String xml) {
+  String encodedXml = Api.base64UrlSafeEncode(Uint8List.fromList(utf8.encode(xml)));
+  return Uint8List.fromList(utf8.encode('op=$operation&dat=$encodedXml'));
+}
+
+/// El cuerpo generado o la descripción de la excepción lanzada, de forma
+/// síncrona o no.
+Future<Object> outcome(FutureOr<Object> Function() build) async {
+  try {
+    return await build();
+  } on Exception catch (e) {
+    return 'Exception: $e';
+  }
+}
+
+/// Comprueba que ambas factorías dan el mismo cuerpo, o la misma excepción.
+Future<void> expectSameBody(
+    FutureOr<Uint8List> Function() native, String Function() dart) async {
+  Object expected = await outcome(() => dartBody(dart()));
+  Object actual = await outcome(native);
+  expect(actual, expected);
+}
+
+SignRequestDocument signDocument(String id,
+    {String? cryptoOperation = 'sign',
+    String signFormat = 'CAdES',
+    String digest = 'SHA-512',
+    String? params = 'bW9kZT1pbXBsaWNpdA=='}) {
+  return SignRequestDocument(
+      id, 'documento.pdf', 1024, 'application/pdf', signFormat, digest, params, cryptoOperation);
+}
+
+SignRequest signRequest(String id, List<SignRequestDocument>? docs) {
+  return SignRequest(id, 'Asunto', 'Remitente', SignRequest.viewNew, '01/01/2022', null, 0, false,
+      false, RequestType.signature, docs, null);
+}
+
+TriphaseSignRequestDocument triphaseDocument(String? id, Map<String, String> result,
+    {String? cryptoOperation = 'sign',
+    String? signatureFormat = 'CAdES',
+    String? digest = 'SHA-512',
+    String? params = 'bW9kZT1pbXBsaWNpdA=='}) {
+  TriphaseConfigData data = TriphaseConfigData()..addAll(result);
+  return TriphaseSignRequestDocument(id, cryptoOperation, signatureFormat, digest, params, data);
+}
+
+void main() {
+  IntegrationTestWidgetsFlutterBinding.ensureInitialized();
+
+  setUpAll(() {
+    expect(NativeRequestBuilder.isSupported, isTrue,
+        reason: 'El constructor nativo solo existe en Windows.');
+  });
+
+  group('presign', () {
+    Future<void> check(SignRequest? request) => expectSameBody(
+        () => NativeRequestFactory.createPresignBody(operation, request),
+        () => XmlRequestFactory.createPresignRequest(request));
+
+    testWidgets('null request', (tester) async {
+      await check(null);
+    });
+
+    testWidgets('no documents', (tester) async {
+      await check(signRequest('req-1', null));
+      await check(signRequest('req-1', []));
+    });
+
+    testWidgets('several documents', (tester) async {
+      await check(signRequest('req-1', [
+        signDocument('doc-1'),
+        signDocument('doc-2', signFormat: 'PAdES', digest: 'SHA-256'),
+        signDocument('doc-3', signFormat: 'XAdES'),
+      ]));
+    });
+
+    testWidgets('null and empty fields', (tester) async {
+      await check(signRequest('', [
+        signDocument('', cryptoOperation: null, params: null),
+        signDocument('doc-2', cryptoOperation: '', signFormat: '', digest: '', params: ''),
+      ]));
+    });
+
+    testWidgets('XML special and non-ASCII characters', (tester) async {
+      await check(signRequest(xmlSpecial, [
+        signDocument(nonAscii, cryptoOperation: xmlSpecial, params: xmlSpecial),
+      ]));
+    });
+
+    testWidgets('every base64 padding length', (tester) async {
+      // Each extra character of the id moves the XML one byte further, so
+      // three consecutive lengths end with no, one and two '=' (%3D).
+      for (int length = 0; length < 6; length++) {
+        await check(signRequest('r' * length, [signDocument('doc')]));
+      }
+    });
+  });
+
+  group('postsign', () {
+    Future<void> check(List<TriphaseRequest>? requests) => expectSameBody(
+        () => NativeRequestFactory.createPostsignBody(operation, requests),
+        () => XmlRequestFactory.createPostsignRequest(requests));
+
+    testWidgets('null and empty lists', (tester) async {
+      await check(null);
+      await check([]);
+    });
+
+    testWidgets('OK and KO requests', (tester) async {
+      await check([
+        TriphaseRequest('req-1', [
+          triphaseDocument('doc-1', {'PK1': 'c2lnbmF0dXJl', 'NEED_DATA': 'true'}),
+          triphaseDocument('doc-2', {'PK1': 'b3RoZXI=', 'PRE': 'cHJl'}),
+        ]),
+        // Documents of a KO request are not sent.
+        TriphaseRequest.withStatus('req-2', [triphaseDocument('doc-3', {'PK1': 'eA=='})], false),
+        TriphaseRequest.withException('req-3', false, 'error'),
+        TriphaseRequest('req-4', null),
+      ]);
+    });
+
+    testWidgets('null and empty fields', (tester) async {
+      await check([
+        TriphaseRequest('', [
+          triphaseDocument(null, {},
+              cryptoOperation: null, signatureFormat: null, digest: null, params: null),
+          triphaseDocument('', {'': ''},
+              cryptoOperation: '', signatureFormat: '', digest: '', params: ''),
+        ]),
+      ]);
+    });
+
+    testWidgets('XML special and non-ASCII characters', (tester) async {
+      await check([
+        TriphaseRequest(xmlSpecial, [
+          triphaseDocument(nonAscii, {xmlSpecial: nonAscii, nonAscii: xmlSpecial},
+              cryptoOperation: xmlSpecial, params: nonAscii),
+        ]),
+      ]);
+    });
+
+    testWidgets('every base64 padding length', (tester) async {
+      for (int length = 0; length < 6; length++) {
+        await check([
+          TriphaseRequest('r' * length, [triphaseDocument('doc', {'PK1': 'eA=='})]),
+        ]);
+      }
+    });
+  });
+
+  group('approve', () {
+    Future<void> check(List<String>? ids) => expectSameBody(
+        () => NativeRequestFactory.createApproveBody(operation, ids),
+        () => XmlRequestFactory.createApproveRequest(ids));
+
+    testWidgets('null and empty lists', (tester) async {
+      await check(null);
+      await check([]);
+    });
+
+    testWidgets('identifiers', (tester) async {
+      await check(['req-1']);
+      await check(['req-1', '', xmlSpecial, nonAscii]);
+    });
+
+    testWidgets('every base64 padding length', (tester) async {
+      for (int length = 0; length < 6; length++) {
+        await check(['r' * length]);
+      }
+    });
+  });
+
+  group('reject', () {
+    Future<void> check(List<String>? ids, String? reason) => expectSameBody(
+        () => NativeRequestFactory.createRejectBody(operation, ids, reason),
+        () => XmlRequestFactory.createRejectRequest(ids, reason));
+
+    testWidgets('null and empty lists', (tester) async {
+      await check(null, 'motivo');
+      await check([], 'motivo');
+    });
+
+    testWidgets('missing reasons', (tester) async {
+      await check(['req-1'], null);
+      await check(['req-1'], '');
+    });
+
+    testWidgets('non-ASCII reasons', (tester) async {
+      await check(['req-1', 'req-2'], nonAscii);
+      await check(['req-1'], 'ñ');
+      await check(['req-1'], '€');
+      await check(['req-1'], '😀');
+    });
+
+    testWidgets('XML special characters', (tester) async {
+      await check([xmlSpecial], xmlSpecial);
+    });
+
+    testWidgets('every base64 padding length of the reason', (tester) async {
+      // The reason is base64url encoded inside the XML, which is encoded
+      // again: both paddings vary.
+      for (int length = 1; length < 7; length++) {
+        await check(['req-1'], 'm' * length);
+        await check(['r' * length], 'motivo');
+      }
+    });
+  });
+}
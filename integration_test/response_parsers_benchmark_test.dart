@@ -0,0 +1,204 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Compara los analizadores de respuestas en Dart con el analizador nativo
+// sobre respuestas sintéticas de 10000 peticiones, las mismas que genera
+// plugins/native_core/tools/response_parser_benchmark.cpp. Para cada uno
+// mide el tiempo total y el que ocupa el isolate de la interfaz: todo el
+// análisis en Dart, y solo la construcción de los objetos del modelo a partir
+// de las tablas en el nativo. Comprueba también que ambos dan lo mismo.
+// Necesita el plugin nativo, así que se ejecuta en Windows:
+//
+//   flutter test integration_test/response_parsers_benchmark_test.dart -d windows
+
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:integration_test/integration_test.dart';
+import 'package:portafirmas/api/native_response_parsers.dart';
+import 'package:portafirmas/api/presign_response_parser.dart';
+import 'package:portafirmas/api/request_list_response_parser.dart';
+import 'package:portafirmas/model/partial_sign_requests_list.dart';
+import 'package:portafirmas/model/triphase_request.dart';
+import 'package:portafirmas_native/portafirmas_native.dart';
+
+const int requestCount = 10000;
+const int runs = 10;
+
+/// Tamaño de los fragmentos en que llega el cuerpo por la red.
+const int chunkSize = 16 * 1024;
+
+const List<String> senders = [
+  'José García Martínez',
+  'María López Sánchez',
+  'Ángel Pérez Gómez',
+  'Lucía Fernández Jiménez',
+  'Íñigo Muñoz Álvarez',
+  'Begoña Romero Ibáñez',
+];
+
+String requestId(int i) => 'REQ${1000000 + i}';
+
+String documentId(int i, int document) => 'DOC${1000000 + i}-$document';
+
+/// Un listado de [count] peticiones como el que envía el proxy.
+Uint8List buildList(int count) {
+  StringBuffer xml = StringBuffer('<?xml version="1.0" encoding="UTF-8"?><list n="$count">');
+  for (int i = 0; i < count; i++) {
+    xml.write('<rqt id="${requestId(i)}" priority="${1 + i % 3}" workflow="false" '
+        'forward="false" type="${i % 5 == 0 ? 'VISTOBUENO' : 'FIRMA'}">');
+    xml.write('<subj>Resolución de contratación del expediente $i &_lt;urgente&_gt;</subj>');
+    xml.write('<snder>${senders[i % 6]}</snder>');
+    xml.write('<view>NUEVO</view><date>01/06/2022</date><expdate>30/06/2022</expdate><docs>');
+    for (int document = 1; document <= 2; document++) {
+      xml.write('<doc docid="${documentId(i, document)}"><nm>documento_${i}_$document.pdf</nm>'
+          '<sz>${12345 + i}</sz><mmtp>application/pdf</mmtp><sigfrmt>PAdES</sigfrmt>'
+          '<mdalgo>SHA-256</mdalgo><params>null</params></doc>');
+    }
+    xml.write('</docs></rqt>');
+  }
+  xml.write('</list>');
+  return Uint8List.fromList(utf8.encode(xml.toString()));
+}
+
+/// Una respuesta de prefirma de [count] peticiones, con un parámetro PRE de
+/// 512 bytes en lugar de los atributos firmados.
+Uint8List buildPresign(int count) {
+  String pre = 'Q' * 512;
+  StringBuffer xml = StringBuffer('<?xml version="1.0" encoding="UTF-8"?><pres>');
+  for (int i = 0; i < count; i++) {
+    xml.write('<req id="${requestId(i)}" status="OK">');
+    for (int document = 1; document <= 2; document++) {
+      xml.write('<doc docid="${documentId(i, document)}" cop="firma" sigfrmt="PAdES" '
+          'mdalgo="SHA-256"><params>bW9kZT1pbXBsaWNpdA==</params><result>'
+          '<p n="PRE">$pre</p><p n="NEED_PRE">true</p><p n="TIME">1654084800000</p>'
+          '</result></doc>');
+    }
+    xml.write('</req>');
+  }
+  xml.write('</pres>');
+  return Uint8List.fromList(utf8.encode(xml.toString()));
+}
+
+/// El cuerpo en fragmentos, como lo entrega el cliente HTTP.
+Stream<List<int>> chunks(Uint8List body) async* {
+  for (int offset = 0; offset < body.length; offset += chunkSize) {
+    int end = offset + chunkSize < body.length ? offset + chunkSize : body.length;
+    yield Uint8List.sublistView(body, offset, end);
+  }
+}
+
+/// Mediana de [samples], en milisegundos.
+double median(List<Duration> samples) {
+  List<int> sorted = samples.map((sample) => sample.inMicroseconds).toList()..sort();
+  return sorted[sorted.length ~/ 2] / 1000;
+}
+
+/// Tiempos de un analizador: el total y el que bloquea el isolate.
+class Timing {
+  final List<Duration> total = [];
+  final List<Duration> isolate = [];
+
+  String describe() =>
+      'total ${median(total).toStringAsFixed(1)} ms, '
+      'isolate ${median(isolate).toStringAsFixed(1)} ms';
+}
+
+void report(String name, int bytes, Timing dart, Timing native) {
+  debugPrint('$name (${(bytes / 1e6).toStringAsFixed(1)} MB): '
+      'Dart ${dart.describe()}; nativo ${native.describe()}');
+}
+
+void main() {
+  IntegrationTestWidgetsFlutterBinding binding =
+      IntegrationTestWidgetsFlutterBinding.ensureInitialized();
+  Map<String, Object> results = {};
+
+  setUpAll(() {
+    expect(NativeResponseParser.isSupported, isTrue,
+        reason: 'El analizador nativo solo existe en Windows.');
+  });
+
+  tearDownAll(() {
+    binding.reportData = results;
+  });
+
+  testWidgets('request list', (tester) async {
+    Uint8List body = buildList(requestCount);
+    Timing dart = Timing();
+    Timing native = Timing();
+    PartialSignRequestsList? dartList;
+    PartialSignRequestsList? nativeList;
+    for (int run = 0; run < runs; run++) {
+      Stopwatch stopwatch = Stopwatch()..start();
+      dartList = RequestListResponseParser.parse(utf8.decode(body));
+      dart.total.add(stopwatch.elapsed);
+      dart.isolate.add(stopwatch.elapsed);
+
+      stopwatch.reset();
+      ParsedResponse parsed =
+          await NativeResponseParser.parseStream(ResponseKind.requestList, chunks(body));
+      Duration parsedAt = stopwatch.elapsed;
+      nativeList = NativeResponseParsers.requestList(parsed);
+      native.total.add(stopwatch.elapsed);
+      native.isolate.add(stopwatch.elapsed - parsedAt);
+    }
+
+    expect(nativeList!.totalSignRequests, dartList!.totalSignRequests);
+    expect(nativeList.currentSignRequests.length, requestCount);
+    for (int i = 0; i < requestCount; i += 997) {
+      expect(nativeList.currentSignRequests[i].id, dartList.currentSignRequests[i].id);
+      expect(nativeList.currentSignRequests[i].subject, dartList.currentSignRequests[i].subject);
+      expect(nativeList.currentSignRequests[i].docs!.length,
+          dartList.currentSignRequests[i].docs!.length);
+    }
+    report('list', body.length, dart, native);
+    results['list'] = {'dart': median(dart.total), 'native': median(native.total)};
+  });
+
+  testWidgets('presign', (tester) async {
+    Uint8List body = buildPresign(requestCount);
+    Timing dart = Timing();
+    Timing native = Timing();
+    List<TriphaseRequest>? dartRequests;
+    List<TriphaseRequest>? nativeRequests;
+    for (int run = 0; run < runs; run++) {
+      Stopwatch stopwatch = Stopwatch()..start();
+      dartRequests = PresignResponseParser.parse(utf8.decode(body));
+      dart.total.add(stopwatch.elapsed);
+      dart.isolate.add(stopwatch.elapsed);
+
+      stopwatch.reset();
+      ParsedResponse parsed =
+          await NativeResponseParser.parseStream(ResponseKind.presign, chunks(body));
+      Duration parsedAt = stopwatch.elapsed;
+      nativeRequests = NativeResponseParsers.presign(parsed);
+      native.total.add(stopwatch.elapsed);
+      native.isolate.add(stopwatch.elapsed - parsedAt);
+    }
+
+    expect(nativeRequests!.length, dartRequests!.length);
+    for (int i = 0; i < requestCount; i += 997) {
+      expect(nativeRequests[i].ref, dartRequests[i].ref);
+      expect(nativeRequests[i].requestDocuments!.length,
+          dartRequests[i].requestDocuments!.length);
+    }
+    report('presign', body.length, dart, native);
+    results['presign'] = {'dart': median(dart.total), 'native': median(native.total)};
+  });
+}
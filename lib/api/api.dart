@@ -21,10 +21,18 @@ import 'dart:typed_data';
 
 import 'package:http/http.dart' as http;
 import 'package:logging/logging.dart';
+import 'package:portafirmas/api/native_request_factory.dart';
+import 'package:portafirmas/api/native_response_parsers.dart';
+import 'package:portafirmas/api/presign_response_parser.dart';
+import 'package:portafirmas/api/request_detail_response_parser.dart';
+import 'package:portafirmas/api/request_list_response_parser.dart';
 import 'package:portafirmas/api/xml_request_factory.dart';
 import 'package:portafirmas/config.dart';
+import 'package:portafirmas/model/partial_sign_requests_list.dart';
+import 'package:portafirmas/model/request_detail.dart';
 import 'package:portafirmas/model/sign_request.dart';
 import 'package:portafirmas/model/triphase_request.dart';
+import 'package:portafirmas_native/portafirmas_native.dart';
 import 'package:xml/xml.dart';
 
 enum HttpVerb {
@@ -58,11 +66,32 @@ class Api {
 
   Api() {
     config!.applicationPath.then((appPath) {
+      if (NativeRequestListCache.isSupported) {
+        unawaited(NativeRequestListCache.open(appPath));
+      }
+      if (NativeSigningJournal.isSupported) {
+        // ignore: avoid_types_on_closure_parameters
+        unawaited(NativeSigningJournal.open('$appPath/signing.journal').catchError((Object e) {
+          log.info('SIGNING JOURNAL: $e');
+        }));
+      }
       String path = '$appPath/network.log';
+      Logger.root.level = Level.ALL;
+      if (NativeLogSink.isSupported) {
+        // Records are written in batches from a native thread instead of
+        // opening the file on this isolate for each one.
+        // Start the application with a blank log file
+        unawaited(NativeLogSink.open(path, truncate: true));
+        Logger.root.onRecord.listen((rec) {
+          // Errors are written at once, in case nothing else gets out.
+          NativeLogSink.write('${rec.level.name}: ${rec.time}: ${rec.message}\n',
+              flush: rec.level >= Level.SEVERE);
+        });
+        return;
+      }
       File file = File(path);
       // Start the application with a blank log file
       if (file.existsSync()) file.deleteSync();
-      Logger.root.level = Level.ALL;
       Logger.root.onRecord.listen((rec) {
         file.writeAsStringSync(
           '${rec.level.name}: ${rec.time}: ${rec.message}\n',
@@ -76,6 +105,12 @@ class Api {
     certB64 = null;
     dni = null;
     _sessionCookies = '';
+    if (NativeHttpClient.isSupported) {
+      unawaited(NativeHttpClient.clearSession());
+    }
+    if (NativeSearchIndex.isSupported) {
+      unawaited(NativeSearchIndex.clear());
+    }
   }
 
   /// Request a challenge token from the server.
@@ -97,13 +132,19 @@ class Api {
     try {
       // Before logging in, clear the cookie in case there was a previous login
       _sessionCookies = '';
+      if (NativeHttpClient.isSupported) {
+        await NativeHttpClient.clearSession();
+      }
+      if (NativeSearchIndex.isSupported) {
+        await NativeSearchIndex.clear();
+      }
       log.info('REQUEST XML: <lgnrq />');
       log.info('REQUEST HEADERS: ${_getHeaders()}');
       log.info('REQUEST BODY: op=$operationLoginRequest&dat=$encodedXml');
-      http.Response response = await http.post(
+      http.Response response = await _post(
         Uri.parse(config!.serverURL),
-        body: 'op=$operationLoginRequest&dat=$encodedXml',
-        headers: _getHeaders(),
+        'op=$operationLoginRequest&dat=$encodedXml',
+        _getHeaders(),
       );
       log.info('RESPONSE HEADERS: ${response.headers}');
       log.info('RESPONSE BDOY: ${response.body}');
@@ -151,6 +192,9 @@ class Api {
       requestBody: 'op=$operationLogoutRequest&dat=$encodedXml',
       headers: _getHeaders(),
     );
+    if (NativeHttpClient.isSupported) {
+      log.info('HTTP STATS: ${await NativeHttpClient.stats()}');
+    }
     return responseBody;
   }
 
@@ -174,29 +218,133 @@ class Api {
     return responseBody;
   }
 
-  Future<String> preSignRequest(SignRequest request) async {
-    final String xml = XmlRequestFactory.createPresignRequest(request);
+  /// Obtiene y analiza una página del listado de peticiones. Donde existe el
+  /// analizador nativo, la respuesta se analiza a medida que se recibe.
+  Future<PartialSignRequestsList> getSignRequestsList(
+      String state, List<String>? filters, int numPage, int pageSize) async {
+    if (!NativeResponseParser.isSupported) {
+      var response = await getSignRequests(state, filters, numPage, pageSize);
+      return RequestListResponseParser.parse(utf8.decode(response.codeUnits));
+    }
+    String xml = XmlRequestFactory.createRequestListRequest(state, filters, numPage, pageSize);
+    String encodedXml = base64UrlSafeEncode(Uint8List.fromList(utf8.encode(xml)));
+    log.info('REQUEST XML: $xml');
+    log.info('REQUEST HEADERS: ${_getHeaders()}');
+    log.info('REQUEST BODY: op=$operationLoginValidation&dat=$encodedXml');
+    var response = await _getParsedResponse(
+      kind: ResponseKind.requestList,
+      uri: Uri.parse(config!.serverURL),
+      requestBody: 'op=$operationRequest&dat=$encodedXml',
+      headers: _getHeaders(),
+      // Solo se guarda la primera página sin filtros, que es la que se muestra
+      // al arrancar.
+      cacheKey: numPage == 1 && filters == null ? _requestListCacheKey(state) : null,
+      indexState: filters == null ? state : null,
+    );
+    return NativeResponseParsers.requestList(response);
+  }
 
-    var bytes = utf8.encode(xml);
-    String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+  /// Busca en las peticiones descargadas hasta ahora en [state] las que
+  /// contienen, al principio de alguna palabra del asunto, el remitente, el
+  /// identificador o el nombre de un documento, cada palabra de [text], sin
+  /// distinguir mayúsculas ni acentos. Devuelve los identificadores de las
+  /// [limit] primeras, o null si no hay índice en esta plataforma.
+  Future<List<String>?> searchRequests(String text, String state, {int limit = 50}) async {
+    if (!NativeSearchIndex.isSupported) {
+      return null;
+    }
+    NativeSearchResult result = await NativeSearchIndex.query(text, state: state, limit: limit);
+    return result.ids;
+  }
+
+  /// Recupera la primera página del listado de peticiones tal y como se
+  /// recibió la última vez, o null si no se guardó.
+  Future<PartialSignRequestsList?> getCachedSignRequestsList(String state) async {
+    RequestListCacheKey? key = _requestListCacheKey(state);
+    if (key == null) {
+      return null;
+    }
+    try {
+      ParsedResponse? cached = await NativeRequestListCache.load(key);
+      return cached == null ? null : NativeResponseParsers.requestList(cached);
+    } on Exception catch (e) {
+      log.info('REQUEST LIST CACHE: $e');
+      return null;
+    }
+  }
+
+  /// Propietario de las firmas guardadas en el diario de firmas: cada
+  /// usuario de cada servidor retoma solo las suyas. Null si no hay diario en
+  /// esta plataforma o no hay sesión.
+  String? get signingJournalOwner {
+    if (!NativeSigningJournal.isSupported || certB64 == null) {
+      return null;
+    }
+    return '${config!.serverURL}|$certB64';
+  }
+
+  /// Clave de la caché del listado: cada usuario de cada servidor tiene la
+  /// suya.
+  RequestListCacheKey? _requestListCacheKey(String state) {
+    if (!NativeRequestListCache.isSupported || certB64 == null) {
+      return null;
+    }
+    return RequestListCacheKey('${config!.serverURL}|$certB64', state);
+  }
+
+  Future<String> preSignRequest(SignRequest request) async {
     var responseBody = await _getResponseBody(
       httpVerb: HttpVerb.post,
       uri: Uri.parse(config!.serverURL),
-      requestBody: 'op=$operationPresign&dat=$encodedXml',
+      requestBody: await _presignBody(request),
       headers: _getHeaders(),
     );
     return responseBody;
   }
 
-  Future<String> postSignRequests(List<TriphaseRequest> requests) async {
-    final String xml = XmlRequestFactory.createPostsignRequest(requests);
+  Future<Object> _presignBody(SignRequest request) async {
+    if (NativeRequestBuilder.isSupported) {
+      return NativeRequestFactory.createPresignBody(operationPresign, request);
+    }
+    final String xml = XmlRequestFactory.createPresignRequest(request);
 
     var bytes = utf8.encode(xml);
     String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+    return 'op=$operationPresign&dat=$encodedXml';
+  }
+
+  /// Obtiene y analiza la prefirma de una petición. Donde existe el analizador
+  /// nativo, la respuesta se analiza a medida que se recibe.
+  Future<List<TriphaseRequest>> getPresign(SignRequest request) async {
+    if (!NativeResponseParser.isSupported) {
+      return PresignResponseParser.parse(await preSignRequest(request));
+    }
+    var response = await _getParsedResponse(
+      kind: ResponseKind.presign,
+      uri: Uri.parse(config!.serverURL),
+      requestBody: await _presignBody(request),
+      headers: _getHeaders(),
+    );
+    return NativeResponseParsers.presign(response);
+  }
+
+  /// En lotes con cientos de firmas PKCS#1, el cuerpo se genera con el constructor
+  /// nativo donde existe, sin pasar por las copias intermedias del XML.
+  Future<String> postSignRequests(List<TriphaseRequest> requests) async {
+    Object requestBody;
+    if (NativeRequestBuilder.isSupported) {
+      requestBody = await NativeRequestFactory.createPostsignBody(operationPostsign, requests);
+    } else {
+      final String xml = XmlRequestFactory.createPostsignRequest(requests);
+
+      var bytes = utf8.encode(xml);
+      String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+      requestBody = 'op=$operationPostsign&dat=$encodedXml';
+    }
     var responseBody = await _getResponseBody(
       httpVerb: HttpVerb.post,
       uri: Uri.parse(config!.serverURL),
-      requestBody: 'op=$operationPostsign&dat=$encodedXml',
+      requestBody: requestBody,
       headers: _getHeaders(),
     );
     return responseBody;
@@ -221,15 +369,42 @@ class Api {
     return responseBody;
   }
 
-  Future<String> approveRequests(List<String> requestIds) async {
-    final String xml = XmlRequestFactory.createApproveRequest(requestIds);
+  /// Obtiene y analiza el detalle de una petición. Donde existe el analizador
+  /// nativo, la respuesta se analiza a medida que se recibe.
+  Future<RequestDetail> getRequestDetailParsed(final String requestId) async {
+    if (!NativeResponseParser.isSupported) {
+      var response = await getRequestDetail(requestId);
+      return RequestDetailResponseParser.parse(utf8.decode(response.codeUnits));
+    }
+    String xml = XmlRequestFactory.createDetailRequest(requestId);
+    String encodedXml = base64UrlSafeEncode(Uint8List.fromList(utf8.encode(xml)));
+    log.info('REQUEST XML: $xml');
+    log.info('REQUEST HEADERS: ${_getHeaders()}');
+    log.info('REQUEST BODY: op=$operationLoginValidation&dat=$encodedXml');
+    var response = await _getParsedResponse(
+      kind: ResponseKind.requestDetail,
+      uri: Uri.parse(config!.serverURL),
+      requestBody: 'op=$operationDetail&dat=$encodedXml',
+      headers: _getHeaders(),
+    );
+    return NativeResponseParsers.requestDetail(response);
+  }
 
-    var bytes = utf8.encode(xml);
-    String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+  Future<String> approveRequests(List<String> requestIds) async {
+    Object requestBody;
+    if (NativeRequestBuilder.isSupported) {
+      requestBody = await NativeRequestFactory.createApproveBody(operationApprove, requestIds);
+    } else {
+      final String xml = XmlRequestFactory.createApproveRequest(requestIds);
+
+      var bytes = utf8.encode(xml);
+      String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+      requestBody = 'op=$operationApprove&dat=$encodedXml';
+    }
     var responseBody = await _getResponseBody(
       httpVerb: HttpVerb.post,
       uri: Uri.parse(config!.serverURL),
-      requestBody: 'op=$operationApprove&dat=$encodedXml',
+      requestBody: requestBody,
       headers: _getHeaders(),
     );
     return responseBody;
@@ -263,14 +438,20 @@ class Api {
   }
 
   Future<String> rejectRequests(List<String> requestIds, String reason) async {
-    final String xml = XmlRequestFactory.createRejectRequest(requestIds, reason);
-
-    var bytes = utf8.encode(xml);
-    String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+    Object requestBody;
+    if (NativeRequestBuilder.isSupported) {
+      requestBody = await NativeRequestFactory.createRejectBody(operationReject, requestIds, reason);
+    } else {
+      final String xml = XmlRequestFactory.createRejectRequest(requestIds, reason);
+
+      var bytes = utf8.encode(xml);
+      String encodedXml = base64UrlSafeEncode(Uint8List.fromList(bytes));
+      requestBody = 'op=$operationReject&dat=$encodedXml';
+    }
     var responseBody = await _getResponseBody(
       httpVerb: HttpVerb.post,
       uri: Uri.parse(config!.serverURL),
-      requestBody: 'op=$operationReject&dat=$encodedXml',
+      requestBody: requestBody,
       headers: _getHeaders(),
     );
     return responseBody;
@@ -288,6 +469,17 @@ class Api {
     return _getHeaders();
   }
 
+  /// El paquete http añade 'charset=utf-8' al Content-Type cuando el cuerpo es un
+  /// String, pero no cuando son bytes. Se añade también en ese caso para que las
+  /// cabeceras no dependan de cómo se haya generado el cuerpo.
+  static Map<String, String> _headersForBody(Map<String, String> headers, Object? body) {
+    String? contentType = headers['Content-Type'];
+    if (body is String || contentType == null || contentType.contains('charset')) {
+      return headers;
+    }
+    return {...headers, 'Content-Type': '$contentType; charset=utf-8'};
+  }
+
   static String base64UrlSafeEncode(Uint8List source) {
     String next = base64Encode(source);
     return next.replaceAll('+', '-').replaceAll('/', '_').replaceAll('=', '%3D');
@@ -296,7 +488,8 @@ class Api {
   Future<String> _getResponseBody({
     required HttpVerb httpVerb,
     required Uri uri,
-    String? requestBody,
+    // String o bytes ya codificados.
+    Object? requestBody,
     required Map<String, String> headers,
   }) async {
     String resultError = 'no_error';
@@ -311,7 +504,7 @@ class Api {
           break;
         case HttpVerb.post:
           assert(requestBody != null);
-          response = await http.post(uri, body: requestBody, headers: headers);
+          response = await _post(uri, requestBody!, headers);
           break;
         case HttpVerb.put:
           assert(requestBody != null);
@@ -349,6 +542,116 @@ class Api {
     }
     return resultBody;
   }
+
+  /// POST con el cliente HTTP nativo cuando está disponible, que mantiene las
+  /// conexiones abiertas y reanuda las sesiones TLS entre peticiones. La
+  /// respuesta es la misma que daría http.post().
+  Future<http.Response> _post(Uri uri, Object requestBody, Map<String, String> headers) async {
+    if (!NativeHttpClient.isSupported) {
+      return http.post(uri, body: requestBody, headers: _headersForBody(headers, requestBody));
+    }
+    Uint8List body = _bodyBytes(requestBody);
+    NativeHttpResponse response =
+        await NativeHttpClient.post(uri, headers: _headersForBody(headers, body), body: body);
+    return http.Response.bytes(response.bodyBytes!, response.statusCode, headers: response.headers);
+  }
+
+  static Uint8List _bodyBytes(Object requestBody) {
+    if (requestBody is Uint8List) return requestBody;
+    if (requestBody is String) return Uint8List.fromList(utf8.encode(requestBody));
+    return Uint8List.fromList(requestBody as List<int>);
+  }
+
+  /// El cuerpo tal y como lo da http.Response.body, para registrarlo.
+  static String _responseText(Uint8List body, int statusCode, Map<String, String> headers) {
+    return http.Response.bytes(body, statusCode, headers: headers).body;
+  }
+
+  /// Estados de la respuesta con los que no se analiza el cuerpo.
+  static void _checkParsedStatus(int statusCode) {
+    if (statusCode == 401) {
+      throw const UnauthorizedException();
+    }
+    if (statusCode != 200) {
+      // Bad Request
+      assert(statusCode != 400, 'API call has failed');
+      throw const NetworkException();
+    }
+  }
+
+  /// Como [_getResponseBody], pero pasa el cuerpo de la respuesta al analizador
+  /// nativo por fragmentos según se reciben, sin reunirlo en memoria salvo
+  /// para registrarlo.
+  Future<ParsedResponse> _getParsedResponse({
+    required ResponseKind kind,
+    required Uri uri,
+    // String o bytes ya codificados.
+    required Object requestBody,
+    required Map<String, String> headers,
+    // Dónde guardar el listado analizado, si es un listado de peticiones, y
+    // con qué estado indexarlo para las búsquedas.
+    RequestListCacheKey? cacheKey,
+    String? indexState,
+  }) async {
+    if (NativeHttpClient.isSupported) {
+      // El cliente nativo entrega la respuesta al analizador sin que cruce el
+      // canal.
+      try {
+        Uint8List body = _bodyBytes(requestBody);
+        NativeHttpResponse response = await NativeHttpClient.postParsed(kind, uri,
+            headers: _headersForBody(headers, body),
+            body: body,
+            cacheKey: cacheKey,
+            indexState: indexState,
+            keepBody: log.isLoggable(Level.INFO));
+        log.info('RESPONSE HEADERS: ${response.headers}');
+        log.info(() => 'RESPONSE BODY: '
+            '${_responseText(response.bodyBytes!, response.statusCode, response.headers)}');
+        _checkParsedStatus(response.statusCode);
+        return response.parsed!;
+      } on PortafirmasException {
+        rethrow;
+      } on Exception {
+        throw const NetworkException();
+      }
+    }
+    http.Client client = http.Client();
+    try {
+      http.Request request = http.Request('POST', uri)
+        ..headers.addAll(_headersForBody(headers, requestBody));
+      if (requestBody is String) {
+        request.body = requestBody;
+      } else {
+        request.bodyBytes = requestBody as List<int>;
+      }
+      http.StreamedResponse response = await client.send(request);
+      log.info('RESPONSE HEADERS: ${response.headers}');
+      if (response.statusCode != 200) {
+        // El cuerpo de los errores no se analiza, pero se registra.
+        Uint8List body = await response.stream.toBytes();
+        log.info(() => 'RESPONSE BODY: ${_responseText(body, response.statusCode, response.headers)}');
+        _checkParsedStatus(response.statusCode);
+      }
+      // Solo se guarda una copia del cuerpo si se va a registrar.
+      List<int>? logged = log.isLoggable(Level.INFO) ? <int>[] : null;
+      ParsedResponse parsed = await NativeResponseParser.parseStream(
+        kind,
+        response.stream.map((chunk) {
+          logged?.addAll(chunk);
+          return chunk;
+        }),
+      );
+      log.info(() => 'RESPONSE BODY: '
+          '${_responseText(Uint8List.fromList(logged!), response.statusCode, response.headers)}');
+      return parsed;
+    } on PortafirmasException {
+      rethrow;
+    } on Exception {
+      throw const NetworkException();
+    } finally {
+      client.close();
+    }
+  }
 }
 
 class PortafirmasException implements Exception {
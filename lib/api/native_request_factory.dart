@@ -0,0 +1,94 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+import 'dart:typed_data';
+
+import 'package:portafirmas/model/sign_request.dart';
+import 'package:portafirmas/model/triphase_request.dart';
+import 'package:portafirmas_native/portafirmas_native.dart';
+
+/// Crea con el constructor nativo los cuerpos de las solicitudes por lotes,
+/// ya codificados como 'op=<operación>&dat=<xml>'. El resultado es idéntico al de
+/// [XmlRequestFactory] seguido de [Api.base64UrlSafeEncode] y se lanzan las mismas
+/// excepciones.
+class NativeRequestFactory {
+  /// Equivalente a [XmlRequestFactory.createPresignRequest].
+  static Future<Uint8List> createPresignBody(String operation, SignRequest? request) {
+    if (request == null) {
+      throw Exception('La lista de peticiones no puede ser nula');
+    }
+    return NativeRequestBuilder.presignBody(operation, request.id, presignDocuments(request));
+  }
+
+  /// Los documentos de [request] tal y como se envían en la prefirma.
+  static List<List<String?>>? presignDocuments(SignRequest request) {
+    return request.docs
+        ?.map((document) => [
+              document.id,
+              document.cryptoOperation,
+              document.signFormat,
+              document.messageDigestAlgorithm,
+              document.params,
+            ])
+        .toList();
+  }
+
+  /// Equivalente a [XmlRequestFactory.createPostsignRequest].
+  static Future<Uint8List> createPostsignBody(String operation, List<TriphaseRequest>? requests) {
+    if (requests == null) {
+      throw Exception('La lista de peticiones no puede ser nula');
+    }
+    List<List<Object?>> fields = requests.map((request) {
+      // Solo se envían los documentos si la peticion es buena
+      List<List<Object?>> documents = [];
+      if (request.isStatusOk && request.requestDocuments != null) {
+        documents = request.requestDocuments!.map((document) {
+          List<String> result = [];
+          document.partialResult!.forEach((key, value) {
+            result.addAll([key, value]);
+          });
+          return [
+            document.id,
+            document.cryptoOperation,
+            document.signatureFormat,
+            document.messageDigestAlgorithm,
+            document.params,
+            result,
+          ];
+        }).toList();
+      }
+      return [request.ref, request.isStatusOk, documents];
+    }).toList();
+    return NativeRequestBuilder.postsignBody(operation, fields);
+  }
+
+  /// Equivalente a [XmlRequestFactory.createApproveRequest].
+  static Future<Uint8List> createApproveBody(String operation, List<String>? requestIds) {
+    if (requestIds == null || requestIds.isEmpty) {
+      throw Exception('La lista de peticiones no puede ser nula');
+    }
+    return NativeRequestBuilder.approveBody(operation, requestIds);
+  }
+
+  /// Equivalente a [XmlRequestFactory.createRejectRequest].
+  static Future<Uint8List> createRejectBody(
+      String operation, List<String>? requestIds, String? reason) {
+    if (requestIds == null || requestIds.isEmpty) {
+      throw Exception('La lista de peticiones no puede ser nula');
+    }
+    return NativeRequestBuilder.rejectBody(operation, requestIds, reason ?? '');
+  }
+}
@@ -0,0 +1,349 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:flutter/material.dart';
+import 'package:portafirmas/api/api.dart';
+import 'package:portafirmas/model/partial_sign_requests_list.dart';
+import 'package:portafirmas/model/request_detail.dart';
+import 'package:portafirmas/model/request_document.dart';
+import 'package:portafirmas/model/sign_line.dart';
+import 'package:portafirmas/model/sign_line_element.dart';
+import 'package:portafirmas/model/sign_request.dart';
+import 'package:portafirmas/model/sign_request_document.dart';
+import 'package:portafirmas/model/triphase_request.dart';
+import 'package:portafirmas/model/triphase_sign_request_document.dart';
+import 'package:portafirmas_native/portafirmas_native.dart';
+
+// Posiciones de las columnas de las tablas que genera el analizador nativo.
+// Deben coincidir con las enumeraciones de native_core/proxy_response_parsers.h.
+
+class _ListField {
+  static const int total = 0;
+}
+
+class _RequestField {
+  static const int id = 0;
+  static const int subject = 1;
+  static const int sender = 2;
+  static const int view = 3;
+  static const int date = 4;
+  static const int expirationDate = 5;
+  static const int priority = 6;
+  static const int workflow = 7;
+  static const int forward = 8;
+  static const int type = 9;
+  static const int firstDocument = 10;
+  static const int documentCount = 11;
+  static const int stride = 12;
+}
+
+class _DocumentField {
+  static const int id = 0;
+  static const int name = 1;
+  static const int size = 2;
+  static const int mimeType = 3;
+  static const int signatureFormat = 4;
+  static const int messageDigestAlgorithm = 5;
+  static const int params = 6;
+  static const int stride = 7;
+}
+
+class _DetailField {
+  static const int id = 0;
+  static const int subject = 1;
+  static const int message = 2;
+  static const int date = 3;
+  static const int expirationDate = 4;
+  static const int application = 5;
+  static const int rejectReason = 6;
+  static const int reference = 7;
+  static const int signLinesType = 8;
+  static const int priority = 9;
+  static const int workflow = 10;
+  static const int forward = 11;
+  static const int type = 12;
+  static const int firstSender = 13;
+  static const int senderCount = 14;
+  static const int firstLine = 15;
+  static const int lineCount = 16;
+  static const int firstDocument = 17;
+  static const int documentCount = 18;
+  static const int firstAttached = 19;
+  static const int attachedCount = 20;
+}
+
+class _SenderField {
+  static const int name = 0;
+  static const int stride = 1;
+}
+
+class _LineField {
+  static const int type = 0;
+  static const int firstSigner = 1;
+  static const int signerCount = 2;
+  static const int stride = 3;
+}
+
+class _SignerField {
+  static const int name = 0;
+  static const int done = 1;
+  static const int stride = 2;
+}
+
+class _AttachedField {
+  static const int id = 0;
+  static const int name = 1;
+  static const int size = 2;
+  static const int mimeType = 3;
+  static const int stride = 4;
+}
+
+class _PresignRequestField {
+  static const int reference = 0;
+  static const int statusOk = 1;
+  static const int exception = 2;
+  static const int firstDocument = 3;
+  static const int documentCount = 4;
+  static const int stride = 5;
+}
+
+class _PresignDocumentField {
+  static const int id = 0;
+  static const int cryptoOperation = 1;
+  static const int signatureFormat = 2;
+  static const int messageDigestAlgorithm = 3;
+  static const int params = 4;
+  static const int firstParam = 5;
+  static const int paramCount = 6;
+  static const int stride = 7;
+}
+
+class _ParamField {
+  static const int key = 0;
+  static const int value = 1;
+  static const int stride = 2;
+}
+
+/// Construye los objetos del modelo a partir de las tablas del analizador nativo
+/// de respuestas. Acepta y rechaza lo mismo que los analizadores en Dart.
+class NativeResponseParsers {
+  /// Lanza la excepción que habría lanzado la ruta en Dart: [ErrorMessageException]
+  /// si el proxy devolvió un error, [NetworkException] si el XML está mal formado
+  /// y [Exception] si el contenido no es válido.
+  static void _checkErrors(ParsedResponse response) {
+    if (response.proxyError != null) {
+      throw ErrorMessageException(response.proxyError!);
+    }
+    if (response.syntaxError != null) {
+      throw const NetworkException();
+    }
+    if (response.error != null) {
+      throw Exception(response.error);
+    }
+  }
+
+  static RequestType? _requestType(int value) {
+    switch (value) {
+      case 0:
+        return RequestType.signature;
+      case 1:
+        return RequestType.approve;
+    }
+    return null;
+  }
+
+  /// Equivalente a [RequestListResponseParser.parse].
+  static PartialSignRequestsList requestList(ParsedResponse response) {
+    _checkErrors(response);
+    Int32List list = response.tables['list']!;
+    Int32List requests = response.tables['requests']!;
+    Int32List docs = response.tables['docs']!;
+
+    String? total = response.string(list[_ListField.total]);
+    int numRequests = total == null ? 0 : int.tryParse(total) ?? 0;
+
+    List<SignRequest> signRequests = [];
+    for (int row = 0; row < requests.length; row += _RequestField.stride) {
+      String? priority = response.string(requests[row + _RequestField.priority]);
+      signRequests.add(SignRequest(
+        response.string(requests[row + _RequestField.id])!,
+        response.string(requests[row + _RequestField.subject]),
+        response.string(requests[row + _RequestField.sender])!,
+        response.string(requests[row + _RequestField.view]),
+        response.string(requests[row + _RequestField.date]),
+        response.string(requests[row + _RequestField.expirationDate]),
+        priority == null ? 1 : int.parse(priority),
+        requests[row + _RequestField.workflow] == 1,
+        requests[row + _RequestField.forward] == 1,
+        _requestType(requests[row + _RequestField.type]),
+        _documents(response, docs, requests[row + _RequestField.firstDocument],
+            requests[row + _RequestField.documentCount]),
+        null,
+      ));
+    }
+    return PartialSignRequestsList(signRequests, numRequests);
+  }
+
+  static List<SignRequestDocument> _documents(
+      ParsedResponse response, Int32List docs, int first, int count) {
+    List<SignRequestDocument> documents = [];
+    for (int i = first; i < first + count; i++) {
+      int row = i * _DocumentField.stride;
+      documents.add(SignRequestDocument(
+        response.string(docs[row + _DocumentField.id])!,
+        response.string(docs[row + _DocumentField.name])!,
+        _size(response.string(docs[row + _DocumentField.size])),
+        response.string(docs[row + _DocumentField.mimeType])!,
+        response.string(docs[row + _DocumentField.signatureFormat])!,
+        response.string(docs[row + _DocumentField.messageDigestAlgorithm])!,
+        response.string(docs[row + _DocumentField.params]),
+        null,
+      ));
+    }
+    return documents;
+  }
+
+  /// Tamaño de un documento: -1 si no se indica y null si no es válido.
+  static int? _size(String? text) {
+    if (text == null) return -1;
+    int? size = int.tryParse(text);
+    if (size == null) {
+      debugPrint('No se ha indicado un tamaño de documento válido: $text');
+    }
+    return size;
+  }
+
+  /// Equivalente a [RequestDetailResponseParser.parse].
+  static RequestDetail requestDetail(ParsedResponse response) {
+    _checkErrors(response);
+    Int32List detail = response.tables['detail']!;
+    Int32List senders = response.tables['senders']!;
+    Int32List lines = response.tables['lines']!;
+    Int32List signers = response.tables['signers']!;
+    Int32List docs = response.tables['docs']!;
+    Int32List attached = response.tables['attached']!;
+
+    // Sin errores, la respuesta siempre tiene un elemento raíz.
+    RequestDetail reqDetail = RequestDetail(response.string(detail[_DetailField.id])!);
+    String? priority = response.string(detail[_DetailField.priority]);
+    reqDetail.priority = priority == null ? 1 : int.parse(priority);
+    reqDetail.workflow = detail[_DetailField.workflow] == 1;
+    reqDetail.forward = detail[_DetailField.forward] == 1;
+    reqDetail.type = _requestType(detail[_DetailField.type]);
+    reqDetail.subject = response.string(detail[_DetailField.subject]);
+    reqDetail.message = response.string(detail[_DetailField.message]);
+
+    int firstSender = detail[_DetailField.firstSender];
+    reqDetail.senders = [
+      for (int i = firstSender; i < firstSender + detail[_DetailField.senderCount]; i++)
+        response.string(senders[i * _SenderField.stride + _SenderField.name])!
+    ];
+
+    reqDetail.date = response.string(detail[_DetailField.date]);
+    String? expDate = response.string(detail[_DetailField.expirationDate]);
+    if (expDate != null) reqDetail.expDate = expDate;
+    reqDetail.app = response.string(detail[_DetailField.application]);
+    reqDetail.rejectReason = response.string(detail[_DetailField.rejectReason]);
+    reqDetail.ref = response.string(detail[_DetailField.reference]);
+    reqDetail.signlinestype = response.string(detail[_DetailField.signLinesType]);
+
+    List<SignLine> signLines = [];
+    int firstLine = detail[_DetailField.firstLine];
+    for (int i = firstLine; i < firstLine + detail[_DetailField.lineCount]; i++) {
+      int line = i * _LineField.stride;
+      SignLine signLine = SignLine.withType(response.string(lines[line + _LineField.type])!);
+      int firstSigner = lines[line + _LineField.firstSigner];
+      for (int j = firstSigner; j < firstSigner + lines[line + _LineField.signerCount]; j++) {
+        int signer = j * _SignerField.stride;
+        signLine.addElement(SignLineElement(response.string(signers[signer + _SignerField.name])!,
+            signers[signer + _SignerField.done] == 1));
+      }
+      signLines.add(signLine);
+    }
+    reqDetail.signLines = signLines;
+
+    reqDetail.docs = _documents(response, docs, detail[_DetailField.firstDocument],
+        detail[_DetailField.documentCount]);
+
+    int firstAttached = detail[_DetailField.firstAttached];
+    if (firstAttached >= 0) {
+      List<RequestDocument> attachments = [];
+      for (int i = firstAttached; i < firstAttached + detail[_DetailField.attachedCount]; i++) {
+        int row = i * _AttachedField.stride;
+        attachments.add(RequestDocument(
+          response.string(attached[row + _AttachedField.id])!,
+          response.string(attached[row + _AttachedField.name])!,
+          _size(response.string(attached[row + _AttachedField.size])),
+          response.string(attached[row + _AttachedField.mimeType])!,
+        ));
+      }
+      reqDetail.attached = attachments;
+    }
+    return reqDetail;
+  }
+
+  /// Equivalente a [PresignResponseParser.parse].
+  static List<TriphaseRequest> presign(ParsedResponse response) {
+    _checkErrors(response);
+    Int32List requests = response.tables['requests']!;
+    Int32List docs = response.tables['docs']!;
+    Int32List params = response.tables['params']!;
+
+    List<TriphaseRequest> triphaseRequests = [];
+    for (int row = 0; row < requests.length; row += _PresignRequestField.stride) {
+      String ref = response.string(requests[row + _PresignRequestField.reference])!;
+      bool statusOk = requests[row + _PresignRequestField.statusOk] == 1;
+      String? exception = response.string(requests[row + _PresignRequestField.exception]);
+      try {
+        exception = exception == null ? null : utf8.decode(base64.decode(exception));
+      } on Exception {
+        debugPrint('No se ha podido descodificar el base 64 de la traza de la '
+            'excepcion, se usara tal cual');
+      }
+      if (!statusOk) {
+        triphaseRequests.add(TriphaseRequest.withException(ref, false, exception));
+        continue;
+      }
+
+      List<TriphaseSignRequestDocument> documents = [];
+      int firstDocument = requests[row + _PresignRequestField.firstDocument];
+      int documentCount = requests[row + _PresignRequestField.documentCount];
+      for (int i = firstDocument; i < firstDocument + documentCount; i++) {
+        int doc = i * _PresignDocumentField.stride;
+        TriphaseConfigData config = TriphaseConfigData();
+        int firstParam = docs[doc + _PresignDocumentField.firstParam];
+        for (int j = firstParam; j < firstParam + docs[doc + _PresignDocumentField.paramCount]; j++) {
+          int param = j * _ParamField.stride;
+          config[response.string(params[param + _ParamField.key])!] =
+              response.string(params[param + _ParamField.value])!;
+        }
+        documents.add(TriphaseSignRequestDocument(
+          response.string(docs[doc + _PresignDocumentField.id]),
+          response.string(docs[doc + _PresignDocumentField.cryptoOperation]),
+          response.string(docs[doc + _PresignDocumentField.signatureFormat]),
+          response.string(docs[doc + _PresignDocumentField.messageDigestAlgorithm]),
+          response.string(docs[doc + _PresignDocumentField.params]),
+          config,
+        ));
+      }
+      triphaseRequests.add(TriphaseRequest.withStatus(ref, documents, statusOk));
+    }
+    return triphaseRequests;
+  }
+}
@@ -14,15 +14,11 @@
     limitations under the License.
 */
 
-import 'dart:convert';
-
 import 'package:flutter/material.dart';
 import 'package:mobx/mobx.dart';
 import 'package:portafirmas/api/api.dart';
 import 'package:portafirmas/api/approve_response_parser.dart';
 import 'package:portafirmas/api/reject_response_parser.dart';
-import 'package:portafirmas/api/request_detail_response_parser.dart';
-import 'package:portafirmas/api/request_list_response_parser.dart';
 import 'package:portafirmas/config.dart';
 import 'package:portafirmas/model/request_detail.dart';
 import 'package:portafirmas/model/request_result.dart';
@@ -113,8 +109,16 @@ abstract class _RequestController with Store {
         pageToRequest = unresolvedPresentPage + 1;
       }
     }
-    var response = await api.getSignRequests(requestsState, null, pageToRequest, _requestPageSize);
-    var parsedResult = RequestListResponseParser.parse(utf8.decode(response.codeUnits));
+    if (pageLoadType == PageLoadType.initial) {
+      await _showCachedRequests(requestsState);
+      // Requests signed by an interrupted batch are postsigned before the
+      // list is fetched, so that they no longer show as unresolved.
+      if (requestsState == SignRequest.stateUnresolved) {
+        await TriSigner.resumeBatch(api);
+      }
+    }
+    var parsedResult =
+        await api.getSignRequestsList(requestsState, null, pageToRequest, _requestPageSize);
     var requests = parsedResult.currentSignRequests;
     var totalRequests = parsedResult.totalSignRequests;
     if (requestsState == SignRequest.stateUnresolved) {
@@ -126,9 +130,29 @@ abstract class _RequestController with Store {
     }
   }
 
+  /// Shows the first page as it was last downloaded while the server answers,
+  /// unless the list already has something to show.
+  Future<void> _showCachedRequests(String requestsState) async {
+    bool unresolved = requestsState == SignRequest.stateUnresolved;
+    if ((unresolved ? unresolvedRequests : otherRequests).isNotEmpty) {
+      return;
+    }
+    var cached = await api.getCachedSignRequestsList(requestsState);
+    if (cached == null) {
+      return;
+    }
+    if (unresolved) {
+      unresolvedPresentPage = 1;
+      unresolvedHasMore = _requestPageSize < cached.totalSignRequests;
+      unresolvedRequests = [...cached.currentSignRequests].asObservable();
+    } else {
+      otherRequests = [...cached.currentSignRequests].asObservable();
+    }
+  }
+
   Future<void> requestDetail(SignRequest request) {
-    return api.getRequestDetail(request.id).then((response) {
-      activeRequestDetail = RequestDetailResponseParser.parse(utf8.decode(response.codeUnits));
+    return api.getRequestDetailParsed(request.id).then((detail) {
+      activeRequestDetail = detail;
       // ignore: avoid_types_on_closure_parameters
     }).catchError((Object e) {
       debugPrint('Problema en la respuesta de detalle: ${e.toString()}');
@@ -148,6 +172,24 @@ abstract class _RequestController with Store {
 
   // Signs a handful of requests
   Future<void> signRequests(List<SignRequest> requests) async {
+    void onResult(SignRequest request, RequestResult result) {
+      // Remove requests from local unresolvedRequests in a synchronized way
+      // since results arrive asynchronously from server
+      _lock.synchronized(() {
+        // If the status is ok (correctly processed), we remove the request from the list
+        if (result.statusOk == true) {
+          unresolvedRequests.remove(request);
+        }
+        requestsResult = result;
+      });
+    }
+
+    // The native engine pipelines the whole batch and bounds the requests in
+    // flight itself.
+    if (TriSigner.isBatchSupported) {
+      return TriSigner.signBatch(requests, api, onResult);
+    }
+
     // Create a Stream that will produce a SignRequest every interval of time
     Stream<SignRequest> requestProducer(Duration interval, List<SignRequest> requests) async* {
       for (SignRequest request in requests) {
@@ -159,17 +201,7 @@ abstract class _RequestController with Store {
     // Emit requests every 200 milliseconds. This has proved to be the correct
     // interval to avoid errors in the server when sending a handful of them.
     requestProducer(const Duration(milliseconds: 200), requests).listen((request) {
-      TriSigner.sign(request, api).then((result) {
-        // Remove requests from local unresolvedRequests in a synchronized way
-        // since results arrive asynchronously from server
-        _lock.synchronized(() {
-          // If the status is ok (correctly processed), we remove the request from the list
-          if (result.statusOk == true) {
-            unresolvedRequests.remove(request);
-          }
-          requestsResult = result;
-        });
-      });
+      TriSigner.sign(request, api).then((result) => onResult(request, result));
     });
   }
 
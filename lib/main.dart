@@ -25,6 +25,7 @@ import 'package:portafirmas/config.dart';
 import 'package:portafirmas/controllers/request_controller.dart';
 import 'package:portafirmas/controllers/user_controller.dart';
 import 'package:portafirmas/services/localizations.dart';
+import 'package:portafirmas/services/native_diagnostics.dart';
 import 'package:portafirmas/widgets/home.dart';
 import 'package:provider/provider.dart';
 
@@ -43,18 +44,21 @@ Future main() async {
   _setTargetPlatformForDesktop();
 
   WidgetsFlutterBinding.ensureInitialized();
+  unawaited(NativeDiagnostics.startupPhase('dart main'));
 
   await FlutterDownloader.initialize();
 
   config = Config();
   await config!.init();
   final api = Api();
+  unawaited(NativeDiagnostics.startupPhase('config loaded'));
 
   // Add some delay to allow for the application to initialize
   // Otherwise, the application starts with a black screen
   await Future<void>.delayed(const Duration(milliseconds: 100));
 
   runApp(MyApp(api: api));
+  WidgetsBinding.instance.addPostFrameCallback((_) => NativeDiagnostics.firstFrame());
 }
 
 class MyApp extends StatelessWidget {
@@ -0,0 +1,56 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+import 'dart:io' show Directory, Platform;
+import 'dart:typed_data';
+
+import 'package:flutter/services.dart';
+import 'package:path_provider/path_provider.dart';
+
+/// Miniaturas de la primera página de los PDF descargados.
+///
+/// En Windows las genera el plugin nativo en su pool de trabajo, nunca en el
+/// hilo de plataforma, y las guarda en una caché en memoria y en disco
+/// limitada en tamaño. En el resto de plataformas no hay miniaturas.
+class DocumentThumbnails {
+  static const MethodChannel methodChannel = MethodChannel('portafirmas/thumbnails');
+
+  static Future<bool>? _opened;
+
+  /// PNG de la primera página del PDF en [path], con su lado mayor de [size]
+  /// píxeles, o null si no se puede generar.
+  static Future<Uint8List?> thumbnail(String path, {int size = 128}) async {
+    if (!Platform.isWindows || !await (_opened ??= _open())) return null;
+    return methodChannel.invokeMethod<Uint8List>('thumbnail', {'path': path, 'size': size});
+  }
+
+  /// Aciertos, renderizados y tamaño de la caché de miniaturas.
+  static Future<Map<String, int>> stats() async {
+    if (!Platform.isWindows) return {};
+    final stats = await methodChannel.invokeMapMethod<String, int>('stats');
+    return stats ?? {};
+  }
+
+  /// Abre la caché en el directorio de soporte de la aplicación, que a
+  /// diferencia del temporal de descargas se conserva entre sesiones.
+  /// Devuelve si el plugin puede renderizar PDF.
+  static Future<bool> _open() async {
+    final directory = Directory('${(await getApplicationSupportDirectory()).path}/thumbnails');
+    await directory.create(recursive: true);
+    final canRender = await methodChannel.invokeMethod<bool>('open', {'directory': directory.path});
+    return canRender ?? false;
+  }
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+import 'dart:io' show Platform;
+
+import 'package:flutter/services.dart';
+
+/// Consultas de diagnóstico al runner nativo de Windows.
+class NativeDiagnostics {
+  static const MethodChannel methodChannel = MethodChannel('portafirmas/diagnostics');
+
+  /// Número de bloqueos del hilo de plataforma por llamada de canal
+  /// ('digital_certificates/signData', ...). Vacío fuera de Windows.
+  static Future<Map<String, int>> stallCounts() async {
+    if (!Platform.isWindows) return {};
+    final counts = await methodChannel.invokeMapMethod<String, int>('stallCounts');
+    return counts ?? {};
+  }
+
+  /// Estadísticas del bucle de mensajes (iteraciones y percentiles en microsegundos).
+  static Future<Map<String, dynamic>> loopStats() async {
+    if (!Platform.isWindows) return {};
+    final stats = await methodChannel.invokeMapMethod<String, dynamic>('loopStats');
+    return stats ?? {};
+  }
+
+  /// Marca el fin de una fase del arranque en la línea de tiempo nativa.
+  static Future<void> startupPhase(String phase) async {
+    if (!Platform.isWindows) return;
+    await methodChannel.invokeMethod<void>('startupPhase', phase);
+  }
+
+  /// Avisa al runner de que se ha pintado el primer frame: cierra la línea de
+  /// tiempo del arranque y libera la inicialización diferida de los plugins.
+  static Future<void> firstFrame() async {
+    if (!Platform.isWindows) return;
+    await methodChannel.invokeMethod<void>('firstFrame');
+  }
+
+  /// Fases del arranque con su instante, en microsegundos desde la creación
+  /// del proceso.
+  static Future<List<MapEntry<String, int>>> startupTimeline() async {
+    if (!Platform.isWindows) return [];
+    final phases = await methodChannel.invokeListMethod<List<Object?>>('startupTimeline');
+    return [
+      for (final phase in phases ?? <List<Object?>>[]) MapEntry(phase[0]! as String, phase[1]! as int),
+    ];
+  }
+}
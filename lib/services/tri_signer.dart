@@ -21,12 +21,14 @@ import 'package:digital_certificates/digital_certificates.dart';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 import 'package:portafirmas/api/api.dart';
+import 'package:portafirmas/api/native_request_factory.dart';
 import 'package:portafirmas/api/postsign_response_parser.dart';
-import 'package:portafirmas/api/presign_response_parser.dart';
+import 'package:portafirmas/config.dart';
 import 'package:portafirmas/model/request_result.dart';
 import 'package:portafirmas/model/sign_request.dart';
 import 'package:portafirmas/model/triphase_request.dart';
 import 'package:portafirmas/model/triphase_sign_request_document.dart';
+import 'package:portafirmas_native/portafirmas_native.dart';
 
 /// Firmador trifásico.
 class TriSigner {
@@ -49,6 +51,87 @@ class TriSigner {
     }
   }
 
+  /// Indica si se pueden firmar lotes con [signBatch].
+  static bool get isBatchSupported => NativeTriphaseEngine.isSupported;
+
+  /// Firma un lote de peticiones con el motor trifásico nativo, que solapa las fases:
+  /// mientras se firma una petición, se prefirma la siguiente y se postfirma la anterior.
+  /// Cada petición falla por separado y con el mismo resultado que daría [sign];
+  /// [onResult] se llama una vez por petición, según van terminando.
+  static Future<void> signBatch(final List<SignRequest> requests, final Api api,
+      void Function(SignRequest request, RequestResult result) onResult) async {
+    final List<bool> done = List.filled(requests.length, false);
+    try {
+      await for (TriphaseOutcome outcome in NativeTriphaseEngine.signBatch(
+        url: config!.serverURL,
+        cookie: api.headers['Cookie'] ?? '',
+        journalOwner: api.signingJournalOwner,
+        requests: requests
+            .map((request) => [request.id, NativeRequestFactory.presignDocuments(request)])
+            .toList(),
+      )) {
+        if (outcome.failure != TriphaseFailure.none) {
+          debugPrint('TriSigner.signBatch() Error en la petición ${outcome.id}: ${outcome.detail}');
+        }
+        done[outcome.index] = true;
+        onResult(requests[outcome.index], _resultOf(outcome));
+      }
+    }
+    // El lote no ha llegado a empezar (p. ej. no hay certificado seleccionado)
+    on Exception catch (e) {
+      debugPrint('TriSigner.signBatch() Error durante la operacion de firma: ${e.toString()}');
+      for (int i = 0; i < requests.length; i++) {
+        if (!done[i]) {
+          onResult(requests[i],
+              RequestResult(id: requests[i].id, statusOk: false, errorMsg: 'Error de firma'));
+        }
+      }
+    }
+  }
+
+  /// Envía la postfirma de las peticiones que un lote anterior firmó sin
+  /// llegar a postfirmar (la aplicación se cerró o se perdió la conexión),
+  /// sin volver a firmarlas. No hace nada si no hay ninguna pendiente.
+  static Future<void> resumeBatch(final Api api) async {
+    String? owner = api.signingJournalOwner;
+    if (owner == null) {
+      return;
+    }
+    try {
+      if (await NativeSigningJournal.pendingCount(owner) == 0) {
+        return;
+      }
+      await for (TriphaseOutcome outcome in NativeTriphaseEngine.resumeBatch(
+        url: config!.serverURL,
+        cookie: api.headers['Cookie'] ?? '',
+        journalOwner: owner,
+      )) {
+        if (outcome.failure != TriphaseFailure.none || !outcome.statusOk) {
+          debugPrint('TriSigner.resumeBatch() Error en la petición ${outcome.id}: ${outcome.detail}');
+        }
+      }
+    } on Exception catch (e) {
+      debugPrint('TriSigner.resumeBatch() Error durante la postfirma: ${e.toString()}');
+    }
+  }
+
+  /// El [RequestResult] que [sign] devuelve en cada caso.
+  static RequestResult _resultOf(TriphaseOutcome outcome) {
+    switch (outcome.failure) {
+      case TriphaseFailure.none:
+      case TriphaseFailure.signature:
+        return RequestResult(id: outcome.id, statusOk: outcome.statusOk);
+      case TriphaseFailure.network:
+        return RequestResult(id: outcome.id, statusOk: false, errorMsg: 'Error de red');
+      case TriphaseFailure.presign:
+        return RequestResult(id: outcome.id, statusOk: false, errorMsg: 'Error en la prefirma');
+      case TriphaseFailure.error:
+      case TriphaseFailure.cancelled:
+        break;
+    }
+    return RequestResult(id: outcome.id, statusOk: false, errorMsg: 'Error de firma');
+  }
+
   /// Firma de forma trifásica una petición de firma.
   static Future<RequestResult> doSign(final SignRequest request, final Api api) async {
     // *****************************************************************************************************
@@ -107,8 +190,7 @@ class TriSigner {
 
   /// Genera la prefirma de una petición de firma.
   static Future<List<TriphaseRequest>> signPhase1(final SignRequest request, final Api api) async {
-    String document = await api.preSignRequest(request);
-    return PresignResponseParser.parse(document);
+    return api.getPresign(request);
   }
 
   /// Genera la firma PKCS#1 (segunda fase del proceso de firma trifásica) y muta el objeto
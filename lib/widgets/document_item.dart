@@ -14,7 +14,10 @@
     limitations under the License.
 */
 
+import 'dart:typed_data';
+
 import 'package:flutter/material.dart';
+import 'package:portafirmas/services/document_thumbnails.dart';
 
 /// Tipos de documento
 enum DocumentType {
@@ -38,13 +41,18 @@ class DocumentItem extends StatefulWidget {
   final DocumentType type;
   final GestureTapCallback onTap;
 
+  /// Ruta del documento si ya se ha descargado. Si es un PDF se muestra la
+  /// miniatura de su primera página en lugar del icono.
+  final String? filePath;
+
   const DocumentItem(
       {Key? key,
       required this.name,
       required this.mimetype,
       required this.size,
       required this.type,
-      required this.onTap})
+      required this.onTap,
+      this.filePath})
       : super(key: key);
 
   @override
@@ -52,6 +60,36 @@ class DocumentItem extends StatefulWidget {
 }
 
 class _DocumentItemState extends State<DocumentItem> {
+  /// Alto de la miniatura, y su lado mayor en píxeles: el doble, para
+  /// pantallas de alta densidad.
+  static const double _thumbnailHeight = 48.0;
+  static const int _thumbnailPixels = 96;
+
+  Uint8List? _thumbnail;
+
+  @override
+  void initState() {
+    super.initState();
+    _loadThumbnail();
+  }
+
+  @override
+  void didUpdateWidget(DocumentItem oldWidget) {
+    super.didUpdateWidget(oldWidget);
+    if (oldWidget.filePath != widget.filePath) {
+      _thumbnail = null;
+      _loadThumbnail();
+    }
+  }
+
+  Future<void> _loadThumbnail() async {
+    final String? path = widget.filePath;
+    if (path == null || !path.toLowerCase().endsWith('.pdf')) return;
+    final Uint8List? thumbnail = await DocumentThumbnails.thumbnail(path, size: _thumbnailPixels);
+    if (!mounted || thumbnail == null || path != widget.filePath) return;
+    setState(() => _thumbnail = thumbnail);
+  }
+
   @override
   Widget build(BuildContext context) {
     Color titleColor = widget.type == DocumentType.document ? Colors.black : Colors.black54;
@@ -65,7 +103,9 @@ class _DocumentItemState extends State<DocumentItem> {
               SizedBox(
                 width: 60.0,
                 child: Center(
-                  child: _getIconForFile(widget.name.toLowerCase()),
+                  child: _thumbnail != null
+                      ? Image.memory(_thumbnail!, height: _thumbnailHeight, gaplessPlayback: true)
+                      : _getIconForFile(widget.name.toLowerCase()),
                 ),
               ),
               Expanded(
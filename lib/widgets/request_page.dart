@@ -79,6 +79,9 @@ class RequestPageState extends State<RequestPage> {
   String? _downloadPath;
   final ReceivePort _port = ReceivePort();
 
+  // Documents already downloaded on Windows, by name, to show their thumbnails.
+  final Map<String, String> _downloadedFiles = {};
+
   @override
   void initState() {
     super.initState();
@@ -86,6 +89,8 @@ class RequestPageState extends State<RequestPage> {
     _bindBackgroundIsolate();
 
     FlutterDownloader.registerCallback(downloadCallback);
+
+    _findDownloadedFiles();
   }
 
   @override
@@ -103,6 +108,25 @@ class RequestPageState extends State<RequestPage> {
     super.dispose();
   }
 
+  // On Windows, documents are downloaded to the temp storage path, which is kept for the whole
+  // session: find the ones of this request that were downloaded before.
+  Future<void> _findDownloadedFiles() async {
+    if (!Platform.isWindows) return;
+    final String directory = await config!.tempStoragePath;
+    final List<String> names = [
+      for (SignRequestDocument doc in widget.requestDetail.docs!) doc.name,
+      for (RequestDocument attachment in widget.requestDetail.attached!) attachment.name,
+      for (SignRequestDocument doc in widget.requestDetail.docs!) 'report_${doc.name}.pdf',
+    ];
+    final Map<String, String> found = {};
+    for (String name in names) {
+      final String path = '$directory/$name';
+      if (await File(path).exists()) found[name] = path;
+    }
+    if (!mounted || found.isEmpty) return;
+    setState(() => _downloadedFiles.addAll(found));
+  }
+
   void _bindBackgroundIsolate() {
     bool isSuccess = IsolateNameServer.registerPortWithName(_port.sendPort, 'downloader_send_port');
     if (!isSuccess) {
@@ -416,6 +440,9 @@ class RequestPageState extends State<RequestPage> {
         }).then((response) async {
           await response.pipe(File(filePath).openWrite());
           if (!mounted) return;
+          if (docType != DocumentType.signature) {
+            setState(() => _downloadedFiles[name] = filePath);
+          }
           if (processingDialog) {
             Navigator.of(context).pop();
             processingDialog = false;
@@ -437,6 +464,7 @@ class RequestPageState extends State<RequestPage> {
         mimetype: doc.mimeType,
         size: doc.size!,
         type: DocumentType.document,
+        filePath: _downloadedFiles[doc.name],
         onTap: () {
           _onDocumentItemPressed(doc.id, doc.name, DocumentType.document);
         },
@@ -451,6 +479,7 @@ class RequestPageState extends State<RequestPage> {
             mimetype: attachment.mimeType,
             size: attachment.size!,
             type: DocumentType.attachment,
+            filePath: _downloadedFiles[attachment.name],
             onTap: () {
               _onDocumentItemPressed(attachment.id, attachment.name, DocumentType.document);
             }));
@@ -478,6 +507,7 @@ class RequestPageState extends State<RequestPage> {
             mimetype: doc.mimeType,
             size: doc.size!,
             type: DocumentType.report,
+            filePath: _downloadedFiles[name],
             onTap: () {
               _onDocumentItemPressed(doc.id, name, DocumentType.report);
             }));
@@ -22,12 +22,48 @@ class DigitalCertificates {
     return DigitalCertificatesPlatform.instance.selectCertificate();
   }
 
-  static Future<Uint8List?> signData(Uint8List data, [String? algorithm]) async {
-    return DigitalCertificatesPlatform.instance.signData(data, algorithm);
+  /// Signs [data] with the selected certificate, or with the open certificate
+  /// with [thumbprint] if given.
+  static Future<Uint8List?> signData(Uint8List data,
+      [String? algorithm, String? thumbprint]) async {
+    return DigitalCertificatesPlatform.instance.signData(data, algorithm, thumbprint);
   }
 
-  /// Gets the subject of the selected certificate
-  static Future<String?> certificateSubject() {
-    return DigitalCertificatesPlatform.instance.certificateSubject();
+  /// Gets the subject of the selected certificate, or of the certificate with
+  /// [thumbprint] if given.
+  static Future<String?> certificateSubject([String? thumbprint]) {
+    return DigitalCertificatesPlatform.instance.certificateSubject(thumbprint);
+  }
+
+  /// Selects again, without the dialog, a certificate selected before, and
+  /// returns it as [selectCertificate] does. Windows only.
+  static Future<String?> activateCertificate(String thumbprint) {
+    return DigitalCertificatesPlatform.instance.activateCertificate(thumbprint);
+  }
+
+  /// Gets the SHA-1 thumbprint of the selected certificate, in uppercase hex.
+  /// Windows only.
+  static Future<String?> certificateThumbprint() {
+    return DigitalCertificatesPlatform.instance.certificateThumbprint();
+  }
+
+  /// Gets the thumbprints of the certificates kept open, most recently used
+  /// first. Windows only.
+  static Future<List<String>> openCertificates() {
+    return DigitalCertificatesPlatform.instance.openCertificates();
+  }
+
+  /// Closes the certificate with [thumbprint], and its key. Closing the
+  /// selected certificate unselects it. Windows only.
+  static Future<void> closeCertificate(String thumbprint) {
+    return DigitalCertificatesPlatform.instance.closeCertificate(thumbprint);
+  }
+
+  /// Counters of the locked memory the signatures keep their digests and
+  /// results in: "signatures", "allocations" and "largeAllocations" (those
+  /// that did not fit a pooled block) made by them, and the "blocks" of the
+  /// pool, "blocksInUse" and "lockedBytes". Windows only.
+  static Future<Map<String, int>> signingStats() {
+    return DigitalCertificatesPlatform.instance.signingStats();
   }
 }
@@ -33,16 +33,48 @@ class MethodChannelDigitalCertificates extends DigitalCertificatesPlatform {
   }
 
   @override
-  Future<Uint8List?> signData(Uint8List data, [String? algorithm]) async {
-    return await methodChannel
-        .invokeMethod<Uint8List>('signData', {'data': data, 'algorithm': algorithm});
+  Future<Uint8List?> signData(Uint8List data, [String? algorithm, String? thumbprint]) async {
+    return await methodChannel.invokeMethod<Uint8List>('signData', {
+      'data': data,
+      'algorithm': algorithm,
+      if (thumbprint != null) 'thumbprint': thumbprint,
+    });
   }
 
   /// Gets the subject of the selected certificate
   @override
-  Future<String?> certificateSubject() async {
-    final subject =
-        await methodChannel.invokeMethod<String>('certificateSubject', <String, dynamic>{});
+  Future<String?> certificateSubject([String? thumbprint]) async {
+    final subject = await methodChannel.invokeMethod<String>('certificateSubject',
+        <String, dynamic>{if (thumbprint != null) 'thumbprint': thumbprint});
     return subject;
   }
+
+  @override
+  Future<String?> activateCertificate(String thumbprint) async {
+    return await methodChannel
+        .invokeMethod<String>('activateCertificate', {'thumbprint': thumbprint});
+  }
+
+  @override
+  Future<String?> certificateThumbprint() async {
+    return await methodChannel
+        .invokeMethod<String>('certificateThumbprint', <String, dynamic>{});
+  }
+
+  @override
+  Future<List<String>> openCertificates() async {
+    final thumbprints = await methodChannel.invokeListMethod<String>('openCertificates');
+    return thumbprints ?? <String>[];
+  }
+
+  @override
+  Future<void> closeCertificate(String thumbprint) async {
+    await methodChannel.invokeMethod<void>('closeCertificate', {'thumbprint': thumbprint});
+  }
+
+  @override
+  Future<Map<String, int>> signingStats() async {
+    final stats = await methodChannel.invokeMapMethod<String, int>('signingStats');
+    return stats ?? <String, int>{};
+  }
 }
@@ -45,11 +45,31 @@ abstract class DigitalCertificatesPlatform extends PlatformInterface {
     throw UnimplementedError('certificateSubject() has not been implemented.');
   }
 
-  Future<Uint8List?> signData(Uint8List data, [String? algorithm]) async {
+  Future<Uint8List?> signData(Uint8List data, [String? algorithm, String? thumbprint]) async {
     throw UnimplementedError('certificateSubject() has not been implemented.');
   }
 
-  Future<String?> certificateSubject() {
+  Future<String?> certificateSubject([String? thumbprint]) {
     throw UnimplementedError('certificateSubject() has not been implemented.');
   }
+
+  Future<String?> activateCertificate(String thumbprint) {
+    throw UnimplementedError('activateCertificate() has not been implemented.');
+  }
+
+  Future<String?> certificateThumbprint() {
+    throw UnimplementedError('certificateThumbprint() has not been implemented.');
+  }
+
+  Future<List<String>> openCertificates() {
+    throw UnimplementedError('openCertificates() has not been implemented.');
+  }
+
+  Future<void> closeCertificate(String thumbprint) {
+    throw UnimplementedError('closeCertificate() has not been implemented.');
+  }
+
+  Future<Map<String, int>> signingStats() {
+    throw UnimplementedError('signingStats() has not been implemented.');
+  }
 }
@@ -19,68 +19,302 @@
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar.h>
 #include <flutter/standard_method_codec.h>
+#include <flutter_windows.h>
+#include <native_core/certificate_signer.h>
+#include <native_core/lazy.h>
+#include <native_core/method_dispatch.h>
+#include <native_core/secure_arena.h>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <vector>
 
-#include <iostream>
 #include <iterator>
 #include <codecvt>
 #include <algorithm>
 
-#include <bcrypt.h>
 #include <ncrypt.h>
 #include <wincrypt.h>
 #include <cryptuiapi.h>
 
 #pragma comment (lib, "crypt32.lib")
 #pragma comment (lib, "cryptui.lib")
-#pragma comment (lib, "bcrypt.lib")
 #pragma comment (lib, "ncrypt.lib")
 
 #define MY_ENCODING_TYPE  (PKCS_7_ASN_ENCODING | X509_ASN_ENCODING)
 
-#define NT_SUCCESS(Status)          (((NTSTATUS)(Status)) >= 0)
-#define STATUS_UNSUCCESSFUL         ((NTSTATUS)0xC0000001L)
-
 namespace {
 
+  // The current user's "MY" store. Opening it loads the providers of every
+  // certificate in it, which is too slow for the startup path.
+  class CertStore {
+
+  public:
+    CertStore() {
+      // Aternativa para abrir el almacén de sistema:
+      // if (!(handle = CertOpenSystemStore(NULL, L"MY"))) {
+      handle = CertOpenStore(CERT_STORE_PROV_SYSTEM, X509_ASN_ENCODING,
+        0, CERT_STORE_OPEN_EXISTING_FLAG | CERT_SYSTEM_STORE_CURRENT_USER, L"MY");
+    }
+
+    ~CertStore() {
+      if (handle) {
+        CertCloseStore(handle, 0);
+      }
+    }
+
+    // Prevent copying.
+    CertStore(CertStore const&) = delete;
+    CertStore& operator=(CertStore const&) = delete;
+
+    // The certificates that have a private key, each with its own reference
+    // that the caller frees. Safe to call from a worker thread.
+    std::vector<PCCERT_CONTEXT> SigningCertificates() {
+      std::vector<PCCERT_CONTEXT> found;
+      if (!handle) {
+        return found;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      PCCERT_CONTEXT context = NULL;
+      while ((context = CertEnumCertificatesInStore(handle, context)) != NULL) {
+        DWORD size = 0;
+        if (CertGetCertificateContextProperty(context, CERT_KEY_PROV_INFO_PROP_ID, NULL, &size)) {
+          found.push_back(CertDuplicateCertificateContext(context));
+        }
+      }
+      return found;
+    }
+
+    // NULL if the store could not be opened.
+    HCERTSTORE handle = NULL;
+
+    // Held by every use of |handle|: the enumeration runs on a worker while
+    // the platform thread may look up or resync the store. Not recursive, so
+    // never held across anything that pumps messages.
+    std::mutex mutex;
+  };
+
+  // Opt-in: set to 1 to open the store and acquire the keys of its
+  // certificates in the background as soon as the plugin is registered.
+  const wchar_t kPrewarmVariable[] = L"PORTAFIRMAS_CERT_PREWARM";
+
+  bool IsPrewarmEnabled() {
+    wchar_t value[8];
+    DWORD length = GetEnvironmentVariableW(kPrewarmVariable, value, 8);
+    return length == 1 && value[0] == L'1';
+  }
+
+  // Certificates kept open at once, each with its key. Users with several
+  // roles or delegations switch between a few of them; beyond this the least
+  // recently used one is closed, and opened again from the store when needed.
+  constexpr size_t kMaxOpenCertificates = 8;
+
+  // Thumbprints are kept in uppercase hex, as the certificate dialog shows
+  // them.
+  std::string ToHex(const BYTE* bytes, size_t size) {
+    const char kHex[] = "0123456789ABCDEF";
+    std::string hex;
+    for (size_t i = 0; i < size; i++) {
+      hex += kHex[bytes[i] >> 4];
+      hex += kHex[bytes[i] & 0xF];
+    }
+    return hex;
+  }
+
+  // SHA-1 of the certificate. Empty if it cannot be computed.
+  std::string Thumbprint(PCCERT_CONTEXT context) {
+    BYTE hash[20];
+    DWORD size = sizeof(hash);
+    if (!CertGetCertificateContextProperty(context, CERT_SHA1_HASH_PROP_ID, hash, &size)) {
+      return std::string();
+    }
+    return ToHex(hash, size);
+  }
+
+  // Reads a thumbprint as copied from anywhere: any case, with or without
+  // spaces. Returns false if it is not 20 bytes of hex.
+  bool ParseThumbprint(const std::string& text, std::vector<BYTE>* hash) {
+    hash->clear();
+    int high = -1;
+    for (char c : text) {
+      int value;
+      if (c >= '0' && c <= '9') value = c - '0';
+      else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+      else if (c == ' ' || c == ':') continue;
+      else return false;
+      if (high < 0) {
+        high = value;
+      }
+      else {
+        hash->push_back(static_cast<BYTE>(high << 4 | value));
+        high = -1;
+      }
+    }
+    return high < 0 && hash->size() == 20;
+  }
+
+  // The certificate in base64, as returned by selectCertificate. Empty if it
+  // cannot be converted.
+  std::string CertificateBase64(PCCERT_CONTEXT context) {
+    DWORD size;
+    if (CryptBinaryToString(context->pbCertEncoded, context->cbCertEncoded,
+      CRYPT_STRING_BASE64HEADER, NULL, &size)) {
+      // Initialize the Long Pointer to Wide string properly
+      std::vector< wchar_t > wide_buffer(size);
+      LPWSTR certificate = &wide_buffer[0];
+      if (CryptBinaryToString(context->pbCertEncoded, context->cbCertEncoded, CRYPT_STRING_BASE64, certificate, &size)) {
+        std::wostringstream certificate_stream;
+        certificate_stream << certificate << std::endl;
+
+        // wide to UTF-8
+        std::wstring_convert<std::codecvt_utf8<wchar_t>> conv1;
+        return conv1.to_bytes(certificate_stream.str());
+      }
+    }
+    return std::string();
+  }
+
+  // The display name of the subject of the certificate. Empty if it cannot
+  // be read.
+  std::string Subject(PCCERT_CONTEXT context) {
+    DWORD size = CertGetNameString(context, CERT_NAME_SIMPLE_DISPLAY_TYPE, 0, NULL, NULL, 0);
+    if (!size) {
+      return std::string();
+    }
+    std::vector<TCHAR> name(size);
+    if (!CertGetNameString(context, CERT_NAME_SIMPLE_DISPLAY_TYPE, 0, NULL, name.data(), size)) {
+      return std::string();
+    }
+
+    std::wostringstream subject_stream;
+    subject_stream << name.data() << std::endl;
+
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> conv1;
+    return conv1.to_bytes(subject_stream.str());
+  }
+
+  // A certificate kept open, with the key its signer holds.
+  struct OpenCertificate {
+    std::string thumbprint;
+    std::shared_ptr<native_core::CertificateSigner> signer;
+  };
+
   class DigitalCertificatesPlugin : public flutter::Plugin {
 
   public:
-    static void RegisterWithRegistrar(flutter::PluginRegistrar* registrar);
+    // |window| is the Flutter view, or null without one.
+    static void RegisterWithRegistrar(flutter::PluginRegistrar* registrar, HWND window);
 
-    // Creates a plugin that communicates on the given channel.
+    // Creates a plugin that communicates on the given channel, whose dialogs
+    // are owned by the top-level window of |window|.
     DigitalCertificatesPlugin(
-      std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel);
+      std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel, HWND window);
 
     virtual ~DigitalCertificatesPlugin();
 
   private:
 
-    HCERTSTORE       hCertStore = NULL;
-    PCCERT_CONTEXT   pCertContext = NULL;
+    // Opened on first use, or in the background once the first frame is up.
+    native_core::Lazy<CertStore> cert_store_{ []() { return std::make_unique<CertStore>(); } };
+    // Certificates in use, most recently used first, at most
+    // kMaxOpenCertificates of them.
+    std::vector<OpenCertificate> open_certificates_;
+    // Signs with the key of the selected certificate, which is never closed
+    // while selected. Shared with the other modules as the active signer.
+    std::shared_ptr<native_core::CertificateSigner> signer_;
+
+    // Expires with the plugin; completions posted back to the platform thread
+    // hold a weak reference and do nothing once it has gone.
+    std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
 
     void CleanUp();
-    void CleanBCryptHashObjects(BCRYPT_ALG_HANDLE hAlg, BCRYPT_HASH_HANDLE hHash, PBYTE pbHashObject, PBYTE pbHash);
+
+    // Opens the store on the shared pool and acquires the keys of its
+    // certificates there without any UI. The signers whose keys could be
+    // acquired join the open certificates, behind those already in use, so
+    // that a later selection or signature finds its provider loaded.
+    void Prewarm();
+
+    // Returns the signer of the certificate with |thumbprint|, opening it from
+    // the store, without the dialog, if it is not open. Null if the store does
+    // not have it.
+    std::shared_ptr<native_core::CertificateSigner> FindCertificate(const std::string& thumbprint);
+
+    // The signer of the open certificate with the normalized |thumbprint|,
+    // made the most recently used, or null if it is not open.
+    std::shared_ptr<native_core::CertificateSigner> OpenSigner(const std::string& thumbprint);
+
+    // Makes |signer| the most recently used certificate, adding it if needed,
+    // and closes the least recently used ones beyond the limit.
+    void Touch(const std::string& thumbprint,
+      std::shared_ptr<native_core::CertificateSigner> signer);
+
+    // Makes |signer| the selected certificate.
+    void Select(std::shared_ptr<native_core::CertificateSigner> signer);
+
+    using Arguments = native_core::MethodArguments;
+    using Result = std::unique_ptr<flutter::MethodResult<>>;
+
+    // The signer of the certificate named by the "thumbprint" argument, or of
+    // the selected one without it. Null after answering |result| with an
+    // error.
+    std::shared_ptr<native_core::CertificateSigner> SignerFor(
+      const Arguments& arguments, flutter::MethodResult<>* result);
+
+    // The methods of the channel and their handlers.
+    static const native_core::MethodDispatcher<DigitalCertificatesPlugin>::Table& Methods();
 
     // Called when a method is called on |channel_|;
     void HandleMethodCall(
       const flutter::MethodCall<>& method_call,
       std::unique_ptr<flutter::MethodResult<>> result);
 
+    // Shows the certificate dialog, selects the chosen certificate and
+    // answers it in base64.
+    void SelectCertificate(const Arguments& arguments, Result result);
+
+    // Switches to a certificate selected before, without the dialog.
+    void ActivateCertificate(const Arguments& arguments, Result result);
+
+    void CertificateThumbprint(const Arguments& arguments, Result result);
+    void OpenCertificates(const Arguments& arguments, Result result);
+
+    // Closing the selected certificate unselects it.
+    void CloseCertificate(const Arguments& arguments, Result result);
+
+    void CertificateSubject(const Arguments& arguments, Result result);
+    void SignData(const Arguments& arguments, Result result);
+
+    // Allocation counters of the secure memory the signatures use.
+    void SigningStats(const Arguments& arguments, Result result);
+
+    // Call counts and times of the methods of this channel.
+    void CallStats(const Arguments& arguments, Result result);
+
     // The MethodChannel used for communication with the Flutter engine.
     std::unique_ptr<flutter::MethodChannel<>> channel_;
+
+    // The Flutter view. Signers are given it for their PIN dialogs, which
+    // are otherwise left unowned behind the application when a batch signs
+    // off the platform thread.
+    HWND window_;
+
+    // Routes the calls on |channel_| to the handlers in Methods().
+    native_core::MethodDispatcher<DigitalCertificatesPlugin> dispatcher_{
+      "digital_certificates", &Methods() };
   };
 
   // static
-  void DigitalCertificatesPlugin::RegisterWithRegistrar(flutter::PluginRegistrar* registrar) {
+  void DigitalCertificatesPlugin::RegisterWithRegistrar(
+    flutter::PluginRegistrar* registrar, HWND window) {
     auto channel =
       std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
         registrar->messenger(), "digital_certificates",
         &flutter::StandardMethodCodec::GetInstance());
     auto* channel_pointer = channel.get();
 
-    auto plugin = std::make_unique<DigitalCertificatesPlugin>(std::move(channel));
+    auto plugin = std::make_unique<DigitalCertificatesPlugin>(std::move(channel), window);
 
     channel_pointer->SetMethodCallHandler(
       [plugin_pointer = plugin.get()](const auto& call, auto result) {
@@ -91,419 +325,345 @@ namespace {
   };
 
   DigitalCertificatesPlugin::DigitalCertificatesPlugin(
-    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel)
-    : channel_(std::move(channel)) {}
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel, HWND window)
+    : channel_(std::move(channel)), window_(window) {
+    if (IsPrewarmEnabled()) {
+      Prewarm();
+    }
+    else {
+      cert_store_.WarmAfterFirstFrame();
+    }
+  }
 
   DigitalCertificatesPlugin::~DigitalCertificatesPlugin() {
     CleanUp();
   };
 
-  void DigitalCertificatesPlugin::HandleMethodCall(
-    const flutter::MethodCall<>& method_call,
-    std::unique_ptr<flutter::MethodResult<>> result) {
-
-    if (method_call.method_name().compare("selectCertificate") == 0) {
-
-      // HELP
-      // https://github.com/garmonbozzzia/XmlSignWebService/blob/master/csp-integral-test/tools/certificate-search.cpp
-      // https://github.com/rbmm/LIB/blob/master/ASIO/ssl.cpp
-
-      // Clean up previous variables in case they are still around
-      CleanUp();
-
-      // Aternativa para abrir el almacén de sistema:
-      // if (!(hCertStore = CertOpenSystemStore(NULL, L"MY"))) {
-      hCertStore = CertOpenStore(CERT_STORE_PROV_SYSTEM, X509_ASN_ENCODING,
-        0, CERT_STORE_OPEN_EXISTING_FLAG | CERT_SYSTEM_STORE_CURRENT_USER, L"MY");
-      if (!hCertStore) {
-        result->Error("certificate_error", "No se ha podido abrir el almacén de certificados.");
-        return;
+  void DigitalCertificatesPlugin::Prewarm() {
+    // Get() makes a selectCertificate issued meanwhile wait for the store
+    // instead of opening a second one. Like its own warm-up, the pool task
+    // relies on the plugin living until the process exits.
+    native_core::Lazy<CertStore>* cert_store = &cert_store_;
+    auto prewarmed = std::make_shared<std::vector<OpenCertificate>>();
+    HWND window = window_;
+    auto work = [cert_store, window, prewarmed]() {
+      for (PCCERT_CONTEXT context : cert_store->Get().SigningCertificates()) {
+        if (prewarmed->size() < kMaxOpenCertificates) {
+          auto signer = std::make_shared<native_core::CertificateSigner>(context, window);
+          // Keys that need a PIN or a missing smart card are left to the
+          // first signature.
+          if (signer->AcquireKeySilently()) {
+            prewarmed->push_back({ Thumbprint(context), std::move(signer) });
+          }
+        }
+        CertFreeCertificateContext(context);
       }
-      pCertContext = CryptUIDlgSelectCertificateFromStore(hCertStore, NULL, NULL, NULL,
-        CRYPTUI_SELECT_LOCATION_COLUMN, 0, NULL);
-      if (!pCertContext) {
-        result->Error("certificate_error", "Error al seleccionar el certificado");
+    };
+    std::weak_ptr<bool> alive = alive_;
+    auto done = [this, alive, prewarmed](bool) {
+      if (alive.expired()) {
         return;
       }
-
-      // Muestra en una ventana la información del certificado seleccionado.
-      // CryptUIDlgViewContext(CERT_STORE_CERTIFICATE_CONTEXT, pCertContext, NULL, NULL, 0, NULL);
-
-      DWORD size;
-      if (CryptBinaryToString(pCertContext->pbCertEncoded, pCertContext->cbCertEncoded,
-        CRYPT_STRING_BASE64HEADER, NULL, &size)) {
-        // Initialize the Long Pointer to Wide string properly
-        std::vector< wchar_t > wide_buffer(size);
-        LPWSTR certificate = &wide_buffer[0];
-        if (CryptBinaryToString(pCertContext->pbCertEncoded, pCertContext->cbCertEncoded, CRYPT_STRING_BASE64, certificate, &size)) {
-          // Print wide string to standard output
-          //std::wcout << certificate << std::endl;
-
-          std::wostringstream certificate_stream;
-          certificate_stream << certificate << std::endl;
-
-          // wide to UTF-8
-          std::wstring_convert<std::codecvt_utf8<wchar_t>> conv1;
-          std::string u8str = conv1.to_bytes(certificate_stream.str());
-          //std::cout << u8str << std::endl;
-
-          result->Success(flutter::EncodableValue(u8str));
-          return;
+      for (OpenCertificate& open : *prewarmed) {
+        if (open_certificates_.size() >= kMaxOpenCertificates) {
+          break;
+        }
+        bool is_open = std::any_of(open_certificates_.begin(), open_certificates_.end(),
+          [&](const OpenCertificate& other) { return other.thumbprint == open.thumbprint; });
+        if (!is_open) {
+          open_certificates_.push_back(std::move(open));
         }
       }
-      // Remember to close the CertStore
-      // CertCloseStore(hCertStore, 0);
-      result->Error("certificate_error", "Error obteniendo el certificado.");
-
+    };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      cert_store_.WarmAfterFirstFrame();
     }
-    else if (method_call.method_name().compare("certificateSubject") == 0) {
+  }
 
-      LPTSTR pszName;
-      DWORD cbSize;
+  std::shared_ptr<native_core::CertificateSigner> DigitalCertificatesPlugin::FindCertificate(
+    const std::string& thumbprint) {
+    std::vector<BYTE> hash;
+    if (!ParseThumbprint(thumbprint, &hash)) {
+      return nullptr;
+    }
+    std::string normalized = ToHex(hash.data(), hash.size());
+    std::shared_ptr<native_core::CertificateSigner> signer = OpenSigner(normalized);
+    if (signer) {
+      return signer;
+    }
 
-      cbSize = CertGetNameString(
-        pCertContext,
-        CERT_NAME_SIMPLE_DISPLAY_TYPE,
-        0,
-        NULL,
-        NULL,
-        0);
-      if (!cbSize)
-      {
-        std::cout << "CertGetNameString 1 failed" << std::endl;
-        result->Error("certificate_error", "CertGetNameString 1 failed.");
-      }
+    CertStore& store = cert_store_.Get();
+    HCERTSTORE hCertStore = store.handle;
+    if (!hCertStore) {
+      return nullptr;
+    }
+    std::unique_lock<std::mutex> store_lock(store.mutex);
+    CRYPT_HASH_BLOB blob = { static_cast<DWORD>(hash.size()), hash.data() };
+    PCCERT_CONTEXT context = CertFindCertificateInStore(hCertStore, MY_ENCODING_TYPE, 0,
+      CERT_FIND_SHA1_HASH, &blob, NULL);
+    if (!context) {
+      // Perhaps on a smart card inserted since the store was last read.
+      CertControlStore(hCertStore, 0, CERT_STORE_CTRL_RESYNC, NULL);
+      context = CertFindCertificateInStore(hCertStore, MY_ENCODING_TYPE, 0,
+        CERT_FIND_SHA1_HASH, &blob, NULL);
+    }
+    store_lock.unlock();
+    if (!context) {
+      return nullptr;
+    }
+    signer = std::make_shared<native_core::CertificateSigner>(context, window_);
+    CertFreeCertificateContext(context);
+    Touch(normalized, signer);
+    return signer;
+  }
 
-      pszName = (LPTSTR)malloc(cbSize * sizeof(TCHAR));
-      if (!pszName)
-      {
-        std::cout << "Memory allocation failed" << std::endl;
-        result->Error("certificate_error", "Memory allocation failed in CertGetNameString.");
+  std::shared_ptr<native_core::CertificateSigner> DigitalCertificatesPlugin::OpenSigner(
+    const std::string& thumbprint) {
+    for (const OpenCertificate& open : open_certificates_) {
+      if (open.thumbprint == thumbprint) {
+        std::shared_ptr<native_core::CertificateSigner> signer = open.signer;
+        Touch(thumbprint, signer);
+        return signer;
       }
+    }
+    return nullptr;
+  }
 
-      if (!CertGetNameString(
-        pCertContext,
-        CERT_NAME_SIMPLE_DISPLAY_TYPE,
-        0,
-        NULL,
-        pszName,
-        cbSize))
-      {
-        std::cout << "CertGetNameString failed." << std::endl;
-        result->Error("certificate_error", "CertGetNameString failed.");
+  void DigitalCertificatesPlugin::Touch(const std::string& thumbprint,
+    std::shared_ptr<native_core::CertificateSigner> signer) {
+    auto it = std::find_if(open_certificates_.begin(), open_certificates_.end(),
+      [&](const OpenCertificate& open) { return open.thumbprint == thumbprint; });
+    if (it == open_certificates_.end()) {
+      open_certificates_.insert(open_certificates_.begin(), { thumbprint, std::move(signer) });
+    }
+    else {
+      std::rotate(open_certificates_.begin(), it, it + 1);
+    }
+    // Signatures in progress hold their signer, so closing one here only
+    // drops the cache's reference.
+    for (size_t i = open_certificates_.size(); i > 0 && open_certificates_.size() > kMaxOpenCertificates; i--) {
+      if (open_certificates_[i - 1].signer != signer_) {
+        open_certificates_.erase(open_certificates_.begin() + (i - 1));
       }
+    }
+  }
 
-      std::wostringstream subject_stream;
-      subject_stream << pszName << std::endl;
-
-      std::wstring_convert<std::codecvt_utf8<wchar_t>> conv1;
-      std::string u8str = conv1.to_bytes(subject_stream.str());
-
-      result->Success(flutter::EncodableValue(u8str));
+  void DigitalCertificatesPlugin::Select(std::shared_ptr<native_core::CertificateSigner> signer) {
+    signer_ = std::move(signer);
+    native_core::SetActiveSigner(signer_);
+  }
 
+  std::shared_ptr<native_core::CertificateSigner> DigitalCertificatesPlugin::SignerFor(
+    const Arguments& arguments, flutter::MethodResult<>* result) {
+    const std::string* thumbprint = arguments.Optional<std::string>("thumbprint");
+    if (!arguments.ok()) {
+      result->Error("certificate_error", "La huella del certificado no es válida.");
+      return nullptr;
+    }
+    if (!thumbprint) {
+      if (!signer_) {
+        result->Error("certificate_error", "No se ha seleccionado ningún certificado.");
+      }
+      return signer_;
+    }
+    std::shared_ptr<native_core::CertificateSigner> signer = FindCertificate(*thumbprint);
+    if (!signer) {
+      result->Error("certificate_error", "No se encuentra el certificado.");
     }
-    else if (method_call.method_name().compare("signData") == 0) {
+    return signer;
+  }
 
-      //https://github.com/open-eid/chrome-token-signing/blob/master/host-windows/NativeSigner.cpp
-      //https://github.com/open-eid/libdigidocpp/blob/master/src/crypto/WinSigner.cpp
+  // static
+  const native_core::MethodDispatcher<DigitalCertificatesPlugin>::Table&
+  DigitalCertificatesPlugin::Methods() {
+    using Plugin = DigitalCertificatesPlugin;
+    static constexpr native_core::MethodDispatcher<Plugin>::Table kMethods = {
+      {"selectCertificate", &Plugin::SelectCertificate},
+      {"activateCertificate", &Plugin::ActivateCertificate},
+      {"certificateThumbprint", &Plugin::CertificateThumbprint},
+      {"openCertificates", &Plugin::OpenCertificates},
+      {"closeCertificate", &Plugin::CloseCertificate},
+      {"certificateSubject", &Plugin::CertificateSubject},
+      {"signData", &Plugin::SignData},
+      {"signingStats", &Plugin::SigningStats},
+      {"callStats", &Plugin::CallStats},
+    };
+    return kMethods;
+  }
 
-      std::vector<uint8_t> data;
+  void DigitalCertificatesPlugin::HandleMethodCall(
+    const flutter::MethodCall<>& method_call,
+    std::unique_ptr<flutter::MethodResult<>> result) {
+    dispatcher_.Dispatch(this, method_call, std::move(result));
+  }
 
-      const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-      if (arguments) {
+  void DigitalCertificatesPlugin::SelectCertificate(const Arguments&, Result result) {
 
-        BCRYPT_PKCS1_PADDING_INFO padInfo;
-        padInfo.pszAlgId = NCRYPT_SHA256_ALGORITHM;
-        DWORD obtainKeyStrategy = CRYPT_ACQUIRE_PREFER_NCRYPT_KEY_FLAG;
-        ALG_ID alg_id = CALG_SHA_256;
-        LPCWSTR bcrypt_alg = BCRYPT_SHA256_ALGORITHM;
+    // HELP
+    // https://github.com/garmonbozzzia/XmlSignWebService/blob/master/csp-integral-test/tools/certificate-search.cpp
+    // https://github.com/rbmm/LIB/blob/master/ASIO/ssl.cpp
 
-        auto algorithm_it = arguments->find(flutter::EncodableValue("algorithm"));
-        if (algorithm_it != arguments->end()) {
-          std::string alg = std::get<std::string>(algorithm_it->second);
-          std::transform(alg.begin(), alg.end(), alg.begin(), [](unsigned char c) { return static_cast<unsigned char>(std::tolower(c)); });
-          if (alg.find("sha-1") != std::string::npos || alg.find("sha1") != std::string::npos) {
-            padInfo.pszAlgId = NCRYPT_SHA1_ALGORITHM;
-            alg_id = CALG_SHA1;
-            bcrypt_alg = BCRYPT_SHA1_ALGORITHM;
-          }
-          else if (alg.find("sha-256") != std::string::npos || alg.find("sha256") != std::string::npos) {
-            padInfo.pszAlgId = NCRYPT_SHA256_ALGORITHM;
-            alg_id = CALG_SHA_256;
-            bcrypt_alg = BCRYPT_SHA256_ALGORITHM;
-          }
-          else if (alg.find("sha-384") != std::string::npos || alg.find("sha384") != std::string::npos) {
-            padInfo.pszAlgId = NCRYPT_SHA384_ALGORITHM;
-            alg_id = CALG_SHA_384;
-            bcrypt_alg = BCRYPT_SHA384_ALGORITHM;
-          }
-          else {
-            padInfo.pszAlgId = NCRYPT_SHA512_ALGORITHM;
-            alg_id = CALG_SHA_512;
-            bcrypt_alg = BCRYPT_SHA512_ALGORITHM;
-          }
-        }
+    CertStore& store = cert_store_.Get();
+    HCERTSTORE hCertStore = store.handle;
+    if (!hCertStore) {
+      result->Error("certificate_error", "No se ha podido abrir el almacén de certificados.");
+      return;
+    }
+    std::unique_lock<std::mutex> store_lock(store.mutex);
+    // The store stays open between selections; pick up certificates added
+    // or removed since (e.g. a smart card inserted).
+    CertControlStore(hCertStore, 0, CERT_STORE_CTRL_RESYNC, NULL);
+    // The dialog runs its own message loop, in which other platform messages
+    // reach FindCertificate() on this same thread: it gets a reference of
+    // its own, and the lock is not held across it.
+    HCERTSTORE dialog_store = CertDuplicateStore(hCertStore);
+    store_lock.unlock();
+    HWND owner = window_ ? GetAncestor(window_, GA_ROOT) : NULL;
+    PCCERT_CONTEXT pCertContext = CryptUIDlgSelectCertificateFromStore(dialog_store, owner, NULL, NULL,
+      CRYPTUI_SELECT_LOCATION_COLUMN, 0, NULL);
+    CertCloseStore(dialog_store, 0);
+    if (!pCertContext) {
+      result->Error("certificate_error", "Error al seleccionar el certificado");
+      return;
+    }
 
-        auto data_it = arguments->find(flutter::EncodableValue("data"));
-        if (data_it != arguments->end()) {
+    // Muestra en una ventana la información del certificado seleccionado.
+    // CryptUIDlgViewContext(CERT_STORE_CERTIFICATE_CONTEXT, pCertContext, NULL, NULL, 0, NULL);
 
-          data = std::get<std::vector<uint8_t>>(data_it->second);
+    // A certificate selected before keeps its signer, and the key it holds.
+    std::string thumbprint = Thumbprint(pCertContext);
+    std::shared_ptr<native_core::CertificateSigner> signer = OpenSigner(thumbprint);
+    if (!signer) {
+      signer = std::make_shared<native_core::CertificateSigner>(pCertContext, window_);
+      Touch(thumbprint, signer);
+    }
+    CertFreeCertificateContext(pCertContext);
+    Select(signer);
 
-          std::vector<unsigned char> signature;
+    std::string certificate = CertificateBase64(signer->certificate());
+    if (certificate.empty()) {
+      result->Error("certificate_error", "Error obteniendo el certificado.");
+      return;
+    }
+    result->Success(flutter::EncodableValue(certificate));
+  }
 
-          DWORD flags = obtainKeyStrategy | CRYPT_ACQUIRE_COMPARE_KEY_FLAG;
-          DWORD spec = 0;
-          BOOL freeKeyHandle = false;
-          HCRYPTPROV_OR_NCRYPT_KEY_HANDLE* handle = new HCRYPTPROV_OR_NCRYPT_KEY_HANDLE(0);
-          BOOL gotKey = CryptAcquireCertificatePrivateKey(pCertContext, flags, 0, handle, &spec, &freeKeyHandle);
-          if (!gotKey) {
-            std::cout << "Error getting key context." << std::endl;
-            result->Error("signing_error", "Error getting key context.");
-            return;
-          }
+  void DigitalCertificatesPlugin::ActivateCertificate(const Arguments& arguments, Result result) {
+    const std::string& thumbprint = arguments.Get<std::string>("thumbprint");
+    if (!arguments.ok()) {
+      result->Error("certificate_error", "Falta la huella del certificado.");
+      return;
+    }
+    std::shared_ptr<native_core::CertificateSigner> signer = FindCertificate(thumbprint);
+    if (!signer) {
+      result->Error("certificate_error", "No se encuentra el certificado.");
+      return;
+    }
+    Select(signer);
+    std::string certificate = CertificateBase64(signer->certificate());
+    if (certificate.empty()) {
+      result->Error("certificate_error", "Error obteniendo el certificado.");
+      return;
+    }
+    result->Success(flutter::EncodableValue(certificate));
+  }
 
-          auto deleter = [=](HCRYPTPROV_OR_NCRYPT_KEY_HANDLE* key) {
-            if (!freeKeyHandle)
-              return;
-            if (spec == CERT_NCRYPT_KEY_SPEC)
-              NCryptFreeObject(*key);
-            else
-              CryptReleaseContext(*key, 0);
-          };
-          std::unique_ptr<HCRYPTPROV_OR_NCRYPT_KEY_HANDLE, decltype(deleter)> key(handle, deleter);
-
-          switch (spec)
-          {
-          case CERT_NCRYPT_KEY_SPEC:
-          {
-            // Calculate the hash
-            // https://docs.microsoft.com/en-us/windows/win32/seccng/creating-a-hash-with-cng
-
-            // Hash variables
-            BCRYPT_ALG_HANDLE       hAlg = NULL;
-            BCRYPT_HASH_HANDLE      hHash = NULL;
-            NTSTATUS                status = STATUS_UNSUCCESSFUL;
-            DWORD                   cbData = 0,
-              cbHash = 0,
-              cbHashObject = 0;
-            PBYTE                   pbHashObject = NULL;
-            PBYTE                   pbHash = NULL;
-
-            //open an algorithm handle
-            if (!NT_SUCCESS(status = BCryptOpenAlgorithmProvider(
-              &hAlg,
-              bcrypt_alg,
-              NULL,
-              0))) {
-              std::cout << "Error in BCryptOpenAlgorithmProvider: " << status << std::endl;
-              result->Error("signing_error", "Error in BCryptOpenAlgorithmProvider.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //calculate the size of the buffer to hold the hash object
-            if (!NT_SUCCESS(status = BCryptGetProperty(
-              hAlg,
-              BCRYPT_OBJECT_LENGTH,
-              (PBYTE)&cbHashObject,
-              sizeof(DWORD),
-              &cbData,
-              0))) {
-              std::cout << "Error in BCryptGetProperty: " << status << std::endl;
-              result->Error("signing_error", "Error in BCryptOpenAlgorithmProvider.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //allocate the hash object on the heap
-            pbHashObject = (PBYTE)HeapAlloc(GetProcessHeap(), 0, cbHashObject);
-            if (NULL == pbHashObject) {
-              std::cout << "memory allocation failed" << std::endl;
-              result->Error("signing_error", "memory allocation failed.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //calculate the length of the hash
-            if (!NT_SUCCESS(status = BCryptGetProperty(
-              hAlg,
-              BCRYPT_HASH_LENGTH,
-              (PBYTE)&cbHash,
-              sizeof(DWORD),
-              &cbData,
-              0))) {
-              std::cout << "Error in BCryptGetProperty: " << status << std::endl;
-              result->Error("signing_error", "Error in BCryptOpenAlgorithmProvider.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //allocate the hash buffer on the heap
-            pbHash = (PBYTE)HeapAlloc(GetProcessHeap(), 0, cbHash);
-            if (NULL == pbHash) {
-              std::cout << "memory allocation failed" << std::endl;
-              result->Error("signing_error", "memory allocation failed.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //create a hash
-            if (!NT_SUCCESS(status = BCryptCreateHash(
-              hAlg,
-              &hHash,
-              pbHashObject,
-              cbHashObject,
-              NULL,
-              0,
-              0))) {
-              std::cout << "Error in BCryptCreateHash: " << status << std::endl;
-              result->Error("signing_error", "Error in BCryptOpenAlgorithmProvider.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //hash some data
-            if (!NT_SUCCESS(status = BCryptHashData(
-              hHash,
-              (PBYTE)data.data(),
-              (ULONG)data.size(),
-              0))) {
-              std::cout << "Error in BCryptHashData: " << status << std::endl;
-              result->Error("signing_error", "Error in BCryptOpenAlgorithmProvider.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            //close the hash
-            if (!NT_SUCCESS(status = BCryptFinishHash(
-              hHash,
-              pbHash,
-              cbHash,
-              0))) {
-              std::cout << "Error in BCryptFinishHash: " << status << std::endl;
-              result->Error("signing_error", "Error in BCryptOpenAlgorithmProvider.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            // Sign the obtained hash
-
-            DWORD size = 0;
-            std::wstring algo(5, 0);
-            if (!NT_SUCCESS(status = NCryptGetProperty(*key.get(), NCRYPT_ALGORITHM_GROUP_PROPERTY,
-              PBYTE(algo.data()), DWORD((algo.size() + 1) * 2), &size, 0))) {
-              std::cout << "Error in NCryptGetProperty with NCRYPT_ALGORITHM_GROUP_PROPERTY: " << status << std::endl;
-              result->Error("signing_error", "Error in NCryptGetProperty with NCRYPT_ALGORITHM_GROUP_PROPERTY.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            algo.resize(size / 2 - 1);
-            bool isRSA = algo == L"RSA";
-
-            if (!NT_SUCCESS(status = NCryptSignHash(*key.get(), isRSA ? &padInfo : nullptr, pbHash, cbHash,
-              nullptr, 0, LPDWORD(&size), BCRYPT_PAD_PKCS1))) {
-              std::cout << "Error getting size in NCryptSignHash: " << status << std::endl;
-              result->Error("signing_error", "Error getting size in NCryptSignHash.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            signature.resize(size);
-            if (!NT_SUCCESS(status = NCryptSignHash(*key.get(), isRSA ? &padInfo : nullptr, pbHash, cbHash,
-              signature.data(), DWORD(signature.size()), LPDWORD(&size), BCRYPT_PAD_PKCS1))) {
-              std::cout << "Error in NCryptSignHash: " << status << std::endl;
-              result->Error("signing_error", "Error in NCryptSignHash.");
-              CleanBCryptHashObjects(hAlg, hHash, pbHashObject, pbHash);
-              return;
-            }
-
-            break;
-          }
-          case AT_KEYEXCHANGE:
-          case AT_SIGNATURE:
-          {
-            std::cout << "AT_SIGNATURE" << std::endl;
-
-            HCRYPTHASH hash = 0;
-            if (!CryptCreateHash(*key.get(), alg_id, 0, 0, &hash)) {
-              std::cout << "CryptCreateHash failed." << std::endl;
-              result->Error("signing_error", "CryptCreateHash failed.");
-              return;
-            }
-
-            BYTE* pbMessage = (BYTE*)(data.data());  // Message to be signed
-            DWORD cbMessage = (WORD)(data.size());  // Size of the message
-
-            if (!CryptHashData(hash, pbMessage, cbMessage, 0)) {
-              CryptDestroyHash(hash);
-              std::cout << "Error during CryptHashData." << std::endl;
-              result->Error("signing_error", "Error during CryptHashData.");
-              return;
-            }
-
-            DWORD size = 0;
-            if (!CryptSignHashW(hash, spec, nullptr, 0, nullptr, &size)) {
-              CryptDestroyHash(hash);
-              std::cout << "Error getting size in CryptSignHashW." << std::endl;
-              result->Error("signing_error", "Error getting size in CryptSignHashW.");
-              return;
-            }
-
-            signature.resize(size);
-            if (!CryptSignHashW(hash, spec, nullptr, 0, LPBYTE(signature.data()), &size)) {
-              CryptDestroyHash(hash);
-              std::cout << "Error in CryptSignHashW." << std::endl;
-              result->Error("signing_error", "Error in CryptSignHashW.");
-              return;
-            }
-
-            CryptDestroyHash(hash);
-            reverse(signature.begin(), signature.end());
-            break;
-          }
-          default:
-          {
-            std::cout << "Incompatible key." << std::endl;
-            result->Error("signing_error", "Incompatible key.");
-            return;
-          }
-          }
+  void DigitalCertificatesPlugin::CertificateThumbprint(const Arguments& arguments, Result result) {
+    std::shared_ptr<native_core::CertificateSigner> signer = SignerFor(arguments, result.get());
+    if (signer) {
+      result->Success(flutter::EncodableValue(Thumbprint(signer->certificate())));
+    }
+  }
 
-          result->Success(flutter::EncodableValue(signature));
-        }
-      }
+  void DigitalCertificatesPlugin::OpenCertificates(const Arguments&, Result result) {
+    flutter::EncodableList thumbprints;
+    for (const OpenCertificate& open : open_certificates_) {
+      thumbprints.emplace_back(open.thumbprint);
     }
-    else {
-      result->NotImplemented();
+    result->Success(flutter::EncodableValue(std::move(thumbprints)));
+  }
+
+  void DigitalCertificatesPlugin::CloseCertificate(const Arguments& arguments, Result result) {
+    std::shared_ptr<native_core::CertificateSigner> signer = SignerFor(arguments, result.get());
+    if (!signer) {
+      return;
+    }
+    open_certificates_.erase(std::remove_if(open_certificates_.begin(), open_certificates_.end(),
+      [&](const OpenCertificate& open) { return open.signer == signer; }),
+      open_certificates_.end());
+    if (signer == signer_) {
+      Select(nullptr);
     }
+    result->Success();
   }
 
-  void DigitalCertificatesPlugin::CleanUp() {
-    // Clean up and free memory as needed.
-    if (pCertContext) {
-      CertFreeCertificateContext(pCertContext);
+  void DigitalCertificatesPlugin::CertificateSubject(const Arguments& arguments, Result result) {
+    std::shared_ptr<native_core::CertificateSigner> signer = SignerFor(arguments, result.get());
+    if (!signer) {
+      return;
     }
-    if (hCertStore) {
-      CertCloseStore(hCertStore, CERT_CLOSE_STORE_CHECK_FLAG);
-      hCertStore = NULL;
+    std::string subject = Subject(signer->certificate());
+    if (subject.empty()) {
+      result->Error("certificate_error", "CertGetNameString failed.");
+      return;
     }
+    result->Success(flutter::EncodableValue(subject));
   }
 
-  void DigitalCertificatesPlugin::CleanBCryptHashObjects(BCRYPT_ALG_HANDLE hAlg, BCRYPT_HASH_HANDLE hHash, PBYTE pbHashObject, PBYTE pbHash) {
-    if (hAlg) {
-      BCryptCloseAlgorithmProvider(hAlg, 0);
+  void DigitalCertificatesPlugin::SignData(const Arguments& arguments, Result result) {
+    // Signed in place, without copying the data.
+    const auto& data = arguments.Get<std::vector<uint8_t>>("data");
+    // SHA-256 unless told otherwise.
+    const std::string* algorithm = arguments.Optional<std::string>("algorithm");
+    if (!arguments.ok()) {
+      result->Error("signing_error", "Argumentos de la firma no válidos.");
+      return;
     }
-    if (hHash) {
-      BCryptDestroyHash(hHash);
+
+    std::shared_ptr<native_core::CertificateSigner> signer = SignerFor(arguments, result.get());
+    if (!signer) {
+      return;
     }
-    if (pbHashObject) {
-      HeapFree(GetProcessHeap(), 0, pbHashObject);
+
+    std::vector<uint8_t> signature;
+    std::string error;
+    if (!signer->Sign(algorithm ? *algorithm : "SHA256withRSA", data.data(), data.size(),
+      &signature, &error)) {
+      result->Error("signing_error", error);
+      return;
     }
-    if (pbHash) {
-      HeapFree(GetProcessHeap(), 0, pbHash);
+
+    result->Success(flutter::EncodableValue(std::move(signature)));
+  }
+
+  void DigitalCertificatesPlugin::SigningStats(const Arguments&, Result result) {
+    native_core::SecureArenaStats stats = native_core::GetSecureArenaStats();
+    auto count = [](uint64_t value) {
+      return flutter::EncodableValue(static_cast<int64_t>(value));
+    };
+    result->Success(flutter::EncodableValue(flutter::EncodableMap{
+      {flutter::EncodableValue("signatures"), count(stats.arenas)},
+      {flutter::EncodableValue("allocations"), count(stats.allocations)},
+      {flutter::EncodableValue("largeAllocations"), count(stats.large_allocations)},
+      {flutter::EncodableValue("blocks"), count(stats.blocks)},
+      {flutter::EncodableValue("blocksInUse"), count(stats.blocks_in_use)},
+      {flutter::EncodableValue("lockedBytes"), count(stats.locked_bytes)},
+    }));
+  }
+
+  void DigitalCertificatesPlugin::CallStats(const Arguments&, Result result) {
+    result->Success(dispatcher_.Stats());
+  }
+
+  void DigitalCertificatesPlugin::CleanUp() {
+    // Clean up and free memory as needed.
+    // The store itself is kept open for the next selection.
+    if (signer_) {
+      Select(nullptr);
     }
+    open_certificates_.clear();
   }
+
 }  // namespace
 
 void DigitalCertificatesPluginRegisterWithRegistrar(
@@ -512,6 +672,11 @@ void DigitalCertificatesPluginRegisterWithRegistrar(
   // remain valid for the life of the application.
   static auto* plugin_registrar = new flutter::PluginRegistrar(registrar);
 
-  DigitalCertificatesPlugin::RegisterWithRegistrar(plugin_registrar);
+  // The view is created before the plugins are registered, and only later
+  // placed in the runner's window, so the top-level window is looked up when
+  // a dialog is shown.
+  FlutterDesktopViewRef view = FlutterDesktopPluginRegistrarGetView(registrar);
+  HWND window = view ? FlutterDesktopViewGetHWND(view) : NULL;
+  DigitalCertificatesPlugin::RegisterWithRegistrar(plugin_registrar, window);
 }
 
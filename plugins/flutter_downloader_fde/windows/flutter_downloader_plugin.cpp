@@ -19,6 +19,10 @@
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar.h>
 #include <flutter/standard_method_codec.h>
+#include <native_core/method_dispatch.h>
+#include <native_core/pdf_renderer.h>
+#include <native_core/runtime.h>
+#include <native_core/thumbnail_cache.h>
 #include <memory>
 #include <sstream>
 #include <codecvt>
@@ -28,27 +32,70 @@ namespace {
   using flutter::EncodableMap;
   using flutter::EncodableValue;
 
+  // Longest side of the thumbnails, in pixels.
+  constexpr int64_t kMinThumbnailSize = 16;
+  constexpr int64_t kMaxThumbnailSize = 1024;
+
   class FlutterDownloaderPlugin : public flutter::Plugin {
 
   public:
     static void RegisterWithRegistrar(flutter::PluginRegistrar* registrar);
 
-    // Creates a plugin that communicates on the given channel.
+    // Creates a plugin that communicates on the given channels.
     FlutterDownloaderPlugin(
-      std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel);
+      std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel,
+      std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> thumbnail_channel);
 
 
     virtual ~FlutterDownloaderPlugin();
 
   private:
+    using Arguments = native_core::MethodArguments;
+    using Result = std::unique_ptr<flutter::MethodResult<>>;
+    using Dispatcher = native_core::MethodDispatcher<FlutterDownloaderPlugin>;
+
+    // The methods of each channel and their handlers.
+    static const Dispatcher::Table& Methods();
+    static const Dispatcher::Table& ThumbnailMethods();
+
+    // The task methods of the flutter_downloader API. Files are downloaded by
+    // the Dart side on Windows, so there are no tasks and they just succeed.
+    void Succeed(const Arguments& arguments, Result result);
+
+    // Opens the file with its associated application. The API passes a task
+    // id, which on Windows is the path of the file.
+    void Open(const Arguments& arguments, Result result);
+
+    // Opens the thumbnail cache in the "directory" argument and answers
+    // whether this build can render PDFs at all.
+    void ThumbnailOpen(const Arguments& arguments, Result result);
+
+    // Answers the PNG thumbnail of the first page of the PDF at "path", its
+    // longer side "size" pixels, or null if it cannot be rendered. Runs on
+    // the shared pool.
+    void Thumbnail(const Arguments& arguments, Result result);
 
-    // Called when a method is called on plugin channel;
-    void HandleMethodCall(
-      const flutter::MethodCall<EncodableValue>& method_call,
-      std::unique_ptr<flutter::MethodResult<EncodableValue>> result);
+    // Answers the hits, renders and sizes of the thumbnail cache.
+    void ThumbnailStats(const Arguments& arguments, Result result);
 
-    // The MethodChannel used for communication with the Flutter engine.
+    // Answers the call statistics of each channel's dispatcher.
+    void CallStats(const Arguments& arguments, Result result);
+    void ThumbnailCallStats(const Arguments& arguments, Result result);
+
+    // Opens |path| with its associated application. Safe to call from any thread.
+    static void OpenFile(const std::wstring& path);
+
+    // The MethodChannels used for communication with the Flutter engine.
     std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> thumbnail_channel_;
+
+    // Route the calls on each channel to the handlers of its table.
+    Dispatcher dispatcher_{ "vn.hunghd/downloader", &Methods() };
+    Dispatcher thumbnail_dispatcher_{ "portafirmas/thumbnails", &ThumbnailMethods() };
+
+    // The thumbnails rendered so far, once "open" has been called. Shared with
+    // the renders in progress.
+    std::shared_ptr<native_core::ThumbnailCache> thumbnails_;
   };
 
   // static
@@ -56,66 +103,168 @@ namespace {
 
     auto channel = std::make_unique<flutter::MethodChannel<EncodableValue>>(
       registrar->messenger(), "vn.hunghd/downloader", &flutter::StandardMethodCodec::GetInstance());
+    auto thumbnail_channel = std::make_unique<flutter::MethodChannel<EncodableValue>>(
+      registrar->messenger(), "portafirmas/thumbnails", &flutter::StandardMethodCodec::GetInstance());
 
     auto* channel_pointer = channel.get();
+    auto* thumbnail_channel_pointer = thumbnail_channel.get();
 
-    auto plugin = std::make_unique<FlutterDownloaderPlugin>(std::move(channel));
+    auto plugin = std::make_unique<FlutterDownloaderPlugin>(
+      std::move(channel), std::move(thumbnail_channel));
 
     channel_pointer->SetMethodCallHandler(
       [plugin_pointer = plugin.get()](const auto& call, auto result) {
-      plugin_pointer->HandleMethodCall(call, std::move(result));
+      plugin_pointer->dispatcher_.Dispatch(plugin_pointer, call, std::move(result));
+    });
+    thumbnail_channel_pointer->SetMethodCallHandler(
+      [plugin_pointer = plugin.get()](const auto& call, auto result) {
+      plugin_pointer->thumbnail_dispatcher_.Dispatch(plugin_pointer, call, std::move(result));
     });
 
     registrar->AddPlugin(std::move(plugin));
   }
 
   FlutterDownloaderPlugin::FlutterDownloaderPlugin(
-    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel)
-    : channel_(std::move(channel)) {}
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel,
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> thumbnail_channel)
+    : channel_(std::move(channel)), thumbnail_channel_(std::move(thumbnail_channel)) {}
 
   FlutterDownloaderPlugin::~FlutterDownloaderPlugin() {}
 
-  void FlutterDownloaderPlugin::HandleMethodCall(
-    const flutter::MethodCall<EncodableValue>& method_call,
-    std::unique_ptr<flutter::MethodResult<EncodableValue>> result) {
+  // static
+  const FlutterDownloaderPlugin::Dispatcher::Table& FlutterDownloaderPlugin::Methods() {
+    using Plugin = FlutterDownloaderPlugin;
+    static constexpr Dispatcher::Table kMethods = {
+      {"initialize", &Plugin::Succeed},
+      {"registerCallback", &Plugin::Succeed},
+      {"enqueue", &Plugin::Succeed},
+      {"remove", &Plugin::Succeed},
+      {"open", &Plugin::Open},
+      {"callStats", &Plugin::CallStats},
+    };
+    return kMethods;
+  }
+
+  // static
+  const FlutterDownloaderPlugin::Dispatcher::Table& FlutterDownloaderPlugin::ThumbnailMethods() {
+    using Plugin = FlutterDownloaderPlugin;
+    static constexpr Dispatcher::Table kMethods = {
+      {"open", &Plugin::ThumbnailOpen},
+      {"thumbnail", &Plugin::Thumbnail},
+      {"stats", &Plugin::ThumbnailStats},
+      {"callStats", &Plugin::ThumbnailCallStats},
+    };
+    return kMethods;
+  }
+
+  void FlutterDownloaderPlugin::Succeed(const Arguments&, Result result) {
+    result->Success();
+  }
 
-    if (method_call.method_name().compare("initialize") == 0) {
+  void FlutterDownloaderPlugin::Open(const Arguments& arguments, Result result) {
+    // The Flutter_Downloader plugin uses "taskId" to find the task and its corresponding file
+    // In windows, I have not implemented the task architecture so I will use the "TaskId" coming form the
+    // channel as the file path or full filename
+    const std::string* u8Path = arguments.Optional<std::string>("task_id");
+    if (!u8Path) {
       result->Success();
+      return;
     }
-    else if (method_call.method_name().compare("registerCallback") == 0) {
-      result->Success();
+
+    // utf8 to wide
+    std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv1;
+    std::wstring wPath = conv1.from_bytes(*u8Path);
+
+    // ShellExecute may take seconds while the associated viewer starts, so it runs
+    // on the shared worker pool and the result is answered back on the platform thread.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    bool posted = native_core::Runtime::Get().RunAsync(
+      [wPath]() { OpenFile(wPath); },
+      [shared_result](bool) { shared_result->Success(); });
+    if (!posted) {
+      OpenFile(wPath);
+      shared_result->Success();
     }
-    else if (method_call.method_name().compare("enqueue") == 0) {
-      result->Success();
+  }
+
+  void FlutterDownloaderPlugin::ThumbnailOpen(const Arguments& arguments, Result result) {
+    const std::string& directory = arguments.Get<std::string>("directory");
+    if (!arguments.ok()) {
+      result->Error("thumbnail_error", "Falta el directorio de las miniaturas.");
+      return;
     }
-    else if (method_call.method_name().compare("remove") == 0) {
+    native_core::ThumbnailCacheOptions options;
+    options.directory = directory;
+    thumbnails_ = std::make_shared<native_core::ThumbnailCache>(std::move(options));
+    result->Success(EncodableValue(native_core::CanRenderPdf()));
+  }
+
+  void FlutterDownloaderPlugin::Thumbnail(const Arguments& arguments, Result result) {
+    std::string path = arguments.Get<std::string>("path");
+    int64_t size = arguments.Integer("size");
+    if (!arguments.ok() || size < kMinThumbnailSize || size > kMaxThumbnailSize) {
+      result->Error("thumbnail_error", "Argumentos de la miniatura no válidos.");
+      return;
+    }
+    if (!thumbnails_) {
       result->Success();
+      return;
     }
-    else if (method_call.method_name().compare("open") == 0) {
-
-      const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-      if (arguments) {
+    // Hashing and rendering take tens of milliseconds per document, so they
+    // always run on the shared pool: when it is saturated there is no
+    // thumbnail rather than a stall of the platform thread.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    std::shared_ptr<native_core::ThumbnailCache> thumbnails = thumbnails_;
+    auto png = std::make_shared<native_core::ThumbnailCache::Png>();
+    auto work = [thumbnails, path, size, png]() {
+      std::string error;
+      *png = thumbnails->Get(path, static_cast<int>(size), &error);
+    };
+    auto done = [png, shared_result](bool) {
+      if (*png) {
+        shared_result->Success(EncodableValue(**png));
+      }
+      else {
+        shared_result->Success();
+      }
+    };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      shared_result->Success();
+    }
+  }
 
-        // The Flutter_Downloader plugin uses "taskId" to find the task and its corresponding file
-        // In windows, I have not implemented the task architecture so I will use the "TaskId" coming form the
-        // channel as the file path or full filename
-        auto path_it = arguments->find(flutter::EncodableValue("task_id"));
+  void FlutterDownloaderPlugin::ThumbnailStats(const Arguments&, Result result) {
+    if (!thumbnails_) {
+      result->Success(EncodableValue(EncodableMap()));
+      return;
+    }
+    native_core::ThumbnailCacheStats stats = thumbnails_->stats();
+    auto count = [](uint64_t value) { return EncodableValue(static_cast<int64_t>(value)); };
+    result->Success(EncodableValue(EncodableMap{
+      {EncodableValue("memoryHits"), count(stats.memory_hits)},
+      {EncodableValue("diskHits"), count(stats.disk_hits)},
+      {EncodableValue("renders"), count(stats.renders)},
+      {EncodableValue("failures"), count(stats.failures)},
+      {EncodableValue("memoryBytes"), count(stats.memory_bytes)},
+      {EncodableValue("diskBytes"), count(stats.disk_bytes)},
+    }));
+  }
 
-        if (path_it != arguments->end()) {
-          // path comes as a utf8 string
-          std::string u8Path = std::get<std::string>(path_it->second);
+  void FlutterDownloaderPlugin::CallStats(const Arguments&, Result result) {
+    result->Success(dispatcher_.Stats());
+  }
 
-          // utf8 to wide
-          std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv1;
-          std::wstring wPath = conv1.from_bytes(u8Path);
+  void FlutterDownloaderPlugin::ThumbnailCallStats(const Arguments&, Result result) {
+    result->Success(thumbnail_dispatcher_.Stats());
+  }
 
-          ShellExecute(0, 0, wPath.c_str(), 0, 0, SW_SHOWNORMAL);
-        }
-      }
-      result->Success();
-    }
-    else {
-      result->NotImplemented();
+  // static
+  void FlutterDownloaderPlugin::OpenFile(const std::wstring& path) {
+    // ShellExecute may delegate to shell extensions that need COM on the calling thread.
+    HRESULT com_result = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+    ShellExecute(0, 0, path.c_str(), 0, 0, SW_SHOWNORMAL);
+    if (SUCCEEDED(com_result)) {
+      CoUninitialize();
     }
   }
 
@@ -127,5 +276,9 @@ void FlutterDownloaderPluginRegisterWithRegistrar(
   // remain valid for the life of the application.
   static auto* plugin_registrar = new flutter::PluginRegistrar(registrar);
 
+  // Registration runs on the platform thread, which is where the shared runtime
+  // must be created.
+  native_core::Runtime::Get();
+
   FlutterDownloaderPlugin::RegisterWithRegistrar(plugin_registrar);
 }
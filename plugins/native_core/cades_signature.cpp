@@ -0,0 +1,370 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/cades_signature.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <initializer_list>
+#include <utility>
+
+#include "include/native_core/digest.h"
+
+namespace native_core {
+
+namespace {
+
+using Der = std::vector<uint8_t>;
+
+// ASN.1 tags.
+constexpr uint8_t kInteger = 0x02;
+constexpr uint8_t kOctetString = 0x04;
+constexpr uint8_t kObjectIdentifier = 0x06;
+constexpr uint8_t kUtcTime = 0x17;
+constexpr uint8_t kGeneralizedTime = 0x18;
+constexpr uint8_t kSequence = 0x30;
+constexpr uint8_t kSet = 0x31;
+constexpr uint8_t kContext0 = 0xa0;
+constexpr uint8_t kContext4 = 0xa4;
+
+// Object identifiers, as the contents of their DER encoding.
+const Der kSignedDataOid = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x07, 0x02};
+const Der kDataOid = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x07, 0x01};
+const Der kContentTypeOid = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x09, 0x03};
+const Der kMessageDigestOid = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x09, 0x04};
+const Der kSigningTimeOid = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x09, 0x05};
+const Der kSigningCertificateV2Oid = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d,
+                                      0x01, 0x09, 0x10, 0x02, 0x2f};
+
+struct AlgorithmOids {
+  Der digest;
+  Der signature;
+  // Name for Pkcs1Signer::Sign().
+  const char* name;
+};
+
+AlgorithmOids OidsFor(DigestAlgorithm digest) {
+  const Der rsa = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01};
+  const Der sha2 = {0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02};
+  auto with = [](Der prefix, uint8_t last) {
+    prefix.push_back(last);
+    return prefix;
+  };
+  switch (digest) {
+    case DigestAlgorithm::kSha1:
+      return {{0x2b, 0x0e, 0x03, 0x02, 0x1a}, with(rsa, 0x05), "SHA1withRSA"};
+    case DigestAlgorithm::kSha256:
+      return {with(sha2, 0x01), with(rsa, 0x0b), "SHA256withRSA"};
+    case DigestAlgorithm::kSha384:
+      return {with(sha2, 0x02), with(rsa, 0x0c), "SHA384withRSA"};
+    case DigestAlgorithm::kSha512:
+      break;
+  }
+  return {with(sha2, 0x03), with(rsa, 0x0d), "SHA512withRSA"};
+}
+
+// Appends a tag, the DER length of |size| and nothing else.
+void AppendHeader(Der* out, uint8_t tag, size_t size) {
+  out->push_back(tag);
+  if (size < 0x80) {
+    out->push_back(static_cast<uint8_t>(size));
+    return;
+  }
+  uint8_t bytes[sizeof(size_t)];
+  int count = 0;
+  for (size_t value = size; value > 0; value >>= 8) {
+    bytes[count++] = static_cast<uint8_t>(value);
+  }
+  out->push_back(static_cast<uint8_t>(0x80 | count));
+  while (count > 0) {
+    out->push_back(bytes[--count]);
+  }
+}
+
+Der Tlv(uint8_t tag, const uint8_t* contents, size_t size) {
+  Der out;
+  out.reserve(size + 6);
+  AppendHeader(&out, tag, size);
+  out.insert(out.end(), contents, contents + size);
+  return out;
+}
+
+Der Tlv(uint8_t tag, const Der& contents) {
+  return Tlv(tag, contents.data(), contents.size());
+}
+
+// A constructed value holding |parts| in order.
+Der Tlv(uint8_t tag, std::initializer_list<const Der*> parts) {
+  size_t size = 0;
+  for (const Der* part : parts) {
+    size += part->size();
+  }
+  Der out;
+  out.reserve(size + 6);
+  AppendHeader(&out, tag, size);
+  for (const Der* part : parts) {
+    out.insert(out.end(), part->begin(), part->end());
+  }
+  return out;
+}
+
+// A DER SET OF: its elements sorted by their encodings (X.690, 11.6).
+Der SetOf(std::vector<Der> elements) {
+  std::sort(elements.begin(), elements.end());
+  Der contents;
+  for (const Der& element : elements) {
+    contents.insert(contents.end(), element.begin(), element.end());
+  }
+  return Tlv(kSet, contents);
+}
+
+// AlgorithmIdentifier with absent parameters, as RFC 5754 asks for digests.
+Der DigestAlgorithmIdentifier(const Der& oid) {
+  Der encoded_oid = Tlv(kObjectIdentifier, oid);
+  return Tlv(kSequence, {&encoded_oid});
+}
+
+// AlgorithmIdentifier with NULL parameters, as RFC 4055 asks for PKCS#1 v1.5.
+Der SignatureAlgorithmIdentifier(const Der& oid) {
+  Der encoded_oid = Tlv(kObjectIdentifier, oid);
+  const Der null = {0x05, 0x00};
+  return Tlv(kSequence, {&encoded_oid, &null});
+}
+
+Der Attribute(const Der& oid, const Der& value) {
+  Der encoded_oid = Tlv(kObjectIdentifier, oid);
+  Der values = Tlv(kSet, value);
+  return Tlv(kSequence, {&encoded_oid, &values});
+}
+
+// UTCTime up to 2049 and GeneralizedTime from then on (RFC 5280, 4.1.2.5).
+Der Time(std::chrono::system_clock::time_point time) {
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  std::tm utc{};
+#ifdef _WIN32
+  gmtime_s(&utc, &seconds);
+#else
+  gmtime_r(&seconds, &utc);
+#endif
+  int year = utc.tm_year + 1900;
+  bool utc_time = year >= 1950 && year < 2050;
+  char text[32];
+  int size = std::snprintf(text, sizeof(text), "%0*d%02d%02d%02d%02d%02dZ",
+                           utc_time ? 2 : 4, utc_time ? year % 100 : year,
+                           utc.tm_mon + 1, utc.tm_mday, utc.tm_hour,
+                           utc.tm_min, utc.tm_sec);
+  return Tlv(utc_time ? kUtcTime : kGeneralizedTime,
+             reinterpret_cast<const uint8_t*>(text), static_cast<size_t>(size));
+}
+
+// A DER value within a buffer: [begin, end) is its whole encoding and
+// [contents, end) what follows its length.
+struct DerValue {
+  uint8_t tag = 0;
+  const uint8_t* begin = nullptr;
+  const uint8_t* contents = nullptr;
+  const uint8_t* end = nullptr;
+
+  Der Encoding() const { return Der(begin, end); }
+};
+
+// Reads the value at |*position|, before |end|, and moves past it.
+bool ReadValue(const uint8_t** position, const uint8_t* end, DerValue* value) {
+  const uint8_t* p = *position;
+  if (end - p < 2) {
+    return false;
+  }
+  value->begin = p;
+  value->tag = *p++;
+  size_t size = *p++;
+  if (size & 0x80) {
+    size_t count = size & 0x7f;
+    if (count == 0 || count > 4 || static_cast<size_t>(end - p) < count) {
+      return false;
+    }
+    size = 0;
+    while (count-- > 0) {
+      size = (size << 8) | *p++;
+    }
+  }
+  if (static_cast<size_t>(end - p) < size) {
+    return false;
+  }
+  value->contents = p;
+  value->end = p + size;
+  *position = value->end;
+  return true;
+}
+
+// The issuer and serial number of a DER X.509 certificate (RFC 5280, 4.1).
+bool ReadIssuerAndSerial(const std::vector<uint8_t>& certificate,
+                         Der* issuer,
+                         Der* serial) {
+  const uint8_t* position = certificate.data();
+  const uint8_t* end = position + certificate.size();
+  DerValue value;
+  if (!ReadValue(&position, end, &value) || value.tag != kSequence) {
+    return false;
+  }
+  position = value.contents;
+  end = value.end;
+  DerValue tbs;
+  if (!ReadValue(&position, end, &tbs) || tbs.tag != kSequence) {
+    return false;
+  }
+  position = tbs.contents;
+  DerValue field;
+  // version [0] EXPLICIT, absent for v1.
+  if (!ReadValue(&position, tbs.end, &field)) {
+    return false;
+  }
+  if (field.tag == kContext0 && !ReadValue(&position, tbs.end, &field)) {
+    return false;
+  }
+  if (field.tag != kInteger) {
+    return false;
+  }
+  *serial = field.Encoding();
+  DerValue algorithm;
+  if (!ReadValue(&position, tbs.end, &algorithm) ||
+      !ReadValue(&position, tbs.end, &field) || field.tag != kSequence) {
+    return false;
+  }
+  *issuer = field.Encoding();
+  return true;
+}
+
+// Builds the SignedData for content whose hash is |content_digest|,
+// carrying |content| when it is not null.
+bool BuildSignedData(Pkcs1Signer* signer,
+                     const std::vector<uint8_t>& certificate,
+                     const Der& content_digest,
+                     const uint8_t* content,
+                     size_t size,
+                     const CadesOptions& options,
+                     std::vector<uint8_t>* signature,
+                     std::string* error) {
+  Der issuer;
+  Der serial;
+  if (!ReadIssuerAndSerial(certificate, &issuer, &serial)) {
+    *error = "The signing certificate cannot be read.";
+    return false;
+  }
+  AlgorithmOids oids = OidsFor(options.digest);
+  Der digest_algorithm = DigestAlgorithmIdentifier(oids.digest);
+  Der data_oid = Tlv(kObjectIdentifier, kDataOid);
+
+  // Signed attributes (RFC 5652, 11; ETSI EN 319 122-1, 5.2).
+  Der message_digest = Tlv(kOctetString, content_digest);
+  Der certificate_hash = Tlv(
+      kOctetString,
+      Digest(options.digest, certificate.data(), certificate.size()));
+  // ESSCertIDv2: the hash algorithm is left out when it is the default,
+  // SHA-256; the issuer goes as a directoryName of GeneralNames.
+  Der directory_name = Tlv(kContext4, issuer);
+  Der general_names = Tlv(kSequence, {&directory_name});
+  Der issuer_serial = Tlv(kSequence, {&general_names, &serial});
+  const Der no_algorithm;
+  Der cert_id = Tlv(kSequence,
+                    {options.digest == DigestAlgorithm::kSha256
+                         ? &no_algorithm
+                         : &digest_algorithm,
+                     &certificate_hash, &issuer_serial});
+  Der cert_ids = Tlv(kSequence, {&cert_id});
+  Der signing_certificate = Tlv(kSequence, {&cert_ids});
+  std::vector<Der> attributes = {
+      Attribute(kContentTypeOid, data_oid),
+      Attribute(kMessageDigestOid, message_digest),
+      Attribute(kSigningCertificateV2Oid, signing_certificate),
+  };
+  if (options.signing_time_attribute) {
+    attributes.push_back(
+        Attribute(kSigningTimeOid, Time(options.signing_time.value_or(
+                                       std::chrono::system_clock::now()))));
+  }
+  Der signed_attributes = SetOf(std::move(attributes));
+
+  // What is signed is the attributes encoded as a SET; they are stored
+  // with the [0] IMPLICIT tag instead.
+  Der signature_value;
+  if (!signer->Sign(oids.name, signed_attributes.data(),
+                    signed_attributes.size(), &signature_value, error)) {
+    return false;
+  }
+  signed_attributes[0] = kContext0;
+
+  const Der version = {kInteger, 0x01, 0x01};
+  Der signer_id = Tlv(kSequence, {&issuer, &serial});
+  Der signature_algorithm = SignatureAlgorithmIdentifier(oids.signature);
+  Der encrypted_digest = Tlv(kOctetString, signature_value);
+  Der signer_info = Tlv(kSequence, {&version, &signer_id, &digest_algorithm,
+                                    &signed_attributes, &signature_algorithm,
+                                    &encrypted_digest});
+  Der signer_infos = Tlv(kSet, signer_info);
+
+  Der digest_algorithms = Tlv(kSet, digest_algorithm);
+  Der encapsulated;
+  if (content != nullptr) {
+    Der octets = Tlv(kOctetString, content, size);
+    Der explicit_content = Tlv(kContext0, octets);
+    encapsulated = Tlv(kSequence, {&data_oid, &explicit_content});
+  }
+  else {
+    encapsulated = Tlv(kSequence, {&data_oid});
+  }
+  Der certificates = Tlv(kContext0, certificate);
+  Der signed_data = Tlv(kSequence, {&version, &digest_algorithms, &encapsulated,
+                                    &certificates, &signer_infos});
+
+  Der signed_data_oid = Tlv(kObjectIdentifier, kSignedDataOid);
+  Der explicit_signed_data = Tlv(kContext0, signed_data);
+  *signature = Tlv(kSequence, {&signed_data_oid, &explicit_signed_data});
+  return true;
+}
+
+}  // namespace
+
+bool BuildCadesSignature(Pkcs1Signer* signer,
+                         const std::vector<uint8_t>& certificate,
+                         const uint8_t* content,
+                         size_t size,
+                         const CadesOptions& options,
+                         std::vector<uint8_t>* signature,
+                         std::string* error) {
+  // Empty content may come without an address, and is carried all the same.
+  static const uint8_t kNoContent = 0;
+  const uint8_t* carried = nullptr;
+  if (options.attached) {
+    carried = content ? content : &kNoContent;
+  }
+  return BuildSignedData(signer, certificate,
+                         Digest(options.digest, content, size), carried, size,
+                         options, signature, error);
+}
+
+bool BuildDetachedCadesSignature(Pkcs1Signer* signer,
+                                 const std::vector<uint8_t>& certificate,
+                                 const std::vector<uint8_t>& content_digest,
+                                 const CadesOptions& options,
+                                 std::vector<uint8_t>* signature,
+                                 std::string* error) {
+  if (content_digest.size() != Digester::SizeOf(options.digest)) {
+    *error = "The content digest does not match the digest algorithm.";
+    return false;
+  }
+  return BuildSignedData(signer, certificate, content_digest, nullptr, 0,
+                         options, signature, error);
+}
+
+}  // namespace native_core
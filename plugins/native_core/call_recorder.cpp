@@ -0,0 +1,357 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/call_recorder.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace native_core {
+
+namespace {
+
+constexpr uint8_t kNameRecord = 1;
+constexpr uint8_t kBeginRecord = 2;
+constexpr uint8_t kReturnRecord = 3;
+constexpr uint8_t kEndRecord = 4;
+
+// Buffered records are written once there are this many bytes, or once the
+// oldest is this old.
+constexpr size_t kWriteThreshold = 64 * 1024;
+constexpr std::chrono::seconds kWriteInterval{1};
+
+// Opens a file by its UTF-8 path.
+std::FILE* OpenFile(const std::string& path, const char* mode) {
+  std::filesystem::path file_path = std::filesystem::u8path(path);
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, file_path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                                     : nullptr;
+#else
+  return std::fopen(file_path.c_str(), mode);
+#endif
+}
+
+// The value of the environment |variable| as UTF-8, empty if unset.
+std::string Environment(const char* variable) {
+#ifdef _WIN32
+  std::wstring name(variable, variable + std::strlen(variable));
+  DWORD length = GetEnvironmentVariableW(name.c_str(), nullptr, 0);
+  if (length == 0) {
+    return std::string();
+  }
+  std::wstring value(length, L'\0');
+  length = GetEnvironmentVariableW(name.c_str(), value.data(), length);
+  value.resize(length);
+  return std::filesystem::path(value).u8string();
+#else
+  const char* value = std::getenv(variable);
+  return value ? std::string(value) : std::string();
+#endif
+}
+
+void AppendVarint(std::string* buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  buffer->push_back(static_cast<char>(value));
+}
+
+void AppendBytes(std::string* buffer, const void* data, size_t size) {
+  AppendVarint(buffer, size);
+  buffer->append(static_cast<const char*>(data), size);
+}
+
+// Reads the records of a trace, stopping quietly at a torn one.
+class TraceReader {
+ public:
+  explicit TraceReader(std::string_view data) : data_(data) {}
+
+  bool at_end() const { return position_ == data_.size(); }
+
+  bool Byte(uint8_t* value) {
+    if (position_ >= data_.size()) {
+      return false;
+    }
+    *value = static_cast<uint8_t>(data_[position_++]);
+    return true;
+  }
+
+  bool Varint(uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte;
+      if (!Byte(&byte)) {
+        return false;
+      }
+      *value |= uint64_t{byte & 0x7Fu} << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Bytes(std::string_view* value) {
+    uint64_t size;
+    if (!Varint(&size) || size > data_.size() - position_) {
+      return false;
+    }
+    *value = data_.substr(position_, static_cast<size_t>(size));
+    position_ += static_cast<size_t>(size);
+    return true;
+  }
+
+ private:
+  std::string_view data_;
+  size_t position_ = 0;
+};
+
+}  // namespace
+
+// static
+CallRecorder* CallRecorder::Get() {
+  // Intentionally leaked, like the other process-wide state; what is still
+  // buffered is written when the process exits.
+  static CallRecorder* recorder = []() -> CallRecorder* {
+    std::string path = Environment("PORTAFIRMAS_CALL_TRACE");
+    if (path.empty()) {
+      return nullptr;
+    }
+    CallRecorder* opened =
+        Open(path, Environment("PORTAFIRMAS_CALL_TRACE_PAYLOADS") == "1")
+            .release();
+    if (opened) {
+      std::atexit([]() { Get()->Flush(); });
+    }
+    return opened;
+  }();
+  return recorder;
+}
+
+// static
+std::unique_ptr<CallRecorder> CallRecorder::Open(const std::string& path,
+                                                 bool payloads) {
+  std::FILE* file = OpenFile(path, "wb");
+  if (!file) {
+    return nullptr;
+  }
+  if (std::fwrite(kMagic, 1, sizeof(kMagic), file) != sizeof(kMagic) ||
+      std::fflush(file) != 0) {
+    std::fclose(file);
+    return nullptr;
+  }
+  return std::unique_ptr<CallRecorder>(new CallRecorder(file, payloads));
+}
+
+CallRecorder::CallRecorder(std::FILE* file, bool payloads)
+    : file_(file),
+      payloads_(payloads),
+      last_time_(Clock::now()),
+      last_write_(last_time_) {}
+
+CallRecorder::~CallRecorder() {
+  Flush();
+  std::fclose(file_);
+}
+
+uint64_t CallRecorder::Begin(const std::string& channel,
+                             const std::string& method,
+                             size_t argument_size,
+                             const std::vector<uint8_t>* payload) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [name, added] =
+      names_.try_emplace(std::make_pair(channel, method), names_.size());
+  if (added) {
+    buffer_.push_back(static_cast<char>(kNameRecord));
+    AppendBytes(&buffer_, channel.data(), channel.size());
+    AppendBytes(&buffer_, method.data(), method.size());
+  }
+  StartRecord(kBeginRecord);
+  AppendVarint(&buffer_, name->second);
+  AppendVarint(&buffer_, argument_size);
+  bool kept = payloads_ && payload;
+  buffer_.push_back(static_cast<char>(kept));
+  if (kept) {
+    AppendBytes(&buffer_, payload->data(), payload->size());
+  }
+  MaybeWrite();
+  return next_call_++;
+}
+
+void CallRecorder::Return(uint64_t call) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StartRecord(kReturnRecord);
+  AppendVarint(&buffer_, call);
+  MaybeWrite();
+}
+
+void CallRecorder::End(uint64_t call, CallOutcome outcome, size_t result_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StartRecord(kEndRecord);
+  AppendVarint(&buffer_, call);
+  buffer_.push_back(static_cast<char>(outcome));
+  AppendVarint(&buffer_, result_size);
+  MaybeWrite();
+}
+
+void CallRecorder::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Write();
+}
+
+void CallRecorder::StartRecord(uint8_t kind) {
+  // Taken under the lock, so times follow the order of the records.
+  Clock::time_point now = Clock::now();
+  buffer_.push_back(static_cast<char>(kind));
+  AppendVarint(&buffer_,
+               static_cast<uint64_t>(
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       now - last_time_)
+                       .count()));
+  last_time_ = now;
+}
+
+void CallRecorder::MaybeWrite() {
+  if (buffer_.size() >= kWriteThreshold ||
+      last_time_ - last_write_ >= kWriteInterval) {
+    Write();
+  }
+}
+
+void CallRecorder::Write() {
+  if (!buffer_.empty()) {
+    std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    std::fflush(file_);
+    buffer_.clear();
+  }
+  last_write_ = last_time_;
+}
+
+bool ReadCallTrace(const std::string& path,
+                   std::vector<TracedCall>* calls,
+                   std::string* error) {
+  calls->clear();
+  std::FILE* file = OpenFile(path, "rb");
+  if (!file) {
+    *error = "No se puede abrir la traza " + path;
+    return false;
+  }
+  std::string data;
+  char chunk[64 * 1024];
+  size_t read;
+  while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    data.append(chunk, read);
+  }
+  bool read_ok = !std::ferror(file);
+  std::fclose(file);
+  if (!read_ok) {
+    *error = "No se puede leer la traza " + path;
+    return false;
+  }
+  if (data.size() < sizeof(CallRecorder::kMagic) ||
+      std::memcmp(data.data(), CallRecorder::kMagic,
+                  sizeof(CallRecorder::kMagic)) != 0) {
+    *error = path + " no es una traza de llamadas";
+    return false;
+  }
+
+  TraceReader reader(std::string_view(data).substr(sizeof(CallRecorder::kMagic)));
+  std::vector<std::pair<std::string, std::string>> names;
+  std::vector<TracedCall> read_calls;
+  std::chrono::nanoseconds time{0};
+  // Each record is only kept once it has been read whole.
+  while (!reader.at_end()) {
+    uint8_t kind;
+    reader.Byte(&kind);
+    if (kind == kNameRecord) {
+      std::string_view channel;
+      std::string_view method;
+      if (!reader.Bytes(&channel) || !reader.Bytes(&method)) {
+        break;
+      }
+      names.emplace_back(channel, method);
+      continue;
+    }
+    uint64_t delta;
+    if (!reader.Varint(&delta)) {
+      break;
+    }
+    std::chrono::nanoseconds record_time =
+        time + std::chrono::nanoseconds(delta);
+    if (kind == kBeginRecord) {
+      uint64_t name;
+      uint64_t argument_size;
+      uint8_t has_payload;
+      std::string_view payload;
+      if (!reader.Varint(&name) || !reader.Varint(&argument_size) ||
+          !reader.Byte(&has_payload) ||
+          (has_payload && !reader.Bytes(&payload))) {
+        break;
+      }
+      if (name >= names.size()) {
+        *error = path + " está dañada";
+        return false;
+      }
+      TracedCall call;
+      call.channel = names[name].first;
+      call.method = names[name].second;
+      call.begin = record_time;
+      call.argument_size = argument_size;
+      if (has_payload) {
+        call.payload.emplace(payload.begin(), payload.end());
+      }
+      read_calls.push_back(std::move(call));
+    }
+    else if (kind == kReturnRecord || kind == kEndRecord) {
+      uint64_t index;
+      uint8_t outcome = 0;
+      uint64_t result_size = 0;
+      if (!reader.Varint(&index) ||
+          (kind == kEndRecord &&
+           (!reader.Byte(&outcome) || !reader.Varint(&result_size)))) {
+        break;
+      }
+      if (index >= read_calls.size()) {
+        *error = path + " está dañada";
+        return false;
+      }
+      TracedCall& call = read_calls[index];
+      if (kind == kReturnRecord) {
+        call.returned = record_time;
+      }
+      else {
+        call.answered = record_time;
+        call.outcome = static_cast<CallOutcome>(outcome);
+        call.result_size = result_size;
+      }
+    }
+    else {
+      *error = path + " está dañada";
+      return false;
+    }
+    time = record_time;
+  }
+  *calls = std::move(read_calls);
+  return true;
+}
+
+}  // namespace native_core
@@ -0,0 +1,75 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/call_tracker.h"
+
+namespace native_core {
+
+// static
+CallTracker& CallTracker::Get() {
+  static CallTracker* tracker = new CallTracker();
+  return *tracker;
+}
+
+void CallTracker::Begin(const std::string& channel, const std::string& method) {
+  if (depth_++ == 0) {
+    Store(channel, method);
+    active_.store(true, std::memory_order_release);
+  }
+}
+
+void CallTracker::End() {
+  if (depth_ > 0 && --depth_ == 0) {
+    active_.store(false, std::memory_order_release);
+  }
+}
+
+bool CallTracker::Snapshot(std::string* name) const {
+  for (;;) {
+    uint32_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    bool active = active_.load(std::memory_order_acquire);
+    size_t length = length_.load(std::memory_order_relaxed);
+    name->resize(length);
+    for (size_t i = 0; i < length; i++) {
+      (*name)[i] = name_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == before) {
+      return active;
+    }
+  }
+}
+
+void CallTracker::Store(const std::string& channel, const std::string& method) {
+  sequence_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  size_t length = 0;
+  auto append = [this, &length](const std::string& part) {
+    for (char c : part) {
+      if (length == kMaxNameLength) {
+        return;
+      }
+      name_[length++].store(c, std::memory_order_relaxed);
+    }
+  };
+  append(channel);
+  append("/");
+  append(method);
+  length_.store(length, std::memory_order_relaxed);
+  sequence_.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace native_core
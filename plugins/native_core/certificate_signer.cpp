@@ -0,0 +1,345 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/certificate_signer.h"
+
+#include <bcrypt.h>
+#include <ncrypt.h>
+
+#include <array>
+#include <cwchar>
+#include <iterator>
+#include <string>
+
+#include "include/native_core/secure_arena.h"
+
+#pragma comment(lib, "crypt32.lib")
+#pragma comment(lib, "bcrypt.lib")
+#pragma comment(lib, "ncrypt.lib")
+
+namespace native_core {
+
+namespace {
+
+// https://github.com/open-eid/chrome-token-signing/blob/master/host-windows/NativeSigner.cpp
+// https://github.com/open-eid/libdigidocpp/blob/master/src/crypto/WinSigner.cpp
+
+struct DigestNames {
+  LPCWSTR bcrypt_algorithm;
+  LPCWSTR ncrypt_algorithm;
+  ALG_ID capi_algorithm;
+};
+
+DigestNames NamesFor(DigestAlgorithm digest) {
+  switch (digest) {
+    case DigestAlgorithm::kSha1:
+      return {BCRYPT_SHA1_ALGORITHM, NCRYPT_SHA1_ALGORITHM, CALG_SHA1};
+    case DigestAlgorithm::kSha256:
+      return {BCRYPT_SHA256_ALGORITHM, NCRYPT_SHA256_ALGORITHM, CALG_SHA_256};
+    case DigestAlgorithm::kSha384:
+      return {BCRYPT_SHA384_ALGORITHM, NCRYPT_SHA384_ALGORITHM, CALG_SHA_384};
+    case DigestAlgorithm::kSha512:
+      break;
+  }
+  return {BCRYPT_SHA512_ALGORITHM, NCRYPT_SHA512_ALGORITHM, CALG_SHA_512};
+}
+
+// Largest signature a key may produce: RSA with a 16384-bit key.
+constexpr DWORD kMaxSignatureSize = 2048;
+
+// The CNG provider of |digest|, opened once for the life of the process:
+// opening one costs more than hashing what is signed, and a provider may be
+// used by several threads at once. Null if it could not be opened.
+BCRYPT_ALG_HANDLE HashProvider(DigestAlgorithm digest) {
+  static const std::array<BCRYPT_ALG_HANDLE, 4> providers = [] {
+    std::array<BCRYPT_ALG_HANDLE, 4> opened{};
+    for (size_t i = 0; i < opened.size(); i++) {
+      LPCWSTR algorithm =
+          NamesFor(static_cast<DigestAlgorithm>(i)).bcrypt_algorithm;
+      if (!BCRYPT_SUCCESS(
+              BCryptOpenAlgorithmProvider(&opened[i], algorithm, NULL, 0))) {
+        opened[i] = NULL;
+      }
+    }
+    return opened;
+  }();
+  return providers[static_cast<size_t>(digest)];
+}
+
+// Digest computed with CNG, with the hash state and the digest in |arena|.
+bool HashWithCng(DigestAlgorithm digest,
+                 const uint8_t* data,
+                 size_t size,
+                 SecureArena* arena,
+                 uint8_t** hash,
+                 DWORD* hash_size,
+                 std::string* error) {
+  BCRYPT_ALG_HANDLE provider = HashProvider(digest);
+  if (!provider) {
+    *error = "Error in BCryptOpenAlgorithmProvider.";
+    return false;
+  }
+  DWORD object_size = 0;
+  DWORD written = 0;
+  if (!BCRYPT_SUCCESS(BCryptGetProperty(
+          provider, BCRYPT_OBJECT_LENGTH, reinterpret_cast<PUCHAR>(&object_size),
+          sizeof(DWORD), &written, 0)) ||
+      !BCRYPT_SUCCESS(BCryptGetProperty(
+          provider, BCRYPT_HASH_LENGTH, reinterpret_cast<PUCHAR>(hash_size),
+          sizeof(DWORD), &written, 0))) {
+    *error = "Error in BCryptGetProperty.";
+    return false;
+  }
+  uint8_t* hash_object = arena->Allocate(object_size);
+  *hash = arena->Allocate(*hash_size);
+  if (!hash_object || !*hash) {
+    *error = "Out of memory.";
+    return false;
+  }
+  BCRYPT_HASH_HANDLE hash_handle = NULL;
+  bool ok = false;
+  if (!BCRYPT_SUCCESS(BCryptCreateHash(provider, &hash_handle, hash_object,
+                                       object_size, NULL, 0, 0))) {
+    *error = "Error in BCryptCreateHash.";
+  }
+  else if (!BCRYPT_SUCCESS(BCryptHashData(
+               hash_handle, const_cast<PUCHAR>(data),
+               static_cast<ULONG>(size), 0))) {
+    *error = "Error in BCryptHashData.";
+  }
+  else if (!BCRYPT_SUCCESS(
+               BCryptFinishHash(hash_handle, *hash, *hash_size, 0))) {
+    *error = "Error in BCryptFinishHash.";
+  }
+  else {
+    ok = true;
+  }
+  if (hash_handle) {
+    BCryptDestroyHash(hash_handle);
+  }
+  return ok;
+}
+
+bool SignWithCng(NCRYPT_KEY_HANDLE key,
+                 bool rsa,
+                 DigestAlgorithm digest,
+                 const uint8_t* data,
+                 size_t size,
+                 SecureArena* arena,
+                 std::vector<uint8_t>* signature,
+                 std::string* error) {
+  uint8_t* hash = nullptr;
+  DWORD hash_size = 0;
+  if (!HashWithCng(digest, data, size, arena, &hash, &hash_size, error)) {
+    return false;
+  }
+  uint8_t* buffer = arena->Allocate(kMaxSignatureSize);
+  if (!buffer) {
+    *error = "Out of memory.";
+    return false;
+  }
+
+  BCRYPT_PKCS1_PADDING_INFO padding = {NamesFor(digest).ncrypt_algorithm};
+  void* padding_info = rsa ? &padding : nullptr;
+  DWORD length = 0;
+  if (NCryptSignHash(key, padding_info, hash, hash_size, buffer,
+                     kMaxSignatureSize, &length,
+                     BCRYPT_PAD_PKCS1) != ERROR_SUCCESS) {
+    *error = "Error in NCryptSignHash.";
+    return false;
+  }
+  signature->assign(buffer, buffer + length);
+  return true;
+}
+
+bool SignWithCryptoApi(HCRYPTPROV provider,
+                       DWORD spec,
+                       DigestAlgorithm digest,
+                       const uint8_t* data,
+                       size_t size,
+                       SecureArena* arena,
+                       std::vector<uint8_t>* signature,
+                       std::string* error) {
+  uint8_t* buffer = arena->Allocate(kMaxSignatureSize);
+  if (!buffer) {
+    *error = "Out of memory.";
+    return false;
+  }
+  HCRYPTHASH hash = 0;
+  if (!CryptCreateHash(provider, NamesFor(digest).capi_algorithm, 0, 0,
+                       &hash)) {
+    *error = "CryptCreateHash failed.";
+    return false;
+  }
+  bool ok = false;
+  DWORD length = kMaxSignatureSize;
+  if (!CryptHashData(hash, data, static_cast<DWORD>(size), 0)) {
+    *error = "Error during CryptHashData.";
+  }
+  else if (!CryptSignHashW(hash, spec, nullptr, 0, buffer, &length)) {
+    *error = "Error in CryptSignHashW.";
+  }
+  else {
+    // CryptoAPI returns the signature little-endian; it is reversed as it is
+    // copied out, so that it is never rearranged outside the arena.
+    signature->assign(std::reverse_iterator<uint8_t*>(buffer + length),
+                      std::reverse_iterator<uint8_t*>(buffer));
+    ok = true;
+  }
+  CryptDestroyHash(hash);
+  return ok;
+}
+
+}  // namespace
+
+// Releases the key handle from CryptAcquireCertificatePrivateKey().
+struct CertificateSigner::Key {
+  Key() = default;
+
+  ~Key() {
+    if (!handle || !must_free) {
+      return;
+    }
+    if (spec == CERT_NCRYPT_KEY_SPEC) {
+      NCryptFreeObject(handle);
+    }
+    else {
+      CryptReleaseContext(handle, 0);
+    }
+  }
+
+  // Prevent copying.
+  Key(Key const&) = delete;
+  Key& operator=(Key const&) = delete;
+
+  HCRYPTPROV_OR_NCRYPT_KEY_HANDLE handle = 0;
+  DWORD spec = 0;
+  BOOL must_free = FALSE;
+  // Whether a CNG key is RSA, which takes PKCS#1 padding information.
+  bool rsa = false;
+  // Whether it was acquired with CRYPT_ACQUIRE_SILENT_FLAG.
+  bool silent = false;
+};
+
+CertificateSigner::CertificateSigner(PCCERT_CONTEXT certificate, HWND window)
+    : certificate_(CertDuplicateCertificateContext(certificate)),
+      window_(window) {}
+
+CertificateSigner::~CertificateSigner() {
+  CertFreeCertificateContext(certificate_);
+}
+
+bool CertificateSigner::Sign(std::string_view algorithm,
+                             const uint8_t* data,
+                             size_t size,
+                             std::vector<uint8_t>* signature,
+                             std::string* error) {
+  DigestAlgorithm digest = DigestAlgorithmFor(algorithm);
+  // A key acquired silently ahead of time may refuse to sign when its
+  // provider needs a PIN (CryptoAPI contexts stay silent), so such a key gets
+  // a second attempt with one acquired the usual way.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    std::shared_ptr<Key> key = AcquireKey(0, error);
+    if (!key) {
+      return false;
+    }
+
+    // The hash state, the digest and the signature are kept in locked memory,
+    // cleared when the signature is done.
+    SecureArena arena;
+    bool ok = false;
+    switch (key->spec) {
+      case CERT_NCRYPT_KEY_SPEC:
+        ok = SignWithCng(key->handle, key->rsa, digest, data, size, &arena,
+                         signature, error);
+        break;
+      case AT_KEYEXCHANGE:
+      case AT_SIGNATURE:
+        ok = SignWithCryptoApi(key->handle, key->spec, digest, data, size,
+                               &arena, signature, error);
+        break;
+      default:
+        *error = "Incompatible key.";
+        break;
+    }
+    if (ok) {
+      return true;
+    }
+    {
+      std::lock_guard<std::mutex> lock(key_mutex_);
+      if (key_ == key) {
+        key_.reset();
+      }
+    }
+    if (!key->silent) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool CertificateSigner::AcquireKeySilently() {
+  std::string error;
+  return AcquireKey(CRYPT_ACQUIRE_SILENT_FLAG, &error) != nullptr;
+}
+
+std::shared_ptr<CertificateSigner::Key> CertificateSigner::AcquireKey(
+    DWORD flags, std::string* error) {
+  // Held while acquiring, so that a PIN is only asked for once when several
+  // signatures start together.
+  std::lock_guard<std::mutex> lock(key_mutex_);
+  if (key_) {
+    return key_;
+  }
+  auto key = std::make_shared<Key>();
+  bool silent = (flags & CRYPT_ACQUIRE_SILENT_FLAG) != 0;
+  // Looked up on every acquisition: the window may have been reparented
+  // since the signer was created. The provider sets it as PP_CLIENT_HWND or
+  // NCRYPT_WINDOW_HANDLE_PROPERTY of the key.
+  HWND owner = window_ && !silent ? GetAncestor(window_, GA_ROOT) : NULL;
+  if (owner) {
+    flags |= CRYPT_ACQUIRE_WINDOW_HANDLE_FLAG;
+  }
+  if (!CryptAcquireCertificatePrivateKey(
+          certificate_,
+          CRYPT_ACQUIRE_PREFER_NCRYPT_KEY_FLAG | CRYPT_ACQUIRE_COMPARE_KEY_FLAG |
+              flags,
+          owner ? &owner : NULL, &key->handle, &key->spec, &key->must_free)) {
+    *error = "Error getting key context.";
+    return nullptr;
+  }
+  // Asked once per key rather than per signature.
+  if (key->spec == CERT_NCRYPT_KEY_SPEC) {
+    wchar_t group[16] = {};
+    DWORD length = 0;
+    if (NCryptGetProperty(key->handle, NCRYPT_ALGORITHM_GROUP_PROPERTY,
+                          reinterpret_cast<PBYTE>(group), sizeof(group),
+                          &length, 0) != ERROR_SUCCESS) {
+      *error =
+          "Error in NCryptGetProperty with NCRYPT_ALGORITHM_GROUP_PROPERTY.";
+      return nullptr;
+    }
+    key->rsa = wcscmp(group, L"RSA") == 0;
+  }
+  key->silent = silent;
+  key_ = key;
+  return key;
+}
+
+std::vector<uint8_t> CertificateSigner::Certificate() const {
+  return std::vector<uint8_t>(
+      certificate_->pbCertEncoded,
+      certificate_->pbCertEncoded + certificate_->cbCertEncoded);
+}
+
+}  // namespace native_core
@@ -0,0 +1,363 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/content_coding.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#ifdef NATIVE_CORE_HAS_ZLIB
+#include <zlib.h>
+#endif
+#ifdef NATIVE_CORE_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace native_core {
+
+namespace {
+
+// Decoded output is handed to the sink in chunks of at most this size, which
+// matches what the HTTP backends read at a time.
+constexpr size_t kOutputSize = 64 * 1024;
+
+std::string_view Trim(std::string_view value) {
+  while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+    value.remove_prefix(1);
+  }
+  while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+    value.remove_suffix(1);
+  }
+  return value;
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+    return std::tolower(static_cast<unsigned char>(x)) ==
+           std::tolower(static_cast<unsigned char>(y));
+  });
+}
+
+#ifdef NATIVE_CORE_HAS_ZLIB
+
+// gzip, and deflate both with the zlib wrapper RFC 9110 asks for and without
+// it, as some servers send.
+class ZlibDecoder : public ContentDecoder {
+ public:
+  ZlibDecoder(ContentCoding coding, Sink sink)
+      : gzip_(coding == ContentCoding::kGzip),
+        sink_(std::move(sink)),
+        output_(kOutputSize) {}
+
+  ~ZlibDecoder() override {
+    if (initialized_) {
+      inflateEnd(&stream_);
+    }
+  }
+
+  bool Feed(const char* data, size_t size) override {
+    if (failed_) {
+      return false;
+    }
+    if (initialized_) {
+      return Inflate(data, size);
+    }
+    // Raw deflate is told apart by the first two bytes, which may come in
+    // separate chunks.
+    pending_.append(data, size);
+    if (!gzip_ && pending_.size() < 2) {
+      return true;
+    }
+    return Start();
+  }
+
+  bool Finish() override {
+    if (failed_) {
+      return false;
+    }
+    if (!initialized_) {
+      if (pending_.empty()) {
+        // An empty body.
+        return true;
+      }
+      if (!Start()) {
+        return false;
+      }
+    }
+    if (!ended_) {
+      return Fail("Truncated compressed body.");
+    }
+    return true;
+  }
+
+ private:
+  bool Start() {
+    int window_bits = 15 + 16;
+    if (!gzip_) {
+      unsigned char cmf = static_cast<unsigned char>(pending_[0]);
+      unsigned char flg =
+          pending_.size() > 1 ? static_cast<unsigned char>(pending_[1]) : 0;
+      bool zlib_header = (cmf & 0x0f) == 8 && (cmf * 256 + flg) % 31 == 0;
+      window_bits = zlib_header ? 15 : -15;
+    }
+    if (inflateInit2(&stream_, window_bits) != Z_OK) {
+      return Fail("inflateInit2 failed.");
+    }
+    initialized_ = true;
+    std::string first = std::move(pending_);
+    return Inflate(first.data(), first.size());
+  }
+
+  bool Inflate(const char* data, size_t size) {
+    while (size > 0) {
+      uInt step = static_cast<uInt>(
+          std::min<size_t>(size, std::numeric_limits<uInt>::max()));
+      stream_.next_in =
+          reinterpret_cast<Bytef*>(const_cast<char*>(data));
+      stream_.avail_in = step;
+      do {
+        if (ended_ && stream_.avail_in > 0) {
+          // gzip bodies may hold several members one after the other.
+          if (!gzip_) {
+            return Fail("Data after the end of the deflate stream.");
+          }
+          inflateReset(&stream_);
+          ended_ = false;
+        }
+        stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+        stream_.avail_out = static_cast<uInt>(output_.size());
+        int result = inflate(&stream_, Z_NO_FLUSH);
+        size_t produced = output_.size() - stream_.avail_out;
+        if (produced > 0) {
+          sink_(output_.data(), produced);
+        }
+        if (result == Z_STREAM_END) {
+          ended_ = true;
+        }
+        else if (result == Z_BUF_ERROR) {
+          // Needs more input.
+          break;
+        }
+        else if (result != Z_OK) {
+          return Fail(stream_.msg ? stream_.msg : "Corrupt compressed body.");
+        }
+      } while (stream_.avail_in > 0 || stream_.avail_out == 0);
+      data += step;
+      size -= step;
+    }
+    return true;
+  }
+
+  bool Fail(const char* message) {
+    failed_ = true;
+    error_ = message;
+    return false;
+  }
+
+  const bool gzip_;
+  Sink sink_;
+  std::vector<char> output_;
+  std::string pending_;
+  z_stream stream_ = {};
+  bool initialized_ = false;
+  bool ended_ = false;
+  bool failed_ = false;
+};
+
+#endif  // NATIVE_CORE_HAS_ZLIB
+
+#ifdef NATIVE_CORE_HAS_ZSTD
+
+class ZstdDecoder : public ContentDecoder {
+ public:
+  explicit ZstdDecoder(Sink sink)
+      : sink_(std::move(sink)),
+        output_(kOutputSize),
+        context_(ZSTD_createDCtx()) {}
+
+  ~ZstdDecoder() override { ZSTD_freeDCtx(context_); }
+
+  bool Feed(const char* data, size_t size) override {
+    if (failed_) {
+      return false;
+    }
+    if (!context_) {
+      return Fail("ZSTD_createDCtx failed.");
+    }
+    ZSTD_inBuffer input = {data, size, 0};
+    bool output_full = false;
+    while (input.pos < input.size || output_full) {
+      ZSTD_outBuffer output = {output_.data(), output_.size(), 0};
+      size_t result = ZSTD_decompressStream(context_, &output, &input);
+      if (ZSTD_isError(result)) {
+        return Fail(ZSTD_getErrorName(result));
+      }
+      if (output.pos > 0) {
+        sink_(output_.data(), output.pos);
+      }
+      output_full = output.pos == output.size;
+      // Zero once a frame is complete and flushed.
+      remaining_ = result;
+    }
+    return true;
+  }
+
+  bool Finish() override {
+    if (failed_) {
+      return false;
+    }
+    if (remaining_ != 0) {
+      return Fail("Truncated compressed body.");
+    }
+    return true;
+  }
+
+ private:
+  bool Fail(const char* message) {
+    failed_ = true;
+    error_ = message;
+    return false;
+  }
+
+  Sink sink_;
+  std::vector<char> output_;
+  ZSTD_DCtx* context_;
+  size_t remaining_ = 0;
+  bool failed_ = false;
+};
+
+#endif  // NATIVE_CORE_HAS_ZSTD
+
+}  // namespace
+
+ContentCoding ContentCodingFor(std::string_view value) {
+  value = Trim(value);
+  if (value.empty() || EqualsIgnoreCase(value, "identity")) {
+    return ContentCoding::kIdentity;
+  }
+  if (EqualsIgnoreCase(value, "gzip") || EqualsIgnoreCase(value, "x-gzip")) {
+    return ContentCoding::kGzip;
+  }
+  if (EqualsIgnoreCase(value, "deflate")) {
+    return ContentCoding::kDeflate;
+  }
+  if (EqualsIgnoreCase(value, "zstd")) {
+    return ContentCoding::kZstd;
+  }
+  return ContentCoding::kUnsupported;
+}
+
+bool CanDecode(ContentCoding coding) {
+  switch (coding) {
+    case ContentCoding::kIdentity:
+      return true;
+    case ContentCoding::kGzip:
+    case ContentCoding::kDeflate:
+#ifdef NATIVE_CORE_HAS_ZLIB
+      return true;
+#else
+      return false;
+#endif
+    case ContentCoding::kZstd:
+#ifdef NATIVE_CORE_HAS_ZSTD
+      return true;
+#else
+      return false;
+#endif
+    case ContentCoding::kUnsupported:
+      break;
+  }
+  return false;
+}
+
+std::string_view AcceptedCodings() {
+#if defined(NATIVE_CORE_HAS_ZLIB) && defined(NATIVE_CORE_HAS_ZSTD)
+  return "gzip, deflate, zstd";
+#elif defined(NATIVE_CORE_HAS_ZLIB)
+  return "gzip, deflate";
+#elif defined(NATIVE_CORE_HAS_ZSTD)
+  return "zstd";
+#else
+  return "";
+#endif
+}
+
+// static
+std::unique_ptr<ContentDecoder> ContentDecoder::Create(
+    ContentCoding coding,
+    [[maybe_unused]] Sink sink) {
+  switch (coding) {
+    case ContentCoding::kGzip:
+    case ContentCoding::kDeflate:
+#ifdef NATIVE_CORE_HAS_ZLIB
+      return std::make_unique<ZlibDecoder>(coding, std::move(sink));
+#else
+      break;
+#endif
+    case ContentCoding::kZstd:
+#ifdef NATIVE_CORE_HAS_ZSTD
+      return std::make_unique<ZstdDecoder>(std::move(sink));
+#else
+      break;
+#endif
+    case ContentCoding::kIdentity:
+    case ContentCoding::kUnsupported:
+      break;
+  }
+  return nullptr;
+}
+
+ContentDecoder::~ContentDecoder() {}
+
+bool GzipCompress([[maybe_unused]] const uint8_t* data,
+                  [[maybe_unused]] size_t size,
+                  [[maybe_unused]] std::vector<uint8_t>* compressed) {
+#ifdef NATIVE_CORE_HAS_ZLIB
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  compressed->clear();
+  int result = Z_OK;
+  while (result == Z_OK) {
+    uInt step = static_cast<uInt>(
+        std::min<size_t>(size, std::numeric_limits<uInt>::max()));
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = step;
+    int flush = step == size ? Z_FINISH : Z_NO_FLUSH;
+    do {
+      size_t written = compressed->size();
+      compressed->resize(written + kOutputSize);
+      stream.next_out = compressed->data() + written;
+      stream.avail_out = static_cast<uInt>(kOutputSize);
+      result = deflate(&stream, flush);
+      compressed->resize(written + kOutputSize - stream.avail_out);
+    } while (stream.avail_out == 0 && result == Z_OK);
+    data += step;
+    size -= step;
+    if (flush == Z_FINISH) {
+      break;
+    }
+  }
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+#else
+  return false;
+#endif
+}
+
+}  // namespace native_core
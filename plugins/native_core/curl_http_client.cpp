@@ -0,0 +1,218 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/curl_http_client.h"
+
+#include <curl/curl.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+using ShareLocks = std::array<std::mutex, 8>;
+static_assert(CURL_LOCK_DATA_LAST <= std::tuple_size<ShareLocks>::value,
+              "One lock per curl_lock_data value");
+
+void LockShare(CURL*, curl_lock_data data, curl_lock_access, void* user) {
+  (*static_cast<ShareLocks*>(user))[data].lock();
+}
+
+void UnlockShare(CURL*, curl_lock_data data, void* user) {
+  (*static_cast<ShareLocks*>(user))[data].unlock();
+}
+
+// CURLINFO_SCHEME is uppercase in some libcurl versions.
+bool IsHttps(std::string_view scheme) {
+  constexpr std::string_view kHttps = "https";
+  return std::equal(scheme.begin(), scheme.end(), kHttps.begin(), kHttps.end(),
+                    [](char a, char b) {
+                      return std::tolower(static_cast<unsigned char>(a)) == b;
+                    });
+}
+
+// State of the request being performed, seen by the callbacks.
+struct Transfer {
+  CURL* handle;
+  const HttpClient::Sink* sink;
+  int* status;
+  HttpHeaders* headers;
+  bool tls_resumed = false;
+};
+
+size_t OnHeader(char* buffer, size_t size, size_t count, void* user) {
+  auto* transfer = static_cast<Transfer*>(user);
+  std::string_view line(buffer, size * count);
+  while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+    line.remove_suffix(1);
+  }
+  if (line.compare(0, 5, "HTTP/") == 0) {
+    // Interim responses (100 Continue) and redirects start over.
+    transfer->headers->clear();
+    size_t space = line.find(' ');
+    *transfer->status = space == std::string_view::npos
+        ? 0
+        : std::atoi(std::string(line.substr(space + 1, 3)).c_str());
+    return size * count;
+  }
+  size_t colon = line.find(':');
+  if (colon == std::string_view::npos) {
+    return size * count;
+  }
+  std::string name(line.substr(0, colon));
+  std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  std::string_view value = line.substr(colon + 1);
+  while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+    value.remove_prefix(1);
+  }
+  transfer->headers->emplace_back(std::move(name), std::string(value));
+  return size * count;
+}
+
+size_t OnBody(char* data, size_t size, size_t count, void* user) {
+  (*static_cast<Transfer*>(user)->sink)(data, size * count);
+  return size * count;
+}
+
+// Runs once the connection is ready, before the request is sent; the only
+// point where the TLS state of a new connection can be read.
+int OnConnected(void* user, char*, char*, int, int) {
+  auto* transfer = static_cast<Transfer*>(user);
+  const curl_tlssessioninfo* info = nullptr;
+  if (curl_easy_getinfo(transfer->handle, CURLINFO_TLS_SSL_PTR, &info) ==
+          CURLE_OK &&
+      info && info->backend == CURLSSLBACKEND_OPENSSL && info->internals) {
+    transfer->tls_resumed =
+        SSL_session_reused(static_cast<SSL*>(info->internals)) == 1;
+  }
+  return CURL_PREREQFUNC_OK;
+}
+
+}  // namespace
+
+CurlHttpClient::CurlHttpClient(HttpClientOptions options)
+    : HttpClient(std::move(options)) {
+  static std::once_flag global_init;
+  std::call_once(global_init, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+  CURLSH* share = curl_share_init();
+  curl_share_setopt(share, CURLSHOPT_LOCKFUNC, LockShare);
+  curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, UnlockShare);
+  curl_share_setopt(share, CURLSHOPT_USERDATA, &share_locks_);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  share_ = share;
+}
+
+CurlHttpClient::~CurlHttpClient() {
+  for (void* handle : idle_handles_) {
+    curl_easy_cleanup(static_cast<CURL*>(handle));
+  }
+  curl_share_cleanup(static_cast<CURLSH*>(share_));
+}
+
+void CurlHttpClient::Perform(const std::string& url,
+                             const HttpHeaders& headers,
+                             const std::vector<uint8_t>& body,
+                             const Sink& sink,
+                             Exchange* exchange) {
+  CURL* handle = static_cast<CURL*>(AcquireHandle());
+  if (!handle) {
+    exchange->error = "curl_easy_init failed.";
+    return;
+  }
+
+  curl_slist* header_list = nullptr;
+  for (const auto& [name, value] : headers) {
+    header_list = curl_slist_append(header_list, (name + ": " + value).c_str());
+  }
+  // Large postsign bodies would otherwise wait a round trip for a
+  // 100 Continue. No CURLOPT_ACCEPT_ENCODING: HttpClient decodes the body.
+  header_list = curl_slist_append(header_list, "Expect:");
+
+  Transfer transfer{handle, &sink, &exchange->status, &exchange->headers};
+  char error[CURL_ERROR_SIZE] = {};
+  curl_easy_setopt(handle, CURLOPT_SHARE, static_cast<CURLSH*>(share_));
+  curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(handle, CURLOPT_POST, 1L);
+  curl_easy_setopt(handle, CURLOPT_POSTFIELDS,
+                   body.empty() ? "" : reinterpret_cast<const char*>(body.data()));
+  curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE,
+                   static_cast<curl_off_t>(body.size()));
+  curl_easy_setopt(handle, CURLOPT_HTTPHEADER, header_list);
+  curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, OnHeader);
+  curl_easy_setopt(handle, CURLOPT_HEADERDATA, &transfer);
+  curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, OnBody);
+  curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer);
+  curl_easy_setopt(handle, CURLOPT_PREREQFUNCTION, OnConnected);
+  curl_easy_setopt(handle, CURLOPT_PREREQDATA, &transfer);
+  curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, error);
+  if (!options().ca_file.empty()) {
+    curl_easy_setopt(handle, CURLOPT_CAINFO, options().ca_file.c_str());
+  }
+
+  CURLcode code = curl_easy_perform(handle);
+  if (code == CURLE_OK) {
+    long status = 0;
+    long connects = 0;
+    char* scheme = nullptr;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(handle, CURLINFO_SCHEME, &scheme);
+    exchange->status = static_cast<int>(status);
+    exchange->connection_known = true;
+    exchange->new_connection = connects > 0;
+    exchange->tls = scheme && IsHttps(scheme);
+    exchange->tls_resumed = transfer.tls_resumed;
+  }
+  else {
+    exchange->status = 0;
+    exchange->headers.clear();
+    exchange->error = error[0] ? error : curl_easy_strerror(code);
+  }
+
+  curl_slist_free_all(header_list);
+  ReleaseHandle(handle);
+}
+
+void* CurlHttpClient::AcquireHandle() {
+  {
+    std::lock_guard<std::mutex> lock(handles_mutex_);
+    if (!idle_handles_.empty()) {
+      void* handle = idle_handles_.back();
+      idle_handles_.pop_back();
+      // Keeps the caches and the connections, drops the options.
+      curl_easy_reset(static_cast<CURL*>(handle));
+      return handle;
+    }
+  }
+  return curl_easy_init();
+}
+
+void CurlHttpClient::ReleaseHandle(void* handle) {
+  std::lock_guard<std::mutex> lock(handles_mutex_);
+  idle_handles_.push_back(handle);
+}
+
+}  // namespace native_core
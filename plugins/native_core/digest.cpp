@@ -0,0 +1,345 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/digest.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace native_core {
+
+namespace {
+
+// FIPS 180-4, section 4.2.
+constexpr uint32_t kSha256Constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr uint64_t kSha512Constants[80] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f,
+    0xe9b5dba58189dbbc, 0x3956c25bf348b538, 0x59f111f1b605d019,
+    0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242,
+    0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+    0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3,
+    0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65, 0x2de92c6f592b0275,
+    0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+    0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f,
+    0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc,
+    0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+    0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6,
+    0x92722c851482353b, 0xa2bfe8a14cf10364, 0xa81a664bbc423001,
+    0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+    0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99,
+    0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb,
+    0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc,
+    0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915,
+    0xc67178f2e372532b, 0xca273eceea26619c, 0xd186b8c721c0c207,
+    0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba,
+    0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+    0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a,
+    0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+};
+
+// Section 5.3.
+constexpr uint64_t kSha1Initial[5] = {0x67452301, 0xefcdab89, 0x98badcfe,
+                                      0x10325476, 0xc3d2e1f0};
+constexpr uint64_t kSha256Initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                        0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                        0x1f83d9ab, 0x5be0cd19};
+constexpr uint64_t kSha384Initial[8] = {
+    0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17,
+    0x152fecd8f70e5939, 0x67332667ffc00b31, 0x8eb44a8768581511,
+    0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4};
+constexpr uint64_t kSha512Initial[8] = {
+    0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b,
+    0xa54ff53a5f1d36f1, 0x510e527fade682d1, 0x9b05688c2b3e6c1f,
+    0x1f83d9abfb41bd6b, 0x5be0cd19137e2179};
+
+inline uint32_t Rotr32(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t Rotl32(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+inline uint64_t Rotr64(uint64_t x, int n) {
+  return (x >> n) | (x << (64 - n));
+}
+
+inline uint32_t Load32(const uint8_t* p) {
+  return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) |
+         (uint32_t{p[2]} << 8) | p[3];
+}
+
+inline uint64_t Load64(const uint8_t* p) {
+  return (uint64_t{Load32(p)} << 32) | Load32(p + 4);
+}
+
+void Sha1Block(uint64_t* state, const uint8_t* block) {
+  uint32_t w[80];
+  for (int t = 0; t < 16; t++) {
+    w[t] = Load32(block + 4 * t);
+  }
+  for (int t = 16; t < 80; t++) {
+    w[t] = Rotl32(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+  }
+  uint32_t a = static_cast<uint32_t>(state[0]);
+  uint32_t b = static_cast<uint32_t>(state[1]);
+  uint32_t c = static_cast<uint32_t>(state[2]);
+  uint32_t d = static_cast<uint32_t>(state[3]);
+  uint32_t e = static_cast<uint32_t>(state[4]);
+  for (int t = 0; t < 80; t++) {
+    uint32_t f;
+    uint32_t k;
+    if (t < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    }
+    else if (t < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    }
+    else if (t < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    }
+    else {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+    uint32_t temp = Rotl32(a, 5) + f + e + k + w[t];
+    e = d;
+    d = c;
+    c = Rotl32(b, 30);
+    b = a;
+    a = temp;
+  }
+  state[0] = static_cast<uint32_t>(state[0] + a);
+  state[1] = static_cast<uint32_t>(state[1] + b);
+  state[2] = static_cast<uint32_t>(state[2] + c);
+  state[3] = static_cast<uint32_t>(state[3] + d);
+  state[4] = static_cast<uint32_t>(state[4] + e);
+}
+
+void Sha256Block(uint64_t* state, const uint8_t* block) {
+  uint32_t w[64];
+  for (int t = 0; t < 16; t++) {
+    w[t] = Load32(block + 4 * t);
+  }
+  for (int t = 16; t < 64; t++) {
+    uint32_t s0 = Rotr32(w[t - 15], 7) ^ Rotr32(w[t - 15], 18) ^
+                  (w[t - 15] >> 3);
+    uint32_t s1 = Rotr32(w[t - 2], 17) ^ Rotr32(w[t - 2], 19) ^
+                  (w[t - 2] >> 10);
+    w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+  }
+  // The working variables stay in registers, renamed instead of moved.
+  uint32_t a = static_cast<uint32_t>(state[0]);
+  uint32_t b = static_cast<uint32_t>(state[1]);
+  uint32_t c = static_cast<uint32_t>(state[2]);
+  uint32_t d = static_cast<uint32_t>(state[3]);
+  uint32_t e = static_cast<uint32_t>(state[4]);
+  uint32_t f = static_cast<uint32_t>(state[5]);
+  uint32_t g = static_cast<uint32_t>(state[6]);
+  uint32_t h = static_cast<uint32_t>(state[7]);
+  for (int t = 0; t < 64; t++) {
+    uint32_t s1 = Rotr32(e, 6) ^ Rotr32(e, 11) ^ Rotr32(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t temp1 = h + s1 + ch + kSha256Constants[t] + w[t];
+    uint32_t s0 = Rotr32(a, 2) ^ Rotr32(a, 13) ^ Rotr32(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    h = g;
+    g = f;
+    f = e;
+    e = d + temp1;
+    d = c;
+    c = b;
+    b = a;
+    a = temp1 + s0 + maj;
+  }
+  const uint32_t v[8] = {a, b, c, d, e, f, g, h};
+  for (int i = 0; i < 8; i++) {
+    state[i] = static_cast<uint32_t>(state[i] + v[i]);
+  }
+}
+
+void Sha512Block(uint64_t* state, const uint8_t* block) {
+  uint64_t w[80];
+  for (int t = 0; t < 16; t++) {
+    w[t] = Load64(block + 8 * t);
+  }
+  for (int t = 16; t < 80; t++) {
+    uint64_t s0 = Rotr64(w[t - 15], 1) ^ Rotr64(w[t - 15], 8) ^
+                  (w[t - 15] >> 7);
+    uint64_t s1 = Rotr64(w[t - 2], 19) ^ Rotr64(w[t - 2], 61) ^
+                  (w[t - 2] >> 6);
+    w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+  }
+  uint64_t a = state[0];
+  uint64_t b = state[1];
+  uint64_t c = state[2];
+  uint64_t d = state[3];
+  uint64_t e = state[4];
+  uint64_t f = state[5];
+  uint64_t g = state[6];
+  uint64_t h = state[7];
+  for (int t = 0; t < 80; t++) {
+    uint64_t s1 = Rotr64(e, 14) ^ Rotr64(e, 18) ^ Rotr64(e, 41);
+    uint64_t ch = (e & f) ^ (~e & g);
+    uint64_t temp1 = h + s1 + ch + kSha512Constants[t] + w[t];
+    uint64_t s0 = Rotr64(a, 28) ^ Rotr64(a, 34) ^ Rotr64(a, 39);
+    uint64_t maj = (a & b) ^ (a & c) ^ (b & c);
+    h = g;
+    g = f;
+    f = e;
+    e = d + temp1;
+    d = c;
+    c = b;
+    b = a;
+    a = temp1 + s0 + maj;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+}  // namespace
+
+Digester::Digester(DigestAlgorithm algorithm) : algorithm_(algorithm) {
+  switch (algorithm) {
+    case DigestAlgorithm::kSha1:
+      block_size_ = 64;
+      std::memcpy(state_, kSha1Initial, sizeof(kSha1Initial));
+      break;
+    case DigestAlgorithm::kSha256:
+      block_size_ = 64;
+      std::memcpy(state_, kSha256Initial, sizeof(kSha256Initial));
+      break;
+    case DigestAlgorithm::kSha384:
+      block_size_ = 128;
+      std::memcpy(state_, kSha384Initial, sizeof(kSha384Initial));
+      break;
+    case DigestAlgorithm::kSha512:
+      block_size_ = 128;
+      std::memcpy(state_, kSha512Initial, sizeof(kSha512Initial));
+      break;
+  }
+}
+
+// static
+size_t Digester::SizeOf(DigestAlgorithm algorithm) {
+  switch (algorithm) {
+    case DigestAlgorithm::kSha1:
+      return 20;
+    case DigestAlgorithm::kSha256:
+      return 32;
+    case DigestAlgorithm::kSha384:
+      return 48;
+    case DigestAlgorithm::kSha512:
+      break;
+  }
+  return 64;
+}
+
+void Digester::Update(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  length_ += size;
+  if (buffered_ > 0) {
+    size_t taken = std::min(size, block_size_ - buffered_);
+    std::memcpy(buffer_ + buffered_, data, taken);
+    buffered_ += taken;
+    data += taken;
+    size -= taken;
+    if (buffered_ < block_size_) {
+      return;
+    }
+    Compress(buffer_);
+    buffered_ = 0;
+  }
+  for (; size >= block_size_; data += block_size_, size -= block_size_) {
+    Compress(data);
+  }
+  std::memcpy(buffer_, data, size);
+  buffered_ = size;
+}
+
+std::vector<uint8_t> Digester::Finish() {
+  // The padding: a 1 bit, zeros, and the length in bits in the last 8 (or
+  // 16) bytes of the block.
+  size_t length_size = block_size_ / 8;
+  uint64_t bits = length_ * 8;
+  uint8_t padding[256] = {0x80};
+  size_t padding_size = block_size_ - (buffered_ + length_size) % block_size_;
+  for (int i = 0; i < 8; i++) {
+    padding[padding_size + length_size - 1 - i] =
+        static_cast<uint8_t>(bits >> (8 * i));
+  }
+  Update(padding, padding_size + length_size);
+
+  size_t size = SizeOf(algorithm_);
+  std::vector<uint8_t> hash(size);
+  size_t word_size = block_size_ == 64 ? 4 : 8;
+  for (size_t i = 0; i < size; i++) {
+    size_t shift = 8 * (word_size - 1 - i % word_size);
+    hash[i] = static_cast<uint8_t>(state_[i / word_size] >> shift);
+  }
+  return hash;
+}
+
+void Digester::Compress(const uint8_t* block) {
+  switch (algorithm_) {
+    case DigestAlgorithm::kSha1:
+      Sha1Block(state_, block);
+      break;
+    case DigestAlgorithm::kSha256:
+      Sha256Block(state_, block);
+      break;
+    case DigestAlgorithm::kSha384:
+    case DigestAlgorithm::kSha512:
+      Sha512Block(state_, block);
+      break;
+  }
+}
+
+std::vector<uint8_t> Digest(DigestAlgorithm algorithm,
+                            const uint8_t* data,
+                            size_t size) {
+  Digester digester(algorithm);
+  digester.Update(data, size);
+  return digester.Finish();
+}
+
+}  // namespace native_core
@@ -0,0 +1,80 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/eventfd_wakeup.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+namespace native_core {
+
+EventFdWakeup::EventFdWakeup() {
+#if defined(__linux__)
+  read_fd_ = write_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#else
+  int fds[2];
+  if (pipe(fds) == 0) {
+    for (int fd : fds) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    read_fd_ = fds[0];
+    write_fd_ = fds[1];
+  }
+#endif
+}
+
+EventFdWakeup::~EventFdWakeup() {
+  if (read_fd_ >= 0) {
+    close(read_fd_);
+  }
+  if (write_fd_ >= 0 && write_fd_ != read_fd_) {
+    close(write_fd_);
+  }
+}
+
+void EventFdWakeup::Signal() {
+  uint64_t one = 1;
+  ssize_t written;
+  do {
+    written = write(write_fd_, &one, write_fd_ == read_fd_ ? sizeof(one) : 1);
+  } while (written < 0 && errno == EINTR);
+  // EAGAIN means the counter (or pipe) is already signalled, which is all we
+  // need.
+}
+
+bool EventFdWakeup::Wait(int timeout_ms) {
+  pollfd descriptor = {read_fd_, POLLIN, 0};
+  int ready;
+  do {
+    ready = poll(&descriptor, 1, timeout_ms);
+  } while (ready < 0 && errno == EINTR);
+  return ready > 0;
+}
+
+void EventFdWakeup::Consume() {
+  uint64_t buffer[8];
+  while (read(read_fd_, buffer, read_fd_ == write_fd_ ? sizeof(uint64_t)
+                                                      : sizeof(buffer)) > 0) {
+  }
+}
+
+}  // namespace native_core
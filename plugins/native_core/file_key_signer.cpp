@@ -0,0 +1,125 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/file_key_signer.h"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include <cstdio>
+#include <utility>
+
+#include "include/native_core/secure_arena.h"
+
+namespace native_core {
+
+namespace {
+
+const EVP_MD* DigestFor(DigestAlgorithm digest) {
+  switch (digest) {
+    case DigestAlgorithm::kSha1:
+      return EVP_sha1();
+    case DigestAlgorithm::kSha256:
+      return EVP_sha256();
+    case DigestAlgorithm::kSha384:
+      return EVP_sha384();
+    case DigestAlgorithm::kSha512:
+      break;
+  }
+  return EVP_sha512();
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<FileKeySigner> FileKeySigner::Open(const std::string& path,
+                                                   std::string* error) {
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = "Cannot open " + path;
+    return nullptr;
+  }
+  EVP_PKEY* key = PEM_read_PrivateKey(file, nullptr, nullptr, nullptr);
+  std::vector<uint8_t> certificate;
+  X509* x509 = key ? PEM_read_X509(file, nullptr, nullptr, nullptr) : nullptr;
+  if (x509) {
+    int size = i2d_X509(x509, nullptr);
+    if (size > 0) {
+      certificate.resize(static_cast<size_t>(size));
+      uint8_t* out = certificate.data();
+      i2d_X509(x509, &out);
+    }
+    X509_free(x509);
+  }
+  std::fclose(file);
+  if (!key) {
+    *error = "No PEM private key in " + path;
+    return nullptr;
+  }
+  if (EVP_PKEY_base_id(key) != EVP_PKEY_RSA) {
+    EVP_PKEY_free(key);
+    *error = "Not an RSA key: " + path;
+    return nullptr;
+  }
+  return std::unique_ptr<FileKeySigner>(
+      new FileKeySigner(key, std::move(certificate)));
+}
+
+FileKeySigner::FileKeySigner(void* key, std::vector<uint8_t> certificate)
+    : key_(key), certificate_(std::move(certificate)) {}
+
+FileKeySigner::~FileKeySigner() {
+  EVP_PKEY_free(static_cast<EVP_PKEY*>(key_));
+}
+
+bool FileKeySigner::Sign(std::string_view algorithm,
+                         const uint8_t* data,
+                         size_t size,
+                         std::vector<uint8_t>* signature,
+                         std::string* error) {
+  EVP_PKEY* key = static_cast<EVP_PKEY*>(key_);
+  // Signed into locked memory, sized for the key, and copied out once.
+  SecureArena arena;
+  size_t length = static_cast<size_t>(EVP_PKEY_size(key));
+  uint8_t* buffer = arena.Allocate(length);
+  if (!buffer) {
+    *error = "Out of memory.";
+    return false;
+  }
+  EVP_MD_CTX* context = EVP_MD_CTX_new();
+  if (!context) {
+    *error = "EVP_MD_CTX_new failed.";
+    return false;
+  }
+  EVP_PKEY_CTX* key_context = nullptr;
+  bool ok = EVP_DigestSignInit(context, &key_context,
+                               DigestFor(DigestAlgorithmFor(algorithm)),
+                               nullptr, key) == 1 &&
+            EVP_PKEY_CTX_set_rsa_padding(key_context, RSA_PKCS1_PADDING) == 1 &&
+            EVP_DigestSign(context, buffer, &length, data, size) == 1;
+  EVP_MD_CTX_free(context);
+  if (!ok) {
+    *error = "EVP_DigestSign failed.";
+    return false;
+  }
+  signature->assign(buffer, buffer + length);
+  return true;
+}
+
+std::vector<uint8_t> FileKeySigner::Certificate() const {
+  return certificate_;
+}
+
+}  // namespace native_core
@@ -0,0 +1,57 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/first_frame.h"
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace native_core {
+
+namespace {
+
+std::atomic<bool> first_frame_rendered{false};
+
+// Only touched on the platform thread.
+std::vector<std::function<void()>>& PendingTasks() {
+  static auto* tasks = new std::vector<std::function<void()>>();
+  return *tasks;
+}
+
+}  // namespace
+
+void RunAfterFirstFrame(std::function<void()> task) {
+  if (first_frame_rendered.load(std::memory_order_acquire)) {
+    task();
+    return;
+  }
+  PendingTasks().push_back(std::move(task));
+}
+
+void NotifyFirstFrame() {
+  if (first_frame_rendered.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  std::vector<std::function<void()>> tasks;
+  tasks.swap(PendingTasks());
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+bool HasRenderedFirstFrame() {
+  return first_frame_rendered.load(std::memory_order_acquire);
+}
+
+}  // namespace native_core
@@ -0,0 +1,103 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/histogram.h"
+
+#include <cmath>
+
+namespace native_core {
+
+namespace {
+
+int HighestBit(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+}  // namespace
+
+DurationHistogram::DurationHistogram() {
+  Reset();
+}
+
+void DurationHistogram::Record(std::chrono::nanoseconds duration) {
+  uint64_t value =
+      duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+  buckets_[BucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_ns_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t current_max = max_ns_.load(std::memory_order_relaxed);
+  while (value > current_max &&
+         !max_ns_.compare_exchange_weak(current_max, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+std::chrono::nanoseconds DurationHistogram::Percentile(
+    double percentile) const {
+  uint64_t total = count();
+  if (total == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  auto rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * total));
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < kBucketCount; bucket++) {
+    seen += buckets_[bucket].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      uint64_t bound = BucketUpperBound(bucket);
+      uint64_t largest = max_ns_.load(std::memory_order_relaxed);
+      return std::chrono::nanoseconds(
+          static_cast<int64_t>(bound < largest ? bound : largest));
+    }
+  }
+  return max();
+}
+
+void DurationHistogram::Reset() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  total_ns_.store(0, std::memory_order_relaxed);
+  max_ns_.store(0, std::memory_order_relaxed);
+}
+
+// static
+int DurationHistogram::BucketFor(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<int>(value);
+  }
+  int exponent = HighestBit(value);
+  int shift = exponent - kSubBucketBits;
+  int sub_bucket = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+  return (shift + 1) * kSubBuckets + sub_bucket;
+}
+
+// static
+uint64_t DurationHistogram::BucketUpperBound(int bucket) {
+  if (bucket < kSubBuckets) {
+    return static_cast<uint64_t>(bucket);
+  }
+  int shift = bucket / kSubBuckets - 1;
+  uint64_t sub_bucket = static_cast<uint64_t>(bucket % kSubBuckets);
+  uint64_t lower = (kSubBuckets + sub_bucket) << shift;
+  return lower + ((uint64_t{1} << shift) - 1);
+}
+
+}  // namespace native_core
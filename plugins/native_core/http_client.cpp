@@ -0,0 +1,316 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/http_client.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <string_view>
+
+#include "include/native_core/content_coding.h"
+
+#ifdef _WIN32
+#include "include/native_core/winhttp_client.h"
+#else
+#include "include/native_core/curl_http_client.h"
+#endif
+
+namespace native_core {
+
+namespace {
+
+constexpr std::string_view kSessionCookieName = "JSESSIONID";
+
+std::string Lowercase(std::string_view value) {
+  std::string lower(value);
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return lower;
+}
+
+// "scheme://host:port" of |url|, lowercased, without any user info.
+std::string OriginOf(const std::string& url) {
+  size_t scheme_end = url.find("://");
+  if (scheme_end == std::string::npos) {
+    return Lowercase(url);
+  }
+  size_t authority_start = scheme_end + 3;
+  size_t authority_end = url.find_first_of("/?#", authority_start);
+  if (authority_end == std::string::npos) {
+    authority_end = url.size();
+  }
+  std::string_view authority(url.data() + authority_start,
+                             authority_end - authority_start);
+  size_t at = authority.rfind('@');
+  if (at != std::string_view::npos) {
+    authority.remove_prefix(at + 1);
+  }
+  return Lowercase(std::string_view(url.data(), authority_start)) +
+         Lowercase(authority);
+}
+
+bool HasHeader(const HttpHeaders& headers, std::string_view name) {
+  return std::any_of(headers.begin(), headers.end(), [&](const auto& header) {
+    return !header.second.empty() && Lowercase(header.first) == name;
+  });
+}
+
+// Value of the first header named |name| (lowercase), or an empty string.
+std::string_view HeaderValue(const HttpHeaders& headers,
+                             std::string_view name) {
+  for (const auto& [header_name, value] : headers) {
+    if (header_name == name) {
+      return value;
+    }
+  }
+  return std::string_view();
+}
+
+// The "JSESSIONID=..." pair of a Set-Cookie header, or an empty string.
+std::string SessionCookieOf(std::string_view set_cookie) {
+  size_t end = set_cookie.find(';');
+  std::string_view pair = set_cookie.substr(0, end);
+  while (!pair.empty() && pair.front() == ' ') {
+    pair.remove_prefix(1);
+  }
+  if (pair.size() <= kSessionCookieName.size() ||
+      pair.compare(0, kSessionCookieName.size(), kSessionCookieName) != 0 ||
+      pair[kSessionCookieName.size()] != '=') {
+    return std::string();
+  }
+  return std::string(pair);
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<HttpClient> HttpClient::Create(HttpClientOptions options) {
+#ifdef _WIN32
+  return std::make_unique<WinHttpClient>(std::move(options));
+#else
+  return std::make_unique<CurlHttpClient>(std::move(options));
+#endif
+}
+
+HttpClient::HttpClient(HttpClientOptions options)
+    : options_(std::move(options)) {
+  for (const std::string& url : options_.compress_requests_to) {
+    origins_[OriginOf(url)].compress_requests = true;
+  }
+}
+
+HttpClient::~HttpClient() {}
+
+HttpResponse HttpClient::Post(const std::string& url,
+                              const HttpHeaders& headers,
+                              const std::vector<uint8_t>& body,
+                              const Sink& sink) {
+  std::string origin = OriginOf(url);
+  HttpHeaders request_headers = headers;
+  bool compress = false;
+  {
+    std::lock_guard<std::mutex> lock(origins_mutex_);
+    const Origin& known = origins_[origin];
+    compress = known.compress_requests;
+    if (!known.session_cookie.empty() && !HasHeader(headers, "cookie")) {
+      // An empty Cookie header stands for no cookie.
+      request_headers.erase(
+          std::remove_if(request_headers.begin(), request_headers.end(),
+                         [](const auto& header) {
+                           return Lowercase(header.first) == "cookie";
+                         }),
+          request_headers.end());
+      request_headers.emplace_back("Cookie", known.session_cookie);
+    }
+  }
+  if (!DecodesResponses() && !AcceptedCodings().empty() &&
+      !HasHeader(headers, "accept-encoding")) {
+    request_headers.emplace_back("Accept-Encoding",
+                                 std::string(AcceptedCodings()));
+  }
+
+  Exchange exchange;
+  std::vector<uint8_t> compressed;
+  if (compress && body.size() >= options_.compress_requests_from &&
+      !HasHeader(headers, "content-encoding") &&
+      GzipCompress(body.data(), body.size(), &compressed) &&
+      compressed.size() < body.size()) {
+    HttpHeaders compressed_headers = request_headers;
+    compressed_headers.emplace_back("Content-Encoding", "gzip");
+    Send(origin, url, compressed_headers, compressed, true, sink, &exchange);
+    if (exchange.status == 415) {
+      // The host does not take compressed bodies after all.
+      {
+        std::lock_guard<std::mutex> lock(origins_mutex_);
+        origins_[origin].compress_requests = false;
+      }
+      exchange = Exchange();
+      Send(origin, url, request_headers, body, false, sink, &exchange);
+    }
+    else {
+      plain_request_bytes_.fetch_add(body.size(), std::memory_order_relaxed);
+      compressed_request_bytes_.fetch_add(compressed.size(),
+                                          std::memory_order_relaxed);
+    }
+  }
+  else {
+    Send(origin, url, request_headers, body, false, sink, &exchange);
+  }
+
+  HttpResponse response;
+  response.status = exchange.status;
+  response.error = std::move(exchange.error);
+  for (auto& [name, value] : exchange.headers) {
+    if (name == "set-cookie") {
+      std::string cookie = SessionCookieOf(value);
+      if (!cookie.empty()) {
+        std::lock_guard<std::mutex> lock(origins_mutex_);
+        origins_[origin].session_cookie = std::move(cookie);
+      }
+    }
+    auto inserted = response.headers.emplace(name, value);
+    if (!inserted.second) {
+      inserted.first->second.append(",").append(value);
+    }
+  }
+  return response;
+}
+
+void HttpClient::ClearSession() {
+  std::lock_guard<std::mutex> lock(origins_mutex_);
+  for (auto& [origin, known] : origins_) {
+    known.session_cookie.clear();
+  }
+}
+
+void HttpClient::CompressRequests(const std::string& url, bool enabled) {
+  std::lock_guard<std::mutex> lock(origins_mutex_);
+  origins_[OriginOf(url)].compress_requests = enabled;
+}
+
+HttpStats HttpClient::stats() const {
+  HttpStats stats;
+  stats.requests = requests_.load(std::memory_order_relaxed);
+  stats.failures = failures_.load(std::memory_order_relaxed);
+  stats.connections_opened = connections_opened_.load(std::memory_order_relaxed);
+  stats.connections_reused = connections_reused_.load(std::memory_order_relaxed);
+  stats.tls_full_handshakes =
+      tls_full_handshakes_.load(std::memory_order_relaxed);
+  stats.tls_resumed_handshakes =
+      tls_resumed_handshakes_.load(std::memory_order_relaxed);
+  stats.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+  stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+  stats.encoded_response_bytes =
+      encoded_response_bytes_.load(std::memory_order_relaxed);
+  stats.decoded_response_bytes =
+      decoded_response_bytes_.load(std::memory_order_relaxed);
+  stats.plain_request_bytes =
+      plain_request_bytes_.load(std::memory_order_relaxed);
+  stats.compressed_request_bytes =
+      compressed_request_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void HttpClient::Send(const std::string& origin,
+                      const std::string& url,
+                      const HttpHeaders& headers,
+                      const std::vector<uint8_t>& body,
+                      bool compressed,
+                      const Sink& sink,
+                      Exchange* exchange) {
+  uint64_t received = 0;
+  uint64_t decoded = 0;
+  bool started = false;
+  bool discard = false;
+  std::unique_ptr<ContentDecoder> decoder;
+  Sink decoded_sink = [&](const char* data, size_t size) {
+    decoded += size;
+    sink(data, size);
+  };
+
+  AcquireSlot(origin);
+  auto start = std::chrono::steady_clock::now();
+  Perform(url, headers, body, [&](const char* data, size_t size) {
+    received += size;
+    if (!started) {
+      started = true;
+      // The body of a refused compressed request is not the response.
+      discard = compressed && exchange->status == 415;
+      if (!DecodesResponses()) {
+        decoder = ContentDecoder::Create(
+            ContentCodingFor(HeaderValue(exchange->headers, "content-encoding")),
+            decoded_sink);
+      }
+    }
+    if (discard) {
+      return;
+    }
+    if (decoder) {
+      decoder->Feed(data, size);
+    }
+    else {
+      sink(data, size);
+    }
+  }, exchange);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  ReleaseSlot(origin);
+
+  if (decoder && exchange->status != 0 && !decoder->Finish()) {
+    exchange->status = 0;
+    exchange->error = decoder->error();
+  }
+
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  bytes_sent_.fetch_add(body.size(), std::memory_order_relaxed);
+  bytes_received_.fetch_add(received, std::memory_order_relaxed);
+  if (decoder) {
+    encoded_response_bytes_.fetch_add(received, std::memory_order_relaxed);
+    decoded_response_bytes_.fetch_add(decoded, std::memory_order_relaxed);
+  }
+  if (exchange->status == 0) {
+    failures_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (exchange->connection_known) {
+    if (exchange->new_connection) {
+      connections_opened_.fetch_add(1, std::memory_order_relaxed);
+      new_connection_times_.Record(elapsed);
+      if (exchange->tls) {
+        (exchange->tls_resumed ? tls_resumed_handshakes_ : tls_full_handshakes_)
+            .fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    else {
+      connections_reused_.fetch_add(1, std::memory_order_relaxed);
+      reused_connection_times_.Record(elapsed);
+    }
+  }
+}
+
+void HttpClient::AcquireSlot(const std::string& origin) {
+  std::unique_lock<std::mutex> lock(slots_mutex_);
+  size_t limit = std::max<size_t>(options_.max_connections_per_host, 1);
+  slot_released_.wait(lock, [&]() { return in_flight_[origin] < limit; });
+  in_flight_[origin]++;
+}
+
+void HttpClient::ReleaseSlot(const std::string& origin) {
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    in_flight_[origin]--;
+  }
+  slot_released_.notify_all();
+}
+
+}  // namespace native_core
@@ -0,0 +1,71 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CADES_SIGNATURE_H_
+#define NATIVE_CORE_CADES_SIGNATURE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "export.h"
+#include "pkcs1_signer.h"
+
+namespace native_core {
+
+struct CadesOptions {
+  // Hashes the content and the signed attributes.
+  DigestAlgorithm digest = DigestAlgorithm::kSha512;
+  // Whether the content is carried in the signature (implicit) or left out
+  // of it (explicit, detached).
+  bool attached = false;
+  // The signing-time attribute; now if unset.
+  std::optional<std::chrono::system_clock::time_point> signing_time;
+  // Whether to add the signing-time attribute at all. PAdES signatures leave
+  // it out and carry the time in the signature dictionary.
+  bool signing_time_attribute = true;
+};
+
+// Builds a CAdES-BES signature of |size| bytes of |content| in one pass: a
+// DER-encoded CMS SignedData (RFC 5652) with the content-type, signing-time,
+// message-digest and signing-certificate-v2 (RFC 5035) signed attributes,
+// carrying |certificate| (DER) and signed by |signer|, whose key must be the
+// one of |certificate|. The signer is asked for exactly one signature.
+//
+// Returns false, with a description in |error|, if |certificate| cannot be
+// read or the signer fails.
+NATIVE_CORE_EXPORT bool BuildCadesSignature(Pkcs1Signer* signer,
+                                            const std::vector<uint8_t>& certificate,
+                                            const uint8_t* content,
+                                            size_t size,
+                                            const CadesOptions& options,
+                                            std::vector<uint8_t>* signature,
+                                            std::string* error);
+
+// Same as BuildCadesSignature(), always detached, for content that has
+// already been hashed with |options.digest| into |content_digest|: content
+// too large to hold, hashed as it streams by.
+NATIVE_CORE_EXPORT bool BuildDetachedCadesSignature(
+    Pkcs1Signer* signer,
+    const std::vector<uint8_t>& certificate,
+    const std::vector<uint8_t>& content_digest,
+    const CadesOptions& options,
+    std::vector<uint8_t>* signature,
+    std::string* error);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CADES_SIGNATURE_H_
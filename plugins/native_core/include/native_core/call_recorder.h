@@ -0,0 +1,158 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CALL_RECORDER_H_
+#define NATIVE_CORE_CALL_RECORDER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// How a method call was answered.
+enum class CallOutcome : uint8_t {
+  kSuccess = 0,
+  kError = 1,
+  kNotImplemented = 2,
+};
+
+// Records the method-channel calls of the plugins into a trace file, so that
+// the traffic of a slow session can be looked at and replayed headlessly
+// (tools/call_replay.cpp) against the same native code.
+//
+// Recording is opt-in: the process-wide recorder exists only when
+// PORTAFIRMAS_CALL_TRACE names the trace file. The arguments of each call are
+// kept as well, which replaying needs, when PORTAFIRMAS_CALL_TRACE_PAYLOADS
+// is 1; otherwise only their size is. Payloads hold whatever the app sends,
+// documents and responses included, so they are never kept by default.
+//
+// The file starts with kMagic and is a sequence of records, each a kind byte
+// followed by unsigned LEB128 integers and length-prefixed bytes:
+//
+//   name:   channel, method
+//   begin:  name index, time, argument size, has payload, [payload]
+//   return: call index, time
+//   end:    call index, time, outcome, result size
+//
+// Names and calls are numbered in the order they appear. Times are steady
+// clock nanoseconds since the previous record, so they never go back. A call
+// begins when the handler is entered, returns when the handler returns and
+// ends when it is answered, which for work run on the pool is later.
+//
+// Records are buffered and written once a second while calls keep coming,
+// and when the recorder is destroyed or the process exits; a record torn by a
+// crash is ignored when the trace is read.
+//
+// Safe to use from several threads at once.
+class NATIVE_CORE_EXPORT CallRecorder {
+ public:
+  // "PFCALLS" and the layout version.
+  static constexpr char kMagic[8] = {'P', 'F', 'C', 'A', 'L', 'L', 'S', 1};
+
+  // Returns the process-wide recorder shared by the plugins, set up from the
+  // environment on first use, or null if recording is off.
+  static CallRecorder* Get();
+
+  // Creates the trace at the UTF-8 |path|, replacing any file there. Returns
+  // null if it cannot be written.
+  static std::unique_ptr<CallRecorder> Open(const std::string& path,
+                                            bool payloads);
+
+  ~CallRecorder();
+
+  // Prevent copying.
+  CallRecorder(CallRecorder const&) = delete;
+  CallRecorder& operator=(CallRecorder const&) = delete;
+
+  // Whether the arguments of the calls are kept, not only their size.
+  bool payloads() const { return payloads_; }
+
+  // Records that |channel|/|method| was called with arguments of
+  // |argument_size| bytes, encoded as |payload| if payloads() (it may be null
+  // otherwise). Returns the index of the call.
+  uint64_t Begin(const std::string& channel,
+                 const std::string& method,
+                 size_t argument_size,
+                 const std::vector<uint8_t>* payload);
+
+  // Records that the handler of |call| returned.
+  void Return(uint64_t call);
+
+  // Records that |call| was answered with a result of |result_size| bytes.
+  void End(uint64_t call, CallOutcome outcome, size_t result_size);
+
+  // Writes the buffered records to the file.
+  void Flush();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  CallRecorder(std::FILE* file, bool payloads);
+
+  // Starts a record of |kind|, taking its time. Must hold |mutex_|.
+  void StartRecord(uint8_t kind);
+
+  // Writes the buffer if it is large or old enough. Must hold |mutex_|.
+  void MaybeWrite();
+
+  void Write();
+
+  std::FILE* const file_;
+  const bool payloads_;
+
+  std::mutex mutex_;
+  std::string buffer_;
+  std::map<std::pair<std::string, std::string>, uint64_t> names_;
+  uint64_t next_call_ = 0;
+  Clock::time_point last_time_;
+  Clock::time_point last_write_;
+};
+
+// A call read back from a trace.
+struct TracedCall {
+  std::string channel;
+  std::string method;
+  // Since the start of the trace.
+  std::chrono::nanoseconds begin{0};
+  // Unset if the trace ends before the handler returned or the call was
+  // answered.
+  std::optional<std::chrono::nanoseconds> returned;
+  std::optional<std::chrono::nanoseconds> answered;
+  CallOutcome outcome = CallOutcome::kSuccess;
+  uint64_t argument_size = 0;
+  uint64_t result_size = 0;
+  // The arguments in the StandardMessageCodec encoding, if payloads were
+  // recorded.
+  std::optional<std::vector<uint8_t>> payload;
+};
+
+// Reads the trace at the UTF-8 |path| into |calls|, in the order they began.
+// A torn last record is ignored. Returns false, describing why in |error|, if
+// the file cannot be read or is not a trace.
+NATIVE_CORE_EXPORT bool ReadCallTrace(const std::string& path,
+                                      std::vector<TracedCall>* calls,
+                                      std::string* error);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CALL_RECORDER_H_
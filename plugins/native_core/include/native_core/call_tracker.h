@@ -0,0 +1,84 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CALL_TRACKER_H_
+#define NATIVE_CORE_CALL_TRACKER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "export.h"
+
+namespace native_core {
+
+// Remembers which method-channel call the platform thread is executing, so
+// that another thread (the runner's watchdog) can tell what it is stuck in.
+//
+// Begin()/End() are only called on the platform thread. Snapshot() may be
+// called from any thread; it never blocks the platform thread.
+class NATIVE_CORE_EXPORT CallTracker {
+ public:
+  // Longest "channel/method" name kept; longer names are truncated.
+  static constexpr size_t kMaxNameLength = 127;
+
+  // Returns the process-wide tracker shared by the plugins and the runner.
+  static CallTracker& Get();
+
+  // Prevent copying.
+  CallTracker(CallTracker const&) = delete;
+  CallTracker& operator=(CallTracker const&) = delete;
+
+  // Records that |channel|/|method| started running. Nested calls keep the
+  // outermost name.
+  void Begin(const std::string& channel, const std::string& method);
+
+  void End();
+
+  // Copies "channel/method" of the call in progress into |name|. Returns false
+  // if the platform thread is not inside a tracked call.
+  bool Snapshot(std::string* name) const;
+
+ private:
+  CallTracker() = default;
+
+  void Store(const std::string& channel, const std::string& method);
+
+  // Platform thread only.
+  int depth_ = 0;
+
+  // Seqlock: odd while the name is being rewritten.
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<bool> active_{false};
+  std::atomic<size_t> length_{0};
+  std::array<std::atomic<char>, kMaxNameLength> name_{};
+};
+
+// Tracks a method call for the lifetime of the scope.
+class CallScope {
+ public:
+  CallScope(const std::string& channel, const std::string& method) {
+    CallTracker::Get().Begin(channel, method);
+  }
+
+  ~CallScope() { CallTracker::Get().End(); }
+
+  // Prevent copying.
+  CallScope(CallScope const&) = delete;
+  CallScope& operator=(CallScope const&) = delete;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CALL_TRACKER_H_
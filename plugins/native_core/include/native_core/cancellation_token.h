@@ -0,0 +1,59 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CANCELLATION_TOKEN_H_
+#define NATIVE_CORE_CANCELLATION_TOKEN_H_
+
+#include <atomic>
+#include <memory>
+
+namespace native_core {
+
+// Read side of a cancellation flag. Tokens are cheap to copy and are handed to
+// background work, which polls IsCancelled() at convenient points.
+class CancellationToken {
+ public:
+  // A token that can never be cancelled.
+  CancellationToken() = default;
+
+  bool IsCancelled() const {
+    return flag_ && flag_->load(std::memory_order_acquire);
+  }
+
+ private:
+  friend class CancellationSource;
+
+  explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag)
+      : flag_(std::move(flag)) {}
+
+  std::shared_ptr<const std::atomic<bool>> flag_;
+};
+
+// Owner side of a cancellation flag. Cancel() is sticky and thread-safe.
+class CancellationSource {
+ public:
+  CancellationSource() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void Cancel() { flag_->store(true, std::memory_order_release); }
+
+  bool IsCancelled() const { return flag_->load(std::memory_order_acquire); }
+
+  CancellationToken token() const { return CancellationToken(flag_); }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CANCELLATION_TOKEN_H_
@@ -0,0 +1,85 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CERTIFICATE_SIGNER_H_
+#define NATIVE_CORE_CERTIFICATE_SIGNER_H_
+
+#include <windows.h>
+
+#include <wincrypt.h>
+
+#include <memory>
+#include <mutex>
+
+#include "export.h"
+#include "pkcs1_signer.h"
+
+namespace native_core {
+
+// Signs with the private key of a certificate from a Windows store, through
+// CNG when its provider is a KSP and through CryptoAPI otherwise. The key is
+// acquired on the first signature and kept for the next ones, so a provider
+// that prompts for a PIN does so once per signer rather than per signature.
+// A key that fails to sign is dropped and acquired again on the next one,
+// which is what a reinserted smart card needs.
+//
+// Signatures run on worker threads, so a PIN dialog has no window of its own
+// thread to sit in front of; it is owned by the top-level window of |window|
+// instead, when there is one.
+class NATIVE_CORE_EXPORT CertificateSigner : public Pkcs1Signer {
+ public:
+  // Holds its own reference to |certificate|. |window|, if any, must outlive
+  // the signer.
+  explicit CertificateSigner(PCCERT_CONTEXT certificate, HWND window = NULL);
+  ~CertificateSigner() override;
+
+  // Prevent copying.
+  CertificateSigner(CertificateSigner const&) = delete;
+  CertificateSigner& operator=(CertificateSigner const&) = delete;
+
+  bool Sign(std::string_view algorithm,
+            const uint8_t* data,
+            size_t size,
+            std::vector<uint8_t>* signature,
+            std::string* error) override;
+
+  std::vector<uint8_t> Certificate() const override;
+
+  PCCERT_CONTEXT certificate() const { return certificate_; }
+
+  // Acquires and keeps the key without showing any UI, which loads its
+  // provider ahead of the first signature. Returns false, leaving the key to
+  // the first signature, if the provider needs a PIN or its smart card is
+  // missing.
+  bool AcquireKeySilently();
+
+ private:
+  struct Key;
+
+  // Returns the kept key, acquiring it with CryptAcquireCertificatePrivateKey
+  // |flags| if there is none, or null after describing the failure in
+  // |error|.
+  std::shared_ptr<Key> AcquireKey(DWORD flags, std::string* error);
+
+  PCCERT_CONTEXT certificate_;
+  const HWND window_;
+
+  // Signatures hold their own reference, so a key dropped by one of them
+  // outlives the others in progress.
+  std::mutex key_mutex_;
+  std::shared_ptr<Key> key_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CERTIFICATE_SIGNER_H_
@@ -0,0 +1,89 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CONTENT_CODING_H_
+#define NATIVE_CORE_CONTENT_CODING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// HTTP content codings (Content-Encoding and Accept-Encoding values).
+enum class ContentCoding {
+  kIdentity,
+  kGzip,
+  kDeflate,
+  kZstd,
+  // Anything else, or more than one coding.
+  kUnsupported,
+};
+
+// Reads a Content-Encoding value. An empty value is kIdentity.
+NATIVE_CORE_EXPORT ContentCoding ContentCodingFor(std::string_view value);
+
+// Whether this build can decode |coding|. gzip and deflate need zlib and zstd
+// needs libzstd, both optional at build time.
+NATIVE_CORE_EXPORT bool CanDecode(ContentCoding coding);
+
+// The codings this build can decode, as an Accept-Encoding value, or an empty
+// string if there are none.
+NATIVE_CORE_EXPORT std::string_view AcceptedCodings();
+
+// Decodes a body as it arrives and hands the decoded bytes to a sink.
+class NATIVE_CORE_EXPORT ContentDecoder {
+ public:
+  using Sink = std::function<void(const char* data, size_t size)>;
+
+  // Returns null if |coding| cannot be decoded by this build.
+  static std::unique_ptr<ContentDecoder> Create(ContentCoding coding,
+                                                Sink sink);
+
+  virtual ~ContentDecoder();
+
+  // Prevent copying.
+  ContentDecoder(ContentDecoder const&) = delete;
+  ContentDecoder& operator=(ContentDecoder const&) = delete;
+
+  // Decodes the next chunk of the body. Returns false, and ignores any
+  // further input, once the body turns out to be corrupt.
+  virtual bool Feed(const char* data, size_t size) = 0;
+
+  // Marks the end of the body. Returns false if it was corrupt or truncated.
+  virtual bool Finish() = 0;
+
+  // Why decoding failed.
+  const std::string& error() const { return error_; }
+
+ protected:
+  ContentDecoder() = default;
+
+  std::string error_;
+};
+
+// gzip-compresses |size| bytes at |data| into |compressed|, deflating in
+// fixed-size steps. Returns false if compression is not available.
+NATIVE_CORE_EXPORT bool GzipCompress(const uint8_t* data,
+                                     size_t size,
+                                     std::vector<uint8_t>* compressed);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CONTENT_CODING_H_
@@ -0,0 +1,67 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_CURL_HTTP_CLIENT_H_
+#define NATIVE_CORE_CURL_HTTP_CLIENT_H_
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#include "export.h"
+#include "http_client.h"
+
+namespace native_core {
+
+// HTTP client for hosts without WinHTTP (the headless tools), backed by
+// libcurl.
+//
+// The easy handles used by Post() share one connection cache, TLS session
+// cache and DNS cache, so a connection left open by one request is picked up
+// by the next one whatever the thread, and new connections resume the TLS
+// session of earlier ones.
+class NATIVE_CORE_EXPORT CurlHttpClient : public HttpClient {
+ public:
+  explicit CurlHttpClient(HttpClientOptions options);
+  ~CurlHttpClient() override;
+
+  // Prevent copying.
+  CurlHttpClient(CurlHttpClient const&) = delete;
+  CurlHttpClient& operator=(CurlHttpClient const&) = delete;
+
+ protected:
+  // HttpClient:
+  void Perform(const std::string& url,
+               const HttpHeaders& headers,
+               const std::vector<uint8_t>& body,
+               const Sink& sink,
+               Exchange* exchange) override;
+
+ private:
+  // Returns an idle easy handle, or a new one.
+  void* AcquireHandle();
+  void ReleaseHandle(void* handle);
+
+  // A CURLSH and CURL handles; kept opaque so that users need no libcurl
+  // headers.
+  void* share_ = nullptr;
+  // Guard the data shared through |share_|, one per curl_lock_data value.
+  std::array<std::mutex, 8> share_locks_;
+
+  std::mutex handles_mutex_;
+  std::vector<void*> idle_handles_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_CURL_HTTP_CLIENT_H_
@@ -0,0 +1,62 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_DIGEST_H_
+#define NATIVE_CORE_DIGEST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "export.h"
+#include "pkcs1_signer.h"
+
+namespace native_core {
+
+// SHA-1 and SHA-2 hashing, the same on every platform, for the structures
+// that are signed locally (the message digest of a document, the hash of a
+// certificate). The data to sign itself is hashed by the Pkcs1Signer.
+class NATIVE_CORE_EXPORT Digester {
+ public:
+  explicit Digester(DigestAlgorithm algorithm);
+
+  // Hashes |size| more bytes. Not to be called after Finish().
+  void Update(const uint8_t* data, size_t size);
+
+  // The hash of everything passed to Update().
+  std::vector<uint8_t> Finish();
+
+  // Size in bytes of the hashes of |algorithm|.
+  static size_t SizeOf(DigestAlgorithm algorithm);
+
+ private:
+  void Compress(const uint8_t* block);
+
+  DigestAlgorithm algorithm_;
+  // 64-byte blocks for SHA-1 and SHA-256, 128-byte ones for SHA-384/512.
+  size_t block_size_;
+  // SHA-1 and SHA-256 keep their 32-bit words in the low half.
+  uint64_t state_[8];
+  uint8_t buffer_[128];
+  size_t buffered_ = 0;
+  uint64_t length_ = 0;
+};
+
+// Hashes |size| bytes of |data| at once.
+NATIVE_CORE_EXPORT std::vector<uint8_t> Digest(DigestAlgorithm algorithm,
+                                               const uint8_t* data,
+                                               size_t size);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_DIGEST_H_
@@ -0,0 +1,56 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_EVENTFD_WAKEUP_H_
+#define NATIVE_CORE_EVENTFD_WAKEUP_H_
+
+#include "export.h"
+#include "wakeup.h"
+
+namespace native_core {
+
+// Wake-up for hosts without a window message loop (the headless tools).
+//
+// Backed by an eventfd on Linux and by a non-blocking pipe on other POSIX
+// systems. The host loop polls fd() or calls Wait(), then Consume()s the
+// signal before draining the dispatcher.
+class NATIVE_CORE_EXPORT EventFdWakeup : public Wakeup {
+ public:
+  EventFdWakeup();
+  ~EventFdWakeup() override;
+
+  // Prevent copying.
+  EventFdWakeup(EventFdWakeup const&) = delete;
+  EventFdWakeup& operator=(EventFdWakeup const&) = delete;
+
+  // Wakeup:
+  void Signal() override;
+
+  // Blocks until signalled or until |timeout_ms| elapses (-1 waits forever).
+  // Returns true if signalled.
+  bool Wait(int timeout_ms);
+
+  // Resets the signalled state.
+  void Consume();
+
+  // Readable while signalled.
+  int fd() const { return read_fd_; }
+
+ private:
+  int read_fd_ = -1;
+  int write_fd_ = -1;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_EVENTFD_WAKEUP_H_
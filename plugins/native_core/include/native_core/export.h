@@ -0,0 +1,29 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_EXPORT_H_
+#define NATIVE_CORE_EXPORT_H_
+
+#if defined(NATIVE_CORE_STATIC)
+#define NATIVE_CORE_EXPORT
+#elif defined(_WIN32)
+#ifdef NATIVE_CORE_IMPL
+#define NATIVE_CORE_EXPORT __declspec(dllexport)
+#else
+#define NATIVE_CORE_EXPORT __declspec(dllimport)
+#endif
+#else
+#define NATIVE_CORE_EXPORT __attribute__((visibility("default")))
+#endif
+
+#endif  // NATIVE_CORE_EXPORT_H_
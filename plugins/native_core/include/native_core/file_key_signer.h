@@ -0,0 +1,60 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_FILE_KEY_SIGNER_H_
+#define NATIVE_CORE_FILE_KEY_SIGNER_H_
+
+#include <memory>
+#include <string>
+
+#include "export.h"
+#include "pkcs1_signer.h"
+
+namespace native_core {
+
+// Signs with an RSA private key read from a PEM file, through OpenSSL. This is
+// the key backend of the headless tools, which run where there is no Windows
+// certificate store.
+class NATIVE_CORE_EXPORT FileKeySigner : public Pkcs1Signer {
+ public:
+  // Loads an unencrypted PEM private key (PKCS#1 or PKCS#8), and the
+  // certificate that follows it in the same file if there is one. Returns
+  // null, with a description in |error|, if the key cannot be read.
+  static std::unique_ptr<FileKeySigner> Open(const std::string& path,
+                                             std::string* error);
+
+  ~FileKeySigner() override;
+
+  // Prevent copying.
+  FileKeySigner(FileKeySigner const&) = delete;
+  FileKeySigner& operator=(FileKeySigner const&) = delete;
+
+  bool Sign(std::string_view algorithm,
+            const uint8_t* data,
+            size_t size,
+            std::vector<uint8_t>* signature,
+            std::string* error) override;
+
+  std::vector<uint8_t> Certificate() const override;
+
+ private:
+  // An EVP_PKEY; kept opaque so that users need no OpenSSL headers.
+  FileKeySigner(void* key, std::vector<uint8_t> certificate);
+
+  void* key_;
+  std::vector<uint8_t> certificate_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_FILE_KEY_SIGNER_H_
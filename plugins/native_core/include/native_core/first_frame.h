@@ -0,0 +1,41 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_FIRST_FRAME_H_
+#define NATIVE_CORE_FIRST_FRAME_H_
+
+#include <functional>
+
+#include "export.h"
+
+namespace native_core {
+
+// Startup work that should not compete with the first frame.
+//
+// Plugins queue deferrable initialization with RunAfterFirstFrame(); the
+// runner calls NotifyFirstFrame() once the first frame has been rendered.
+// Hosts without a UI (the headless tools) call it right away.
+
+// Runs |task| on the platform thread once the first frame has been rendered,
+// or immediately if it already has. Platform thread only.
+NATIVE_CORE_EXPORT void RunAfterFirstFrame(std::function<void()> task);
+
+// Releases the tasks queued by RunAfterFirstFrame(). Later calls do nothing.
+// Platform thread only.
+NATIVE_CORE_EXPORT void NotifyFirstFrame();
+
+NATIVE_CORE_EXPORT bool HasRenderedFirstFrame();
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_FIRST_FRAME_H_
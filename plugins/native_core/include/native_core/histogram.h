@@ -0,0 +1,74 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_HISTOGRAM_H_
+#define NATIVE_CORE_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "export.h"
+
+namespace native_core {
+
+// Log-linear histogram of durations.
+//
+// Each power of two is split in kSubBuckets linear buckets, which bounds the
+// relative error of a reported percentile to 1 / kSubBuckets. Recording is
+// wait-free so it can be done from hot paths on any thread while another
+// thread reads a snapshot.
+class NATIVE_CORE_EXPORT DurationHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kBucketCount = 64 * kSubBuckets;
+
+  DurationHistogram();
+
+  // Prevent copying.
+  DurationHistogram(DurationHistogram const&) = delete;
+  DurationHistogram& operator=(DurationHistogram const&) = delete;
+
+  void Record(std::chrono::nanoseconds duration);
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  std::chrono::nanoseconds total() const {
+    return std::chrono::nanoseconds(total_ns_.load(std::memory_order_relaxed));
+  }
+
+  std::chrono::nanoseconds max() const {
+    return std::chrono::nanoseconds(max_ns_.load(std::memory_order_relaxed));
+  }
+
+  // Upper bound of the bucket holding the |percentile|-th sample (0-100).
+  // Returns zero when nothing has been recorded.
+  std::chrono::nanoseconds Percentile(double percentile) const;
+
+  void Reset();
+
+ private:
+  static int BucketFor(uint64_t value);
+  static uint64_t BucketUpperBound(int bucket);
+
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_ns_{0};
+  std::atomic<uint64_t> max_ns_{0};
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_HISTOGRAM_H_
@@ -0,0 +1,227 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_HTTP_CLIENT_H_
+#define NATIVE_CORE_HTTP_CLIENT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+#include "histogram.h"
+
+namespace native_core {
+
+// Request headers as name and value pairs, sent in order.
+using HttpHeaders = std::vector<std::pair<std::string, std::string>>;
+
+struct HttpResponse {
+  // HTTP status, or 0 if no complete response was received.
+  int status = 0;
+  // Header names are lowercased and repeated headers joined with ",", as
+  // package:http does.
+  std::map<std::string, std::string> headers;
+  // Why there is no response, for the logs.
+  std::string error;
+};
+
+struct HttpClientOptions {
+  // Connections kept alive per host, which is also how many requests to a
+  // host may be in flight. Further requests wait for a free connection
+  // instead of opening new ones.
+  size_t max_connections_per_host = 4;
+  // PEM file with additional trusted certificates, e.g. those of a test
+  // server. Only used where the system trust store is not (libcurl).
+  std::string ca_file;
+  // Origins ("https://host:port") that take gzip-compressed request bodies,
+  // to which bodies of at least |compress_requests_from| bytes are sent
+  // compressed. Servers rarely decode request bodies, and an Accept-Encoding
+  // response header (RFC 7694) is only a hint, so no other origin is sent
+  // one. See also HttpClient::CompressRequests().
+  std::vector<std::string> compress_requests_to;
+  size_t compress_requests_from = 1024;
+};
+
+// Counters since the client was created.
+struct HttpStats {
+  uint64_t requests = 0;
+  // Requests that got no complete response.
+  uint64_t failures = 0;
+  // Requests that had to open a connection, and those served by a pooled
+  // one. Both stay at zero where the platform does not tell them apart.
+  uint64_t connections_opened = 0;
+  uint64_t connections_reused = 0;
+  // TLS handshakes on new connections: full ones and abbreviated ones that
+  // resumed an earlier session.
+  uint64_t tls_full_handshakes = 0;
+  uint64_t tls_resumed_handshakes = 0;
+  // Bytes on the wire.
+  uint64_t bytes_sent = 0;
+  uint64_t bytes_received = 0;
+  // Compressed responses: bytes on the wire and once decoded.
+  uint64_t encoded_response_bytes = 0;
+  uint64_t decoded_response_bytes = 0;
+  // Compressed requests: bytes before and after compression.
+  uint64_t plain_request_bytes = 0;
+  uint64_t compressed_request_bytes = 0;
+};
+
+// HTTP client for the proxy API, shared by every request of the process.
+//
+// Connections are kept alive and pooled per host, and TLS sessions are cached
+// so that the connections that still have to be opened resume them instead of
+// doing a full handshake. The JSESSIONID cookie set by the proxy is kept per
+// host and sent with the requests that carry no Cookie header of their own.
+//
+// Responses are requested compressed and decoded as they arrive, so that the
+// sink sees the plain body. Request bodies are compressed only for the origins
+// opted in, and sent again uncompressed, for good, if one answers 415.
+//
+// Every request is a POST, which is not idempotent and so is never
+// pipelined. Where the server negotiates HTTP/2 (WinHTTP) concurrent requests
+// are multiplexed over a single connection instead.
+//
+// Post() blocks and may be called from several threads at once.
+class NATIVE_CORE_EXPORT HttpClient {
+ public:
+  using Sink = std::function<void(const char* data, size_t size)>;
+
+  // Creates the client of the platform: WinHTTP on Windows and libcurl
+  // elsewhere.
+  static std::unique_ptr<HttpClient> Create(
+      HttpClientOptions options = HttpClientOptions());
+
+  virtual ~HttpClient();
+
+  // Prevent copying.
+  HttpClient(HttpClient const&) = delete;
+  HttpClient& operator=(HttpClient const&) = delete;
+
+  // Posts |body| to |url| and hands the response body to |sink| as it
+  // arrives and is decoded, whatever the status.
+  HttpResponse Post(const std::string& url,
+                    const HttpHeaders& headers,
+                    const std::vector<uint8_t>& body,
+                    const Sink& sink);
+
+  // Forgets the session cookies, e.g. on logout.
+  void ClearSession();
+
+  // Opts the origin of |url| in or out of compressed request bodies, as
+  // HttpClientOptions::compress_requests_to does.
+  void CompressRequests(const std::string& url, bool enabled);
+
+  HttpStats stats() const;
+
+  // Duration of the requests that opened a connection and of those served by
+  // a pooled one; the difference is what keep-alive saves.
+  const DurationHistogram& new_connection_times() const {
+    return new_connection_times_;
+  }
+  const DurationHistogram& reused_connection_times() const {
+    return reused_connection_times_;
+  }
+
+ protected:
+  // What the backend reports about one request. |status| and |headers| are
+  // set before the body is handed to the sink; |status| goes back to 0 if
+  // the response is not received completely.
+  struct Exchange {
+    int status = 0;
+    // Names lowercased, in the order received.
+    HttpHeaders headers;
+    std::string error;
+    // Whether the backend could tell how the connection was obtained.
+    bool connection_known = false;
+    bool new_connection = false;
+    bool tls = false;
+    bool tls_resumed = false;
+  };
+
+  explicit HttpClient(HttpClientOptions options);
+
+  // Sends the request as given and fills |exchange|. |sink| receives the
+  // response body as it came on the wire.
+  virtual void Perform(const std::string& url,
+                       const HttpHeaders& headers,
+                       const std::vector<uint8_t>& body,
+                       const Sink& sink,
+                       Exchange* exchange) = 0;
+
+  // Whether the backend negotiates and decodes compressed responses itself,
+  // in which case the body it hands to the sink is already decoded.
+  virtual bool DecodesResponses() const { return false; }
+
+  const HttpClientOptions& options() const { return options_; }
+
+ private:
+  // What is known of a host.
+  struct Origin {
+    // "JSESSIONID=...", or empty.
+    std::string session_cookie;
+    // Whether request bodies are sent to it gzip-compressed.
+    bool compress_requests = false;
+  };
+
+  // Performs one request, decoding the response for |sink|. With
+  // |compressed| a 415 response is not handed to the sink.
+  void Send(const std::string& origin,
+            const std::string& url,
+            const HttpHeaders& headers,
+            const std::vector<uint8_t>& body,
+            bool compressed,
+            const Sink& sink,
+            Exchange* exchange);
+
+  // Bound the requests in flight to the host of |origin|.
+  void AcquireSlot(const std::string& origin);
+  void ReleaseSlot(const std::string& origin);
+
+  const HttpClientOptions options_;
+
+  std::mutex slots_mutex_;
+  std::condition_variable slot_released_;
+  // Requests in flight by origin.
+  std::map<std::string, size_t> in_flight_;
+
+  std::mutex origins_mutex_;
+  std::map<std::string, Origin> origins_;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> failures_{0};
+  std::atomic<uint64_t> connections_opened_{0};
+  std::atomic<uint64_t> connections_reused_{0};
+  std::atomic<uint64_t> tls_full_handshakes_{0};
+  std::atomic<uint64_t> tls_resumed_handshakes_{0};
+  std::atomic<uint64_t> bytes_sent_{0};
+  std::atomic<uint64_t> bytes_received_{0};
+  std::atomic<uint64_t> encoded_response_bytes_{0};
+  std::atomic<uint64_t> decoded_response_bytes_{0};
+  std::atomic<uint64_t> plain_request_bytes_{0};
+  std::atomic<uint64_t> compressed_request_bytes_{0};
+  DurationHistogram new_connection_times_;
+  DurationHistogram reused_connection_times_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_HTTP_CLIENT_H_
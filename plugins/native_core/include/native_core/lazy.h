@@ -0,0 +1,82 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_LAZY_H_
+#define NATIVE_CORE_LAZY_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "first_frame.h"
+#include "runtime.h"
+
+namespace native_core {
+
+// A value whose construction is deferred until it is first needed, or until
+// the background after the first frame, whichever comes first.
+//
+// Get() may be called from any thread. If a background construction is in
+// progress, Get() waits for it instead of constructing a second instance.
+template <typename T>
+class Lazy {
+ public:
+  using Factory = std::function<std::unique_ptr<T>()>;
+
+  explicit Lazy(Factory factory) : factory_(std::move(factory)) {}
+
+  // Prevent copying.
+  Lazy(Lazy const&) = delete;
+  Lazy& operator=(Lazy const&) = delete;
+
+  T& Get() {
+    std::call_once(once_, [this]() {
+      value_ = factory_();
+      initialized_.store(true, std::memory_order_release);
+    });
+    return *value_;
+  }
+
+  bool IsInitialized() const {
+    return initialized_.load(std::memory_order_acquire);
+  }
+
+  // Constructs the value on the shared worker pool once the first frame has
+  // been rendered. Platform thread only. |this| must outlive the pool task,
+  // which holds for plugin members: plugins live until the process exits.
+  void WarmAfterFirstFrame() {
+    RunAfterFirstFrame([this]() {
+      if (!IsInitialized()) {
+        Runtime::Get().pool().TryPost([this]() { Get(); });
+      }
+    });
+  }
+
+  // Constructs the value on the shared worker pool right away.
+  void WarmNow() {
+    if (!IsInitialized()) {
+      Runtime::Get().pool().TryPost([this]() { Get(); });
+    }
+  }
+
+ private:
+  Factory factory_;
+  std::once_flag once_;
+  std::atomic<bool> initialized_{false};
+  std::unique_ptr<T> value_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_LAZY_H_
@@ -0,0 +1,155 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_LOG_SINK_H_
+#define NATIVE_CORE_LOG_SINK_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "export.h"
+#include "mpsc_ring.h"
+
+namespace native_core {
+
+// What Write() does when the buffered records reach the limits.
+enum class LogOverflow {
+  // Drops the record. The file gets a line saying how many were dropped.
+  kDrop,
+  // Waits for the writer thread to make room.
+  kBlock,
+};
+
+struct LogSinkOptions {
+  // UTF-8 path of the log file.
+  std::string path;
+  // Start with an empty file instead of appending to the existing one.
+  bool truncate = false;
+  // The file is rotated before it grows past this size: it becomes
+  // "<path>.1", the previous "<path>.1" becomes "<path>.2" and so on. Zero
+  // turns rotation off.
+  uint64_t max_file_bytes = 8 * 1024 * 1024;
+  // Rotated files kept; older ones are deleted.
+  size_t max_rotated_files = 3;
+  // gzip rotated files ("<path>.1.gz"). Ignored if the build has no zlib.
+  bool compress_rotated = false;
+  // Memory bound: records waiting to be written, and their total size. A
+  // record larger than |max_buffered_bytes| is still accepted into an empty
+  // buffer.
+  size_t max_buffered_records = 4096;
+  size_t max_buffered_bytes = 16 * 1024 * 1024;
+  LogOverflow overflow = LogOverflow::kDrop;
+  // How long a record may wait before it is written, unless a batch of
+  // |batch_bytes| fills up first.
+  std::chrono::milliseconds flush_interval{200};
+  size_t batch_bytes = 64 * 1024;
+};
+
+// Counters since the sink was opened.
+struct LogSinkStats {
+  uint64_t records = 0;
+  uint64_t dropped = 0;
+  uint64_t bytes_written = 0;
+  // Writes to the file, each holding every record buffered at the time.
+  uint64_t batches = 0;
+  uint64_t rotations = 0;
+};
+
+// Appends log records to a file from a background thread.
+//
+// Write() only moves the record into a lock-free ring buffer, so the thread
+// that logs never touches the file. The writer thread wakes up when a batch
+// fills up or the flush interval passes, and writes everything buffered with
+// a single call, rotating the file by size on the way. Records are written
+// as given and in the order Write() accepted them.
+class NATIVE_CORE_EXPORT LogSink {
+ public:
+  // Opens the file and starts the writer thread. Returns null if the file
+  // cannot be opened.
+  static std::unique_ptr<LogSink> Open(LogSinkOptions options);
+
+  // Writes what is buffered and joins the writer thread.
+  ~LogSink();
+
+  // Prevent copying.
+  LogSink(LogSink const&) = delete;
+  LogSink& operator=(LogSink const&) = delete;
+
+  // Queues |record|, which should end with its own line break. Returns false
+  // if it was dropped. May be called from any thread.
+  bool Write(std::string record);
+
+  // Blocks until every record accepted so far is written to the file.
+  void Flush();
+
+  LogSinkStats stats() const;
+
+ private:
+  LogSink(LogSinkOptions options, std::FILE* file, uint64_t file_size);
+
+  void WriterMain();
+
+  // Writes |batch| to the file, rotating it first if it would grow too big.
+  void WriteBatch(const std::string& batch);
+
+  // Renames the file to "<path>.1" (compressing it if asked to), shifting the
+  // older ones, and opens a new one.
+  void Rotate();
+
+  std::string RotatedPath(size_t index) const;
+
+  const LogSinkOptions options_;
+
+  MpscRing<std::string> records_;
+  std::atomic<size_t> buffered_bytes_{0};
+
+  // Only used by the writer thread (and the constructor).
+  std::FILE* file_;
+  uint64_t file_size_;
+
+  std::mutex mutex_;
+  // Signalled by writers to wake the writer thread, and by the writer thread
+  // when there is room again or a flush completed.
+  std::condition_variable work_available_;
+  std::condition_variable room_available_;
+  std::condition_variable flushed_;
+  bool stopping_ = false;
+  // Flush() requests and the last one served.
+  uint64_t flush_requested_ = 0;
+  uint64_t flush_done_ = 0;
+  // The same for writers blocked on a full buffer, so that they wake the
+  // writer thread before the flush interval passes.
+  uint64_t room_requested_ = 0;
+  uint64_t room_done_ = 0;
+
+  std::atomic<uint64_t> records_written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+  std::atomic<uint64_t> batches_{0};
+  std::atomic<uint64_t> rotations_{0};
+
+  // Declared last so that everything it uses exists while it runs.
+  std::thread writer_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_LOG_SINK_H_
@@ -0,0 +1,60 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_MAPPED_FILE_H_
+#define NATIVE_CORE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "export.h"
+
+namespace native_core {
+
+// A whole file mapped read-only into memory.
+//
+// Pages are read in as they are touched, so opening a large file costs the
+// same as a small one. The file must not be truncated while it is mapped.
+class NATIVE_CORE_EXPORT MappedFile {
+ public:
+  // Maps the file at the UTF-8 |path|. Returns null if it does not exist,
+  // cannot be mapped or is empty.
+  static std::unique_ptr<MappedFile> Open(const std::string& path);
+
+  ~MappedFile();
+
+  // Prevent copying.
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Drops the pages of |size| bytes at |offset| from the working set of the
+  // process once they have been read, for one-pass reads of files larger
+  // than memory. They stay cached by the system and are read in again if
+  // touched.
+  void Release(size_t offset, size_t size) const;
+
+ private:
+  MappedFile(const uint8_t* data, size_t size);
+
+  const uint8_t* data_;
+  size_t size_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_MAPPED_FILE_H_
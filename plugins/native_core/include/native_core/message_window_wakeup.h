@@ -0,0 +1,55 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_MESSAGE_WINDOW_WAKEUP_H_
+#define NATIVE_CORE_MESSAGE_WINDOW_WAKEUP_H_
+
+#include <windows.h>
+
+#include <functional>
+
+#include "export.h"
+#include "wakeup.h"
+
+namespace native_core {
+
+// Wakes the platform thread by posting a message to a message-only window
+// owned by that thread. Whatever message loop the runner is running dispatches
+// it, so no cooperation from the Flutter view is needed.
+class NATIVE_CORE_EXPORT MessageWindowWakeup : public Wakeup {
+ public:
+  // Must be constructed on the platform thread. |on_wake| runs there for every
+  // delivered wake-up.
+  explicit MessageWindowWakeup(std::function<void()> on_wake);
+  ~MessageWindowWakeup() override;
+
+  // Prevent copying.
+  MessageWindowWakeup(MessageWindowWakeup const&) = delete;
+  MessageWindowWakeup& operator=(MessageWindowWakeup const&) = delete;
+
+  // Wakeup:
+  void Signal() override;
+
+ private:
+  static LRESULT CALLBACK WndProc(HWND const window,
+                                  UINT const message,
+                                  WPARAM const wparam,
+                                  LPARAM const lparam) noexcept;
+
+  std::function<void()> on_wake_;
+  HWND window_ = nullptr;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_MESSAGE_WINDOW_WAKEUP_H_
@@ -0,0 +1,466 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_METHOD_DISPATCH_H_
+#define NATIVE_CORE_METHOD_DISPATCH_H_
+
+// Method-channel dispatch shared by the Windows plugins. Unlike the rest of
+// the runtime it is built on the Flutter C++ wrapper, so it is header-only
+// and compiled into each plugin.
+
+#include <flutter/encodable_value.h>
+#include <flutter/method_call.h>
+#include <flutter/method_result.h>
+#include <flutter/standard_message_codec.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "call_recorder.h"
+#include "call_tracker.h"
+#include "histogram.h"
+#include "method_table.h"
+
+namespace native_core {
+
+// Reads the arguments of a method call without exceptions, which the plugins
+// are built without, and without copying them: values are returned by
+// reference into the call, so whatever must outlive the handler is copied by
+// the handler itself.
+//
+// A missing argument, or one of another type, yields an empty value and
+// fails the reader. Handlers read everything they need, then check ok()
+// once:
+//
+//   const std::string& url = arguments.Get<std::string>("url");
+//   const std::vector<uint8_t>& body =
+//       arguments.Get<std::vector<uint8_t>>("body");
+//   if (!arguments.ok()) {
+//     result->Error("request_error", "Argumentos de la petición no válidos.");
+//     return;
+//   }
+class MethodArguments {
+ public:
+  explicit MethodArguments(const flutter::EncodableValue* value)
+      : value_(value),
+        map_(value ? std::get_if<flutter::EncodableMap>(value) : nullptr) {}
+
+  // Prevent copying.
+  MethodArguments(MethodArguments const&) = delete;
+  MethodArguments& operator=(MethodArguments const&) = delete;
+
+  // Whether every argument read so far was there with the expected type.
+  bool ok() const { return !failed_; }
+
+  // The arguments as a whole, for calls that do not send a map. Returns null
+  // if they are not a T; this does not fail the reader.
+  template <typename T>
+  const T* As() const {
+    return value_ ? std::get_if<T>(value_) : nullptr;
+  }
+
+  // The |name| argument.
+  template <typename T>
+  const T& Get(const char* name) const {
+    return Get<T>(map_, name);
+  }
+
+  // The |name| argument, or null if it is missing or null.
+  template <typename T>
+  const T* Optional(const char* name) const {
+    return Optional<T>(map_, name);
+  }
+
+  // The |name| argument as an integer, which the codec sends as a 32 or 64
+  // bit one depending on its value.
+  int64_t Integer(const char* name) const {
+    return Integer(Find(map_, name));
+  }
+
+  // The same for the values nested in the arguments: the fields of a map, the
+  // elements of a list, or a value itself.
+  template <typename T>
+  const T& Get(const flutter::EncodableValue& value) const {
+    return Expect<T>(&value);
+  }
+
+  template <typename T>
+  const T& Get(const flutter::EncodableMap& map, const char* name) const {
+    return Get<T>(&map, name);
+  }
+
+  template <typename T>
+  const T* Optional(const flutter::EncodableMap& map, const char* name) const {
+    return Optional<T>(&map, name);
+  }
+
+  template <typename T>
+  const T& Get(const flutter::EncodableList& list, size_t index) const {
+    return Expect<T>(index < list.size() ? &list[index] : nullptr);
+  }
+
+  template <typename T>
+  const T* Optional(const flutter::EncodableList& list, size_t index) const {
+    return OrNull<T>(index < list.size() ? &list[index] : nullptr);
+  }
+
+ private:
+  static const flutter::EncodableValue* Find(const flutter::EncodableMap* map,
+                                             const char* name) {
+    if (!map) {
+      return nullptr;
+    }
+    auto it = map->find(flutter::EncodableValue(name));
+    return it != map->end() ? &it->second : nullptr;
+  }
+
+  template <typename T>
+  const T& Get(const flutter::EncodableMap* map, const char* name) const {
+    return Expect<T>(Find(map, name));
+  }
+
+  template <typename T>
+  const T* Optional(const flutter::EncodableMap* map, const char* name) const {
+    return OrNull<T>(Find(map, name));
+  }
+
+  template <typename T>
+  const T& Expect(const flutter::EncodableValue* value) const {
+    static const T kEmpty{};
+    const T* typed = value ? std::get_if<T>(value) : nullptr;
+    if (!typed) {
+      failed_ = true;
+      return kEmpty;
+    }
+    return *typed;
+  }
+
+  template <typename T>
+  const T* OrNull(const flutter::EncodableValue* value) const {
+    if (!value || value->IsNull()) {
+      return nullptr;
+    }
+    const T* typed = std::get_if<T>(value);
+    if (!typed) {
+      failed_ = true;
+    }
+    return typed;
+  }
+
+  int64_t Integer(const flutter::EncodableValue* value) const {
+    if (value) {
+      if (const auto* small = std::get_if<int32_t>(value)) {
+        return *small;
+      }
+      if (const auto* large = std::get_if<int64_t>(value)) {
+        return *large;
+      }
+    }
+    failed_ = true;
+    return 0;
+  }
+
+  const flutter::EncodableValue* value_;
+  const flutter::EncodableMap* map_;
+  // Reading is logically const; only the outcome is kept.
+  mutable bool failed_ = false;
+};
+
+// Calls to one method of a channel.
+struct MethodCallStats {
+  // Time the handler held the platform thread.
+  DurationHistogram handler_times;
+  // Time until the call was answered, which for work run on the pool or on
+  // the network is later.
+  DurationHistogram answer_times;
+  std::atomic<uint64_t> errors{0};
+};
+
+namespace internal {
+
+// Whether T is one of the typed lists of EncodableValue (of bytes, integers
+// or floating point numbers).
+template <typename T>
+struct IsTypedList : std::false_type {};
+
+template <typename Element>
+struct IsTypedList<std::vector<Element>> : std::is_arithmetic<Element> {};
+
+// Where |value| ends when the StandardMessageCodec writes it |offset| bytes
+// into a message, worked out without encoding it: a type byte, a size for
+// strings and collections (1, 3 or 5 bytes), and the contents, with numbers
+// aligned to their size from the start of the message.
+inline size_t EncodedEnd(const flutter::EncodableValue& value, size_t offset) {
+  auto size_end = [](size_t size, size_t at) {
+    return at + (size < 254 ? 1 : size <= 0xffff ? 3 : 5);
+  };
+  auto align = [](size_t at, size_t alignment) {
+    return (at + alignment - 1) / alignment * alignment;
+  };
+  // Past the type byte.
+  offset++;
+  return std::visit(
+      [&](const auto& content) -> size_t {
+        using T = std::decay_t<decltype(content)>;
+        if constexpr (std::is_same_v<T, int32_t>) {
+          return offset + 4;
+        }
+        else if constexpr (std::is_same_v<T, int64_t>) {
+          return offset + 8;
+        }
+        else if constexpr (std::is_same_v<T, double>) {
+          return align(offset, 8) + 8;
+        }
+        else if constexpr (std::is_same_v<T, std::string>) {
+          return size_end(content.size(), offset) + content.size();
+        }
+        else if constexpr (std::is_same_v<T, flutter::EncodableList>) {
+          size_t end = size_end(content.size(), offset);
+          for (const flutter::EncodableValue& element : content) {
+            end = EncodedEnd(element, end);
+          }
+          return end;
+        }
+        else if constexpr (std::is_same_v<T, flutter::EncodableMap>) {
+          size_t end = size_end(content.size(), offset);
+          for (const auto& [key, element] : content) {
+            end = EncodedEnd(element, EncodedEnd(key, end));
+          }
+          return end;
+        }
+        else if constexpr (IsTypedList<T>::value) {
+          // Empty ones are not aligned.
+          using Element = typename T::value_type;
+          size_t end = size_end(content.size(), offset);
+          if (content.empty()) {
+            return end;
+          }
+          return align(end, sizeof(Element)) + content.size() * sizeof(Element);
+        }
+        else {
+          return offset;
+        }
+      },
+      static_cast<const flutter::EncodableValue::super&>(value));
+}
+
+// Bytes of |value| encoded on its own, as a message.
+inline size_t EncodedSize(const flutter::EncodableValue& value) {
+  return EncodedEnd(value, 0);
+}
+
+// Answers the wrapped result, timing the answer and recording it in the call
+// trace.
+class DispatchedResult : public flutter::MethodResult<> {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  DispatchedResult(MethodCallStats* stats,
+                   Clock::time_point start,
+                   CallRecorder* recorder,
+                   uint64_t call,
+                   std::unique_ptr<flutter::MethodResult<>> result)
+      : stats_(stats),
+        start_(start),
+        recorder_(recorder),
+        call_(call),
+        result_(std::move(result)) {}
+
+ protected:
+  void SuccessInternal(const flutter::EncodableValue* value) override {
+    Answered(CallOutcome::kSuccess, value ? EncodedSize(*value) : 0);
+    if (value) {
+      result_->Success(*value);
+    }
+    else {
+      result_->Success();
+    }
+  }
+
+  void ErrorInternal(const std::string& code,
+                     const std::string& message,
+                     const flutter::EncodableValue* details) override {
+    Answered(CallOutcome::kError, code.size() + message.size());
+    if (details) {
+      result_->Error(code, message, *details);
+    }
+    else {
+      result_->Error(code, message);
+    }
+  }
+
+  void NotImplementedInternal() override {
+    Answered(CallOutcome::kNotImplemented, 0);
+    result_->NotImplemented();
+  }
+
+ private:
+  void Answered(CallOutcome outcome, size_t result_size) {
+    if (stats_) {
+      stats_->answer_times.Record(Clock::now() - start_);
+      if (outcome == CallOutcome::kError) {
+        stats_->errors.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (recorder_) {
+      recorder_->End(call_, outcome, result_size);
+    }
+  }
+
+  // Only worked out when recording, which is when the size is kept.
+  size_t EncodedSize(const flutter::EncodableValue& value) const {
+    return recorder_ ? internal::EncodedSize(value) : 0;
+  }
+
+  MethodCallStats* stats_;
+  Clock::time_point start_;
+  CallRecorder* recorder_;
+  uint64_t call_;
+  std::unique_ptr<flutter::MethodResult<>> result_;
+};
+
+}  // namespace internal
+
+// Dispatches the calls of a channel to the member functions of |Plugin|
+// named in a MethodTable, and around each call:
+//
+//  - tells the runner's watchdog which call the platform thread is in,
+//  - records the call in the call trace, when PORTAFIRMAS_CALL_TRACE is set,
+//  - times the handler and the answer of each method, for Stats().
+//
+// Unknown methods are answered as not implemented. Platform thread only.
+template <typename Plugin>
+class MethodDispatcher {
+ public:
+  using Handler = void (Plugin::*)(
+      const MethodArguments& arguments,
+      std::unique_ptr<flutter::MethodResult<>> result);
+  using Table = MethodTable<Handler>;
+
+  // |table| must outlive the dispatcher; it is meant to be constexpr.
+  MethodDispatcher(std::string channel, const Table* table)
+      : channel_(std::move(channel)),
+        table_(table),
+        stats_(std::make_unique<MethodCallStats[]>(table->size())) {}
+
+  // Prevent copying.
+  MethodDispatcher(MethodDispatcher const&) = delete;
+  MethodDispatcher& operator=(MethodDispatcher const&) = delete;
+
+  void Dispatch(Plugin* plugin,
+                const flutter::MethodCall<>& method_call,
+                std::unique_ptr<flutter::MethodResult<>> result) {
+    using Clock = internal::DispatchedResult::Clock;
+    Clock::time_point start = Clock::now();
+    const std::string& method = method_call.method_name();
+    // Lets the runner's watchdog attribute a platform thread stall to this
+    // call.
+    CallScope call_scope(channel_, method);
+
+    // Keeps the call for replaying, encoded as on the channel, which is also
+    // what the replay decodes. Without payloads only the size is kept, and
+    // it is worked out without encoding the arguments.
+    CallRecorder* recorder = CallRecorder::Get();
+    uint64_t call = 0;
+    if (recorder) {
+      static const flutter::EncodableValue kNoArguments;
+      const flutter::EncodableValue& arguments =
+          method_call.arguments() ? *method_call.arguments() : kNoArguments;
+      if (recorder->payloads()) {
+        std::unique_ptr<std::vector<uint8_t>> encoded =
+            flutter::StandardMessageCodec::GetInstance().EncodeMessage(
+                arguments);
+        call =
+            recorder->Begin(channel_, method, encoded->size(), encoded.get());
+      }
+      else {
+        call = recorder->Begin(channel_, method,
+                               internal::EncodedSize(arguments), nullptr);
+      }
+    }
+
+    int index = table_->IndexOf(method);
+    MethodCallStats* stats = index >= 0 ? &stats_[index] : nullptr;
+    result = std::make_unique<internal::DispatchedResult>(
+        stats, start, recorder, call, std::move(result));
+    if (!stats) {
+      result->NotImplemented();
+    }
+    else {
+      MethodArguments arguments(method_call.arguments());
+      (plugin->*(*table_)[index].handler)(arguments, std::move(result));
+      stats->handler_times.Record(Clock::now() - start);
+    }
+
+    if (recorder) {
+      recorder->Return(call);
+    }
+  }
+
+  // The calls so far to each method called at least once, by name: their
+  // count and errors, and the percentiles of their handler and answer times
+  // in microseconds.
+  flutter::EncodableValue Stats() const {
+    auto count = [](uint64_t value) {
+      return flutter::EncodableValue(static_cast<int64_t>(value));
+    };
+    auto micros = [](std::chrono::nanoseconds duration) {
+      return flutter::EncodableValue(static_cast<int64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(duration)
+              .count()));
+    };
+    flutter::EncodableMap methods;
+    for (size_t i = 0; i < table_->size(); i++) {
+      const MethodCallStats& stats = stats_[i];
+      if (stats.handler_times.count() == 0) {
+        continue;
+      }
+      methods[flutter::EncodableValue(std::string((*table_)[i].name))] =
+          flutter::EncodableValue(flutter::EncodableMap{
+              {flutter::EncodableValue("calls"),
+               count(stats.handler_times.count())},
+              {flutter::EncodableValue("errors"),
+               count(stats.errors.load(std::memory_order_relaxed))},
+              {flutter::EncodableValue("handlerP50"),
+               micros(stats.handler_times.Percentile(50))},
+              {flutter::EncodableValue("handlerP99"),
+               micros(stats.handler_times.Percentile(99))},
+              {flutter::EncodableValue("handlerMax"),
+               micros(stats.handler_times.max())},
+              {flutter::EncodableValue("answerP50"),
+               micros(stats.answer_times.Percentile(50))},
+              {flutter::EncodableValue("answerP99"),
+               micros(stats.answer_times.Percentile(99))},
+              {flutter::EncodableValue("answerMax"),
+               micros(stats.answer_times.max())},
+          });
+    }
+    return flutter::EncodableValue(std::move(methods));
+  }
+
+ private:
+  const std::string channel_;
+  const Table* table_;
+  std::unique_ptr<MethodCallStats[]> stats_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_METHOD_DISPATCH_H_
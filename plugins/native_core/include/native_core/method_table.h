@@ -0,0 +1,119 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_METHOD_TABLE_H_
+#define NATIVE_CORE_METHOD_TABLE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+namespace native_core {
+
+namespace internal {
+
+// Not constexpr: reaching either while building a MethodTable in a constant
+// expression fails the build.
+inline void DuplicateMethodName() {}
+inline void TooManyMethods() {}
+
+}  // namespace internal
+
+// The methods of a channel and their handlers, looked up by name with a
+// perfect hash built at compile time: a call costs one hash and one string
+// comparison however many methods there are.
+//
+// Meant to be declared constexpr, so that the hash is searched for by the
+// compiler and a duplicate name does not build:
+//
+//   static constexpr MethodTable<Handler> kMethods = {
+//       {"createParser", &Plugin::CreateParser},
+//       {"feed", &Plugin::Feed},
+//   };
+template <typename Handler>
+class MethodTable {
+ public:
+  static constexpr size_t kMaxMethods = 64;
+
+  struct Entry {
+    std::string_view name;
+    Handler handler{};
+  };
+
+  constexpr MethodTable(std::initializer_list<Entry> entries) {
+    if (entries.size() > kMaxMethods) {
+      internal::TooManyMethods();
+    }
+    for (const Entry& entry : entries) {
+      for (size_t i = 0; i < size_; i++) {
+        if (entries_[i].name == entry.name) {
+          internal::DuplicateMethodName();
+        }
+      }
+      entries_[size_++] = entry;
+    }
+    // With four slots per method at most, a seed without collisions turns up
+    // within a few tries.
+    for (seed_ = 0;; seed_++) {
+      slots_ = {};
+      bool collided = false;
+      for (size_t i = 0; i < size_ && !collided; i++) {
+        uint8_t& slot = slots_[Hash(entries_[i].name, seed_) & kSlotMask];
+        collided = slot != 0;
+        slot = static_cast<uint8_t>(i + 1);
+      }
+      if (!collided) {
+        break;
+      }
+    }
+  }
+
+  constexpr size_t size() const { return size_; }
+
+  constexpr const Entry& operator[](size_t index) const {
+    return entries_[index];
+  }
+
+  // Returns the index of the method called |name|, or -1 if there is none.
+  constexpr int IndexOf(std::string_view name) const {
+    uint8_t slot = slots_[Hash(name, seed_) & kSlotMask];
+    return slot != 0 && entries_[slot - 1].name == name ? slot - 1 : -1;
+  }
+
+ private:
+  static constexpr size_t kSlots = 4 * kMaxMethods;
+  static constexpr size_t kSlotMask = kSlots - 1;
+  static_assert((kSlots & kSlotMask) == 0, "kSlots must be a power of two");
+
+  // Seeded FNV-1a, with the high bits folded into the low ones the slots are
+  // taken from.
+  static constexpr uint32_t Hash(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+      hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash ^ (hash >> 16);
+  }
+
+  std::array<Entry, kMaxMethods> entries_{};
+  size_t size_ = 0;
+  // Index + 1 of the method in each slot, 0 if empty.
+  std::array<uint8_t, kSlots> slots_{};
+  uint32_t seed_ = 0;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_METHOD_TABLE_H_
@@ -0,0 +1,87 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_MPSC_QUEUE_H_
+#define NATIVE_CORE_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+namespace native_core {
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov).
+//
+// Push() may be called from any thread; TryPop() must only ever be called from
+// the single consumer thread. A producer that is preempted between swapping
+// the head and linking its node makes TryPop() report an empty queue until it
+// resumes, which is fine for a queue that is drained on every wake-up.
+//
+// |T| must be default constructible and movable.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {}
+
+  ~MpscQueue() {
+    T discarded;
+    while (TryPop(&discarded)) {
+    }
+    delete tail_;
+  }
+
+  // Prevent copying.
+  MpscQueue(MpscQueue const&) = delete;
+  MpscQueue& operator=(MpscQueue const&) = delete;
+
+  void Push(T value) {
+    Node* node = new Node();
+    node->value = std::move(value);
+    Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  // Moves the oldest element into |value| and returns true, or returns false
+  // if the queue is (observably) empty.
+  bool TryPop(T* value) {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    *value = std::move(next->value);
+    // |next| becomes the new stub node.
+    tail_ = next;
+    delete tail;
+    return true;
+  }
+
+  // Only meaningful on the consumer thread.
+  bool IsEmpty() const {
+    return tail_->next.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    T value;
+  };
+
+  // Producers swap themselves in at the head.
+  std::atomic<Node*> head_;
+  // Owned by the consumer; always points at the current stub node.
+  Node* tail_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_MPSC_QUEUE_H_
@@ -0,0 +1,113 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_MPSC_RING_H_
+#define NATIVE_CORE_MPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace native_core {
+
+// Bounded lock-free multi-producer single-consumer ring buffer (Vyukov).
+//
+// Unlike MpscQueue it allocates nothing after construction, and TryPush()
+// fails instead of growing once |capacity| elements are waiting. Each slot
+// carries a sequence number that tells producers whether it is free and the
+// consumer whether it has been filled. TryPop() must only ever be called from
+// the single consumer thread.
+//
+// |T| must be default constructible and movable.
+template <typename T>
+class MpscRing {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit MpscRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    mask_ = size - 1;
+    slots_ = std::make_unique<Slot[]>(size);
+    for (size_t i = 0; i < size; i++) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Prevent copying.
+  MpscRing(MpscRing const&) = delete;
+  MpscRing& operator=(MpscRing const&) = delete;
+
+  // Moves |value| into the ring and returns true, or returns false, leaving
+  // |value| untouched, if the ring is full.
+  bool TryPush(T& value) {
+    size_t position = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[position & mask_];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+      if (difference == 0) {
+        if (head_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          slot.value = std::move(value);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (difference < 0) {
+        // The slot still holds the element pushed one lap ago.
+        return false;
+      }
+      else {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Moves the oldest element into |value| and returns true, or returns false
+  // if the ring is (observably) empty.
+  bool TryPop(T* value) {
+    Slot& slot = slots_[tail_ & mask_];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != tail_ + 1) {
+      return false;
+    }
+    *value = std::move(slot.value);
+    slot.value = T();
+    // Free for the producer one lap ahead.
+    slot.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+    tail_++;
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+  // Claimed by producers.
+  std::atomic<size_t> head_{0};
+  // Owned by the consumer.
+  size_t tail_ = 0;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_MPSC_RING_H_
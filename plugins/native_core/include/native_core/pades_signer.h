@@ -0,0 +1,75 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PADES_SIGNER_H_
+#define NATIVE_CORE_PADES_SIGNER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "export.h"
+#include "pkcs1_signer.h"
+
+namespace native_core {
+
+struct PadesOptions {
+  // Hashes the signed byte ranges and the signed attributes.
+  DigestAlgorithm digest = DigestAlgorithm::kSha256;
+  // /Reason and /Location of the signature dictionary, UTF-8; left out when
+  // empty.
+  std::string reason;
+  std::string location;
+  // /M of the signature dictionary; now if unset.
+  std::optional<std::chrono::system_clock::time_point> signing_time;
+  // Bytes reserved for the signature in /Contents; 0 sizes it from the
+  // certificate.
+  size_t reserved_size = 0;
+};
+
+// What SignPdf() did.
+struct PadesResult {
+  uint64_t input_size = 0;
+  uint64_t output_size = 0;
+  // Size of the CMS signature and of the room that was reserved for it.
+  size_t signature_size = 0;
+  size_t reserved_size = 0;
+};
+
+// Signs the PDF file at |input_path| into |output_path| with a PAdES
+// baseline signature (ETSI EN 319 142-1, B-B): an incremental update with a
+// signature field on the first page whose /Contents is a detached CAdES
+// signature (ETSI.CAdES.detached) of the /ByteRange, that is, of the whole
+// output file but /Contents itself.
+//
+// The input is mapped, copied to the output and hashed in one sequential
+// pass; neither file is ever held in memory, so its size does not matter.
+// The incremental update, a few kilobytes, is built in memory, hashed around
+// the /Contents placeholder, and written once the signature is spliced in.
+// The signer is asked for exactly one signature.
+//
+// Returns false, with a description in |error|, if the input cannot be
+// read, is encrypted or damaged, or the signer fails. No output is left
+// behind then.
+NATIVE_CORE_EXPORT bool SignPdf(Pkcs1Signer* signer,
+                                const std::string& input_path,
+                                const std::string& output_path,
+                                const PadesOptions& options,
+                                PadesResult* result,
+                                std::string* error);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PADES_SIGNER_H_
@@ -0,0 +1,175 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PDF_DOCUMENT_H_
+#define NATIVE_CORE_PDF_DOCUMENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+#include "mapped_file.h"
+
+namespace native_core {
+
+// A PDF object (ISO 32000-1, 7.3).
+struct NATIVE_CORE_EXPORT PdfObject {
+  enum class Type {
+    kNull,
+    kBoolean,
+    kNumber,
+    kString,
+    kName,
+    kArray,
+    kDictionary,
+    kReference,
+    kStream,
+  };
+
+  static PdfObject Integer(int64_t value);
+  static PdfObject Name(std::string name);
+  static PdfObject String(std::string bytes);
+  static PdfObject Reference(uint32_t number, uint16_t generation = 0);
+
+  // The entry |key| of a dictionary or a stream, or null if there is none.
+  const PdfObject* Find(std::string_view key) const;
+  // Adds or replaces the entry |key| of a dictionary.
+  void Set(const std::string& key, PdfObject value);
+  // Removes the entry |key| of a dictionary, if there is one.
+  void Remove(std::string_view key);
+
+  bool IsName(std::string_view name) const {
+    return type == Type::kName && text == name;
+  }
+  // The value of a number, or 0 if this is not one.
+  double Number() const;
+
+  Type type = Type::kNull;
+  bool boolean = false;
+  // The text of a number as it was read, the bytes of a string or a name
+  // (without the slash and with #xx escapes decoded).
+  std::string text;
+  // Items of an array.
+  std::vector<PdfObject> items;
+  // Entries of a dictionary, and the dictionary of a stream, in file order.
+  std::vector<std::pair<std::string, PdfObject>> entries;
+  // Object a reference points to.
+  uint32_t number = 0;
+  uint16_t generation = 0;
+  // Undecoded data of a stream, within the mapped file.
+  const uint8_t* stream = nullptr;
+  size_t stream_size = 0;
+};
+
+// Writes |object| in PDF syntax. Streams are written as their dictionary.
+NATIVE_CORE_EXPORT std::string SerializePdfObject(const PdfObject& object);
+
+// Read access to a PDF file, mapped into memory and parsed on demand: only
+// the cross-reference sections are read when it is opened, and each object
+// when it is first asked for, so that the size of the file does not matter.
+//
+// Reads classic cross-reference tables, cross-reference and object streams
+// (which need zlib) and the /Prev chain of incremental updates. Damaged files
+// are not repaired. Not thread-safe.
+class NATIVE_CORE_EXPORT PdfDocument {
+ public:
+  // Where an object is stored, from the cross-reference sections.
+  struct XrefEntry {
+    enum class Type : uint8_t { kUnset, kFree, kInFile, kInObjectStream };
+    Type type = Type::kUnset;
+    // The offset of an object in the file, or the number of the object
+    // stream that holds it.
+    uint64_t offset = 0;
+    // The generation of an object in the file, or its index in the object
+    // stream.
+    uint32_t index = 0;
+  };
+
+  // Opens the PDF file at the UTF-8 |path|. Returns null, with a
+  // description in |error|, if it cannot be read or is not a PDF file.
+  static std::unique_ptr<PdfDocument> Open(const std::string& path,
+                                           std::string* error);
+
+  ~PdfDocument();
+
+  // Prevent copying.
+  PdfDocument(PdfDocument const&) = delete;
+  PdfDocument& operator=(PdfDocument const&) = delete;
+
+  // The whole file.
+  const MappedFile& file() const { return *file_; }
+  const uint8_t* data() const { return file_->data(); }
+  size_t size() const { return file_->size(); }
+
+  // The trailer entries, the newest of each key along the /Prev chain.
+  const PdfObject& trailer() const { return trailer_; }
+  // The offset of the last cross-reference section (the last startxref).
+  uint64_t last_xref_offset() const { return last_xref_offset_; }
+  // Whether that section is a cross-reference stream.
+  bool xref_is_stream() const { return xref_is_stream_; }
+  // One more than the highest object number in use (the trailer's /Size).
+  uint32_t object_count() const;
+
+  // The object |number|, or null if it does not exist or cannot be read.
+  const PdfObject* Object(uint32_t number);
+  // |object| itself, or the object it refers to.
+  const PdfObject* Resolve(const PdfObject* object);
+  // The document catalog.
+  const PdfObject* Catalog();
+
+  // The number of pages and a reference to the page |index|, from the page
+  // tree. PageReference() returns false if there is no such page.
+  size_t PageCount();
+  bool PageReference(size_t index, PdfObject* reference);
+
+  // Decodes the data of |stream| into |data|: unfiltered or FlateDecode, with
+  // or without PNG and TIFF predictors. Returns false, with a description
+  // in |error|, for any other filter or corrupt data.
+  bool DecodeStream(const PdfObject& stream,
+                    std::string* data,
+                    std::string* error);
+
+ private:
+  struct ObjectStream;
+
+  explicit PdfDocument(std::unique_ptr<MappedFile> file);
+
+  bool ReadXref(std::string* error);
+  bool ReadXrefTable(size_t offset, PdfObject* trailer, std::string* error);
+  bool ReadXrefStream(size_t offset, PdfObject* trailer, std::string* error);
+  void AddEntry(uint32_t number, XrefEntry entry);
+  void MergeTrailer(const PdfObject& trailer);
+  std::unique_ptr<PdfObject> Load(uint32_t number);
+  const ObjectStream* LoadObjectStream(uint32_t number);
+
+  std::unique_ptr<MappedFile> file_;
+  PdfObject trailer_;
+  uint64_t last_xref_offset_ = 0;
+  bool xref_is_stream_ = false;
+  std::vector<XrefEntry> xref_;
+  std::unordered_map<uint32_t, std::unique_ptr<PdfObject>> objects_;
+  std::unordered_map<uint32_t, std::unique_ptr<ObjectStream>> object_streams_;
+  // Objects being loaded, against reference cycles (e.g. through /Length).
+  std::unordered_set<uint32_t> loading_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PDF_DOCUMENT_H_
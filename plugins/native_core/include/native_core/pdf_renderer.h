@@ -0,0 +1,42 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PDF_RENDERER_H_
+#define NATIVE_CORE_PDF_RENDERER_H_
+
+#include <string>
+
+#include "export.h"
+#include "png_encoder.h"
+
+namespace native_core {
+
+// Whether this build can render PDF pages. Rendering needs PDFium, which is
+// optional at build time.
+NATIVE_CORE_EXPORT bool CanRenderPdf();
+
+// Renders the first page of the PDF at the UTF-8 |path| on a white
+// background, scaled so that its longer side is |max_size| pixels. Returns
+// false, describing why in |error|, if the file is not a PDF that can be
+// opened without a password or the build cannot render.
+//
+// PDFium is not thread-safe, so renders from several threads take turns;
+// only reading the file overlaps.
+NATIVE_CORE_EXPORT bool RenderFirstPage(const std::string& path,
+                                        int max_size,
+                                        RgbImage* image,
+                                        std::string* error);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PDF_RENDERER_H_
@@ -0,0 +1,64 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PKCS1_SIGNER_H_
+#define NATIVE_CORE_PKCS1_SIGNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// Digest named by a signature algorithm as TriSigner writes it ("SHA256withRSA")
+// or by a digest algorithm ("SHA-256"). Anything unrecognized is SHA-512, as
+// in the signData method of digital_certificates.
+enum class DigestAlgorithm { kSha1, kSha256, kSha384, kSha512 };
+
+NATIVE_CORE_EXPORT DigestAlgorithm DigestAlgorithmFor(std::string_view name);
+
+// A private key that produces PKCS#1 v1.5 signatures: the second phase of a
+// triphase signature.
+class NATIVE_CORE_EXPORT Pkcs1Signer {
+ public:
+  virtual ~Pkcs1Signer();
+
+  // Hashes |data| with the digest named by |algorithm| and signs the hash.
+  // May be called from any thread, though callers are expected to sign one
+  // datum at a time: smart card drivers handle concurrency poorly. Returns
+  // false, with a description in |error|, on failure.
+  virtual bool Sign(std::string_view algorithm,
+                    const uint8_t* data,
+                    size_t size,
+                    std::vector<uint8_t>* signature,
+                    std::string* error) = 0;
+
+  // DER encoding of the certificate of the key, for the signatures built
+  // locally (CAdES). Empty if unknown.
+  virtual std::vector<uint8_t> Certificate() const;
+};
+
+// The key of the certificate selected in digital_certificates, for the
+// modules that sign on their own (the triphase engine). Null while no
+// certificate is selected. Thread-safe.
+NATIVE_CORE_EXPORT void SetActiveSigner(std::shared_ptr<Pkcs1Signer> signer);
+NATIVE_CORE_EXPORT std::shared_ptr<Pkcs1Signer> GetActiveSigner();
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PKCS1_SIGNER_H_
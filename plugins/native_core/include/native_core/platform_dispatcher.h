@@ -0,0 +1,59 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PLATFORM_DISPATCHER_H_
+#define NATIVE_CORE_PLATFORM_DISPATCHER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+#include "export.h"
+#include "mpsc_queue.h"
+#include "wakeup.h"
+
+namespace native_core {
+
+// Carries completions from background threads back to the platform thread.
+//
+// Any thread may Post(); the platform thread runs the posted tasks from
+// Drain(). Only the first Post() after a Drain() signals |wakeup|, so a burst
+// of completions costs a single wake-up of the platform thread.
+class NATIVE_CORE_EXPORT PlatformDispatcher {
+ public:
+  using Task = std::function<void()>;
+
+  // |wakeup| must outlive the dispatcher.
+  explicit PlatformDispatcher(Wakeup* wakeup);
+  ~PlatformDispatcher();
+
+  // Prevent copying.
+  PlatformDispatcher(PlatformDispatcher const&) = delete;
+  PlatformDispatcher& operator=(PlatformDispatcher const&) = delete;
+
+  // Queues |task| to run on the platform thread. Thread-safe.
+  void Post(Task task);
+
+  // Runs every task queued so far. Must be called on the platform thread.
+  // Returns the number of tasks run.
+  size_t Drain();
+
+ private:
+  Wakeup* wakeup_;
+  MpscQueue<Task> queue_;
+  std::atomic<bool> wake_pending_{false};
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PLATFORM_DISPATCHER_H_
@@ -0,0 +1,39 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PNG_ENCODER_H_
+#define NATIVE_CORE_PNG_ENCODER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// An 8-bit RGB image, rows top to bottom with no padding between them.
+struct RgbImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Encodes |image| as a PNG. Each row is filtered the way that leaves the
+// smallest differences, and the whole compressed with zlib when the build has
+// it; without zlib the data is stored uncompressed, which is larger but still
+// a valid PNG.
+NATIVE_CORE_EXPORT std::vector<uint8_t> EncodePng(const RgbImage& image);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PNG_ENCODER_H_
@@ -0,0 +1,174 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PROXY_RESPONSE_PARSERS_H_
+#define NATIVE_CORE_PROXY_RESPONSE_PARSERS_H_
+
+#include <memory>
+
+#include "export.h"
+#include "response_parser.h"
+
+namespace native_core {
+
+// Streaming counterparts of RequestListResponseParser,
+// RequestDetailResponseParser, PresignResponseParser and
+// PostsignResponseParser in lib/api. They
+// accept and reject the same documents, with the same messages, and produce
+// record tables instead of model objects.
+//
+// The table layouts below are mirrored in lib/api/native_response_parsers.dart.
+// String cells index strings() (-1 for null); "first"/"count" cells are
+// ranges of rows in another table.
+
+// Kinds of response, as numbered over the method channel.
+enum class ResponseKind {
+  kRequestList = 0,
+  kRequestDetail = 1,
+  kPresign = 2,
+  kPostsign = 3,
+};
+
+NATIVE_CORE_EXPORT std::unique_ptr<ResponseParser> CreateResponseParser(
+    ResponseKind kind);
+
+// Request list: a "list" table with one row and the "requests" and "docs"
+// tables.
+namespace request_list {
+
+enum ListField { kTotal, kListStride };
+
+enum RequestField {
+  kId,
+  kSubject,
+  kSender,
+  kView,
+  kDate,
+  kExpirationDate,
+  // Attribute text, already validated as an integer.
+  kPriority,
+  // 1 or 0.
+  kWorkflow,
+  kForward,
+  // 0 signature, 1 approve, -1 unknown.
+  kType,
+  kFirstDocument,
+  kDocumentCount,
+  kRequestStride
+};
+
+}  // namespace request_list
+
+// Documents of a request ("docs" table in the list and in the detail).
+namespace sign_request_document {
+
+enum DocumentField {
+  kDocumentId,
+  kName,
+  // Element text; the Dart side applies int.tryParse.
+  kSize,
+  kMimeType,
+  kSignatureFormat,
+  kMessageDigestAlgorithm,
+  kParams,
+  kDocumentStride
+};
+
+}  // namespace sign_request_document
+
+// Request detail: a "detail" table with one row, plus "senders", "lines",
+// "signers", "docs" and "attached".
+namespace request_detail {
+
+enum DetailField {
+  kId,
+  kSubject,
+  kMessage,
+  kDate,
+  kExpirationDate,
+  kApplication,
+  kRejectReason,
+  kReference,
+  kSignLinesType,
+  kPriority,
+  kWorkflow,
+  kForward,
+  kType,
+  kFirstSender,
+  kSenderCount,
+  kFirstLine,
+  kLineCount,
+  kFirstDocument,
+  kDocumentCount,
+  // -1 when there is no attachment list at all.
+  kFirstAttached,
+  kAttachedCount,
+  kDetailStride
+};
+
+enum SenderField { kSenderName, kSenderStride };
+
+enum LineField { kLineType, kFirstSigner, kSignerCount, kLineStride };
+
+enum SignerField { kSignerName, kSignerDone, kSignerStride };
+
+enum AttachedField {
+  kAttachedId,
+  kAttachedName,
+  kAttachedSize,
+  kAttachedMimeType,
+  kAttachedStride
+};
+
+}  // namespace request_detail
+
+// Presign: "requests", "docs" and "params" tables.
+namespace presign {
+
+enum RequestField {
+  kReference,
+  kStatusOk,
+  // Raw exceptionb64 attribute; the Dart side decodes it.
+  kException,
+  // -1 when the request failed and has no documents.
+  kFirstDocument,
+  kDocumentCount,
+  kRequestStride
+};
+
+enum DocumentField {
+  kDocumentId,
+  kCryptoOperation,
+  kSignatureFormat,
+  kMessageDigestAlgorithm,
+  kParams,
+  kFirstParam,
+  kParamCount,
+  kDocumentStride
+};
+
+enum ParamField { kKey, kValue, kParamStride };
+
+}  // namespace presign
+
+// Postsign: a "result" table with the single row that PostsignResponseParser
+// reads, the first <req> of the response.
+namespace postsign {
+
+enum ResultField { kReference, kStatusOk, kResultStride };
+
+}  // namespace postsign
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PROXY_RESPONSE_PARSERS_H_
@@ -0,0 +1,107 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_PROXY_SESSION_H_
+#define NATIVE_CORE_PROXY_SESSION_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "export.h"
+#include "http_client.h"
+#include "pkcs1_signer.h"
+#include "response_parser.h"
+#include "triphase_engine.h"
+
+namespace native_core {
+
+// A request of the request list, with what signing it takes.
+struct ListedRequest {
+  std::string id;
+  std::string subject;
+  // 0 signature, 1 approve, -1 unknown, as in the request list table.
+  int type = 0;
+  // Missing when the request has no document list.
+  std::optional<std::vector<TriphaseDocument>> documents;
+};
+
+// A user session with the proxy, for the processes that talk to it without
+// the Dart side: the challenge-response login of UserController.login(), the
+// request list of Api.getSignRequests() and the logout. Presigns and
+// postsigns go through transport(), which shares the session cookie.
+//
+// Not thread-safe, except for transport().
+class NATIVE_CORE_EXPORT ProxySession {
+ public:
+  // Operation codes of Api.
+  static constexpr const char* kRequestListOperation = "2";
+  static constexpr const char* kLoginRequestOperation = "10";
+  static constexpr const char* kLoginValidationOperation = "11";
+  static constexpr const char* kLogoutOperation = "12";
+
+  // |client| must outlive the session.
+  ProxySession(HttpClient* client, std::string url);
+
+  // Prevent copying.
+  ProxySession(ProxySession const&) = delete;
+  ProxySession& operator=(ProxySession const&) = delete;
+
+  // Forgets any previous session, asks for a challenge, signs it with
+  // |signer| (SHA256withRSA) and sends it back with the certificate of the
+  // signer. Returns false, with a description in |error|, on a network
+  // failure, a malformed response or a rejected login; the message of the
+  // proxy is passed on for the latter.
+  bool Login(Pkcs1Signer* signer, std::string* error);
+
+  // The DNI the proxy reported at login, and the owner of the journal
+  // records of this session ('<url>|<certificate base64>', as on the Dart
+  // side).
+  const std::string& dni() const { return dni_; }
+  const std::string& journal_owner() const { return journal_owner_; }
+
+  // Fetches the page |page| (from 1) of |page_size| requests in |state|
+  // ("unresolved", "signed", ...). |total| receives the number of requests
+  // in that state, or -1 if the proxy did not say. Returns false, with a
+  // description in |error|, if the page cannot be fetched or parsed.
+  bool ListRequests(const std::string& state,
+                    int page,
+                    int page_size,
+                    std::vector<ListedRequest>* requests,
+                    int* total,
+                    std::string* error);
+
+  // Ends the session on the proxy. Failures are not reported: the session
+  // cookie is forgotten either way.
+  void Logout();
+
+  TriphaseTransport* transport() { return &transport_; }
+  const std::string& url() const { return url_; }
+
+ private:
+  // Posts |body| and feeds the response to |parser|. Returns false, with a
+  // description in |error|, unless the response is a 200 without errors.
+  bool Exchange(const std::vector<uint8_t>& body,
+                ResponseParser* parser,
+                std::string* error);
+
+  HttpClient* client_;
+  std::string url_;
+  HttpTriphaseTransport transport_;
+  std::string dni_;
+  std::string journal_owner_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_PROXY_SESSION_H_
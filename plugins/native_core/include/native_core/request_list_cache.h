@@ -0,0 +1,99 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_REQUEST_LIST_CACHE_H_
+#define NATIVE_CORE_REQUEST_LIST_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "export.h"
+#include "proxy_response_parsers.h"
+#include "response_parser.h"
+
+namespace native_core {
+
+// A request list read back from the cache, in the tables of the request list
+// parser ("list", "requests" and "docs"), so that the Dart side builds the
+// model objects the same way for both.
+struct RequestListSnapshot {
+  StringTable strings;
+  RecordTable list{"list", request_list::kListStride};
+  RecordTable requests{"requests", request_list::kRequestStride};
+  RecordTable docs{"docs", sign_request_document::kDocumentStride};
+};
+
+// What Merge() did.
+struct RequestListMergeStats {
+  // Records written, and records whose bytes on disk were kept as they were.
+  size_t written = 0;
+  size_t kept = 0;
+  // Whether the file was rewritten from scratch to drop stale records.
+  bool compacted = false;
+};
+
+// On-disk cache of the first page of the request lists, one file per server
+// and state, so that the last known inbox can be shown before the network
+// answers.
+//
+// The file holds the records in a compact binary format and an index with
+// their order, and is read through a memory mapping. Merge() applies a fresh
+// page by request id: records that did not change keep their bytes in place
+// and only new and changed ones are appended, followed by a new index. The
+// header, which points at the index, is rewritten last, so an interrupted
+// merge leaves the previous list readable. Files with another format version
+// are ignored and replaced.
+//
+// Safe to use from several threads at once.
+class NATIVE_CORE_EXPORT RequestListCache {
+ public:
+  // Bumped whenever the file layout changes.
+  static constexpr uint32_t kVersion = 1;
+
+  // Keeps its files in the existing directory at the UTF-8 |directory|.
+  explicit RequestListCache(std::string directory);
+
+  // Prevent copying.
+  RequestListCache(RequestListCache const&) = delete;
+  RequestListCache& operator=(RequestListCache const&) = delete;
+
+  // The cached list, or null if there is none or the file is unusable.
+  std::unique_ptr<RequestListSnapshot> Load(const std::string& server,
+                                            const std::string& state);
+
+  // Makes |page|, a request list parsed without errors, the cached list.
+  // Returns false if the file could not be written.
+  bool Merge(const std::string& server,
+             const std::string& state,
+             const ResponseParser& page,
+             RequestListMergeStats* stats = nullptr);
+
+  // Deletes the cached list.
+  void Remove(const std::string& server, const std::string& state);
+
+ private:
+  std::string PathFor(const std::string& server,
+                      const std::string& state) const;
+
+  const std::string directory_;
+
+  // Serializes access to the files.
+  std::mutex mutex_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_REQUEST_LIST_CACHE_H_
@@ -0,0 +1,156 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_RESPONSE_PARSER_H_
+#define NATIVE_CORE_RESPONSE_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "export.h"
+#include "xml_pull_parser.h"
+#include "xml_subtree.h"
+
+namespace native_core {
+
+// The strings referenced by record tables, stored back to back as UTF-8.
+// String i spans [ends()[i - 1], ends()[i]).
+class NATIVE_CORE_EXPORT StringTable {
+ public:
+  // Index standing for a missing (null) string.
+  static constexpr int32_t kNull = -1;
+
+  int32_t Add(std::string_view value);
+
+  size_t size() const { return ends_.size(); }
+  const std::string& bytes() const { return bytes_; }
+  const std::vector<int32_t>& ends() const { return ends_; }
+
+ private:
+  std::string bytes_;
+  std::vector<int32_t> ends_;
+};
+
+// Rows of |stride| int32 cells: string indices, numbers, flags and ranges of
+// rows in other tables. Stored row after row in a single array.
+class NATIVE_CORE_EXPORT RecordTable {
+ public:
+  RecordTable(std::string name, size_t stride);
+
+  // Prevent copying.
+  RecordTable(RecordTable const&) = delete;
+  RecordTable& operator=(RecordTable const&) = delete;
+
+  const std::string& name() const { return name_; }
+  size_t stride() const { return stride_; }
+  size_t rows() const { return cells_.size() / stride_; }
+  const std::vector<int32_t>& cells() const { return cells_; }
+
+  void Reserve(size_t rows) { cells_.reserve(rows * stride_); }
+
+  // Appends a row with every cell set to -1 and returns its index.
+  int32_t AddRow();
+
+  int32_t* row(int32_t index) { return cells_.data() + index * stride_; }
+
+ private:
+  std::string name_;
+  size_t stride_;
+  std::vector<int32_t> cells_;
+};
+
+// Base of the streaming parsers for proxy responses.
+//
+// The response is tokenized as it is fed. Elements at |record_depth| (1 for
+// the root, 2 for its children) are gathered one at a time into an
+// XmlSubtree and handed to OnRecord(), which validates them and appends them
+// to record tables. Only one record is held in memory at a time.
+//
+// Three kinds of failure are reported separately, because the Dart side
+// surfaces them differently: malformed XML (syntax_error()), an <err>
+// element anywhere in the response (proxy_error()) and content that the Dart
+// parsers would reject (error(), with the same message).
+class NATIVE_CORE_EXPORT ResponseParser {
+ public:
+  virtual ~ResponseParser();
+
+  // Prevent copying.
+  ResponseParser(ResponseParser const&) = delete;
+  ResponseParser& operator=(ResponseParser const&) = delete;
+
+  void Feed(const char* data, size_t size);
+
+  // Marks the end of the response.
+  void Finish();
+
+  bool has_syntax_error() const { return !syntax_error_.empty(); }
+  const std::string& syntax_error() const { return syntax_error_; }
+
+  bool has_proxy_error() const { return has_proxy_error_; }
+  const std::string& proxy_error() const { return proxy_error_; }
+
+  bool has_error() const { return !error_.empty(); }
+  const std::string& error() const { return error_; }
+
+  const StringTable& strings() const { return strings_; }
+  const std::vector<std::unique_ptr<RecordTable>>& tables() const {
+    return tables_;
+  }
+
+ protected:
+  explicit ResponseParser(size_t record_depth);
+
+  // Called with the start tag of the root element.
+  virtual void OnRoot(const XmlPullParser& /*parser*/) {}
+
+  // Called with each complete record, unless an error was reported before.
+  virtual void OnRecord(const XmlSubtree& record) = 0;
+
+  // Called once the whole response has been parsed without syntax errors.
+  virtual void OnEnd() {}
+
+  // Reports a content error. Only the first one is kept; records after it are
+  // no longer gathered.
+  void SetError(std::string message);
+
+  RecordTable* AddTable(std::string name, size_t stride);
+
+  StringTable& mutable_strings() { return strings_; }
+
+ private:
+  void Pump();
+
+  const size_t record_depth_;
+  XmlPullParser xml_;
+  XmlSubtree record_;
+  bool gathering_ = false;
+
+  // Depth of the <err> element whose text is being gathered, or 0.
+  size_t proxy_error_depth_ = 0;
+  bool has_proxy_error_ = false;
+  std::string proxy_error_;
+
+  std::string syntax_error_;
+  std::string error_;
+
+  StringTable strings_;
+  std::vector<std::unique_ptr<RecordTable>> tables_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_RESPONSE_PARSER_H_
@@ -0,0 +1,67 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_RUNTIME_H_
+#define NATIVE_CORE_RUNTIME_H_
+
+#include <functional>
+#include <memory>
+
+#include "cancellation_token.h"
+#include "export.h"
+#include "platform_dispatcher.h"
+#include "wakeup.h"
+#include "worker_pool.h"
+
+namespace native_core {
+
+// Process-wide worker pool and platform dispatcher shared by the plugins.
+//
+// Plugin method handlers run on the platform thread and must answer their
+// MethodResult there. Work that may block goes to the pool with RunAsync();
+// its completion is posted back through the dispatcher.
+class NATIVE_CORE_EXPORT Runtime {
+ public:
+  // Returns the process-wide runtime, creating it on first use. The first call
+  // must be made on the platform thread (plugin registration is).
+  static Runtime& Get();
+
+  // Prevent copying.
+  Runtime(Runtime const&) = delete;
+  Runtime& operator=(Runtime const&) = delete;
+
+  WorkerPool& pool() { return *pool_; }
+  PlatformDispatcher& dispatcher() { return *dispatcher_; }
+  Wakeup& wakeup() { return *wakeup_; }
+
+  // Runs |work| on the pool and then |done| on the platform thread. |work| is
+  // skipped if |token| was cancelled before a worker picked it up; |done|
+  // always runs, told whether |token| was cancelled by the time the work
+  // finished or was skipped, so that a MethodResult it holds is answered
+  // either way. Returns false, running neither, when the pool is saturated.
+  bool RunAsync(std::function<void()> work,
+                std::function<void(bool cancelled)> done,
+                CancellationToken token = CancellationToken());
+
+ private:
+  Runtime();
+  ~Runtime();
+
+  std::unique_ptr<Wakeup> wakeup_;
+  std::unique_ptr<PlatformDispatcher> dispatcher_;
+  std::unique_ptr<WorkerPool> pool_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_RUNTIME_H_
@@ -0,0 +1,158 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_SEARCH_INDEX_H_
+#define NATIVE_CORE_SEARCH_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+#include "response_parser.h"
+
+namespace native_core {
+
+// Lower-cases |text| (UTF-8) and removes the accents of Latin-1 letters, so
+// that "Resolución" and "RESOLUCION" compare equal. Other characters are
+// kept as they are.
+NATIVE_CORE_EXPORT std::string FoldForSearch(std::string_view text);
+
+struct SearchResult {
+  // Ids of the matching requests in the order they were first indexed, at
+  // most the |limit| given to Query().
+  std::vector<std::string> ids;
+  // Number of matching requests.
+  size_t total = 0;
+};
+
+struct SearchIndexStats {
+  size_t requests = 0;
+  size_t terms = 0;
+  size_t postings = 0;
+};
+
+// In-memory inverted index over the requests of the fetched lists, so that
+// the inbox can be searched as the user types without asking the proxy.
+//
+// The id, subject and sender of each request and the names of its documents
+// are split into words, folded with FoldForSearch(), and every word points
+// at the requests that contain it. Query() matches requests that contain,
+// for every word of the query, a word starting with it. The words are kept
+// sorted in a single block, with the requests of each word next to those of
+// the following one, so each query word costs two binary searches and one
+// pass over a contiguous array. Words added since the block was last
+// rebuilt are kept apart until there are a few thousand of them. The
+// matches are combined as bitmaps.
+//
+// Requests are added page by page as the lists arrive. A request indexed
+// again, e.g. because it moved to another state, replaces the previous one.
+//
+// Safe to use from several threads at once.
+class NATIVE_CORE_EXPORT SearchIndex {
+ public:
+  SearchIndex() = default;
+
+  // Prevent copying.
+  SearchIndex(SearchIndex const&) = delete;
+  SearchIndex& operator=(SearchIndex const&) = delete;
+
+  // Indexes the requests of |page|, a request list parsed without errors,
+  // under |state|. Returns false if |page| is not such a list.
+  bool AddRequestList(std::string_view state, const ResponseParser& page);
+
+  // Same, for the "requests" and "docs" tables of a request list whose
+  // strings are in |strings|.
+  void AddRequestList(std::string_view state,
+                      const StringTable& strings,
+                      const RecordTable& requests,
+                      const RecordTable& docs);
+
+  // Indexes one request, replacing any request with the same |id|.
+  void Add(std::string_view id,
+           std::string_view state,
+           const std::vector<std::string_view>& texts);
+
+  void Remove(std::string_view id);
+
+  void Clear();
+
+  // Requests in |state| (any state if empty) matching every word of |text|,
+  // as a prefix. An empty query matches nothing.
+  SearchResult Query(std::string_view text,
+                     std::string_view state,
+                     size_t limit) const;
+
+  SearchIndexStats stats() const;
+
+ private:
+  struct Request {
+    std::string id;
+    uint32_t state;
+  };
+
+  // Sorted words stored back to back, followed by the numbers of the
+  // requests containing each, also back to back: the words sharing a
+  // prefix, and their numbers, are contiguous.
+  struct Segment {
+    std::string_view Word(size_t index) const;
+    uint32_t NumbersBegin(size_t index) const;
+    // Indices [first, last) of the words starting with |prefix|.
+    std::pair<size_t, size_t> PrefixRange(std::string_view prefix) const;
+
+    std::string words;
+    std::vector<uint32_t> word_ends;
+    std::vector<uint32_t> number_ends;
+    std::vector<uint32_t> numbers;
+  };
+
+  // Callers hold |mutex_|.
+  void AddLocked(std::string_view id,
+                 std::string_view state,
+                 const std::vector<std::string_view>& texts);
+  void RemoveLocked(std::string_view id);
+  // Renumbers the live requests once replaced ones outnumber them.
+  void CompactLocked();
+  // Rebuilds |segment_| with the recent words, applying |renumbered| (the new
+  // number by old number, kRemoved for dropped ones) if given.
+  void MergeLocked(const std::vector<uint32_t>* renumbered);
+
+  mutable std::mutex mutex_;
+
+  // By request number, in the order they were indexed. Replaced and removed
+  // requests stay until the next compaction.
+  std::vector<Request> requests_;
+  size_t live_requests_ = 0;
+  // Numbers of the live requests by id.
+  std::unordered_map<std::string, uint32_t> numbers_;
+  // States by number, and a bitmap of the live requests in each.
+  std::vector<std::string> states_;
+  std::vector<std::vector<uint64_t>> state_bits_;
+  // Numbers of the requests containing each folded word, in increasing
+  // order: in |segment_|, and in |recent_terms_| for those added since it
+  // was last rebuilt.
+  Segment segment_;
+  std::map<std::string, std::vector<uint32_t>, std::less<>> recent_terms_;
+  size_t terms_ = 0;
+  size_t postings_ = 0;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_SEARCH_INDEX_H_
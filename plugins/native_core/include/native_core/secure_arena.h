@@ -0,0 +1,95 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_SECURE_ARENA_H_
+#define NATIVE_CORE_SECURE_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "export.h"
+
+namespace native_core {
+
+// Counters since the process started.
+struct SecureArenaStats {
+  // Arenas opened; the signers open one per signature.
+  uint64_t arenas = 0;
+  // Allocations from those arenas, and those among them too large for a
+  // block, which got pages of their own.
+  uint64_t allocations = 0;
+  uint64_t large_allocations = 0;
+  // Blocks in the pool, those handed out right now, and how many bytes of
+  // them are locked in RAM. Locking fails beyond the limit of the process
+  // (RLIMIT_MEMLOCK, the minimum working set on Windows); such blocks are
+  // still used, and still cleared.
+  uint64_t blocks = 0;
+  uint64_t blocks_in_use = 0;
+  uint64_t locked_bytes = 0;
+};
+
+NATIVE_CORE_EXPORT SecureArenaStats GetSecureArenaStats();
+
+// Clears |size| bytes at |data| in a way the compiler may not drop as a dead
+// store.
+NATIVE_CORE_EXPORT void SecureZero(void* data, size_t size);
+
+namespace internal {
+
+struct SecureBlock;
+
+}  // namespace internal
+
+// Scratch memory for one signature: hash states, digests and signatures on
+// their way out, which should neither be paged out nor linger in the heap.
+//
+// Memory comes in blocks from a process-wide pool of pages locked in RAM and
+// left out of core dumps, each large enough for the buffers of a signature
+// with the largest keys and digests, so a signature takes one block and
+// never touches the heap. Allocating is a pointer bump. The arena clears
+// what it handed out and returns its blocks to the pool when it goes away;
+// the pool keeps them for the next one.
+//
+// Not thread-safe: an arena belongs to the signature that opened it.
+class NATIVE_CORE_EXPORT SecureArena {
+ public:
+  // Bytes of a block, header included.
+  static constexpr size_t kBlockSize = 4096;
+
+  SecureArena();
+  ~SecureArena();
+
+  // Prevent copying.
+  SecureArena(SecureArena const&) = delete;
+  SecureArena& operator=(SecureArena const&) = delete;
+
+  // Returns |size| zeroed bytes, 16-byte aligned, valid for the life of the
+  // arena. Returns null only if the system is out of memory.
+  uint8_t* Allocate(size_t size);
+
+  template <typename T>
+  T* Allocate(size_t count) {
+    return reinterpret_cast<T*>(Allocate(count * sizeof(T)));
+  }
+
+  size_t allocations() const { return allocations_; }
+
+ private:
+  // The block being allocated from; it links to those filled before it.
+  internal::SecureBlock* current_ = nullptr;
+  size_t allocations_ = 0;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_SECURE_ARENA_H_
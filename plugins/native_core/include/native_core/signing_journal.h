@@ -0,0 +1,129 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_SIGNING_JOURNAL_H_
+#define NATIVE_CORE_SIGNING_JOURNAL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// A signed request whose postsign has not been answered yet.
+struct JournaledPostsign {
+  std::string request_id;
+  // The complete postsign form body: the presign parameters and the PKCS#1
+  // signatures of every document.
+  std::vector<uint8_t> body;
+};
+
+struct SigningJournalStats {
+  // Records appended since the journal was opened.
+  uint64_t records = 0;
+  // fsync() calls; each one makes every record written before it durable.
+  uint64_t syncs = 0;
+  size_t pending = 0;
+};
+
+// Write-ahead journal of the signatures produced by the triphase engine, so
+// that a batch interrupted after signing (a failed postsign, a crash, an
+// expired session) can be postsigned again without signing again, which on
+// smart cards means minutes and PIN prompts.
+//
+// The file is append-only. Each record carries its length and a CRC-32, so a
+// record torn by a crash is detected, and it and everything after it are
+// dropped when the journal is opened. A signed request is only sent to the
+// postsign once its record is on disk; appends from several threads waiting
+// for the disk at the same time share a single fsync(). When the journal is
+// opened it is rewritten with only the pending requests.
+//
+// Requests are kept per owner (the server and user they were signed for),
+// which is stored hashed.
+//
+// Safe to use from several threads at once.
+class NATIVE_CORE_EXPORT SigningJournal {
+ public:
+  // Bumped whenever the file layout changes; files with another version are
+  // discarded.
+  static constexpr uint32_t kVersion = 1;
+
+  // Opens the journal at the UTF-8 |path|, creating it if needed. Returns
+  // null if it cannot be written.
+  static std::unique_ptr<SigningJournal> Open(const std::string& path);
+
+  ~SigningJournal();
+
+  // Prevent copying.
+  SigningJournal(SigningJournal const&) = delete;
+  SigningJournal& operator=(SigningJournal const&) = delete;
+
+  // Records, durably, that |request_id| was signed for |owner| and is about
+  // to be postsigned with |body|. Returns false if the record may not have
+  // reached the disk.
+  bool RecordSigned(std::string_view owner,
+                    std::string_view request_id,
+                    const std::vector<uint8_t>& body);
+
+  // Records that the proxy answered the postsign of |request_id| with a
+  // response that parsed, whether OK or KO. Not synced on its own: if it is
+  // lost, the postsign is sent once more.
+  void RecordPosted(std::string_view owner, std::string_view request_id);
+
+  // The requests of |owner| signed and not answered, in the order they were
+  // signed.
+  std::vector<JournaledPostsign> Pending(std::string_view owner) const;
+
+  SigningJournalStats stats() const;
+
+ private:
+  // (owner hash, request id).
+  using Key = std::pair<uint64_t, std::string>;
+
+  struct Entry {
+    uint64_t sequence = 0;
+    std::vector<uint8_t> body;
+  };
+
+  SigningJournal(std::FILE* file, std::map<Key, Entry> pending);
+
+  // Appends |record| and, if |sync|, waits until it is on disk.
+  bool Append(const std::string& record, bool sync);
+
+  std::FILE* file_;
+
+  mutable std::mutex mutex_;
+  // Signalled when an fsync() completes.
+  std::condition_variable synced_;
+  bool syncing_ = false;
+  // Bytes appended, and bytes known to be on disk.
+  uint64_t written_ = 0;
+  uint64_t durable_ = 0;
+
+  std::map<Key, Entry> pending_;
+  uint64_t next_sequence_;
+  SigningJournalStats stats_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_SIGNING_JOURNAL_H_
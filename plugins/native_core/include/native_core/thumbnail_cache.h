@@ -0,0 +1,150 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_THUMBNAIL_CACHE_H_
+#define NATIVE_CORE_THUMBNAIL_CACHE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+struct ThumbnailCacheOptions {
+  // Existing directory the thumbnails are kept in, UTF-8.
+  std::string directory;
+  // Bytes of thumbnails kept in memory and on disk; the least recently used
+  // ones are dropped beyond them.
+  size_t max_memory_bytes = 4 * 1024 * 1024;
+  uint64_t max_disk_bytes = 32 * 1024 * 1024;
+};
+
+struct ThumbnailCacheStats {
+  uint64_t memory_hits = 0;
+  uint64_t disk_hits = 0;
+  uint64_t renders = 0;
+  uint64_t failures = 0;
+  size_t memory_bytes = 0;
+  uint64_t disk_bytes = 0;
+};
+
+// PNG thumbnails of the first page of the downloaded PDFs.
+//
+// Thumbnails are keyed by the SHA-256 of the document and their size, so the
+// same document downloaded again in another session, or under another name,
+// is not rendered again. Hashing reads the whole file, so the hash of each
+// path is remembered for as long as its size and modification time stay the
+// same.
+//
+// They are kept in memory and in the directory, each up to its own size,
+// dropping the least recently used first; on disk the modification time of
+// each file records its last use across sessions. The last documents that
+// could not be rendered are remembered as such and not tried again.
+//
+// Get() blocks while it reads, hashes and renders, so it is meant to run on
+// the worker pool. It may be called from several threads at once; a call for
+// a thumbnail that another is rendering waits for it instead of rendering it
+// again.
+class NATIVE_CORE_EXPORT ThumbnailCache {
+ public:
+  using Png = std::shared_ptr<const std::vector<uint8_t>>;
+
+  explicit ThumbnailCache(ThumbnailCacheOptions options);
+
+  // Prevent copying.
+  ThumbnailCache(ThumbnailCache const&) = delete;
+  ThumbnailCache& operator=(ThumbnailCache const&) = delete;
+
+  // The thumbnail of the PDF at the UTF-8 |path|, its longer side |size|
+  // pixels, rendering it if it is not cached. Returns null, describing why in
+  // |error|, if the file cannot be read or rendered.
+  Png Get(const std::string& path, int size, std::string* error);
+
+  ThumbnailCacheStats stats() const;
+
+ private:
+  using MemoryList = std::list<std::pair<std::string, Png>>;
+
+  // The file a document hash was taken from.
+  struct HashedFile {
+    uint64_t size = 0;
+    int64_t modified = 0;
+    std::string hash;
+  };
+
+  struct DiskEntry {
+    uint64_t size = 0;
+    // Higher is more recent.
+    uint64_t last_use = 0;
+  };
+
+  // The key of the thumbnail of |path| at |size|, hashing the file unless
+  // it has not changed since it was last hashed.
+  bool KeyFor(const std::string& path,
+              int size,
+              std::string* key,
+              std::string* error);
+
+  // Lists the thumbnails in the directory, on first use. Must hold |mutex_|.
+  void LoadDiskIndex();
+
+  // Makes |png| the most recently used thumbnail in memory. Must hold
+  // |mutex_|.
+  void Remember(const std::string& key, Png png);
+
+  // Records that the file of |key|, |size| bytes, was just used, and drops the
+  // least recently used files beyond the limit. Must hold |mutex_|.
+  void Used(const std::string& key, uint64_t size);
+
+  std::string PathFor(const std::string& key) const;
+
+  const ThumbnailCacheOptions options_;
+
+  mutable std::mutex mutex_;
+  // Signalled whenever a render ends.
+  std::condition_variable rendered_;
+  // Keys being rendered.
+  std::set<std::string> rendering_;
+  // The documents hashed so far, by path.
+  std::map<std::string, HashedFile> hashes_;
+  // Keys that could not be rendered, with the reason; forgotten all at once
+  // when there are too many.
+  std::unordered_map<std::string, std::string> failed_;
+
+  // Most recently used first.
+  MemoryList memory_;
+  std::unordered_map<std::string, MemoryList::iterator> memory_index_;
+  size_t memory_bytes_ = 0;
+
+  bool disk_loaded_ = false;
+  std::unordered_map<std::string, DiskEntry> disk_;
+  uint64_t disk_bytes_ = 0;
+  uint64_t next_use_ = 0;
+
+  ThumbnailCacheStats stats_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_THUMBNAIL_CACHE_H_
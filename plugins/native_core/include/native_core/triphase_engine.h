@@ -0,0 +1,169 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_TRIPHASE_ENGINE_H_
+#define NATIVE_CORE_TRIPHASE_ENGINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cancellation_token.h"
+#include "export.h"
+#include "http_client.h"
+#include "pkcs1_signer.h"
+#include "signing_journal.h"
+
+namespace native_core {
+
+// Carries the presign and postsign requests to the proxy. Called from several
+// threads at once.
+class NATIVE_CORE_EXPORT TriphaseTransport {
+ public:
+  using Sink = std::function<void(const char* data, size_t size)>;
+
+  virtual ~TriphaseTransport();
+
+  // Posts the form body |body| and hands the response body to |sink| as it
+  // arrives. Returns the HTTP status, or 0 if no complete response was
+  // received.
+  virtual int Post(const std::vector<uint8_t>& body, const Sink& sink) = 0;
+};
+
+// Posts to the proxy at |url| through |client|, with the headers of
+// Api._getHeaders(). Without a |cookie| the client sends the session cookie
+// it got at login.
+class NATIVE_CORE_EXPORT HttpTriphaseTransport : public TriphaseTransport {
+ public:
+  // |client| must outlive the transport.
+  HttpTriphaseTransport(HttpClient* client,
+                        std::string url,
+                        const std::string& cookie);
+
+  int Post(const std::vector<uint8_t>& body, const Sink& sink) override;
+
+ private:
+  HttpClient* client_;
+  std::string url_;
+  HttpHeaders headers_;
+};
+
+// A document of a SignRequest, as sent in the presign request.
+struct TriphaseDocument {
+  std::string id;
+  std::optional<std::string> crypto_operation;
+  std::string signature_format;
+  std::string message_digest_algorithm;
+  std::optional<std::string> params;
+};
+
+// A SignRequest to sign.
+struct TriphaseJob {
+  std::string id;
+  // Missing when the request has no document list.
+  std::optional<std::vector<TriphaseDocument>> documents;
+};
+
+// Why a request failed. Each value stands for one of the RequestResult
+// outcomes of TriSigner.sign(); numbered as TriphaseFailure in
+// portafirmas_native.dart.
+enum class TriphaseFailure {
+  kNone = 0,
+  // NetworkException: 'Error de red'.
+  kNetwork = 1,
+  // Any other exception: 'Error de firma'.
+  kError = 2,
+  // A request of the presign response is KO: 'Error en la prefirma'.
+  kPresign = 3,
+  // Signing a document failed: no message.
+  kSignature = 4,
+  // The batch was cancelled before the request was sent.
+  kCancelled = 5,
+};
+
+struct TriphaseOutcome {
+  // Position of the request in the batch.
+  size_t index = 0;
+  // The request id, or the reference returned by the postsign.
+  std::string id;
+  bool status_ok = false;
+  TriphaseFailure failure = TriphaseFailure::kNone;
+  // Description of the failure, for the logs.
+  std::string detail;
+};
+
+struct TriphaseOptions {
+  // Presign requests in flight, which is also how far presigning may run
+  // ahead of signing.
+  size_t presign_window = 2;
+  // Postsign requests in flight, which is also how many signed requests may
+  // wait for one.
+  size_t postsign_window = 2;
+  // If set, every signed request is recorded here, under |journal_owner|,
+  // before its postsign is sent, and marked once the proxy answers it, so
+  // that Resume() can send what a crash or a lost response left behind.
+  // Must outlive the engine.
+  SigningJournal* journal = nullptr;
+  std::string journal_owner;
+};
+
+// Signs a batch of requests with the triphase protocol, pipelining the three
+// phases across requests: while request k is being signed, request k+1 is
+// presigned and request k-1 postsigned.
+//
+// Each request goes through the same steps as TriSigner.doSign() and fails on
+// its own, without affecting the others. Signing is serial and in batch
+// order, since it may need the user (PIN prompts) and a smart card.
+class NATIVE_CORE_EXPORT TriphaseEngine {
+ public:
+  using OutcomeCallback = std::function<void(const TriphaseOutcome& outcome)>;
+
+  // |transport| and |signer| must outlive the engine.
+  TriphaseEngine(TriphaseTransport* transport,
+                 Pkcs1Signer* signer,
+                 TriphaseOptions options = TriphaseOptions());
+
+  // Prevent copying.
+  TriphaseEngine(TriphaseEngine const&) = delete;
+  TriphaseEngine& operator=(TriphaseEngine const&) = delete;
+
+  // Runs the whole batch and returns when every request has an outcome.
+  // Signing runs on the calling thread, the network phases on threads of
+  // their own. |on_outcome| is called once per request, in completion order,
+  // never concurrently. Requests not yet presigned when |token| is cancelled
+  // end with kCancelled.
+  void Run(const std::vector<TriphaseJob>& jobs,
+           const OutcomeCallback& on_outcome,
+           CancellationToken token = CancellationToken());
+
+  // Sends the postsigns of |postsigns|, requests already signed and
+  // journaled by an earlier Run(), up to |postsign_window| at a time. Each
+  // outcome has the position of its request in |postsigns| as index; the
+  // signer is not used. Postsigns not yet sent when |token| is cancelled end
+  // with kCancelled and stay pending.
+  void Resume(const std::vector<JournaledPostsign>& postsigns,
+              const OutcomeCallback& on_outcome,
+              CancellationToken token = CancellationToken());
+
+ private:
+  TriphaseTransport* transport_;
+  Pkcs1Signer* signer_;
+  TriphaseOptions options_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_TRIPHASE_ENGINE_H_
@@ -0,0 +1,30 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_WAKEUP_H_
+#define NATIVE_CORE_WAKEUP_H_
+
+namespace native_core {
+
+// Something that makes the platform thread call PlatformDispatcher::Drain()
+// soon. Signal() is called from arbitrary threads.
+class Wakeup {
+ public:
+  virtual ~Wakeup() = default;
+
+  virtual void Signal() = 0;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_WAKEUP_H_
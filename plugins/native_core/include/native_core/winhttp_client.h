@@ -0,0 +1,68 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_WINHTTP_CLIENT_H_
+#define NATIVE_CORE_WINHTTP_CLIENT_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "export.h"
+#include "http_client.h"
+
+namespace native_core {
+
+// HTTP client backed by a single WinHTTP session.
+//
+// WinHTTP keeps the connections of a session alive and pools them per
+// server, and Schannel caches TLS sessions process-wide, so new connections
+// resume them. HTTP/2 is offered where the system supports it. The session's
+// own cookie handling is disabled: HttpClient keeps the session cookie.
+// Compressed responses are decoded by HttpClient, or by WinHTTP when the
+// build has no zlib.
+class NATIVE_CORE_EXPORT WinHttpClient : public HttpClient {
+ public:
+  explicit WinHttpClient(HttpClientOptions options);
+  ~WinHttpClient() override;
+
+  // Prevent copying.
+  WinHttpClient(WinHttpClient const&) = delete;
+  WinHttpClient& operator=(WinHttpClient const&) = delete;
+
+ protected:
+  // HttpClient:
+  void Perform(const std::string& url,
+               const HttpHeaders& headers,
+               const std::vector<uint8_t>& body,
+               const Sink& sink,
+               Exchange* exchange) override;
+  bool DecodesResponses() const override { return decodes_responses_; }
+
+ private:
+  // Returns the connection handle for |host| and |port|, opening it on first
+  // use. Null if it cannot be opened.
+  void* ConnectionFor(const std::wstring& host, unsigned short port);
+
+  // HINTERNET handles; kept opaque so that users need no WinHTTP headers.
+  void* session_ = nullptr;
+  bool decodes_responses_ = false;
+
+  std::mutex connections_mutex_;
+  std::map<std::wstring, void*> connections_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_WINHTTP_CLIENT_H_
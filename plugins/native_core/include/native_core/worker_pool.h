@@ -0,0 +1,71 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_WORKER_POOL_H_
+#define NATIVE_CORE_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// A fixed set of worker threads fed from a bounded FIFO.
+//
+// The queue bound is what keeps a burst of method calls from piling up
+// unbounded work: TryPost() refuses new tasks once |queue_capacity| tasks are
+// waiting, and callers are expected to report that back as a busy error.
+class NATIVE_CORE_EXPORT WorkerPool {
+ public:
+  using Task = std::function<void()>;
+
+  WorkerPool(size_t thread_count, size_t queue_capacity);
+
+  // Stops accepting tasks, runs the ones already queued and joins the workers.
+  ~WorkerPool();
+
+  // Prevent copying.
+  WorkerPool(WorkerPool const&) = delete;
+  WorkerPool& operator=(WorkerPool const&) = delete;
+
+  // Queues |task| for execution. Returns false if the queue is full or the
+  // pool is shutting down, in which case |task| is not run.
+  bool TryPost(Task task);
+
+  size_t thread_count() const { return workers_.size(); }
+
+  // Number of tasks waiting for a worker.
+  size_t pending() const;
+
+ private:
+  void WorkerMain();
+
+  const size_t queue_capacity_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::deque<Task> tasks_;
+  bool stopping_ = false;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_WORKER_POOL_H_
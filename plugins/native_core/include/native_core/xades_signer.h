@@ -0,0 +1,82 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_XADES_SIGNER_H_
+#define NATIVE_CORE_XADES_SIGNER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "export.h"
+#include "pkcs1_signer.h"
+
+namespace native_core {
+
+struct XadesOptions {
+  enum class Packaging {
+    // The signature goes into the document, as the last child of its root
+    // element.
+    kEnveloped,
+    // The signature is a document of its own referencing the signed one by
+    // |detached_uri|.
+    kDetached,
+  };
+
+  // Hashes the references and signs SignedInfo.
+  DigestAlgorithm digest = DigestAlgorithm::kSha256;
+  Packaging packaging = Packaging::kEnveloped;
+  // URI of the signed document in a detached signature, as the verifier
+  // will dereference it (e.g. its file name). Required for kDetached.
+  std::string detached_uri;
+  // MimeType of the DataObjectFormat of the signed document.
+  std::string mime_type = "text/xml";
+  // SigningTime; now if unset.
+  std::optional<std::chrono::system_clock::time_point> signing_time;
+};
+
+// What SignXml() did.
+struct XadesResult {
+  uint64_t input_size = 0;
+  uint64_t output_size = 0;
+  // Size of the ds:Signature element.
+  size_t signature_size = 0;
+};
+
+// Signs the XML document at |input_path| into |output_path| with a XAdES
+// baseline signature (ETSI EN 319 132-1, B-B): a ds:Signature with two
+// references, one to the document and one to the SignedProperties, signed
+// together in SignedInfo with RSA and |options.digest|. Every reference and
+// SignedInfo itself are canonicalized with Exclusive XML Canonicalization.
+//
+// The document reference is digested as the input streams through an
+// ExclusiveCanonicalizer, so no DOM is ever built; the input is mapped, and
+// read once more to be copied around the signature. The signature itself,
+// a few kilobytes, is built in memory. The signer is asked for exactly one
+// signature.
+//
+// Returns false, with a description in |error|, if the input cannot be read
+// or is not namespace-well-formed XML, or the signer fails. No output is
+// left behind then.
+NATIVE_CORE_EXPORT bool SignXml(Pkcs1Signer* signer,
+                                const std::string& input_path,
+                                const std::string& output_path,
+                                const XadesOptions& options,
+                                XadesResult* result,
+                                std::string* error);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_XADES_SIGNER_H_
@@ -0,0 +1,137 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_XML_CANONICALIZER_H_
+#define NATIVE_CORE_XML_CANONICALIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "export.h"
+#include "xml_pull_parser.h"
+
+namespace native_core {
+
+// Exclusive XML Canonicalization 1.0, without comments
+// (http://www.w3.org/2001/10/xml-exc-c14n#), of a whole document as it
+// streams through an XmlPullParser. The canonical form is handed to the sink
+// in chunks as it is produced and no tree is built: memory is bounded by the
+// open elements and their namespace declarations, not by the document.
+//
+// Enough for what is signed here: documents to be signed, and the parts of a
+// signature built on their own with their namespace declarations, which
+// canonicalize as they would in place. There is no DTD processing: entities
+// of an internal subset, default attributes and attribute types other than
+// CDATA are not supported, nor is an InclusiveNamespaces PrefixList.
+class NATIVE_CORE_EXPORT ExclusiveCanonicalizer {
+ public:
+  using Sink = std::function<void(const char* data, size_t size)>;
+
+  explicit ExclusiveCanonicalizer(Sink sink);
+  ~ExclusiveCanonicalizer();
+
+  // Prevent copying.
+  ExclusiveCanonicalizer(ExclusiveCanonicalizer const&) = delete;
+  ExclusiveCanonicalizer& operator=(ExclusiveCanonicalizer const&) = delete;
+
+  // Canonicalizes the next chunk of the document. Returns false, and ignores
+  // any further input, once it turns out not to be namespace-well-formed.
+  bool Feed(const char* data, size_t size);
+
+  // Marks the end of the document and hands the rest of the canonical form
+  // to the sink. Returns false if it was not well-formed or truncated.
+  bool Finish();
+
+  // Why canonicalization failed.
+  const std::string& error() const { return error_; }
+
+  // The root element as written, and the offsets in the input of its end
+  // tag, before which an enveloped signature goes. For a root written as an
+  // empty-element tag, the offsets of that tag. Valid once Finish() returned
+  // true.
+  const std::string& root_name() const { return root_name_; }
+  uint64_t root_end_begin() const { return root_end_begin_; }
+  uint64_t root_end_end() const { return root_end_end_; }
+  bool root_empty() const { return root_empty_; }
+
+  // Canonicalizes the document |xml| at once into |out|.
+  static bool Canonicalize(std::string_view xml,
+                           std::string* out,
+                           std::string* error);
+
+ private:
+  struct Binding {
+    std::string prefix;
+    std::string uri;
+  };
+
+  // An attribute of the element being written, with the namespace it sorts
+  // by.
+  struct SortedAttribute {
+    std::string_view uri;
+    std::string_view local_name;
+    const XmlPullParser::Attribute* attribute;
+  };
+
+  // Handles the events of what was fed so far.
+  bool Drain();
+
+  bool StartElement();
+  void EndElement();
+  void Other(const std::string& markup);
+
+  // The namespace |prefix| is bound to in |bindings|, innermost first, or
+  // null.
+  static const std::string* Find(const std::vector<Binding>& bindings,
+                                 std::string_view prefix);
+
+  void Append(std::string_view data);
+  // Appends |value| with the characters C14N escapes in text or, if
+  // |attribute|, in attribute values.
+  void AppendEscaped(std::string_view value, bool attribute);
+  void Flush();
+
+  bool Fail(std::string message);
+
+  Sink sink_;
+  XmlPullParser parser_;
+  std::string out_;
+  bool failed_ = false;
+  bool seen_root_ = false;
+
+  // Namespaces declared by the open elements, and those rendered in the
+  // output by them, innermost last; each open element marks where its own
+  // begin.
+  std::vector<Binding> declared_;
+  std::vector<Binding> rendered_;
+  std::vector<size_t> declared_marks_;
+  std::vector<size_t> rendered_marks_;
+
+  // Scratch for the element being written, kept between elements.
+  std::vector<SortedAttribute> attributes_;
+
+  std::string root_name_;
+  uint64_t root_begin_ = 0;
+  uint64_t root_end_begin_ = 0;
+  uint64_t root_end_end_ = 0;
+  bool root_empty_ = false;
+  std::string error_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_XML_CANONICALIZER_H_
@@ -0,0 +1,155 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_XML_PULL_PARSER_H_
+#define NATIVE_CORE_XML_PULL_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// Incremental XML tokenizer. Input is fed in arbitrary chunks as it arrives
+// from the network; Next() returns one event at a time and kNeedMoreData when
+// the next token is not complete yet.
+//
+// Covers what the proxy sends: elements, attributes, character data, CDATA,
+// comments, processing instructions and a DOCTYPE without internal subset.
+// The five predefined entities and character references are decoded; unknown
+// entities are left as written, as the Dart xml package does. Input must be
+// UTF-8.
+class NATIVE_CORE_EXPORT XmlPullParser {
+ public:
+  enum class Event {
+    kNeedMoreData,
+    kStartElement,
+    kEndElement,
+    // Character data or a CDATA section.
+    kText,
+    // A comment or processing instruction.
+    kOther,
+    kEndDocument,
+    kError,
+  };
+
+  struct Attribute {
+    std::string name;
+    std::string value;
+  };
+
+  XmlPullParser();
+
+  // Prevent copying.
+  XmlPullParser(XmlPullParser const&) = delete;
+  XmlPullParser& operator=(XmlPullParser const&) = delete;
+
+  void Feed(const char* data, size_t size);
+
+  // Marks the end of the input.
+  void Finish();
+
+  // Normalizes line ends in character data, and whitespace in attribute
+  // values, as XML 1.0 asks of a processor (2.11, 3.3.3): what the
+  // canonicalizer needs, and more than the proxy does. Off by default; set
+  // before the first Feed().
+  void set_normalize_whitespace(bool normalize) {
+    normalize_whitespace_ = normalize;
+  }
+
+  Event Next();
+
+  // Element name as written, prefix included. Valid after kStartElement and
+  // kEndElement.
+  const std::string& name() const { return name_; }
+
+  // Valid after kStartElement.
+  const std::vector<Attribute>& attributes() const { return attributes_; }
+
+  // First attribute whose name matches |lowercase_name| ignoring ASCII case,
+  // or nullptr.
+  const Attribute* FindAttribute(std::string_view lowercase_name) const;
+
+  // Decoded character data. Valid after kText. After kOther, the comment or
+  // processing instruction as written, delimiters included.
+  const std::string& text() const { return text_; }
+
+  // Offsets in the input of the first byte of the token just returned and of
+  // the byte after it. The kEndElement of an empty-element tag has those of
+  // the tag itself.
+  uint64_t token_begin() const { return token_begin_; }
+  uint64_t token_end() const { return token_end_; }
+
+  // Number of open elements: after kStartElement it counts the element just
+  // started, after kEndElement it no longer counts the one just closed.
+  size_t depth() const { return open_elements_.size(); }
+
+  // Description of the syntax error. Valid after kError.
+  const std::string& error() const { return error_; }
+
+ private:
+  Event ReadMarkup();
+  Event ReadText();
+  Event ReadStartTag(size_t end);
+  Event ReadEndTag(size_t end);
+
+  // Finds |terminator| at or after |from|, resuming the search where the last
+  // unsuccessful one stopped.
+  size_t FindFrom(size_t from, std::string_view terminator);
+
+  Event Fail(std::string message);
+
+  enum class Normalization { kNone, kText, kAttribute };
+
+  // Appends |raw| to |out| with entity and character references decoded,
+  // normalizing the whitespace written as such as |normalization| says.
+  static void Decode(std::string_view raw,
+                     Normalization normalization,
+                     std::string* out);
+
+  // Appends |literal|, which has no references, normalized.
+  static void AppendLiteral(std::string_view literal,
+                            Normalization normalization,
+                            std::string* out);
+
+  std::string buffer_;
+  // Input dropped from the front of |buffer_| so far.
+  uint64_t consumed_ = 0;
+  size_t position_ = 0;
+  uint64_t token_begin_ = 0;
+  uint64_t token_end_ = 0;
+  // Where the search for the end of the pending token resumes.
+  size_t scanned_ = 0;
+  bool finished_ = false;
+  bool failed_ = false;
+  bool normalize_whitespace_ = false;
+  bool root_closed_ = false;
+  bool seen_root_ = false;
+  // An empty-element tag was returned as kStartElement; its kEndElement is
+  // next.
+  bool pending_end_ = false;
+
+  std::vector<std::string> open_elements_;
+  std::string name_;
+  std::vector<Attribute> attributes_;
+  std::string text_;
+  std::string error_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_XML_PULL_PARSER_H_
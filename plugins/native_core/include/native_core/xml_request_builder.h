@@ -0,0 +1,132 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_XML_REQUEST_BUILDER_H_
+#define NATIVE_CORE_XML_REQUEST_BUILDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "export.h"
+
+namespace native_core {
+
+// Builders for the proxy requests that carry whole batches, producing the
+// form body "op=<operation>&dat=<xml>" that Api posts, with the XML encoded
+// as Api.base64UrlSafeEncode() does. The XML matches XmlRequestFactory in
+// lib/api byte for byte.
+//
+// Each body is generated twice: once to measure it and once to encode it
+// straight into a buffer of the exact final size, so the XML itself is
+// never materialized.
+//
+// The inputs only borrow their strings. A missing optional string is written
+// as "null", which is what Dart string interpolation does.
+using OptionalString = std::optional<std::string_view>;
+
+// A document of a presign request (SignRequestDocument).
+struct PresignDocument {
+  std::string_view id;
+  OptionalString crypto_operation;
+  std::string_view signature_format;
+  std::string_view message_digest_algorithm;
+  // Written empty when missing.
+  OptionalString params;
+};
+
+// A document of a postsign request (TriphaseSignRequestDocument).
+struct PostsignDocument {
+  OptionalString id;
+  OptionalString crypto_operation;
+  OptionalString signature_format;
+  OptionalString message_digest_algorithm;
+  // Written empty when missing.
+  OptionalString params;
+  // TriphaseConfigData, in iteration order.
+  std::vector<std::pair<std::string_view, std::string_view>> result;
+};
+
+// A request of a postsign batch (TriphaseRequest).
+struct PostsignRequest {
+  std::string_view ref;
+  bool status_ok = true;
+  // Only written for requests with status_ok.
+  std::vector<PostsignDocument> documents;
+};
+
+// XmlRequestFactory.createPresignRequest(). |documents| may be null.
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildPresignBody(
+    std::string_view operation,
+    std::string_view request_id,
+    const std::vector<PresignDocument>* documents);
+
+// XmlRequestFactory.createPostsignRequest().
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildPostsignBody(
+    std::string_view operation,
+    const std::vector<PostsignRequest>& requests);
+
+// XmlRequestFactory.createApproveRequest(). The caller rejects an empty list,
+// as the factory does.
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildApproveBody(
+    std::string_view operation,
+    const std::vector<std::string_view>& request_ids);
+
+// XmlRequestFactory.createRejectRequest(). An empty |reason| is omitted.
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildRejectBody(
+    std::string_view operation,
+    const std::vector<std::string_view>& request_ids,
+    std::string_view reason);
+
+// XmlRequestFactory.createRequestListRequest(). |filters|, "key=value"
+// strings, may be null.
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildRequestListBody(
+    std::string_view operation,
+    std::string_view state,
+    const std::vector<std::string_view>* filters,
+    int page,
+    int page_size);
+
+// XmlRequestFactory.createDetailRequest().
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildRequestDetailBody(
+    std::string_view operation,
+    std::string_view request_id);
+
+// XmlRequestFactory.createPreviewRequest(), for the document, signature and
+// report previews. Api puts it in the query of a GET; the proxy takes it as
+// a form body too.
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildPreviewBody(
+    std::string_view operation,
+    std::string_view document_id);
+
+// The challenge request of Api.loginRequest().
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildLoginRequestBody(
+    std::string_view operation);
+
+// The signed challenge of Api.login(): the DER certificate and the PKCS#1
+// signature, both already in standard base64.
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildLoginValidationBody(
+    std::string_view operation,
+    std::string_view certificate,
+    std::string_view pkcs1);
+
+// Api.logout().
+NATIVE_CORE_EXPORT std::vector<uint8_t> BuildLogoutBody(
+    std::string_view operation);
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_XML_REQUEST_BUILDER_H_
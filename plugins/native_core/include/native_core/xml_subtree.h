@@ -0,0 +1,116 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_XML_SUBTREE_H_
+#define NATIVE_CORE_XML_SUBTREE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "export.h"
+#include "xml_pull_parser.h"
+
+namespace native_core {
+
+// A small read-only tree built from XmlPullParser events, holding one record
+// of a response (e.g. one <rqt> of a request list) at a time. Clear() keeps
+// the storage, so parsing thousands of records does not allocate per record.
+//
+// Lookups mirror the Dart xml package as the response parsers use it:
+// element names compared lowercased, text() joining all descendant text.
+class NATIVE_CORE_EXPORT XmlSubtree {
+ public:
+  using NodeId = int32_t;
+  static constexpr NodeId kNone = -1;
+
+  enum class NodeKind : uint8_t { kElement, kText, kOther };
+
+  XmlSubtree() = default;
+
+  // Prevent copying.
+  XmlSubtree(XmlSubtree const&) = delete;
+  XmlSubtree& operator=(XmlSubtree const&) = delete;
+
+  void Clear();
+
+  bool empty() const { return nodes_.empty(); }
+
+  // Building, in document order.
+  void StartElement(const XmlPullParser& parser);
+  void EndElement();
+  void AddText(std::string_view text);
+  void AddOther();
+
+  // The first element added.
+  NodeId root() const { return nodes_.empty() ? kNone : 0; }
+
+  NodeKind kind(NodeId node) const { return nodes_[node].kind; }
+
+  // Element name as written, and lowercased.
+  std::string_view name(NodeId node) const;
+  std::string_view lowercase_name(NodeId node) const;
+
+  NodeId first_child(NodeId node) const { return nodes_[node].first_child; }
+  NodeId next_sibling(NodeId node) const { return nodes_[node].next_sibling; }
+
+  // First child element named |lowercase_name| (ignoring case), or kNone.
+  NodeId FindChild(NodeId node, std::string_view lowercase_name) const;
+
+  // First attribute of |node| named |lowercase_name| (ignoring case). Returns
+  // false if there is none.
+  bool FindAttribute(NodeId node, std::string_view lowercase_name,
+                     std::string_view* value) const;
+
+  // Concatenated text of all text and CDATA descendants.
+  std::string Text(NodeId node) const;
+
+ private:
+  struct Span {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+  };
+
+  struct Node {
+    NodeKind kind = NodeKind::kElement;
+    Span name;
+    Span lowercase_name;
+    Span text;
+    uint32_t first_attribute = 0;
+    uint32_t attribute_count = 0;
+    NodeId first_child = kNone;
+    NodeId last_child = kNone;
+    NodeId next_sibling = kNone;
+    // Index of the node that follows the whole subtree of this one.
+    NodeId subtree_end = kNone;
+  };
+
+  struct AttributeSpans {
+    Span lowercase_name;
+    Span value;
+  };
+
+  Span Store(std::string_view value);
+  std::string_view View(Span span) const;
+  NodeId Append(Node node);
+
+  std::string chars_;
+  std::vector<Node> nodes_;
+  std::vector<AttributeSpans> attributes_;
+  std::vector<NodeId> open_;
+};
+
+}  // namespace native_core
+
+#endif  // NATIVE_CORE_XML_SUBTREE_H_
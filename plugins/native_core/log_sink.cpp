@@ -0,0 +1,274 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/log_sink.h"
+
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "include/native_core/content_coding.h"
+
+namespace native_core {
+
+namespace {
+
+// Opens a file by its UTF-8 path.
+std::FILE* OpenFile(const std::string& path, const char* mode) {
+  std::filesystem::path file_path = std::filesystem::u8path(path);
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, file_path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                                     : nullptr;
+#else
+  return std::fopen(file_path.c_str(), mode);
+#endif
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* contents) {
+  std::FILE* file = OpenFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents->insert(contents->end(), buffer, buffer + read);
+  }
+  bool ok = !std::ferror(file);
+  std::fclose(file);
+  return ok;
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& contents) {
+  std::FILE* file = OpenFile(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = std::fwrite(contents.data(), 1, contents.size(), file) ==
+            contents.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<LogSink> LogSink::Open(LogSinkOptions options) {
+  std::FILE* file = OpenFile(options.path, options.truncate ? "wb" : "ab");
+  if (!file) {
+    return nullptr;
+  }
+  std::error_code error;
+  uintmax_t size =
+      std::filesystem::file_size(std::filesystem::u8path(options.path), error);
+  return std::unique_ptr<LogSink>(
+      new LogSink(std::move(options), file, error ? 0 : size));
+}
+
+LogSink::LogSink(LogSinkOptions options, std::FILE* file, uint64_t file_size)
+    : options_(std::move(options)),
+      records_(options_.max_buffered_records),
+      file_(file),
+      file_size_(file_size),
+      writer_(&LogSink::WriterMain, this) {}
+
+LogSink::~LogSink() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_one();
+  writer_.join();
+  if (file_) {
+    std::fclose(file_);
+  }
+}
+
+bool LogSink::Write(std::string record) {
+  size_t size = record.size();
+  for (;;) {
+    // Counted before the push so that the writer never subtracts a record
+    // that has not been added yet.
+    size_t previous = buffered_bytes_.fetch_add(size, std::memory_order_acq_rel);
+    bool fits = previous == 0 || previous + size <= options_.max_buffered_bytes;
+    if (fits && records_.TryPush(record)) {
+      if (previous < options_.batch_bytes &&
+          previous + size >= options_.batch_bytes) {
+        work_available_.notify_one();
+      }
+      return true;
+    }
+    buffered_bytes_.fetch_sub(size, std::memory_order_acq_rel);
+    if (options_.overflow == LogOverflow::kDrop) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    room_requested_++;
+    work_available_.notify_one();
+    // Bounded so that a wake-up racing with the writer is never lost.
+    room_available_.wait_for(lock, std::chrono::milliseconds(10));
+  }
+}
+
+void LogSink::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t request = ++flush_requested_;
+  work_available_.notify_one();
+  flushed_.wait(lock, [&]() { return flush_done_ >= request || stopping_; });
+}
+
+LogSinkStats LogSink::stats() const {
+  LogSinkStats stats;
+  stats.records = records_written_.load(std::memory_order_relaxed);
+  stats.dropped = dropped_.load(std::memory_order_relaxed);
+  stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+  stats.batches = batches_.load(std::memory_order_relaxed);
+  stats.rotations = rotations_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void LogSink::WriterMain() {
+  std::string batch;
+  std::string record;
+  uint64_t dropped_reported = 0;
+  for (;;) {
+    bool stopping;
+    uint64_t flush_request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait_for(lock, options_.flush_interval, [this]() {
+        return stopping_ || flush_requested_ != flush_done_ ||
+               room_requested_ != room_done_ ||
+               buffered_bytes_.load(std::memory_order_acquire) >=
+                   options_.batch_bytes;
+      });
+      stopping = stopping_;
+      flush_request = flush_requested_;
+      // Blocked writers are woken below, once the buffer is drained.
+      room_done_ = room_requested_;
+    }
+
+    // Everything accepted before the wake-up, written with as few calls as
+    // rotation allows.
+    uint64_t count = 0;
+    while (records_.TryPop(&record)) {
+      buffered_bytes_.fetch_sub(record.size(), std::memory_order_acq_rel);
+      uint64_t size = file_size_ + batch.size();
+      if (options_.max_file_bytes > 0 && size > 0 &&
+          size + record.size() > options_.max_file_bytes) {
+        WriteBatch(batch);
+        batch.clear();
+        Rotate();
+      }
+      batch.append(record);
+      count++;
+    }
+    room_available_.notify_all();
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != dropped_reported) {
+      batch.append("WARNING: ")
+          .append(std::to_string(dropped - dropped_reported))
+          .append(" log records dropped.\n");
+      dropped_reported = dropped;
+    }
+    WriteBatch(batch);
+    batch.clear();
+    records_written_.fetch_add(count, std::memory_order_relaxed);
+
+    if (flush_request != flush_done_ || stopping) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      flush_done_ = flush_request;
+    }
+    flushed_.notify_all();
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void LogSink::WriteBatch(const std::string& batch) {
+  if (batch.empty()) {
+    return;
+  }
+  if (!file_) {
+    // Rotation could not open a new file; try again.
+    file_ = OpenFile(options_.path, "ab");
+    if (!file_) {
+      return;
+    }
+  }
+  size_t written = std::fwrite(batch.data(), 1, batch.size(), file_);
+  // Handed to the system on every batch so that the file can be read, and
+  // survives a crash, without waiting for the sink to close.
+  std::fflush(file_);
+  file_size_ += written;
+  bytes_written_.fetch_add(written, std::memory_order_relaxed);
+  batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LogSink::Rotate() {
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  std::filesystem::path path = std::filesystem::u8path(options_.path);
+  std::error_code error;
+  if (options_.max_rotated_files == 0) {
+    std::filesystem::remove(path, error);
+  }
+  else {
+    std::filesystem::remove(
+        std::filesystem::u8path(RotatedPath(options_.max_rotated_files)),
+        error);
+    for (size_t index = options_.max_rotated_files - 1; index > 0; index--) {
+      std::filesystem::rename(std::filesystem::u8path(RotatedPath(index)),
+                              std::filesystem::u8path(RotatedPath(index + 1)),
+                              error);
+    }
+    std::vector<uint8_t> contents;
+    std::vector<uint8_t> compressed;
+    if (RotatedPath(1) != options_.path + ".1" &&
+        ReadFile(options_.path, &contents) &&
+        GzipCompress(contents.data(), contents.size(), &compressed) &&
+        WriteFile(RotatedPath(1), compressed)) {
+      std::filesystem::remove(path, error);
+    }
+    else {
+      // Uncompressed if it cannot be compressed.
+      std::filesystem::rename(path, std::filesystem::u8path(options_.path + ".1"),
+                              error);
+    }
+  }
+  file_ = OpenFile(options_.path, "wb");
+  file_size_ = 0;
+  rotations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string LogSink::RotatedPath(size_t index) const {
+  std::string rotated = options_.path + "." + std::to_string(index);
+  // zlib is in the build if gzip can be decoded.
+  if (options_.compress_rotated && CanDecode(ContentCoding::kGzip)) {
+    rotated.append(".gz");
+  }
+  return rotated;
+}
+
+}  // namespace native_core
@@ -0,0 +1,81 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/message_window_wakeup.h"
+
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+constexpr const wchar_t kWindowClassName[] = L"NATIVE_CORE_WAKEUP_WINDOW";
+
+// Private to our own window class, so WM_APP is safe to use.
+constexpr UINT kWakeMessage = WM_APP + 1;
+
+}  // namespace
+
+MessageWindowWakeup::MessageWindowWakeup(std::function<void()> on_wake)
+    : on_wake_(std::move(on_wake)) {
+  HINSTANCE instance = nullptr;
+  ::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                           GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                       reinterpret_cast<LPCWSTR>(&MessageWindowWakeup::WndProc),
+                       &instance);
+
+  WNDCLASSW window_class{};
+  window_class.lpfnWndProc = MessageWindowWakeup::WndProc;
+  window_class.hInstance = instance;
+  window_class.lpszClassName = kWindowClassName;
+  // Fails harmlessly with ERROR_CLASS_ALREADY_EXISTS on later instances.
+  ::RegisterClassW(&window_class);
+
+  window_ = ::CreateWindowExW(0, kWindowClassName, L"", 0, 0, 0, 0, 0,
+                              HWND_MESSAGE, nullptr, instance, nullptr);
+  if (window_) {
+    ::SetWindowLongPtr(window_, GWLP_USERDATA,
+                       reinterpret_cast<LONG_PTR>(this));
+  }
+}
+
+MessageWindowWakeup::~MessageWindowWakeup() {
+  if (window_) {
+    ::DestroyWindow(window_);
+    window_ = nullptr;
+  }
+}
+
+void MessageWindowWakeup::Signal() {
+  if (window_) {
+    ::PostMessage(window_, kWakeMessage, 0, 0);
+  }
+}
+
+// static
+LRESULT CALLBACK MessageWindowWakeup::WndProc(HWND const window,
+                                              UINT const message,
+                                              WPARAM const wparam,
+                                              LPARAM const lparam) noexcept {
+  if (message == kWakeMessage) {
+    auto* that = reinterpret_cast<MessageWindowWakeup*>(
+        ::GetWindowLongPtr(window, GWLP_USERDATA));
+    if (that && that->on_wake_) {
+      that->on_wake_();
+    }
+    return 0;
+  }
+  return ::DefWindowProc(window, message, wparam, lparam);
+}
+
+}  // namespace native_core
@@ -0,0 +1,497 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/pades_signer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "include/native_core/cades_signature.h"
+#include "include/native_core/digest.h"
+#include "include/native_core/pdf_document.h"
+
+namespace native_core {
+
+namespace {
+
+// Bytes copied and hashed at a time.
+constexpr size_t kCopyChunk = 4 << 20;
+// Room for "0 offset offset length" in the /ByteRange placeholder.
+constexpr size_t kByteRangeWidth = 64;
+
+// Opens a file by its UTF-8 path.
+std::FILE* OpenFile(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                               : nullptr;
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+// A PDF text string (ISO 32000-1, 7.9.2.2): ASCII as is, anything else in
+// UTF-16BE with a byte order mark.
+std::string TextString(const std::string& utf8) {
+  if (std::all_of(utf8.begin(), utf8.end(),
+                  [](char c) { return c >= ' ' && c < 0x7f; })) {
+    return utf8;
+  }
+  std::string out = "\xfe\xff";
+  auto unit = [&out](uint32_t value) {
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value & 0xff));
+  };
+  size_t i = 0;
+  while (i < utf8.size()) {
+    uint8_t lead = static_cast<uint8_t>(utf8[i++]);
+    int extra = lead < 0x80 ? 0 : lead >= 0xf0 ? 3 : lead >= 0xe0 ? 2
+                                 : lead >= 0xc0 ? 1 : -1;
+    uint32_t code = extra == 0 ? lead : lead & (0x3f >> extra);
+    for (int k = 0; k < extra; ++k) {
+      if (i >= utf8.size() || (utf8[i] & 0xc0) != 0x80) {
+        extra = -1;
+        break;
+      }
+      code = (code << 6) | (static_cast<uint8_t>(utf8[i++]) & 0x3f);
+    }
+    if (extra < 0 || code > 0x10ffff) {
+      code = 0xfffd;
+    }
+    if (code >= 0x10000) {
+      code -= 0x10000;
+      unit(0xd800 | (code >> 10));
+      unit(0xdc00 | (code & 0x3ff));
+    }
+    else {
+      unit(code);
+    }
+  }
+  return out;
+}
+
+// A PDF date (ISO 32000-1, 7.9.4), in UTC.
+std::string PdfDate(std::chrono::system_clock::time_point time) {
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  std::tm utc{};
+#ifdef _WIN32
+  gmtime_s(&utc, &seconds);
+#else
+  gmtime_r(&seconds, &utc);
+#endif
+  char text[64];
+  std::snprintf(text, sizeof(text), "D:%04d%02d%02d%02d%02d%02d+00'00'",
+                utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour,
+                utc.tm_min, utc.tm_sec);
+  return text;
+}
+
+// Whether the document carries a certification signature that allows no
+// changes at all (ISO 32000-1, 12.8.2.2).
+bool ForbidsChanges(PdfDocument* document, const PdfObject& catalog) {
+  const PdfObject* permissions = document->Resolve(catalog.Find("Perms"));
+  const PdfObject* certification =
+      permissions != nullptr ? document->Resolve(permissions->Find("DocMDP"))
+                             : nullptr;
+  const PdfObject* references =
+      certification != nullptr
+          ? document->Resolve(certification->Find("Reference"))
+          : nullptr;
+  if (references == nullptr || references->type != PdfObject::Type::kArray) {
+    return false;
+  }
+  for (const PdfObject& item : references->items) {
+    const PdfObject* reference = document->Resolve(&item);
+    const PdfObject* parameters =
+        reference != nullptr
+            ? document->Resolve(reference->Find("TransformParams"))
+            : nullptr;
+    const PdfObject* access =
+        parameters != nullptr ? document->Resolve(parameters->Find("P"))
+                              : nullptr;
+    if (access != nullptr && access->Number() == 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A copy of the array |object| resolves to, or an empty array.
+PdfObject ArrayCopy(PdfDocument* document, const PdfObject* object) {
+  const PdfObject* array = document->Resolve(object);
+  if (array != nullptr && array->type == PdfObject::Type::kArray) {
+    return *array;
+  }
+  PdfObject empty;
+  empty.type = PdfObject::Type::kArray;
+  return empty;
+}
+
+// A field name that no top-level field of the form uses yet.
+std::string UniqueFieldName(PdfDocument* document, const PdfObject& fields) {
+  std::vector<std::string> names;
+  for (const PdfObject& item : fields.items) {
+    const PdfObject* field = document->Resolve(&item);
+    const PdfObject* name =
+        field != nullptr ? document->Resolve(field->Find("T")) : nullptr;
+    if (name != nullptr && name->type == PdfObject::Type::kString) {
+      names.push_back(name->text);
+    }
+  }
+  for (size_t i = 1;; ++i) {
+    std::string name = "Signature" + std::to_string(i);
+    if (std::find(names.begin(), names.end(), name) == names.end()) {
+      return name;
+    }
+  }
+}
+
+// An object written in the incremental update.
+struct WrittenObject {
+  uint32_t number;
+  uint16_t generation;
+  uint64_t offset;
+};
+
+// Cross-reference subsections for |objects|: runs of consecutive numbers,
+// as (first number, first index in |objects|, count).
+struct Subsection {
+  uint32_t first;
+  size_t index;
+  size_t count;
+};
+
+std::vector<Subsection> Subsections(std::vector<WrittenObject>* objects) {
+  std::sort(objects->begin(), objects->end(),
+            [](const WrittenObject& a, const WrittenObject& b) {
+              return a.number < b.number;
+            });
+  std::vector<Subsection> subsections;
+  for (size_t i = 0; i < objects->size(); ++i) {
+    uint32_t number = (*objects)[i].number;
+    if (subsections.empty() ||
+        subsections.back().first + subsections.back().count != number) {
+      subsections.push_back({number, i, 0});
+    }
+    ++subsections.back().count;
+  }
+  return subsections;
+}
+
+// The trailer entries an incremental update carries over (ISO 32000-1,
+// 7.5.6): the old ones but those of the previous section itself.
+PdfObject UpdatedTrailer(const PdfDocument& document, uint32_t size) {
+  PdfObject trailer = document.trailer();
+  for (const char* key : {"Prev", "XRefStm", "Type", "W", "Index", "Filter",
+                          "DecodeParms", "Length", "DL"}) {
+    trailer.Remove(key);
+  }
+  trailer.Set("Size", PdfObject::Integer(size));
+  trailer.Set("Prev", PdfObject::Integer(
+                          static_cast<int64_t>(document.last_xref_offset())));
+  return trailer;
+}
+
+}  // namespace
+
+bool SignPdf(Pkcs1Signer* signer,
+             const std::string& input_path,
+             const std::string& output_path,
+             const PadesOptions& options,
+             PadesResult* result,
+             std::string* error) {
+  std::error_code same_error;
+  if (std::filesystem::equivalent(std::filesystem::u8path(input_path),
+                                  std::filesystem::u8path(output_path),
+                                  same_error)) {
+    *error = "The signed PDF file must be written to another file.";
+    return false;
+  }
+  std::vector<uint8_t> certificate = signer->Certificate();
+  if (certificate.empty()) {
+    *error = "The signing certificate is not available.";
+    return false;
+  }
+  std::unique_ptr<PdfDocument> document = PdfDocument::Open(input_path, error);
+  if (!document) {
+    return false;
+  }
+  if (document->trailer().Find("Encrypt") != nullptr) {
+    *error = "Encrypted PDF files cannot be signed.";
+    return false;
+  }
+  PdfObject catalog = *document->Catalog();
+  if (ForbidsChanges(document.get(), catalog)) {
+    *error = "The PDF file is certified and allows no further signatures.";
+    return false;
+  }
+  PdfObject page_reference;
+  const PdfObject* root = document->trailer().Find("Root");
+  const PdfObject* page = document->PageReference(0, &page_reference)
+                              ? document->Resolve(&page_reference)
+                              : nullptr;
+  if (root == nullptr || root->type != PdfObject::Type::kReference ||
+      page == nullptr || page->type != PdfObject::Type::kDictionary) {
+    *error = "The PDF file has no pages.";
+    return false;
+  }
+
+  // The new and changed objects: the signature, its field (merged with its
+  // widget annotation), the catalog with the field in its form, and the
+  // first page with the widget among its annotations.
+  uint32_t signature_number = document->object_count();
+  uint32_t field_number = signature_number + 1;
+
+  PdfObject form;
+  const PdfObject* old_form = document->Resolve(catalog.Find("AcroForm"));
+  if (old_form != nullptr && old_form->type == PdfObject::Type::kDictionary) {
+    form = *old_form;
+  }
+  form.type = PdfObject::Type::kDictionary;
+  PdfObject fields = ArrayCopy(document.get(), form.Find("Fields"));
+  std::string field_name = UniqueFieldName(document.get(), fields);
+  fields.items.push_back(PdfObject::Reference(field_number));
+  form.Set("Fields", std::move(fields));
+  // SignaturesExist and AppendOnly.
+  const PdfObject* flags = document->Resolve(form.Find("SigFlags"));
+  form.Set("SigFlags", PdfObject::Integer(
+                           (flags != nullptr
+                                ? static_cast<int64_t>(flags->Number())
+                                : 0) |
+                           3));
+  catalog.Set("AcroForm", std::move(form));
+
+  PdfObject new_page = *page;
+  PdfObject annotations = ArrayCopy(document.get(), new_page.Find("Annots"));
+  annotations.items.push_back(PdfObject::Reference(field_number));
+  new_page.Set("Annots", std::move(annotations));
+
+  PdfObject field;
+  field.type = PdfObject::Type::kDictionary;
+  field.Set("Type", PdfObject::Name("Annot"));
+  field.Set("Subtype", PdfObject::Name("Widget"));
+  field.Set("FT", PdfObject::Name("Sig"));
+  field.Set("T", PdfObject::String(field_name));
+  field.Set("V", PdfObject::Reference(signature_number));
+  field.Set("P", page_reference);
+  PdfObject rectangle;
+  rectangle.type = PdfObject::Type::kArray;
+  rectangle.items.assign(4, PdfObject::Integer(0));
+  field.Set("Rect", std::move(rectangle));
+  // Print and Locked: an invisible signature.
+  field.Set("F", PdfObject::Integer(132));
+
+  // The incremental update, after the whole input.
+  const uint64_t base = document->size();
+  std::string update;
+  uint8_t last = document->data()[base - 1];
+  if (last != '\n' && last != '\r') {
+    update.push_back('\n');
+  }
+  std::vector<WrittenObject> written;
+  auto begin_object = [&](uint32_t number, uint16_t generation) {
+    written.push_back({number, generation, base + update.size()});
+    update += std::to_string(number) + " " + std::to_string(generation) +
+              " obj\n";
+  };
+  const char* end_object = "\nendobj\n";
+
+  size_t reserved = options.reserved_size > 0
+                        ? options.reserved_size
+                        : certificate.size() * 2 + 2048;
+  begin_object(signature_number, 0);
+  update +=
+      "<</Type /Sig /Filter /Adobe.PPKLite /SubFilter /ETSI.CAdES.detached";
+  update += " /M " + SerializePdfObject(PdfObject::String(PdfDate(
+                         options.signing_time.value_or(
+                             std::chrono::system_clock::now()))));
+  if (!options.reason.empty()) {
+    update += " /Reason " +
+              SerializePdfObject(PdfObject::String(TextString(options.reason)));
+  }
+  if (!options.location.empty()) {
+    update += " /Location " + SerializePdfObject(PdfObject::String(
+                                  TextString(options.location)));
+  }
+  update += " /ByteRange [";
+  size_t byte_range_at = update.size();
+  update.append(kByteRangeWidth, ' ');
+  update += "] /Contents ";
+  size_t contents_at = update.size();
+  update.push_back('<');
+  update.append(reserved * 2, '0');
+  update.push_back('>');
+  size_t contents_end = update.size();
+  update += ">>";
+  update += end_object;
+
+  begin_object(field_number, 0);
+  update += SerializePdfObject(field) + end_object;
+  begin_object(root->number, root->generation);
+  update += SerializePdfObject(catalog) + end_object;
+  begin_object(page_reference.number, page_reference.generation);
+  update += SerializePdfObject(new_page) + end_object;
+
+  uint64_t xref_offset = base + update.size();
+  if (!document->xref_is_stream()) {
+    std::vector<Subsection> subsections = Subsections(&written);
+    update += "xref\n";
+    for (const Subsection& subsection : subsections) {
+      update += std::to_string(subsection.first) + " " +
+                std::to_string(subsection.count) + "\n";
+      for (size_t i = 0; i < subsection.count; ++i) {
+        const WrittenObject& object = written[subsection.index + i];
+        char entry[32];
+        std::snprintf(entry, sizeof(entry), "%010llu %05u n\r\n",
+                      static_cast<unsigned long long>(object.offset),
+                      static_cast<unsigned>(object.generation));
+        update += entry;
+      }
+    }
+    update += "trailer\n" +
+              SerializePdfObject(UpdatedTrailer(*document, field_number + 1)) +
+              "\n";
+  }
+  else {
+    // A file that uses cross-reference streams goes on with one,
+    // uncompressed.
+    uint32_t xref_number = field_number + 1;
+    written.push_back({xref_number, 0, xref_offset});
+    std::vector<Subsection> subsections = Subsections(&written);
+    size_t offset_width = 1;
+    while (offset_width < 8 && (xref_offset >> (8 * offset_width)) > 0) {
+      ++offset_width;
+    }
+    std::string data;
+    PdfObject index;
+    index.type = PdfObject::Type::kArray;
+    for (const Subsection& subsection : subsections) {
+      index.items.push_back(PdfObject::Integer(subsection.first));
+      index.items.push_back(
+          PdfObject::Integer(static_cast<int64_t>(subsection.count)));
+      for (size_t i = 0; i < subsection.count; ++i) {
+        const WrittenObject& object = written[subsection.index + i];
+        data.push_back(1);
+        for (size_t byte = offset_width; byte-- > 0;) {
+          data.push_back(static_cast<char>(object.offset >> (8 * byte)));
+        }
+        data.push_back(static_cast<char>(object.generation >> 8));
+        data.push_back(static_cast<char>(object.generation & 0xff));
+      }
+    }
+    PdfObject widths;
+    widths.type = PdfObject::Type::kArray;
+    widths.items = {PdfObject::Integer(1),
+                    PdfObject::Integer(static_cast<int64_t>(offset_width)),
+                    PdfObject::Integer(2)};
+    PdfObject dictionary = UpdatedTrailer(*document, xref_number + 1);
+    dictionary.Set("Type", PdfObject::Name("XRef"));
+    dictionary.Set("W", std::move(widths));
+    dictionary.Set("Index", std::move(index));
+    dictionary.Set("Length",
+                   PdfObject::Integer(static_cast<int64_t>(data.size())));
+    update += std::to_string(xref_number) + " 0 obj\n" +
+              SerializePdfObject(dictionary) + "\nstream\r\n" + data +
+              "\r\nendstream" + end_object;
+  }
+  update += "startxref\n" + std::to_string(xref_offset) + "\n%%EOF\n";
+
+  // The signed ranges: everything but the /Contents hex string.
+  uint64_t hole_begin = base + contents_at;
+  uint64_t hole_end = base + contents_end;
+  uint64_t total = base + update.size();
+  char byte_range[kByteRangeWidth + 1];
+  int byte_range_size = std::snprintf(
+      byte_range, sizeof(byte_range), "0 %llu %llu %llu",
+      static_cast<unsigned long long>(hole_begin),
+      static_cast<unsigned long long>(hole_end),
+      static_cast<unsigned long long>(total - hole_end));
+  std::memcpy(&update[byte_range_at], byte_range,
+              static_cast<size_t>(byte_range_size));
+
+  std::filesystem::path path = std::filesystem::u8path(output_path);
+  std::FILE* output = OpenFile(path, "wb");
+  if (output == nullptr) {
+    *error = "The signed PDF file cannot be created.";
+    return false;
+  }
+  auto fail = [&](const char* message) {
+    std::fclose(output);
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+    if (message != nullptr) {
+      *error = message;
+    }
+    return false;
+  };
+
+  // Copies the input while hashing it, one sequential pass over the mapping.
+  Digester digester(options.digest);
+  for (uint64_t offset = 0; offset < base; offset += kCopyChunk) {
+    size_t size = static_cast<size_t>(std::min<uint64_t>(kCopyChunk,
+                                                         base - offset));
+    const uint8_t* chunk = document->data() + offset;
+    digester.Update(chunk, size);
+    if (std::fwrite(chunk, 1, size, output) != size) {
+      return fail("The signed PDF file cannot be written.");
+    }
+    document->file().Release(static_cast<size_t>(offset), size);
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(update.data());
+  digester.Update(bytes, contents_at);
+  digester.Update(bytes + contents_end, update.size() - contents_end);
+
+  CadesOptions cades;
+  cades.digest = options.digest;
+  // The signing time goes in /M (ETSI EN 319 142-1, 5.4.3).
+  cades.signing_time_attribute = false;
+  std::vector<uint8_t> signature;
+  if (!BuildDetachedCadesSignature(signer, certificate, digester.Finish(),
+                                   cades, &signature, error)) {
+    return fail(nullptr);
+  }
+  if (signature.size() > reserved) {
+    return fail("The signature does not fit in the room reserved for it.");
+  }
+  static constexpr char kHex[] = "0123456789ABCDEF";
+  for (size_t i = 0; i < signature.size(); ++i) {
+    update[contents_at + 1 + 2 * i] = kHex[signature[i] >> 4];
+    update[contents_at + 2 + 2 * i] = kHex[signature[i] & 0x0f];
+  }
+  if (std::fwrite(update.data(), 1, update.size(), output) != update.size() ||
+      std::fflush(output) != 0) {
+    return fail("The signed PDF file cannot be written.");
+  }
+  if (std::fclose(output) != 0) {
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+    *error = "The signed PDF file cannot be written.";
+    return false;
+  }
+  if (result != nullptr) {
+    result->input_size = base;
+    result->output_size = total;
+    result->signature_size = signature.size();
+    result->reserved_size = reserved;
+  }
+  return true;
+}
+
+}  // namespace native_core
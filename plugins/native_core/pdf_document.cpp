@@ -0,0 +1,1151 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/pdf_document.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "include/native_core/content_coding.h"
+
+namespace native_core {
+
+namespace {
+
+// Nesting allowed for arrays and dictionaries, against stack exhaustion.
+constexpr int kMaxDepth = 64;
+// The highest object number a PDF file may use (ISO 32000-1, C.2).
+constexpr uint32_t kMaxObjectNumber = 8388607;
+// How far from the end of the file startxref is looked for.
+constexpr size_t kTailSize = 1024;
+
+bool IsWhitespace(uint8_t c) {
+  return c == 0 || c == '\t' || c == '\n' || c == '\f' || c == '\r' ||
+         c == ' ';
+}
+
+bool IsDelimiter(uint8_t c) {
+  return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' ||
+         c == ']' || c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+bool IsRegular(uint8_t c) {
+  return !IsWhitespace(c) && !IsDelimiter(c);
+}
+
+int HexValue(uint8_t c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool IsNumber(std::string_view token) {
+  if (token.empty()) {
+    return false;
+  }
+  bool digits = false;
+  for (size_t i = 0; i < token.size(); ++i) {
+    char c = token[i];
+    if (c >= '0' && c <= '9') {
+      digits = true;
+    }
+    else if (c != '.' && !((c == '+' || c == '-') && i == 0)) {
+      return false;
+    }
+  }
+  return digits;
+}
+
+bool ParseUnsigned(std::string_view token, uint64_t* value) {
+  if (token.empty() || token.size() > 19) {
+    return false;
+  }
+  uint64_t result = 0;
+  for (char c : token) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    result = result * 10 + static_cast<uint64_t>(c - '0');
+  }
+  *value = result;
+  return true;
+}
+
+// Reads PDF syntax from a buffer.
+class Parser {
+ public:
+  Parser(const uint8_t* data, size_t size, size_t position)
+      : data_(data), size_(size), position_(std::min(position, size)) {}
+
+  size_t position() const { return position_; }
+  void Seek(size_t position) { position_ = std::min(position, size_); }
+
+  // Skips whitespace and comments.
+  void SkipWhitespace() {
+    while (position_ < size_) {
+      uint8_t c = data_[position_];
+      if (c == '%') {
+        while (position_ < size_ && data_[position_] != '\n' &&
+               data_[position_] != '\r') {
+          ++position_;
+        }
+      }
+      else if (IsWhitespace(c)) {
+        ++position_;
+      }
+      else {
+        break;
+      }
+    }
+  }
+
+  // The run of regular characters at the current position (a keyword or a
+  // number), consumed.
+  std::string_view ReadToken() {
+    SkipWhitespace();
+    size_t start = position_;
+    while (position_ < size_ && IsRegular(data_[position_])) {
+      ++position_;
+    }
+    return std::string_view(reinterpret_cast<const char*>(data_) + start,
+                            position_ - start);
+  }
+
+  // Consumes |keyword| if it is the next token.
+  bool ReadKeyword(std::string_view keyword) {
+    size_t start = position_;
+    if (ReadToken() == keyword) {
+      return true;
+    }
+    position_ = start;
+    return false;
+  }
+
+  bool ReadUnsigned(uint64_t* value) {
+    size_t start = position_;
+    if (ParseUnsigned(ReadToken(), value)) {
+      return true;
+    }
+    position_ = start;
+    return false;
+  }
+
+  bool ReadObject(PdfObject* object, int depth = 0) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    SkipWhitespace();
+    if (position_ >= size_) {
+      return false;
+    }
+    uint8_t c = data_[position_];
+    switch (c) {
+      case '/':
+        ++position_;
+        object->type = PdfObject::Type::kName;
+        return ReadName(&object->text);
+      case '(':
+        ++position_;
+        object->type = PdfObject::Type::kString;
+        return ReadLiteralString(&object->text);
+      case '[':
+        ++position_;
+        object->type = PdfObject::Type::kArray;
+        return ReadArray(object, depth);
+      case '<':
+        if (position_ + 1 < size_ && data_[position_ + 1] == '<') {
+          position_ += 2;
+          object->type = PdfObject::Type::kDictionary;
+          return ReadDictionary(object, depth);
+        }
+        ++position_;
+        object->type = PdfObject::Type::kString;
+        return ReadHexString(&object->text);
+      default:
+        break;
+    }
+    std::string_view token = ReadToken();
+    if (token == "true" || token == "false") {
+      object->type = PdfObject::Type::kBoolean;
+      object->boolean = token == "true";
+      return true;
+    }
+    if (token == "null") {
+      object->type = PdfObject::Type::kNull;
+      return true;
+    }
+    if (!IsNumber(token)) {
+      return false;
+    }
+    // "number generation R" is a reference.
+    uint64_t number;
+    if (ParseUnsigned(token, &number)) {
+      size_t after = position_;
+      uint64_t generation;
+      if (ReadUnsigned(&generation) && ReadKeyword("R") &&
+          number <= kMaxObjectNumber && generation <= 65535) {
+        *object = PdfObject::Reference(static_cast<uint32_t>(number),
+                                       static_cast<uint16_t>(generation));
+        return true;
+      }
+      position_ = after;
+    }
+    object->type = PdfObject::Type::kNumber;
+    object->text = std::string(token);
+    return true;
+  }
+
+ private:
+  bool ReadName(std::string* name) {
+    while (position_ < size_ && IsRegular(data_[position_])) {
+      uint8_t c = data_[position_++];
+      if (c == '#' && position_ + 1 < size_) {
+        int high = HexValue(data_[position_]);
+        int low = HexValue(data_[position_ + 1]);
+        if (high >= 0 && low >= 0) {
+          name->push_back(static_cast<char>(high * 16 + low));
+          position_ += 2;
+          continue;
+        }
+      }
+      name->push_back(static_cast<char>(c));
+    }
+    return true;
+  }
+
+  bool ReadLiteralString(std::string* bytes) {
+    int open = 1;
+    while (position_ < size_) {
+      uint8_t c = data_[position_++];
+      if (c == '(') {
+        ++open;
+      }
+      else if (c == ')') {
+        if (--open == 0) {
+          return true;
+        }
+      }
+      else if (c == '\r') {
+        // An end of line stands for a line feed, whatever its bytes.
+        if (position_ < size_ && data_[position_] == '\n') {
+          ++position_;
+        }
+        c = '\n';
+      }
+      else if (c == '\\' && position_ < size_) {
+        c = data_[position_++];
+        switch (c) {
+          case 'n':
+            c = '\n';
+            break;
+          case 'r':
+            c = '\r';
+            break;
+          case 't':
+            c = '\t';
+            break;
+          case 'b':
+            c = '\b';
+            break;
+          case 'f':
+            c = '\f';
+            break;
+          case '\r':
+            if (position_ < size_ && data_[position_] == '\n') {
+              ++position_;
+            }
+            continue;
+          case '\n':
+            continue;
+          default:
+            if (c >= '0' && c <= '7') {
+              int value = c - '0';
+              for (int i = 0; i < 2 && position_ < size_ &&
+                              data_[position_] >= '0' &&
+                              data_[position_] <= '7';
+                   ++i) {
+                value = value * 8 + (data_[position_++] - '0');
+              }
+              c = static_cast<uint8_t>(value);
+            }
+            break;
+        }
+      }
+      bytes->push_back(static_cast<char>(c));
+    }
+    return false;
+  }
+
+  bool ReadHexString(std::string* bytes) {
+    int high = -1;
+    while (position_ < size_) {
+      uint8_t c = data_[position_++];
+      if (c == '>') {
+        if (high >= 0) {
+          bytes->push_back(static_cast<char>(high * 16));
+        }
+        return true;
+      }
+      if (IsWhitespace(c)) {
+        continue;
+      }
+      int value = HexValue(c);
+      if (value < 0) {
+        return false;
+      }
+      if (high < 0) {
+        high = value;
+      }
+      else {
+        bytes->push_back(static_cast<char>(high * 16 + value));
+        high = -1;
+      }
+    }
+    return false;
+  }
+
+  bool ReadArray(PdfObject* array, int depth) {
+    while (true) {
+      SkipWhitespace();
+      if (position_ >= size_) {
+        return false;
+      }
+      if (data_[position_] == ']') {
+        ++position_;
+        return true;
+      }
+      PdfObject item;
+      if (!ReadObject(&item, depth + 1)) {
+        return false;
+      }
+      array->items.push_back(std::move(item));
+    }
+  }
+
+  bool ReadDictionary(PdfObject* dictionary, int depth) {
+    while (true) {
+      SkipWhitespace();
+      if (position_ + 1 < size_ && data_[position_] == '>' &&
+          data_[position_ + 1] == '>') {
+        position_ += 2;
+        return true;
+      }
+      if (position_ >= size_ || data_[position_] != '/') {
+        return false;
+      }
+      ++position_;
+      std::string key;
+      ReadName(&key);
+      PdfObject value;
+      if (!ReadObject(&value, depth + 1)) {
+        return false;
+      }
+      // A null value is the same as no entry (ISO 32000-1, 7.3.7).
+      if (value.type != PdfObject::Type::kNull) {
+        dictionary->entries.emplace_back(std::move(key), std::move(value));
+      }
+    }
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_;
+};
+
+// Reads "number generation obj" and the object after it at |offset| of the
+// file of |document|, with the data of a stream.
+bool ReadIndirectObject(PdfDocument* document,
+                        size_t offset,
+                        uint32_t* number,
+                        PdfObject* object) {
+  Parser parser(document->data(), document->size(), offset);
+  uint64_t object_number;
+  uint64_t generation;
+  if (!parser.ReadUnsigned(&object_number) ||
+      !parser.ReadUnsigned(&generation) || !parser.ReadKeyword("obj") ||
+      object_number > kMaxObjectNumber || !parser.ReadObject(object)) {
+    return false;
+  }
+  *number = static_cast<uint32_t>(object_number);
+  if (object->type != PdfObject::Type::kDictionary ||
+      !parser.ReadKeyword("stream")) {
+    return true;
+  }
+  // The data starts after the end of line that follows "stream".
+  const uint8_t* data = document->data();
+  size_t size = document->size();
+  size_t start = parser.position();
+  if (start < size && data[start] == '\r') {
+    ++start;
+  }
+  if (start < size && data[start] == '\n') {
+    ++start;
+  }
+  object->type = PdfObject::Type::kStream;
+  object->stream = data + start;
+  const PdfObject* length = document->Resolve(object->Find("Length"));
+  if (length != nullptr && length->type == PdfObject::Type::kNumber &&
+      length->Number() >= 0 &&
+      length->Number() <= static_cast<double>(size - start)) {
+    object->stream_size = static_cast<size_t>(length->Number());
+    parser.Seek(start + object->stream_size);
+    if (parser.ReadKeyword("endstream")) {
+      return true;
+    }
+  }
+  // A wrong /Length: the data ends at the end of line before "endstream".
+  static constexpr char kEnd[] = "endstream";
+  const uint8_t* end = std::search(data + start, data + size, kEnd,
+                                   kEnd + sizeof(kEnd) - 1);
+  if (end == data + size) {
+    return false;
+  }
+  if (end > data + start && end[-1] == '\n') {
+    --end;
+  }
+  if (end > data + start && end[-1] == '\r') {
+    --end;
+  }
+  object->stream_size = static_cast<size_t>(end - (data + start));
+  return true;
+}
+
+// Undoes a PNG (10 and up) or TIFF (2) predictor (ISO 32000-1, 7.4.4.4).
+bool Unpredict(const PdfObject* parameters,
+               std::string* data,
+               std::string* error) {
+  auto parameter = [parameters](std::string_view key, int fallback) {
+    const PdfObject* value =
+        parameters != nullptr ? parameters->Find(key) : nullptr;
+    return value != nullptr && value->type == PdfObject::Type::kNumber
+               ? static_cast<int>(value->Number())
+               : fallback;
+  };
+  int predictor = parameter("Predictor", 1);
+  if (predictor == 1) {
+    return true;
+  }
+  int colors = parameter("Colors", 1);
+  int bits = parameter("BitsPerComponent", 8);
+  int columns = parameter("Columns", 1);
+  if (colors < 1 || colors > 32 || bits < 1 || bits > 16 || columns < 1 ||
+      columns > (1 << 24)) {
+    *error = "Invalid predictor parameters.";
+    return false;
+  }
+  size_t pixel = std::max<size_t>(1, static_cast<size_t>(colors * bits) / 8);
+  size_t row = (static_cast<size_t>(colors) * bits * columns + 7) / 8;
+  if (predictor == 2) {
+    if (bits != 8) {
+      *error = "Unsupported TIFF predictor.";
+      return false;
+    }
+    for (size_t start = 0; start + row <= data->size(); start += row) {
+      for (size_t i = pixel; i < row; ++i) {
+        (*data)[start + i] = static_cast<char>((*data)[start + i] +
+                                               (*data)[start + i - pixel]);
+      }
+    }
+    return true;
+  }
+  if (predictor < 10) {
+    *error = "Unsupported predictor.";
+    return false;
+  }
+  // Each row is a filter type byte and the filtered row.
+  std::string decoded;
+  decoded.reserve(data->size() / (row + 1) * row);
+  std::vector<uint8_t> previous(row, 0);
+  std::vector<uint8_t> current(row);
+  for (size_t start = 0; start + row + 1 <= data->size(); start += row + 1) {
+    uint8_t type = static_cast<uint8_t>((*data)[start]);
+    const uint8_t* in =
+        reinterpret_cast<const uint8_t*>(data->data()) + start + 1;
+    for (size_t i = 0; i < row; ++i) {
+      int left = i >= pixel ? current[i - pixel] : 0;
+      int up = previous[i];
+      int up_left = i >= pixel ? previous[i - pixel] : 0;
+      int value = in[i];
+      switch (type) {
+        case 0:
+          break;
+        case 1:
+          value += left;
+          break;
+        case 2:
+          value += up;
+          break;
+        case 3:
+          value += (left + up) / 2;
+          break;
+        case 4: {
+          int estimate = left + up - up_left;
+          int to_left = std::abs(estimate - left);
+          int to_up = std::abs(estimate - up);
+          int to_up_left = std::abs(estimate - up_left);
+          if (to_left <= to_up && to_left <= to_up_left) {
+            value += left;
+          }
+          else if (to_up <= to_up_left) {
+            value += up;
+          }
+          else {
+            value += up_left;
+          }
+          break;
+        }
+        default:
+          *error = "Invalid PNG predictor row.";
+          return false;
+      }
+      current[i] = static_cast<uint8_t>(value);
+    }
+    decoded.append(reinterpret_cast<const char*>(current.data()), row);
+    previous.swap(current);
+  }
+  *data = std::move(decoded);
+  return true;
+}
+
+}  // namespace
+
+// static
+PdfObject PdfObject::Integer(int64_t value) {
+  PdfObject object;
+  object.type = Type::kNumber;
+  object.text = std::to_string(value);
+  return object;
+}
+
+// static
+PdfObject PdfObject::Name(std::string name) {
+  PdfObject object;
+  object.type = Type::kName;
+  object.text = std::move(name);
+  return object;
+}
+
+// static
+PdfObject PdfObject::String(std::string bytes) {
+  PdfObject object;
+  object.type = Type::kString;
+  object.text = std::move(bytes);
+  return object;
+}
+
+// static
+PdfObject PdfObject::Reference(uint32_t number, uint16_t generation) {
+  PdfObject object;
+  object.type = Type::kReference;
+  object.number = number;
+  object.generation = generation;
+  return object;
+}
+
+const PdfObject* PdfObject::Find(std::string_view key) const {
+  for (const auto& entry : entries) {
+    if (entry.first == key) {
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+void PdfObject::Set(const std::string& key, PdfObject value) {
+  for (auto& entry : entries) {
+    if (entry.first == key) {
+      entry.second = std::move(value);
+      return;
+    }
+  }
+  entries.emplace_back(key, std::move(value));
+}
+
+void PdfObject::Remove(std::string_view key) {
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [key](const auto& entry) {
+                                 return entry.first == key;
+                               }),
+                entries.end());
+}
+
+double PdfObject::Number() const {
+  return type == Type::kNumber ? std::strtod(text.c_str(), nullptr) : 0;
+}
+
+std::string SerializePdfObject(const PdfObject& object) {
+  static constexpr char kHex[] = "0123456789ABCDEF";
+  std::string out;
+  switch (object.type) {
+    case PdfObject::Type::kNull:
+      return "null";
+    case PdfObject::Type::kBoolean:
+      return object.boolean ? "true" : "false";
+    case PdfObject::Type::kNumber:
+      return object.text;
+    case PdfObject::Type::kReference:
+      return std::to_string(object.number) + " " +
+             std::to_string(object.generation) + " R";
+    case PdfObject::Type::kName:
+      out.push_back('/');
+      for (char c : object.text) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        if (byte > ' ' && byte < 0x7f && byte != '#' && IsRegular(byte)) {
+          out.push_back(c);
+        }
+        else {
+          out.push_back('#');
+          out.push_back(kHex[byte >> 4]);
+          out.push_back(kHex[byte & 0x0f]);
+        }
+      }
+      return out;
+    case PdfObject::Type::kString: {
+      // Printable ASCII goes as a literal string, anything else in hex.
+      bool literal = std::all_of(object.text.begin(), object.text.end(),
+                                 [](char c) { return c >= ' ' && c < 0x7f; });
+      if (literal) {
+        out.push_back('(');
+        for (char c : object.text) {
+          if (c == '(' || c == ')' || c == '\\') {
+            out.push_back('\\');
+          }
+          out.push_back(c);
+        }
+        out.push_back(')');
+        return out;
+      }
+      out.push_back('<');
+      for (char c : object.text) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        out.push_back(kHex[byte >> 4]);
+        out.push_back(kHex[byte & 0x0f]);
+      }
+      out.push_back('>');
+      return out;
+    }
+    case PdfObject::Type::kArray:
+      out.push_back('[');
+      for (size_t i = 0; i < object.items.size(); ++i) {
+        if (i > 0) {
+          out.push_back(' ');
+        }
+        out += SerializePdfObject(object.items[i]);
+      }
+      out.push_back(']');
+      return out;
+    case PdfObject::Type::kDictionary:
+    case PdfObject::Type::kStream:
+      break;
+  }
+  out = "<<";
+  for (const auto& entry : object.entries) {
+    out += SerializePdfObject(PdfObject::Name(entry.first));
+    out.push_back(' ');
+    out += SerializePdfObject(entry.second);
+  }
+  out += ">>";
+  return out;
+}
+
+// An object stream, decoded, and where each of its objects starts.
+struct PdfDocument::ObjectStream {
+  std::string data;
+  std::vector<size_t> offsets;
+};
+
+// static
+std::unique_ptr<PdfDocument> PdfDocument::Open(const std::string& path,
+                                               std::string* error) {
+  std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+  if (!file) {
+    *error = "The PDF file cannot be opened.";
+    return nullptr;
+  }
+  static constexpr char kHeader[] = "%PDF-";
+  // The header may come after some garbage, within the first kilobyte.
+  const uint8_t* head_end =
+      file->data() + std::min<size_t>(file->size(), kTailSize);
+  if (std::search(file->data(), head_end, kHeader,
+                  kHeader + sizeof(kHeader) - 1) == head_end) {
+    *error = "The file is not a PDF file.";
+    return nullptr;
+  }
+  std::unique_ptr<PdfDocument> document(new PdfDocument(std::move(file)));
+  if (!document->ReadXref(error)) {
+    return nullptr;
+  }
+  if (document->Catalog() == nullptr) {
+    *error = "The PDF file has no document catalog.";
+    return nullptr;
+  }
+  return document;
+}
+
+PdfDocument::PdfDocument(std::unique_ptr<MappedFile> file)
+    : file_(std::move(file)) {}
+
+PdfDocument::~PdfDocument() = default;
+
+uint32_t PdfDocument::object_count() const {
+  const PdfObject* size = trailer_.Find("Size");
+  double declared = size != nullptr ? size->Number() : 0;
+  if (declared < 0 || declared > kMaxObjectNumber + 1.0) {
+    declared = 0;
+  }
+  return std::max(static_cast<uint32_t>(declared),
+                  static_cast<uint32_t>(xref_.size()));
+}
+
+bool PdfDocument::ReadXref(std::string* error) {
+  static constexpr char kStartXref[] = "startxref";
+  const uint8_t* end = data() + size();
+  const uint8_t* tail = data() + (size() - std::min(size(), kTailSize));
+  const uint8_t* found =
+      std::find_end(tail, end, kStartXref, kStartXref + sizeof(kStartXref) - 1);
+  Parser parser(data(), size(), static_cast<size_t>(found - data()) +
+                                    sizeof(kStartXref) - 1);
+  if (found == end || !parser.ReadUnsigned(&last_xref_offset_) ||
+      last_xref_offset_ >= size()) {
+    *error = "The PDF file has no cross-reference section.";
+    return false;
+  }
+
+  std::vector<uint64_t> visited;
+  uint64_t offset = last_xref_offset_;
+  while (true) {
+    if (std::find(visited.begin(), visited.end(), offset) != visited.end()) {
+      break;
+    }
+    visited.push_back(offset);
+    Parser probe(data(), size(), static_cast<size_t>(offset));
+    bool table = probe.ReadKeyword("xref");
+    if (visited.size() == 1) {
+      xref_is_stream_ = !table;
+    }
+    PdfObject trailer;
+    if (table ? !ReadXrefTable(static_cast<size_t>(offset), &trailer, error)
+              : !ReadXrefStream(static_cast<size_t>(offset), &trailer,
+                                error)) {
+      return false;
+    }
+    MergeTrailer(trailer);
+    // A hybrid file lists its compressed objects in a stream that comes
+    // after the table and before the previous section (ISO 32000-1, 7.5.8.4).
+    const PdfObject* stream = trailer.Find("XRefStm");
+    if (table && stream != nullptr && stream->Number() > 0 &&
+        stream->Number() < static_cast<double>(size())) {
+      PdfObject ignored;
+      if (!ReadXrefStream(static_cast<size_t>(stream->Number()), &ignored,
+                          error)) {
+        return false;
+      }
+    }
+    const PdfObject* previous = trailer.Find("Prev");
+    if (previous == nullptr || previous->Number() < 0 ||
+        previous->Number() >= static_cast<double>(size())) {
+      break;
+    }
+    offset = static_cast<uint64_t>(previous->Number());
+  }
+  return true;
+}
+
+bool PdfDocument::ReadXrefTable(size_t offset,
+                                PdfObject* trailer,
+                                std::string* error) {
+  Parser parser(data(), size(), offset);
+  parser.ReadKeyword("xref");
+  while (!parser.ReadKeyword("trailer")) {
+    uint64_t first;
+    uint64_t count;
+    if (!parser.ReadUnsigned(&first) || !parser.ReadUnsigned(&count) ||
+        first + count > kMaxObjectNumber + 1ull) {
+      *error = "Invalid cross-reference table.";
+      return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+      uint64_t position;
+      uint64_t generation;
+      if (!parser.ReadUnsigned(&position) ||
+          !parser.ReadUnsigned(&generation)) {
+        *error = "Invalid cross-reference table.";
+        return false;
+      }
+      std::string_view kind = parser.ReadToken();
+      XrefEntry entry;
+      if (kind == "n") {
+        entry.type = XrefEntry::Type::kInFile;
+        entry.offset = position;
+        entry.index = static_cast<uint32_t>(generation);
+      }
+      else if (kind == "f") {
+        entry.type = XrefEntry::Type::kFree;
+      }
+      else {
+        *error = "Invalid cross-reference table.";
+        return false;
+      }
+      AddEntry(static_cast<uint32_t>(first + i), entry);
+    }
+  }
+  if (!parser.ReadObject(trailer) ||
+      trailer->type != PdfObject::Type::kDictionary) {
+    *error = "Invalid trailer.";
+    return false;
+  }
+  return true;
+}
+
+bool PdfDocument::ReadXrefStream(size_t offset,
+                                 PdfObject* trailer,
+                                 std::string* error) {
+  uint32_t number;
+  std::string data;
+  if (!ReadIndirectObject(this, offset, &number, trailer) ||
+      trailer->type != PdfObject::Type::kStream ||
+      !trailer->Find("Type") || !trailer->Find("Type")->IsName("XRef")) {
+    *error = "Invalid cross-reference stream.";
+    return false;
+  }
+  if (!DecodeStream(*trailer, &data, error)) {
+    return false;
+  }
+  const PdfObject* widths = trailer->Find("W");
+  if (widths == nullptr || widths->type != PdfObject::Type::kArray ||
+      widths->items.size() != 3) {
+    *error = "Invalid cross-reference stream.";
+    return false;
+  }
+  size_t width[3];
+  size_t entry_size = 0;
+  for (int i = 0; i < 3; ++i) {
+    double value = widths->items[i].Number();
+    if (value < 0 || value > 8) {
+      *error = "Invalid cross-reference stream.";
+      return false;
+    }
+    width[i] = static_cast<size_t>(value);
+    entry_size += width[i];
+  }
+  if (entry_size == 0) {
+    *error = "Invalid cross-reference stream.";
+    return false;
+  }
+  std::vector<double> index;
+  const PdfObject* sections = trailer->Find("Index");
+  if (sections != nullptr && sections->type == PdfObject::Type::kArray) {
+    for (const PdfObject& item : sections->items) {
+      index.push_back(item.Number());
+    }
+  }
+  else {
+    const PdfObject* size = trailer->Find("Size");
+    index = {0, size != nullptr ? size->Number() : 0};
+  }
+
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+  size_t position = 0;
+  auto field = [&](size_t size, uint64_t fallback) {
+    if (size == 0) {
+      return fallback;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+      value = (value << 8) | bytes[position++];
+    }
+    return value;
+  };
+  for (size_t section = 0; section + 1 < index.size(); section += 2) {
+    double first = index[section];
+    double count = index[section + 1];
+    if (first < 0 || count < 0 || first + count > kMaxObjectNumber + 1.0) {
+      *error = "Invalid cross-reference stream.";
+      return false;
+    }
+    for (uint32_t i = 0; i < static_cast<uint32_t>(count); ++i) {
+      if (position + entry_size > data.size()) {
+        *error = "Truncated cross-reference stream.";
+        return false;
+      }
+      uint64_t type = field(width[0], 1);
+      uint64_t second = field(width[1], 0);
+      uint64_t third = field(width[2], 0);
+      XrefEntry entry;
+      if (type == 0) {
+        entry.type = XrefEntry::Type::kFree;
+      }
+      else if (type == 1) {
+        entry.type = XrefEntry::Type::kInFile;
+      }
+      else if (type == 2) {
+        entry.type = XrefEntry::Type::kInObjectStream;
+      }
+      else {
+        // Unknown types are references to the null object.
+        continue;
+      }
+      entry.offset = second;
+      entry.index = static_cast<uint32_t>(third);
+      AddEntry(static_cast<uint32_t>(first) + i, entry);
+    }
+  }
+  return true;
+}
+
+void PdfDocument::AddEntry(uint32_t number, XrefEntry entry) {
+  if (number > kMaxObjectNumber) {
+    return;
+  }
+  if (number >= xref_.size()) {
+    xref_.resize(number + 1);
+  }
+  // Newer sections are read first and win.
+  if (xref_[number].type == XrefEntry::Type::kUnset) {
+    xref_[number] = entry;
+  }
+}
+
+void PdfDocument::MergeTrailer(const PdfObject& trailer) {
+  trailer_.type = PdfObject::Type::kDictionary;
+  for (const auto& entry : trailer.entries) {
+    if (trailer_.Find(entry.first) == nullptr) {
+      trailer_.entries.push_back(entry);
+    }
+  }
+}
+
+const PdfObject* PdfDocument::Object(uint32_t number) {
+  auto cached = objects_.find(number);
+  if (cached != objects_.end()) {
+    return cached->second.get();
+  }
+  if (!loading_.insert(number).second) {
+    return nullptr;
+  }
+  std::unique_ptr<PdfObject> object = Load(number);
+  loading_.erase(number);
+  return objects_.emplace(number, std::move(object)).first->second.get();
+}
+
+std::unique_ptr<PdfObject> PdfDocument::Load(uint32_t number) {
+  if (number >= xref_.size()) {
+    return nullptr;
+  }
+  XrefEntry entry = xref_[number];
+  auto object = std::make_unique<PdfObject>();
+  if (entry.type == XrefEntry::Type::kInFile) {
+    uint32_t found;
+    if (entry.offset >= size() ||
+        !ReadIndirectObject(this, static_cast<size_t>(entry.offset), &found,
+                            object.get()) ||
+        found != number) {
+      return nullptr;
+    }
+    return object;
+  }
+  if (entry.type != XrefEntry::Type::kInObjectStream ||
+      entry.offset > kMaxObjectNumber) {
+    return nullptr;
+  }
+  const ObjectStream* stream =
+      LoadObjectStream(static_cast<uint32_t>(entry.offset));
+  if (stream == nullptr || entry.index >= stream->offsets.size()) {
+    return nullptr;
+  }
+  Parser parser(reinterpret_cast<const uint8_t*>(stream->data.data()),
+                stream->data.size(), stream->offsets[entry.index]);
+  if (!parser.ReadObject(object.get())) {
+    return nullptr;
+  }
+  return object;
+}
+
+const PdfDocument::ObjectStream* PdfDocument::LoadObjectStream(
+    uint32_t number) {
+  auto cached = object_streams_.find(number);
+  if (cached != object_streams_.end()) {
+    return cached->second.get();
+  }
+  std::unique_ptr<ObjectStream> result;
+  const PdfObject* stream = Object(number);
+  std::string error;
+  if (stream != nullptr && stream->type == PdfObject::Type::kStream) {
+    const PdfObject* count = stream->Find("N");
+    const PdfObject* first = stream->Find("First");
+    auto decoded = std::make_unique<ObjectStream>();
+    if (count != nullptr && first != nullptr && first->Number() >= 0 &&
+        DecodeStream(*stream, &decoded->data, &error)) {
+      // The stream starts with pairs of object number and offset.
+      Parser parser(reinterpret_cast<const uint8_t*>(decoded->data.data()),
+                    decoded->data.size(), 0);
+      size_t base = static_cast<size_t>(first->Number());
+      bool valid = true;
+      for (double i = 0; i < count->Number() && valid; ++i) {
+        uint64_t object_number;
+        uint64_t offset;
+        valid = parser.ReadUnsigned(&object_number) &&
+                parser.ReadUnsigned(&offset) &&
+                base + offset < decoded->data.size();
+        decoded->offsets.push_back(base + static_cast<size_t>(offset));
+      }
+      if (valid) {
+        result = std::move(decoded);
+      }
+    }
+  }
+  return object_streams_.emplace(number, std::move(result))
+      .first->second.get();
+}
+
+const PdfObject* PdfDocument::Resolve(const PdfObject* object) {
+  // References to references are not allowed, but are followed a few times.
+  for (int i = 0; i < 8 && object != nullptr &&
+                  object->type == PdfObject::Type::kReference;
+       ++i) {
+    object = Object(object->number);
+  }
+  return object != nullptr && object->type == PdfObject::Type::kReference
+             ? nullptr
+             : object;
+}
+
+const PdfObject* PdfDocument::Catalog() {
+  const PdfObject* catalog = Resolve(trailer_.Find("Root"));
+  return catalog != nullptr && catalog->type == PdfObject::Type::kDictionary
+             ? catalog
+             : nullptr;
+}
+
+size_t PdfDocument::PageCount() {
+  const PdfObject* catalog = Catalog();
+  const PdfObject* pages =
+      catalog != nullptr ? Resolve(catalog->Find("Pages")) : nullptr;
+  const PdfObject* count =
+      pages != nullptr ? Resolve(pages->Find("Count")) : nullptr;
+  return count != nullptr && count->Number() > 0
+             ? static_cast<size_t>(count->Number())
+             : 0;
+}
+
+bool PdfDocument::PageReference(size_t index, PdfObject* reference) {
+  const PdfObject* catalog = Catalog();
+  const PdfObject* node = catalog != nullptr ? catalog->Find("Pages") : nullptr;
+  // Walks down the page tree, skipping whole subtrees by their /Count.
+  for (int depth = 0; depth < kMaxDepth; ++depth) {
+    if (node == nullptr || node->type != PdfObject::Type::kReference) {
+      return false;
+    }
+    const PdfObject* pages = Resolve(node);
+    const PdfObject* kids = pages != nullptr ? Resolve(pages->Find("Kids"))
+                                             : nullptr;
+    if (kids == nullptr || kids->type != PdfObject::Type::kArray) {
+      return false;
+    }
+    const PdfObject* next = nullptr;
+    for (const PdfObject& kid : kids->items) {
+      const PdfObject* child = Resolve(&kid);
+      if (child == nullptr) {
+        continue;
+      }
+      const PdfObject* type = child->Find("Type");
+      bool leaf = child->Find("Kids") == nullptr ||
+                  (type != nullptr && type->IsName("Page"));
+      if (leaf) {
+        if (index == 0) {
+          if (kid.type != PdfObject::Type::kReference) {
+            return false;
+          }
+          *reference = kid;
+          return true;
+        }
+        --index;
+        continue;
+      }
+      const PdfObject* count = Resolve(child->Find("Count"));
+      size_t pages_below = count != nullptr && count->Number() > 0
+                               ? static_cast<size_t>(count->Number())
+                               : 0;
+      if (index < pages_below) {
+        next = &kid;
+        break;
+      }
+      index -= pages_below;
+    }
+    if (next == nullptr) {
+      return false;
+    }
+    node = next;
+  }
+  return false;
+}
+
+bool PdfDocument::DecodeStream(const PdfObject& stream,
+                               std::string* data,
+                               std::string* error) {
+  data->assign(reinterpret_cast<const char*>(stream.stream),
+               stream.stream_size);
+  const PdfObject* filters = Resolve(stream.Find("Filter"));
+  const PdfObject* parameters = Resolve(stream.Find("DecodeParms"));
+  std::vector<const PdfObject*> filter_list;
+  std::vector<const PdfObject*> parameter_list;
+  if (filters != nullptr && filters->type == PdfObject::Type::kArray) {
+    for (size_t i = 0; i < filters->items.size(); ++i) {
+      filter_list.push_back(&filters->items[i]);
+      parameter_list.push_back(
+          parameters != nullptr && parameters->type == PdfObject::Type::kArray &&
+                  i < parameters->items.size()
+              ? Resolve(&parameters->items[i])
+              : nullptr);
+    }
+  }
+  else if (filters != nullptr) {
+    filter_list.push_back(filters);
+    parameter_list.push_back(parameters);
+  }
+
+  for (size_t i = 0; i < filter_list.size(); ++i) {
+    if (!filter_list[i]->IsName("FlateDecode")) {
+      *error = "Unsupported PDF stream filter.";
+      return false;
+    }
+    std::string inflated;
+    std::unique_ptr<ContentDecoder> decoder = ContentDecoder::Create(
+        ContentCoding::kDeflate, [&inflated](const char* chunk, size_t size) {
+          inflated.append(chunk, size);
+        });
+    if (!decoder) {
+      *error = "Compressed PDF streams need zlib, which this build lacks.";
+      return false;
+    }
+    if (!decoder->Feed(data->data(), data->size()) || !decoder->Finish()) {
+      *error = "Corrupt compressed PDF stream.";
+      return false;
+    }
+    *data = std::move(inflated);
+    if (!Unpredict(parameter_list[i], data, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace native_core
@@ -0,0 +1,145 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/pdf_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#include "include/native_core/mapped_file.h"
+
+#ifdef NATIVE_CORE_HAS_PDFIUM
+#include <fpdfview.h>
+#endif
+
+namespace native_core {
+
+#ifdef NATIVE_CORE_HAS_PDFIUM
+namespace {
+
+// Sets PDFium up on first use and returns the lock every call into it must
+// hold. The library is never torn down: a render may still be running on the
+// pool when the process exits.
+std::mutex& PdfiumMutex() {
+  static std::mutex* mutex = []() {
+    FPDF_LIBRARY_CONFIG config = {};
+    config.version = 2;
+    FPDF_InitLibraryWithConfig(&config);
+    return new std::mutex();
+  }();
+  return *mutex;
+}
+
+struct DocumentCloser {
+  void operator()(FPDF_DOCUMENT document) const {
+    FPDF_CloseDocument(document);
+  }
+};
+
+struct PageCloser {
+  void operator()(FPDF_PAGE page) const { FPDF_ClosePage(page); }
+};
+
+struct BitmapDestroyer {
+  void operator()(FPDF_BITMAP bitmap) const {
+    FPDFBitmap_Destroy(bitmap);
+  }
+};
+
+}  // namespace
+#endif
+
+bool CanRenderPdf() {
+#ifdef NATIVE_CORE_HAS_PDFIUM
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool RenderFirstPage([[maybe_unused]] const std::string& path,
+                     [[maybe_unused]] int max_size,
+                     [[maybe_unused]] RgbImage* image,
+                     std::string* error) {
+#ifdef NATIVE_CORE_HAS_PDFIUM
+  // Read through a mapping rather than by PDFium, which would take the path
+  // in another encoding on each platform.
+  std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+  if (!file) {
+    *error = "The document cannot be read.";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(PdfiumMutex());
+  std::unique_ptr<std::remove_pointer_t<FPDF_DOCUMENT>, DocumentCloser> document(
+      FPDF_LoadMemDocument64(file->data(), file->size(), nullptr));
+  if (!document) {
+    *error = FPDF_GetLastError() == FPDF_ERR_PASSWORD
+                 ? "The document is protected with a password."
+                 : "The document is not a valid PDF.";
+    return false;
+  }
+  std::unique_ptr<std::remove_pointer_t<FPDF_PAGE>, PageCloser> page(
+      FPDF_LoadPage(document.get(), 0));
+  if (!page) {
+    *error = "The first page of the document cannot be read.";
+    return false;
+  }
+  float page_width = FPDF_GetPageWidthF(page.get());
+  float page_height = FPDF_GetPageHeightF(page.get());
+  if (!(page_width > 0 && page_height > 0)) {
+    *error = "The first page of the document is empty.";
+    return false;
+  }
+  float scale = max_size / std::max(page_width, page_height);
+  int width = std::max(1, static_cast<int>(std::lround(page_width * scale)));
+  int height = std::max(1, static_cast<int>(std::lround(page_height * scale)));
+
+  // 32-bit BGRx, painted white first: pages are transparent where nothing is
+  // drawn.
+  std::unique_ptr<std::remove_pointer_t<FPDF_BITMAP>, BitmapDestroyer> bitmap(
+      FPDFBitmap_Create(width, height, 0));
+  if (!bitmap) {
+    *error = "The first page of the document cannot be rendered.";
+    return false;
+  }
+  FPDFBitmap_FillRect(bitmap.get(), 0, 0, width, height, 0xffffffff);
+  FPDF_RenderPageBitmap(bitmap.get(), page.get(), 0, 0, width, height, 0,
+                        FPDF_ANNOT);
+
+  const uint8_t* buffer =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(bitmap.get()));
+  int stride = FPDFBitmap_GetStride(bitmap.get());
+  image->width = width;
+  image->height = height;
+  image->pixels.resize(static_cast<size_t>(width) * height * 3);
+  uint8_t* out = image->pixels.data();
+  for (int y = 0; y < height; y++) {
+    const uint8_t* row = buffer + static_cast<size_t>(y) * stride;
+    for (int x = 0; x < width; x++, out += 3) {
+      out[0] = row[x * 4 + 2];
+      out[1] = row[x * 4 + 1];
+      out[2] = row[x * 4];
+    }
+  }
+  return true;
+#else
+  *error = "This build cannot render PDF documents.";
+  return false;
+#endif
+}
+
+}  // namespace native_core
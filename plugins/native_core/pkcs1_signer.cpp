@@ -0,0 +1,67 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/pkcs1_signer.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+std::mutex active_signer_mutex;
+std::shared_ptr<Pkcs1Signer> active_signer;
+
+}  // namespace
+
+DigestAlgorithm DigestAlgorithmFor(std::string_view name) {
+  // Compared in place, ignoring ASCII case, since every signature asks.
+  auto contains = [&](std::string_view value) {
+    auto lower = [](char c) {
+      return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    };
+    return std::search(name.begin(), name.end(), value.begin(), value.end(),
+                       [&](char a, char b) { return lower(a) == b; }) !=
+           name.end();
+  };
+  if (contains("sha-1") || contains("sha1")) {
+    return DigestAlgorithm::kSha1;
+  }
+  if (contains("sha-256") || contains("sha256")) {
+    return DigestAlgorithm::kSha256;
+  }
+  if (contains("sha-384") || contains("sha384")) {
+    return DigestAlgorithm::kSha384;
+  }
+  return DigestAlgorithm::kSha512;
+}
+
+Pkcs1Signer::~Pkcs1Signer() = default;
+
+std::vector<uint8_t> Pkcs1Signer::Certificate() const {
+  return {};
+}
+
+void SetActiveSigner(std::shared_ptr<Pkcs1Signer> signer) {
+  std::lock_guard<std::mutex> lock(active_signer_mutex);
+  active_signer = std::move(signer);
+}
+
+std::shared_ptr<Pkcs1Signer> GetActiveSigner() {
+  std::lock_guard<std::mutex> lock(active_signer_mutex);
+  return active_signer;
+}
+
+}  // namespace native_core
@@ -0,0 +1,45 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/platform_dispatcher.h"
+
+#include <utility>
+
+namespace native_core {
+
+PlatformDispatcher::PlatformDispatcher(Wakeup* wakeup) : wakeup_(wakeup) {}
+
+PlatformDispatcher::~PlatformDispatcher() {}
+
+void PlatformDispatcher::Post(Task task) {
+  queue_.Push(std::move(task));
+  if (!wake_pending_.exchange(true, std::memory_order_acq_rel)) {
+    wakeup_->Signal();
+  }
+}
+
+size_t PlatformDispatcher::Drain() {
+  // Clear the flag before popping: a Post() racing with the drain either gets
+  // its task popped below or signals a new wake-up, never neither.
+  wake_pending_.store(false, std::memory_order_release);
+  size_t count = 0;
+  Task task;
+  while (queue_.TryPop(&task)) {
+    task();
+    task = nullptr;
+    count++;
+  }
+  return count;
+}
+
+}  // namespace native_core
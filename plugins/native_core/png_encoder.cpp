@@ -0,0 +1,215 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/png_encoder.h"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef NATIVE_CORE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace native_core {
+
+namespace {
+
+constexpr uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+constexpr int kBytesPerPixel = 3;
+
+// Row filters (PNG specification, section 9.2).
+enum Filter : uint8_t {
+  kNone = 0,
+  kSub = 1,
+  kUp = 2,
+  kAverage = 3,
+  kPaeth = 4,
+};
+
+uint32_t Crc32(const uint8_t* data, size_t size) {
+  static const std::array<uint32_t, 256> table = []() {
+    std::array<uint32_t, 256> values{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; bit++) {
+        value = (value >> 1) ^ (value & 1 ? 0xedb88320u : 0);
+      }
+      values[i] = value;
+    }
+    return values;
+  }();
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffu;
+}
+
+void PutU32(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(static_cast<uint8_t>(value >> 24));
+  out->push_back(static_cast<uint8_t>(value >> 16));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+void PutChunk(std::vector<uint8_t>* out,
+              const char type[4],
+              const uint8_t* data,
+              size_t size) {
+  PutU32(out, static_cast<uint32_t>(size));
+  size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  if (size > 0) {
+    out->insert(out->end(), data, data + size);
+  }
+  PutU32(out, Crc32(out->data() + start, out->size() - start));
+}
+
+uint8_t Paeth(uint8_t left, uint8_t up, uint8_t up_left) {
+  int estimate = left + up - up_left;
+  int to_left = std::abs(estimate - left);
+  int to_up = std::abs(estimate - up);
+  int to_up_left = std::abs(estimate - up_left);
+  if (to_left <= to_up && to_left <= to_up_left) {
+    return left;
+  }
+  return to_up <= to_up_left ? up : up_left;
+}
+
+// Filters |row| with |filter| into |out|. |previous| is the row above, or
+// zeros for the first one.
+void FilterRow(Filter filter,
+               const uint8_t* row,
+               const uint8_t* previous,
+               size_t size,
+               uint8_t* out) {
+  for (size_t i = 0; i < size; i++) {
+    uint8_t left = i >= kBytesPerPixel ? row[i - kBytesPerPixel] : 0;
+    uint8_t up = previous[i];
+    uint8_t up_left = i >= kBytesPerPixel ? previous[i - kBytesPerPixel] : 0;
+    uint8_t predicted = 0;
+    switch (filter) {
+      case kNone:
+        break;
+      case kSub:
+        predicted = left;
+        break;
+      case kUp:
+        predicted = up;
+        break;
+      case kAverage:
+        predicted = static_cast<uint8_t>((left + up) / 2);
+        break;
+      case kPaeth:
+        predicted = Paeth(left, up, up_left);
+        break;
+    }
+    out[i] = static_cast<uint8_t>(row[i] - predicted);
+  }
+}
+
+// The filtered rows, each preceded by its filter type. Every row takes the
+// filter whose output, read as signed bytes, adds up to the least: the
+// heuristic the specification suggests, which keeps the page background and
+// flat areas near zero for the compressor.
+std::vector<uint8_t> FilterImage(const RgbImage& image) {
+  size_t row_size = static_cast<size_t>(image.width) * kBytesPerPixel;
+  std::vector<uint8_t> filtered;
+  filtered.reserve((row_size + 1) * image.height);
+  std::vector<uint8_t> zeros(row_size, 0);
+  std::vector<uint8_t> candidate(row_size);
+  std::vector<uint8_t> best(row_size);
+  for (int y = 0; y < image.height; y++) {
+    const uint8_t* row = image.pixels.data() + y * row_size;
+    const uint8_t* previous = y > 0 ? row - row_size : zeros.data();
+    Filter best_filter = kNone;
+    uint64_t best_cost = UINT64_MAX;
+    for (Filter filter : {kNone, kSub, kUp, kAverage, kPaeth}) {
+      FilterRow(filter, row, previous, row_size, candidate.data());
+      uint64_t cost = 0;
+      for (uint8_t value : candidate) {
+        cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(value)));
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_filter = filter;
+        best.swap(candidate);
+      }
+    }
+    filtered.push_back(best_filter);
+    filtered.insert(filtered.end(), best.begin(), best.end());
+  }
+  return filtered;
+}
+
+// |data| as a zlib stream (RFC 1950).
+std::vector<uint8_t> Compress(const std::vector<uint8_t>& data) {
+#ifdef NATIVE_CORE_HAS_ZLIB
+  uLongf size = compressBound(static_cast<uLong>(data.size()));
+  std::vector<uint8_t> compressed(size);
+  if (compress2(compressed.data(), &size, data.data(),
+                static_cast<uLong>(data.size()),
+                Z_DEFAULT_COMPRESSION) == Z_OK) {
+    compressed.resize(size);
+    return compressed;
+  }
+#endif
+  // Stored deflate blocks of at most 65535 bytes, then the Adler-32 of the
+  // data.
+  std::vector<uint8_t> stored = {0x78, 0x01};
+  size_t offset = 0;
+  do {
+    size_t size = data.size() - offset;
+    if (size > 0xffff) {
+      size = 0xffff;
+    }
+    bool last = offset + size == data.size();
+    stored.push_back(last ? 1 : 0);
+    stored.push_back(static_cast<uint8_t>(size));
+    stored.push_back(static_cast<uint8_t>(size >> 8));
+    stored.push_back(static_cast<uint8_t>(~size));
+    stored.push_back(static_cast<uint8_t>(~size >> 8));
+    stored.insert(stored.end(), data.begin() + offset,
+                  data.begin() + offset + size);
+    offset += size;
+  } while (offset < data.size());
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t value : data) {
+    a = (a + value) % 65521;
+    b = (b + a) % 65521;
+  }
+  PutU32(&stored, b << 16 | a);
+  return stored;
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodePng(const RgbImage& image) {
+  std::vector<uint8_t> png(kSignature, kSignature + sizeof(kSignature));
+
+  std::vector<uint8_t> header;
+  PutU32(&header, static_cast<uint32_t>(image.width));
+  PutU32(&header, static_cast<uint32_t>(image.height));
+  // 8 bits per sample, RGB, deflate, adaptive filtering, not interlaced.
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+  PutChunk(&png, "IHDR", header.data(), header.size());
+
+  std::vector<uint8_t> data = Compress(FilterImage(image));
+  PutChunk(&png, "IDAT", data.data(), data.size());
+  PutChunk(&png, "IEND", nullptr, 0);
+  return png;
+}
+
+}  // namespace native_core
@@ -0,0 +1,855 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/proxy_response_parsers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+namespace native_core {
+
+namespace {
+
+using NodeId = XmlSubtree::NodeId;
+
+// Upper bound for the rows reserved from the total announced by the proxy,
+// which counts every page and not just this one.
+constexpr size_t kMaxReservedRequests = 4096;
+
+std::string ToLowerAscii(std::string_view value) {
+  std::string lower(value);
+  for (char& c : lower) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  return lower;
+}
+
+std::string ToUpperAscii(std::string_view value) {
+  std::string upper(value);
+  for (char& c : upper) {
+    if (c >= 'a' && c <= 'z') {
+      c = static_cast<char>(c - 'a' + 'A');
+    }
+  }
+  return upper;
+}
+
+// Length of the whitespace character, as String.trim() in Dart defines it,
+// at the start of |value|, or 0.
+size_t LeadingWhitespace(std::string_view value) {
+  if (value.empty()) {
+    return 0;
+  }
+  auto byte = [&](size_t i) {
+    return i < value.size() ? static_cast<unsigned char>(value[i]) : 0;
+  };
+  unsigned char c = byte(0);
+  if (c == ' ' || (c >= 0x09 && c <= 0x0D)) {
+    return 1;
+  }
+  if (c == 0xC2 && (byte(1) == 0x85 || byte(1) == 0xA0)) {
+    return 2;  // U+0085, U+00A0
+  }
+  if (c == 0xE1 && byte(1) == 0x9A && byte(2) == 0x80) {
+    return 3;  // U+1680
+  }
+  if (c == 0xE2 && byte(1) == 0x80 &&
+      (byte(2) <= 0x8A || byte(2) == 0xA8 || byte(2) == 0xA9 ||
+       byte(2) == 0xAF) &&
+      byte(2) >= 0x80) {
+    return 3;  // U+2000..U+200A, U+2028, U+2029, U+202F
+  }
+  if (c == 0xE2 && byte(1) == 0x81 && byte(2) == 0x9F) {
+    return 3;  // U+205F
+  }
+  if (c == 0xE3 && byte(1) == 0x80 && byte(2) == 0x80) {
+    return 3;  // U+3000
+  }
+  if (c == 0xEF && byte(1) == 0xBB && byte(2) == 0xBF) {
+    return 3;  // U+FEFF
+  }
+  return 0;
+}
+
+// Same as String.trim() in Dart.
+std::string_view Trim(std::string_view value) {
+  while (size_t length = LeadingWhitespace(value)) {
+    value.remove_prefix(length);
+  }
+  while (!value.empty()) {
+    // Steps back over one UTF-8 sequence.
+    size_t start = value.size() - 1;
+    while (start > 0 &&
+           (static_cast<unsigned char>(value[start]) & 0xC0) == 0x80) {
+      --start;
+    }
+    std::string_view last = value.substr(start);
+    if (LeadingWhitespace(last) != last.size()) {
+      break;
+    }
+    value.remove_suffix(last.size());
+  }
+  return value;
+}
+
+void ReplaceAll(std::string* value, std::string_view from,
+                std::string_view to) {
+  size_t position = 0;
+  while ((position = value->find(from.data(), position, from.size())) !=
+         std::string::npos) {
+    value->replace(position, from.size(), to.data(), to.size());
+    position += to.size();
+  }
+}
+
+// normalizeValue() of the Dart parsers: undoes the escaping the proxy applies
+// to keep the XML well formed.
+std::string Normalize(std::string_view value) {
+  std::string normalized(Trim(value));
+  ReplaceAll(&normalized, "&_lt;", "<");
+  ReplaceAll(&normalized, "&_gt;", ">");
+  return normalized;
+}
+
+// Whether int.tryParse() in Dart accepts |value|.
+bool IsDartInt(std::string_view value) {
+  value = Trim(value);
+  if (!value.empty() && (value[0] == '+' || value[0] == '-')) {
+    value.remove_prefix(1);
+  }
+  if (value.size() > 2 && value[0] == '0' &&
+      (value[1] == 'x' || value[1] == 'X')) {
+    value.remove_prefix(2);
+    if (value.size() > 16) {
+      return false;
+    }
+    return std::all_of(value.begin(), value.end(), [](char c) {
+      return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+             (c >= 'A' && c <= 'F');
+    });
+  }
+  if (value.empty() || !std::all_of(value.begin(), value.end(), [](char c) {
+        return c >= '0' && c <= '9';
+      })) {
+    return false;
+  }
+  // Must fit in a 64-bit int.
+  std::string_view digits = value;
+  while (digits.size() > 1 && digits[0] == '0') {
+    digits.remove_prefix(1);
+  }
+  constexpr std::string_view kMax = "9223372036854775807";
+  return digits.size() < kMax.size() ||
+         (digits.size() == kMax.size() && digits <= kMax);
+}
+
+// Adds the text of the first child named |name| of |node|. Returns false if
+// there is none.
+bool AddChildText(const XmlSubtree& tree, NodeId node, std::string_view name,
+                  bool normalize, StringTable* strings, int32_t* cell) {
+  NodeId child = tree.FindChild(node, name);
+  if (child == XmlSubtree::kNone) {
+    return false;
+  }
+  std::string text = tree.Text(child);
+  *cell = strings->Add(normalize ? Normalize(text) : text);
+  return true;
+}
+
+// SignRequestDocumentParser.parse().
+bool ParseSignRequestDocument(const XmlSubtree& tree, NodeId node,
+                              StringTable* strings, RecordTable* documents,
+                              std::string* error) {
+  using namespace sign_request_document;
+  if (tree.lowercase_name(node) != "doc") {
+    *error = "Se ha encontrado el elemento '" +
+             std::string(tree.lowercase_name(node)) +
+             "' en el listado de documentos";
+    return false;
+  }
+  int32_t* row = documents->row(documents->AddRow());
+
+  std::string_view value;
+  if (!tree.FindAttribute(node, "docid", &value)) {
+    *error = "Existe un documento sin el atributo 'docid'";
+    return false;
+  }
+  row[kDocumentId] = strings->Add(value);
+
+  if (!AddChildText(tree, node, "nm", false, strings, &row[kName])) {
+    *error = "Existe un documento sin el elemento  nm";
+    return false;
+  }
+  AddChildText(tree, node, "sz", false, strings, &row[kSize]);
+  if (!AddChildText(tree, node, "mmtp", false, strings, &row[kMimeType])) {
+    *error = "Existe un documento sin el elemento mmtp";
+    return false;
+  }
+  if (!AddChildText(tree, node, "sigfrmt", false, strings,
+                    &row[kSignatureFormat])) {
+    *error = "Existe un documento sin el elemento sigfrmt";
+    return false;
+  }
+  if (!AddChildText(tree, node, "mdalgo", false, strings,
+                    &row[kMessageDigestAlgorithm])) {
+    *error = "Existe un documento sin el elemento mdalgo";
+    return false;
+  }
+  NodeId params = tree.FindChild(node, "params");
+  if (params != XmlSubtree::kNone) {
+    std::string text = tree.Text(params);
+    std::string_view trimmed = Trim(text);
+    if (!trimmed.empty() && trimmed != "null") {
+      row[kParams] = strings->Add(text);
+    }
+  }
+  return true;
+}
+
+// Adds the element children of |node| as documents, storing the range of
+// rows added in |first| and |count|.
+bool ParseSignRequestDocuments(const XmlSubtree& tree, NodeId node,
+                               StringTable* strings, RecordTable* documents,
+                               int32_t* first, int32_t* count,
+                               std::string* error) {
+  *first = static_cast<int32_t>(documents->rows());
+  *count = 0;
+  for (NodeId child = tree.first_child(node); child != XmlSubtree::kNone;
+       child = tree.next_sibling(child)) {
+    if (tree.kind(child) != XmlSubtree::NodeKind::kElement) {
+      continue;
+    }
+    if (!ParseSignRequestDocument(tree, child, strings, documents, error)) {
+      return false;
+    }
+    ++*count;
+  }
+  return true;
+}
+
+// Parses a boolean attribute as parseBool() in the Dart parsers does.
+bool ParseBool(std::string_view value, bool* result) {
+  std::string lower = ToLowerAscii(value);
+  if (lower == "true") {
+    *result = true;
+    return true;
+  }
+  if (lower == "false") {
+    *result = false;
+    return true;
+  }
+  return false;
+}
+
+// RequestListResponseParser.
+class RequestListParser : public ResponseParser {
+ public:
+  RequestListParser() : ResponseParser(2) {
+    list_ = AddTable("list", request_list::kListStride);
+    requests_ = AddTable("requests", request_list::kRequestStride);
+    documents_ = AddTable("docs", sign_request_document::kDocumentStride);
+    list_->AddRow();
+  }
+
+ protected:
+  void OnRoot(const XmlPullParser& parser) override {
+    std::string name = ToLowerAscii(parser.name());
+    if (name == "err") {
+      const XmlPullParser::Attribute* code = parser.FindAttribute("cd");
+      if (code) {
+        SetError("El servicio proxy notificó un error (" + code->name +
+                 "): " + code->value);
+        return;
+      }
+    }
+    if (name != "list") {
+      SetError("El elemento raiz del XML debe ser list y aparece: " + name);
+      return;
+    }
+    const XmlPullParser::Attribute* total = parser.FindAttribute("n");
+    if (total) {
+      list_->row(0)[request_list::kTotal] = mutable_strings().Add(total->value);
+      if (IsDartInt(total->value)) {
+        size_t announced = static_cast<size_t>(
+            std::min<long long>(std::max(std::atoll(total->value.c_str()), 0LL),
+                                static_cast<long long>(kMaxReservedRequests)));
+        requests_->Reserve(announced);
+        documents_->Reserve(announced);
+      }
+    }
+  }
+
+  void OnRecord(const XmlSubtree& tree) override {
+    using namespace request_list;
+    StringTable& strings = mutable_strings();
+    NodeId node = tree.root();
+    if (tree.lowercase_name(node) != "rqt") {
+      SetError("Se ha encontrado el elemento '" +
+               std::string(tree.lowercase_name(node)) +
+               "' en el listado de peticiones");
+      return;
+    }
+    int32_t* row = requests_->row(requests_->AddRow());
+
+    std::string_view value;
+    if (!tree.FindAttribute(node, "id", &value)) {
+      SetError("No se ha encontrado el atributo obligatorio 'id' en un "
+               "peticion de firma");
+      return;
+    }
+    std::string ref(value);
+    row[kId] = strings.Add(ref);
+
+    if (tree.FindAttribute(node, "priority", &value)) {
+      if (!IsDartInt(value)) {
+        SetError("La prioridad de la peticion con referencia '" + ref +
+                 "' no es valida. Debe ser un valor entero");
+        return;
+      }
+      row[kPriority] = strings.Add(value);
+    }
+
+    bool flag = false;
+    row[kWorkflow] = 0;
+    if (tree.FindAttribute(node, "workflow", &value)) {
+      if (!ParseBool(value, &flag)) {
+        SetError("El valor del atributo 'false' de la peticion con "
+                 "referencia '" + ref + "' no es valida. no es valido. Debe "
+                 "ser 'true' o 'false'");
+        return;
+      }
+      row[kWorkflow] = flag ? 1 : 0;
+    }
+    row[kForward] = 0;
+    if (tree.FindAttribute(node, "forward", &value)) {
+      if (!ParseBool(value, &flag)) {
+        SetError("El valor del atributo 'false' de la peticion con "
+                 "referencia '" + ref + "' no es valida. no es valido. Debe "
+                 "ser 'true' o 'false'");
+        return;
+      }
+      row[kForward] = flag ? 1 : 0;
+    }
+
+    row[kType] = 0;
+    if (tree.FindAttribute(node, "type", &value)) {
+      row[kType] = value == "FIRMA" ? 0 : value == "VISTOBUENO" ? 1 : -1;
+    }
+
+    auto missing = [&](const char* element) {
+      SetError("La petición con referencia '" + ref +
+               "' no contiene el elemento " + element);
+    };
+    if (!AddChildText(tree, node, "subj", true, &strings, &row[kSubject])) {
+      return missing("subj");
+    }
+    if (!AddChildText(tree, node, "snder", true, &strings, &row[kSender])) {
+      return missing("snder");
+    }
+    if (!AddChildText(tree, node, "view", false, &strings, &row[kView])) {
+      return missing("view");
+    }
+    if (!AddChildText(tree, node, "date", false, &strings, &row[kDate])) {
+      return missing("date");
+    }
+    NodeId expiration = tree.FindChild(node, "expdate");
+    if (expiration != XmlSubtree::kNone) {
+      std::string text = tree.Text(expiration);
+      if (!text.empty()) {
+        row[kExpirationDate] = strings.Add(text);
+      }
+    }
+    NodeId documents = tree.FindChild(node, "docs");
+    if (documents == XmlSubtree::kNone) {
+      return missing("docs");
+    }
+    int32_t first = 0;
+    int32_t count = 0;
+    std::string error;
+    bool parsed = ParseSignRequestDocuments(tree, documents, &strings,
+                                            documents_, &first, &count,
+                                            &error);
+    if (!parsed) {
+      SetError(error);
+      return;
+    }
+    row[kFirstDocument] = first;
+    row[kDocumentCount] = count;
+  }
+
+ private:
+  RecordTable* list_;
+  RecordTable* requests_;
+  RecordTable* documents_;
+};
+
+// RequestDetailResponseParser.
+class RequestDetailParser : public ResponseParser {
+ public:
+  RequestDetailParser() : ResponseParser(1) {
+    using namespace request_detail;
+    detail_ = AddTable("detail", kDetailStride);
+    senders_ = AddTable("senders", kSenderStride);
+    lines_ = AddTable("lines", kLineStride);
+    signers_ = AddTable("signers", kSignerStride);
+    documents_ = AddTable("docs", sign_request_document::kDocumentStride);
+    attached_ = AddTable("attached", kAttachedStride);
+  }
+
+ protected:
+  void OnRoot(const XmlPullParser& parser) override {
+    std::string name = ToLowerAscii(parser.name());
+    if (name != "dtl") {
+      SetError("El elemento raiz del XML debe ser 'dtl ' y aparece: " + name);
+    }
+  }
+
+  void OnRecord(const XmlSubtree& tree) override {
+    using namespace request_detail;
+    StringTable& strings = mutable_strings();
+    NodeId node = tree.root();
+    detail_->AddRow();
+    // The detail table has a single row and nothing else is added to it, so
+    // the pointer stays valid.
+    int32_t* row = detail_->row(0);
+
+    std::string_view value;
+    if (!tree.FindAttribute(node, "id", &value)) {
+      SetError("El detalle de la peticion carece del atributo 'id' con el "
+               "identificador de la peticion");
+      return;
+    }
+    std::string id(value);
+    row[kId] = strings.Add(id);
+
+    auto invalid_attribute = [&](const char* attribute) {
+      SetError(std::string("Se ha establecido un valor no valido en el "
+                           "atributo '") +
+               attribute + " ' en el detalle de la peticion  " + id);
+    };
+    if (tree.FindAttribute(node, "priority", &value)) {
+      if (!IsDartInt(value)) {
+        return invalid_attribute("priority");
+      }
+      row[kPriority] = strings.Add(value);
+    }
+    bool flag = false;
+    row[kWorkflow] = 0;
+    if (tree.FindAttribute(node, "workflow", &value)) {
+      if (!ParseBool(value, &flag)) {
+        return invalid_attribute("workflow");
+      }
+      row[kWorkflow] = flag ? 1 : 0;
+    }
+    row[kForward] = 0;
+    if (tree.FindAttribute(node, "forward", &value)) {
+      if (!ParseBool(value, &flag)) {
+        return invalid_attribute("forward");
+      }
+      row[kForward] = flag ? 1 : 0;
+    }
+    // Unlike the list, a detail without type keeps the default of
+    // SignRequest.withId (null).
+    if (tree.FindAttribute(node, "type", &value)) {
+      std::string type = ToUpperAscii(value);
+      row[kType] = type == "FIRMA" ? 0 : type == "VISTOBUENO" ? 1 : -1;
+    }
+
+    auto missing = [&](const char* element) {
+      SetError(std::string("No se encontró el nodo '") + element +
+               " ' en la peticion con identificador " + id);
+    };
+
+    if (!AddChildText(tree, node, "subj", true, &strings, &row[kSubject])) {
+      return missing("subj");
+    }
+    AddChildText(tree, node, "msg", true, &strings, &row[kMessage]);
+
+    NodeId senders = tree.FindChild(node, "snders");
+    if (senders == XmlSubtree::kNone) {
+      return missing("snders");
+    }
+    row[kFirstSender] = static_cast<int32_t>(senders_->rows());
+    row[kSenderCount] = 0;
+    for (NodeId child = tree.first_child(senders); child != XmlSubtree::kNone;
+         child = tree.next_sibling(child)) {
+      if (tree.kind(child) != XmlSubtree::NodeKind::kElement) {
+        continue;
+      }
+      if (tree.lowercase_name(child) != "snder") {
+        SetError("Se ha encontrado el nodo " +
+                 std::string(tree.lowercase_name(child)) +
+                 "  en el listado de remitentes de la solicitud de firma");
+        return;
+      }
+      senders_->row(senders_->AddRow())[kSenderName] =
+          strings.Add(Normalize(tree.Text(child)));
+      ++row[kSenderCount];
+    }
+
+    if (!AddChildText(tree, node, "date", false, &strings, &row[kDate])) {
+      return missing("date");
+    }
+    NodeId expiration = tree.FindChild(node, "expdate");
+    if (expiration != XmlSubtree::kNone) {
+      std::string text = tree.Text(expiration);
+      if (!text.empty()) {
+        row[kExpirationDate] = strings.Add(text);
+      }
+    }
+    if (!AddChildText(tree, node, "app", true, &strings, &row[kApplication])) {
+      return missing("app");
+    }
+    AddChildText(tree, node, "rejt", false, &strings, &row[kRejectReason]);
+    if (!AddChildText(tree, node, "ref", true, &strings, &row[kReference])) {
+      return missing("ref");
+    }
+    if (!AddChildText(tree, node, "signlinestype", true, &strings,
+                      &row[kSignLinesType])) {
+      row[kSignLinesType] = strings.Add("cascada");
+    }
+
+    NodeId lines = tree.FindChild(node, "sgnlines");
+    if (lines == XmlSubtree::kNone) {
+      return missing("sgnlines");
+    }
+    if (!ParseSignLines(tree, lines, row)) {
+      return;
+    }
+
+    NodeId documents = tree.FindChild(node, "docs");
+    if (documents == XmlSubtree::kNone) {
+      return missing("docs");
+    }
+    std::string error;
+    if (!ParseSignRequestDocuments(tree, documents, &strings, documents_,
+                                   &row[kFirstDocument], &row[kDocumentCount],
+                                   &error)) {
+      SetError(error);
+      return;
+    }
+
+    NodeId attached = tree.FindChild(node, "attachedlist");
+    if (attached != XmlSubtree::kNone) {
+      ParseAttachments(tree, attached, row);
+    }
+  }
+
+ private:
+  // getSignLines(). Note that, as there, the done state of a receiver
+  // carries over to the following ones that do not state it.
+  bool ParseSignLines(const XmlSubtree& tree, NodeId lines, int32_t* detail) {
+    using namespace request_detail;
+    StringTable& strings = mutable_strings();
+    detail[kFirstLine] = static_cast<int32_t>(lines_->rows());
+    detail[kLineCount] = 0;
+    bool done = false;
+    std::string_view value;
+    for (NodeId line = tree.first_child(lines); line != XmlSubtree::kNone;
+         line = tree.next_sibling(line)) {
+      if (tree.kind(line) != XmlSubtree::NodeKind::kElement) {
+        continue;
+      }
+      if (tree.lowercase_name(line) != "sgnline") {
+        SetError("Se ha encontrado el nodo " +
+                 std::string(tree.lowercase_name(line)) +
+                 " en el listado de líneas de firma");
+        return false;
+      }
+      int32_t line_index = lines_->AddRow();
+      lines_->row(line_index)[kLineType] = strings.Add(
+          tree.FindAttribute(line, "type", &value) ? value : "FIRMA");
+      lines_->row(line_index)[kFirstSigner] =
+          static_cast<int32_t>(signers_->rows());
+      lines_->row(line_index)[kSignerCount] = 0;
+      ++detail[kLineCount];
+
+      for (NodeId receiver = tree.first_child(line);
+           receiver != XmlSubtree::kNone;
+           receiver = tree.next_sibling(receiver)) {
+        if (tree.kind(receiver) != XmlSubtree::NodeKind::kElement) {
+          continue;
+        }
+        if (tree.lowercase_name(receiver) != "rcvr") {
+          SetError("Se ha encontrado el nodo " +
+                   std::string(tree.lowercase_name(receiver)) +
+                   " en el listado de líneas de receptores");
+          return false;
+        }
+        if (tree.FindAttribute(receiver, "st", &value)) {
+          done = ToLowerAscii(value) == "true";
+        }
+        int32_t* signer = signers_->row(signers_->AddRow());
+        signer[kSignerName] = strings.Add(Normalize(tree.Text(receiver)));
+        signer[kSignerDone] = done ? 1 : 0;
+        ++lines_->row(line_index)[kSignerCount];
+      }
+    }
+    return true;
+  }
+
+  // getAttachments() with RequestDocumentParser.parse().
+  void ParseAttachments(const XmlSubtree& tree, NodeId attached,
+                        int32_t* detail) {
+    using namespace request_detail;
+    StringTable& strings = mutable_strings();
+    detail[kFirstAttached] = static_cast<int32_t>(attached_->rows());
+    detail[kAttachedCount] = 0;
+    std::string_view value;
+    for (NodeId node = tree.first_child(attached); node != XmlSubtree::kNone;
+         node = tree.next_sibling(node)) {
+      if (tree.kind(node) != XmlSubtree::NodeKind::kElement) {
+        continue;
+      }
+      std::string_view name = tree.lowercase_name(node);
+      if (name != "doc" && name != "attached") {
+        SetError("Se ha encontrado el elemento '" + std::string(name) +
+                 "' en el listado de documentos");
+        return;
+      }
+      int32_t* row = attached_->row(attached_->AddRow());
+      if (!tree.FindAttribute(node, "docid", &value)) {
+        SetError("Existe un documento sin el atributo 'docid'");
+        return;
+      }
+      row[kAttachedId] = strings.Add(value);
+      if (!AddChildText(tree, node, "nm", false, &strings,
+                        &row[kAttachedName])) {
+        SetError("Existe un documento sin el elemento  nm");
+        return;
+      }
+      AddChildText(tree, node, "sz", false, &strings, &row[kAttachedSize]);
+      if (!AddChildText(tree, node, "mmtp", false, &strings,
+                        &row[kAttachedMimeType])) {
+        SetError("Existe un documento sin el elemento mmtp");
+        return;
+      }
+      ++detail[kAttachedCount];
+    }
+  }
+
+  RecordTable* detail_;
+  RecordTable* senders_;
+  RecordTable* lines_;
+  RecordTable* signers_;
+  RecordTable* documents_;
+  RecordTable* attached_;
+};
+
+// PresignResponseParser.
+class PresignParser : public ResponseParser {
+ public:
+  PresignParser() : ResponseParser(2) {
+    requests_ = AddTable("requests", presign::kRequestStride);
+    documents_ = AddTable("docs", presign::kDocumentStride);
+    params_ = AddTable("params", presign::kParamStride);
+  }
+
+ protected:
+  void OnRoot(const XmlPullParser& parser) override {
+    std::string name = ToLowerAscii(parser.name());
+    if (name != "pres") {
+      SetError("El elemento raiz del XML debe ser 'pres ' y aparece: " + name);
+    }
+  }
+
+  void OnRecord(const XmlSubtree& tree) override {
+    using namespace presign;
+    StringTable& strings = mutable_strings();
+    NodeId node = tree.root();
+    if (tree.lowercase_name(node) != "req") {
+      SetError("Se ha encontrado el elemento '" +
+               std::string(tree.lowercase_name(node)) +
+               "' en los nodos de prefirma");
+      return;
+    }
+    int32_t request = requests_->AddRow();
+
+    std::string_view value;
+    if (!tree.FindAttribute(node, "id", &value)) {
+      SetError("No se ha encontrado el atributo 'id' en una prefirma");
+      return;
+    }
+    requests_->row(request)[kReference] = strings.Add(value);
+    bool status_ok = !tree.FindAttribute(node, "status", &value) ||
+                     ToLowerAscii(value) != "ko";
+    requests_->row(request)[kStatusOk] = status_ok ? 1 : 0;
+    if (tree.FindAttribute(node, "exceptionb64", &value)) {
+      requests_->row(request)[kException] = strings.Add(value);
+    }
+    if (!status_ok) {
+      return;
+    }
+
+    requests_->row(request)[kFirstDocument] =
+        static_cast<int32_t>(documents_->rows());
+    requests_->row(request)[kDocumentCount] = 0;
+    for (NodeId child = tree.first_child(node); child != XmlSubtree::kNone;
+         child = tree.next_sibling(child)) {
+      if (tree.kind(child) != XmlSubtree::NodeKind::kElement) {
+        continue;
+      }
+      if (!ParseDocument(tree, child)) {
+        return;
+      }
+      ++requests_->row(request)[kDocumentCount];
+    }
+  }
+
+ private:
+  // PresignRequestDocumentParser.parse().
+  bool ParseDocument(const XmlSubtree& tree, NodeId node) {
+    using namespace presign;
+    StringTable& strings = mutable_strings();
+    if (tree.lowercase_name(node) != "doc") {
+      SetError("Se ha encontrado el elemento '" +
+               std::string(tree.lowercase_name(node)) +
+               "' en el listado de documentos de prefirma");
+      return false;
+    }
+    int32_t document = documents_->AddRow();
+    int32_t* row = documents_->row(document);
+
+    std::string_view value;
+    if (!tree.FindAttribute(node, "docid", &value)) {
+      SetError("No se ha encontrado el atributo 'docid' en una petición de "
+               "prefirma de documento");
+      return false;
+    }
+    row[kDocumentId] = strings.Add(value);
+
+    std::string operation = "sign";
+    if (tree.FindAttribute(node, "cop", &value)) {
+      std::string lower = ToLowerAscii(value);
+      operation = lower == "firma"         ? "sign"
+                  : lower == "cofirma"     ? "cosign"
+                  : lower == "contrafirma" ? "countersign"
+                                           : std::string(value);
+    }
+    row[kCryptoOperation] = strings.Add(operation);
+
+    if (!tree.FindAttribute(node, "sigfrmt", &value)) {
+      SetError("No se ha encontrado el atributo obligatorio 'sigfrmt' en una "
+               "peticion de prefirma de documento");
+      return false;
+    }
+    row[kSignatureFormat] = strings.Add(value);
+    if (tree.FindAttribute(node, "mdalgo", &value)) {
+      row[kMessageDigestAlgorithm] = strings.Add(value);
+    }
+
+    AddChildText(tree, node, "params", false, &strings, &row[kParams]);
+
+    NodeId result = tree.FindChild(node, "result");
+    if (result == XmlSubtree::kNone) {
+      SetError("No se ha encontrado el nodo result  en la respuesta de la "
+               "peticion de prefirma del documento");
+      return false;
+    }
+
+    // TriphaseConfigDataParser.parse() goes through every child node, so
+    // text between the parameters is rejected too.
+    row[kFirstParam] = static_cast<int32_t>(params_->rows());
+    row[kParamCount] = 0;
+    for (NodeId param = tree.first_child(result); param != XmlSubtree::kNone;
+         param = tree.next_sibling(param)) {
+      if (tree.kind(param) != XmlSubtree::NodeKind::kElement ||
+          !tree.FindAttribute(param, "n", &value)) {
+        SetError("Se ha indicado un parametro de firma trifasica sin clave");
+        return false;
+      }
+      int32_t* pair = params_->row(params_->AddRow());
+      pair[kKey] = strings.Add(value);
+      pair[kValue] = strings.Add(Trim(tree.Text(param)));
+      ++documents_->row(document)[kParamCount];
+    }
+    return true;
+  }
+
+  RecordTable* requests_;
+  RecordTable* documents_;
+  RecordTable* params_;
+};
+
+// PostsignResponseParser: only the first child element of <posts> is read.
+class PostsignParser : public ResponseParser {
+ public:
+  PostsignParser() : ResponseParser(2) {
+    result_ = AddTable("result", postsign::kResultStride);
+  }
+
+ protected:
+  void OnRoot(const XmlPullParser& parser) override {
+    std::string name = ToLowerAscii(parser.name());
+    if (name != "posts") {
+      SetError("El elemento raiz del XML debe ser 'posts ' y aparece: " +
+               name);
+    }
+  }
+
+  void OnRecord(const XmlSubtree& tree) override {
+    using namespace postsign;
+    if (result_->rows() > 0) {
+      return;
+    }
+    NodeId node = tree.root();
+    if (tree.lowercase_name(node) != "req") {
+      // The Dart parser names the expected element twice in this message.
+      SetError("No se encontró el elemento 'req' y aparece: req");
+      return;
+    }
+    std::string_view value;
+    if (!tree.FindAttribute(node, "id", &value)) {
+      SetError("No se ha encontrado el atributo 'id' en una respuesta de "
+               "postfirma");
+      return;
+    }
+    int32_t* row = result_->row(result_->AddRow());
+    row[kReference] = mutable_strings().Add(value);
+    // Unlike the presign status, this one is compared case-sensitively.
+    row[kStatusOk] =
+        !tree.FindAttribute(node, "status", &value) || value != "KO" ? 1 : 0;
+  }
+
+  void OnEnd() override {
+    if (!has_error() && result_->rows() == 0) {
+      SetError("No se encontró el elemento 'req' y aparece: req");
+    }
+  }
+
+ private:
+  RecordTable* result_;
+};
+
+}  // namespace
+
+std::unique_ptr<ResponseParser> CreateResponseParser(ResponseKind kind) {
+  switch (kind) {
+    case ResponseKind::kRequestList:
+      return std::make_unique<RequestListParser>();
+    case ResponseKind::kRequestDetail:
+      return std::make_unique<RequestDetailParser>();
+    case ResponseKind::kPresign:
+      return std::make_unique<PresignParser>();
+    case ResponseKind::kPostsign:
+      return std::make_unique<PostsignParser>();
+  }
+  return nullptr;
+}
+
+}  // namespace native_core
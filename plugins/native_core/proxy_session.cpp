@@ -0,0 +1,370 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/proxy_session.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "include/native_core/proxy_response_parsers.h"
+#include "include/native_core/xml_request_builder.h"
+
+namespace native_core {
+
+namespace {
+
+using NodeId = XmlSubtree::NodeId;
+
+constexpr char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// base64Encode() in Dart.
+std::string Base64Encode(const std::vector<uint8_t>& data) {
+  std::string encoded;
+  encoded.reserve((data.size() + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 3 <= data.size(); i += 3) {
+    uint32_t bits = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) |
+                    data[i + 2];
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += kAlphabet[(bits >> 6) & 0x3F];
+    encoded += kAlphabet[bits & 0x3F];
+  }
+  size_t remainder = data.size() - i;
+  if (remainder > 0) {
+    uint32_t bits = uint32_t{data[i]} << 16;
+    if (remainder == 2) {
+      bits |= uint32_t{data[i + 1]} << 8;
+    }
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += remainder == 2 ? kAlphabet[(bits >> 6) & 0x3F] : '=';
+    encoded += '=';
+  }
+  return encoded;
+}
+
+int Base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+' || c == '-') return 62;
+  if (c == '/' || c == '_') return 63;
+  return -1;
+}
+
+// base64Decode() in Dart, for the challenge. The text of <lgnrq> is decoded
+// as a whole, so the whitespace around it that pretty-printing proxies add
+// is skipped.
+bool Base64Decode(std::string_view encoded, std::vector<uint8_t>* data) {
+  data->clear();
+  uint32_t bits = 0;
+  size_t count = 0;
+  bool padding = false;
+  for (char c : encoded) {
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      continue;
+    }
+    if (c == '=') {
+      padding = true;
+      continue;
+    }
+    int value = Base64Value(c);
+    if (value < 0 || padding) {
+      return false;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    if (++count % 4 == 0) {
+      data->push_back(static_cast<uint8_t>(bits >> 16));
+      data->push_back(static_cast<uint8_t>(bits >> 8));
+      data->push_back(static_cast<uint8_t>(bits));
+      bits = 0;
+    }
+  }
+  size_t tail = count % 4;
+  if (tail == 1) {
+    return false;
+  }
+  if (tail >= 2) {
+    bits <<= 6 * (4 - tail);
+    data->push_back(static_cast<uint8_t>(bits >> 16));
+    if (tail == 3) {
+      data->push_back(static_cast<uint8_t>(bits >> 8));
+    }
+  }
+  return !data->empty();
+}
+
+// The element the login parsers read: the first child element of the root,
+// or the root itself if it has none.
+NodeId RequestNode(const XmlSubtree& tree) {
+  for (NodeId child = tree.first_child(tree.root());
+       child != XmlSubtree::kNone; child = tree.next_sibling(child)) {
+    if (tree.kind(child) == XmlSubtree::NodeKind::kElement) {
+      return child;
+    }
+  }
+  return tree.root();
+}
+
+// LoginTokenResponseParser.
+class LoginTokenParser : public ResponseParser {
+ public:
+  LoginTokenParser() : ResponseParser(1) {}
+
+  const std::string& token() const { return token_; }
+  bool status_ok() const { return status_ok_; }
+
+ protected:
+  void OnRecord(const XmlSubtree& tree) override {
+    std::string root(tree.lowercase_name(tree.root()));
+    if (root != "lgnrq") {
+      SetError("El elemento raiz del XML debe ser lgnrq y aparece: " + root);
+      return;
+    }
+    NodeId node = RequestNode(tree);
+    if (tree.lowercase_name(node) != "lgnrq") {
+      SetError("Se encontró un elemento " +
+               std::string(tree.lowercase_name(node)) +
+               " en la solicitud de token de inicio de sesión");
+      return;
+    }
+    std::string_view value;
+    if (!tree.FindAttribute(node, "id", &value)) {
+      SetError("No se ha encontrado el atributo obligatorio id en un "
+               "petición de login");
+      return;
+    }
+    status_ok_ = !tree.FindAttribute(node, "err", &value);
+    token_ = tree.Text(node);
+  }
+
+ private:
+  std::string token_;
+  bool status_ok_ = false;
+};
+
+// LoginValidationResponseParser.
+class LoginValidationParser : public ResponseParser {
+ public:
+  LoginValidationParser() : ResponseParser(1) {}
+
+  bool status_ok() const { return status_ok_; }
+  const std::string& dni() const { return dni_; }
+  const std::string& message() const { return message_; }
+
+ protected:
+  void OnRecord(const XmlSubtree& tree) override {
+    std::string root(tree.lowercase_name(tree.root()));
+    if (root != "vllgnrq") {
+      SetError("El elemento raiz del XML debe ser vllgnrq y aparece: " +
+               root);
+      return;
+    }
+    NodeId node = RequestNode(tree);
+    if (tree.lowercase_name(node) != "vllgnrq") {
+      SetError("Se encontró un elemento " +
+               std::string(tree.lowercase_name(node)) +
+               " en el listado de peticiones");
+      return;
+    }
+    std::string_view value;
+    if (!tree.FindAttribute(node, "ok", &value)) {
+      SetError("No se ha encontrado el atributo obligatorio ok en un "
+               "respuesta de login");
+      return;
+    }
+    // Only "false", in any case, is a failure.
+    std::string ok(value);
+    for (char& c : ok) {
+      if (c >= 'A' && c <= 'Z') {
+        c = static_cast<char>(c - 'A' + 'a');
+      }
+    }
+    status_ok_ = ok != "false";
+    if (tree.FindAttribute(node, "er", &value)) {
+      message_ = std::string(value);
+    }
+    if (tree.FindAttribute(node, "dni", &value)) {
+      dni_ = std::string(value);
+    }
+  }
+
+ private:
+  bool status_ok_ = false;
+  std::string dni_;
+  std::string message_;
+};
+
+std::optional<std::string> StringAt(const StringTable& strings,
+                                    int32_t index) {
+  if (index == StringTable::kNull) {
+    return std::nullopt;
+  }
+  int32_t begin = index == 0 ? 0 : strings.ends()[index - 1];
+  return strings.bytes().substr(begin, strings.ends()[index] - begin);
+}
+
+}  // namespace
+
+ProxySession::ProxySession(HttpClient* client, std::string url)
+    : client_(client), url_(url), transport_(client, std::move(url), "") {}
+
+bool ProxySession::Exchange(const std::vector<uint8_t>& body,
+                            ResponseParser* parser,
+                            std::string* error) {
+  int status = transport_.Post(
+      body, [&](const char* data, size_t size) { parser->Feed(data, size); });
+  if (status == 0) {
+    *error = "Error de red";
+    return false;
+  }
+  if (status == 401) {
+    *error = "Sesión no autorizada";
+    return false;
+  }
+  if (status != 200) {
+    *error = "El proxy respondió con el estado " + std::to_string(status);
+    return false;
+  }
+  parser->Finish();
+  if (parser->has_syntax_error()) {
+    *error = parser->syntax_error();
+    return false;
+  }
+  if (parser->has_proxy_error()) {
+    *error = parser->proxy_error();
+    return false;
+  }
+  if (parser->has_error()) {
+    *error = parser->error();
+    return false;
+  }
+  return true;
+}
+
+bool ProxySession::Login(Pkcs1Signer* signer, std::string* error) {
+  dni_.clear();
+  journal_owner_.clear();
+  client_->ClearSession();
+
+  std::vector<uint8_t> certificate = signer->Certificate();
+  if (certificate.empty()) {
+    *error = "No se conoce el certificado de la clave de firma";
+    return false;
+  }
+
+  LoginTokenParser token_parser;
+  if (!Exchange(BuildLoginRequestBody(kLoginRequestOperation), &token_parser,
+                error)) {
+    return false;
+  }
+  std::vector<uint8_t> challenge;
+  if (!token_parser.status_ok() ||
+      !Base64Decode(token_parser.token(), &challenge)) {
+    *error = "El proxy no ha devuelto un token de inicio de sesión válido";
+    return false;
+  }
+
+  std::vector<uint8_t> pkcs1;
+  if (!signer->Sign("SHA256withRSA", challenge.data(), challenge.size(),
+                    &pkcs1, error)) {
+    return false;
+  }
+  std::string certificate_base64 = Base64Encode(certificate);
+  LoginValidationParser validation_parser;
+  if (!Exchange(BuildLoginValidationBody(kLoginValidationOperation,
+                                         certificate_base64,
+                                         Base64Encode(pkcs1)),
+                &validation_parser, error)) {
+    return false;
+  }
+  if (!validation_parser.status_ok()) {
+    *error = validation_parser.message().empty()
+                 ? "El proxy ha rechazado el inicio de sesión"
+                 : validation_parser.message();
+    return false;
+  }
+  dni_ = validation_parser.dni();
+  journal_owner_ = url_ + "|" + certificate_base64;
+  return true;
+}
+
+bool ProxySession::ListRequests(const std::string& state,
+                                int page,
+                                int page_size,
+                                std::vector<ListedRequest>* requests,
+                                int* total,
+                                std::string* error) {
+  std::unique_ptr<ResponseParser> parser =
+      CreateResponseParser(ResponseKind::kRequestList);
+  if (!Exchange(BuildRequestListBody(kRequestListOperation, state, nullptr,
+                                     page, page_size),
+                parser.get(), error)) {
+    return false;
+  }
+
+  const StringTable& strings = parser->strings();
+  const RecordTable& list = *parser->tables()[0];
+  const RecordTable& rows = *parser->tables()[1];
+  const RecordTable& documents = *parser->tables()[2];
+
+  std::optional<std::string> total_text =
+      StringAt(strings, list.cells()[request_list::kTotal]);
+  *total = total_text ? std::atoi(total_text->c_str()) : -1;
+
+  requests->clear();
+  requests->reserve(rows.rows());
+  for (size_t i = 0; i < rows.rows(); ++i) {
+    const int32_t* row = rows.cells().data() + i * rows.stride();
+    ListedRequest request;
+    request.id = StringAt(strings, row[request_list::kId]).value_or("");
+    request.subject =
+        StringAt(strings, row[request_list::kSubject]).value_or("");
+    request.type = row[request_list::kType];
+    if (row[request_list::kFirstDocument] >= 0) {
+      request.documents.emplace();
+      for (int32_t d = 0; d < row[request_list::kDocumentCount]; ++d) {
+        using namespace sign_request_document;
+        const int32_t* cells =
+            documents.cells().data() +
+            (row[request_list::kFirstDocument] + d) * documents.stride();
+        TriphaseDocument document;
+        // Dart interpolates a missing string as "null".
+        document.id = StringAt(strings, cells[kDocumentId]).value_or("null");
+        document.signature_format =
+            StringAt(strings, cells[kSignatureFormat]).value_or("null");
+        document.message_digest_algorithm =
+            StringAt(strings, cells[kMessageDigestAlgorithm]).value_or("null");
+        document.params = StringAt(strings, cells[kParams]);
+        request.documents->push_back(std::move(document));
+      }
+    }
+    requests->push_back(std::move(request));
+  }
+  return true;
+}
+
+void ProxySession::Logout() {
+  transport_.Post(BuildLogoutBody(kLogoutOperation),
+                  [](const char*, size_t) {});
+  client_->ClearSession();
+  dni_.clear();
+  journal_owner_.clear();
+}
+
+}  // namespace native_core
@@ -0,0 +1,495 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/request_list_cache.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "include/native_core/mapped_file.h"
+
+namespace native_core {
+
+namespace {
+
+// File layout. Every number is an unsigned 32-bit little-endian integer and
+// every string a length followed by its UTF-8 bytes, with kNullLength for a
+// null string.
+//
+//   Header (kHeaderSize bytes): "PFRC", version, index offset, index size,
+//   record count, index checksum (FNV-1a of the index bytes), bytes of
+//   the records the index refers to, and a zero.
+//
+//   Records, back to back: id, subject, sender, view, date, expiration
+//   date, priority, workflow, forward, type (as int32), document count and,
+//   per document, id, name, size, MIME type, signature format, digest
+//   algorithm and params.
+//
+//   Index: total (a string), then the offset and size of each record in
+//   list order.
+//
+// A merge appends records and a new index after the current end and then
+// rewrites the header; what the old index referred to is never overwritten.
+constexpr char kMagic[4] = {'P', 'F', 'R', 'C'};
+constexpr size_t kHeaderSize = 32;
+constexpr uint32_t kNullLength = 0xffffffff;
+
+// Stale bytes tolerated before the file is rewritten from scratch, as a
+// multiple of the live ones.
+constexpr size_t kCompactionRatio = 2;
+
+struct Header {
+  uint32_t index_offset = 0;
+  uint32_t index_size = 0;
+  uint32_t record_count = 0;
+  uint32_t index_checksum = 0;
+  uint32_t live_bytes = 0;
+};
+
+uint32_t Checksum(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+uint64_t Hash64(std::string_view value) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : value) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+void PutU32(std::string* out, uint32_t value) {
+  char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                   static_cast<char>(value >> 16),
+                   static_cast<char>(value >> 24)};
+  out->append(bytes, 4);
+}
+
+uint32_t GetU32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) |
+         static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 |
+         static_cast<uint32_t>(data[3]) << 24;
+}
+
+// Bounds-checked reads from the mapped file. Once a read fails every later
+// one does too, and ok() turns false.
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size) : data_(data), left_(size) {}
+
+  uint32_t U32() {
+    if (left_ < 4) {
+      left_ = 0;
+      ok_ = false;
+      return 0;
+    }
+    uint32_t value = GetU32(data_);
+    data_ += 4;
+    left_ -= 4;
+    return value;
+  }
+
+  // Adds the string to |strings| and returns its index, or kNull.
+  int32_t String(StringTable* strings) {
+    uint32_t length = U32();
+    if (length == kNullLength || !ok_) {
+      return StringTable::kNull;
+    }
+    if (left_ < length) {
+      left_ = 0;
+      ok_ = false;
+      return StringTable::kNull;
+    }
+    std::string_view value(reinterpret_cast<const char*>(data_), length);
+    data_ += length;
+    left_ -= length;
+    return strings->Add(value);
+  }
+
+  // Only the first string, the request id, is needed to merge.
+  std::string_view PeekString() const {
+    if (left_ < 4) {
+      return std::string_view();
+    }
+    uint32_t length = GetU32(data_);
+    if (length == kNullLength || left_ - 4 < length) {
+      return std::string_view();
+    }
+    return std::string_view(reinterpret_cast<const char*>(data_ + 4), length);
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  const uint8_t* data_;
+  size_t left_;
+  bool ok_ = true;
+};
+
+// Encodes records from the tables of a parsed page.
+class Encoder {
+ public:
+  explicit Encoder(const StringTable& strings) : strings_(strings) {}
+
+  void String(std::string* out, int32_t index) const {
+    if (index < 0 || static_cast<size_t>(index) >= strings_.size()) {
+      PutU32(out, kNullLength);
+      return;
+    }
+    size_t start = index == 0 ? 0 : strings_.ends()[index - 1];
+    size_t end = strings_.ends()[index];
+    PutU32(out, static_cast<uint32_t>(end - start));
+    out->append(strings_.bytes(), start, end - start);
+  }
+
+  std::string_view View(int32_t index) const {
+    if (index < 0 || static_cast<size_t>(index) >= strings_.size()) {
+      return std::string_view();
+    }
+    size_t start = index == 0 ? 0 : strings_.ends()[index - 1];
+    return std::string_view(strings_.bytes()).substr(
+        start, strings_.ends()[index] - start);
+  }
+
+ private:
+  const StringTable& strings_;
+};
+
+const RecordTable* FindTable(const ResponseParser& page,
+                             std::string_view name) {
+  for (const auto& table : page.tables()) {
+    if (table->name() == name) {
+      return table.get();
+    }
+  }
+  return nullptr;
+}
+
+// The mapped file and its header, once validated.
+struct CacheFile {
+  std::unique_ptr<MappedFile> mapped;
+  Header header;
+};
+
+bool ReadHeader(const std::string& path, CacheFile* file) {
+  file->mapped = MappedFile::Open(path);
+  if (!file->mapped || file->mapped->size() < kHeaderSize) {
+    return false;
+  }
+  const uint8_t* data = file->mapped->data();
+  if (std::memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+      GetU32(data + 4) != RequestListCache::kVersion) {
+    return false;
+  }
+  Header& header = file->header;
+  header.index_offset = GetU32(data + 8);
+  header.index_size = GetU32(data + 12);
+  header.record_count = GetU32(data + 16);
+  header.index_checksum = GetU32(data + 20);
+  header.live_bytes = GetU32(data + 24);
+  size_t size = file->mapped->size();
+  if (header.index_offset < kHeaderSize || header.index_offset > size ||
+      header.index_size > size - header.index_offset) {
+    return false;
+  }
+  return Checksum(data + header.index_offset, header.index_size) ==
+         header.index_checksum;
+}
+
+std::string EncodeHeader(const Header& header) {
+  std::string bytes(kMagic, sizeof(kMagic));
+  PutU32(&bytes, RequestListCache::kVersion);
+  PutU32(&bytes, header.index_offset);
+  PutU32(&bytes, header.index_size);
+  PutU32(&bytes, header.record_count);
+  PutU32(&bytes, header.index_checksum);
+  PutU32(&bytes, header.live_bytes);
+  PutU32(&bytes, 0);
+  return bytes;
+}
+
+std::FILE* OpenFile(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                               : nullptr;
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+bool WriteAt(std::FILE* file, uint64_t offset, const std::string& bytes) {
+  return std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0 &&
+         std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+}
+
+}  // namespace
+
+RequestListCache::RequestListCache(std::string directory)
+    : directory_(std::move(directory)) {}
+
+std::unique_ptr<RequestListSnapshot> RequestListCache::Load(
+    const std::string& server,
+    const std::string& state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CacheFile file;
+  if (!ReadHeader(PathFor(server, state), &file)) {
+    return nullptr;
+  }
+  const uint8_t* data = file.mapped->data();
+  size_t size = file.mapped->size();
+  auto snapshot = std::make_unique<RequestListSnapshot>();
+  Reader index(data + file.header.index_offset, file.header.index_size);
+  snapshot->list.row(snapshot->list.AddRow())[request_list::kTotal] =
+      index.String(&snapshot->strings);
+  snapshot->requests.Reserve(file.header.record_count);
+
+  using namespace request_list;
+  using namespace sign_request_document;
+  for (uint32_t i = 0; i < file.header.record_count; i++) {
+    uint32_t offset = index.U32();
+    uint32_t record_size = index.U32();
+    if (!index.ok() || offset > size || record_size > size - offset) {
+      return nullptr;
+    }
+    Reader record(data + offset, record_size);
+    StringTable& strings = snapshot->strings;
+    int32_t* row = snapshot->requests.row(snapshot->requests.AddRow());
+    for (int field = kId; field <= kPriority; field++) {
+      row[field] = record.String(&strings);
+    }
+    row[kWorkflow] = static_cast<int32_t>(record.U32());
+    row[kForward] = static_cast<int32_t>(record.U32());
+    row[kType] = static_cast<int32_t>(record.U32());
+    uint32_t documents = record.U32();
+    // Each document takes at least 28 bytes, which bounds a corrupt count.
+    if (!record.ok() || documents > record_size / 28) {
+      return nullptr;
+    }
+    row[kFirstDocument] = static_cast<int32_t>(snapshot->docs.rows());
+    row[kDocumentCount] = static_cast<int32_t>(documents);
+    for (uint32_t document = 0; document < documents; document++) {
+      int32_t* doc = snapshot->docs.row(snapshot->docs.AddRow());
+      for (int field = kDocumentId; field < kDocumentStride; field++) {
+        doc[field] = record.String(&strings);
+      }
+    }
+    if (!record.ok() || row[kId] == StringTable::kNull) {
+      return nullptr;
+    }
+  }
+  return snapshot;
+}
+
+bool RequestListCache::Merge(const std::string& server,
+                             const std::string& state,
+                             const ResponseParser& page,
+                             RequestListMergeStats* stats) {
+  const RecordTable* list = FindTable(page, "list");
+  const RecordTable* requests = FindTable(page, "requests");
+  const RecordTable* docs = FindTable(page, "docs");
+  if (!list || !requests || !docs || list->rows() != 1 || page.has_error() ||
+      page.has_syntax_error() || page.has_proxy_error()) {
+    return false;
+  }
+  RequestListMergeStats merge_stats;
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string path = PathFor(server, state);
+
+  // Where each cached record is, by request id.
+  CacheFile file;
+  bool appending = ReadHeader(path, &file);
+  std::map<std::string_view, std::pair<uint32_t, uint32_t>> cached;
+  if (appending) {
+    Reader index(file.mapped->data() + file.header.index_offset,
+                 file.header.index_size);
+    StringTable ignored;
+    index.String(&ignored);
+    for (uint32_t i = 0; i < file.header.record_count && index.ok(); i++) {
+      uint32_t offset = index.U32();
+      uint32_t size = index.U32();
+      if (!index.ok() || offset > file.mapped->size() ||
+          size > file.mapped->size() - offset) {
+        appending = false;
+        break;
+      }
+      std::string_view id =
+          Reader(file.mapped->data() + offset, size).PeekString();
+      cached[id] = {offset, size};
+    }
+  }
+
+  using namespace request_list;
+  using namespace sign_request_document;
+  Encoder encoder(page.strings());
+  const std::vector<int32_t>& cells = requests->cells();
+  const std::vector<int32_t>& doc_cells = docs->cells();
+  // Every record of the page, encoded, and where the unchanged ones already
+  // are.
+  std::vector<std::string> records(requests->rows());
+  std::vector<int64_t> kept_offsets(requests->rows(), -1);
+  size_t live_bytes = 0;
+  for (size_t row = 0; row < requests->rows(); row++) {
+    const int32_t* fields = cells.data() + row * kRequestStride;
+    std::string& record = records[row];
+    for (int field = kId; field <= kPriority; field++) {
+      encoder.String(&record, fields[field]);
+    }
+    PutU32(&record, static_cast<uint32_t>(fields[kWorkflow]));
+    PutU32(&record, static_cast<uint32_t>(fields[kForward]));
+    PutU32(&record, static_cast<uint32_t>(fields[kType]));
+    int32_t first = fields[kFirstDocument];
+    int32_t count = fields[kDocumentCount];
+    PutU32(&record, static_cast<uint32_t>(count));
+    for (int32_t doc = first; doc < first + count; doc++) {
+      for (int field = kDocumentId; field < kDocumentStride; field++) {
+        encoder.String(&record, doc_cells[doc * kDocumentStride + field]);
+      }
+    }
+    live_bytes += record.size();
+    auto cached_it = cached.find(encoder.View(fields[kId]));
+    if (cached_it != cached.end() &&
+        cached_it->second.second == record.size() &&
+        std::memcmp(file.mapped->data() + cached_it->second.first,
+                    record.data(), record.size()) == 0) {
+      kept_offsets[row] = cached_it->second.first;
+    }
+  }
+
+  // Appended after the current end, or rewritten from scratch when there is
+  // no usable file yet or the stale records would make it grow well beyond
+  // the live ones.
+  uint32_t end = appending ? file.header.index_offset + file.header.index_size
+                           : static_cast<uint32_t>(kHeaderSize);
+  uint64_t appended_bytes = 0;
+  for (size_t row = 0; row < records.size(); row++) {
+    if (!appending || kept_offsets[row] < 0) {
+      appended_bytes += records[row].size();
+    }
+  }
+  if (appending &&
+      end - kHeaderSize + appended_bytes > kCompactionRatio * live_bytes +
+                                               64 * 1024) {
+    appending = false;
+    end = static_cast<uint32_t>(kHeaderSize);
+    merge_stats.compacted = true;
+  }
+
+  std::string appended;
+  std::string index;
+  encoder.String(&index, list->cells()[kTotal]);
+  for (size_t row = 0; row < records.size(); row++) {
+    uint32_t size = static_cast<uint32_t>(records[row].size());
+    if (appending && kept_offsets[row] >= 0) {
+      PutU32(&index, static_cast<uint32_t>(kept_offsets[row]));
+      merge_stats.kept++;
+    }
+    else {
+      PutU32(&index, end + static_cast<uint32_t>(appended.size()));
+      appended.append(records[row]);
+      merge_stats.written++;
+    }
+    PutU32(&index, size);
+  }
+  if (stats) {
+    *stats = merge_stats;
+  }
+  if (appending && appended.empty() &&
+      file.header.index_size == index.size() &&
+      std::memcmp(file.mapped->data() + file.header.index_offset,
+                  index.data(), index.size()) == 0) {
+    // Nothing changed.
+    return true;
+  }
+  if (static_cast<uint64_t>(end) + appended.size() + index.size() >
+      0xffffffffull) {
+    return false;
+  }
+  Header header;
+  header.index_offset = end + static_cast<uint32_t>(appended.size());
+  header.index_size = static_cast<uint32_t>(index.size());
+  header.record_count = static_cast<uint32_t>(records.size());
+  header.index_checksum =
+      Checksum(reinterpret_cast<const uint8_t*>(index.data()), index.size());
+  header.live_bytes = static_cast<uint32_t>(live_bytes);
+  // Nothing below may read the old file.
+  file.mapped.reset();
+
+  bool ok;
+  std::filesystem::path file_path = std::filesystem::u8path(path);
+  if (appending) {
+    std::FILE* out = OpenFile(file_path, "r+b");
+    ok = out && WriteAt(out, end, appended + index) &&
+         std::fflush(out) == 0 && WriteAt(out, 0, EncodeHeader(header));
+    if (out) {
+      ok = std::fclose(out) == 0 && ok;
+    }
+  }
+  else {
+    // Written aside and renamed over the old file, which stays intact until
+    // the new one is complete.
+    std::filesystem::path temporary = file_path;
+    temporary += ".tmp";
+    std::FILE* out = OpenFile(temporary, "wb");
+    ok = out && WriteAt(out, 0, EncodeHeader(header) + appended + index);
+    if (out) {
+      ok = std::fclose(out) == 0 && ok;
+    }
+    std::error_code error;
+    if (ok) {
+      std::filesystem::rename(temporary, file_path, error);
+      ok = !error;
+    }
+    if (!ok) {
+      std::filesystem::remove(temporary, error);
+    }
+  }
+  return ok;
+}
+
+void RequestListCache::Remove(const std::string& server,
+                              const std::string& state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::u8path(PathFor(server, state)),
+                          error);
+}
+
+std::string RequestListCache::PathFor(const std::string& server,
+                                      const std::string& state) const {
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx",
+                static_cast<unsigned long long>(Hash64(server)));
+  std::string name = "requests-";
+  name.append(hash).append("-");
+  for (char c : state) {
+    name.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+  }
+  name.append(".cache");
+  return directory_ + "/" + name;
+}
+
+}  // namespace native_core
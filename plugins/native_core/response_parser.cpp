@@ -0,0 +1,143 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/response_parser.h"
+
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+// Api._getResponseBody looks for <err> with findAllElements, which matches
+// the local name exactly.
+bool IsProxyErrorElement(const std::string& name) {
+  size_t colon = name.rfind(':');
+  std::string_view local =
+      colon == std::string::npos
+          ? std::string_view(name)
+          : std::string_view(name).substr(colon + 1);
+  return local == "err";
+}
+
+}  // namespace
+
+int32_t StringTable::Add(std::string_view value) {
+  bytes_.append(value.data(), value.size());
+  ends_.push_back(static_cast<int32_t>(bytes_.size()));
+  return static_cast<int32_t>(ends_.size() - 1);
+}
+
+RecordTable::RecordTable(std::string name, size_t stride)
+    : name_(std::move(name)), stride_(stride) {}
+
+int32_t RecordTable::AddRow() {
+  int32_t index = static_cast<int32_t>(rows());
+  cells_.resize(cells_.size() + stride_, -1);
+  return index;
+}
+
+ResponseParser::ResponseParser(size_t record_depth)
+    : record_depth_(record_depth) {}
+
+ResponseParser::~ResponseParser() = default;
+
+void ResponseParser::Feed(const char* data, size_t size) {
+  if (has_syntax_error()) {
+    return;
+  }
+  xml_.Feed(data, size);
+  Pump();
+}
+
+void ResponseParser::Finish() {
+  if (has_syntax_error()) {
+    return;
+  }
+  xml_.Finish();
+  Pump();
+  if (!has_syntax_error()) {
+    OnEnd();
+  }
+}
+
+void ResponseParser::SetError(std::string message) {
+  if (error_.empty()) {
+    error_ = std::move(message);
+  }
+  gathering_ = false;
+}
+
+RecordTable* ResponseParser::AddTable(std::string name, size_t stride) {
+  tables_.push_back(std::make_unique<RecordTable>(std::move(name), stride));
+  return tables_.back().get();
+}
+
+void ResponseParser::Pump() {
+  while (true) {
+    switch (xml_.Next()) {
+      case XmlPullParser::Event::kNeedMoreData:
+      case XmlPullParser::Event::kEndDocument:
+        return;
+      case XmlPullParser::Event::kError:
+        syntax_error_ = xml_.error();
+        return;
+      case XmlPullParser::Event::kStartElement:
+        if (!has_proxy_error_ && IsProxyErrorElement(xml_.name())) {
+          has_proxy_error_ = true;
+          proxy_error_depth_ = xml_.depth();
+        }
+        if (xml_.depth() == 1) {
+          OnRoot(xml_);
+        }
+        if (has_error()) {
+          break;
+        }
+        if (!gathering_ && xml_.depth() == record_depth_) {
+          record_.Clear();
+          gathering_ = true;
+        }
+        if (gathering_) {
+          record_.StartElement(xml_);
+        }
+        break;
+      case XmlPullParser::Event::kText:
+        if (proxy_error_depth_ != 0) {
+          proxy_error_ += xml_.text();
+        }
+        if (gathering_) {
+          record_.AddText(xml_.text());
+        }
+        break;
+      case XmlPullParser::Event::kOther:
+        if (gathering_) {
+          record_.AddOther();
+        }
+        break;
+      case XmlPullParser::Event::kEndElement:
+        if (proxy_error_depth_ == xml_.depth() + 1) {
+          proxy_error_depth_ = 0;
+        }
+        if (gathering_) {
+          record_.EndElement();
+          if (xml_.depth() + 1 == record_depth_) {
+            gathering_ = false;
+            OnRecord(record_);
+          }
+        }
+        break;
+    }
+  }
+}
+
+}  // namespace native_core
@@ -0,0 +1,83 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/runtime.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include "include/native_core/message_window_wakeup.h"
+#else
+#include "include/native_core/eventfd_wakeup.h"
+#endif
+
+namespace native_core {
+
+namespace {
+
+// Signing and file work is mostly waiting on devices and disks, a couple of
+// threads are plenty and keep smart card drivers from being hammered.
+constexpr size_t kMinWorkers = 2;
+constexpr size_t kMaxWorkers = 4;
+
+// Tasks allowed to wait for a worker before TryPost() starts refusing.
+constexpr size_t kQueueCapacity = 64;
+
+size_t WorkerCount() {
+  size_t cores = std::thread::hardware_concurrency();
+  return std::clamp(cores / 2, kMinWorkers, kMaxWorkers);
+}
+
+}  // namespace
+
+// static
+Runtime& Runtime::Get() {
+  // Intentionally leaked: plugins may still post completions while the
+  // process is being torn down.
+  static Runtime* runtime = new Runtime();
+  return *runtime;
+}
+
+Runtime::Runtime() {
+#ifdef _WIN32
+  wakeup_ = std::make_unique<MessageWindowWakeup>(
+      [this]() { dispatcher_->Drain(); });
+#else
+  // Hosts without a window loop wait on the eventfd and drain themselves.
+  wakeup_ = std::make_unique<EventFdWakeup>();
+#endif
+  dispatcher_ = std::make_unique<PlatformDispatcher>(wakeup_.get());
+  pool_ = std::make_unique<WorkerPool>(WorkerCount(), kQueueCapacity);
+}
+
+Runtime::~Runtime() {}
+
+bool Runtime::RunAsync(std::function<void()> work,
+                       std::function<void(bool cancelled)> done,
+                       CancellationToken token) {
+  PlatformDispatcher* dispatcher = dispatcher_.get();
+  return pool_->TryPost([dispatcher, work = std::move(work),
+                         done = std::move(done), token]() {
+    if (!token.IsCancelled()) {
+      work();
+    }
+    if (done) {
+      bool cancelled = token.IsCancelled();
+      dispatcher->Post([done, cancelled]() { done(cancelled); });
+    }
+  });
+}
+
+}  // namespace native_core
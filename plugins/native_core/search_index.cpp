@@ -0,0 +1,491 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/search_index.h"
+
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "include/native_core/proxy_response_parsers.h"
+
+namespace native_core {
+
+namespace {
+
+// Replacements for U+00C0 to U+00FF, the letters of Latin-1: the unaccented
+// lower-case letter, or 0 to keep the character. Upper-case letters without
+// an unaccented form (Æ, Ð, Þ) are lower-cased separately.
+constexpr char kLatin1Folds[64] = {
+    // À Á Â Ã Ä Å Æ Ç
+    'a', 'a', 'a', 'a', 'a', 'a', 0, 'c',
+    // È É Ê Ë Ì Í Î Ï
+    'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+    // Ð Ñ Ò Ó Ô Õ Ö ×
+    0, 'n', 'o', 'o', 'o', 'o', 'o', 0,
+    // Ø Ù Ú Û Ü Ý Þ ß
+    'o', 'u', 'u', 'u', 'u', 'y', 0, 0,
+    // à á â ã ä å æ ç
+    'a', 'a', 'a', 'a', 'a', 'a', 0, 'c',
+    // è é ê ë ì í î ï
+    'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+    // ð ñ ò ó ô õ ö ÷
+    0, 'n', 'o', 'o', 'o', 'o', 'o', 0,
+    // ø ù ú û ü ý þ ÿ
+    'o', 'u', 'u', 'u', 'u', 'y', 0, 'y',
+};
+
+// Length of the UTF-8 sequence starting with |lead|; 1 for stray bytes.
+size_t SequenceLength(uint8_t lead) {
+  if (lead >= 0xf0 && lead < 0xf8) {
+    return 4;
+  }
+  if (lead >= 0xe0) {
+    return lead < 0xf0 ? 3 : 1;
+  }
+  return lead >= 0xc0 ? 2 : 1;
+}
+
+// Whether the character at the start of |sequence|, of |length| bytes, in
+// folded text separates words: ASCII other than letters and digits, the
+// symbols and punctuation of Latin-1 (¡, ¿, «, », ×, ÷...) and the general
+// punctuation block (dashes, typographic quotes...).
+bool IsSeparator(const uint8_t* sequence, size_t length) {
+  uint8_t lead = sequence[0];
+  if (length == 1) {
+    return lead < 0x80 && !(lead >= 'a' && lead <= 'z') &&
+           !(lead >= '0' && lead <= '9');
+  }
+  if (length == 2) {
+    return lead == 0xc2 ||
+           (lead == 0xc3 && (sequence[1] == 0x97 || sequence[1] == 0xb7));
+  }
+  return length == 3 && lead == 0xe2 && (sequence[1] == 0x80 ||
+                                         sequence[1] == 0x81);
+}
+
+// Calls |on_word| with each word of |folded|, the output of FoldForSearch().
+template <typename OnWord>
+void ForEachWord(std::string_view folded, OnWord on_word) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(folded.data());
+  size_t size = folded.size();
+  size_t start = 0;
+  size_t position = 0;
+  while (position < size) {
+    size_t length = std::min(SequenceLength(bytes[position]), size - position);
+    if (IsSeparator(bytes + position, length)) {
+      if (position > start) {
+        on_word(folded.substr(start, position - start));
+      }
+      start = position + length;
+    }
+    position += length;
+  }
+  if (size > start) {
+    on_word(folded.substr(start));
+  }
+}
+
+std::string_view View(const StringTable& strings, int32_t index) {
+  if (index < 0 || static_cast<size_t>(index) >= strings.size()) {
+    return std::string_view();
+  }
+  size_t start = index == 0 ? 0 : strings.ends()[index - 1];
+  return std::string_view(strings.bytes())
+      .substr(start, strings.ends()[index] - start);
+}
+
+const RecordTable* FindTable(const ResponseParser& page,
+                             std::string_view name) {
+  for (const auto& table : page.tables()) {
+    if (table->name() == name) {
+      return table.get();
+    }
+  }
+  return nullptr;
+}
+
+// Position of the lowest set bit of |bits|, which is not zero.
+size_t LowestBit(uint64_t bits) {
+  return std::bitset<64>((bits & (~bits + 1)) - 1).count();
+}
+
+// Sets bit |number|, growing |bits| as needed.
+void SetBit(std::vector<uint64_t>* bits, uint32_t number) {
+  if (bits->size() <= number >> 6) {
+    bits->resize((number >> 6) + 1);
+  }
+  (*bits)[number >> 6] |= uint64_t{1} << (number & 63);
+}
+
+constexpr uint32_t kRemoved = std::numeric_limits<uint32_t>::max();
+
+// Replaced requests tolerated before renumbering, besides outnumbering the
+// live ones.
+constexpr size_t kMinStaleRequests = 1024;
+
+// Words added since the segment was rebuilt that are tolerated before
+// rebuilding it again. Queries go through every recent word a query word is
+// a prefix of, so this bounds their cost.
+constexpr size_t kMaxRecentTerms = 4096;
+
+}  // namespace
+
+std::string FoldForSearch(std::string_view text) {
+  std::string folded;
+  folded.reserve(text.size());
+  const auto* bytes = reinterpret_cast<const uint8_t*>(text.data());
+  for (size_t i = 0; i < text.size(); i++) {
+    uint8_t byte = bytes[i];
+    if (byte >= 'A' && byte <= 'Z') {
+      folded.push_back(static_cast<char>(byte - 'A' + 'a'));
+    }
+    else if (byte == 0xc3 && i + 1 < text.size() && bytes[i + 1] >= 0x80 &&
+             bytes[i + 1] < 0xc0) {
+      uint8_t next = bytes[++i];
+      char fold = kLatin1Folds[next - 0x80];
+      if (fold) {
+        folded.push_back(fold);
+      }
+      else {
+        // Æ, Ð and Þ are 0x20 below their lower-case forms.
+        bool upper = next == 0x86 || next == 0x90 || next == 0x9e;
+        folded.push_back(static_cast<char>(byte));
+        folded.push_back(static_cast<char>(upper ? next + 0x20 : next));
+      }
+    }
+    else {
+      folded.push_back(static_cast<char>(byte));
+    }
+  }
+  return folded;
+}
+
+bool SearchIndex::AddRequestList(std::string_view state,
+                                 const ResponseParser& page) {
+  const RecordTable* requests = FindTable(page, "requests");
+  const RecordTable* docs = FindTable(page, "docs");
+  if (!requests || !docs || !FindTable(page, "list") || page.has_error() ||
+      page.has_syntax_error() || page.has_proxy_error()) {
+    return false;
+  }
+  AddRequestList(state, page.strings(), *requests, *docs);
+  return true;
+}
+
+void SearchIndex::AddRequestList(std::string_view state,
+                                 const StringTable& strings,
+                                 const RecordTable& requests,
+                                 const RecordTable& docs) {
+  using namespace request_list;
+  using namespace sign_request_document;
+  const std::vector<int32_t>& cells = requests.cells();
+  const std::vector<int32_t>& doc_cells = docs.cells();
+  std::vector<std::string_view> texts;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t row = 0; row < requests.rows(); row++) {
+    const int32_t* fields = cells.data() + row * kRequestStride;
+    std::string_view id = View(strings, fields[kId]);
+    if (id.empty()) {
+      continue;
+    }
+    texts.assign({id, View(strings, fields[kSubject]),
+                  View(strings, fields[kSender])});
+    int32_t first = fields[kFirstDocument];
+    int32_t count = fields[kDocumentCount];
+    for (int32_t doc = first; doc >= 0 && doc < first + count; doc++) {
+      if (static_cast<size_t>(doc) < docs.rows()) {
+        texts.push_back(View(strings, doc_cells[doc * kDocumentStride + kName]));
+      }
+    }
+    AddLocked(id, state, texts);
+  }
+}
+
+void SearchIndex::Add(std::string_view id,
+                      std::string_view state,
+                      const std::vector<std::string_view>& texts) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AddLocked(id, state, texts);
+}
+
+void SearchIndex::Remove(std::string_view id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RemoveLocked(id);
+  CompactLocked();
+}
+
+void SearchIndex::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_.clear();
+  live_requests_ = 0;
+  numbers_.clear();
+  states_.clear();
+  state_bits_.clear();
+  segment_ = Segment();
+  recent_terms_.clear();
+  terms_ = 0;
+  postings_ = 0;
+}
+
+SearchResult SearchIndex::Query(std::string_view text,
+                                std::string_view state,
+                                size_t limit) const {
+  SearchResult result;
+  std::string folded = FoldForSearch(text);
+  std::vector<std::string_view> words;
+  ForEachWord(folded, [&](std::string_view word) { words.push_back(word); });
+  if (words.empty()) {
+    return result;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // One bit per request number: the live requests in |state| (or in any),
+  // narrowed down to those matching each word in turn.
+  size_t bitmap_words = (requests_.size() + 63) / 64;
+  std::vector<uint64_t> matched(bitmap_words);
+  if (state.empty()) {
+    for (const std::vector<uint64_t>& bits : state_bits_) {
+      for (size_t w = 0; w < bits.size(); w++) {
+        matched[w] |= bits[w];
+      }
+    }
+  }
+  else {
+    auto state_it = std::find(states_.begin(), states_.end(), state);
+    if (state_it == states_.end()) {
+      return result;
+    }
+    const std::vector<uint64_t>& bits =
+        state_bits_[state_it - states_.begin()];
+    std::copy(bits.begin(), bits.end(), matched.begin());
+  }
+
+  std::vector<uint64_t> current(bitmap_words);
+  for (std::string_view word : words) {
+    std::fill(current.begin(), current.end(), 0);
+    // The words starting with |word| are a range of the segment, and so are
+    // their numbers.
+    auto [first, last] = segment_.PrefixRange(word);
+    const uint32_t* numbers = segment_.numbers.data();
+    uint64_t* bits = current.data();
+    for (uint32_t i = segment_.NumbersBegin(first);
+         i < segment_.NumbersBegin(last); i++) {
+      bits[numbers[i] >> 6] |= uint64_t{1} << (numbers[i] & 63);
+    }
+    for (auto it = recent_terms_.lower_bound(word);
+         it != recent_terms_.end() &&
+         it->first.compare(0, word.size(), word) == 0;
+         ++it) {
+      for (uint32_t number : it->second) {
+        bits[number >> 6] |= uint64_t{1} << (number & 63);
+      }
+    }
+    for (size_t w = 0; w < bitmap_words; w++) {
+      matched[w] &= current[w];
+    }
+  }
+
+  for (size_t w = 0; w < bitmap_words; w++) {
+    uint64_t bits = matched[w];
+    result.total += std::bitset<64>(bits).count();
+    for (; bits && result.ids.size() < limit; bits &= bits - 1) {
+      result.ids.push_back(requests_[w * 64 + LowestBit(bits)].id);
+    }
+  }
+  return result;
+}
+
+SearchIndexStats SearchIndex::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SearchIndexStats stats;
+  stats.requests = live_requests_;
+  stats.terms = terms_;
+  stats.postings = postings_;
+  return stats;
+}
+
+std::string_view SearchIndex::Segment::Word(size_t index) const {
+  size_t start = index == 0 ? 0 : word_ends[index - 1];
+  return std::string_view(words).substr(start, word_ends[index] - start);
+}
+
+uint32_t SearchIndex::Segment::NumbersBegin(size_t index) const {
+  return index == 0 ? 0 : number_ends[index - 1];
+}
+
+std::pair<size_t, size_t> SearchIndex::Segment::PrefixRange(
+    std::string_view prefix) const {
+  size_t first = 0;
+  size_t count = word_ends.size();
+  // Words before the range compare less than |prefix|, and words in it
+  // compare equal once cut to its length.
+  while (count > 0) {
+    size_t step = count / 2;
+    if (Word(first + step) < prefix) {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else {
+      count = step;
+    }
+  }
+  size_t last = first;
+  count = word_ends.size() - first;
+  while (count > 0) {
+    size_t step = count / 2;
+    if (Word(last + step).substr(0, prefix.size()) == prefix) {
+      last += step + 1;
+      count -= step + 1;
+    }
+    else {
+      count = step;
+    }
+  }
+  return {first, last};
+}
+
+void SearchIndex::AddLocked(std::string_view id,
+                            std::string_view state,
+                            const std::vector<std::string_view>& texts) {
+  RemoveLocked(id);
+  auto state_it = std::find(states_.begin(), states_.end(), state);
+  if (state_it == states_.end()) {
+    state_it = states_.emplace(states_.end(), state);
+    state_bits_.emplace_back();
+  }
+  auto state_number = static_cast<uint32_t>(state_it - states_.begin());
+  auto number = static_cast<uint32_t>(requests_.size());
+  requests_.push_back({std::string(id), state_number});
+  SetBit(&state_bits_[state_number], number);
+  live_requests_++;
+  numbers_[std::string(id)] = number;
+
+  // Numbers only grow, so appending keeps every list in order; a word that
+  // appears twice in the request is only added once.
+  for (std::string_view text : texts) {
+    std::string folded = FoldForSearch(text);
+    ForEachWord(folded, [&](std::string_view word) {
+      auto it = recent_terms_.lower_bound(word);
+      if (it == recent_terms_.end() || it->first != word) {
+        it = recent_terms_.emplace_hint(it, std::string(word),
+                                        std::vector<uint32_t>());
+        auto [first, last] = segment_.PrefixRange(word);
+        if (first == last || segment_.Word(first) != word) {
+          terms_++;
+        }
+      }
+      if (it->second.empty() || it->second.back() != number) {
+        it->second.push_back(number);
+        postings_++;
+      }
+    });
+  }
+  if (recent_terms_.size() > kMaxRecentTerms) {
+    MergeLocked(nullptr);
+  }
+  CompactLocked();
+}
+
+void SearchIndex::RemoveLocked(std::string_view id) {
+  auto it = numbers_.find(std::string(id));
+  if (it == numbers_.end()) {
+    return;
+  }
+  uint32_t number = it->second;
+  state_bits_[requests_[number].state][number >> 6] &=
+      ~(uint64_t{1} << (number & 63));
+  live_requests_--;
+  numbers_.erase(it);
+}
+
+void SearchIndex::CompactLocked() {
+  size_t stale = requests_.size() - live_requests_;
+  if (stale < kMinStaleRequests || stale <= live_requests_) {
+    return;
+  }
+  std::vector<uint32_t> renumbered(requests_.size(), kRemoved);
+  std::vector<Request> live;
+  live.reserve(live_requests_);
+  for (std::vector<uint64_t>& bits : state_bits_) {
+    bits.clear();
+  }
+  for (const auto& [id, number] : numbers_) {
+    renumbered[number] = 0;
+  }
+  for (size_t number = 0; number < requests_.size(); number++) {
+    if (renumbered[number] != kRemoved) {
+      auto new_number = static_cast<uint32_t>(live.size());
+      renumbered[number] = new_number;
+      numbers_[requests_[number].id] = new_number;
+      SetBit(&state_bits_[requests_[number].state], new_number);
+      live.push_back(std::move(requests_[number]));
+    }
+  }
+  requests_ = std::move(live);
+  MergeLocked(&renumbered);
+}
+
+void SearchIndex::MergeLocked(const std::vector<uint32_t>* renumbered) {
+  Segment merged;
+  merged.words.reserve(segment_.words.size());
+  merged.word_ends.reserve(segment_.word_ends.size() + recent_terms_.size());
+  merged.number_ends.reserve(merged.word_ends.capacity());
+  merged.numbers.reserve(postings_);
+  auto append = [&](const uint32_t* numbers, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      uint32_t number = renumbered ? (*renumbered)[numbers[i]] : numbers[i];
+      if (number != kRemoved) {
+        merged.numbers.push_back(number);
+      }
+    }
+  };
+
+  // Both are sorted; a word in both keeps its older numbers first.
+  size_t index = 0;
+  auto recent = recent_terms_.begin();
+  while (index < segment_.word_ends.size() || recent != recent_terms_.end()) {
+    std::string_view word;
+    size_t numbers_before = merged.numbers.size();
+    bool from_segment = index < segment_.word_ends.size() &&
+                        (recent == recent_terms_.end() ||
+                         segment_.Word(index) <= recent->first);
+    if (from_segment) {
+      word = segment_.Word(index);
+      uint32_t begin = segment_.NumbersBegin(index);
+      append(segment_.numbers.data() + begin,
+             segment_.number_ends[index] - begin);
+      index++;
+    }
+    if (recent != recent_terms_.end() &&
+        (!from_segment || word == recent->first)) {
+      word = recent->first;
+      append(recent->second.data(), recent->second.size());
+      ++recent;
+    }
+    if (merged.numbers.size() > numbers_before) {
+      merged.words.append(word);
+      merged.word_ends.push_back(static_cast<uint32_t>(merged.words.size()));
+      merged.number_ends.push_back(
+          static_cast<uint32_t>(merged.numbers.size()));
+    }
+  }
+  segment_ = std::move(merged);
+  recent_terms_.clear();
+  terms_ = segment_.word_ends.size();
+  postings_ = segment_.numbers.size();
+}
+
+}  // namespace native_core
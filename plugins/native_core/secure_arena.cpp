@@ -0,0 +1,258 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/secure_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace native_core {
+
+namespace internal {
+
+struct SecureBlock {
+  // The block filled before this one in the same arena, or the next free
+  // block in the pool.
+  SecureBlock* previous;
+  // Bytes of the block and bytes handed out, header included.
+  size_t size;
+  size_t used;
+  bool locked;
+  // Whether the block has pages of its own instead of coming from the pool.
+  bool large;
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::SecureBlock;
+
+constexpr size_t kAlignment = 16;
+constexpr size_t kHeaderSize =
+    (sizeof(SecureBlock) + kAlignment - 1) / kAlignment * kAlignment;
+
+// Blocks taken from the system at once, so that the pool locks and maps
+// pages in runs rather than one by one.
+constexpr size_t kBlocksPerChunk = 16;
+
+// SecureArenaStats, as they are counted.
+struct Counters {
+  std::atomic<uint64_t> arenas{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> large_allocations{0};
+  std::atomic<uint64_t> blocks{0};
+  std::atomic<uint64_t> blocks_in_use{0};
+  std::atomic<uint64_t> locked_bytes{0};
+} counters;
+
+size_t RoundUp(size_t size, size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+size_t PageSize() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Returns |size| bytes of zeroed pages, locked in RAM if the limits of the
+// process allow it, or null.
+void* MapPages(size_t size, bool* locked) {
+#ifdef _WIN32
+  void* pages =
+      VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (!pages) {
+    return nullptr;
+  }
+  *locked = VirtualLock(pages, size) != 0;
+#else
+  void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    return nullptr;
+  }
+  *locked = mlock(pages, size) == 0;
+#ifdef MADV_DONTDUMP
+  madvise(pages, size, MADV_DONTDUMP);
+#endif
+#endif
+  if (*locked) {
+    counters.locked_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  return pages;
+}
+
+void UnmapPages(void* pages, size_t size, bool locked) {
+  if (locked) {
+    counters.locked_bytes.fetch_sub(size, std::memory_order_relaxed);
+  }
+#ifdef _WIN32
+  if (locked) {
+    VirtualUnlock(pages, size);
+  }
+  VirtualFree(pages, 0, MEM_RELEASE);
+#else
+  if (locked) {
+    munlock(pages, size);
+  }
+  munmap(pages, size);
+#endif
+}
+
+// The blocks not in use, which are kept for the life of the process.
+class BlockPool {
+ public:
+  static BlockPool& Get() {
+    // Leaked, as arenas may still be released while the process exits.
+    static BlockPool* pool = new BlockPool();
+    return *pool;
+  }
+
+  // Returns a cleared block, or null if the system is out of memory.
+  SecureBlock* Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_ && !Grow()) {
+      return nullptr;
+    }
+    SecureBlock* block = free_;
+    free_ = block->previous;
+    block->previous = nullptr;
+    counters.blocks_in_use.fetch_add(1, std::memory_order_relaxed);
+    return block;
+  }
+
+  // Takes back |block|, already cleared.
+  void Give(SecureBlock* block) {
+    block->used = kHeaderSize;
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->previous = free_;
+    free_ = block;
+    counters.blocks_in_use.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+ private:
+  BlockPool() = default;
+
+  bool Grow() {
+    bool locked = false;
+    auto* chunk = static_cast<uint8_t*>(
+        MapPages(SecureArena::kBlockSize * kBlocksPerChunk, &locked));
+    if (!chunk) {
+      return false;
+    }
+    for (size_t i = 0; i < kBlocksPerChunk; i++) {
+      auto* block =
+          reinterpret_cast<SecureBlock*>(chunk + i * SecureArena::kBlockSize);
+      *block = {free_, SecureArena::kBlockSize, kHeaderSize, locked, false};
+      free_ = block;
+    }
+    counters.blocks.fetch_add(kBlocksPerChunk, std::memory_order_relaxed);
+    return true;
+  }
+
+  std::mutex mutex_;
+  SecureBlock* free_ = nullptr;
+};
+
+// A block for an allocation of |size| bytes that no pooled block can hold.
+SecureBlock* TakeLargeBlock(size_t size) {
+  size_t block_size = RoundUp(kHeaderSize + size, PageSize());
+  bool locked = false;
+  auto* block = static_cast<SecureBlock*>(MapPages(block_size, &locked));
+  if (!block) {
+    return nullptr;
+  }
+  *block = {nullptr, block_size, kHeaderSize, locked, true};
+  counters.large_allocations.fetch_add(1, std::memory_order_relaxed);
+  return block;
+}
+
+}  // namespace
+
+SecureArenaStats GetSecureArenaStats() {
+  SecureArenaStats stats;
+  stats.arenas = counters.arenas.load(std::memory_order_relaxed);
+  stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+  stats.large_allocations =
+      counters.large_allocations.load(std::memory_order_relaxed);
+  stats.blocks = counters.blocks.load(std::memory_order_relaxed);
+  stats.blocks_in_use =
+      counters.blocks_in_use.load(std::memory_order_relaxed);
+  stats.locked_bytes = counters.locked_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void SecureZero(void* data, size_t size) {
+#ifdef _WIN32
+  SecureZeroMemory(data, size);
+#else
+  std::memset(data, 0, size);
+  // Tells the compiler the memory is read afterwards, so that the stores are
+  // kept.
+  __asm__ __volatile__("" : : "r"(data) : "memory");
+#endif
+}
+
+SecureArena::SecureArena() {
+  counters.arenas.fetch_add(1, std::memory_order_relaxed);
+}
+
+SecureArena::~SecureArena() {
+  counters.allocations.fetch_add(allocations_, std::memory_order_relaxed);
+  while (current_) {
+    SecureBlock* block = current_;
+    current_ = block->previous;
+    SecureZero(reinterpret_cast<uint8_t*>(block) + kHeaderSize,
+               block->used - kHeaderSize);
+    if (block->large) {
+      UnmapPages(block, block->size, block->locked);
+    }
+    else {
+      BlockPool::Get().Give(block);
+    }
+  }
+}
+
+uint8_t* SecureArena::Allocate(size_t size) {
+  size = RoundUp(std::max<size_t>(size, 1), kAlignment);
+  if (!current_ || current_->size - current_->used < size) {
+    SecureBlock* block = size <= kBlockSize - kHeaderSize
+                             ? BlockPool::Get().Take()
+                             : TakeLargeBlock(size);
+    if (!block) {
+      return nullptr;
+    }
+    block->previous = current_;
+    current_ = block;
+  }
+  uint8_t* memory = reinterpret_cast<uint8_t*>(current_) + current_->used;
+  current_->used += size;
+  allocations_++;
+  return memory;
+}
+
+}  // namespace native_core
@@ -0,0 +1,412 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/signing_journal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace native_core {
+
+namespace {
+
+// File layout. Numbers are little-endian; strings are a 32-bit length
+// followed by their bytes.
+//
+//   Header: "PFSJ" and the version (32 bits).
+//
+//   Records, back to back: payload size (32 bits), CRC-32 of the type and
+//   the payload, type (one byte) and payload. Both types start with the
+//   owner hash (64 bits) and the request id; kSigned follows them with the
+//   postsign body.
+constexpr char kMagic[4] = {'P', 'F', 'S', 'J'};
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kRecordHeaderSize = 9;
+
+enum RecordType : uint8_t {
+  kSigned = 1,
+  kPosted = 2,
+};
+
+uint32_t Crc32(const uint8_t* data, size_t size) {
+  static const std::array<uint32_t, 256> table = []() {
+    std::array<uint32_t, 256> values{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320u : 0);
+      }
+      values[i] = crc;
+    }
+    return values;
+  }();
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffu;
+}
+
+uint64_t OwnerHash(std::string_view owner) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : owner) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+void PutU32(std::string* out, uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out->push_back(static_cast<char>(value >> shift));
+  }
+}
+
+void PutU64(std::string* out, uint64_t value) {
+  for (int shift = 0; shift < 64; shift += 8) {
+    out->push_back(static_cast<char>(value >> shift));
+  }
+}
+
+void PutBytes(std::string* out, const void* data, size_t size) {
+  PutU32(out, static_cast<uint32_t>(size));
+  out->append(static_cast<const char*>(data), size);
+}
+
+// A record with its length and checksum in front.
+std::string EncodeRecord(RecordType type,
+                         uint64_t owner,
+                         std::string_view request_id,
+                         const std::vector<uint8_t>* body) {
+  std::string payload(1, static_cast<char>(type));
+  PutU64(&payload, owner);
+  PutBytes(&payload, request_id.data(), request_id.size());
+  if (body) {
+    PutBytes(&payload, body->data(), body->size());
+  }
+  std::string record;
+  record.reserve(kRecordHeaderSize + payload.size());
+  PutU32(&record, static_cast<uint32_t>(payload.size() - 1));
+  PutU32(&record, Crc32(reinterpret_cast<const uint8_t*>(payload.data()),
+                        payload.size()));
+  record.append(payload);
+  return record;
+}
+
+// Bounds-checked reads from a record payload.
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size) : data_(data), left_(size) {}
+
+  bool U32(uint32_t* value) {
+    if (left_ < 4) {
+      return false;
+    }
+    *value = 0;
+    for (int i = 3; i >= 0; i--) {
+      *value = (*value << 8) | data_[i];
+    }
+    Skip(4);
+    return true;
+  }
+
+  bool U64(uint64_t* value) {
+    if (left_ < 8) {
+      return false;
+    }
+    *value = 0;
+    for (int i = 7; i >= 0; i--) {
+      *value = (*value << 8) | data_[i];
+    }
+    Skip(8);
+    return true;
+  }
+
+  bool Take(size_t size, const uint8_t** data) {
+    if (left_ < size) {
+      return false;
+    }
+    *data = data_;
+    Skip(size);
+    return true;
+  }
+
+  bool Bytes(const uint8_t** data, size_t* size) {
+    uint32_t length;
+    if (!U32(&length) || !Take(length, data)) {
+      return false;
+    }
+    *size = length;
+    return true;
+  }
+
+ private:
+  void Skip(size_t size) {
+    data_ += size;
+    left_ -= size;
+  }
+
+  const uint8_t* data_;
+  size_t left_;
+};
+
+// Opens a file by its UTF-8 path.
+std::FILE* OpenFile(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                               : nullptr;
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+// Hands what was written to |file| to the system and waits for the disk.
+bool SyncFile(std::FILE* file) {
+  if (std::fflush(file) != 0) {
+    return false;
+  }
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Makes a rename in |directory| durable. Windows does it with the rename.
+void SyncDirectory([[maybe_unused]] const std::filesystem::path& directory) {
+#ifndef _WIN32
+  int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+}
+
+bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>* data) {
+  std::FILE* file = OpenFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data->insert(data->end(), buffer, buffer + read);
+  }
+  bool ok = !std::ferror(file);
+  std::fclose(file);
+  return ok;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<SigningJournal> SigningJournal::Open(const std::string& path) {
+  std::filesystem::path file_path = std::filesystem::u8path(path);
+
+  // Replays the valid records. Reading stops at the first record that is
+  // incomplete or fails its checksum, which is where a crash interrupted an
+  // append.
+  std::map<Key, Entry> pending;
+  uint64_t sequence = 0;
+  std::vector<uint8_t> contents;
+  if (ReadFile(file_path, &contents) && contents.size() >= kHeaderSize &&
+      std::memcmp(contents.data(), kMagic, sizeof(kMagic)) == 0) {
+    Reader header(contents.data() + sizeof(kMagic), 4);
+    uint32_t version = 0;
+    header.U32(&version);
+    Reader records(contents.data() + kHeaderSize,
+                   version == kVersion ? contents.size() - kHeaderSize : 0);
+    uint32_t payload_size;
+    uint32_t checksum;
+    const uint8_t* record;
+    while (records.U32(&payload_size) && records.U32(&checksum) &&
+           records.Take(size_t{payload_size} + 1, &record) &&
+           Crc32(record, size_t{payload_size} + 1) == checksum) {
+      Reader payload(record + 1, payload_size);
+      uint64_t owner;
+      const uint8_t* id;
+      size_t id_size;
+      const uint8_t* body = nullptr;
+      size_t body_size = 0;
+      if (!payload.U64(&owner) || !payload.Bytes(&id, &id_size) ||
+          (record[0] == kSigned && !payload.Bytes(&body, &body_size))) {
+        break;
+      }
+      Key key(owner, std::string(reinterpret_cast<const char*>(id), id_size));
+      if (record[0] == kSigned) {
+        Entry& entry = pending[key];
+        entry.sequence = sequence++;
+        entry.body.assign(body, body + body_size);
+      }
+      else {
+        pending.erase(key);
+      }
+    }
+  }
+
+  // Rewritten with only the pending requests, which also drops a torn
+  // record, and swapped in with a rename so that a crash meanwhile leaves
+  // one of the two whole.
+  std::vector<std::pair<uint64_t, const std::pair<const Key, Entry>*>> order;
+  for (const auto& item : pending) {
+    order.emplace_back(item.second.sequence, &item);
+  }
+  std::sort(order.begin(), order.end());
+  std::string rewritten(kMagic, sizeof(kMagic));
+  PutU32(&rewritten, kVersion);
+  for (const auto& [unused, item] : order) {
+    rewritten.append(EncodeRecord(kSigned, item->first.first,
+                                  item->first.second, &item->second.body));
+  }
+  std::filesystem::path temporary = file_path;
+  temporary += ".tmp";
+  std::FILE* file = OpenFile(temporary, "wb");
+  if (!file) {
+    return nullptr;
+  }
+  bool written = std::fwrite(rewritten.data(), 1, rewritten.size(), file) ==
+                     rewritten.size() &&
+                 SyncFile(file);
+  std::fclose(file);
+  std::error_code error;
+  if (!written ||
+      (std::filesystem::rename(temporary, file_path, error), error)) {
+    std::filesystem::remove(temporary, error);
+    return nullptr;
+  }
+  SyncDirectory(file_path.parent_path());
+
+  file = OpenFile(file_path, "ab");
+  if (!file) {
+    return nullptr;
+  }
+  std::unique_ptr<SigningJournal> journal(
+      new SigningJournal(file, std::move(pending)));
+  journal->next_sequence_ = sequence;
+  return journal;
+}
+
+SigningJournal::SigningJournal(std::FILE* file, std::map<Key, Entry> pending)
+    : file_(file), pending_(std::move(pending)), next_sequence_(0) {}
+
+SigningJournal::~SigningJournal() {
+  SyncFile(file_);
+  std::fclose(file_);
+}
+
+bool SigningJournal::RecordSigned(std::string_view owner,
+                                  std::string_view request_id,
+                                  const std::vector<uint8_t>& body) {
+  uint64_t hash = OwnerHash(owner);
+  if (!Append(EncodeRecord(kSigned, hash, request_id, &body), true)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = pending_[Key(hash, std::string(request_id))];
+  entry.sequence = next_sequence_++;
+  entry.body = body;
+  return true;
+}
+
+void SigningJournal::RecordPosted(std::string_view owner,
+                                  std::string_view request_id) {
+  uint64_t hash = OwnerHash(owner);
+  Append(EncodeRecord(kPosted, hash, request_id, nullptr), false);
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.erase(Key(hash, std::string(request_id)));
+}
+
+std::vector<JournaledPostsign> SigningJournal::Pending(
+    std::string_view owner) const {
+  uint64_t hash = OwnerHash(owner);
+  std::vector<std::pair<uint64_t, JournaledPostsign>> found;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = pending_.lower_bound(Key(hash, std::string()));
+         it != pending_.end() && it->first.first == hash; ++it) {
+      found.push_back({it->second.sequence, {it->first.second, it->second.body}});
+    }
+  }
+  std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+  std::vector<JournaledPostsign> postsigns;
+  postsigns.reserve(found.size());
+  for (auto& item : found) {
+    postsigns.push_back(std::move(item.second));
+  }
+  return postsigns;
+}
+
+SigningJournalStats SigningJournal::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SigningJournalStats stats = stats_;
+  stats.pending = pending_.size();
+  return stats;
+}
+
+bool SigningJournal::Append(const std::string& record, bool sync) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (std::fwrite(record.data(), 1, record.size(), file_) != record.size()) {
+    return false;
+  }
+  written_ += record.size();
+  stats_.records++;
+  uint64_t target = written_;
+  // Whoever finds no fsync() in progress runs one for everything written so
+  // far; the others wait for it and check whether it covered their record.
+  while (sync && durable_ < target) {
+    if (syncing_) {
+      synced_.wait(lock);
+      continue;
+    }
+    syncing_ = true;
+    uint64_t covered = written_;
+    if (std::fflush(file_) != 0) {
+      syncing_ = false;
+      synced_.notify_all();
+      return false;
+    }
+    lock.unlock();
+#ifdef _WIN32
+    bool ok = _commit(_fileno(file_)) == 0;
+#else
+    bool ok = fsync(fileno(file_)) == 0;
+#endif
+    lock.lock();
+    syncing_ = false;
+    if (ok) {
+      durable_ = std::max(durable_, covered);
+      stats_.syncs++;
+    }
+    synced_.notify_all();
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace native_core
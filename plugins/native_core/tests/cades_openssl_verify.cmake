@@ -0,0 +1,90 @@
+# Copyright 2022. Chema Molins.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Checks CAdES signatures with openssl cms -verify: the fixtures of
+# tests/data/cades, and new ones that cades_sign makes of the same documents
+# with every digest, detached and attached. Run by ctest, or by hand:
+#
+#   cmake -DOPENSSL=openssl -DCADES_SIGN=path/to/cades_sign
+#       -DDATA=tests/data -DWORK=/tmp/cades -P tests/cades_openssl_verify.cmake
+foreach(variable OPENSSL CADES_SIGN DATA WORK)
+  if(NOT DEFINED ${variable})
+    message(FATAL_ERROR "${variable} is not set")
+  endif()
+endforeach()
+
+set(key "${DATA}/file_key.pem")
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+
+# Verifies |signature|, of |content| or attached if it is empty, trusting the
+# test certificate. The attached content must come out as |expected|.
+function(verify signature content expected)
+  set(arguments cms -verify -binary -inform DER -in "${signature}"
+    -CAfile "${key}" -purpose any -out "${WORK}/content")
+  if(content)
+    list(APPEND arguments -content "${content}")
+  endif()
+  execute_process(COMMAND "${OPENSSL}" ${arguments}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${signature} does not verify:\n${output}")
+  endif()
+  execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files
+    "${WORK}/content" "${expected}" RESULT_VARIABLE different)
+  if(different)
+    message(FATAL_ERROR "${signature} carries other content")
+  endif()
+endfunction()
+
+verify("${DATA}/cades/document.txt.sha256.p7s" "${DATA}/cades/document.txt"
+  "${DATA}/cades/document.txt")
+verify("${DATA}/cades/document.txt.sha512.attached.p7s" ""
+  "${DATA}/cades/document.txt")
+verify("${DATA}/cades/bytes.bin.sha384.p7s" "${DATA}/cades/bytes.bin"
+  "${DATA}/cades/bytes.bin")
+verify("${DATA}/cades/bytes.bin.sha1.p7s" "${DATA}/cades/bytes.bin"
+  "${DATA}/cades/bytes.bin")
+
+foreach(document document.txt bytes.bin)
+  foreach(digest SHA-1 SHA-256 SHA-384 SHA-512)
+    set(content "${DATA}/cades/${document}")
+    set(detached "${WORK}/${document}.${digest}.p7s")
+    set(attached "${WORK}/${document}.${digest}.attached.p7s")
+    execute_process(COMMAND "${CADES_SIGN}" "${key}" "${content}" "${detached}"
+      ${digest} RESULT_VARIABLE result OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "cades_sign failed for ${document} with ${digest}")
+    endif()
+    execute_process(COMMAND "${CADES_SIGN}" "${key}" "${content}" "${attached}"
+      ${digest} --attached RESULT_VARIABLE result OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "cades_sign failed for ${document} with ${digest}")
+    endif()
+    verify("${detached}" "${content}" "${content}")
+    verify("${attached}" "" "${content}")
+  endforeach()
+endforeach()
+
+# A changed document must fail.
+file(READ "${DATA}/cades/document.txt" text)
+file(WRITE "${WORK}/changed.txt" "${text}.")
+execute_process(COMMAND "${OPENSSL}" cms -verify -binary -inform DER
+  -in "${DATA}/cades/document.txt.sha256.p7s" -content "${WORK}/changed.txt"
+  -CAfile "${key}" -purpose any -out "${WORK}/content"
+  RESULT_VARIABLE result OUTPUT_QUIET ERROR_QUIET)
+if(result EQUAL 0)
+  message(FATAL_ERROR "A changed document verifies")
+endif()
+file(REMOVE_RECURSE "${WORK}")
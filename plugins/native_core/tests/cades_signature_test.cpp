@@ -0,0 +1,261 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// CAdES signatures of the documents in tests/data/cades, checked against the
+// signatures next to them, which openssl cms -verify accepts (see
+// cades_openssl_verify.cmake), and verified with the OpenSSL CMS code. They
+// are signed with the key of tests/data/file_key.pem at kSigningTime, so the
+// same signature comes out every time. ctest passes the directory in
+// TEST_DATA and the key in TEST_KEY.
+#include <native_core/cades_signature.h>
+#include <native_core/digest.h>
+#include <native_core/file_key_signer.h>
+
+#include <openssl/bio.h>
+#include <openssl/cms.h>
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::BuildCadesSignature;
+using native_core::BuildDetachedCadesSignature;
+using native_core::CadesOptions;
+using native_core::DigestAlgorithm;
+using native_core::FileKeySigner;
+
+namespace {
+
+// 2022-06-01 12:00:00 UTC, the signing time of the fixtures.
+constexpr int64_t kSigningTime = 1654084800;
+
+// A fixture signature and what it signs.
+struct Fixture {
+  const char* content;
+  const char* signature;
+  DigestAlgorithm digest;
+  bool attached;
+};
+
+constexpr Fixture kFixtures[] = {
+    {"document.txt", "document.txt.sha256.p7s", DigestAlgorithm::kSha256,
+     false},
+    {"document.txt", "document.txt.sha512.attached.p7s",
+     DigestAlgorithm::kSha512, true},
+    {"bytes.bin", "bytes.bin.sha384.p7s", DigestAlgorithm::kSha384, false},
+    {"bytes.bin", "bytes.bin.sha1.p7s", DigestAlgorithm::kSha1, false},
+};
+
+std::vector<uint8_t> ReadFixture(const std::string& name) {
+  const char* directory = std::getenv("TEST_DATA");
+  std::ifstream file(std::string(directory ? directory : ".") + "/cades/" +
+                         name,
+                     std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+std::unique_ptr<FileKeySigner> OpenKey() {
+  const char* path = std::getenv("TEST_KEY");
+  std::string error;
+  return path ? FileKeySigner::Open(path, &error) : nullptr;
+}
+
+CadesOptions OptionsFor(DigestAlgorithm digest, bool attached) {
+  CadesOptions options;
+  options.digest = digest;
+  options.attached = attached;
+  options.signing_time = std::chrono::system_clock::time_point(
+      std::chrono::seconds(kSigningTime));
+  return options;
+}
+
+std::vector<uint8_t> Sign(FileKeySigner* signer,
+                          const std::vector<uint8_t>& content,
+                          const CadesOptions& options) {
+  std::vector<uint8_t> signature;
+  std::string error;
+  if (!BuildCadesSignature(signer, signer->Certificate(), content.data(),
+                           content.size(), options, &signature, &error)) {
+    signature.clear();
+  }
+  return signature;
+}
+
+// A parsed CMS structure.
+struct CmsDeleter {
+  void operator()(CMS_ContentInfo* cms) const { CMS_ContentInfo_free(cms); }
+};
+using Cms = std::unique_ptr<CMS_ContentInfo, CmsDeleter>;
+
+Cms Parse(const std::vector<uint8_t>& signature) {
+  const unsigned char* data = signature.data();
+  return Cms(d2i_CMS_ContentInfo(nullptr, &data,
+                                 static_cast<long>(signature.size())));
+}
+
+// Whether |signature| verifies as openssl cms -verify -binary does, trusting
+// the certificate it carries. |content| is the detached content, or null for
+// an attached signature, whose content goes to |attached|.
+bool Verifies(const std::vector<uint8_t>& signature,
+              const std::vector<uint8_t>* content,
+              std::vector<uint8_t>* attached = nullptr) {
+  Cms cms = Parse(signature);
+  if (!cms) {
+    return false;
+  }
+  STACK_OF(X509)* certificates = CMS_get1_certs(cms.get());
+  X509_STORE* store = X509_STORE_new();
+  for (int i = 0; i < sk_X509_num(certificates); i++) {
+    X509_STORE_add_cert(store, sk_X509_value(certificates, i));
+  }
+  // The test certificate has no key usage for S/MIME.
+  X509_STORE_set_purpose(store, X509_PURPOSE_ANY);
+  // An empty buffer still needs an address.
+  static const uint8_t kNothing = 0;
+  BIO* input = content ? BIO_new_mem_buf(
+                             content->empty() ? &kNothing : content->data(),
+                             static_cast<int>(content->size()))
+                       : nullptr;
+  BIO* output = BIO_new(BIO_s_mem());
+  bool ok = CMS_verify(cms.get(), nullptr, store, input, output,
+                       CMS_BINARY) == 1;
+  if (ok && attached) {
+    char* data = nullptr;
+    long size = BIO_get_mem_data(output, &data);
+    attached->assign(data, data + size);
+  }
+  BIO_free(output);
+  BIO_free(input);
+  X509_STORE_free(store);
+  sk_X509_pop_free(certificates, X509_free);
+  return ok;
+}
+
+// Whether the signer info of |signature| has the |nid| signed attribute.
+bool HasSignedAttribute(const std::vector<uint8_t>& signature, int nid) {
+  Cms cms = Parse(signature);
+  STACK_OF(CMS_SignerInfo)* infos = cms ? CMS_get0_SignerInfos(cms.get())
+                                        : nullptr;
+  if (!infos || sk_CMS_SignerInfo_num(infos) != 1) {
+    return false;
+  }
+  return CMS_signed_get_attr_by_NID(sk_CMS_SignerInfo_value(infos, 0), nid,
+                                    -1) >= 0;
+}
+
+}  // namespace
+
+TEST(FixtureSignaturesAreReproduced) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  for (const Fixture& fixture : kFixtures) {
+    std::vector<uint8_t> expected = ReadFixture(fixture.signature);
+    ASSERT_TRUE(!expected.empty());
+    EXPECT_TRUE(Sign(signer.get(), ReadFixture(fixture.content),
+                     OptionsFor(fixture.digest, fixture.attached)) ==
+                expected);
+  }
+}
+
+TEST(FixtureSignaturesVerify) {
+  for (const Fixture& fixture : kFixtures) {
+    std::vector<uint8_t> content = ReadFixture(fixture.content);
+    std::vector<uint8_t> signature = ReadFixture(fixture.signature);
+    if (fixture.attached) {
+      std::vector<uint8_t> attached;
+      EXPECT_TRUE(Verifies(signature, nullptr, &attached));
+      EXPECT_TRUE(attached == content);
+    }
+    else {
+      EXPECT_TRUE(Verifies(signature, &content));
+    }
+  }
+}
+
+TEST(ChangedContentDoesNotVerify) {
+  std::vector<uint8_t> content = ReadFixture("document.txt");
+  std::vector<uint8_t> signature = ReadFixture("document.txt.sha256.p7s");
+  ASSERT_TRUE(!content.empty());
+  content.back() ^= 1;
+  EXPECT_FALSE(Verifies(signature, &content));
+  std::vector<uint8_t> other = ReadFixture("bytes.bin");
+  EXPECT_FALSE(Verifies(signature, &other));
+
+  // A flipped bit in the signature value, the last bytes of the structure.
+  std::vector<uint8_t> changed = ReadFixture("document.txt.sha256.p7s");
+  changed[changed.size() - 8] ^= 1;
+  content = ReadFixture("document.txt");
+  EXPECT_FALSE(Verifies(changed, &content));
+}
+
+TEST(EmptyContentIsSigned) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  std::vector<uint8_t> empty;
+  std::vector<uint8_t> detached =
+      Sign(signer.get(), empty, OptionsFor(DigestAlgorithm::kSha256, false));
+  EXPECT_TRUE(Verifies(detached, &empty));
+  std::vector<uint8_t> attached_content = {'x'};
+  EXPECT_TRUE(Verifies(
+      Sign(signer.get(), empty, OptionsFor(DigestAlgorithm::kSha256, true)),
+      nullptr, &attached_content));
+  EXPECT_TRUE(attached_content.empty());
+}
+
+TEST(DetachedSignatureOfADigestIsTheSame) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  for (const Fixture& fixture : kFixtures) {
+    if (fixture.attached) {
+      continue;
+    }
+    std::vector<uint8_t> content = ReadFixture(fixture.content);
+    std::vector<uint8_t> signature;
+    std::string error;
+    EXPECT_TRUE(BuildDetachedCadesSignature(
+        signer.get(), signer->Certificate(),
+        native_core::Digest(fixture.digest, content.data(), content.size()),
+        OptionsFor(fixture.digest, false), &signature, &error));
+    EXPECT_TRUE(signature == ReadFixture(fixture.signature));
+  }
+}
+
+TEST(SignedAttributesAreTheCadesOnes) {
+  std::vector<uint8_t> signature = ReadFixture("document.txt.sha256.p7s");
+  EXPECT_TRUE(HasSignedAttribute(signature, NID_pkcs9_contentType));
+  EXPECT_TRUE(HasSignedAttribute(signature, NID_pkcs9_messageDigest));
+  EXPECT_TRUE(HasSignedAttribute(signature, NID_pkcs9_signingTime));
+  EXPECT_TRUE(HasSignedAttribute(signature,
+                                 NID_id_smime_aa_signingCertificateV2));
+
+  // PAdES signatures carry the time in the signature dictionary instead.
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  CadesOptions options = OptionsFor(DigestAlgorithm::kSha256, false);
+  options.signing_time_attribute = false;
+  std::vector<uint8_t> content = ReadFixture("document.txt");
+  std::vector<uint8_t> without_time = Sign(signer.get(), content, options);
+  EXPECT_TRUE(Verifies(without_time, &content));
+  EXPECT_FALSE(HasSignedAttribute(without_time, NID_pkcs9_signingTime));
+  EXPECT_TRUE(HasSignedAttribute(without_time,
+                                 NID_id_smime_aa_signingCertificateV2));
+}
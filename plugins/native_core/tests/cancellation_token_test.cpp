@@ -0,0 +1,80 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/cancellation_token.h>
+
+#include <atomic>
+#include <thread>
+
+#include "test_support.h"
+
+using native_core::CancellationSource;
+using native_core::CancellationToken;
+
+TEST(DefaultTokenIsNeverCancelled) {
+  CancellationToken token;
+  EXPECT_FALSE(token.IsCancelled());
+  CancellationToken copy = token;
+  EXPECT_FALSE(copy.IsCancelled());
+}
+
+TEST(CancelReachesEveryToken) {
+  CancellationSource source;
+  CancellationToken before = source.token();
+  EXPECT_FALSE(source.IsCancelled());
+  EXPECT_FALSE(before.IsCancelled());
+  source.Cancel();
+  CancellationToken after = source.token();
+  EXPECT_TRUE(source.IsCancelled());
+  EXPECT_TRUE(before.IsCancelled());
+  EXPECT_TRUE(after.IsCancelled());
+  CancellationToken copy = before;
+  EXPECT_TRUE(copy.IsCancelled());
+}
+
+TEST(CancelIsSticky) {
+  CancellationSource source;
+  source.Cancel();
+  source.Cancel();
+  EXPECT_TRUE(source.token().IsCancelled());
+}
+
+TEST(SourcesAreIndependent) {
+  CancellationSource first;
+  CancellationSource second;
+  first.Cancel();
+  EXPECT_TRUE(first.token().IsCancelled());
+  EXPECT_FALSE(second.token().IsCancelled());
+}
+
+TEST(TokenOutlivesItsSource) {
+  CancellationToken token;
+  {
+    CancellationSource source;
+    token = source.token();
+    source.Cancel();
+  }
+  EXPECT_TRUE(token.IsCancelled());
+}
+
+TEST(CancelIsSeenByAnotherThread) {
+  CancellationSource source;
+  std::atomic<bool> saw_cancel{false};
+  std::thread worker([token = source.token(), &saw_cancel]() {
+    saw_cancel = native_core_tests::WaitFor(
+        [&token]() { return token.IsCancelled(); });
+  });
+  source.Cancel();
+  worker.join();
+  EXPECT_TRUE(saw_cancel.load());
+}
@@ -0,0 +1,101 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/eventfd_wakeup.h>
+#include <native_core/platform_dispatcher.h>
+
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "test_support.h"
+
+using native_core::EventFdWakeup;
+
+namespace {
+
+bool Readable(int fd) {
+  pollfd entry{fd, POLLIN, 0};
+  return poll(&entry, 1, 0) == 1 && (entry.revents & POLLIN) != 0;
+}
+
+}  // namespace
+
+TEST(EventFdWaitTimesOutUnsignalled) {
+  EventFdWakeup wakeup;
+  EXPECT_TRUE(wakeup.fd() >= 0);
+  EXPECT_FALSE(Readable(wakeup.fd()));
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(wakeup.Wait(20));
+  EXPECT_TRUE(std::chrono::steady_clock::now() - start >=
+              std::chrono::milliseconds(15));
+  EXPECT_FALSE(wakeup.Wait(0));
+}
+
+TEST(EventFdSignalsAreCoalescedUntilConsumed) {
+  EventFdWakeup wakeup;
+  wakeup.Signal();
+  wakeup.Signal();
+  wakeup.Signal();
+  EXPECT_TRUE(Readable(wakeup.fd()));
+  EXPECT_TRUE(wakeup.Wait(0));
+  // Waiting does not consume.
+  EXPECT_TRUE(wakeup.Wait(0));
+  wakeup.Consume();
+  EXPECT_FALSE(Readable(wakeup.fd()));
+  EXPECT_FALSE(wakeup.Wait(0));
+  // Consuming with nothing signalled does not block.
+  wakeup.Consume();
+  wakeup.Signal();
+  EXPECT_TRUE(wakeup.Wait(0));
+}
+
+TEST(EventFdSignalFromAnotherThreadEndsWait) {
+  EventFdWakeup wakeup;
+  std::thread signaller([&wakeup]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    wakeup.Signal();
+  });
+  EXPECT_TRUE(wakeup.Wait(10000));
+  signaller.join();
+}
+
+TEST(EventFdDrivesADispatcher) {
+  // The loop of the headless tools: wait, consume, drain.
+  EventFdWakeup wakeup;
+  native_core::PlatformDispatcher dispatcher(&wakeup);
+  std::atomic<int> posted{0};
+  int ran = 0;
+  std::thread poster([&]() {
+    for (int i = 0; i < 10000; i++) {
+      dispatcher.Post([&ran]() { ran++; });
+      posted++;
+    }
+  });
+  while (ran < 10000 && wakeup.Wait(10000)) {
+    wakeup.Consume();
+    dispatcher.Drain();
+  }
+  poster.join();
+  EXPECT_EQ(ran, 10000);
+  // The signal of the last post may land after the drain that ran it: it
+  // finds nothing left to run.
+  if (wakeup.Wait(0)) {
+    wakeup.Consume();
+    dispatcher.Drain();
+  }
+  EXPECT_EQ(ran, 10000);
+  EXPECT_FALSE(wakeup.Wait(0));
+}
@@ -0,0 +1,631 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The HTTP client against a stand-in server run by the test, over plain HTTP
+// and over TLS with the self-signed certificate of tests/data. The stand-in
+// serves the compressed copies of tests/data/response.xml:
+//
+//   response.xml.gz, .multi.gz   gzip, in one member and in two
+//   response.xml.zlib, .deflate  deflate, zlib-wrapped and raw
+//   response.xml.zst             zstd, checked when the build decodes it
+//   response.xml.truncated.*     gzip and zstd cut two thirds of the way
+//
+// ctest passes the directory in TEST_DATA.
+#include <native_core/content_coding.h>
+#include <native_core/http_client.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::CanDecode;
+using native_core::ContentCoding;
+using native_core::ContentDecoder;
+using native_core::HttpClient;
+using native_core::HttpClientOptions;
+using native_core::HttpResponse;
+using native_core::HttpStats;
+
+namespace {
+
+std::string DataPath(const std::string& name) {
+  const char* directory = std::getenv("TEST_DATA");
+  return std::string(directory ? directory : ".") + "/" + name;
+}
+
+std::string ReadFixture(const std::string& name) {
+  std::ifstream file(DataPath(name), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+std::vector<uint8_t> Bytes(const std::string& text) {
+  return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+// A request as the stand-in received it.
+struct ReceivedRequest {
+  std::string path;
+  // Names lowercased.
+  std::map<std::string, std::string> headers;
+  std::string body;
+};
+
+// An HTTP/1.1 server on a free loopback port, with keep-alive, one thread per
+// connection. Routes, with ?bytes=N or ?offset=N where noted:
+//
+//   /plain, /gzip, /multi-gzip, /zlib, /deflate, /zstd   the fixture
+//   /truncated-gzip, /truncated-zstd                     the cut fixtures
+//   /cut-gzip?bytes=N, /cut-zstd?bytes=N                 its first N bytes
+//   /corrupt-gzip?offset=N                               a byte flipped
+//   /echo                                                "ok"
+//   /refuse-gzip                                         415 to gzip bodies
+//   /login                                               sets JSESSIONID
+//   /close                                               "ok", then closes
+//
+// Every response advertises "Accept-Encoding: gzip", which must not be taken
+// as leave to compress request bodies.
+class StandIn {
+ public:
+  explicit StandIn(bool tls) {
+    signal(SIGPIPE, SIG_IGN);
+    if (tls) {
+      context_ = SSL_CTX_new(TLS_server_method());
+      if (!context_ ||
+          SSL_CTX_use_certificate_chain_file(
+              context_, DataPath("standin_cert.pem").c_str()) != 1 ||
+          SSL_CTX_use_PrivateKey_file(context_,
+                                      DataPath("standin_key.pem").c_str(),
+                                      SSL_FILETYPE_PEM) != 1) {
+        return;
+      }
+    }
+    listener_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    if (bind(listener_, reinterpret_cast<sockaddr*>(&address), size) != 0 ||
+        listen(listener_, 16) != 0 ||
+        getsockname(listener_, reinterpret_cast<sockaddr*>(&address),
+                    &size) != 0) {
+      return;
+    }
+    base_url_ = std::string(tls ? "https" : "http") + "://127.0.0.1:" +
+                std::to_string(ntohs(address.sin_port));
+    acceptor_ = std::thread([this]() { Accept(); });
+  }
+
+  ~StandIn() {
+    stopping_ = true;
+    shutdown(listener_, SHUT_RDWR);
+    if (acceptor_.joinable()) {
+      acceptor_.join();
+    }
+    close(listener_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int connection : connections_) {
+        shutdown(connection, SHUT_RDWR);
+      }
+    }
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+    for (int connection : connections_) {
+      close(connection);
+    }
+    if (context_) {
+      SSL_CTX_free(context_);
+    }
+  }
+
+  // Prevent copying.
+  StandIn(StandIn const&) = delete;
+  StandIn& operator=(StandIn const&) = delete;
+
+  // Empty if the stand-in did not start.
+  std::string Url(const std::string& path) const {
+    return base_url_.empty() ? std::string() : base_url_ + path;
+  }
+
+  std::vector<ReceivedRequest> received() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_;
+  }
+
+ private:
+  struct Response {
+    int status = 200;
+    std::string reason = "OK";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+    bool close = false;
+  };
+
+  // A connection, over TLS when |ssl| is set.
+  struct Connection {
+    int socket;
+    SSL* ssl;
+
+    int Read(char* buffer, int size) {
+      return ssl ? SSL_read(ssl, buffer, size)
+                 : static_cast<int>(recv(socket, buffer, size, 0));
+    }
+
+    bool Write(const std::string& data) {
+      size_t written = 0;
+      while (written < data.size()) {
+        int size = static_cast<int>(data.size() - written);
+        int result = ssl ? SSL_write(ssl, data.data() + written, size)
+                         : static_cast<int>(send(socket, data.data() + written,
+                                                 size, MSG_NOSIGNAL));
+        if (result <= 0) {
+          return false;
+        }
+        written += static_cast<size_t>(result);
+      }
+      return true;
+    }
+  };
+
+  void Accept() {
+    while (!stopping_) {
+      int connection = accept(listener_, nullptr, nullptr);
+      if (connection < 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      connections_.push_back(connection);
+      threads_.emplace_back([this, connection]() { Serve(connection); });
+    }
+  }
+
+  void Serve(int socket) {
+    Connection connection{socket, nullptr};
+    if (context_) {
+      connection.ssl = SSL_new(context_);
+      SSL_set_fd(connection.ssl, socket);
+      if (SSL_accept(connection.ssl) != 1) {
+        // A client that does not trust the certificate gives up here.
+        ERR_clear_error();
+        SSL_free(connection.ssl);
+        return;
+      }
+    }
+    std::string buffer;
+    char chunk[16 * 1024];
+    bool open = true;
+    while (open) {
+      size_t head_end;
+      while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        int read = connection.Read(chunk, sizeof(chunk));
+        if (read <= 0) {
+          open = false;
+          break;
+        }
+        buffer.append(chunk, static_cast<size_t>(read));
+      }
+      if (!open) {
+        break;
+      }
+      ReceivedRequest request;
+      std::string head = buffer.substr(0, head_end);
+      buffer.erase(0, head_end + 4);
+      size_t path_start = head.find(' ') + 1;
+      request.path = head.substr(path_start, head.find(' ', path_start) -
+                                                 path_start);
+      size_t line = head.find("\r\n");
+      while (line != std::string::npos) {
+        size_t end = head.find("\r\n", line + 2);
+        std::string header = head.substr(line + 2, end - line - 2);
+        size_t colon = header.find(':');
+        if (colon != std::string::npos) {
+          std::string name = header.substr(0, colon);
+          std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+          size_t value = header.find_first_not_of(' ', colon + 1);
+          request.headers[name] =
+              value == std::string::npos ? "" : header.substr(value);
+        }
+        line = end;
+      }
+      size_t length = static_cast<size_t>(
+          std::strtoull(request.headers["content-length"].c_str(), nullptr, 10));
+      while (buffer.size() < length) {
+        int read = connection.Read(chunk, sizeof(chunk));
+        if (read <= 0) {
+          open = false;
+          break;
+        }
+        buffer.append(chunk, static_cast<size_t>(read));
+      }
+      if (!open) {
+        break;
+      }
+      request.body = buffer.substr(0, length);
+      buffer.erase(0, length);
+
+      Response response = Handle(request);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        received_.push_back(std::move(request));
+      }
+      std::string reply = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                          response.reason + "\r\nContent-Length: " +
+                          std::to_string(response.body.size()) +
+                          "\r\nAccept-Encoding: gzip\r\n";
+      for (const auto& [name, value] : response.headers) {
+        reply += name + ": " + value + "\r\n";
+      }
+      reply += response.close ? "Connection: close\r\n\r\n" : "\r\n";
+      reply += response.body;
+      open = connection.Write(reply) && !response.close;
+    }
+    if (connection.ssl) {
+      SSL_shutdown(connection.ssl);
+      SSL_free(connection.ssl);
+    }
+  }
+
+  static Response Fixture(const std::string& name, const char* coding) {
+    Response response;
+    response.headers.emplace_back("Content-Type", "application/xml");
+    if (coding) {
+      response.headers.emplace_back("Content-Encoding", coding);
+    }
+    response.body = ReadFixture(name);
+    return response;
+  }
+
+  static Response Handle(const ReceivedRequest& request) {
+    std::string path = request.path.substr(0, request.path.find('?'));
+    size_t equals = request.path.find('=');
+    size_t number = equals == std::string::npos
+                        ? 0
+                        : std::strtoull(request.path.c_str() + equals + 1,
+                                        nullptr, 10);
+    Response response;
+    if (path == "/plain") {
+      return Fixture("response.xml", nullptr);
+    }
+    if (path == "/gzip" || path == "/cut-gzip" || path == "/corrupt-gzip") {
+      response = Fixture("response.xml.gz", "gzip");
+      if (path == "/cut-gzip") {
+        response.body.resize(std::min(number, response.body.size()));
+      }
+      else if (path == "/corrupt-gzip" && number < response.body.size()) {
+        response.body[number] = static_cast<char>(~response.body[number]);
+      }
+      return response;
+    }
+    if (path == "/zstd" || path == "/cut-zstd") {
+      response = Fixture("response.xml.zst", "zstd");
+      if (path == "/cut-zstd") {
+        response.body.resize(std::min(number, response.body.size()));
+      }
+      return response;
+    }
+    if (path == "/multi-gzip") {
+      return Fixture("response.xml.multi.gz", "gzip");
+    }
+    if (path == "/zlib") {
+      return Fixture("response.xml.zlib", "deflate");
+    }
+    if (path == "/deflate") {
+      return Fixture("response.xml.deflate", "deflate");
+    }
+    if (path == "/truncated-gzip") {
+      return Fixture("response.xml.truncated.gz", "gzip");
+    }
+    if (path == "/truncated-zstd") {
+      return Fixture("response.xml.truncated.zst", "zstd");
+    }
+    if (path == "/refuse-gzip") {
+      auto coding = request.headers.find("content-encoding");
+      if (coding != request.headers.end() && coding->second == "gzip") {
+        response.status = 415;
+        response.reason = "Unsupported Media Type";
+        response.body = "<html>Unsupported Media Type</html>";
+        return response;
+      }
+    }
+    if (path == "/login") {
+      response.headers.emplace_back("Set-Cookie",
+                                    "JSESSIONID=standin-1; Path=/; HttpOnly");
+    }
+    response.close = path == "/close";
+    response.body = "ok";
+    return response;
+  }
+
+  SSL_CTX* context_ = nullptr;
+  int listener_ = -1;
+  std::string base_url_;
+  std::atomic<bool> stopping_{false};
+  std::thread acceptor_;
+
+  mutable std::mutex mutex_;
+  std::vector<int> connections_;
+  std::vector<std::thread> threads_;
+  std::vector<ReceivedRequest> received_;
+};
+
+// Posts |body| to |url| and collects the response body in |received|.
+HttpResponse Post(HttpClient* client, const std::string& url,
+                  std::string* received = nullptr,
+                  const std::string& body = "op=1&dat=eA%3D%3D") {
+  std::string collected;
+  HttpResponse response =
+      client->Post(url, {{"Content-Type", "application/x-www-form-urlencoded"}},
+                   Bytes(body), [&](const char* data, size_t size) {
+                     collected.append(data, size);
+                   });
+  if (received) {
+    *received = std::move(collected);
+  }
+  return response;
+}
+
+std::string Gunzip(const std::string& compressed) {
+  std::string plain;
+  std::unique_ptr<ContentDecoder> decoder = ContentDecoder::Create(
+      ContentCoding::kGzip,
+      [&](const char* data, size_t size) { plain.append(data, size); });
+  if (!decoder || !decoder->Feed(compressed.data(), compressed.size()) ||
+      !decoder->Finish()) {
+    return std::string();
+  }
+  return plain;
+}
+
+// Paths of the fixture in every coding this build decodes.
+std::vector<std::string> EncodedPaths() {
+  std::vector<std::string> paths;
+  if (CanDecode(ContentCoding::kGzip)) {
+    paths.insert(paths.end(), {"/gzip", "/multi-gzip", "/zlib", "/deflate"});
+  }
+  if (CanDecode(ContentCoding::kZstd)) {
+    paths.push_back("/zstd");
+  }
+  return paths;
+}
+
+std::string RepeatedXml(size_t size) {
+  std::string xml;
+  while (xml.size() < size) {
+    xml += "<req id=\"U0001R000042\" status=\"OK\"><doc docid=\"D0\"/></req>";
+  }
+  return xml;
+}
+
+}  // namespace
+
+TEST(DecodesTheFixtureInEveryCoding) {
+  StandIn standin(false);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  std::string expected = ReadFixture("response.xml");
+  ASSERT_TRUE(!expected.empty());
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+
+  std::string body;
+  EXPECT_EQ(Post(client.get(), standin.Url("/plain"), &body).status, 200);
+  EXPECT_TRUE(body == expected);
+  std::vector<std::string> paths = EncodedPaths();
+  for (const std::string& path : paths) {
+    HttpResponse response = Post(client.get(), standin.Url(path), &body);
+    EXPECT_EQ(response.status, 200);
+    EXPECT_EQ(response.error, std::string());
+    EXPECT_TRUE(body == expected);
+  }
+
+  HttpStats stats = client->stats();
+  EXPECT_EQ(stats.decoded_response_bytes, expected.size() * paths.size());
+  EXPECT_TRUE(stats.encoded_response_bytes * 5 < stats.decoded_response_bytes);
+  // The client asks for what it can decode.
+  std::vector<ReceivedRequest> received = standin.received();
+  ASSERT_TRUE(!received.empty());
+  EXPECT_EQ(received.back().headers["accept-encoding"],
+            std::string(native_core::AcceptedCodings()));
+}
+
+TEST(TruncatedStreamsFail) {
+  StandIn standin(false);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+  std::vector<std::string> paths;
+  if (CanDecode(ContentCoding::kGzip)) {
+    paths.push_back("/truncated-gzip");
+    size_t size = ReadFixture("response.xml.gz").size();
+    // Inside the header, inside the data, and without the trailer.
+    for (size_t bytes : {size_t{1}, size_t{9}, size_t{10}, size / 2, size - 8,
+                         size - 1}) {
+      paths.push_back("/cut-gzip?bytes=" + std::to_string(bytes));
+    }
+    // A flipped byte of the data, and of the checksum.
+    paths.push_back("/corrupt-gzip?offset=" + std::to_string(size / 2));
+    paths.push_back("/corrupt-gzip?offset=" + std::to_string(size - 6));
+  }
+  if (CanDecode(ContentCoding::kZstd)) {
+    paths.push_back("/truncated-zstd");
+    size_t size = ReadFixture("response.xml.zst").size();
+    for (size_t bytes : {size_t{1}, size_t{4}, size / 2, size - 1}) {
+      paths.push_back("/cut-zstd?bytes=" + std::to_string(bytes));
+    }
+  }
+  for (const std::string& path : paths) {
+    HttpResponse response = Post(client.get(), standin.Url(path));
+    EXPECT_EQ(response.status, 0);
+    EXPECT_FALSE(response.error.empty());
+  }
+  EXPECT_EQ(client->stats().failures, paths.size());
+  // The connection is still good for the next request.
+  std::string body;
+  EXPECT_EQ(Post(client.get(), standin.Url("/plain"), &body).status, 200);
+  EXPECT_TRUE(body == ReadFixture("response.xml"));
+}
+
+TEST(RequestBodiesAreOnlyCompressedForOriginsOptedIn) {
+  if (!CanDecode(ContentCoding::kGzip)) {
+    return;
+  }
+  StandIn standin(false);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  std::string xml = RepeatedXml(8 * 1024);
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+
+  // The stand-in advertises gzip in every response, which is not enough.
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo"), nullptr, xml).status, 200);
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo"), nullptr, xml).status, 200);
+  client->CompressRequests(standin.Url("/"), true);
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo"), nullptr, xml).status, 200);
+  // Too small to be worth it.
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo"), nullptr, "op=1").status,
+            200);
+  client->CompressRequests(standin.Url("/other/path"), false);
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo"), nullptr, xml).status, 200);
+
+  std::vector<ReceivedRequest> received = standin.received();
+  ASSERT_TRUE(received.size() == 5);
+  for (size_t i : {size_t{0}, size_t{1}, size_t{3}, size_t{4}}) {
+    EXPECT_EQ(received[i].headers.count("content-encoding"), size_t{0});
+  }
+  EXPECT_TRUE(received[0].body == xml);
+  EXPECT_EQ(received[2].headers["content-encoding"], std::string("gzip"));
+  EXPECT_TRUE(received[2].body.size() < xml.size() / 4);
+  EXPECT_TRUE(Gunzip(received[2].body) == xml);
+
+  HttpStats stats = client->stats();
+  EXPECT_EQ(stats.plain_request_bytes, xml.size());
+  EXPECT_EQ(stats.compressed_request_bytes, received[2].body.size());
+}
+
+TEST(OriginsOptedInAtCreationAreCompressed) {
+  if (!CanDecode(ContentCoding::kGzip)) {
+    return;
+  }
+  StandIn standin(false);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  HttpClientOptions options;
+  // Any URL of the origin will do; the host is matched case-insensitively.
+  options.compress_requests_to.push_back(standin.Url("/proxy/pf"));
+  std::unique_ptr<HttpClient> client = HttpClient::Create(options);
+  std::string xml = RepeatedXml(4 * 1024);
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo"), nullptr, xml).status, 200);
+  std::vector<ReceivedRequest> received = standin.received();
+  ASSERT_TRUE(received.size() == 1);
+  EXPECT_EQ(received[0].headers["content-encoding"], std::string("gzip"));
+}
+
+TEST(RefusedCompressionIsResentPlainAndNotTriedAgain) {
+  if (!CanDecode(ContentCoding::kGzip)) {
+    return;
+  }
+  StandIn standin(false);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+  client->CompressRequests(standin.Url("/"), true);
+  std::string xml = RepeatedXml(4 * 1024);
+
+  std::string body;
+  HttpResponse response =
+      Post(client.get(), standin.Url("/refuse-gzip"), &body, xml);
+  EXPECT_EQ(response.status, 200);
+  // The body of the 415 is not passed on.
+  EXPECT_EQ(body, std::string("ok"));
+  EXPECT_EQ(Post(client.get(), standin.Url("/refuse-gzip"), nullptr, xml).status,
+            200);
+
+  std::vector<ReceivedRequest> received = standin.received();
+  ASSERT_TRUE(received.size() == 3);
+  EXPECT_EQ(received[0].headers["content-encoding"], std::string("gzip"));
+  EXPECT_EQ(received[1].headers.count("content-encoding"), size_t{0});
+  EXPECT_TRUE(received[1].body == xml);
+  EXPECT_EQ(received[2].headers.count("content-encoding"), size_t{0});
+}
+
+TEST(SessionCookieIsSentBack) {
+  StandIn standin(false);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+  EXPECT_EQ(Post(client.get(), standin.Url("/login")).status, 200);
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo")).status, 200);
+  client->ClearSession();
+  EXPECT_EQ(Post(client.get(), standin.Url("/echo")).status, 200);
+
+  std::vector<ReceivedRequest> received = standin.received();
+  ASSERT_TRUE(received.size() == 3);
+  EXPECT_EQ(received[1].headers["cookie"], std::string("JSESSIONID=standin-1"));
+  EXPECT_EQ(received[2].headers.count("cookie"), size_t{0});
+}
+
+TEST(TlsConnectionsAreKeptAliveAndResumed) {
+  StandIn standin(true);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  HttpClientOptions options;
+  options.ca_file = DataPath("standin_cert.pem");
+  options.max_connections_per_host = 1;
+  std::unique_ptr<HttpClient> client = HttpClient::Create(options);
+
+  std::string expected = ReadFixture("response.xml");
+  std::vector<std::string> paths = EncodedPaths();
+  paths.push_back("/plain");
+  for (const std::string& path : paths) {
+    std::string body;
+    EXPECT_EQ(Post(client.get(), standin.Url(path), &body).status, 200);
+    EXPECT_TRUE(body == expected);
+  }
+  HttpStats stats = client->stats();
+  EXPECT_EQ(stats.connections_opened, uint64_t{1});
+  EXPECT_EQ(stats.connections_reused, paths.size() - 1);
+  EXPECT_EQ(stats.tls_full_handshakes, uint64_t{1});
+
+  // Each of these closes its connection, so the next one opens a new one
+  // and resumes the session.
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(Post(client.get(), standin.Url("/close")).status, 200);
+  }
+  stats = client->stats();
+  EXPECT_EQ(stats.connections_opened, uint64_t{3});
+  EXPECT_EQ(stats.tls_full_handshakes + stats.tls_resumed_handshakes,
+            uint64_t{3});
+  EXPECT_TRUE(stats.tls_resumed_handshakes >= 1);
+}
+
+TEST(TlsWithAnUntrustedCertificateFails) {
+  StandIn standin(true);
+  ASSERT_TRUE(!standin.Url("/").empty());
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+  HttpResponse response = Post(client.get(), standin.Url("/plain"));
+  EXPECT_EQ(response.status, 0);
+  EXPECT_FALSE(response.error.empty());
+  EXPECT_TRUE(standin.received().empty());
+}
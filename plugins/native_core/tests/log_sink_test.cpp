@@ -0,0 +1,316 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <native_core/content_coding.h>
+#include <native_core/log_sink.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::LogOverflow;
+using native_core::LogSink;
+using native_core::LogSinkOptions;
+using native_core::LogSinkStats;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+// Long enough that nothing in a test is written by the timer.
+constexpr std::chrono::hours kNever{1};
+
+std::string ReadAll(const std::string& path) {
+  std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+bool Exists(const std::string& path) {
+  return std::filesystem::exists(std::filesystem::u8path(path));
+}
+
+// Record |index|, padded with its line break to |size| bytes.
+std::string Record(int index, size_t size = 100) {
+  std::string record = "record " + std::to_string(index) + " ";
+  record.resize(size - 1, '.');
+  return record + "\n";
+}
+
+std::string Records(int first, int end) {
+  std::string records;
+  for (int index = first; index < end; index++) {
+    records += Record(index);
+  }
+  return records;
+}
+
+std::string Gunzip(const std::string& compressed) {
+  std::string decoded;
+  std::unique_ptr<native_core::ContentDecoder> decoder =
+      native_core::ContentDecoder::Create(
+          native_core::ContentCoding::kGzip,
+          [&](const char* data, size_t size) { decoded.append(data, size); });
+  if (!decoder || !decoder->Feed(compressed.data(), compressed.size()) ||
+      !decoder->Finish()) {
+    return "(corrupt)";
+  }
+  return decoded;
+}
+
+}  // namespace
+
+TEST(RecordsAreWrittenAsGivenOnFlush) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.flush_interval = kNever;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  for (int index = 0; index < 10; index++) {
+    EXPECT_TRUE(sink->Write(Record(index)));
+  }
+  sink->Flush();
+  EXPECT_EQ(ReadAll(options.path), Records(0, 10));
+  LogSinkStats stats = sink->stats();
+  EXPECT_EQ(stats.records, 10u);
+  EXPECT_EQ(stats.bytes_written, 1000u);
+  EXPECT_EQ(stats.dropped, 0u);
+}
+
+TEST(OpeningAppendsUnlessTruncating) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  LogSink::Open(options)->Write(Record(0));
+  LogSink::Open(options)->Write(Record(1));
+  EXPECT_EQ(ReadAll(options.path), Records(0, 2));
+
+  options.truncate = true;
+  LogSink::Open(options)->Write(Record(2));
+  EXPECT_EQ(ReadAll(options.path), Records(2, 3));
+}
+
+TEST(ProducersKeepTheirOrder) {
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 5000;
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.max_file_bytes = 0;
+  // Small enough for the producers to fill it, with nothing dropped.
+  options.max_buffered_records = 64;
+  options.overflow = LogOverflow::kBlock;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < kProducers; producer++) {
+    producers.emplace_back([&, producer]() {
+      for (int index = 0; index < kPerProducer; index++) {
+        sink->Write(std::to_string(producer) + " " + std::to_string(index) +
+                    "\n");
+      }
+    });
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  sink->Flush();
+  EXPECT_EQ(sink->stats().records,
+            static_cast<uint64_t>(kProducers * kPerProducer));
+  EXPECT_EQ(sink->stats().dropped, 0u);
+
+  // Whole lines only, and each producer's in the order it wrote them.
+  std::istringstream lines(ReadAll(options.path));
+  std::vector<int> next(kProducers, 0);
+  int producer;
+  int index;
+  int count = 0;
+  while (lines >> producer >> index) {
+    ASSERT_TRUE(producer >= 0 && producer < kProducers);
+    EXPECT_EQ(index, next[producer]);
+    next[producer] = index + 1;
+    count++;
+  }
+  EXPECT_EQ(count, kProducers * kPerProducer);
+}
+
+TEST(FilesRotateBySize) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  // Ten records per file.
+  options.max_file_bytes = 1000;
+  options.max_rotated_files = 2;
+  options.flush_interval = kNever;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  // Written in batches of every size, which must not change where the files
+  // are cut.
+  int written = 0;
+  for (int batch = 1; written < 55; batch++) {
+    for (int index = 0; index < batch && written < 55; index++) {
+      sink->Write(Record(written++));
+    }
+    sink->Flush();
+  }
+  EXPECT_EQ(ReadAll(options.path), Records(50, 55));
+  EXPECT_EQ(ReadAll(options.path + ".1"), Records(40, 50));
+  EXPECT_EQ(ReadAll(options.path + ".2"), Records(30, 40));
+  EXPECT_FALSE(Exists(options.path + ".3"));
+  EXPECT_EQ(sink->stats().rotations, 5u);
+}
+
+TEST(RotatingWithoutKeptFilesStartsAgain) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.max_file_bytes = 1000;
+  options.max_rotated_files = 0;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  for (int index = 0; index < 25; index++) {
+    sink->Write(Record(index));
+  }
+  sink->Flush();
+  EXPECT_EQ(ReadAll(options.path), Records(20, 25));
+  EXPECT_FALSE(Exists(options.path + ".1"));
+}
+
+TEST(RotatedFilesAreGzipped) {
+  if (!native_core::CanDecode(native_core::ContentCoding::kGzip)) {
+    // Built without zlib: rotated files stay as they are.
+    return;
+  }
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.max_file_bytes = 1000;
+  options.max_rotated_files = 2;
+  options.compress_rotated = true;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  for (int index = 0; index < 35; index++) {
+    sink->Write(Record(index));
+  }
+  sink->Flush();
+  EXPECT_EQ(ReadAll(options.path), Records(30, 35));
+  std::string first = ReadAll(options.path + ".1.gz");
+  EXPECT_TRUE(first.size() < 1000);
+  EXPECT_EQ(Gunzip(first), Records(20, 30));
+  EXPECT_EQ(Gunzip(ReadAll(options.path + ".2.gz")), Records(10, 20));
+  EXPECT_FALSE(Exists(options.path + ".1"));
+  EXPECT_FALSE(Exists(options.path + ".3.gz"));
+}
+
+TEST(DropOverflowCountsWhatWasDropped) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.max_buffered_bytes = 250;
+  options.overflow = LogOverflow::kDrop;
+  options.flush_interval = kNever;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  // Nothing is written until the flush, so only the first two fit.
+  for (int index = 0; index < 10; index++) {
+    EXPECT_EQ(sink->Write(Record(index)), index < 2);
+  }
+  sink->Flush();
+  EXPECT_EQ(ReadAll(options.path),
+            Records(0, 2) + "WARNING: 8 log records dropped.\n");
+  EXPECT_EQ(sink->stats().records, 2u);
+  EXPECT_EQ(sink->stats().dropped, 8u);
+
+  // Room again once written, and the warning is not repeated.
+  EXPECT_TRUE(sink->Write(Record(2)));
+  sink->Flush();
+  EXPECT_EQ(ReadAll(options.path),
+            Records(0, 2) + "WARNING: 8 log records dropped.\n" +
+                Records(2, 3));
+}
+
+TEST(OversizedRecordIsTakenIntoAnEmptyBuffer) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.max_buffered_bytes = 50;
+  options.flush_interval = kNever;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  EXPECT_TRUE(sink->Write(Record(0)));
+  EXPECT_FALSE(sink->Write(Record(1)));
+  sink->Flush();
+  EXPECT_EQ(sink->stats().records, 1u);
+  EXPECT_EQ(sink->stats().dropped, 1u);
+}
+
+TEST(BlockOverflowWaitsForTheWriter) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.max_buffered_bytes = 250;
+  options.overflow = LogOverflow::kBlock;
+  // A blocked writer must wake the writer thread itself.
+  options.flush_interval = kNever;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < 100; index++) {
+    EXPECT_TRUE(sink->Write(Record(index)));
+  }
+  EXPECT_TRUE(std::chrono::steady_clock::now() - start <
+              std::chrono::seconds(30));
+  sink->Flush();
+  EXPECT_EQ(ReadAll(options.path), Records(0, 100));
+  EXPECT_EQ(sink->stats().dropped, 0u);
+}
+
+TEST(ClosingWritesWhatIsBuffered) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("app.log");
+  options.flush_interval = kNever;
+  std::unique_ptr<LogSink> sink = LogSink::Open(options);
+  ASSERT_TRUE(sink != nullptr);
+
+  for (int index = 0; index < 10; index++) {
+    sink->Write(Record(index));
+  }
+  sink.reset();
+  EXPECT_EQ(ReadAll(options.path), Records(0, 10));
+}
+
+TEST(OpenFailsWithoutADirectory) {
+  TempDirectory directory;
+  LogSinkOptions options;
+  options.path = directory.File("missing/app.log");
+  EXPECT_TRUE(LogSink::Open(options) == nullptr);
+}
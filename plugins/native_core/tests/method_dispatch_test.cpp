@@ -0,0 +1,387 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Built against the Flutter C++ wrapper, which the dispatcher is written
+// on; see FLUTTER_CPP_CLIENT_WRAPPER in CMakeLists.txt.
+
+#include <flutter/encodable_value.h>
+#include <flutter/method_call.h>
+#include <flutter/method_result_functions.h>
+#include <flutter/standard_message_codec.h>
+#include <native_core/call_recorder.h>
+#include <native_core/method_dispatch.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test_support.h"
+
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+using native_core::MethodArguments;
+using native_core::MethodDispatcher;
+
+namespace {
+
+using Result = std::unique_ptr<flutter::MethodResult<>>;
+
+// How a call was answered.
+struct Answer {
+  enum Kind { kNone, kSuccess, kError, kNotImplemented } kind = kNone;
+  EncodableValue value;
+  std::string code;
+};
+
+Result Capture(Answer* answer) {
+  return std::make_unique<flutter::MethodResultFunctions<>>(
+      [answer](const EncodableValue* value) {
+        answer->kind = Answer::kSuccess;
+        answer->value = value ? *value : EncodableValue();
+      },
+      [answer](const std::string& code, const std::string&,
+               const EncodableValue*) {
+        answer->kind = Answer::kError;
+        answer->code = code;
+      },
+      [answer]() { answer->kind = Answer::kNotImplemented; });
+}
+
+EncodableValue Map(std::initializer_list<std::pair<const char*, EncodableValue>>
+                       fields) {
+  EncodableMap map;
+  for (const auto& [name, value] : fields) {
+    map[EncodableValue(name)] = value;
+  }
+  return EncodableValue(std::move(map));
+}
+
+class FakePlugin {
+ public:
+  using Dispatcher = MethodDispatcher<FakePlugin>;
+
+  static const Dispatcher::Table& Methods() {
+    static constexpr Dispatcher::Table kMethods = {
+        {"echo", &FakePlugin::Echo},
+        {"fail", &FakePlugin::Fail},
+        {"keepBody", &FakePlugin::KeepBody},
+        {"later", &FakePlugin::Later},
+    };
+    return kMethods;
+  }
+
+  void Echo(const MethodArguments& arguments, Result result) {
+    calls.push_back("echo");
+    const std::string& text = arguments.Get<std::string>("text");
+    if (!arguments.ok()) {
+      result->Error("request_error", "Falta el texto.");
+      return;
+    }
+    result->Success(EncodableValue(text));
+  }
+
+  void Fail(const MethodArguments&, Result result) {
+    calls.push_back("fail");
+    result->Error("failed", "Siempre falla.");
+  }
+
+  void KeepBody(const MethodArguments& arguments, Result result) {
+    calls.push_back("keepBody");
+    body = &arguments.Get<std::vector<uint8_t>>("body");
+    result->Success();
+  }
+
+  // Answers after the handler returns, as work run on the pool does.
+  void Later(const MethodArguments&, Result result) {
+    calls.push_back("later");
+    pending = std::move(result);
+  }
+
+  std::vector<std::string> calls;
+  const std::vector<uint8_t>* body = nullptr;
+  Result pending;
+};
+
+Answer Call(FakePlugin::Dispatcher* dispatcher,
+            FakePlugin* plugin,
+            const std::string& method,
+            std::unique_ptr<EncodableValue> arguments = nullptr) {
+  Answer answer;
+  flutter::MethodCall<> call(method, std::move(arguments));
+  dispatcher->Dispatch(plugin, call, Capture(&answer));
+  return answer;
+}
+
+// |field| of the stats of |method|, or -1 if |method| is not in |stats|.
+int64_t StatOf(const EncodableValue& stats,
+               const char* method,
+               const char* field) {
+  const auto& methods = std::get<EncodableMap>(stats);
+  auto it = methods.find(EncodableValue(method));
+  if (it == methods.end()) {
+    return -1;
+  }
+  return std::get<EncodableMap>(it->second)
+      .at(EncodableValue(field))
+      .LongValue();
+}
+
+size_t Encoded(const EncodableValue& value) {
+  return flutter::StandardMessageCodec::GetInstance()
+      .EncodeMessage(value)
+      ->size();
+}
+
+}  // namespace
+
+TEST(ArgumentsAreReadByReference) {
+  EncodableValue value = Map({
+      {"text", EncodableValue("hola")},
+      {"body", EncodableValue(std::vector<uint8_t>(1000, 7))},
+      {"small", EncodableValue(int32_t{5})},
+      {"large", EncodableValue(int64_t{1} << 40)},
+      {"flag", EncodableValue(true)},
+      {"none", EncodableValue()},
+      {"list", EncodableValue(EncodableList{EncodableValue("a"),
+                                            EncodableValue(int32_t{2})})},
+  });
+  MethodArguments arguments(&value);
+  const auto& map = std::get<EncodableMap>(value);
+
+  const std::vector<uint8_t>& body =
+      arguments.Get<std::vector<uint8_t>>("body");
+  // The very bytes of the call, not a copy.
+  EXPECT_TRUE(&body == &std::get<std::vector<uint8_t>>(
+                           map.at(EncodableValue("body"))));
+  EXPECT_TRUE(&arguments.Get<std::string>("text") ==
+              &std::get<std::string>(map.at(EncodableValue("text"))));
+  EXPECT_EQ(arguments.Integer("small"), 5);
+  EXPECT_EQ(arguments.Integer("large"), int64_t{1} << 40);
+  EXPECT_TRUE(arguments.Get<bool>("flag"));
+  const EncodableList& list = arguments.Get<EncodableList>("list");
+  EXPECT_EQ(arguments.Get<std::string>(list, 0), "a");
+  EXPECT_EQ(arguments.Get<int32_t>(list, 1), 2);
+  EXPECT_TRUE(arguments.Optional<std::string>("none") == nullptr);
+  EXPECT_TRUE(arguments.Optional<std::string>("missing") == nullptr);
+  EXPECT_TRUE(arguments.As<EncodableMap>() == &map);
+  EXPECT_TRUE(arguments.As<EncodableList>() == nullptr);
+  // Nothing read so far failed.
+  EXPECT_TRUE(arguments.ok());
+}
+
+TEST(BadArgumentsFailWithoutThrowing) {
+  EncodableValue value = Map({
+      {"text", EncodableValue(int32_t{3})},
+      {"none", EncodableValue()},
+      {"list", EncodableValue(EncodableList{EncodableValue("a")})},
+  });
+
+  {
+    MethodArguments arguments(&value);
+    // Of another type.
+    EXPECT_EQ(arguments.Get<std::string>("text"), "");
+    EXPECT_FALSE(arguments.ok());
+  }
+  {
+    MethodArguments arguments(&value);
+    EXPECT_TRUE(arguments.Get<std::vector<uint8_t>>("missing").empty());
+    EXPECT_FALSE(arguments.ok());
+  }
+  {
+    MethodArguments arguments(&value);
+    // Null is not a value of the type asked for.
+    EXPECT_EQ(arguments.Get<std::string>("none"), "");
+    EXPECT_FALSE(arguments.ok());
+  }
+  {
+    MethodArguments arguments(&value);
+    EXPECT_EQ(arguments.Integer("none"), 0);
+    EXPECT_FALSE(arguments.ok());
+  }
+  {
+    MethodArguments arguments(&value);
+    // Optional ones may be missing or null, but not of another type.
+    EXPECT_TRUE(arguments.Optional<std::string>("none") == nullptr);
+    EXPECT_TRUE(arguments.ok());
+    EXPECT_TRUE(arguments.Optional<std::string>("text") == nullptr);
+    EXPECT_FALSE(arguments.ok());
+  }
+  {
+    MethodArguments arguments(&value);
+    const EncodableList& list = arguments.Get<EncodableList>("list");
+    EXPECT_EQ(arguments.Get<std::string>(list, 1), "");
+    EXPECT_FALSE(arguments.ok());
+  }
+  {
+    // No arguments at all, or not a map.
+    MethodArguments none(nullptr);
+    EXPECT_EQ(none.Get<std::string>("text"), "");
+    EXPECT_FALSE(none.ok());
+    EncodableValue list(EncodableList{});
+    MethodArguments not_a_map(&list);
+    EXPECT_TRUE(not_a_map.Optional<bool>("flag") == nullptr);
+    EXPECT_TRUE(not_a_map.As<EncodableList>() != nullptr);
+    EXPECT_TRUE(not_a_map.ok());
+  }
+}
+
+TEST(CallsReachTheirHandlers) {
+  FakePlugin plugin;
+  FakePlugin::Dispatcher dispatcher("test/channel", &FakePlugin::Methods());
+
+  Answer echo = Call(&dispatcher, &plugin, "echo",
+                     std::make_unique<EncodableValue>(
+                         Map({{"text", EncodableValue("hola")}})));
+  EXPECT_EQ(echo.kind, Answer::kSuccess);
+  EXPECT_TRUE(echo.value == EncodableValue("hola"));
+
+  Answer missing = Call(&dispatcher, &plugin, "echo");
+  EXPECT_EQ(missing.kind, Answer::kError);
+  EXPECT_EQ(missing.code, "request_error");
+
+  EXPECT_EQ(Call(&dispatcher, &plugin, "fail").kind, Answer::kError);
+  EXPECT_EQ(Call(&dispatcher, &plugin, "unknown").kind,
+            Answer::kNotImplemented);
+  EXPECT_EQ(Call(&dispatcher, &plugin, "Echo").kind, Answer::kNotImplemented);
+
+  std::vector<std::string> expected = {"echo", "echo", "fail"};
+  EXPECT_TRUE(plugin.calls == expected);
+}
+
+TEST(BinaryPayloadsAreNotCopied) {
+  FakePlugin plugin;
+  FakePlugin::Dispatcher dispatcher("test/channel", &FakePlugin::Methods());
+  auto arguments = std::make_unique<EncodableValue>(
+      Map({{"body", EncodableValue(std::vector<uint8_t>(1 << 20, 1))}}));
+  const auto* body = &std::get<std::vector<uint8_t>>(
+      std::get<EncodableMap>(*arguments).at(EncodableValue("body")));
+
+  Answer answer;
+  flutter::MethodCall<> call("keepBody", std::move(arguments));
+  dispatcher.Dispatch(&plugin, call, Capture(&answer));
+  EXPECT_EQ(answer.kind, Answer::kSuccess);
+  EXPECT_TRUE(plugin.body == body);
+}
+
+TEST(StatsAreKeptPerMethod) {
+  FakePlugin plugin;
+  FakePlugin::Dispatcher dispatcher("test/channel", &FakePlugin::Methods());
+  for (int i = 0; i < 3; i++) {
+    Call(&dispatcher, &plugin, "echo",
+         std::make_unique<EncodableValue>(Map({{"text", EncodableValue("")}})));
+  }
+  Call(&dispatcher, &plugin, "echo");
+  Call(&dispatcher, &plugin, "fail");
+  Call(&dispatcher, &plugin, "fail");
+  Call(&dispatcher, &plugin, "unknown");
+
+  EncodableValue stats = dispatcher.Stats();
+  EXPECT_EQ(StatOf(stats, "echo", "calls"), 4);
+  EXPECT_EQ(StatOf(stats, "echo", "errors"), 1);
+  EXPECT_EQ(StatOf(stats, "fail", "calls"), 2);
+  EXPECT_EQ(StatOf(stats, "fail", "errors"), 2);
+  EXPECT_TRUE(StatOf(stats, "echo", "handlerMax") >=
+              StatOf(stats, "echo", "handlerP50"));
+  // Methods never called, and unknown ones, are left out.
+  EXPECT_EQ(StatOf(stats, "keepBody", "calls"), -1);
+  EXPECT_EQ(StatOf(stats, "unknown", "calls"), -1);
+  EXPECT_EQ(std::get<EncodableMap>(stats).size(), 2u);
+}
+
+TEST(LateAnswersAreTimedWhenTheyComeIn) {
+  FakePlugin plugin;
+  FakePlugin::Dispatcher dispatcher("test/channel", &FakePlugin::Methods());
+  Answer answer = Call(&dispatcher, &plugin, "later");
+  EXPECT_EQ(answer.kind, Answer::kNone);
+  ASSERT_TRUE(plugin.pending != nullptr);
+  EXPECT_EQ(StatOf(dispatcher.Stats(), "later", "calls"), 1);
+
+  plugin.pending->Error("late", "Falla más tarde.");
+  EXPECT_EQ(StatOf(dispatcher.Stats(), "later", "errors"), 1);
+}
+
+TEST(EncodedSizesMatchTheCodec) {
+  std::vector<EncodableValue> values = {
+      EncodableValue(),
+      EncodableValue(true),
+      EncodableValue(int32_t{-1}),
+      EncodableValue(int64_t{1} << 40),
+      EncodableValue(3.5),
+      EncodableValue(""),
+      EncodableValue(std::string(253, 'a')),
+      EncodableValue(std::string(254, 'a')),
+      EncodableValue(std::string(0x10000, 'a')),
+      EncodableValue(std::vector<uint8_t>(300, 1)),
+      EncodableValue(std::vector<int32_t>{1, 2, 3}),
+      EncodableValue(std::vector<int64_t>{1}),
+      EncodableValue(std::vector<int64_t>{}),
+      EncodableValue(std::vector<double>{1.0, 2.0}),
+      EncodableValue(std::vector<float>{1.0f}),
+  };
+  // The same inside collections, where numbers land at every alignment.
+  EncodableList list;
+  for (size_t shift = 0; shift < 8; shift++) {
+    for (const EncodableValue& value : values) {
+      list.push_back(EncodableValue(std::string(shift, 'x')));
+      list.push_back(value);
+    }
+  }
+  values.push_back(EncodableValue(list));
+  values.push_back(Map({
+      {"presign", EncodableValue(list)},
+      {"time", EncodableValue(2.5)},
+      {"data", EncodableValue(std::vector<uint8_t>(70000, 3))},
+      {"nested", Map({{"id", EncodableValue(int32_t{1})}})},
+  }));
+  for (const EncodableValue& value : values) {
+    EXPECT_EQ(native_core::internal::EncodedSize(value), Encoded(value));
+  }
+}
+
+TEST(TracedCallsKeepSizesWithoutPayloads) {
+  // Only in the run with PORTAFIRMAS_CALL_TRACE set; see CMakeLists.txt.
+  native_core::CallRecorder* recorder = native_core::CallRecorder::Get();
+  if (!recorder) {
+    return;
+  }
+  EXPECT_FALSE(recorder->payloads());
+  FakePlugin plugin;
+  FakePlugin::Dispatcher dispatcher("test/channel", &FakePlugin::Methods());
+  EncodableValue arguments = Map({
+      {"text", EncodableValue(std::string(300, 't'))},
+      {"time", EncodableValue(1.5)},
+      {"data", EncodableValue(std::vector<int64_t>{1, 2})},
+  });
+  Call(&dispatcher, &plugin, "echo",
+       std::make_unique<EncodableValue>(arguments));
+  Call(&dispatcher, &plugin, "fail");
+  recorder->Flush();
+
+  std::vector<native_core::TracedCall> calls;
+  std::string error;
+  ASSERT_TRUE(native_core::ReadCallTrace(
+      std::getenv("PORTAFIRMAS_CALL_TRACE"), &calls, &error));
+  ASSERT_TRUE(calls.size() == 2);
+  EXPECT_EQ(calls[0].method, "echo");
+  EXPECT_EQ(calls[0].argument_size, Encoded(arguments));
+  EXPECT_EQ(calls[0].result_size,
+            Encoded(EncodableValue(std::string(300, 't'))));
+  EXPECT_FALSE(calls[0].payload.has_value());
+  EXPECT_EQ(calls[1].argument_size, Encoded(EncodableValue()));
+  EXPECT_TRUE(calls[1].outcome == native_core::CallOutcome::kError);
+}
@@ -0,0 +1,121 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <native_core/method_table.h>
+
+#include <string>
+#include <string_view>
+
+#include "test_support.h"
+
+using native_core::MethodTable;
+
+namespace {
+
+// The methods of the portafirmas_native channel, as an example of a real
+// table, each with its position as the handler.
+constexpr MethodTable<int> kPluginMethods = {
+    {"createParser", 0},
+    {"feed", 1},
+    {"finish", 2},
+    {"disposeParser", 3},
+    {"signBatch", 4},
+    {"resumeBatch", 5},
+    {"cancelBatch", 6},
+    {"journalOpen", 7},
+    {"journalPending", 8},
+    {"cadesSign", 9},
+    {"padesSign", 10},
+    {"httpPost", 11},
+    {"httpStats", 12},
+    {"httpClearSession", 13},
+    {"httpCompressRequests", 14},
+    {"logOpen", 15},
+    {"logWrite", 16},
+    {"logFlush", 17},
+    {"logStats", 18},
+    {"cacheOpen", 19},
+    {"cacheLoad", 20},
+    {"cacheRemove", 21},
+    {"searchQuery", 22},
+    {"searchClear", 23},
+    {"searchStats", 24},
+    {"buildPresignBody", 25},
+    {"buildPostsignBody", 26},
+    {"buildApproveBody", 27},
+    {"buildRejectBody", 28},
+    {"callStats", 29},
+};
+
+#define METHOD(n) {"method" #n, n}
+#define METHODS8(n)                                                      \
+  METHOD(n##0), METHOD(n##1), METHOD(n##2), METHOD(n##3), METHOD(n##4), \
+      METHOD(n##5), METHOD(n##6), METHOD(n##7)
+
+// As many methods as a table holds.
+constexpr MethodTable<int> kFullTable = {
+    METHODS8(1), METHODS8(2), METHODS8(3), METHODS8(4),
+    METHODS8(5), METHODS8(6), METHODS8(7), METHODS8(8),
+};
+
+#undef METHODS8
+#undef METHOD
+
+// Looked up by the compiler, too.
+static_assert(kPluginMethods.IndexOf("feed") == 1, "feed is found");
+static_assert(kPluginMethods.IndexOf("fee") == -1, "prefixes are misses");
+static_assert(kFullTable.size() == MethodTable<int>::kMaxMethods,
+              "the full table is full");
+
+}  // namespace
+
+TEST(EveryMethodIsFound) {
+  for (size_t i = 0; i < kPluginMethods.size(); i++) {
+    std::string_view name = kPluginMethods[i].name;
+    int index = kPluginMethods.IndexOf(name);
+    EXPECT_EQ(index, static_cast<int>(i));
+    ASSERT_TRUE(index >= 0);
+    EXPECT_EQ(kPluginMethods[index].handler, static_cast<int>(i));
+    // Found by its contents, not by the pointer of the literal.
+    EXPECT_EQ(kPluginMethods.IndexOf(std::string(name)), index);
+  }
+  EXPECT_EQ(kPluginMethods.size(), 30u);
+}
+
+TEST(OtherNamesAreMisses) {
+  for (const char* name :
+       {"", "Feed", "feed ", "fee", "feedd", "logwrite", "log", "unknown",
+        "httpPostX", "searchQueryAll", "callStat"}) {
+    EXPECT_EQ(kPluginMethods.IndexOf(name), -1);
+  }
+  // A name with an embedded NUL is not cut there.
+  EXPECT_EQ(kPluginMethods.IndexOf(std::string_view("feed\0", 5)), -1);
+}
+
+TEST(FullTableFindsEveryMethod) {
+  for (size_t i = 0; i < kFullTable.size(); i++) {
+    std::string_view name = kFullTable[i].name;
+    EXPECT_EQ(kFullTable.IndexOf(name), static_cast<int>(i));
+    EXPECT_EQ(kFullTable.IndexOf(std::string(name) + "0"), -1);
+  }
+  EXPECT_EQ(kFullTable.IndexOf("method9"), -1);
+  EXPECT_EQ(kFullTable.IndexOf("method90"), -1);
+}
+
+TEST(EmptyTableFindsNothing) {
+  constexpr MethodTable<int> kEmpty = {};
+  EXPECT_EQ(kEmpty.size(), 0u);
+  EXPECT_EQ(kEmpty.IndexOf(""), -1);
+  EXPECT_EQ(kEmpty.IndexOf("feed"), -1);
+}
@@ -0,0 +1,156 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/mpsc_queue.h>
+#include <native_core/mpsc_ring.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::MpscQueue;
+using native_core::MpscRing;
+
+namespace {
+
+constexpr int kProducers = 4;
+constexpr uint32_t kPerProducer = 100000;
+
+// A value that tells which producer pushed it and in which order.
+uint64_t Tag(uint32_t producer, uint32_t sequence) {
+  return (uint64_t{producer} << 32) | sequence;
+}
+
+// Pops from |pop| until every producer's values have arrived, checking that
+// each producer's values arrive in the order they were pushed.
+template <typename Pop>
+void ConsumeAll(Pop pop) {
+  std::vector<uint32_t> next(kProducers, 0);
+  uint64_t received = 0;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  uint64_t value;
+  while (received < uint64_t{kProducers} * kPerProducer) {
+    if (!pop(&value)) {
+      ASSERT_TRUE(std::chrono::steady_clock::now() < deadline);
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t producer = static_cast<uint32_t>(value >> 32);
+    ASSERT_TRUE(producer < kProducers);
+    EXPECT_EQ(static_cast<uint32_t>(value), next[producer]);
+    next[producer] = static_cast<uint32_t>(value) + 1;
+    received++;
+  }
+  EXPECT_FALSE(pop(&value));
+}
+
+}  // namespace
+
+TEST(MpscQueuePopsInOrder) {
+  MpscQueue<int> queue;
+  int value = -1;
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_FALSE(queue.TryPop(&value));
+  for (int i = 0; i < 10; i++) {
+    queue.Push(i);
+  }
+  EXPECT_FALSE(queue.IsEmpty());
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_FALSE(queue.TryPop(&value));
+}
+
+TEST(MpscQueueFreesWhatIsLeft) {
+  // Run under ASan, a leak here fails the test.
+  auto counted = std::make_shared<int>(0);
+  {
+    MpscQueue<std::shared_ptr<int>> queue;
+    for (int i = 0; i < 100; i++) {
+      queue.Push(counted);
+    }
+    std::shared_ptr<int> value;
+    EXPECT_TRUE(queue.TryPop(&value));
+  }
+  EXPECT_EQ(counted.use_count(), 1L);
+}
+
+TEST(MpscQueueKeepsEachProducersOrder) {
+  MpscQueue<uint64_t> queue;
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < kProducers; p++) {
+    producers.emplace_back([&queue, p]() {
+      for (uint32_t i = 0; i < kPerProducer; i++) {
+        queue.Push(Tag(p, i));
+      }
+    });
+  }
+  ConsumeAll([&queue](uint64_t* value) { return queue.TryPop(value); });
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+}
+
+TEST(MpscRingRoundsCapacityUp) {
+  EXPECT_EQ(MpscRing<int>(0).capacity(), size_t{2});
+  EXPECT_EQ(MpscRing<int>(3).capacity(), size_t{4});
+  EXPECT_EQ(MpscRing<int>(64).capacity(), size_t{64});
+  EXPECT_EQ(MpscRing<int>(65).capacity(), size_t{128});
+}
+
+TEST(MpscRingRefusesWhenFullAndWrapsAround) {
+  MpscRing<std::unique_ptr<int>> ring(4);
+  for (int lap = 0; lap < 3; lap++) {
+    for (int i = 0; i < 4; i++) {
+      auto value = std::make_unique<int>(lap * 10 + i);
+      ASSERT_TRUE(ring.TryPush(value));
+      EXPECT_TRUE(value == nullptr);
+    }
+    auto extra = std::make_unique<int>(99);
+    EXPECT_FALSE(ring.TryPush(extra));
+    // A refused value is left with the caller.
+    ASSERT_TRUE(extra != nullptr);
+    EXPECT_EQ(*extra, 99);
+    std::unique_ptr<int> value;
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(ring.TryPop(&value));
+      EXPECT_EQ(*value, lap * 10 + i);
+    }
+    EXPECT_FALSE(ring.TryPop(&value));
+  }
+}
+
+TEST(MpscRingKeepsEachProducersOrder) {
+  MpscRing<uint64_t> ring(1024);
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < kProducers; p++) {
+    producers.emplace_back([&ring, p]() {
+      for (uint32_t i = 0; i < kPerProducer; i++) {
+        uint64_t value = Tag(p, i);
+        while (!ring.TryPush(value)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  ConsumeAll([&ring](uint64_t* value) { return ring.TryPop(value); });
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+}
@@ -0,0 +1,70 @@
+# Copyright 2022. Chema Molins.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Signs a synthetic PDF of MEGABYTES (500 by default) with pades_sign and
+# fails if the signer's peak memory grows with the document: the file is
+# streamed, so MAX_RSS_MB (64 by default) is plenty for any size. Labelled
+# "benchmark" in ctest (ctest -LE benchmark leaves it out), or by hand:
+#
+#   cmake -DPADES_SIGN=path/to/pades_sign -DKEY=tests/data/file_key.pem
+#       -DWORK=/tmp/pades -P tests/pades_benchmark.cmake
+foreach(variable PADES_SIGN KEY WORK)
+  if(NOT DEFINED ${variable})
+    message(FATAL_ERROR "${variable} is not set")
+  endif()
+endforeach()
+if(NOT DEFINED MEGABYTES)
+  set(MEGABYTES 500)
+endif()
+if(NOT DEFINED MAX_RSS_MB)
+  set(MAX_RSS_MB 64)
+endif()
+
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+foreach(xref table stream)
+  set(input "${WORK}/${xref}.pdf")
+  set(output "${WORK}/${xref}.signed.pdf")
+  set(generate --generate ${MEGABYTES} "${input}")
+  if(xref STREQUAL "stream")
+    list(APPEND generate --xref-stream)
+  endif()
+  execute_process(COMMAND "${PADES_SIGN}" ${generate} RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Cannot generate a ${MEGABYTES} MB document")
+  endif()
+  execute_process(COMMAND "${PADES_SIGN}" "${KEY}" "${input}" "${output}"
+    RESULT_VARIABLE result OUTPUT_VARIABLE report ERROR_VARIABLE report)
+  string(STRIP "${report}" report)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pades_sign failed: ${report}")
+  endif()
+  message(STATUS "cross-reference ${xref}: ${report}")
+
+  file(SIZE "${input}" input_size)
+  file(SIZE "${output}" output_size)
+  math(EXPR update_size "${output_size} - ${input_size}")
+  if(update_size LESS_EQUAL 0 OR update_size GREATER 65536)
+    message(FATAL_ERROR "The incremental update takes ${update_size} bytes")
+  endif()
+  if(NOT report MATCHES "peak RSS ([0-9]+) KB")
+    message(FATAL_ERROR "No peak RSS in the report")
+  endif()
+  math(EXPR limit "${MAX_RSS_MB} * 1024")
+  if(CMAKE_MATCH_1 GREATER limit)
+    message(FATAL_ERROR "Peak RSS ${CMAKE_MATCH_1} KB is over ${limit} KB")
+  endif()
+  file(REMOVE "${input}" "${output}")
+endforeach()
+file(REMOVE_RECURSE "${WORK}")
@@ -0,0 +1,358 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Signs the PDF files of tests/data/pades and checks the output as a PAdES
+// validator would: the input is left untouched before an incremental update
+// that the PDF reader opens, the signature field is reachable from the form
+// and the first page, the /ByteRange covers the whole file but /Contents,
+// and /Contents is a detached CMS signature of those ranges, without the
+// signing-time attribute. The inputs are:
+//
+//   table.pdf, xref_stream.pdf    one page, cross-reference table or stream
+//   object_streams.pdf            catalog and page inside an object stream
+//   incremental.pdf               table.pdf with an incremental update
+//   form.pdf                      a form with a field named Signature1
+//   encrypted.pdf, certified.pdf  refused: encrypted, or certified with no
+//   damaged.pdf                   changes allowed; cut two thirds of the way
+//
+// table.signed.pdf is table.pdf signed at kSigningTime with the key of
+// tests/data/file_key.pem, which SignPdf() must reproduce. ctest passes the
+// directory in TEST_DATA and the key in TEST_KEY.
+#include <native_core/file_key_signer.h>
+#include <native_core/pades_signer.h>
+#include <native_core/pdf_document.h>
+
+#include <openssl/bio.h>
+#include <openssl/cms.h>
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::DigestAlgorithm;
+using native_core::FileKeySigner;
+using native_core::PadesOptions;
+using native_core::PadesResult;
+using native_core::PdfDocument;
+using native_core::PdfObject;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+// 2022-06-01 12:00:00 UTC, the signing time of table.signed.pdf.
+constexpr int64_t kSigningTime = 1654084800;
+
+constexpr const char* kSignable[] = {
+    "table.pdf",       "xref_stream.pdf", "object_streams.pdf",
+    "incremental.pdf", "form.pdf",
+};
+
+std::string DataPath(const std::string& name) {
+  const char* directory = std::getenv("TEST_DATA");
+  return std::string(directory ? directory : ".") + "/pades/" + name;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+std::unique_ptr<FileKeySigner> OpenKey() {
+  const char* path = std::getenv("TEST_KEY");
+  std::string error;
+  return path ? FileKeySigner::Open(path, &error) : nullptr;
+}
+
+PadesOptions Options(DigestAlgorithm digest = DigestAlgorithm::kSha256) {
+  PadesOptions options;
+  options.digest = digest;
+  options.reason = "Firma de prueba";
+  options.location = "Cádiz";
+  options.signing_time = std::chrono::system_clock::time_point(
+      std::chrono::seconds(kSigningTime));
+  return options;
+}
+
+// A signature of a signed file, as found through the form.
+struct FoundSignature {
+  std::string field_name;
+  std::vector<int64_t> byte_range;
+  std::string contents;
+  std::string sub_filter;
+  bool has_time = false;
+};
+
+// The signatures of every signature field of |document| that has a value.
+std::vector<FoundSignature> FindSignatures(PdfDocument* document) {
+  std::vector<FoundSignature> found;
+  const PdfObject* catalog = document->Catalog();
+  const PdfObject* form =
+      catalog ? document->Resolve(catalog->Find("AcroForm")) : nullptr;
+  const PdfObject* fields =
+      form ? document->Resolve(form->Find("Fields")) : nullptr;
+  if (!fields) {
+    return found;
+  }
+  for (const PdfObject& item : fields->items) {
+    const PdfObject* field = document->Resolve(&item);
+    const PdfObject* type = field ? field->Find("FT") : nullptr;
+    const PdfObject* value =
+        field ? document->Resolve(field->Find("V")) : nullptr;
+    if (!type || !type->IsName("Sig") || !value) {
+      continue;
+    }
+    FoundSignature signature;
+    if (const PdfObject* name = field->Find("T")) {
+      signature.field_name = name->text;
+    }
+    if (const PdfObject* range = document->Resolve(value->Find("ByteRange"))) {
+      for (const PdfObject& number : range->items) {
+        signature.byte_range.push_back(
+            static_cast<int64_t>(number.Number()));
+      }
+    }
+    if (const PdfObject* contents = value->Find("Contents")) {
+      signature.contents = contents->text;
+    }
+    if (const PdfObject* sub_filter = value->Find("SubFilter")) {
+      signature.sub_filter = sub_filter->text;
+    }
+    signature.has_time = value->Find("M") != nullptr;
+    found.push_back(std::move(signature));
+  }
+  return found;
+}
+
+// Whether the detached CMS signature |der| verifies over |content|, trusting
+// the certificate it carries, and carries no signing-time attribute.
+bool CmsVerifies(const std::string& der, const std::string& content) {
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(der.data());
+  CMS_ContentInfo* cms =
+      d2i_CMS_ContentInfo(nullptr, &data, static_cast<long>(der.size()));
+  if (!cms) {
+    return false;
+  }
+  STACK_OF(X509)* certificates = CMS_get1_certs(cms);
+  X509_STORE* store = X509_STORE_new();
+  for (int i = 0; i < sk_X509_num(certificates); i++) {
+    X509_STORE_add_cert(store, sk_X509_value(certificates, i));
+  }
+  // The test certificate has no key usage for document signing.
+  X509_STORE_set_purpose(store, X509_PURPOSE_ANY);
+  BIO* input =
+      BIO_new_mem_buf(content.data(), static_cast<int>(content.size()));
+  bool ok = CMS_verify(cms, nullptr, store, input, nullptr,
+                       CMS_BINARY) == 1;
+  STACK_OF(CMS_SignerInfo)* infos = CMS_get0_SignerInfos(cms);
+  ok = ok && sk_CMS_SignerInfo_num(infos) == 1 &&
+       CMS_signed_get_attr_by_NID(sk_CMS_SignerInfo_value(infos, 0),
+                                  NID_pkcs9_signingTime, -1) < 0 &&
+       CMS_signed_get_attr_by_NID(sk_CMS_SignerInfo_value(infos, 0),
+                                  NID_id_smime_aa_signingCertificateV2,
+                                  -1) >= 0;
+  BIO_free(input);
+  X509_STORE_free(store);
+  sk_X509_pop_free(certificates, X509_free);
+  CMS_ContentInfo_free(cms);
+  return ok;
+}
+
+// Whether |signature| covers the first |size| bytes of |file| but its
+// /Contents, and verifies over them.
+bool CoversAndVerifies(const FoundSignature& signature, const std::string& file,
+                       size_t size) {
+  const std::vector<int64_t>& range = signature.byte_range;
+  if (range.size() != 4 || range[0] != 0 || range[1] <= 0 ||
+      range[2] <= range[1] || range[3] < 0 ||
+      static_cast<size_t>(range[2] + range[3]) != size || size > file.size()) {
+    return false;
+  }
+  // The gap is exactly the hex string of /Contents, delimiters included.
+  size_t gap = static_cast<size_t>(range[2] - range[1]);
+  if (file[range[1]] != '<' || file[range[2] - 1] != '>' ||
+      gap != signature.contents.size() * 2 + 2) {
+    return false;
+  }
+  std::string signed_bytes = file.substr(0, range[1]) +
+                             file.substr(range[2], range[3]);
+  return CmsVerifies(signature.contents, signed_bytes);
+}
+
+// Checks |output|, signed from |input|, and returns its signatures, the new
+// one last.
+std::vector<FoundSignature> Validate(const std::string& input,
+                                     const std::string& output) {
+  std::string before = ReadFile(input);
+  std::string after = ReadFile(output);
+  EXPECT_TRUE(after.size() > before.size());
+  EXPECT_TRUE(after.compare(0, before.size(), before) == 0);
+
+  std::string error;
+  std::unique_ptr<PdfDocument> original = PdfDocument::Open(input, &error);
+  std::unique_ptr<PdfDocument> document = PdfDocument::Open(output, &error);
+  if (!original || !document) {
+    EXPECT_TRUE(original && document);
+    return {};
+  }
+  const PdfObject* previous = document->trailer().Find("Prev");
+  EXPECT_TRUE(previous && previous->Number() == original->last_xref_offset());
+  EXPECT_EQ(document->PageCount(), original->PageCount());
+
+  const PdfObject* catalog = document->Catalog();
+  const PdfObject* form =
+      catalog ? document->Resolve(catalog->Find("AcroForm")) : nullptr;
+  const PdfObject* flags = form ? document->Resolve(form->Find("SigFlags"))
+                                : nullptr;
+  EXPECT_TRUE(flags && flags->Number() == 3);
+
+  std::vector<FoundSignature> signatures = FindSignatures(document.get());
+  if (signatures.empty()) {
+    EXPECT_FALSE(signatures.empty());
+    return signatures;
+  }
+  const FoundSignature& signature = signatures.back();
+  EXPECT_EQ(signature.sub_filter, std::string("ETSI.CAdES.detached"));
+  EXPECT_TRUE(signature.has_time);
+  EXPECT_TRUE(CoversAndVerifies(signature, after, after.size()));
+
+  // Field names are unique, and the widget is an annotation of page one.
+  std::set<std::string> names;
+  for (const FoundSignature& found : signatures) {
+    names.insert(found.field_name);
+  }
+  EXPECT_EQ(names.size(), signatures.size());
+  PdfObject page_reference;
+  EXPECT_TRUE(document->PageReference(0, &page_reference));
+  const PdfObject* page = document->Resolve(&page_reference);
+  const PdfObject* annotations =
+      page ? document->Resolve(page->Find("Annots")) : nullptr;
+  bool widget = false;
+  for (size_t i = 0; annotations && i < annotations->items.size(); i++) {
+    const PdfObject* annotation = document->Resolve(&annotations->items[i]);
+    const PdfObject* name = annotation ? annotation->Find("T") : nullptr;
+    widget = widget || (name && name->text == signature.field_name);
+  }
+  EXPECT_TRUE(widget);
+  return signatures;
+}
+
+bool Sign(FileKeySigner* signer, const std::string& input,
+          const std::string& output, const PadesOptions& options,
+          std::string* error) {
+  PadesResult result;
+  return native_core::SignPdf(signer, input, output, options, &result, error);
+}
+
+}  // namespace
+
+TEST(SignedFixturesValidate) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  for (const char* name : kSignable) {
+    std::string output = directory.File(name);
+    std::string error;
+    EXPECT_TRUE(Sign(signer.get(), DataPath(name), output, Options(), &error));
+    EXPECT_EQ(Validate(DataPath(name), output).size(), size_t{1});
+  }
+}
+
+TEST(ReferenceSignatureIsReproduced) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  std::string output = directory.File("table.signed.pdf");
+  std::string error;
+  ASSERT_TRUE(Sign(signer.get(), DataPath("table.pdf"), output, Options(),
+                   &error));
+  std::string expected = ReadFile(DataPath("table.signed.pdf"));
+  ASSERT_TRUE(!expected.empty());
+  EXPECT_TRUE(ReadFile(output) == expected);
+  EXPECT_EQ(Validate(DataPath("table.pdf"), DataPath("table.signed.pdf")).size(),
+            size_t{1});
+}
+
+TEST(EveryDigestValidates) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  for (DigestAlgorithm digest :
+       {DigestAlgorithm::kSha1, DigestAlgorithm::kSha256,
+        DigestAlgorithm::kSha384, DigestAlgorithm::kSha512}) {
+    std::string output = directory.File("signed.pdf");
+    std::string error;
+    EXPECT_TRUE(Sign(signer.get(), DataPath("xref_stream.pdf"), output,
+                     Options(digest), &error));
+    EXPECT_EQ(Validate(DataPath("xref_stream.pdf"), output).size(), size_t{1});
+  }
+}
+
+TEST(SignedFilesCanBeSignedAgain) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  std::string once = DataPath("table.signed.pdf");
+  std::string twice = directory.File("twice.pdf");
+  std::string error;
+  ASSERT_TRUE(Sign(signer.get(), once, twice, Options(), &error));
+  std::vector<FoundSignature> signatures = Validate(once, twice);
+  ASSERT_TRUE(signatures.size() == 2);
+  // The first signature still covers exactly the first revision.
+  EXPECT_TRUE(CoversAndVerifies(signatures[0], ReadFile(twice),
+                                ReadFile(once).size()));
+}
+
+TEST(ChangedBytesDoNotVerify) {
+  std::string file = ReadFile(DataPath("table.signed.pdf"));
+  std::string error;
+  std::unique_ptr<PdfDocument> document =
+      PdfDocument::Open(DataPath("table.signed.pdf"), &error);
+  ASSERT_TRUE(document);
+  std::vector<FoundSignature> signatures = FindSignatures(document.get());
+  ASSERT_TRUE(signatures.size() == 1);
+  EXPECT_TRUE(CoversAndVerifies(signatures[0], file, file.size()));
+  // A byte of the page content, then one of the signature dictionary.
+  for (size_t offset : {file.find("Documento de prueba"), file.find("/M (")}) {
+    ASSERT_TRUE(offset != std::string::npos);
+    std::string changed = file;
+    changed[offset] ^= 1;
+    EXPECT_FALSE(CoversAndVerifies(signatures[0], changed, changed.size()));
+  }
+  // Anything appended falls outside the ranges.
+  EXPECT_FALSE(CoversAndVerifies(signatures[0], file + "\n", file.size() + 1));
+}
+
+TEST(UnsignableFilesFailWithoutOutput) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  for (const char* name :
+       {"encrypted.pdf", "certified.pdf", "damaged.pdf", "missing.pdf"}) {
+    std::string output = directory.File(name);
+    std::string error;
+    EXPECT_FALSE(Sign(signer.get(), DataPath(name), output, Options(), &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(std::filesystem::exists(output));
+  }
+}
@@ -0,0 +1,53 @@
+# Copyright 2022. Chema Molins.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Signs the PDF files of tests/data/pades with pades_sign and checks them
+# with the validators given: QPDF (qpdf --check) and PDFSIG (poppler's
+# pdfsig, whose signature must be valid; the test certificate is not
+# trusted). Run by ctest when either is found, or by hand:
+#
+#   cmake -DPADES_SIGN=path/to/pades_sign -DDATA=tests/data -DWORK=/tmp/pades
+#       -DQPDF=qpdf -DPDFSIG=pdfsig -P tests/pades_validate.cmake
+foreach(variable PADES_SIGN DATA WORK)
+  if(NOT DEFINED ${variable})
+    message(FATAL_ERROR "${variable} is not set")
+  endif()
+endforeach()
+
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+foreach(name table xref_stream object_streams incremental form)
+  set(input "${DATA}/pades/${name}.pdf")
+  set(output "${WORK}/${name}.signed.pdf")
+  execute_process(COMMAND "${PADES_SIGN}" "${DATA}/file_key.pem" "${input}"
+    "${output}" RESULT_VARIABLE result OUTPUT_QUIET ERROR_VARIABLE error)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pades_sign failed for ${name}.pdf: ${error}")
+  endif()
+  if(QPDF)
+    execute_process(COMMAND "${QPDF}" --check "${output}"
+      RESULT_VARIABLE result OUTPUT_VARIABLE report ERROR_VARIABLE report)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "qpdf --check fails for ${name}.pdf:\n${report}")
+    endif()
+  endif()
+  if(PDFSIG)
+    execute_process(COMMAND "${PDFSIG}" "${output}"
+      OUTPUT_VARIABLE report ERROR_VARIABLE report)
+    if(NOT report MATCHES "Signature Validation: Signature is Valid")
+      message(FATAL_ERROR "pdfsig rejects ${name}.pdf:\n${report}")
+    endif()
+  endif()
+endforeach()
+file(REMOVE_RECURSE "${WORK}")
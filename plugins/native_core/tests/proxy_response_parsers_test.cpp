@@ -0,0 +1,457 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The streaming parsers of the proxy responses, checked against the records
+// and messages of the Dart parsers in lib/api, and fed in every split of the
+// input to check that chunk boundaries change nothing.
+#include <native_core/proxy_response_parsers.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "test_support.h"
+
+using native_core::CreateResponseParser;
+using native_core::RecordTable;
+using native_core::ResponseKind;
+using native_core::ResponseParser;
+using native_core::StringTable;
+
+namespace {
+
+// Parses |xml| fed in chunks of |chunk| bytes.
+std::unique_ptr<ResponseParser> Parse(ResponseKind kind, std::string_view xml,
+                                      size_t chunk = std::string_view::npos) {
+  std::unique_ptr<ResponseParser> parser = CreateResponseParser(kind);
+  for (size_t offset = 0; offset < xml.size(); offset += chunk) {
+    std::string_view piece = xml.substr(offset, chunk);
+    parser->Feed(piece.data(), piece.size());
+  }
+  parser->Finish();
+  return parser;
+}
+
+// Parses |xml| fed in two pieces split at |split|.
+std::unique_ptr<ResponseParser> ParseSplit(ResponseKind kind,
+                                           std::string_view xml,
+                                           size_t split) {
+  std::unique_ptr<ResponseParser> parser = CreateResponseParser(kind);
+  parser->Feed(xml.data(), split);
+  parser->Feed(xml.data() + split, xml.size() - split);
+  parser->Finish();
+  return parser;
+}
+
+std::string StringAt(const StringTable& strings, int32_t index) {
+  if (index == StringTable::kNull) {
+    return "null";
+  }
+  int32_t begin = index == 0 ? 0 : strings.ends()[index - 1];
+  return strings.bytes().substr(begin, strings.ends()[index] - begin);
+}
+
+const RecordTable* Table(const ResponseParser& parser, std::string_view name) {
+  for (const auto& table : parser.tables()) {
+    if (table->name() == name) {
+      return table.get();
+    }
+  }
+  return nullptr;
+}
+
+size_t Rows(const ResponseParser& parser, std::string_view name) {
+  const RecordTable* table = Table(parser, name);
+  return table ? table->rows() : 0;
+}
+
+// Row |row| of table |name|, its cells joined by '|'. |kinds| tells, for each
+// cell, whether it is a string ('s') or a number ('n').
+std::string Row(const ResponseParser& parser, std::string_view name,
+                size_t row, std::string_view kinds) {
+  const RecordTable* table = Table(parser, name);
+  if (!table || row >= table->rows() || kinds.size() != table->stride()) {
+    return "(no such row)";
+  }
+  std::string text;
+  for (size_t i = 0; i < kinds.size(); i++) {
+    int32_t cell = table->cells()[row * table->stride() + i];
+    if (i > 0) {
+      text += '|';
+    }
+    text += kinds[i] == 's' ? StringAt(parser.strings(), cell)
+                            : std::to_string(cell);
+  }
+  return text;
+}
+
+// Everything the parser reports, to compare two parses.
+std::string Snapshot(const ResponseParser& parser) {
+  std::string snapshot = "syntax:" + parser.syntax_error() + "\nproxy:" +
+                         (parser.has_proxy_error() ? "1" : "0") +
+                         parser.proxy_error() + "\nerror:" + parser.error() +
+                         "\nstrings:" + parser.strings().bytes() + "\nends:";
+  for (int32_t end : parser.strings().ends()) {
+    snapshot += std::to_string(end) + ',';
+  }
+  for (const auto& table : parser.tables()) {
+    snapshot += '\n' + table->name() + ':';
+    for (int32_t cell : table->cells()) {
+      snapshot += std::to_string(cell) + ',';
+    }
+  }
+  return snapshot;
+}
+
+// The error reported when parsing |xml| as |kind|.
+std::string ErrorOf(ResponseKind kind, std::string_view xml) {
+  return Parse(kind, xml)->error();
+}
+
+// Layouts of the rows, for Row().
+constexpr char kListRequest[] = "sssssssnnnnn";
+constexpr char kDocument[] = "sssssss";
+constexpr char kDetail[] = "ssssssssssnnnnnnnnnnn";
+constexpr char kPresignRequest[] = "snsnn";
+constexpr char kPresignDocument[] = "sssssnn";
+
+// The proxy escapes < and > in subjects and names as &_lt; and &_gt;, which
+// are left as written, being unknown entities, and then replaced.
+constexpr char kList[] = R"(<?xml version="1.0" encoding="UTF-8"?>
+<list n="3">
+ <rqt id="r1" priority="2" workflow="true" forward="FALSE" type="VISTOBUENO">
+  <subj>  Contrato &_lt;obras&_gt; año 2022 </subj>
+  <snder>Ana Pérez</snder>
+  <view>NUEVO</view>
+  <date>01/06/2022</date>
+  <expdate>30/06/2022</expdate>
+  <docs>
+   <doc docid="d1"><nm>contrato.pdf</nm><sz>1024</sz><mmtp>application/pdf</mmtp><sigfrmt>PAdES</sigfrmt><mdalgo>SHA-256</mdalgo><params>null</params></doc>
+   <doc docid="d2"><nm>anexo.xml</nm><mmtp>text/xml</mmtp><sigfrmt>XAdES</sigfrmt><mdalgo>SHA-512</mdalgo><params>bW9kZQ==</params></doc>
+  </docs>
+ </rqt>
+ <!-- a comment between requests -->
+ <RQT ID="r2"><subj><![CDATA[Nómina <junio>]]></subj><snder>Luis</snder><view>LEIDO</view><date>02/06/2022</date><expdate></expdate><docs/></RQT>
+</list>
+)";
+
+constexpr char kDetailResponse[] = R"(<dtl id="d-1" priority="3" workflow="false" forward="true" type="firma">
+ <subj>Asunto</subj>
+ <msg>Mensaje &_lt;b&_gt;</msg>
+ <snders><snder>Ana</snder><snder> Luis </snder></snders>
+ <date>01/06/2022</date>
+ <app>Nómina</app>
+ <ref>REF-1</ref>
+ <sgnlines>
+  <sgnline><rcvr st="true">Ana</rcvr><rcvr>Luis</rcvr></sgnline>
+  <sgnline type="VISTOBUENO"><rcvr st="false">Eva</rcvr></sgnline>
+ </sgnlines>
+ <docs><doc docid="x"><nm>a.pdf</nm><sz>10</sz><mmtp>application/pdf</mmtp><sigfrmt>PAdES</sigfrmt><mdalgo>SHA-256</mdalgo></doc></docs>
+ <attachedlist><attached docid="y"><nm>b.txt</nm><mmtp>text/plain</mmtp></attached></attachedlist>
+</dtl>)";
+
+constexpr char kPresign[] = R"(<pres>
+ <req id="p1" status="OK">
+  <doc docid="a" cop="cofirma" sigfrmt="CAdES" mdalgo="SHA-512">
+   <params>bW9kZQ==</params>
+   <result><p n="PRE">cHJl</p><p n="NEED_DATA"> true </p></result>
+  </doc>
+  <doc docid="b" cop="otra" sigfrmt="PAdES"><result/></doc>
+ </req>
+ <req id="p2" status="ko" exceptionb64="ZXJyb3I="><doc docid="c"/></req>
+</pres>)";
+
+constexpr char kPostsign[] =
+    R"(<posts><req id="p1" status="OK"/><req id="p2" status="KO"/></posts>)";
+
+// Every document the tests parse, for the split checks.
+struct Document {
+  ResponseKind kind;
+  const char* xml;
+  bool malformed;
+};
+
+constexpr Document kDocuments[] = {
+    {ResponseKind::kRequestList, kList, false},
+    {ResponseKind::kRequestDetail, kDetailResponse, false},
+    {ResponseKind::kPresign, kPresign, false},
+    {ResponseKind::kPostsign, kPostsign, false},
+    // Proxy errors.
+    {ResponseKind::kRequestList, R"(<err cd="ERR-01">Sesión caducada</err>)",
+     false},
+    {ResponseKind::kRequestDetail, R"(<err cd="ERR-02">No existe</err>)",
+     false},
+    {ResponseKind::kRequestList,
+     R"(<list n="1"><rqt id="r1"><err cd="3">fallo</err></rqt></list>)",
+     false},
+    // Content errors.
+    {ResponseKind::kRequestList,
+     R"(<list><rqt id="r1" priority="alta"/></list>)", false},
+    {ResponseKind::kPresign,
+     R"(<pres><req id="p"><doc docid="a" sigfrmt="CAdES"><result> )"
+     R"(<p n="k">v</p></result></doc></req></pres>)",
+     false},
+    // Malformed XML.
+    {ResponseKind::kRequestList,
+     R"(<list n="1"><rqt id="r1"><subj>x</subj></list>)", true},
+    {ResponseKind::kRequestDetail, R"(<dtl id="d"><subj>x</subj>)", true},
+    {ResponseKind::kPresign, R"(<pres></pres><pres/>)", true},
+    {ResponseKind::kPostsign, R"(<posts><req id="a" id2=b/></posts>)", true},
+};
+
+}  // namespace
+
+TEST(RequestListBecomesRecords) {
+  std::unique_ptr<ResponseParser> parser =
+      Parse(ResponseKind::kRequestList, kList);
+  EXPECT_FALSE(parser->has_syntax_error());
+  EXPECT_FALSE(parser->has_proxy_error());
+  EXPECT_EQ(parser->error(), std::string());
+  EXPECT_EQ(Row(*parser, "list", 0, "s"), std::string("3"));
+  ASSERT_TRUE(Rows(*parser, "requests") == 2);
+  EXPECT_EQ(Row(*parser, "requests", 0, kListRequest),
+            std::string("r1|Contrato <obras> año 2022|Ana Pérez|NUEVO|"
+                        "01/06/2022|30/06/2022|2|1|0|1|0|2"));
+  // Element and attribute names are matched ignoring case; an empty
+  // expiration date is no date, and a request without type is a signature.
+  EXPECT_EQ(Row(*parser, "requests", 1, kListRequest),
+            std::string("r2|Nómina <junio>|Luis|LEIDO|02/06/2022|null|null|"
+                        "0|0|0|2|0"));
+  ASSERT_TRUE(Rows(*parser, "docs") == 2);
+  EXPECT_EQ(Row(*parser, "docs", 0, kDocument),
+            std::string("d1|contrato.pdf|1024|application/pdf|PAdES|SHA-256|"
+                        "null"));
+  EXPECT_EQ(Row(*parser, "docs", 1, kDocument),
+            std::string("d2|anexo.xml|null|text/xml|XAdES|SHA-512|bW9kZQ=="));
+}
+
+TEST(RequestListErrorsAreTheDartOnes) {
+  constexpr ResponseKind kKind = ResponseKind::kRequestList;
+  // An <err> root with a code is reported with it, as RequestListResponseParser
+  // does, besides the proxy error that Api looks for in every response.
+  std::unique_ptr<ResponseParser> parser =
+      Parse(kKind, R"(<ERR CD="ERR-01">Sesión caducada</ERR>)");
+  EXPECT_FALSE(parser->has_proxy_error());
+  EXPECT_EQ(parser->error(),
+            std::string("El servicio proxy notificó un error (CD): ERR-01"));
+  parser = Parse(kKind, R"(<err cd="ERR-01">Sesión caducada</err>)");
+  EXPECT_TRUE(parser->has_proxy_error());
+  EXPECT_EQ(parser->proxy_error(), std::string("Sesión caducada"));
+  EXPECT_EQ(parser->error(),
+            std::string("El servicio proxy notificó un error (cd): ERR-01"));
+  // Without a code it is just the wrong root.
+  EXPECT_EQ(ErrorOf(kKind, "<err>x</err>"),
+            std::string("El elemento raiz del XML debe ser list y aparece: "
+                        "err"));
+  EXPECT_EQ(ErrorOf(kKind, "<lst/>"),
+            std::string("El elemento raiz del XML debe ser list y aparece: "
+                        "lst"));
+
+  // An <err> anywhere is a proxy error.
+  parser = Parse(kKind, R"(<list n="1"><rqt id="r1"><err cd="3">fallo</err>)"
+                       R"(</rqt></list>)");
+  EXPECT_TRUE(parser->has_proxy_error());
+  EXPECT_EQ(parser->proxy_error(), std::string("fallo"));
+
+  EXPECT_EQ(ErrorOf(kKind, "<list><foo/></list>"),
+            std::string("Se ha encontrado el elemento 'foo' en el listado de "
+                        "peticiones"));
+  EXPECT_EQ(ErrorOf(kKind, "<list><rqt/></list>"),
+            std::string("No se ha encontrado el atributo obligatorio 'id' en "
+                        "un peticion de firma"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<list><rqt id="r1" priority="alta"/></list>)"),
+            std::string("La prioridad de la peticion con referencia 'r1' no "
+                        "es valida. Debe ser un valor entero"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<list><rqt id="r1" workflow="si"/></list>)"),
+            std::string("El valor del atributo 'false' de la peticion con "
+                        "referencia 'r1' no es valida. no es valido. Debe ser "
+                        "'true' o 'false'"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<list><rqt id="r1"><subj/></rqt></list>)"),
+            std::string("La petición con referencia 'r1' no contiene el "
+                        "elemento snder"));
+  EXPECT_EQ(
+      ErrorOf(kKind, R"(<list><rqt id="r1"><subj/><snder/><view/><date/>)"
+                     R"(<docs><doc docid="d"><nm/><sigfrmt/></doc></docs>)"
+                     R"(</rqt></list>)"),
+      std::string("Existe un documento sin el elemento mmtp"));
+  // Only the first error is kept.
+  EXPECT_EQ(ErrorOf(kKind, R"(<list><rqt/><foo/></list>)"),
+            std::string("No se ha encontrado el atributo obligatorio 'id' en "
+                        "un peticion de firma"));
+}
+
+TEST(RequestDetailBecomesRecords) {
+  std::unique_ptr<ResponseParser> parser =
+      Parse(ResponseKind::kRequestDetail, kDetailResponse);
+  EXPECT_FALSE(parser->has_syntax_error());
+  EXPECT_EQ(parser->error(), std::string());
+  ASSERT_TRUE(Rows(*parser, "detail") == 1);
+  // The type is matched ignoring case, and the sign lines are in cascade
+  // unless stated otherwise.
+  EXPECT_EQ(Row(*parser, "detail", 0, kDetail),
+            std::string("d-1|Asunto|Mensaje <b>|01/06/2022|null|Nómina|null|"
+                        "REF-1|cascada|3|0|1|0|0|2|0|2|0|1|0|1"));
+  EXPECT_EQ(Row(*parser, "senders", 0, "s"), std::string("Ana"));
+  EXPECT_EQ(Row(*parser, "senders", 1, "s"), std::string("Luis"));
+  EXPECT_EQ(Row(*parser, "lines", 0, "snn"), std::string("FIRMA|0|2"));
+  EXPECT_EQ(Row(*parser, "lines", 1, "snn"), std::string("VISTOBUENO|2|1"));
+  // The done state carries over to the receivers that do not state it.
+  EXPECT_EQ(Row(*parser, "signers", 0, "sn"), std::string("Ana|1"));
+  EXPECT_EQ(Row(*parser, "signers", 1, "sn"), std::string("Luis|1"));
+  EXPECT_EQ(Row(*parser, "signers", 2, "sn"), std::string("Eva|0"));
+  EXPECT_EQ(Row(*parser, "docs", 0, kDocument),
+            std::string("x|a.pdf|10|application/pdf|PAdES|SHA-256|null"));
+  EXPECT_EQ(Row(*parser, "attached", 0, "ssss"),
+            std::string("y|b.txt|null|text/plain"));
+
+  // No attachment list at all is told apart from an empty one.
+  parser = Parse(ResponseKind::kRequestDetail,
+                 R"(<dtl id="d"><subj/><snders/><date/><app/><ref/>)"
+                 R"(<signlinestype>paralelo</signlinestype><sgnlines/><docs/>)"
+                 R"(</dtl>)");
+  EXPECT_EQ(parser->error(), std::string());
+  EXPECT_EQ(Row(*parser, "detail", 0, kDetail),
+            std::string("d||null||null||null||paralelo|null|0|0|-1|0|0|0|0|0|"
+                        "0|-1|-1"));
+}
+
+TEST(RequestDetailErrorsAreTheDartOnes) {
+  constexpr ResponseKind kKind = ResponseKind::kRequestDetail;
+  std::unique_ptr<ResponseParser> parser =
+      Parse(kKind, R"(<err cd="ERR-02">No existe</err>)");
+  EXPECT_TRUE(parser->has_proxy_error());
+  EXPECT_EQ(parser->proxy_error(), std::string("No existe"));
+  EXPECT_EQ(parser->error(),
+            std::string("El elemento raiz del XML debe ser 'dtl ' y aparece: "
+                        "err"));
+  EXPECT_EQ(ErrorOf(kKind, "<dtl/>"),
+            std::string("El detalle de la peticion carece del atributo 'id' "
+                        "con el identificador de la peticion"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<dtl id="d" priority="1.5"/>)"),
+            std::string("Se ha establecido un valor no valido en el atributo "
+                        "'priority ' en el detalle de la peticion  d"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<dtl id="d"><subj/></dtl>)"),
+            std::string("No se encontró el nodo 'snders ' en la peticion con "
+                        "identificador d"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<dtl id="d"><subj/><snders><x/></snders></dtl>)"),
+            std::string("Se ha encontrado el nodo x  en el listado de "
+                        "remitentes de la solicitud de firma"));
+  EXPECT_EQ(ErrorOf(kKind, R"(<dtl id="d"><subj/><snders/><date/><app/><ref/>)"
+                           R"(<sgnlines><sgnline><x/></sgnline></sgnlines>)"
+                           R"(</dtl>)"),
+            std::string("Se ha encontrado el nodo x en el listado de líneas de "
+                        "receptores"));
+}
+
+TEST(PresignBecomesRecords) {
+  std::unique_ptr<ResponseParser> parser =
+      Parse(ResponseKind::kPresign, kPresign);
+  EXPECT_FALSE(parser->has_syntax_error());
+  EXPECT_EQ(parser->error(), std::string());
+  ASSERT_TRUE(Rows(*parser, "requests") == 2);
+  EXPECT_EQ(Row(*parser, "requests", 0, kPresignRequest),
+            std::string("p1|1|null|0|2"));
+  // The documents of a failed request are not read.
+  EXPECT_EQ(Row(*parser, "requests", 1, kPresignRequest),
+            std::string("p2|0|ZXJyb3I=|-1|-1"));
+  ASSERT_TRUE(Rows(*parser, "docs") == 2);
+  EXPECT_EQ(Row(*parser, "docs", 0, kPresignDocument),
+            std::string("a|cosign|CAdES|SHA-512|bW9kZQ==|0|2"));
+  EXPECT_EQ(Row(*parser, "docs", 1, kPresignDocument),
+            std::string("b|otra|PAdES|null|null|2|0"));
+  ASSERT_TRUE(Rows(*parser, "params") == 2);
+  EXPECT_EQ(Row(*parser, "params", 0, "ss"), std::string("PRE|cHJl"));
+  EXPECT_EQ(Row(*parser, "params", 1, "ss"), std::string("NEED_DATA|true"));
+}
+
+TEST(PresignErrorsAreTheDartOnes) {
+  constexpr ResponseKind kKind = ResponseKind::kPresign;
+  std::unique_ptr<ResponseParser> parser =
+      Parse(kKind, R"(<err cd="1">Sin sesión</err>)");
+  EXPECT_TRUE(parser->has_proxy_error());
+  EXPECT_EQ(parser->proxy_error(), std::string("Sin sesión"));
+  EXPECT_EQ(parser->error(),
+            std::string("El elemento raiz del XML debe ser 'pres ' y aparece: "
+                        "err"));
+  EXPECT_EQ(ErrorOf(kKind, "<pres><x/></pres>"),
+            std::string("Se ha encontrado el elemento 'x' en los nodos de "
+                        "prefirma"));
+  EXPECT_EQ(ErrorOf(kKind, "<pres><req/></pres>"),
+            std::string("No se ha encontrado el atributo 'id' en una "
+                        "prefirma"));
+  EXPECT_EQ(ErrorOf(kKind,
+                    R"(<pres><req id="p"><doc docid="a"/></req></pres>)"),
+            std::string("No se ha encontrado el atributo obligatorio "
+                        "'sigfrmt' en una peticion de prefirma de documento"));
+  EXPECT_EQ(
+      ErrorOf(kKind, R"(<pres><req id="p"><doc docid="a" sigfrmt="C"/></req>)"
+                     R"(</pres>)"),
+      std::string("No se ha encontrado el nodo result  en la respuesta de la "
+                  "peticion de prefirma del documento"));
+  // Text between the parameters is rejected, as TriphaseConfigDataParser
+  // goes through every child node.
+  EXPECT_EQ(ErrorOf(kKind, R"(<pres><req id="p"><doc docid="a" sigfrmt="C">)"
+                           R"(<result> <p n="k">v</p></result></doc></req>)"
+                           R"(</pres>)"),
+            std::string("Se ha indicado un parametro de firma trifasica sin "
+                        "clave"));
+}
+
+TEST(PostsignReadsTheFirstRequest) {
+  std::unique_ptr<ResponseParser> parser =
+      Parse(ResponseKind::kPostsign, kPostsign);
+  EXPECT_EQ(parser->error(), std::string());
+  ASSERT_TRUE(Rows(*parser, "result") == 1);
+  EXPECT_EQ(Row(*parser, "result", 0, "sn"), std::string("p1|1"));
+  // The status is compared case-sensitively.
+  parser = Parse(ResponseKind::kPostsign,
+                 R"(<posts><req id="p" status="ko"/></posts>)");
+  EXPECT_EQ(Row(*parser, "result", 0, "sn"), std::string("p|1"));
+  parser = Parse(ResponseKind::kPostsign,
+                 R"(<posts><req id="p" status="KO"/></posts>)");
+  EXPECT_EQ(Row(*parser, "result", 0, "sn"), std::string("p|0"));
+  EXPECT_EQ(ErrorOf(ResponseKind::kPostsign, "<posts/>"),
+            std::string("No se encontró el elemento 'req' y aparece: req"));
+}
+
+TEST(MalformedXmlIsASyntaxError) {
+  for (const Document& document : kDocuments) {
+    std::unique_ptr<ResponseParser> parser =
+        Parse(document.kind, document.xml);
+    EXPECT_EQ(parser->has_syntax_error(), document.malformed);
+  }
+  // A truncated response too, wherever it is cut.
+  std::string_view list = kList;
+  size_t root_end = list.rfind("</list>");
+  for (size_t size = 0; size < root_end; size++) {
+    EXPECT_TRUE(Parse(ResponseKind::kRequestList, list.substr(0, size))
+                    ->has_syntax_error());
+  }
+}
+
+TEST(EverySplitGivesTheSameRecords) {
+  for (const Document& document : kDocuments) {
+    std::string_view xml = document.xml;
+    std::string whole = Snapshot(*Parse(document.kind, xml));
+    for (size_t split = 0; split <= xml.size(); split++) {
+      std::string split_snapshot =
+          Snapshot(*ParseSplit(document.kind, xml, split));
+      EXPECT_EQ(split_snapshot, whole);
+    }
+    EXPECT_EQ(Snapshot(*Parse(document.kind, xml, 1)), whole);
+    EXPECT_EQ(Snapshot(*Parse(document.kind, xml, 7)), whole);
+  }
+}
@@ -0,0 +1,389 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/proxy_response_parsers.h>
+#include <native_core/request_list_cache.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::RecordTable;
+using native_core::RequestListCache;
+using native_core::RequestListMergeStats;
+using native_core::RequestListSnapshot;
+using native_core::ResponseKind;
+using native_core::ResponseParser;
+using native_core::StringTable;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+constexpr char kServer[] = "https://proxy.example/pf";
+constexpr char kState[] = "unresolved";
+
+// Offsets in the header, as request_list_cache.cpp lays it out.
+constexpr size_t kVersionOffset = 4;
+constexpr size_t kIndexOffsetOffset = 8;
+constexpr size_t kIndexSizeOffset = 12;
+constexpr size_t kChecksumOffset = 20;
+
+// A request of a page: its id and the subject that tells versions apart.
+using Request = std::pair<std::string, std::string>;
+
+std::vector<Request> Requests(size_t count, const std::string& subject) {
+  std::vector<Request> requests;
+  for (size_t i = 0; i < count; i++) {
+    requests.emplace_back("REQ" + std::to_string(i), subject);
+  }
+  return requests;
+}
+
+// A request list page as the parser leaves it.
+std::unique_ptr<ResponseParser> Page(const std::vector<Request>& requests) {
+  std::string xml = "<list n=\"" + std::to_string(requests.size() * 3) + "\">";
+  for (const Request& request : requests) {
+    xml += "<rqt id=\"" + request.first +
+           "\" priority=\"2\" workflow=\"true\" type=\"VISTOBUENO\"><subj>" +
+           request.second +
+           "</subj><snder>Ana Pérez</snder><view>NUEVO</view>"
+           "<date>01/06/2022</date><docs><doc docid=\"" +
+           request.first +
+           "-1\"><nm>contrato.pdf</nm><sz>1024</sz>"
+           "<mmtp>application/pdf</mmtp><sigfrmt>PAdES</sigfrmt>"
+           "<mdalgo>SHA-256</mdalgo><params>bW9kZQ==</params></doc>"
+           "<doc docid=\"" +
+           request.first +
+           "-2\"><nm>anexo.xml</nm><mmtp>text/xml</mmtp>"
+           "<sigfrmt>XAdES</sigfrmt><mdalgo>SHA-512</mdalgo></doc></docs>"
+           "</rqt>";
+  }
+  xml += "</list>";
+  std::unique_ptr<ResponseParser> parser =
+      native_core::CreateResponseParser(ResponseKind::kRequestList);
+  parser->Feed(xml.data(), xml.size());
+  parser->Finish();
+  return parser;
+}
+
+std::string StringAt(const StringTable& strings, int32_t index) {
+  if (index == StringTable::kNull) {
+    return "null";
+  }
+  int32_t begin = index == 0 ? 0 : strings.ends()[index - 1];
+  return strings.bytes().substr(begin, strings.ends()[index] - begin);
+}
+
+// The list as text, strings resolved, so that a page and a snapshot, whose
+// string tables are laid out differently, can be compared.
+std::string Render(const StringTable& strings, const RecordTable& list,
+                   const RecordTable& requests, const RecordTable& docs) {
+  using namespace native_core::request_list;
+  using namespace native_core::sign_request_document;
+  std::string text = "total " + StringAt(strings, list.cells()[kTotal]);
+  for (size_t row = 0; row < requests.rows(); row++) {
+    const int32_t* fields = requests.cells().data() + row * kRequestStride;
+    text += "\n";
+    for (int field = kId; field <= kPriority; field++) {
+      text += StringAt(strings, fields[field]) + "|";
+    }
+    text += std::to_string(fields[kWorkflow]) + "|" +
+            std::to_string(fields[kForward]) + "|" +
+            std::to_string(fields[kType]);
+    for (int32_t doc = fields[kFirstDocument];
+         doc < fields[kFirstDocument] + fields[kDocumentCount]; doc++) {
+      text += "\n  ";
+      for (int field = kDocumentId; field < kDocumentStride; field++) {
+        text += StringAt(strings, docs.cells()[doc * kDocumentStride + field]) +
+                "|";
+      }
+    }
+  }
+  return text;
+}
+
+const RecordTable& Table(const ResponseParser& page, const char* name) {
+  for (const auto& table : page.tables()) {
+    if (table->name() == name) {
+      return *table;
+    }
+  }
+  static const RecordTable kEmpty("", 1);
+  return kEmpty;
+}
+
+std::string Render(const ResponseParser& page) {
+  return Render(page.strings(), Table(page, "list"), Table(page, "requests"),
+                Table(page, "docs"));
+}
+
+std::string Render(const RequestListSnapshot& snapshot) {
+  return Render(snapshot.strings, snapshot.list, snapshot.requests,
+                snapshot.docs);
+}
+
+// The one cache file in |directory|.
+std::filesystem::path CacheFile(const TempDirectory& directory) {
+  for (const auto& entry :
+       std::filesystem::directory_iterator(directory.path())) {
+    if (entry.path().extension() == ".cache") {
+      return entry.path();
+    }
+  }
+  return std::filesystem::path();
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& bytes) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+uint32_t U32At(const std::string& bytes, size_t offset) {
+  const auto* data = reinterpret_cast<const uint8_t*>(bytes.data() + offset);
+  return static_cast<uint32_t>(data[0]) |
+         static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 |
+         static_cast<uint32_t>(data[3]) << 24;
+}
+
+void PutU32At(std::string* bytes, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    (*bytes)[offset + i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+// Where the index of the cache file |bytes| puts each record, by request
+// id.
+std::map<std::string, uint32_t> RecordOffsets(const std::string& bytes) {
+  std::map<std::string, uint32_t> offsets;
+  size_t index = U32At(bytes, kIndexOffsetOffset);
+  size_t end = index + U32At(bytes, kIndexSizeOffset);
+  // Skips the total.
+  index += 4 + U32At(bytes, index);
+  for (; index + 8 <= end; index += 8) {
+    uint32_t offset = U32At(bytes, index);
+    std::string id = bytes.substr(offset + 4, U32At(bytes, offset));
+    offsets[id] = offset;
+  }
+  return offsets;
+}
+
+}  // namespace
+
+TEST(MergedPageLoadsBack) {
+  TempDirectory directory;
+  RequestListCache cache(directory.path().u8string());
+  EXPECT_FALSE(cache.Load(kServer, kState));
+
+  std::unique_ptr<ResponseParser> page =
+      Page(Requests(20, "Contrato de obras año 2022"));
+  RequestListMergeStats stats;
+  ASSERT_TRUE(cache.Merge(kServer, kState, *page, &stats));
+  EXPECT_EQ(stats.written, static_cast<size_t>(20));
+  EXPECT_EQ(stats.kept, static_cast<size_t>(0));
+  EXPECT_FALSE(stats.compacted);
+
+  std::unique_ptr<RequestListSnapshot> snapshot = cache.Load(kServer, kState);
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(Render(*snapshot), Render(*page));
+  // Servers and states have files of their own.
+  EXPECT_FALSE(cache.Load(kServer, "signed"));
+  EXPECT_FALSE(cache.Load("https://other.example/pf", kState));
+
+  // An empty page too.
+  std::unique_ptr<ResponseParser> empty = Page({});
+  ASSERT_TRUE(cache.Merge(kServer, kState, *empty));
+  snapshot = cache.Load(kServer, kState);
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(snapshot->requests.rows(), static_cast<size_t>(0));
+  EXPECT_EQ(Render(*snapshot), Render(*empty));
+
+  cache.Remove(kServer, kState);
+  EXPECT_FALSE(cache.Load(kServer, kState));
+}
+
+TEST(PagesWithErrorsAreNotMerged) {
+  TempDirectory directory;
+  RequestListCache cache(directory.path().u8string());
+  std::unique_ptr<ResponseParser> parser =
+      native_core::CreateResponseParser(ResponseKind::kRequestList);
+  const char xml[] = "<list><rqt/></list>";
+  parser->Feed(xml, sizeof(xml) - 1);
+  parser->Finish();
+  EXPECT_FALSE(cache.Merge(kServer, kState, *parser));
+  EXPECT_FALSE(cache.Load(kServer, kState));
+  EXPECT_TRUE(CacheFile(directory).empty());
+}
+
+TEST(UnchangedPageLeavesTheFileAlone) {
+  TempDirectory directory;
+  RequestListCache cache(directory.path().u8string());
+  ASSERT_TRUE(cache.Merge(kServer, kState, *Page(Requests(20, "Asunto"))));
+  std::filesystem::path path = CacheFile(directory);
+  std::string before = ReadFile(path);
+
+  RequestListMergeStats stats;
+  ASSERT_TRUE(cache.Merge(kServer, kState, *Page(Requests(20, "Asunto")),
+                          &stats));
+  EXPECT_EQ(stats.kept, static_cast<size_t>(20));
+  EXPECT_EQ(stats.written, static_cast<size_t>(0));
+  EXPECT_TRUE(ReadFile(path) == before);
+}
+
+TEST(OnlyChangedRecordsAreAppended) {
+  TempDirectory directory;
+  RequestListCache cache(directory.path().u8string());
+  std::vector<Request> requests = Requests(20, "Asunto");
+  ASSERT_TRUE(cache.Merge(kServer, kState, *Page(requests)));
+  std::filesystem::path path = CacheFile(directory);
+  std::string before = ReadFile(path);
+  std::map<std::string, uint32_t> offsets_before = RecordOffsets(before);
+
+  // REQ5 changes, REQ19 leaves the page and REQ20 enters it.
+  requests[5].second = "Asunto modificado";
+  requests.pop_back();
+  requests.emplace_back("REQ20", "Asunto");
+  std::unique_ptr<ResponseParser> page = Page(requests);
+  RequestListMergeStats stats;
+  ASSERT_TRUE(cache.Merge(kServer, kState, *page, &stats));
+  EXPECT_EQ(stats.written, static_cast<size_t>(2));
+  EXPECT_EQ(stats.kept, static_cast<size_t>(18));
+  EXPECT_FALSE(stats.compacted);
+
+  std::string after = ReadFile(path);
+  std::map<std::string, uint32_t> offsets_after = RecordOffsets(after);
+  ASSERT_TRUE(offsets_after.size() == 20);
+  for (const auto& [id, offset] : offsets_after) {
+    if (id == "REQ5" || id == "REQ20") {
+      // After the old index, which is left where it was.
+      EXPECT_TRUE(offset >= U32At(before, kIndexOffsetOffset) +
+                                U32At(before, kIndexSizeOffset));
+    }
+    else {
+      EXPECT_EQ(offset, offsets_before[id]);
+    }
+  }
+  // Everything but the header is as it was, and the new records and index
+  // come after it.
+  ASSERT_TRUE(after.size() > before.size());
+  EXPECT_TRUE(after.compare(32, before.size() - 32, before, 32,
+                            before.size() - 32) == 0);
+
+  std::unique_ptr<RequestListSnapshot> snapshot = cache.Load(kServer, kState);
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(Render(*snapshot), Render(*page));
+}
+
+TEST(StaleRecordsAreCompactedAway) {
+  TempDirectory directory;
+  RequestListCache cache(directory.path().u8string());
+  // Every merge changes every record, so each one appends a whole page until
+  // the stale bytes pass the threshold.
+  std::unique_ptr<ResponseParser> page = Page(Requests(50, "Versión 0"));
+  RequestListMergeStats stats;
+  ASSERT_TRUE(cache.Merge(kServer, kState, *page, &stats));
+  std::filesystem::path path = CacheFile(directory);
+  uintmax_t size_before = 0;
+  int merges = 1;
+  for (; merges < 100 && !stats.compacted; merges++) {
+    size_before = std::filesystem::file_size(path);
+    page = Page(Requests(50, "Versión " + std::to_string(merges)));
+    ASSERT_TRUE(cache.Merge(kServer, kState, *page, &stats));
+  }
+  ASSERT_TRUE(stats.compacted);
+  EXPECT_TRUE(merges > 2);
+  EXPECT_EQ(stats.written, static_cast<size_t>(50));
+
+  // Rewritten with the live records alone: header, records, index.
+  std::string bytes = ReadFile(path);
+  EXPECT_TRUE(bytes.size() < size_before);
+  EXPECT_EQ(static_cast<size_t>(U32At(bytes, kIndexOffsetOffset) +
+                                U32At(bytes, kIndexSizeOffset)),
+            bytes.size());
+  EXPECT_FALSE(std::filesystem::exists(path.u8string() + ".tmp"));
+  std::unique_ptr<RequestListSnapshot> snapshot = cache.Load(kServer, kState);
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(Render(*snapshot), Render(*page));
+
+  // And appended to again afterwards.
+  page = Page(Requests(50, "Versión siguiente"));
+  ASSERT_TRUE(cache.Merge(kServer, kState, *page, &stats));
+  EXPECT_FALSE(stats.compacted);
+  EXPECT_TRUE(std::filesystem::file_size(path) > bytes.size());
+}
+
+TEST(DamagedFilesAreNotLoaded) {
+  TempDirectory directory;
+  RequestListCache cache(directory.path().u8string());
+  std::unique_ptr<ResponseParser> page = Page(Requests(10, "Asunto"));
+  ASSERT_TRUE(cache.Merge(kServer, kState, *page));
+  std::filesystem::path path = CacheFile(directory);
+  const std::string good = ReadFile(path);
+  ASSERT_TRUE(cache.Load(kServer, kState));
+
+  // Truncated anywhere.
+  for (size_t size = 0; size < good.size(); size++) {
+    WriteFile(path, good.substr(0, size));
+    EXPECT_FALSE(cache.Load(kServer, kState));
+  }
+
+  // Another format version.
+  std::string bytes = good;
+  PutU32At(&bytes, kVersionOffset, RequestListCache::kVersion + 1);
+  WriteFile(path, bytes);
+  EXPECT_FALSE(cache.Load(kServer, kState));
+
+  // Not a cache file.
+  bytes = good;
+  bytes[0] = 'X';
+  WriteFile(path, bytes);
+  EXPECT_FALSE(cache.Load(kServer, kState));
+
+  // An index that does not match its checksum, whichever of them changed.
+  bytes = good;
+  PutU32At(&bytes, kChecksumOffset, U32At(good, kChecksumOffset) ^ 1);
+  WriteFile(path, bytes);
+  EXPECT_FALSE(cache.Load(kServer, kState));
+  bytes = good;
+  bytes[U32At(good, kIndexOffsetOffset) + 5] ^= 1;
+  WriteFile(path, bytes);
+  EXPECT_FALSE(cache.Load(kServer, kState));
+
+  // An index pointing past the end of the file.
+  bytes = good;
+  PutU32At(&bytes, kIndexSizeOffset, U32At(good, kIndexSizeOffset) + 1);
+  WriteFile(path, bytes);
+  EXPECT_FALSE(cache.Load(kServer, kState));
+
+  // A damaged file is replaced by the next merge.
+  RequestListMergeStats stats;
+  ASSERT_TRUE(cache.Merge(kServer, kState, *page, &stats));
+  EXPECT_EQ(stats.written, static_cast<size_t>(10));
+  EXPECT_TRUE(ReadFile(path) == good);
+  std::unique_ptr<RequestListSnapshot> snapshot = cache.Load(kServer, kState);
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(Render(*snapshot), Render(*page));
+}
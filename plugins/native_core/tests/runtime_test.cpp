@@ -0,0 +1,104 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/cancellation_token.h>
+#include <native_core/eventfd_wakeup.h>
+#include <native_core/runtime.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "test_support.h"
+
+using native_core::Runtime;
+
+namespace {
+
+// Runs the platform loop of a headless host until |condition| holds.
+bool PumpUntil(const std::function<bool()>& condition) {
+  Runtime& runtime = Runtime::Get();
+  auto& wakeup = static_cast<native_core::EventFdWakeup&>(runtime.wakeup());
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    if (wakeup.Wait(100)) {
+      wakeup.Consume();
+    }
+    runtime.dispatcher().Drain();
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(RunAsyncCompletesOnThePlatformThread) {
+  std::thread::id platform = std::this_thread::get_id();
+  std::atomic<bool> worked{false};
+  bool done = false;
+  bool cancelled = true;
+  bool on_platform = false;
+  ASSERT_TRUE(Runtime::Get().RunAsync(
+      [&]() { worked = std::this_thread::get_id() != platform; },
+      [&](bool was_cancelled) {
+        done = true;
+        cancelled = was_cancelled;
+        on_platform = std::this_thread::get_id() == platform;
+      }));
+  EXPECT_TRUE(PumpUntil([&done]() { return done; }));
+  EXPECT_TRUE(worked.load());
+  EXPECT_FALSE(cancelled);
+  EXPECT_TRUE(on_platform);
+}
+
+TEST(RunAsyncCompletesWhenCancelledBeforeTheWork) {
+  native_core::CancellationSource source;
+  source.Cancel();
+  std::atomic<bool> worked{false};
+  bool done = false;
+  bool cancelled = false;
+  ASSERT_TRUE(Runtime::Get().RunAsync(
+      [&worked]() { worked = true; },
+      [&](bool was_cancelled) {
+        done = true;
+        cancelled = was_cancelled;
+      },
+      source.token()));
+  EXPECT_TRUE(PumpUntil([&done]() { return done; }));
+  EXPECT_FALSE(worked.load());
+  EXPECT_TRUE(cancelled);
+}
+
+TEST(RunAsyncCompletesWhenCancelledDuringTheWork) {
+  native_core::CancellationSource source;
+  std::atomic<bool> started{false};
+  bool done = false;
+  bool cancelled = false;
+  ASSERT_TRUE(Runtime::Get().RunAsync(
+      [&started, token = source.token()]() {
+        started = true;
+        native_core_tests::WaitFor([&token]() { return token.IsCancelled(); });
+      },
+      [&](bool was_cancelled) {
+        done = true;
+        cancelled = was_cancelled;
+      },
+      source.token()));
+  ASSERT_TRUE(
+      native_core_tests::WaitFor([&started]() { return started.load(); }));
+  source.Cancel();
+  EXPECT_TRUE(PumpUntil([&done]() { return done; }));
+  EXPECT_TRUE(cancelled);
+}
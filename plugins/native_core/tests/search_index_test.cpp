@@ -0,0 +1,246 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <native_core/proxy_response_parsers.h>
+#include <native_core/search_index.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::FoldForSearch;
+using native_core::SearchIndex;
+using native_core::SearchResult;
+
+namespace {
+
+constexpr size_t kNoLimit = 1000000;
+
+std::vector<std::string> Ids(std::initializer_list<const char*> ids) {
+  return std::vector<std::string>(ids.begin(), ids.end());
+}
+
+std::vector<std::string> Find(const SearchIndex& index,
+                              std::string_view text,
+                              std::string_view state = "") {
+  return index.Query(text, state, kNoLimit).ids;
+}
+
+size_t Count(const SearchIndex& index,
+             std::string_view text,
+             std::string_view state = "") {
+  return index.Query(text, state, 0).total;
+}
+
+// "r<i>", request |i| of the larger tests, which holds the word "u<i>".
+std::string RequestId(int i) { return "r" + std::to_string(i); }
+
+void AddNumbered(SearchIndex* index, int i, std::string_view state) {
+  std::string id = RequestId(i);
+  std::string unique = "u" + std::to_string(i);
+  index->Add(id, state, {id, "Expediente de contratación", unique});
+}
+
+}  // namespace
+
+TEST(FoldingLowersAndDropsSpanishAccents) {
+  EXPECT_EQ(FoldForSearch("Resolución"), "resolucion");
+  EXPECT_EQ(FoldForSearch("RESOLUCIÓN"), "resolucion");
+  EXPECT_EQ(FoldForSearch("Íñigo Muñoz Ibáñez"), "inigo munoz ibanez");
+  EXPECT_EQ(FoldForSearch("ÑANDÚ pingüino"), "nandu pinguino");
+  EXPECT_EQ(FoldForSearch("àèìòù ÀÈÌÒÙ Çç"), "aeiou aeiou cc");
+  // Letters without an unaccented form only change case.
+  EXPECT_EQ(FoldForSearch("Æ Ð Þ æ ß"), "æ ð þ æ ß");
+  // Everything else is kept as it is.
+  EXPECT_EQ(FoldForSearch("¿Qué? 12 € «sí»"), "¿que? 12 € «si»");
+  EXPECT_EQ(FoldForSearch(""), "");
+}
+
+TEST(QueryMatchesEveryWordAsAPrefix) {
+  SearchIndex index;
+  index.Add("A1", "pending", {"Resolución de contratación", "José García"});
+  index.Add("A2", "pending", {"Contrato menor", "María López"});
+  index.Add("A3", "pending", {"Resolución del contrato", "Ángel Pérez"});
+
+  EXPECT_EQ(Find(index, "resolucion"), Ids({"A1", "A3"}));
+  EXPECT_EQ(Find(index, "RESOL"), Ids({"A1", "A3"}));
+  EXPECT_EQ(Find(index, "contrat"), Ids({"A1", "A2", "A3"}));
+  // Every word must match, each as a prefix of some word of the request.
+  EXPECT_EQ(Find(index, "res contrato"), Ids({"A3"}));
+  EXPECT_EQ(Find(index, "contrat garc"), Ids({"A1"}));
+  EXPECT_EQ(Find(index, "contrat garc lopez"), Ids({}));
+  // Prefixes only, not infixes.
+  EXPECT_EQ(Find(index, "olucion"), Ids({}));
+  // Accents and punctuation in the query do not matter.
+  EXPECT_EQ(Find(index, "«Ángel», ¿perez?"), Ids({"A3"}));
+}
+
+TEST(EmptyQueryMatchesNothing) {
+  SearchIndex index;
+  index.Add("A1", "pending", {"Resolución"});
+  EXPECT_EQ(index.Query("", "", kNoLimit).total, 0u);
+  EXPECT_EQ(index.Query(" ¿? -- ", "", kNoLimit).total, 0u);
+}
+
+TEST(LimitCutsIdsButNotTotal) {
+  SearchIndex index;
+  for (int i = 0; i < 10; i++) {
+    index.Add(RequestId(i), "pending", {"Expediente"});
+  }
+  SearchResult result = index.Query("exp", "", 3);
+  EXPECT_EQ(result.ids, Ids({"r0", "r1", "r2"}));
+  EXPECT_EQ(result.total, 10u);
+}
+
+TEST(StateNarrowsTheMatches) {
+  SearchIndex index;
+  index.Add("A1", "pending", {"Resolución"});
+  index.Add("A2", "signed", {"Resolución"});
+  index.Add("A3", "rejected", {"Resolución"});
+
+  EXPECT_EQ(Find(index, "resolucion", "signed"), Ids({"A2"}));
+  EXPECT_EQ(Find(index, "resolucion", "pending"), Ids({"A1"}));
+  EXPECT_EQ(Find(index, "resolucion"), Ids({"A1", "A2", "A3"}));
+  EXPECT_EQ(Find(index, "resolucion", "unknown"), Ids({}));
+}
+
+TEST(AddingAnIdAgainReplacesIt) {
+  SearchIndex index;
+  index.Add("A1", "pending", {"Resolución"});
+  index.Add("A2", "pending", {"Resolución"});
+  index.Add("A1", "signed", {"Contrato"});
+
+  EXPECT_EQ(Find(index, "resolucion"), Ids({"A2"}));
+  EXPECT_EQ(Find(index, "contrato", "pending"), Ids({}));
+  EXPECT_EQ(Find(index, "contrato", "signed"), Ids({"A1"}));
+  EXPECT_EQ(index.stats().requests, 2u);
+}
+
+TEST(RemoveAndClearDropRequests) {
+  SearchIndex index;
+  index.Add("A1", "pending", {"Resolución"});
+  index.Add("A2", "pending", {"Resolución"});
+  index.Remove("A1");
+  index.Remove("missing");
+
+  EXPECT_EQ(Find(index, "resolucion"), Ids({"A2"}));
+  EXPECT_EQ(index.stats().requests, 1u);
+
+  index.Clear();
+  EXPECT_EQ(Find(index, "resolucion"), Ids({}));
+  EXPECT_EQ(index.stats().requests, 0u);
+  EXPECT_EQ(index.stats().terms, 0u);
+  index.Add("A1", "pending", {"Contrato"});
+  EXPECT_EQ(Find(index, "contrato", "pending"), Ids({"A1"}));
+}
+
+TEST(RequestListPagesAreIndexed) {
+  std::unique_ptr<native_core::ResponseParser> page =
+      native_core::CreateResponseParser(
+          native_core::ResponseKind::kRequestList);
+  std::string xml =
+      "<list n=\"2\">"
+      "<rqt id=\"R1\" priority=\"1\" workflow=\"false\" forward=\"false\" "
+      "type=\"FIRMA\"><subj>Resolución de alcaldía</subj>"
+      "<snder>Begoña Romero</snder><view>NUEVO</view><date>01/06/2022</date>"
+      "<docs><doc docid=\"D1\"><nm>anexo_presupuesto.pdf</nm><sz>1</sz>"
+      "<mmtp>application/pdf</mmtp><sigfrmt>PAdES</sigfrmt>"
+      "<mdalgo>SHA-256</mdalgo></doc></docs></rqt>"
+      "<rqt id=\"R2\" priority=\"1\" workflow=\"false\" forward=\"false\" "
+      "type=\"FIRMA\"><subj>Contrato menor</subj>"
+      "<snder>Lucía Fernández</snder><view>NUEVO</view>"
+      "<date>01/06/2022</date><docs></docs></rqt>"
+      "</list>";
+  page->Feed(xml.data(), xml.size());
+  page->Finish();
+
+  SearchIndex index;
+  ASSERT_TRUE(index.AddRequestList("pending", *page));
+  EXPECT_EQ(Find(index, "begona"), Ids({"R1"}));
+  EXPECT_EQ(Find(index, "presupuesto"), Ids({"R1"}));
+  EXPECT_EQ(Find(index, "anexo pdf"), Ids({"R1"}));
+  EXPECT_EQ(Find(index, "lucia contrato", "pending"), Ids({"R2"}));
+  EXPECT_EQ(Find(index, "r"), Ids({"R1", "R2"}));
+
+  std::unique_ptr<native_core::ResponseParser> detail =
+      native_core::CreateResponseParser(
+          native_core::ResponseKind::kRequestDetail);
+  EXPECT_FALSE(index.AddRequestList("pending", *detail));
+}
+
+TEST(QueriesHoldAcrossSegmentMerges) {
+  // Two new words per request: the recent words are merged into the segment
+  // a couple of times, and the last ones are still recent.
+  constexpr int kRequests = 6000;
+  SearchIndex index;
+  for (int i = 0; i < kRequests; i++) {
+    AddNumbered(&index, i, i % 2 == 0 ? "pending" : "signed");
+  }
+  EXPECT_EQ(index.stats().requests, static_cast<size_t>(kRequests));
+  // "r<i>" and "u<i>", plus "expediente", "de" and "contratacion".
+  EXPECT_EQ(index.stats().terms, static_cast<size_t>(2 * kRequests + 3));
+
+  // Words from the segment, from the recent ones, and from both at once.
+  EXPECT_EQ(Find(index, "u0"), Ids({"r0"}));
+  EXPECT_EQ(Find(index, "u4095"), Ids({"r4095"}));
+  EXPECT_EQ(Find(index, "u5999"), Ids({"r5999"}));
+  // u5, u50-u59, u500-u599 and u5000-u5999.
+  EXPECT_EQ(Count(index, "u5"), 1111u);
+  EXPECT_EQ(Count(index, "u"), static_cast<size_t>(kRequests));
+  EXPECT_EQ(Count(index, "expediente contratacion"),
+            static_cast<size_t>(kRequests));
+  EXPECT_EQ(Count(index, "u", "signed"), static_cast<size_t>(kRequests / 2));
+  EXPECT_EQ(Find(index, "u5999", "pending"), Ids({}));
+  // In the order they were indexed, wherever their words are.
+  EXPECT_EQ(index.Query("u", "", 3).ids, Ids({"r0", "r1", "r2"}));
+
+  // A word of the segment added again for a new request.
+  index.Add("extra", "pending", {"u0"});
+  EXPECT_EQ(Find(index, "u0"), Ids({"r0", "extra"}));
+}
+
+TEST(QueriesHoldAcrossCompaction) {
+  constexpr int kRequests = 6000;
+  SearchIndex index;
+  for (int i = 0; i < kRequests; i++) {
+    AddNumbered(&index, i, "pending");
+  }
+  // Removing more than half, well over the minimum, renumbers the rest.
+  for (int i = 0; i < 4000; i++) {
+    index.Remove(RequestId(i));
+  }
+  // And replacing some moves them to the end.
+  for (int i = 4000; i < 4100; i++) {
+    AddNumbered(&index, i, "signed");
+  }
+  EXPECT_EQ(index.stats().requests, 2000u);
+
+  EXPECT_EQ(Find(index, "u0"), Ids({}));
+  EXPECT_EQ(Find(index, "r3999"), Ids({}));
+  EXPECT_EQ(Find(index, "u4000"), Ids({"r4000"}));
+  EXPECT_EQ(Find(index, "u5999", "pending"), Ids({"r5999"}));
+  EXPECT_EQ(Count(index, "u"), 2000u);
+  EXPECT_EQ(Count(index, "expediente", "signed"), 100u);
+  EXPECT_EQ(Count(index, "expediente", "pending"), 1900u);
+  EXPECT_EQ(index.Query("u", "", 2).ids, Ids({"r4100", "r4101"}));
+  EXPECT_EQ(index.Query("u", "signed", 2).ids, Ids({"r4000", "r4001"}));
+
+  // Requests indexed after the compaction are found with the rest.
+  AddNumbered(&index, 0, "pending");
+  EXPECT_EQ(Find(index, "u0"), Ids({"r0"}));
+  EXPECT_EQ(Count(index, "expediente", "pending"), 1901u);
+}
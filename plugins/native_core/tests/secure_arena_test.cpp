@@ -0,0 +1,194 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <native_core/secure_arena.h>
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::GetSecureArenaStats;
+using native_core::SecureArena;
+using native_core::SecureArenaStats;
+
+namespace {
+
+// The counters are process-wide, so tests compare them with where they
+// started.
+SecureArenaStats Since(const SecureArenaStats& start) {
+  SecureArenaStats now = GetSecureArenaStats();
+  SecureArenaStats delta;
+  delta.arenas = now.arenas - start.arenas;
+  delta.allocations = now.allocations - start.allocations;
+  delta.large_allocations = now.large_allocations - start.large_allocations;
+  delta.blocks = now.blocks - start.blocks;
+  delta.blocks_in_use = now.blocks_in_use - start.blocks_in_use;
+  delta.locked_bytes = now.locked_bytes - start.locked_bytes;
+  return delta;
+}
+
+bool IsAligned(const void* memory) {
+  return reinterpret_cast<uintptr_t>(memory) % 16 == 0;
+}
+
+bool IsZero(const uint8_t* memory, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (memory[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Fits in a pooled block, but two of them do not.
+constexpr size_t kMostOfABlock = SecureArena::kBlockSize / 2 + 512;
+
+}  // namespace
+
+TEST(AllocationsAreAlignedZeroedAndApart) {
+  SecureArena arena;
+  std::vector<std::pair<uint8_t*, size_t>> allocations;
+  for (size_t size : {1, 3, 15, 16, 17, 33, 100, 255, 512, 1}) {
+    uint8_t* memory = arena.Allocate(size);
+    ASSERT_TRUE(memory != nullptr);
+    EXPECT_TRUE(IsAligned(memory));
+    EXPECT_TRUE(IsZero(memory, size));
+    std::memset(memory, static_cast<int>(allocations.size() + 1), size);
+    allocations.push_back({memory, size});
+  }
+  // Writing each one left the others alone.
+  for (size_t i = 0; i < allocations.size(); i++) {
+    for (size_t j = 0; j < allocations[i].second; j++) {
+      EXPECT_EQ(static_cast<int>(allocations[i].first[j]),
+                static_cast<int>(i + 1));
+    }
+  }
+  EXPECT_EQ(arena.allocations(), allocations.size());
+
+  uint64_t* words = arena.Allocate<uint64_t>(8);
+  EXPECT_TRUE(IsAligned(words));
+  EXPECT_TRUE(
+      IsZero(reinterpret_cast<uint8_t*>(words), 8 * sizeof(uint64_t)));
+}
+
+TEST(FullBlocksAreFollowedByNewOnes) {
+  SecureArenaStats start = GetSecureArenaStats();
+  {
+    SecureArena arena;
+    std::vector<uint8_t*> allocations;
+    for (int i = 0; i < 3; i++) {
+      uint8_t* memory = arena.Allocate(kMostOfABlock);
+      ASSERT_TRUE(memory != nullptr);
+      EXPECT_TRUE(IsAligned(memory));
+      EXPECT_TRUE(IsZero(memory, kMostOfABlock));
+      std::memset(memory, 0xa0 + i, kMostOfABlock);
+      allocations.push_back(memory);
+    }
+    EXPECT_EQ(Since(start).blocks_in_use, 3u);
+    EXPECT_EQ(Since(start).large_allocations, 0u);
+    for (int i = 0; i < 3; i++) {
+      EXPECT_EQ(static_cast<int>(allocations[i][0]), 0xa0 + i);
+      EXPECT_EQ(static_cast<int>(allocations[i][kMostOfABlock - 1]),
+                0xa0 + i);
+    }
+  }
+  EXPECT_EQ(Since(start).blocks_in_use, 0u);
+}
+
+TEST(LargeAllocationsGetPagesOfTheirOwn) {
+  SecureArenaStats start = GetSecureArenaStats();
+  {
+    SecureArena arena;
+    uint8_t* small = arena.Allocate(64);
+    ASSERT_TRUE(small != nullptr);
+    uint8_t* large = arena.Allocate(3 * SecureArena::kBlockSize);
+    ASSERT_TRUE(large != nullptr);
+    EXPECT_TRUE(IsAligned(large));
+    EXPECT_TRUE(IsZero(large, 3 * SecureArena::kBlockSize));
+    std::memset(large, 0xee, 3 * SecureArena::kBlockSize);
+    std::memset(small, 0x11, 64);
+    EXPECT_EQ(static_cast<int>(large[0]), 0xee);
+    EXPECT_EQ(static_cast<int>(small[63]), 0x11);
+
+    // One pooled block, for the small one; the large one is not pooled.
+    EXPECT_EQ(Since(start).large_allocations, 1u);
+    EXPECT_EQ(Since(start).blocks_in_use, 1u);
+
+    // Whatever is left of the large block is used before taking another.
+    uint8_t* after = arena.Allocate(16);
+    ASSERT_TRUE(after != nullptr);
+    EXPECT_TRUE(IsZero(after, 16));
+    EXPECT_EQ(Since(start).blocks_in_use, 1u);
+  }
+  EXPECT_EQ(Since(start).blocks_in_use, 0u);
+  EXPECT_EQ(Since(start).large_allocations, 1u);
+}
+
+TEST(BlocksAreClearedAndReused) {
+  uint8_t* memory;
+  {
+    SecureArena arena;
+    memory = arena.Allocate(kMostOfABlock);
+    ASSERT_TRUE(memory != nullptr);
+    std::memset(memory, 0x5a, kMostOfABlock);
+  }
+  // Pooled blocks stay mapped, so what the arena left there can be checked.
+  EXPECT_TRUE(IsZero(memory, kMostOfABlock));
+
+  SecureArenaStats start = GetSecureArenaStats();
+  SecureArena arena;
+  uint8_t* again = arena.Allocate(kMostOfABlock);
+  // The block just returned is the first one handed out again, and the
+  // pool did not grow for it.
+  EXPECT_TRUE(again == memory);
+  EXPECT_TRUE(IsZero(again, kMostOfABlock));
+  EXPECT_EQ(Since(start).blocks, 0u);
+}
+
+TEST(StatsCountArenasAndAllocations) {
+  SecureArenaStats start = GetSecureArenaStats();
+  {
+    SecureArena first;
+    for (int i = 0; i < 5; i++) {
+      first.Allocate(32);
+    }
+    SecureArena second;
+    second.Allocate(8);
+    second.Allocate(2 * SecureArena::kBlockSize);
+    EXPECT_EQ(Since(start).arenas, 2u);
+    EXPECT_EQ(Since(start).blocks_in_use, 2u);
+  }
+  SecureArenaStats delta = Since(start);
+  // Allocations are counted when their arena goes away.
+  EXPECT_EQ(delta.allocations, 7u);
+  EXPECT_EQ(delta.large_allocations, 1u);
+  EXPECT_EQ(delta.blocks_in_use, 0u);
+
+  SecureArenaStats now = GetSecureArenaStats();
+  EXPECT_TRUE(now.blocks > 0);
+  EXPECT_EQ(now.blocks % 16, 0u);
+  EXPECT_EQ(now.blocks_in_use, 0u);
+  EXPECT_TRUE(now.locked_bytes <= now.blocks * SecureArena::kBlockSize);
+}
+
+TEST(SecureZeroClears) {
+  std::vector<uint8_t> buffer(1000, 0x42);
+  native_core::SecureZero(buffer.data() + 10, 980);
+  EXPECT_EQ(static_cast<int>(buffer[9]), 0x42);
+  EXPECT_TRUE(IsZero(buffer.data() + 10, 980));
+  EXPECT_EQ(static_cast<int>(buffer[990]), 0x42);
+}
@@ -0,0 +1,241 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/signing_journal.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "test_support.h"
+
+using native_core::JournaledPostsign;
+using native_core::SigningJournal;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+constexpr char kOwner[] = "https://proxy.example|MIIC";
+
+std::vector<uint8_t> Body(const std::string& text) {
+  return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+// The ids of the pending requests of |owner| in |journal|, in order.
+std::vector<std::string> PendingIds(const SigningJournal& journal,
+                                    const char* owner = kOwner) {
+  std::vector<std::string> ids;
+  for (const JournaledPostsign& postsign : journal.Pending(owner)) {
+    ids.push_back(postsign.request_id);
+  }
+  return ids;
+}
+
+std::vector<std::string> Ids(std::initializer_list<const char*> ids) {
+  return std::vector<std::string>(ids.begin(), ids.end());
+}
+
+// Flips the bits of the byte at |offset| of |path|.
+void CorruptByte(const std::filesystem::path& path, uintmax_t offset) {
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekg(static_cast<std::streamoff>(offset));
+  char byte = 0;
+  file.get(byte);
+  file.seekp(static_cast<std::streamoff>(offset));
+  file.put(static_cast<char>(~byte));
+}
+
+// Writes the journal at |path| with the signed requests "a", "b" and "c",
+// and returns the file size after each of them. Signed records are synced,
+// so the sizes are where each record ends on disk.
+std::vector<uintmax_t> WriteThreeSigned(const std::string& path) {
+  std::vector<uintmax_t> ends;
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  for (const char* id : {"a", "b", "c"}) {
+    journal->RecordSigned(kOwner, id, Body(std::string("body of ") + id));
+    ends.push_back(std::filesystem::file_size(std::filesystem::u8path(path)));
+  }
+  return ends;
+}
+
+}  // namespace
+
+TEST(PendingRequestsSurviveReopening) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  {
+    std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+    ASSERT_TRUE(journal);
+    EXPECT_TRUE(journal->RecordSigned(kOwner, "a", Body("first")));
+    EXPECT_TRUE(journal->RecordSigned(kOwner, "b", Body("second")));
+    EXPECT_TRUE(journal->RecordSigned(kOwner, "c", Body("third")));
+    journal->RecordPosted(kOwner, "b");
+    EXPECT_EQ(PendingIds(*journal), Ids({"a", "c"}));
+  }
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  std::vector<JournaledPostsign> pending = journal->Pending(kOwner);
+  ASSERT_TRUE(pending.size() == 2);
+  EXPECT_EQ(pending[0].request_id, std::string("a"));
+  EXPECT_EQ(pending[0].body, Body("first"));
+  EXPECT_EQ(pending[1].request_id, std::string("c"));
+  EXPECT_EQ(pending[1].body, Body("third"));
+  EXPECT_TRUE(journal->Pending("another owner").empty());
+}
+
+TEST(TornTailDropsOnlyTheLastRecord) {
+  TempDirectory directory;
+  std::string original = directory.File("original.journal");
+  std::vector<uintmax_t> ends = WriteThreeSigned(original);
+
+  // A crash may cut the last append anywhere.
+  for (uintmax_t size = ends[1] + 1; size < ends[2]; size++) {
+    std::string path = directory.File("torn.journal");
+    std::filesystem::copy_file(std::filesystem::u8path(original),
+                               std::filesystem::u8path(path),
+                               std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(std::filesystem::u8path(path), size);
+    {
+      std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+      ASSERT_TRUE(journal);
+      EXPECT_EQ(PendingIds(*journal), Ids({"a", "b"}));
+      // Opening dropped the torn bytes, so new records are readable.
+      EXPECT_TRUE(journal->RecordSigned(kOwner, "d", Body("fourth")));
+    }
+    std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+    ASSERT_TRUE(journal);
+    EXPECT_EQ(PendingIds(*journal), Ids({"a", "b", "d"}));
+  }
+}
+
+TEST(ChecksumMismatchDropsTheRecordAndWhatFollows) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  std::vector<uintmax_t> ends = WriteThreeSigned(path);
+
+  // The last byte of "b"'s body: the checksum no longer matches.
+  CorruptByte(std::filesystem::u8path(path), ends[1] - 1);
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  EXPECT_EQ(PendingIds(*journal), Ids({"a"}));
+}
+
+TEST(CorruptLengthDropsTheRecordAndWhatFollows) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  std::vector<uintmax_t> ends = WriteThreeSigned(path);
+
+  // The high byte of "b"'s payload size, which now runs past the end.
+  CorruptByte(std::filesystem::u8path(path), ends[0] + 3);
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  EXPECT_EQ(PendingIds(*journal), Ids({"a"}));
+}
+
+TEST(UnknownVersionStartsEmpty) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  WriteThreeSigned(path);
+
+  CorruptByte(std::filesystem::u8path(path), 4);
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  EXPECT_TRUE(journal->Pending(kOwner).empty());
+}
+
+TEST(KillDuringCompactionKeepsOneWholeJournal) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  WriteThreeSigned(path);
+  // What a crash before the rename leaves behind: a partial rewrite, which
+  // the next open replaces.
+  {
+    std::ofstream partial(std::filesystem::u8path(path + ".tmp"),
+                          std::ios::binary);
+    partial << "PFSJ";
+  }
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  EXPECT_EQ(PendingIds(*journal), Ids({"a", "b", "c"}));
+}
+
+#ifndef _WIN32
+
+namespace {
+
+// Runs |steps| in a child process that is then killed, so that nothing the
+// journal holds in memory or in stdio buffers reaches the file. Returns
+// whether the child got to the kill.
+template <typename Steps>
+bool RunAndKill(const std::string& path, Steps steps) {
+  pid_t child = fork();
+  if (child == 0) {
+    std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+    if (!journal) {
+      _exit(1);
+    }
+    steps(journal.get());
+    raise(SIGKILL);
+    _exit(1);
+  }
+  int status = 0;
+  return child > 0 && waitpid(child, &status, 0) == child &&
+         WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+}
+
+}  // namespace
+
+TEST(KillBetweenSignAndPostsignLeavesTheRequestPending) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  // Signed, and killed before the postsign was sent or answered.
+  ASSERT_TRUE(RunAndKill(path, [](SigningJournal* journal) {
+    journal->RecordSigned(kOwner, "a", Body("signatures of a"));
+  }));
+
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  std::vector<JournaledPostsign> pending = journal->Pending(kOwner);
+  ASSERT_TRUE(pending.size() == 1);
+  EXPECT_EQ(pending[0].request_id, std::string("a"));
+  EXPECT_EQ(pending[0].body, Body("signatures of a"));
+}
+
+TEST(KillAfterAnUnsyncedPostedRecordKeepsTheSignedOnes) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  // "Posted" records are not synced: if one is lost, the postsign is sent
+  // once more, but no signed record may be lost with it.
+  ASSERT_TRUE(RunAndKill(path, [](SigningJournal* journal) {
+    journal->RecordSigned(kOwner, "a", Body("signatures of a"));
+    journal->RecordSigned(kOwner, "b", Body("signatures of b"));
+    journal->RecordPosted(kOwner, "a");
+  }));
+
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  ASSERT_TRUE(journal);
+  std::vector<std::string> pending = PendingIds(*journal);
+  EXPECT_TRUE(pending == Ids({"a", "b"}) || pending == Ids({"b"}));
+}
+
+#endif  // _WIN32
@@ -0,0 +1,55 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cstdio>
+#include <cstring>
+
+#include "test_support.h"
+
+namespace native_core_tests {
+
+namespace {
+
+int failures = 0;
+
+}  // namespace
+
+void Fail(const char* file, int line, const std::string& message) {
+  std::fprintf(stderr, "%s:%d: FAILED %s\n", file, line, message.c_str());
+  failures++;
+}
+
+}  // namespace native_core_tests
+
+int main(int argc, char** argv) {
+  using native_core_tests::Registry;
+  int failed_tests = 0;
+  int run = 0;
+  for (const native_core_tests::TestCase& test : Registry()) {
+    if (argc > 1 && std::strstr(test.name, argv[1]) == nullptr) {
+      continue;
+    }
+    int failures_before = native_core_tests::failures;
+    auto start = std::chrono::steady_clock::now();
+    test.function();
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+    bool ok = native_core_tests::failures == failures_before;
+    std::printf("[%s] %s (%.0f ms)\n", ok ? "  OK  " : "FAILED", test.name,
+                ms);
+    failed_tests += ok ? 0 : 1;
+    run++;
+  }
+  std::printf("%d tests, %d failed\n", run, failed_tests);
+  return failed_tests == 0 && run > 0 ? 0 : 1;
+}
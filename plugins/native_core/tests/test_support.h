@@ -0,0 +1,177 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef NATIVE_CORE_TESTS_TEST_SUPPORT_H_
+#define NATIVE_CORE_TESTS_TEST_SUPPORT_H_
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Just enough of a test framework for the native_core tests, which run under
+// ctest on every platform the runtime builds on and so depend on nothing
+// but the runtime itself.
+//
+//   TEST(WorkerPoolRunsEveryTask) {
+//     ...
+//     EXPECT_EQ(ran.load(), 100);
+//   }
+//
+// Each test binary is one file of TESTs linked with test_main.cpp, which
+// runs them all, or those whose name contains its first argument.
+namespace native_core_tests {
+
+using TestFunction = void (*)();
+
+struct TestCase {
+  const char* name;
+  TestFunction function;
+};
+
+inline std::vector<TestCase>& Registry() {
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+struct Registrar {
+  Registrar(const char* name, TestFunction function) {
+    Registry().push_back({name, function});
+  }
+};
+
+// Reports a failed expectation of the running test.
+void Fail(const char* file, int line, const std::string& message);
+
+template <typename T, typename = void>
+struct Printable : std::false_type {};
+
+template <typename T>
+struct Printable<T, std::void_t<decltype(std::declval<std::ostream&>()
+                                         << std::declval<const T&>())>>
+    : std::true_type {};
+
+template <typename T>
+void Print(std::ostream& out, const T& value) {
+  if constexpr (Printable<T>::value) {
+    out << value;
+  }
+  else {
+    out << "(not printable)";
+  }
+}
+
+template <typename A, typename B>
+std::string Describe(const char* expression, const A& actual,
+                     const B& expected) {
+  std::ostringstream out;
+  out << expression << ": ";
+  Print(out, actual);
+  out << " vs ";
+  Print(out, expected);
+  return out.str();
+}
+
+// Polls |condition| until it holds or |timeout| elapses. Returns whether it
+// held, so that a lost wake-up fails the test instead of hanging it.
+inline bool WaitFor(const std::function<bool()>& condition,
+                    std::chrono::milliseconds timeout =
+                        std::chrono::seconds(10)) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// A directory of its own for one test, removed with everything in it when
+// the test ends.
+class TempDirectory {
+ public:
+  TempDirectory() {
+    std::random_device random;
+    path_ = std::filesystem::temp_directory_path() /
+            ("native_core_test_" + std::to_string(random()) +
+             std::to_string(random()));
+    std::filesystem::create_directories(path_);
+  }
+
+  ~TempDirectory() {
+    std::error_code error;
+    std::filesystem::remove_all(path_, error);
+  }
+
+  // Prevent copying.
+  TempDirectory(TempDirectory const&) = delete;
+  TempDirectory& operator=(TempDirectory const&) = delete;
+
+  const std::filesystem::path& path() const { return path_; }
+
+  // The UTF-8 path of |name| in the directory.
+  std::string File(const std::string& name) const {
+    return (path_ / name).u8string();
+  }
+
+ private:
+  std::filesystem::path path_;
+};
+
+}  // namespace native_core_tests
+
+#define TEST(name)                                                        \
+  static void name();                                                     \
+  static ::native_core_tests::Registrar name##_registrar(#name, &name);   \
+  static void name()
+
+#define EXPECT_TRUE(condition)                                            \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      ::native_core_tests::Fail(__FILE__, __LINE__, #condition);          \
+    }                                                                     \
+  } while (false)
+
+#define EXPECT_FALSE(condition) EXPECT_TRUE(!(condition))
+
+#define EXPECT_EQ(actual, expected)                                       \
+  do {                                                                    \
+    const auto& actual_value = (actual);                                  \
+    const auto& expected_value = (expected);                              \
+    if (!(actual_value == expected_value)) {                              \
+      ::native_core_tests::Fail(                                          \
+          __FILE__, __LINE__,                                             \
+          ::native_core_tests::Describe(#actual " == " #expected,         \
+                                        actual_value, expected_value));   \
+    }                                                                     \
+  } while (false)
+
+// Ends the test when |condition| does not hold, for what the rest of it
+// cannot do without.
+#define ASSERT_TRUE(condition)                                            \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      ::native_core_tests::Fail(__FILE__, __LINE__, #condition);          \
+      return;                                                             \
+    }                                                                     \
+  } while (false)
+
+#endif  // NATIVE_CORE_TESTS_TEST_SUPPORT_H_
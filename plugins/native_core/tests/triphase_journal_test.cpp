@@ -0,0 +1,142 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/signing_journal.h>
+#include <native_core/triphase_engine.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::JournaledPostsign;
+using native_core::SigningJournal;
+using native_core::TriphaseEngine;
+using native_core::TriphaseFailure;
+using native_core::TriphaseOptions;
+using native_core::TriphaseOutcome;
+using native_core::TriphaseTransport;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+constexpr char kOwner[] = "https://proxy.example|MIIC";
+
+// Answers every postsign with the same status and body.
+class CannedTransport : public TriphaseTransport {
+ public:
+  CannedTransport(int status, std::string body)
+      : status_(status), body_(std::move(body)) {}
+
+  int Post(const std::vector<uint8_t>&, const Sink& sink) override {
+    if (!body_.empty()) {
+      sink(body_.data(), body_.size());
+    }
+    return status_;
+  }
+
+ private:
+  int status_;
+  std::string body_;
+};
+
+std::string PostsignResponse(const char* status) {
+  return std::string(
+             "<?xml version=\"1.0\" encoding=\"UTF-8\"?><posts>"
+             "<req id=\"a\" status=\"") +
+         status + "\"/></posts>";
+}
+
+// Journals request "a" as signed, resumes its postsign against a proxy that
+// answers |status| with |body|, and returns whether it is still pending,
+// both right away and once the journal is reopened.
+bool StaysPending(int status, const std::string& body,
+                  TriphaseOutcome* outcome = nullptr) {
+  TempDirectory directory;
+  std::string path = directory.File("signing.journal");
+  bool pending = false;
+  {
+    std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+    std::vector<uint8_t> signed_body = {'o', 'p', '=', '1'};
+    journal->RecordSigned(kOwner, "a", signed_body);
+
+    CannedTransport transport(status, body);
+    TriphaseOptions options;
+    options.journal = journal.get();
+    options.journal_owner = kOwner;
+    TriphaseEngine engine(&transport, nullptr, options);
+    engine.Resume(journal->Pending(kOwner),
+                  [outcome](const TriphaseOutcome& result) {
+                    if (outcome) {
+                      *outcome = result;
+                    }
+                  });
+    pending = !journal->Pending(kOwner).empty();
+  }
+  std::unique_ptr<SigningJournal> reopened = SigningJournal::Open(path);
+  bool reopened_pending = !reopened->Pending(kOwner).empty();
+  EXPECT_EQ(reopened_pending, pending);
+  return pending;
+}
+
+}  // namespace
+
+TEST(PostsignAnsweredOkIsPosted) {
+  TriphaseOutcome outcome;
+  EXPECT_FALSE(StaysPending(200, PostsignResponse("OK"), &outcome));
+  EXPECT_TRUE(outcome.failure == TriphaseFailure::kNone);
+  EXPECT_TRUE(outcome.status_ok);
+}
+
+TEST(PostsignAnsweredKoIsPosted) {
+  TriphaseOutcome outcome;
+  EXPECT_FALSE(StaysPending(200, PostsignResponse("KO"), &outcome));
+  EXPECT_TRUE(outcome.failure == TriphaseFailure::kNone);
+  EXPECT_FALSE(outcome.status_ok);
+}
+
+TEST(PostsignRejectedByTheProxyIsPosted) {
+  EXPECT_FALSE(StaysPending(
+      200, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+           "<err cd=\"ERR-02\">Petición de postfirma vacía</err>"));
+}
+
+TEST(PostsignWithoutResponseStaysPending) {
+  TriphaseOutcome outcome;
+  EXPECT_TRUE(StaysPending(0, "", &outcome));
+  EXPECT_TRUE(outcome.failure == TriphaseFailure::kNetwork);
+}
+
+TEST(PostsignOfExpiredSessionStaysPending) {
+  EXPECT_TRUE(StaysPending(401, ""));
+}
+
+TEST(PostsignServerErrorStaysPending) {
+  EXPECT_TRUE(StaysPending(500, "<html>Internal Server Error</html>"));
+  EXPECT_TRUE(StaysPending(503, ""));
+}
+
+TEST(PostsignTruncatedResponseStaysPending) {
+  std::string response = PostsignResponse("OK");
+  // Cut anywhere before the root element closes.
+  for (size_t size : {size_t{0}, size_t{10}, response.size() / 2,
+                      response.size() - 3}) {
+    EXPECT_TRUE(StaysPending(200, response.substr(0, size)));
+  }
+}
+
+TEST(PostsignUnparseableResponseStaysPending) {
+  EXPECT_TRUE(StaysPending(200, "<posts><req id=\"a\" status=\"OK\"></posts>"));
+  EXPECT_TRUE(StaysPending(200, "not xml at all"));
+}
@@ -0,0 +1,274 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Signs batches end to end: the triphase engine, the HTTP client and a
+// FileKeySigner against proxy_standin, started for each test on a free port.
+// ctest passes the stand-in in PROXY_STANDIN and the key, tests/data/
+// file_key.pem (a throwaway key and self-signed certificate), in TEST_KEY.
+#include <native_core/cancellation_token.h>
+#include <native_core/file_key_signer.h>
+#include <native_core/http_client.h>
+#include <native_core/proxy_session.h>
+#include <native_core/signing_journal.h>
+#include <native_core/triphase_engine.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::CancellationSource;
+using native_core::FileKeySigner;
+using native_core::HttpClient;
+using native_core::ListedRequest;
+using native_core::ProxySession;
+using native_core::SigningJournal;
+using native_core::TriphaseEngine;
+using native_core::TriphaseFailure;
+using native_core::TriphaseJob;
+using native_core::TriphaseOptions;
+using native_core::TriphaseOutcome;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+// Requests of the single user of the stand-in; every fifth one, the fifth
+// and the tenth, is an approval.
+constexpr int kRequests = 10;
+constexpr int kApprovals = 2;
+
+// proxy_standin, run for the life of the object.
+class StandIn {
+ public:
+  StandIn() {
+    const char* path = std::getenv("PROXY_STANDIN");
+    int output[2];
+    if (!path || pipe(output) != 0) {
+      return;
+    }
+    pid_ = fork();
+    if (pid_ == 0) {
+      dup2(output[1], STDERR_FILENO);
+      close(output[0]);
+      close(output[1]);
+      execl(path, path, "--port", "0", "--users", "1", "--requests",
+            std::to_string(kRequests).c_str(), "--documents", "3",
+            "--document-kb", "1", static_cast<char*>(nullptr));
+      _exit(127);
+    }
+    close(output[1]);
+    // "Serving ... on http://127.0.0.1:PORT/".
+    std::string line;
+    char c = 0;
+    while (line.size() < 256 && read(output[0], &c, 1) == 1 && c != '\n') {
+      line += c;
+    }
+    close(output[0]);
+    size_t url = line.rfind("http://");
+    if (pid_ > 0 && url != std::string::npos) {
+      url_ = line.substr(url);
+    }
+  }
+
+  ~StandIn() {
+    if (pid_ > 0) {
+      kill(pid_, SIGTERM);
+      int status = 0;
+      waitpid(pid_, &status, 0);
+    }
+  }
+
+  // Prevent copying.
+  StandIn(StandIn const&) = delete;
+  StandIn& operator=(StandIn const&) = delete;
+
+  // Empty if the stand-in did not start.
+  const std::string& url() const { return url_; }
+
+ private:
+  pid_t pid_ = -1;
+  std::string url_;
+};
+
+std::unique_ptr<FileKeySigner> OpenKey() {
+  const char* path = std::getenv("TEST_KEY");
+  std::string error;
+  return path ? FileKeySigner::Open(path, &error) : nullptr;
+}
+
+// A logged in session of the stand-in's user, with the signer and client it
+// needs.
+struct Fixture {
+  Fixture() : session(client.get(), standin.url()) {
+    if (signer && !standin.url().empty()) {
+      std::string error;
+      logged_in = session.Login(signer.get(), &error);
+    }
+  }
+
+  // The requests listed in |state|, all in one page.
+  std::vector<ListedRequest> List(const std::string& state) {
+    std::vector<ListedRequest> requests;
+    int total = -1;
+    std::string error;
+    if (!session.ListRequests(state, 1, 100, &requests, &total, &error)) {
+      requests.clear();
+    }
+    return requests;
+  }
+
+  StandIn standin;
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+  ProxySession session;
+  bool logged_in = false;
+};
+
+std::vector<TriphaseJob> Jobs(const std::vector<ListedRequest>& requests) {
+  std::vector<TriphaseJob> jobs;
+  for (const ListedRequest& request : requests) {
+    jobs.push_back({request.id, request.documents});
+  }
+  return jobs;
+}
+
+// Runs |jobs| and returns their outcomes by index, checking that each job got
+// exactly one.
+std::vector<TriphaseOutcome> RunBatch(TriphaseEngine* engine,
+                                      const std::vector<TriphaseJob>& jobs,
+                                      native_core::CancellationToken token =
+                                          native_core::CancellationToken()) {
+  std::vector<TriphaseOutcome> outcomes(jobs.size());
+  std::vector<int> counts(jobs.size());
+  engine->Run(jobs, [&](const TriphaseOutcome& outcome) {
+    if (outcome.index < jobs.size()) {
+      outcomes[outcome.index] = outcome;
+      counts[outcome.index]++;
+    }
+  }, std::move(token));
+  EXPECT_EQ(counts, std::vector<int>(jobs.size(), 1));
+  return outcomes;
+}
+
+}  // namespace
+
+TEST(BatchSignsEverySignatureRequest) {
+  Fixture fixture;
+  ASSERT_TRUE(fixture.logged_in);
+  std::vector<ListedRequest> listed = fixture.List("unresolved");
+  ASSERT_TRUE(listed.size() == static_cast<size_t>(kRequests));
+
+  std::vector<ListedRequest> signatures;
+  for (const ListedRequest& request : listed) {
+    if (request.type == 0) {
+      signatures.push_back(request);
+    }
+  }
+  EXPECT_EQ(signatures.size(), static_cast<size_t>(kRequests - kApprovals));
+
+  TriphaseEngine engine(fixture.session.transport(), fixture.signer.get());
+  std::vector<TriphaseOutcome> outcomes = RunBatch(&engine, Jobs(signatures));
+  for (size_t i = 0; i < outcomes.size(); i++) {
+    EXPECT_TRUE(outcomes[i].status_ok);
+    EXPECT_TRUE(outcomes[i].failure == TriphaseFailure::kNone);
+    EXPECT_EQ(outcomes[i].id, signatures[i].id);
+  }
+  EXPECT_EQ(fixture.List("signed").size(), signatures.size());
+  EXPECT_EQ(fixture.List("unresolved").size(), static_cast<size_t>(kApprovals));
+}
+
+TEST(FailedRequestsDoNotStopTheBatch) {
+  Fixture fixture;
+  ASSERT_TRUE(fixture.logged_in);
+  // Approvals take no signature: their presign is KO.
+  std::vector<ListedRequest> listed = fixture.List("unresolved");
+  ASSERT_TRUE(listed.size() == static_cast<size_t>(kRequests));
+
+  TriphaseOptions options;
+  options.presign_window = 1;
+  options.postsign_window = 3;
+  TriphaseEngine engine(fixture.session.transport(), fixture.signer.get(),
+                        options);
+  std::vector<TriphaseOutcome> outcomes = RunBatch(&engine, Jobs(listed));
+  for (size_t i = 0; i < outcomes.size(); i++) {
+    if (listed[i].type == 0) {
+      EXPECT_TRUE(outcomes[i].status_ok);
+    }
+    else {
+      EXPECT_FALSE(outcomes[i].status_ok);
+      EXPECT_TRUE(outcomes[i].failure == TriphaseFailure::kPresign);
+    }
+  }
+
+  // Signed requests are no longer pending: a second batch fails them all.
+  std::vector<TriphaseOutcome> again = RunBatch(&engine, Jobs(listed));
+  for (const TriphaseOutcome& outcome : again) {
+    EXPECT_FALSE(outcome.status_ok);
+  }
+  EXPECT_EQ(fixture.List("signed").size(),
+            static_cast<size_t>(kRequests - kApprovals));
+}
+
+TEST(CancelledBatchPostsignsWhatItSigned) {
+  Fixture fixture;
+  ASSERT_TRUE(fixture.logged_in);
+  std::vector<ListedRequest> signatures;
+  for (const ListedRequest& request : fixture.List("unresolved")) {
+    if (request.type == 0) {
+      signatures.push_back(request);
+    }
+  }
+  ASSERT_TRUE(signatures.size() == static_cast<size_t>(kRequests - kApprovals));
+
+  TempDirectory directory;
+  std::unique_ptr<SigningJournal> journal =
+      SigningJournal::Open(directory.File("signing.journal"));
+  ASSERT_TRUE(journal);
+  TriphaseOptions options;
+  options.presign_window = 1;
+  options.journal = journal.get();
+  options.journal_owner = fixture.session.journal_owner();
+  TriphaseEngine engine(fixture.session.transport(), fixture.signer.get(),
+                        options);
+  // Cancelled from the first outcome on, wherever the pipeline is by then.
+  CancellationSource cancellation;
+  std::vector<TriphaseJob> jobs = Jobs(signatures);
+  std::vector<TriphaseOutcome> outcomes(jobs.size());
+  engine.Run(jobs, [&](const TriphaseOutcome& outcome) {
+    outcomes[outcome.index] = outcome;
+    cancellation.Cancel();
+  }, cancellation.token());
+
+  size_t signed_ok = 0;
+  size_t cancelled = 0;
+  for (const TriphaseOutcome& outcome : outcomes) {
+    signed_ok += outcome.status_ok;
+    cancelled += outcome.failure == TriphaseFailure::kCancelled;
+  }
+  EXPECT_TRUE(signed_ok >= 1);
+  EXPECT_TRUE(cancelled >= 1);
+  EXPECT_EQ(signed_ok + cancelled, jobs.size());
+  // Every signature that was made reached the proxy, and none is left to
+  // resume.
+  EXPECT_EQ(fixture.List("signed").size(), signed_ok);
+  EXPECT_TRUE(journal->Pending(fixture.session.journal_owner()).empty());
+}
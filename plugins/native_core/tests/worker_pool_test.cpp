@@ -0,0 +1,165 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <native_core/worker_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "test_support.h"
+
+using native_core::WorkerPool;
+using native_core_tests::WaitFor;
+
+namespace {
+
+// Holds the workers that run Block() until Release().
+class Gate {
+ public:
+  void Block() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    blocked_++;
+    changed_.notify_all();
+    changed_.wait(lock, [this]() { return open_; });
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = true;
+    changed_.notify_all();
+  }
+
+  // Waits until |count| workers are held.
+  bool WaitBlocked(int count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, std::chrono::seconds(10),
+                             [&]() { return blocked_ >= count; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  int blocked_ = 0;
+  bool open_ = false;
+};
+
+}  // namespace
+
+TEST(WorkerPoolRunsEveryTask) {
+  std::atomic<int> ran{0};
+  {
+    WorkerPool pool(4, 1000);
+    EXPECT_EQ(pool.thread_count(), size_t{4});
+    for (int i = 0; i < 500; i++) {
+      EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }));
+    }
+    EXPECT_TRUE(WaitFor([&ran]() { return ran.load() == 500; }));
+  }
+  EXPECT_EQ(ran.load(), 500);
+}
+
+TEST(WorkerPoolHasAtLeastOneThread) {
+  std::atomic<bool> ran{false};
+  WorkerPool pool(0, 4);
+  EXPECT_EQ(pool.thread_count(), size_t{1});
+  EXPECT_TRUE(pool.TryPost([&ran]() { ran = true; }));
+  EXPECT_TRUE(WaitFor([&ran]() { return ran.load(); }));
+}
+
+TEST(WorkerPoolRunsTasksOnItsThreads) {
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  Gate gate;
+  {
+    WorkerPool pool(3, 16);
+    for (int i = 0; i < 3; i++) {
+      pool.TryPost([&]() {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          threads.insert(std::this_thread::get_id());
+        }
+        gate.Block();
+      });
+    }
+    // Three tasks held at once can only be on three different workers.
+    EXPECT_TRUE(gate.WaitBlocked(3));
+    gate.Release();
+  }
+  EXPECT_EQ(threads.size(), size_t{3});
+  EXPECT_EQ(threads.count(std::this_thread::get_id()), size_t{0});
+}
+
+TEST(WorkerPoolTryPostIsBounded) {
+  Gate gate;
+  std::atomic<int> ran{0};
+  {
+    WorkerPool pool(1, 2);
+    ASSERT_TRUE(pool.TryPost([&]() {
+      gate.Block();
+      ran++;
+    }));
+    // Once the only worker holds the first task, two more fit in the queue.
+    ASSERT_TRUE(gate.WaitBlocked(1));
+    EXPECT_EQ(pool.pending(), size_t{0});
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }));
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }));
+    EXPECT_EQ(pool.pending(), size_t{2});
+    bool refused_ran = false;
+    EXPECT_FALSE(pool.TryPost([&refused_ran]() { refused_ran = true; }));
+    EXPECT_EQ(pool.pending(), size_t{2});
+    gate.Release();
+    EXPECT_TRUE(WaitFor([&ran]() { return ran.load() == 3; }));
+    // Room again once the queue drained.
+    EXPECT_TRUE(pool.TryPost([&ran]() { ran++; }));
+    EXPECT_TRUE(WaitFor([&ran]() { return ran.load() == 4; }));
+    EXPECT_FALSE(refused_ran);
+  }
+  EXPECT_EQ(ran.load(), 4);
+}
+
+TEST(WorkerPoolDrainsQueuedTasksOnShutdown) {
+  Gate gate;
+  std::atomic<int> ran{0};
+  auto pool = std::make_unique<WorkerPool>(1, 16);
+  ASSERT_TRUE(pool->TryPost([&gate]() { gate.Block(); }));
+  ASSERT_TRUE(gate.WaitBlocked(1));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(pool->TryPost([&ran]() { ran++; }));
+  }
+  EXPECT_EQ(pool->pending(), size_t{10});
+  // Shutdown starts with the worker held and ten tasks queued; it runs them
+  // all before the workers are joined.
+  std::thread destroyer([&pool]() { pool.reset(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(ran.load(), 0);
+  gate.Release();
+  destroyer.join();
+  EXPECT_EQ(ran.load(), 10);
+}
+
+TEST(WorkerPoolAcceptsPostsFromItsTasks) {
+  std::atomic<int> ran{0};
+  WorkerPool pool(2, 64);
+  for (int i = 0; i < 8; i++) {
+    pool.TryPost([&pool, &ran]() {
+      ran++;
+      pool.TryPost([&ran]() { ran++; });
+    });
+  }
+  EXPECT_TRUE(WaitFor([&ran]() { return ran.load() == 16; }));
+}
@@ -0,0 +1,148 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// XAdES signatures of the documents in tests/data/xades, which exercise
+// canonicalization: comments, processing instructions and a DTD outside the
+// root, references and CDATA, redundant and redeclared namespaces, quotes
+// and whitespace. The *.signed.xml and *.detached.xml signatures next to
+// them were made at kSigningTime with the key of tests/data/file_key.pem and
+// checked with xades_verify.py (xmlsec1, or lxml and openssl), which
+// xades_verify.cmake runs; SignXml() must reproduce them. ctest passes the
+// directory in TEST_DATA and the key in TEST_KEY.
+#include <native_core/file_key_signer.h>
+#include <native_core/xades_signer.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "test_support.h"
+
+using native_core::DigestAlgorithm;
+using native_core::FileKeySigner;
+using native_core::XadesOptions;
+using native_core::XadesResult;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+// 2022-06-01 12:00:00 UTC, the signing time of the fixtures.
+constexpr int64_t kSigningTime = 1654084800;
+
+// A fixture signature and how it was made.
+struct Fixture {
+  const char* document;
+  const char* signature;
+  DigestAlgorithm digest;
+  bool detached;
+};
+
+constexpr Fixture kFixtures[] = {
+    {"document.xml", "document.signed.xml", DigestAlgorithm::kSha256, false},
+    {"document.xml", "document.detached.xml", DigestAlgorithm::kSha512, true},
+    {"prefixes.xml", "prefixes.signed.xml", DigestAlgorithm::kSha384, false},
+};
+
+std::string DataPath(const std::string& name) {
+  const char* directory = std::getenv("TEST_DATA");
+  return std::string(directory ? directory : ".") + "/xades/" + name;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+std::unique_ptr<FileKeySigner> OpenKey() {
+  const char* path = std::getenv("TEST_KEY");
+  std::string error;
+  return path ? FileKeySigner::Open(path, &error) : nullptr;
+}
+
+XadesOptions OptionsFor(const Fixture& fixture) {
+  XadesOptions options;
+  options.digest = fixture.digest;
+  if (fixture.detached) {
+    options.packaging = XadesOptions::Packaging::kDetached;
+    options.detached_uri = fixture.document;
+  }
+  options.signing_time = std::chrono::system_clock::time_point(
+      std::chrono::seconds(kSigningTime));
+  return options;
+}
+
+}  // namespace
+
+TEST(FixtureSignaturesAreReproduced) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  for (const Fixture& fixture : kFixtures) {
+    std::string expected = ReadFile(DataPath(fixture.signature));
+    ASSERT_TRUE(!expected.empty());
+    std::string output = directory.File(fixture.signature);
+    XadesResult result;
+    std::string error;
+    EXPECT_TRUE(native_core::SignXml(signer.get(), DataPath(fixture.document),
+                                     output, OptionsFor(fixture), &result,
+                                     &error));
+    EXPECT_TRUE(ReadFile(output) == expected);
+    EXPECT_EQ(result.output_size, static_cast<uint64_t>(expected.size()));
+  }
+}
+
+TEST(EnvelopedSignatureKeepsTheDocumentAroundIt) {
+  // Everything up to the end tag of the root, and after it, is copied as is.
+  std::string document = ReadFile(DataPath("document.xml"));
+  std::string signed_document = ReadFile(DataPath("document.signed.xml"));
+  size_t end_tag = document.rfind("</doc>");
+  ASSERT_TRUE(end_tag != std::string::npos);
+  EXPECT_TRUE(signed_document.compare(0, end_tag, document, 0, end_tag) == 0);
+  std::string tail = document.substr(end_tag);
+  EXPECT_TRUE(signed_document.size() > tail.size() &&
+              signed_document.compare(signed_document.size() - tail.size(),
+                                      tail.size(), tail) == 0);
+}
+
+TEST(MalformedDocumentsFailWithoutOutput) {
+  std::unique_ptr<FileKeySigner> signer = OpenKey();
+  ASSERT_TRUE(signer);
+  TempDirectory directory;
+  std::string document = ReadFile(DataPath("document.xml"));
+  const std::string inputs[] = {
+      // Cut inside the root element.
+      document.substr(0, document.size() / 2),
+      // An undeclared prefix.
+      "<r><p:x/></r>",
+      // No root element.
+      "<?xml version=\"1.0\"?>\n<!-- nothing -->\n",
+  };
+  for (const std::string& input : inputs) {
+    std::string input_path = directory.File("input.xml");
+    std::ofstream(input_path, std::ios::binary) << input;
+    std::string output = directory.File("output.xml");
+    XadesOptions options;
+    XadesResult result;
+    std::string error;
+    EXPECT_FALSE(native_core::SignXml(signer.get(), input_path, output,
+                                      options, &result, &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(std::filesystem::exists(output));
+  }
+}
@@ -0,0 +1,84 @@
+# Copyright 2022. Chema Molins.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Checks XAdES signatures with xades_verify.py (xmlsec1, or lxml and openssl
+# without it): the fixtures of tests/data/xades, and new ones that
+# xades_sign makes of every document there with every digest, enveloped and
+# detached. Changed documents and signed properties must fail. Run by ctest,
+# or by hand:
+#
+#   cmake -DPYTHON=python3 -DXADES_SIGN=path/to/xades_sign -DDATA=tests/data
+#       -DWORK=/tmp/xades -P tests/xades_verify.cmake
+foreach(variable PYTHON XADES_SIGN DATA WORK)
+  if(NOT DEFINED ${variable})
+    message(FATAL_ERROR "${variable} is not set")
+  endif()
+endforeach()
+
+set(key "${DATA}/file_key.pem")
+set(verifier "${CMAKE_CURRENT_LIST_DIR}/xades_verify.py")
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+
+# Runs the verifier on |ARGN|; it must succeed if |expected| is true.
+function(verify expected)
+  execute_process(COMMAND "${PYTHON}" "${verifier}" --trusted "${key}" ${ARGN}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+  if(expected AND NOT result EQUAL 0)
+    message(FATAL_ERROR "Signatures do not verify:\n${output}")
+  endif()
+  if(NOT expected AND result EQUAL 0)
+    message(FATAL_ERROR "Changed signatures verify:\n${output}")
+  endif()
+endfunction()
+
+verify(TRUE "${DATA}/xades/document.signed.xml"
+  "${DATA}/xades/document.detached.xml" "${DATA}/xades/prefixes.signed.xml")
+
+set(signatures)
+foreach(document document prefixes same_namespace attributes empty_root)
+  file(COPY "${DATA}/xades/${document}.xml" DESTINATION "${WORK}")
+  foreach(digest SHA-1 SHA-256 SHA-384 SHA-512)
+    set(enveloped "${WORK}/${document}.${digest}.xml")
+    set(detached "${WORK}/${document}.${digest}.detached.xml")
+    execute_process(COMMAND "${XADES_SIGN}" "${key}"
+      "${WORK}/${document}.xml" "${enveloped}" ${digest}
+      RESULT_VARIABLE enveloped_result OUTPUT_QUIET)
+    execute_process(COMMAND "${XADES_SIGN}" "${key}"
+      "${WORK}/${document}.xml" "${detached}" ${digest}
+      --detached "${document}.xml"
+      RESULT_VARIABLE detached_result OUTPUT_QUIET)
+    if(NOT enveloped_result EQUAL 0 OR NOT detached_result EQUAL 0)
+      message(FATAL_ERROR "xades_sign failed for ${document} with ${digest}")
+    endif()
+    list(APPEND signatures "${enveloped}" "${detached}")
+  endforeach()
+endforeach()
+verify(TRUE ${signatures})
+
+# A changed document, a changed detached document and a changed signing time.
+file(READ "${DATA}/xades/document.signed.xml" signed)
+string(REPLACE "text &gt;" "texto &gt;" changed "${signed}")
+file(WRITE "${WORK}/changed.xml" "${changed}")
+verify(FALSE "${WORK}/changed.xml")
+file(COPY "${DATA}/xades/document.detached.xml" DESTINATION "${WORK}")
+file(READ "${DATA}/xades/document.xml" document)
+string(REPLACE "text &gt;" "texto &gt;" changed "${document}")
+file(WRITE "${WORK}/document.xml" "${changed}")
+verify(FALSE "${WORK}/document.detached.xml")
+string(REGEX REPLACE "<xades:SigningTime>2022" "<xades:SigningTime>2021"
+  changed "${signed}")
+file(WRITE "${WORK}/changed.xml" "${changed}")
+verify(FALSE "${WORK}/changed.xml")
+file(REMOVE_RECURSE "${WORK}")
@@ -0,0 +1,254 @@
+# Copyright 2022. Chema Molins.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Verifies XAdES signatures made by xades_sign against a trusted certificate.
+
+  python3 xades_verify.py --trusted cert.pem signature.xml [signature.xml ...]
+
+With xmlsec1 installed the signatures are verified with it. Otherwise, or
+with --lxml, every reference and the signature value are checked with lxml
+(for the canonicalization) and the openssl command. Both ways the XAdES
+SignedProperties must be signed and name the certificate that signed. A
+detached document is looked up next to its signature. Exits with 1 if any
+signature does not verify.
+"""
+
+import argparse
+import base64
+import copy
+import hashlib
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+from lxml import etree
+
+DS = 'http://www.w3.org/2000/09/xmldsig#'
+XADES = 'http://uri.etsi.org/01903/v1.3.2#'
+SIGNED_PROPERTIES = 'http://uri.etsi.org/01903#SignedProperties'
+
+DIGESTS = {
+    'http://www.w3.org/2000/09/xmldsig#sha1': 'sha1',
+    'http://www.w3.org/2001/04/xmlenc#sha256': 'sha256',
+    'http://www.w3.org/2001/04/xmldsig-more#sha384': 'sha384',
+    'http://www.w3.org/2001/04/xmlenc#sha512': 'sha512',
+}
+SIGNATURES = {
+    'http://www.w3.org/2000/09/xmldsig#rsa-sha1': 'sha1',
+    'http://www.w3.org/2001/04/xmldsig-more#rsa-sha256': 'sha256',
+    'http://www.w3.org/2001/04/xmldsig-more#rsa-sha384': 'sha384',
+    'http://www.w3.org/2001/04/xmldsig-more#rsa-sha512': 'sha512',
+}
+ENVELOPED = 'http://www.w3.org/2000/09/xmldsig#enveloped-signature'
+# Canonicalization algorithms: (exclusive, with comments).
+CANONICALIZATIONS = {
+    'http://www.w3.org/2001/10/xml-exc-c14n#': (True, False),
+    'http://www.w3.org/2001/10/xml-exc-c14n#WithComments': (True, True),
+    'http://www.w3.org/TR/2001/REC-xml-c14n-20010315': (False, False),
+    'http://www.w3.org/TR/2001/REC-xml-c14n-20010315#WithComments':
+        (False, True),
+}
+
+
+class VerificationError(Exception):
+    pass
+
+
+def ds(name):
+    return '{%s}%s' % (DS, name)
+
+
+def find_signature(tree):
+    root = tree.getroot()
+    if root.tag == ds('Signature'):
+        return root
+    signature = root.find('.//' + ds('Signature'))
+    if signature is None:
+        raise VerificationError('no ds:Signature')
+    return signature
+
+
+def canonicalize(node, algorithm):
+    if algorithm not in CANONICALIZATIONS:
+        raise VerificationError('unsupported canonicalization ' + algorithm)
+    exclusive, comments = CANONICALIZATIONS[algorithm]
+    return etree.tostring(node, method='c14n', exclusive=exclusive,
+                          with_comments=comments)
+
+
+def without_signature(tree):
+    """The document of an enveloped signature without the signature."""
+    document = copy.deepcopy(tree)
+    signature = find_signature(document)
+    parent = signature.getparent()
+    if signature.tail:
+        previous = signature.getprevious()
+        if previous is not None:
+            previous.tail = (previous.tail or '') + signature.tail
+        else:
+            parent.text = (parent.text or '') + signature.tail
+    parent.remove(signature)
+    return document
+
+
+def reference_data(reference, tree, path):
+    uri = reference.get('URI')
+    transforms = [transform.get('Algorithm') for transform in
+                  reference.findall(ds('Transforms') + '/' + ds('Transform'))]
+    if uri == '':
+        node = tree
+    elif uri.startswith('#'):
+        matches = tree.xpath('//*[@Id=$id]', id=uri[1:])
+        if len(matches) != 1:
+            raise VerificationError('no single element with Id ' + uri[1:])
+        node = matches[0]
+    else:
+        document = os.path.join(os.path.dirname(path), uri)
+        if not transforms:
+            with open(document, 'rb') as file:
+                return file.read()
+        node = etree.parse(document)
+    data = None
+    for transform in transforms:
+        if transform == ENVELOPED:
+            node = without_signature(node)
+        else:
+            data = canonicalize(node, transform)
+    # Node sets without a canonicalization transform get inclusive C14N.
+    return data if data is not None else canonicalize(
+        node, 'http://www.w3.org/TR/2001/REC-xml-c14n-20010315')
+
+
+def check_xades(signature, certificate):
+    """The SignedProperties are signed and name |certificate| (DER)."""
+    signed_info = signature.find(ds('SignedInfo'))
+    types = [reference.get('Type')
+             for reference in signed_info.findall(ds('Reference'))]
+    if SIGNED_PROPERTIES not in types:
+        raise VerificationError('the SignedProperties are not signed')
+    digest = signature.find('.//{%s}CertDigest' % XADES)
+    if digest is None:
+        raise VerificationError('no signing certificate digest')
+    algorithm = DIGESTS.get(digest.find(ds('DigestMethod')).get('Algorithm'))
+    expected = base64.b64decode(digest.find(ds('DigestValue')).text)
+    if algorithm is None or \
+            hashlib.new(algorithm, certificate).digest() != expected:
+        raise VerificationError('the signing certificate digest differs')
+
+
+def embedded_certificate(signature):
+    node = signature.find('.//' + ds('X509Certificate'))
+    if node is None:
+        raise VerificationError('no ds:X509Certificate')
+    return base64.b64decode(''.join(node.text.split()))
+
+
+def verify_with_lxml(path, trusted, scratch):
+    tree = etree.parse(path)
+    signature = find_signature(tree)
+    signed_info = signature.find(ds('SignedInfo'))
+    for reference in signed_info.findall(ds('Reference')):
+        algorithm = DIGESTS.get(
+            reference.find(ds('DigestMethod')).get('Algorithm'))
+        if algorithm is None:
+            raise VerificationError('unsupported digest')
+        digest = hashlib.new(algorithm,
+                             reference_data(reference, tree, path)).digest()
+        expected = base64.b64decode(reference.find(ds('DigestValue')).text)
+        if digest != expected:
+            raise VerificationError(
+                'digest of reference %r differs' % reference.get('URI'))
+
+    certificate = embedded_certificate(signature)
+    if certificate != trusted:
+        raise VerificationError('signed with an untrusted certificate')
+    check_xades(signature, certificate)
+
+    method = signed_info.find(ds('SignatureMethod')).get('Algorithm')
+    if method not in SIGNATURES:
+        raise VerificationError('unsupported signature method ' + method)
+    canonicalization = signed_info.find(
+        ds('CanonicalizationMethod')).get('Algorithm')
+    files = {name: os.path.join(scratch, name)
+             for name in ('signed_info', 'value', 'certificate', 'key')}
+    with open(files['signed_info'], 'wb') as file:
+        file.write(canonicalize(signed_info, canonicalization))
+    with open(files['value'], 'wb') as file:
+        file.write(base64.b64decode(
+            ''.join(signature.find(ds('SignatureValue')).text.split())))
+    with open(files['certificate'], 'wb') as file:
+        file.write(certificate)
+    subprocess.run(['openssl', 'x509', '-inform', 'DER', '-in',
+                    files['certificate'], '-pubkey', '-noout', '-out',
+                    files['key']], check=True)
+    result = subprocess.run(
+        ['openssl', 'dgst', '-' + SIGNATURES[method], '-verify', files['key'],
+         '-signature', files['value'], files['signed_info']],
+        capture_output=True, text=True)
+    if 'Verified OK' not in result.stdout:
+        raise VerificationError('the signature value does not verify')
+
+
+def verify_with_xmlsec(path, trusted_pem, trusted, xmlsec):
+    result = subprocess.run(
+        [xmlsec, '--verify', '--trusted-pem', trusted_pem,
+         '--id-attr:Id', XADES + ':SignedProperties',
+         os.path.basename(path)],
+        cwd=os.path.dirname(os.path.abspath(path)),
+        capture_output=True, text=True)
+    if result.returncode != 0:
+        raise VerificationError('xmlsec1: ' + result.stderr.strip())
+    signature = find_signature(etree.parse(path))
+    certificate = embedded_certificate(signature)
+    if certificate != trusted:
+        raise VerificationError('signed with an untrusted certificate')
+    check_xades(signature, certificate)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--trusted', required=True,
+                        help='PEM file with the signing certificate')
+    parser.add_argument('--lxml', action='store_true',
+                        help='verify with lxml even if xmlsec1 is installed')
+    parser.add_argument('signatures', nargs='+')
+    arguments = parser.parse_args()
+
+    xmlsec = None if arguments.lxml else shutil.which('xmlsec1')
+    with tempfile.TemporaryDirectory() as scratch:
+        # The certificate alone, whatever else the PEM file holds.
+        trusted_pem = os.path.join(scratch, 'trusted.pem')
+        subprocess.run(['openssl', 'x509', '-in', arguments.trusted, '-out',
+                        trusted_pem], check=True)
+        trusted = subprocess.run(
+            ['openssl', 'x509', '-in', trusted_pem, '-outform', 'DER'],
+            capture_output=True, check=True).stdout
+        failed = False
+        for path in arguments.signatures:
+            try:
+                if xmlsec:
+                    verify_with_xmlsec(path, trusted_pem, trusted, xmlsec)
+                else:
+                    verify_with_lxml(path, trusted, scratch)
+                print('%s: OK (%s)' % (path, 'xmlsec1' if xmlsec else 'lxml'))
+            except (VerificationError, etree.Error, OSError) as error:
+                print('%s: FAILED: %s' % (path, error))
+                failed = True
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
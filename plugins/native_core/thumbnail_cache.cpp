@@ -0,0 +1,321 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/thumbnail_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "include/native_core/digest.h"
+#include "include/native_core/mapped_file.h"
+#include "include/native_core/pdf_renderer.h"
+#include "include/native_core/png_encoder.h"
+
+namespace native_core {
+
+namespace {
+
+// Thumbnails are named after their key: the hex SHA-256 of the document, a
+// dash and the size.
+constexpr size_t kHashLength = 64;
+constexpr char kExtension[] = ".png";
+
+// Documents that could not be rendered kept at most.
+constexpr size_t kMaxFailed = 256;
+
+bool IsThumbnailName(const std::string& name) {
+  if (name.size() < kHashLength + 2 + sizeof(kExtension) - 1) {
+    return false;
+  }
+  size_t extension = name.size() - (sizeof(kExtension) - 1);
+  if (name.compare(extension, std::string::npos, kExtension) != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < extension; i++) {
+    char c = name[i];
+    bool valid = i < kHashLength
+                     ? (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')
+                     : i == kHashLength || (c >= '0' && c <= '9');
+    if (!valid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string Hex(const std::vector<uint8_t>& bytes) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(bytes.size() * 2);
+  for (uint8_t byte : bytes) {
+    hex.push_back(kDigits[byte >> 4]);
+    hex.push_back(kDigits[byte & 0xf]);
+  }
+  return hex;
+}
+
+std::FILE* OpenFile(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                               : nullptr;
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+ThumbnailCache::Png ReadThumbnail(const std::filesystem::path& path) {
+  std::error_code error;
+  uint64_t size = std::filesystem::file_size(path, error);
+  std::FILE* file = error ? nullptr : OpenFile(path, "rb");
+  if (!file) {
+    return nullptr;
+  }
+  auto png = std::make_shared<std::vector<uint8_t>>(size);
+  bool ok = std::fread(png->data(), 1, png->size(), file) == png->size();
+  std::fclose(file);
+  return ok && size > 0 ? png : nullptr;
+}
+
+// Written aside and renamed, so that a thumbnail is never read half written.
+bool WriteThumbnail(const std::filesystem::path& path,
+                    const std::vector<uint8_t>& png) {
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  std::FILE* file = OpenFile(temporary, "wb");
+  bool ok = file && std::fwrite(png.data(), 1, png.size(), file) == png.size();
+  if (file) {
+    ok = std::fclose(file) == 0 && ok;
+  }
+  std::error_code error;
+  if (ok) {
+    std::filesystem::rename(temporary, path, error);
+    ok = !error;
+  }
+  if (!ok) {
+    std::filesystem::remove(temporary, error);
+  }
+  return ok;
+}
+
+}  // namespace
+
+ThumbnailCache::ThumbnailCache(ThumbnailCacheOptions options)
+    : options_(std::move(options)) {}
+
+ThumbnailCache::Png ThumbnailCache::Get(const std::string& path,
+                                        int size,
+                                        std::string* error) {
+  std::string key;
+  if (!KeyFor(path, size, &key, error)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.failures++;
+    return nullptr;
+  }
+
+  bool on_disk;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    rendered_.wait(lock, [&]() { return rendering_.count(key) == 0; });
+    auto failed = failed_.find(key);
+    if (failed != failed_.end()) {
+      *error = failed->second;
+      stats_.failures++;
+      return nullptr;
+    }
+    auto cached = memory_index_.find(key);
+    if (cached != memory_index_.end()) {
+      memory_.splice(memory_.begin(), memory_, cached->second);
+      stats_.memory_hits++;
+      return cached->second->second;
+    }
+    LoadDiskIndex();
+    on_disk = disk_.count(key) != 0;
+    rendering_.insert(key);
+  }
+
+  std::filesystem::path file_path = std::filesystem::u8path(PathFor(key));
+  Png png = on_disk ? ReadThumbnail(file_path) : nullptr;
+  bool rendered = false;
+  bool stored = false;
+  if (png) {
+    std::error_code ignored;
+    std::filesystem::last_write_time(
+        file_path, std::filesystem::file_time_type::clock::now(), ignored);
+  }
+  else {
+    // Also when the file went away, or is unreadable, since it was listed.
+    RgbImage image;
+    if (RenderFirstPage(path, size, &image, error)) {
+      auto encoded = std::make_shared<std::vector<uint8_t>>(EncodePng(image));
+      stored = WriteThumbnail(file_path, *encoded);
+      rendered = true;
+      png = std::move(encoded);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rendering_.erase(key);
+    if (!png) {
+      if (failed_.size() >= kMaxFailed) {
+        failed_.clear();
+      }
+      failed_[key] = *error;
+      stats_.failures++;
+    }
+    else {
+      (rendered ? stats_.renders : stats_.disk_hits)++;
+      Remember(key, png);
+      if (!rendered || stored) {
+        Used(key, png->size());
+      }
+    }
+  }
+  rendered_.notify_all();
+  return png;
+}
+
+ThumbnailCacheStats ThumbnailCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ThumbnailCacheStats stats = stats_;
+  stats.memory_bytes = memory_bytes_;
+  stats.disk_bytes = disk_bytes_;
+  return stats;
+}
+
+bool ThumbnailCache::KeyFor(const std::string& path,
+                            int size,
+                            std::string* key,
+                            std::string* error) {
+  std::filesystem::path file_path = std::filesystem::u8path(path);
+  std::error_code error_code;
+  uint64_t file_size = std::filesystem::file_size(file_path, error_code);
+  std::filesystem::file_time_type modified;
+  if (!error_code) {
+    modified = std::filesystem::last_write_time(file_path, error_code);
+  }
+  if (error_code) {
+    *error = "The document cannot be read.";
+    return false;
+  }
+  int64_t ticks = static_cast<int64_t>(modified.time_since_epoch().count());
+
+  std::string hash;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto known = hashes_.find(path);
+    if (known != hashes_.end() && known->second.size == file_size &&
+        known->second.modified == ticks) {
+      hash = known->second.hash;
+    }
+  }
+  if (hash.empty()) {
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+    if (!file) {
+      *error = "The document cannot be read.";
+      return false;
+    }
+    hash = Hex(Digest(DigestAlgorithm::kSha256, file->data(), file->size()));
+    std::lock_guard<std::mutex> lock(mutex_);
+    hashes_[path] = HashedFile{file_size, ticks, hash};
+  }
+  *key = hash + "-" + std::to_string(size);
+  return true;
+}
+
+void ThumbnailCache::LoadDiskIndex() {
+  if (disk_loaded_) {
+    return;
+  }
+  disk_loaded_ = true;
+  // Ordered by modification time, which is the last use.
+  std::vector<std::pair<std::filesystem::file_time_type,
+                        std::pair<std::string, uint64_t>>>
+      files;
+  std::error_code error;
+  for (std::filesystem::directory_iterator it(
+           std::filesystem::u8path(options_.directory), error),
+       end;
+       !error && it != end; it.increment(error)) {
+    std::string name = it->path().filename().u8string();
+    if (!IsThumbnailName(name)) {
+      continue;
+    }
+    std::error_code entry_error;
+    uint64_t size = it->file_size(entry_error);
+    std::filesystem::file_time_type modified =
+        it->last_write_time(entry_error);
+    if (!entry_error) {
+      files.push_back(
+          {modified, {name.substr(0, name.size() - (sizeof(kExtension) - 1)),
+                      size}});
+    }
+  }
+  std::sort(files.begin(), files.end());
+  for (const auto& file : files) {
+    DiskEntry& entry = disk_[file.second.first];
+    entry.size = file.second.second;
+    entry.last_use = ++next_use_;
+    disk_bytes_ += entry.size;
+  }
+}
+
+void ThumbnailCache::Remember(const std::string& key, Png png) {
+  size_t size = png->size();
+  if (size > options_.max_memory_bytes) {
+    return;
+  }
+  auto cached = memory_index_.find(key);
+  if (cached != memory_index_.end()) {
+    memory_bytes_ -= cached->second->second->size();
+    memory_.erase(cached->second);
+  }
+  memory_.emplace_front(key, std::move(png));
+  memory_index_[key] = memory_.begin();
+  memory_bytes_ += size;
+  while (memory_bytes_ > options_.max_memory_bytes) {
+    memory_bytes_ -= memory_.back().second->size();
+    memory_index_.erase(memory_.back().first);
+    memory_.pop_back();
+  }
+}
+
+void ThumbnailCache::Used(const std::string& key, uint64_t size) {
+  DiskEntry& entry = disk_[key];
+  disk_bytes_ = disk_bytes_ - entry.size + size;
+  entry.size = size;
+  entry.last_use = ++next_use_;
+  // The thumbnail just used stays even if it alone is over the limit.
+  while (disk_bytes_ > options_.max_disk_bytes && disk_.size() > 1) {
+    auto oldest = std::min_element(
+        disk_.begin(), disk_.end(), [](const auto& a, const auto& b) {
+          return a.second.last_use < b.second.last_use;
+        });
+    std::error_code error;
+    std::filesystem::remove(std::filesystem::u8path(PathFor(oldest->first)),
+                            error);
+    disk_bytes_ -= oldest->second.size;
+    disk_.erase(oldest);
+  }
+}
+
+std::string ThumbnailCache::PathFor(const std::string& key) const {
+  return options_.directory + "/" + key + kExtension;
+}
+
+}  // namespace native_core
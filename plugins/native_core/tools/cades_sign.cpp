@@ -0,0 +1,103 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Signs a file with BuildCadesSignature(), for checking the output with
+// other tools:
+//
+//   cades_sign key.pem input output.p7s [SHA-256] [--attached]
+//       [--signing-time SECONDS]
+//   openssl cms -verify -binary -inform DER -in output.p7s -content input
+//       -CAfile cert.pem
+//
+// key.pem holds the RSA private key followed by its certificate. With a
+// signing time, in seconds since the epoch, the signature is reproducible:
+// tests/data/cades holds signatures made this way, and
+// tests/cades_openssl_verify.cmake checks them with openssl.
+#include <native_core/cades_signature.h>
+#include <native_core/file_key_signer.h>
+#include <native_core/mapped_file.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    std::fprintf(stderr,
+                 "usage: %s key.pem input output.p7s [digest] [--attached] "
+                 "[--signing-time SECONDS]\n",
+                 argv[0]);
+    return 2;
+  }
+  native_core::CadesOptions options;
+  for (int i = 4; i < argc; i++) {
+    if (std::strcmp(argv[i], "--attached") == 0) {
+      options.attached = true;
+    }
+    else if (std::strcmp(argv[i], "--signing-time") == 0 && i + 1 < argc) {
+      options.signing_time = std::chrono::system_clock::from_time_t(
+          static_cast<std::time_t>(std::strtoll(argv[++i], nullptr, 10)));
+    }
+    else {
+      options.digest = native_core::DigestAlgorithmFor(argv[i]);
+    }
+  }
+
+  std::string error;
+  std::unique_ptr<native_core::FileKeySigner> signer =
+      native_core::FileKeySigner::Open(argv[1], &error);
+  if (!signer) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::vector<uint8_t> certificate = signer->Certificate();
+  if (certificate.empty()) {
+    std::fprintf(stderr, "No certificate after the key in %s\n", argv[1]);
+    return 1;
+  }
+  std::unique_ptr<native_core::MappedFile> input =
+      native_core::MappedFile::Open(argv[2]);
+  if (!input) {
+    std::fprintf(stderr, "Cannot read %s\n", argv[2]);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> signature;
+  if (!native_core::BuildCadesSignature(signer.get(), certificate,
+                                        input->data(), input->size(), options,
+                                        &signature, &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start).count();
+
+  std::FILE* output = std::fopen(argv[3], "wb");
+  if (!output ||
+      std::fwrite(signature.data(), 1, signature.size(), output) !=
+          signature.size()) {
+    std::fprintf(stderr, "Cannot write %s\n", argv[3]);
+    return 1;
+  }
+  std::fclose(output);
+  std::printf("signed %zu bytes in %.2f ms: %zu-byte signature\n",
+              input->size(), ms, signature.size());
+  return 0;
+}
@@ -0,0 +1,901 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a method-channel trace recorded by the plugins (see
+// call_recorder.h) against the native code behind them, with a file-based key
+// in place of the certificate store, and compares the timings of each method
+// with a baseline:
+//
+//   call_replay --trace FILE --key key.pem [--baseline FILE] [--output FILE]
+//               [--repeat 1] [--tolerance 25] [--scratch DIR]
+//
+// The trace must have been recorded with PORTAFIRMAS_CALL_TRACE_PAYLOADS=1.
+// Calls are replayed one at a time in the order they were made, each pass
+// from a fresh state, so two runs over the same trace do the same work.
+// Files the app wrote (the log, the signing journal, the request list cache,
+// signed PDFs) go to the scratch directory instead, a temporary one unless
+// --scratch is given. Calls that need the proxy or the certificate dialog
+// are skipped.
+//
+// --output writes the replayed calls as a trace, to be given as --baseline
+// to a later run. A method whose median is more than --tolerance percent
+// slower than in the baseline is flagged, and the exit status is then 1.
+//
+// key.pem holds the RSA private key followed by its certificate.
+#include <native_core/cades_signature.h>
+#include <native_core/call_recorder.h>
+#include <native_core/file_key_signer.h>
+#include <native_core/histogram.h>
+#include <native_core/log_sink.h>
+#include <native_core/pades_signer.h>
+#include <native_core/request_list_cache.h>
+#include <native_core/response_parser.h>
+#include <native_core/search_index.h>
+#include <native_core/signing_journal.h>
+#include <native_core/xml_request_builder.h>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Medians closer than this to the baseline are never flagged: they are
+// within the noise of the clock and the scheduler.
+constexpr std::chrono::microseconds kNoiseFloor{50};
+
+// A value decoded from the StandardMessageCodec encoding. Integers of either
+// width are kept as int64_t, and typed lists other than bytes as lists.
+struct Value;
+using List = std::vector<Value>;
+using Map = std::vector<std::pair<Value, Value>>;
+
+struct Value {
+  std::variant<std::monostate, bool, int64_t, double, std::string,
+               std::vector<uint8_t>, List, Map>
+      data;
+
+  template <typename T>
+  const T* get() const {
+    return std::get_if<T>(&data);
+  }
+};
+
+// Decodes what flutter::StandardMessageCodec::EncodeMessage() wrote.
+class Decoder {
+ public:
+  explicit Decoder(const std::vector<uint8_t>& data) : data_(data) {}
+
+  bool Decode(Value* value) {
+    return ReadValue(value, 0) && position_ == data_.size();
+  }
+
+ private:
+  // Nesting allowed before the payload is taken as damaged.
+  static constexpr int kMaxDepth = 64;
+
+  bool ReadByte(uint8_t* value) {
+    if (position_ >= data_.size()) {
+      return false;
+    }
+    *value = data_[position_++];
+    return true;
+  }
+
+  // In host order, as the codec writes them.
+  template <typename T>
+  bool ReadFixed(T* value) {
+    if (data_.size() - position_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(value, data_.data() + position_, sizeof(T));
+    position_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadSize(size_t* size) {
+    uint8_t byte;
+    if (!ReadByte(&byte)) {
+      return false;
+    }
+    if (byte < 254) {
+      *size = byte;
+      return true;
+    }
+    if (byte == 254) {
+      uint16_t value;
+      bool ok = ReadFixed(&value);
+      *size = value;
+      return ok;
+    }
+    uint32_t value;
+    bool ok = ReadFixed(&value);
+    *size = value;
+    return ok;
+  }
+
+  // Typed data is aligned to its element size from the start of the message.
+  bool Align(size_t alignment) {
+    size_t mod = position_ % alignment;
+    if (mod != 0) {
+      position_ += alignment - mod;
+    }
+    return position_ <= data_.size();
+  }
+
+  template <typename T>
+  bool ReadTypedList(Value* value) {
+    size_t size;
+    if (!ReadSize(&size) || !Align(sizeof(T)) ||
+        (data_.size() - position_) / sizeof(T) < size) {
+      return false;
+    }
+    List list(size);
+    for (Value& element : list) {
+      T item;
+      ReadFixed(&item);
+      if constexpr (std::is_floating_point_v<T>) {
+        element.data = static_cast<double>(item);
+      }
+      else {
+        element.data = static_cast<int64_t>(item);
+      }
+    }
+    value->data = std::move(list);
+    return true;
+  }
+
+  bool ReadValue(Value* value, int depth) {
+    uint8_t type;
+    if (depth > kMaxDepth || !ReadByte(&type)) {
+      return false;
+    }
+    size_t size;
+    switch (type) {
+      case 0:
+        value->data = std::monostate();
+        return true;
+      case 1:
+      case 2:
+        value->data = type == 1;
+        return true;
+      case 3: {
+        int32_t number;
+        if (!ReadFixed(&number)) {
+          return false;
+        }
+        value->data = int64_t{number};
+        return true;
+      }
+      case 4: {
+        int64_t number;
+        if (!ReadFixed(&number)) {
+          return false;
+        }
+        value->data = number;
+        return true;
+      }
+      case 6: {
+        double number;
+        if (!Align(8) || !ReadFixed(&number)) {
+          return false;
+        }
+        value->data = number;
+        return true;
+      }
+      case 7:
+      case 8: {
+        if (!ReadSize(&size) || data_.size() - position_ < size) {
+          return false;
+        }
+        const uint8_t* begin = data_.data() + position_;
+        position_ += size;
+        if (type == 7) {
+          value->data = std::string(begin, begin + size);
+        }
+        else {
+          value->data = std::vector<uint8_t>(begin, begin + size);
+        }
+        return true;
+      }
+      case 9:
+        return ReadTypedList<int32_t>(value);
+      case 10:
+        return ReadTypedList<int64_t>(value);
+      case 11:
+        return ReadTypedList<double>(value);
+      case 14:
+        return ReadTypedList<float>(value);
+      case 12: {
+        if (!ReadSize(&size) || data_.size() - position_ < size) {
+          return false;
+        }
+        List list(size);
+        for (Value& element : list) {
+          if (!ReadValue(&element, depth + 1)) {
+            return false;
+          }
+        }
+        value->data = std::move(list);
+        return true;
+      }
+      case 13: {
+        if (!ReadSize(&size) || (data_.size() - position_) / 2 < size) {
+          return false;
+        }
+        Map map(size);
+        for (auto& [key, element] : map) {
+          if (!ReadValue(&key, depth + 1) ||
+              !ReadValue(&element, depth + 1)) {
+            return false;
+          }
+        }
+        value->data = std::move(map);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  const std::vector<uint8_t>& data_;
+  size_t position_ = 0;
+};
+
+// The entry of |map| under the string |key|, or null.
+const Value* Find(const Value& map, std::string_view key) {
+  const Map* entries = map.get<Map>();
+  if (!entries) {
+    return nullptr;
+  }
+  for (const auto& [entry_key, value] : *entries) {
+    const std::string* name = entry_key.get<std::string>();
+    if (name && *name == key) {
+      return &value;
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+const T* FindAs(const Value& map, std::string_view key) {
+  const Value* value = Find(map, key);
+  return value ? value->get<T>() : nullptr;
+}
+
+native_core::OptionalString OptionalStringOf(const Value& value) {
+  const std::string* string = value.get<std::string>();
+  return string ? native_core::OptionalString(*string) : std::nullopt;
+}
+
+const std::string& StringOf(const Value& value) {
+  static const std::string kEmpty;
+  const std::string* string = value.get<std::string>();
+  return string ? *string : kEmpty;
+}
+
+const List& ListOf(const Value& value, bool* ok) {
+  static const List kEmpty;
+  const List* list = value.get<List>();
+  *ok = *ok && list;
+  return list ? *list : kEmpty;
+}
+
+// As PresignDocuments() and PostsignRequests() in the plugin.
+bool PresignDocuments(const List& list,
+                      std::vector<native_core::PresignDocument>* documents) {
+  bool ok = true;
+  for (const Value& value : list) {
+    const List& fields = ListOf(value, &ok);
+    if (!ok || fields.size() < 5) {
+      return false;
+    }
+    documents->push_back({StringOf(fields[0]), OptionalStringOf(fields[1]),
+                          StringOf(fields[2]), StringOf(fields[3]),
+                          OptionalStringOf(fields[4])});
+  }
+  return true;
+}
+
+bool PostsignRequests(const List& list,
+                      std::vector<native_core::PostsignRequest>* requests) {
+  bool ok = true;
+  for (const Value& value : list) {
+    const List& fields = ListOf(value, &ok);
+    if (!ok || fields.size() < 3 || !fields[1].get<bool>()) {
+      return false;
+    }
+    native_core::PostsignRequest request;
+    request.ref = StringOf(fields[0]);
+    request.status_ok = *fields[1].get<bool>();
+    for (const Value& document_value : ListOf(fields[2], &ok)) {
+      const List& document_fields = ListOf(document_value, &ok);
+      if (!ok || document_fields.size() < 6) {
+        return false;
+      }
+      native_core::PostsignDocument document;
+      document.id = OptionalStringOf(document_fields[0]);
+      document.crypto_operation = OptionalStringOf(document_fields[1]);
+      document.signature_format = OptionalStringOf(document_fields[2]);
+      document.message_digest_algorithm = OptionalStringOf(document_fields[3]);
+      document.params = OptionalStringOf(document_fields[4]);
+      const List& result = ListOf(document_fields[5], &ok);
+      for (size_t k = 0; k + 1 < result.size(); k += 2) {
+        document.result.emplace_back(StringOf(result[k]),
+                                     StringOf(result[k + 1]));
+      }
+      request.documents.push_back(std::move(document));
+    }
+    requests->push_back(std::move(request));
+  }
+  return ok;
+}
+
+std::vector<std::string_view> StringViews(const List& list) {
+  std::vector<std::string_view> views;
+  views.reserve(list.size());
+  for (const Value& value : list) {
+    views.push_back(StringOf(value));
+  }
+  return views;
+}
+
+enum class Replayed { kOk, kFailed, kSkipped };
+
+// The native state behind the two plugins, as a fresh app has it.
+class Replayer {
+ public:
+  Replayer(native_core::Pkcs1Signer* signer, std::filesystem::path scratch)
+      : signer_(signer), scratch_(std::move(scratch)) {}
+
+  // Runs |method| of |channel| as the plugin would, without answering.
+  Replayed Replay(const std::string& channel,
+                  const std::string& method,
+                  const Value& arguments) {
+    if (channel == "digital_certificates") {
+      return Certificates(method, arguments);
+    }
+    if (channel == "portafirmas_native") {
+      return Portafirmas(method, arguments);
+    }
+    return Replayed::kSkipped;
+  }
+
+ private:
+  // The certificate is the key file: selecting one needs the dialog.
+  Replayed Certificates(const std::string& method, const Value& arguments) {
+    if (method == "signData") {
+      const auto* data = FindAs<std::vector<uint8_t>>(arguments, "data");
+      const auto* algorithm = FindAs<std::string>(arguments, "algorithm");
+      if (!data) {
+        return Replayed::kFailed;
+      }
+      std::vector<uint8_t> signature;
+      std::string error;
+      return signer_->Sign(algorithm ? *algorithm : "SHA256withRSA",
+                           data->data(), data->size(), &signature, &error)
+                 ? Replayed::kOk
+                 : Replayed::kFailed;
+    }
+    return Replayed::kSkipped;
+  }
+
+  Replayed Portafirmas(const std::string& method, const Value& arguments) {
+    auto result = [](bool ok) {
+      return ok ? Replayed::kOk : Replayed::kFailed;
+    };
+    if (method == "createParser") {
+      const int64_t* kind = FindAs<int64_t>(arguments, "kind");
+      if (!kind || *kind < 0 ||
+          *kind > static_cast<int64_t>(native_core::ResponseKind::kPostsign)) {
+        return Replayed::kFailed;
+      }
+      // Numbered as the plugin does, so the ids in later calls match.
+      parsers_[next_parser_id_++] = native_core::CreateResponseParser(
+          static_cast<native_core::ResponseKind>(*kind));
+      return Replayed::kOk;
+    }
+    if (method == "feed" || method == "finish" || method == "disposeParser") {
+      const int64_t* id = FindAs<int64_t>(arguments, "id");
+      auto parser_it = id ? parsers_.find(*id) : parsers_.end();
+      if (method == "disposeParser") {
+        if (parser_it != parsers_.end()) {
+          parsers_.erase(parser_it);
+        }
+        return Replayed::kOk;
+      }
+      if (parser_it == parsers_.end()) {
+        return Replayed::kFailed;
+      }
+      if (method == "feed") {
+        const auto* data = FindAs<std::vector<uint8_t>>(arguments, "data");
+        if (!data) {
+          return Replayed::kFailed;
+        }
+        parser_it->second->Feed(reinterpret_cast<const char*>(data->data()),
+                                data->size());
+        return Replayed::kOk;
+      }
+      parser_it->second->Finish();
+      parsers_.erase(parser_it);
+      return Replayed::kOk;
+    }
+    if (method.rfind("build", 0) == 0) {
+      return result(BuildBody(method, arguments));
+    }
+    if (method == "cadesSign") {
+      const auto* data = FindAs<std::vector<uint8_t>>(arguments, "data");
+      const auto* digest = FindAs<std::string>(arguments, "digest");
+      const bool* attached = FindAs<bool>(arguments, "attached");
+      if (!data || !digest || !attached) {
+        return Replayed::kFailed;
+      }
+      native_core::CadesOptions options;
+      options.digest = native_core::DigestAlgorithmFor(*digest);
+      options.attached = *attached;
+      std::vector<uint8_t> signature;
+      std::string error;
+      return result(native_core::BuildCadesSignature(
+          signer_, signer_->Certificate(), data->data(), data->size(), options,
+          &signature, &error));
+    }
+    if (method == "padesSign") {
+      const auto* input = FindAs<std::string>(arguments, "input");
+      const auto* digest = FindAs<std::string>(arguments, "digest");
+      if (!input || !digest) {
+        return Replayed::kFailed;
+      }
+      native_core::PadesOptions options;
+      options.digest = native_core::DigestAlgorithmFor(*digest);
+      if (const auto* reason = FindAs<std::string>(arguments, "reason")) {
+        options.reason = *reason;
+      }
+      if (const auto* location = FindAs<std::string>(arguments, "location")) {
+        options.location = *location;
+      }
+      std::string output =
+          Scratch("signed-" + std::to_string(++signed_pdfs_) + ".pdf");
+      std::string error;
+      return result(native_core::SignPdf(signer_, *input, output, options,
+                                         nullptr, &error));
+    }
+    if (method == "journalOpen") {
+      journal_ = native_core::SigningJournal::Open(Scratch("journal"));
+      return result(journal_ != nullptr);
+    }
+    if (method == "journalPending") {
+      const auto* owner = FindAs<std::string>(arguments, "owner");
+      if (!owner) {
+        return Replayed::kFailed;
+      }
+      if (journal_) {
+        journal_->Pending(*owner);
+      }
+      return Replayed::kOk;
+    }
+    if (method == "logOpen") {
+      const bool* truncate = FindAs<bool>(arguments, "truncate");
+      const int64_t* max_file_bytes = FindAs<int64_t>(arguments, "maxFileBytes");
+      const int64_t* max_rotated_files =
+          FindAs<int64_t>(arguments, "maxRotatedFiles");
+      const bool* compress_rotated = FindAs<bool>(arguments, "compressRotated");
+      if (!truncate || !max_file_bytes || !max_rotated_files ||
+          !compress_rotated) {
+        return Replayed::kFailed;
+      }
+      native_core::LogSinkOptions options;
+      options.path = Scratch("log.txt");
+      options.truncate = *truncate;
+      options.max_file_bytes = static_cast<uint64_t>(*max_file_bytes);
+      options.max_rotated_files = static_cast<size_t>(*max_rotated_files);
+      options.compress_rotated = *compress_rotated;
+      log_sink_.reset();
+      log_sink_ = native_core::LogSink::Open(std::move(options));
+      return result(log_sink_ != nullptr);
+    }
+    if (method == "logWrite") {
+      const List* records = FindAs<List>(arguments, "records");
+      const bool* flush = FindAs<bool>(arguments, "flush");
+      if (log_sink_ && records) {
+        for (const Value& value : *records) {
+          if (const std::string* record = value.get<std::string>()) {
+            log_sink_->Write(*record);
+          }
+        }
+        if (flush && *flush) {
+          log_sink_->Flush();
+        }
+      }
+      return Replayed::kOk;
+    }
+    if (method == "logFlush") {
+      if (log_sink_) {
+        log_sink_->Flush();
+      }
+      return Replayed::kOk;
+    }
+    if (method == "logStats") {
+      if (log_sink_) {
+        log_sink_->stats();
+      }
+      return Replayed::kOk;
+    }
+    if (method == "cacheOpen") {
+      cache_ = std::make_unique<native_core::RequestListCache>(
+          Scratch("cache"));
+      return Replayed::kOk;
+    }
+    if (method == "cacheLoad" || method == "cacheRemove") {
+      const auto* server = FindAs<std::string>(arguments, "server");
+      const auto* state = FindAs<std::string>(arguments, "state");
+      if (!server || !state) {
+        return Replayed::kFailed;
+      }
+      if (!cache_) {
+        return Replayed::kOk;
+      }
+      if (method == "cacheRemove") {
+        cache_->Remove(*server, *state);
+        return Replayed::kOk;
+      }
+      std::unique_ptr<native_core::RequestListSnapshot> snapshot =
+          cache_->Load(*server, *state);
+      if (snapshot) {
+        search_index_.AddRequestList(*state, snapshot->strings,
+                                     snapshot->requests, snapshot->docs);
+      }
+      return Replayed::kOk;
+    }
+    if (method == "searchQuery") {
+      const auto* text = FindAs<std::string>(arguments, "text");
+      const Value* state = Find(arguments, "state");
+      const int64_t* limit = FindAs<int64_t>(arguments, "limit");
+      if (!text || !state || !limit) {
+        return Replayed::kFailed;
+      }
+      search_index_.Query(*text, StringOf(*state),
+                          *limit < 0 ? 0 : static_cast<size_t>(*limit));
+      return Replayed::kOk;
+    }
+    if (method == "searchClear") {
+      search_index_.Clear();
+      return Replayed::kOk;
+    }
+    if (method == "searchStats") {
+      search_index_.stats();
+      return Replayed::kOk;
+    }
+    // httpPost, httpStats, httpClearSession, signBatch, resumeBatch and
+    // cancelBatch talk to the proxy.
+    return Replayed::kSkipped;
+  }
+
+  // BuildRequestBody() in the plugin.
+  bool BuildBody(const std::string& method, const Value& arguments) {
+    const auto* operation = FindAs<std::string>(arguments, "op");
+    if (!operation) {
+      return false;
+    }
+    bool ok = true;
+    std::vector<uint8_t> body;
+    if (method == "buildPresignBody") {
+      const auto* id = FindAs<std::string>(arguments, "id");
+      const List* list = FindAs<List>(arguments, "docs");
+      std::vector<native_core::PresignDocument> documents;
+      if (!id || (list && !PresignDocuments(*list, &documents))) {
+        return false;
+      }
+      body = native_core::BuildPresignBody(*operation, *id,
+                                           list ? &documents : nullptr);
+    }
+    else if (method == "buildPostsignBody") {
+      const List* list = FindAs<List>(arguments, "reqs");
+      std::vector<native_core::PostsignRequest> requests;
+      if (!list || !PostsignRequests(*list, &requests)) {
+        return false;
+      }
+      body = native_core::BuildPostsignBody(*operation, requests);
+    }
+    else if (method == "buildApproveBody" || method == "buildRejectBody") {
+      const List* ids = FindAs<List>(arguments, "ids");
+      const auto* reason = FindAs<std::string>(arguments, "reason");
+      if (!ids || (method == "buildRejectBody" && !reason)) {
+        return false;
+      }
+      body = method == "buildApproveBody"
+                 ? native_core::BuildApproveBody(*operation, StringViews(*ids))
+                 : native_core::BuildRejectBody(*operation, StringViews(*ids),
+                                                *reason);
+    }
+    else {
+      ok = false;
+    }
+    return ok && !body.empty();
+  }
+
+  std::string Scratch(const std::string& name) const {
+    return (scratch_ / name).u8string();
+  }
+
+  native_core::Pkcs1Signer* signer_;
+  std::filesystem::path scratch_;
+  std::map<int64_t, std::unique_ptr<native_core::ResponseParser>> parsers_;
+  int64_t next_parser_id_ = 1;
+  std::unique_ptr<native_core::SigningJournal> journal_;
+  std::unique_ptr<native_core::LogSink> log_sink_;
+  std::unique_ptr<native_core::RequestListCache> cache_;
+  native_core::SearchIndex search_index_;
+  int signed_pdfs_ = 0;
+};
+
+// The timings of one "channel/method".
+struct MethodStats {
+  native_core::DurationHistogram recorded;
+  native_core::DurationHistogram replayed;
+  native_core::DurationHistogram baseline;
+  uint64_t skipped = 0;
+  uint64_t failed = 0;
+  // Replays that failed where the app succeeded, or the other way round.
+  uint64_t diverged = 0;
+};
+
+using StatsByMethod = std::map<std::string, std::unique_ptr<MethodStats>>;
+
+MethodStats& StatsFor(StatsByMethod* stats, const native_core::TracedCall& call) {
+  std::unique_ptr<MethodStats>& entry =
+      (*stats)[call.channel + "/" + call.method];
+  if (!entry) {
+    entry = std::make_unique<MethodStats>();
+  }
+  return *entry;
+}
+
+// Begin to answer; calls never answered are left out.
+void RecordDurations(const std::vector<native_core::TracedCall>& calls,
+                     native_core::DurationHistogram MethodStats::*histogram,
+                     StatsByMethod* stats) {
+  for (const native_core::TracedCall& call : calls) {
+    if (call.answered) {
+      (StatsFor(stats, call).*histogram).Record(*call.answered - call.begin);
+    }
+  }
+}
+
+struct Options {
+  std::string trace;
+  std::string key;
+  std::string baseline;
+  std::string output;
+  std::string scratch;
+  int repeat = 1;
+  int tolerance = 25;
+};
+
+bool ParseInt(const char* text, int* value) {
+  char* end = nullptr;
+  long parsed = std::strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || parsed < 0 || parsed > 1 << 20) {
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+double Milliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  bool ok = true;
+  for (int i = 1; i < argc && ok; i += 2) {
+    const char* flag = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      ok = false;
+    }
+    else if (std::strcmp(flag, "--trace") == 0) {
+      options.trace = value;
+    }
+    else if (std::strcmp(flag, "--key") == 0) {
+      options.key = value;
+    }
+    else if (std::strcmp(flag, "--baseline") == 0) {
+      options.baseline = value;
+    }
+    else if (std::strcmp(flag, "--output") == 0) {
+      options.output = value;
+    }
+    else if (std::strcmp(flag, "--scratch") == 0) {
+      options.scratch = value;
+    }
+    else if (std::strcmp(flag, "--repeat") == 0) {
+      ok = ParseInt(value, &options.repeat) && options.repeat > 0;
+    }
+    else if (std::strcmp(flag, "--tolerance") == 0) {
+      ok = ParseInt(value, &options.tolerance);
+    }
+    else {
+      ok = false;
+    }
+  }
+  if (!ok || options.trace.empty() || options.key.empty()) {
+    std::fprintf(stderr,
+                 "usage: %s --trace FILE --key key.pem [--baseline FILE] "
+                 "[--output FILE]\n"
+                 "       [--repeat 1] [--tolerance 25] [--scratch DIR]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::string error;
+  std::vector<native_core::TracedCall> calls;
+  if (!native_core::ReadCallTrace(options.trace, &calls, &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::vector<native_core::TracedCall> baseline;
+  if (!options.baseline.empty() &&
+      !native_core::ReadCallTrace(options.baseline, &baseline, &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::unique_ptr<native_core::FileKeySigner> signer =
+      native_core::FileKeySigner::Open(options.key, &error);
+  if (!signer) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::unique_ptr<native_core::CallRecorder> output;
+  if (!options.output.empty()) {
+    output = native_core::CallRecorder::Open(options.output, false);
+    if (!output) {
+      std::fprintf(stderr, "No se puede escribir %s\n",
+                   options.output.c_str());
+      return 1;
+    }
+  }
+
+  std::error_code error_code;
+  bool temporary_scratch = options.scratch.empty();
+  std::filesystem::path scratch =
+      temporary_scratch
+          ? std::filesystem::temp_directory_path(error_code) /
+                ("call_replay-" + std::to_string(getpid()))
+          : std::filesystem::u8path(options.scratch);
+
+  // Decoded once, so that decoding is not timed.
+  std::vector<std::optional<Value>> arguments(calls.size());
+  size_t without_payload = 0;
+  for (size_t i = 0; i < calls.size(); i++) {
+    if (!calls[i].payload) {
+      without_payload++;
+      continue;
+    }
+    Value value;
+    if (Decoder(*calls[i].payload).Decode(&value)) {
+      arguments[i] = std::move(value);
+    }
+  }
+
+  StatsByMethod stats;
+  RecordDurations(calls, &MethodStats::recorded, &stats);
+  RecordDurations(baseline, &MethodStats::baseline, &stats);
+
+  for (int pass = 1; pass <= options.repeat; pass++) {
+    std::filesystem::path directory = scratch / std::to_string(pass);
+    std::filesystem::create_directories(directory, error_code);
+    if (error_code) {
+      std::fprintf(stderr, "No se puede crear %s\n",
+                   directory.u8string().c_str());
+      return 1;
+    }
+    Replayer replayer(signer.get(), directory);
+    for (size_t i = 0; i < calls.size(); i++) {
+      const native_core::TracedCall& call = calls[i];
+      MethodStats& method_stats = StatsFor(&stats, call);
+      if (!arguments[i]) {
+        method_stats.skipped++;
+        continue;
+      }
+      uint64_t replayed_call = 0;
+      if (output) {
+        replayed_call = output->Begin(call.channel, call.method,
+                                      call.argument_size, nullptr);
+      }
+      Clock::time_point start = Clock::now();
+      Replayed replayed = replayer.Replay(call.channel, call.method,
+                                          *arguments[i]);
+      Clock::duration duration = Clock::now() - start;
+      if (replayed == Replayed::kSkipped) {
+        method_stats.skipped++;
+        continue;
+      }
+      if (output) {
+        output->Return(replayed_call);
+        output->End(replayed_call,
+                    replayed == Replayed::kOk
+                        ? native_core::CallOutcome::kSuccess
+                        : native_core::CallOutcome::kError,
+                    0);
+      }
+      method_stats.replayed.Record(duration);
+      if (replayed == Replayed::kFailed) {
+        method_stats.failed++;
+      }
+      if (call.answered &&
+          (replayed == Replayed::kOk) !=
+              (call.outcome == native_core::CallOutcome::kSuccess)) {
+        method_stats.diverged++;
+      }
+    }
+  }
+  output.reset();
+  if (temporary_scratch) {
+    std::filesystem::remove_all(scratch, error_code);
+  }
+
+  std::printf("%zu calls, %zu without arguments recorded, %d passes\n\n",
+              calls.size(), without_payload, options.repeat);
+  std::printf("%-40s %7s %7s %7s %7s %10s %10s %10s %10s %10s %8s\n",
+              "method", "calls", "skipped", "failed", "diverged",
+              "app p50", "p50 ms", "p99 ms", "max ms", "base p50", "change");
+  bool regressed = false;
+  for (const auto& [name, method] : stats) {
+    std::printf("%-40s %7llu %7llu %7llu %7llu %10.3f %10.3f %10.3f %10.3f",
+                name.c_str(),
+                static_cast<unsigned long long>(method->replayed.count()),
+                static_cast<unsigned long long>(method->skipped),
+                static_cast<unsigned long long>(method->failed),
+                static_cast<unsigned long long>(method->diverged),
+                Milliseconds(method->recorded.Percentile(50)),
+                Milliseconds(method->replayed.Percentile(50)),
+                Milliseconds(method->replayed.Percentile(99)),
+                Milliseconds(method->replayed.max()));
+    if (method->baseline.count() == 0 || method->replayed.count() == 0) {
+      std::printf("\n");
+      continue;
+    }
+    std::chrono::nanoseconds median = method->replayed.Percentile(50);
+    std::chrono::nanoseconds base = method->baseline.Percentile(50);
+    double change =
+        base.count() > 0
+            ? static_cast<double>((median - base).count()) / base.count() * 100
+            : 0;
+    bool slower = change > options.tolerance && median - base > kNoiseFloor;
+    regressed = regressed || slower;
+    std::printf(" %10.3f %+7.0f%%%s\n", Milliseconds(base), change,
+                slower ? " !" : "");
+  }
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Signs a PDF file with SignPdf() and reports how long it took and how much
+// memory it needed, for checking the output with other tools and measuring
+// large documents:
+//
+//   pades_sign key.pem input.pdf output.pdf [SHA-256] [--signing-time SECONDS]
+//   pades_sign --generate megabytes output.pdf [--xref-stream]
+//
+// key.pem holds the RSA private key followed by its certificate. With a
+// signing time, in seconds since the epoch, the output is reproducible. The
+// second form writes a synthetic document of about |megabytes| MB to sign,
+// with a cross-reference table or stream; tests/pades_benchmark.cmake signs
+// one of 500 MB.
+#include <native_core/file_key_signer.h>
+#include <native_core/pades_signer.h>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool Generate(const char* path, unsigned long long megabytes,
+              bool xref_stream) {
+  std::FILE* file = std::fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  unsigned long long total = megabytes << 20;
+  // A page every 16 MB of content, at least one.
+  unsigned long long pages = total / (16 << 20) + 1;
+  unsigned long long per_page = total / pages;
+  std::vector<unsigned long long> offsets;
+  unsigned long long position = 0;
+  auto write = [&](const std::string& text) {
+    std::fwrite(text.data(), 1, text.size(), file);
+    position += text.size();
+  };
+  auto object = [&](const std::string& body) {
+    offsets.push_back(position);
+    write(std::to_string(offsets.size()) + " 0 obj\n" + body + "\nendobj\n");
+  };
+
+  write("%PDF-1.7\n%\xe2\xe3\xcf\xd3\n");
+  object("<</Type /Catalog /Pages 2 0 R>>");
+  std::string kids;
+  for (unsigned long long i = 0; i < pages; ++i) {
+    kids += std::to_string(3 + 2 * i) + " 0 R ";
+  }
+  object("<</Type /Pages /Count " + std::to_string(pages) + " /Kids [" +
+         kids + "]>>");
+  const std::string line = "0.5 w 10 10 m 585 832 l S\n";
+  std::string block;
+  while (block.size() < (1 << 20)) {
+    block += line;
+  }
+  for (unsigned long long i = 0; i < pages; ++i) {
+    object("<</Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] /Contents " +
+           std::to_string(4 + 2 * i) + " 0 R>>");
+    unsigned long long length = per_page / block.size() * block.size();
+    offsets.push_back(position);
+    write(std::to_string(offsets.size()) + " 0 obj\n<</Length " +
+          std::to_string(length) + ">>\nstream\n");
+    for (unsigned long long done = 0; done < length; done += block.size()) {
+      write(block);
+    }
+    write("\nendstream\nendobj\n");
+  }
+
+  unsigned long long xref = position;
+  std::string size = std::to_string(offsets.size() + 1);
+  if (!xref_stream) {
+    write("xref\n0 " + size + "\n0000000000 65535 f\r\n");
+    for (unsigned long long offset : offsets) {
+      char entry[32];
+      std::snprintf(entry, sizeof(entry), "%010llu 00000 n\r\n", offset);
+      write(entry);
+    }
+    write("trailer\n<</Size " + size + " /Root 1 0 R>>\n");
+  }
+  else {
+    std::string data = std::string("\0\0\0\0\0\xff\xff", 7);
+    offsets.push_back(xref);
+    for (unsigned long long offset : offsets) {
+      data.push_back(1);
+      for (int byte = 4; byte >= 0; --byte) {
+        data.push_back(static_cast<char>(offset >> (8 * byte)));
+      }
+      data.append(1, '\0');
+    }
+    size = std::to_string(offsets.size() + 1);
+    write(std::to_string(offsets.size()) + " 0 obj\n<</Type /XRef /Size " +
+          size + " /W [1 5 1] /Root 1 0 R /Length " +
+          std::to_string(data.size()) + ">>\nstream\n" + data +
+          "\nendstream\nendobj\n");
+  }
+  write("startxref\n" + std::to_string(xref) + "\n%%EOF\n");
+  return std::fclose(file) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc >= 4 && std::strcmp(argv[1], "--generate") == 0) {
+    bool xref_stream = argc > 4 && std::strcmp(argv[4], "--xref-stream") == 0;
+    if (!Generate(argv[3], std::strtoull(argv[2], nullptr, 10),
+                  xref_stream)) {
+      std::fprintf(stderr, "Cannot write %s\n", argv[3]);
+      return 1;
+    }
+    return 0;
+  }
+  if (argc < 4) {
+    std::fprintf(stderr,
+                 "usage: %s key.pem input.pdf output.pdf [digest] "
+                 "[--signing-time SECONDS]\n"
+                 "       %s --generate megabytes output.pdf [--xref-stream]\n",
+                 argv[0], argv[0]);
+    return 2;
+  }
+  native_core::PadesOptions options;
+  for (int i = 4; i < argc; i++) {
+    if (std::strcmp(argv[i], "--signing-time") == 0 && i + 1 < argc) {
+      options.signing_time = std::chrono::system_clock::from_time_t(
+          static_cast<std::time_t>(std::strtoll(argv[++i], nullptr, 10)));
+    }
+    else {
+      options.digest = native_core::DigestAlgorithmFor(argv[i]);
+    }
+  }
+  options.reason = "Firma de prueba";
+  options.location = "Cádiz";
+
+  std::string error;
+  std::unique_ptr<native_core::FileKeySigner> signer =
+      native_core::FileKeySigner::Open(argv[1], &error);
+  if (!signer) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  native_core::PadesResult result;
+  if (!native_core::SignPdf(signer.get(), argv[2], argv[3], options, &result,
+                            &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  std::printf(
+      "signed %llu bytes in %.2f s (%.0f MB/s), %zu-byte signature in "
+      "%zu reserved, peak RSS %ld KB\n",
+      static_cast<unsigned long long>(result.input_size), seconds,
+      result.input_size / seconds / (1 << 20), result.signature_size,
+      result.reserved_size, usage.ru_maxrss);
+  return 0;
+}
@@ -0,0 +1,810 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Drives the native code behind the plugins with randomized, interleaved
+// calls for as long as asked, and fails if the process does not hold steady:
+//
+//   plugin_soak --key key.pem [--pdf FILE] [--server URL] [--ca-file FILE]
+//               [--seconds 600] [--window 30] [--warmup 2] [--baseline 2]
+//               [--concurrency 16] [--seed 1] [--scratch DIR]
+//               [--rss-growth 25] [--latency-growth 100]
+//
+// The main thread plays the platform thread: it makes the calls the way the
+// plugin handlers do and runs their completions from the dispatcher of the
+// shared runtime. Up to --concurrency calls are in flight at once, each one
+// picked at random:
+//
+//   select    opens one of a dozen certificates (the key file, read again
+//             each time), keeping the eight most recently used open, and
+//             makes it the active signer, as selectCertificate does.
+//   close     closes an open certificate, the active one included, while
+//             signatures with it may be running, as closeCertificate does.
+//   sign      signs random data with the active signer on the pool.
+//   batch     signs a batch with the active signer on a thread of its own,
+//             as signBatch does: with the triphase engine against the proxy
+//             at --server (normally proxy_standin), or else as CAdES
+//             signatures of random documents and, given --pdf, a PAdES
+//             signature of it.
+//   download  writes --pdf, or random bytes, into the scratch directory on
+//             the pool and asks for its thumbnail, as the downloader plugin
+//             does once a document is downloaded.
+//   cancel    cancels a call in flight.
+//
+// Each --window seconds new calls stop until those in flight are answered,
+// and a report gives the resident memory, open file descriptors and threads
+// of the process, settled, and the latency percentiles of each call over the
+// window. After --warmup windows, the next --baseline windows set the steady
+// state. A later window is a regression when its resident memory grows more
+// than --rss-growth percent over it (0 skips the check), its descriptors or
+// threads grow beyond a small slack, or the p99 of a call is more than
+// --latency-growth percent slower. Two regressions in a row, or calls left
+// unanswered, fail the run with exit status 1.
+//
+// Meant to run for hours in a build with sanitizers (-DNATIVE_CORE_SANITIZE=
+// address,undefined or thread), which turns the interleavings that break
+// into reports. AddressSanitizer keeps freed memory in quarantine, so bound
+// it (ASAN_OPTIONS=quarantine_size_mb=16) or skip the memory check there.
+//
+// key.pem holds the RSA private key followed by its certificate.
+#include <native_core/cades_signature.h>
+#include <native_core/cancellation_token.h>
+#include <native_core/eventfd_wakeup.h>
+#include <native_core/file_key_signer.h>
+#include <native_core/histogram.h>
+#include <native_core/http_client.h>
+#include <native_core/pades_signer.h>
+#include <native_core/pkcs1_signer.h>
+#include <native_core/proxy_session.h>
+#include <native_core/runtime.h>
+#include <native_core/thumbnail_cache.h>
+#include <native_core/triphase_engine.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Operation {
+  kSelect,
+  kClose,
+  kSign,
+  kBatch,
+  kDownload,
+  kCancel,
+  kOperationCount
+};
+
+constexpr const char* kOperationNames[kOperationCount] = {
+    "select", "close", "sign", "batch", "download", "cancel"};
+
+// Relative odds of each operation.
+constexpr int kWeights[kOperationCount] = {4, 2, 40, 6, 12, 3};
+
+// Certificates the calls choose from, and how many of them stay open, as in
+// digital_certificates.
+constexpr int kCertificates = 12;
+constexpr size_t kMaxOpenCertificates = 8;
+
+// Files the downloads take turns to write, so that the scratch directory does
+// not grow.
+constexpr int kDownloadFiles = 16;
+constexpr int kThumbnailSizes[] = {64, 96, 128, 192};
+
+// The p99 of a call is only compared over windows with this many of them, and
+// changes smaller than the floor are never a regression: either is within the
+// noise of the scheduler.
+constexpr uint64_t kMinSamples = 100;
+constexpr std::chrono::milliseconds kNoiseFloor{2};
+
+// Descriptors and threads beyond the steady state that are still not a
+// regression: the HTTP client's pooled connections and the resolver.
+constexpr int kDescriptorSlack = 8;
+constexpr int kThreadSlack = 2;
+
+// How long the calls in flight get to be answered at the end of a window.
+constexpr std::chrono::seconds kSettleTimeout{120};
+
+struct Options {
+  std::string key;
+  std::string pdf;
+  std::string server;
+  std::string ca_file;
+  std::string scratch;
+  int seconds = 600;
+  int window = 30;
+  int warmup = 2;
+  int baseline = 2;
+  int concurrency = 16;
+  int seed = 1;
+  int rss_growth = 25;
+  int latency_growth = 100;
+};
+
+// What the process holds once the calls in flight are answered.
+struct ProcessState {
+  uint64_t rss = 0;
+  int descriptors = 0;
+  int threads = 0;
+};
+
+uint64_t ResidentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  statm >> size >> resident;
+  return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+int OpenDescriptors() {
+  std::error_code error;
+  int count = 0;
+  for (std::filesystem::directory_iterator it("/proc/self/fd", error), end;
+       !error && it != end; it.increment(error)) {
+    count++;
+  }
+  return count;
+}
+
+int Threads() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 8, "Threads:") == 0) {
+      return std::atoi(line.c_str() + 8);
+    }
+  }
+  return 0;
+}
+
+ProcessState CurrentState() {
+  return {ResidentBytes(), OpenDescriptors(), Threads()};
+}
+
+double Milliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// A call in flight.
+struct Call {
+  Operation operation;
+  Clock::time_point start;
+  native_core::CancellationSource cancellation;
+};
+
+class Soak {
+ public:
+  Soak(const Options& options, std::vector<uint8_t> document)
+      : options_(options),
+        document_(std::move(document)),
+        random_(static_cast<unsigned>(options.seed)) {
+    native_core::ThumbnailCacheOptions thumbnail_options;
+    thumbnail_options.directory = options.scratch + "/thumbnails";
+    thumbnail_options.max_disk_bytes = 1024 * 1024;
+    thumbnails_ =
+        std::make_shared<native_core::ThumbnailCache>(thumbnail_options);
+  }
+
+  // Returns the exit status.
+  int Run();
+
+ private:
+  // Makes a random call.
+  void Issue();
+
+  void Select();
+  void Close();
+  void Sign();
+  void Batch();
+  void Download();
+  void Cancel();
+
+  // Runs a batch with |signer|, checking |token| between documents. Returns
+  // false if a signature failed. Runs on the batch thread.
+  bool SignLocalBatch(native_core::Pkcs1Signer* signer,
+                      uint64_t id,
+                      size_t documents,
+                      const native_core::CancellationToken& token);
+  bool SignProxyBatch(native_core::Pkcs1Signer* signer,
+                      size_t documents,
+                      const native_core::CancellationToken& token);
+
+  // Starts timing a call and returns its id.
+  uint64_t Begin(Operation operation);
+
+  // Records the answer to call |id|. Platform thread only.
+  void End(uint64_t id, bool ok);
+
+  // Runs the completions posted so far, waiting up to |timeout_ms| for one.
+  void Pump(int timeout_ms);
+
+  // Reports window |number| and compares it with the steady state. Returns
+  // false if it regressed.
+  bool Report(int number, const ProcessState& state, double seconds);
+
+  std::vector<uint8_t> RandomBytes(size_t size);
+
+  const Options& options_;
+  const std::vector<uint8_t> document_;
+  std::mt19937 random_;
+
+  std::map<uint64_t, Call> calls_;
+  uint64_t next_call_ = 0;
+  // Batches run on threads of their own, joined once they post their end.
+  std::map<uint64_t, std::thread> batch_threads_;
+
+  // Open certificates, most recently used first.
+  std::vector<std::pair<int, std::shared_ptr<native_core::Pkcs1Signer>>>
+      open_certificates_;
+
+  std::shared_ptr<native_core::ThumbnailCache> thumbnails_;
+
+  // Over the current window.
+  std::array<native_core::DurationHistogram, kOperationCount> latencies_;
+  std::array<uint64_t, kOperationCount> errors_{};
+  uint64_t cancelled_ = 0;
+  uint64_t late_ = 0;
+  uint64_t total_calls_ = 0;
+
+  // The steady state: the largest values seen over the baseline windows.
+  ProcessState steady_;
+  std::array<std::chrono::nanoseconds, kOperationCount> steady_p99_{};
+};
+
+int Soak::Run() {
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + std::chrono::seconds(options_.seconds);
+  Clock::time_point window_start = start;
+  Clock::time_point window_end =
+      window_start + std::chrono::seconds(options_.window);
+  int window = 0;
+  int regressions = 0;
+  while (true) {
+    Clock::time_point now = Clock::now();
+    bool settling = now >= window_end || now >= deadline;
+    if (!settling) {
+      while (calls_.size() < static_cast<size_t>(options_.concurrency)) {
+        Issue();
+      }
+    }
+    else if (calls_.empty() && batch_threads_.empty()) {
+      ProcessState state = CurrentState();
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - window_start).count();
+      window++;
+      regressions = Report(window, state, seconds) ? 0 : regressions + 1;
+      if (regressions >= 2) {
+        std::printf("FAIL: two windows in a row regressed\n");
+        return 1;
+      }
+      if (now >= deadline) {
+        break;
+      }
+      window_start = Clock::now();
+      window_end = window_start + std::chrono::seconds(options_.window);
+      continue;
+    }
+    else if (now - window_end > kSettleTimeout &&
+             now - deadline > kSettleTimeout) {
+      std::printf("FAIL: %zu calls still unanswered after %lld s\n",
+                  calls_.size(),
+                  static_cast<long long>(kSettleTimeout.count()));
+      for (const auto& [id, call] : calls_) {
+        std::printf("  %s #%llu\n", kOperationNames[call.operation],
+                    static_cast<unsigned long long>(id));
+      }
+      return 1;
+    }
+    Pump(settling ? 100 : 20);
+  }
+
+  std::printf("PASS: %llu calls in %d windows\n",
+              static_cast<unsigned long long>(total_calls_), window);
+  return 0;
+}
+
+void Soak::Issue() {
+  int total = 0;
+  for (int weight : kWeights) {
+    total += weight;
+  }
+  int pick = std::uniform_int_distribution<int>(0, total - 1)(random_);
+  int operation = 0;
+  while (pick >= kWeights[operation]) {
+    pick -= kWeights[operation++];
+  }
+  switch (static_cast<Operation>(operation)) {
+    case kSelect:
+      Select();
+      break;
+    case kClose:
+      Close();
+      break;
+    case kSign:
+      Sign();
+      break;
+    case kBatch:
+      Batch();
+      break;
+    case kDownload:
+      Download();
+      break;
+    case kCancel:
+      Cancel();
+      break;
+    case kOperationCount:
+      break;
+  }
+}
+
+void Soak::Select() {
+  uint64_t id = Begin(kSelect);
+  int certificate =
+      std::uniform_int_distribution<int>(0, kCertificates - 1)(random_);
+  auto open = std::find_if(
+      open_certificates_.begin(), open_certificates_.end(),
+      [&](const auto& entry) { return entry.first == certificate; });
+  std::shared_ptr<native_core::Pkcs1Signer> signer;
+  if (open != open_certificates_.end()) {
+    signer = open->second;
+    open_certificates_.erase(open);
+  }
+  else {
+    std::string error;
+    signer = native_core::FileKeySigner::Open(options_.key, &error);
+  }
+  if (signer) {
+    open_certificates_.insert(open_certificates_.begin(),
+                              {certificate, signer});
+    if (open_certificates_.size() > kMaxOpenCertificates) {
+      open_certificates_.pop_back();
+    }
+  }
+  native_core::SetActiveSigner(signer);
+  End(id, signer != nullptr);
+}
+
+void Soak::Close() {
+  uint64_t id = Begin(kClose);
+  if (!open_certificates_.empty()) {
+    size_t index = std::uniform_int_distribution<size_t>(
+        0, open_certificates_.size() - 1)(random_);
+    if (open_certificates_[index].second == native_core::GetActiveSigner()) {
+      native_core::SetActiveSigner(nullptr);
+    }
+    open_certificates_.erase(open_certificates_.begin() + index);
+  }
+  End(id, true);
+}
+
+void Soak::Sign() {
+  std::shared_ptr<native_core::Pkcs1Signer> signer =
+      native_core::GetActiveSigner();
+  uint64_t id = Begin(kSign);
+  if (!signer) {
+    End(id, false);
+    return;
+  }
+  auto data = std::make_shared<std::vector<uint8_t>>(RandomBytes(
+      std::uniform_int_distribution<size_t>(32, 4096)(random_)));
+  auto ok = std::make_shared<bool>(false);
+  auto work = [signer, data, ok]() {
+    std::vector<uint8_t> signature;
+    std::string error;
+    *ok = signer->Sign("SHA256withRSA", data->data(), data->size(),
+                       &signature, &error);
+  };
+  auto done = [this, id, ok](bool cancelled) {
+    End(id, *ok && !cancelled);
+  };
+  if (!native_core::Runtime::Get().RunAsync(
+          work, done, calls_.at(id).cancellation.token())) {
+    End(id, false);
+  }
+}
+
+void Soak::Batch() {
+  std::shared_ptr<native_core::Pkcs1Signer> signer =
+      native_core::GetActiveSigner();
+  uint64_t id = Begin(kBatch);
+  if (!signer) {
+    End(id, false);
+    return;
+  }
+  size_t documents = std::uniform_int_distribution<size_t>(1, 8)(random_);
+  native_core::CancellationToken token = calls_.at(id).cancellation.token();
+  native_core::PlatformDispatcher* dispatcher =
+      &native_core::Runtime::Get().dispatcher();
+  batch_threads_[id] = std::thread([this, id, signer, documents, token,
+                                    dispatcher]() {
+    bool ok = options_.server.empty()
+                  ? SignLocalBatch(signer.get(), id, documents, token)
+                  : SignProxyBatch(signer.get(), documents, token);
+    dispatcher->Post([this, id, ok]() {
+      auto thread = batch_threads_.find(id);
+      thread->second.join();
+      batch_threads_.erase(thread);
+      End(id, ok);
+    });
+  });
+}
+
+bool Soak::SignLocalBatch(native_core::Pkcs1Signer* signer,
+                          uint64_t id,
+                          size_t documents,
+                          const native_core::CancellationToken& token) {
+  std::vector<uint8_t> certificate = signer->Certificate();
+  std::mt19937 random(static_cast<unsigned>(id));
+  for (size_t i = 0; i < documents && !token.IsCancelled(); i++) {
+    std::vector<uint8_t> content(
+        std::uniform_int_distribution<size_t>(1024, 256 * 1024)(random));
+    for (uint8_t& byte : content) {
+      byte = static_cast<uint8_t>(random());
+    }
+    native_core::CadesOptions options;
+    options.attached = i % 2 == 0;
+    std::vector<uint8_t> signature;
+    std::string error;
+    if (!native_core::BuildCadesSignature(signer, certificate, content.data(),
+                                          content.size(), options, &signature,
+                                          &error)) {
+      return false;
+    }
+  }
+  if (!options_.pdf.empty() && !token.IsCancelled()) {
+    std::string output =
+        options_.scratch + "/batch-" + std::to_string(id) + ".pdf";
+    std::string error;
+    bool ok = native_core::SignPdf(signer, options_.pdf, output,
+                                   native_core::PadesOptions(), nullptr,
+                                   &error);
+    std::error_code ignored;
+    std::filesystem::remove(output, ignored);
+    return ok;
+  }
+  return true;
+}
+
+bool Soak::SignProxyBatch(native_core::Pkcs1Signer* signer,
+                          size_t documents,
+                          const native_core::CancellationToken& token) {
+  // A client of its own: the proxy session is kept in the client's cookies.
+  native_core::HttpClientOptions client_options;
+  client_options.ca_file = options_.ca_file;
+  std::unique_ptr<native_core::HttpClient> client =
+      native_core::HttpClient::Create(client_options);
+  native_core::ProxySession session(client.get(), options_.server);
+  std::string error;
+  if (!session.Login(signer, &error)) {
+    return false;
+  }
+  std::vector<native_core::ListedRequest> requests;
+  int total = 0;
+  bool ok = session.ListRequests("unresolved", 1, 20, &requests, &total,
+                                 &error);
+  std::vector<native_core::TriphaseJob> jobs;
+  for (const native_core::ListedRequest& request : requests) {
+    if (request.type == 0 && jobs.size() < documents) {
+      jobs.push_back({request.id, request.documents});
+    }
+  }
+  native_core::TriphaseEngine engine(session.transport(), signer);
+  engine.Run(jobs, [&](const native_core::TriphaseOutcome& outcome) {
+    ok = ok && outcome.status_ok;
+  }, token);
+  session.Logout();
+  return ok;
+}
+
+void Soak::Download() {
+  uint64_t id = Begin(kDownload);
+  std::string path = options_.scratch + "/download-" +
+                     std::to_string(id % kDownloadFiles) + ".pdf";
+  int size = kThumbnailSizes[std::uniform_int_distribution<size_t>(
+      0, std::size(kThumbnailSizes) - 1)(random_)];
+  auto body = std::make_shared<std::vector<uint8_t>>(
+      document_.empty() ? RandomBytes(64 * 1024) : document_);
+  std::shared_ptr<native_core::ThumbnailCache> thumbnails = thumbnails_;
+  auto ok = std::make_shared<bool>(false);
+  auto work = [id, path, size, body, thumbnails, ok]() {
+    // Written aside and renamed, as the download of the same file may still
+    // be asking for its thumbnail.
+    std::string temporary = path + "." + std::to_string(id);
+    {
+      std::ofstream out(temporary, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(body->data()),
+                static_cast<std::streamsize>(body->size()));
+      *ok = static_cast<bool>(out);
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    *ok = *ok && !error;
+    std::string ignored;
+    thumbnails->Get(path, size, &ignored);
+  };
+  auto done = [this, id, ok](bool cancelled) {
+    End(id, *ok && !cancelled);
+  };
+  if (!native_core::Runtime::Get().RunAsync(
+          work, done, calls_.at(id).cancellation.token())) {
+    End(id, false);
+  }
+}
+
+void Soak::Cancel() {
+  uint64_t id = Begin(kCancel);
+  std::vector<uint64_t> running;
+  for (const auto& [call_id, call] : calls_) {
+    if (call.operation != kCancel && !call.cancellation.IsCancelled()) {
+      running.push_back(call_id);
+    }
+  }
+  if (!running.empty()) {
+    uint64_t picked = running[std::uniform_int_distribution<size_t>(
+        0, running.size() - 1)(random_)];
+    Call& call = calls_.at(picked);
+    call.cancellation.Cancel();
+    cancelled_++;
+    // A cancelled call still ends: a batch with its outcome, a call on the
+    // pool with its completion told of the cancellation.
+  }
+  End(id, true);
+}
+
+uint64_t Soak::Begin(Operation operation) {
+  uint64_t id = next_call_++;
+  calls_[id] = Call{operation, Clock::now(), {}};
+  return id;
+}
+
+void Soak::End(uint64_t id, bool ok) {
+  auto call = calls_.find(id);
+  if (call == calls_.end()) {
+    late_++;
+    return;
+  }
+  Operation operation = call->second.operation;
+  latencies_[operation].Record(Clock::now() - call->second.start);
+  if (!ok) {
+    errors_[operation]++;
+  }
+  total_calls_++;
+  calls_.erase(call);
+}
+
+void Soak::Pump(int timeout_ms) {
+  native_core::Runtime& runtime = native_core::Runtime::Get();
+  // The runtime wakes hosts without a window loop through an eventfd.
+  auto& wakeup = static_cast<native_core::EventFdWakeup&>(runtime.wakeup());
+  if (wakeup.Wait(timeout_ms)) {
+    wakeup.Consume();
+  }
+  runtime.dispatcher().Drain();
+}
+
+bool Soak::Report(int number, const ProcessState& state, double seconds) {
+  std::printf("window %d (%.0f s): rss %.1f MB, %d fds, %d threads, "
+              "%llu cancelled, %llu answered after cancel\n",
+              number, seconds, state.rss / 1e6, state.descriptors,
+              state.threads, static_cast<unsigned long long>(cancelled_),
+              static_cast<unsigned long long>(late_));
+  bool steady = number > options_.warmup + options_.baseline;
+  bool baseline = number > options_.warmup && !steady;
+  bool ok = true;
+  if (baseline) {
+    steady_.rss = std::max(steady_.rss, state.rss);
+    steady_.descriptors = std::max(steady_.descriptors, state.descriptors);
+    steady_.threads = std::max(steady_.threads, state.threads);
+  }
+  else if (steady) {
+    if (options_.rss_growth > 0 &&
+        state.rss > steady_.rss + steady_.rss * options_.rss_growth / 100) {
+      std::printf("  regression: rss %.1f MB, steady %.1f MB\n",
+                  state.rss / 1e6, steady_.rss / 1e6);
+      ok = false;
+    }
+    if (state.descriptors > steady_.descriptors + kDescriptorSlack) {
+      std::printf("  regression: %d fds, steady %d\n", state.descriptors,
+                  steady_.descriptors);
+      ok = false;
+    }
+    if (state.threads > steady_.threads + kThreadSlack) {
+      std::printf("  regression: %d threads, steady %d\n", state.threads,
+                  steady_.threads);
+      ok = false;
+    }
+  }
+
+  for (int i = 0; i < kOperationCount; i++) {
+    native_core::DurationHistogram& latency = latencies_[i];
+    if (latency.count() == 0) {
+      continue;
+    }
+    std::chrono::nanoseconds p99 = latency.Percentile(99);
+    std::printf("  %-9s %8llu calls %6llu errors  p50 %8.2f  p99 %8.2f  "
+                "max %8.2f ms\n",
+                kOperationNames[i],
+                static_cast<unsigned long long>(latency.count()),
+                static_cast<unsigned long long>(errors_[i]),
+                Milliseconds(latency.Percentile(50)), Milliseconds(p99),
+                Milliseconds(latency.max()));
+    bool enough = latency.count() >= kMinSamples;
+    if (baseline && enough) {
+      steady_p99_[i] = std::max(steady_p99_[i], p99);
+    }
+    else if (steady && enough && steady_p99_[i].count() > 0 &&
+             p99 - steady_p99_[i] > kNoiseFloor &&
+             p99 > steady_p99_[i] +
+                       steady_p99_[i] * options_.latency_growth / 100) {
+      std::printf("  regression: %s p99 %.2f ms, steady %.2f ms\n",
+                  kOperationNames[i], Milliseconds(p99),
+                  Milliseconds(steady_p99_[i]));
+      ok = false;
+    }
+    latency.Reset();
+    errors_[i] = 0;
+  }
+  std::fflush(stdout);
+  return ok;
+}
+
+std::vector<uint8_t> Soak::RandomBytes(size_t size) {
+  std::vector<uint8_t> bytes(size);
+  for (uint8_t& byte : bytes) {
+    byte = static_cast<uint8_t>(random_());
+  }
+  return bytes;
+}
+
+bool ParseInt(const char* text, int* value) {
+  char* end = nullptr;
+  long parsed = std::strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || parsed < 0 || parsed > 1 << 24) {
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  bool ok = true;
+  for (int i = 1; i < argc && ok; i += 2) {
+    const char* flag = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      ok = false;
+    }
+    else if (std::strcmp(flag, "--key") == 0) {
+      options.key = value;
+    }
+    else if (std::strcmp(flag, "--pdf") == 0) {
+      options.pdf = value;
+    }
+    else if (std::strcmp(flag, "--server") == 0) {
+      options.server = value;
+    }
+    else if (std::strcmp(flag, "--ca-file") == 0) {
+      options.ca_file = value;
+    }
+    else if (std::strcmp(flag, "--scratch") == 0) {
+      options.scratch = value;
+    }
+    else if (std::strcmp(flag, "--seconds") == 0) {
+      ok = ParseInt(value, &options.seconds);
+    }
+    else if (std::strcmp(flag, "--window") == 0) {
+      ok = ParseInt(value, &options.window) && options.window > 0;
+    }
+    else if (std::strcmp(flag, "--warmup") == 0) {
+      ok = ParseInt(value, &options.warmup);
+    }
+    else if (std::strcmp(flag, "--baseline") == 0) {
+      ok = ParseInt(value, &options.baseline) && options.baseline > 0;
+    }
+    else if (std::strcmp(flag, "--concurrency") == 0) {
+      ok = ParseInt(value, &options.concurrency) && options.concurrency > 0;
+    }
+    else if (std::strcmp(flag, "--seed") == 0) {
+      ok = ParseInt(value, &options.seed);
+    }
+    else if (std::strcmp(flag, "--rss-growth") == 0) {
+      ok = ParseInt(value, &options.rss_growth);
+    }
+    else if (std::strcmp(flag, "--latency-growth") == 0) {
+      ok = ParseInt(value, &options.latency_growth);
+    }
+    else {
+      ok = false;
+    }
+  }
+  if (!ok || options.key.empty()) {
+    std::fprintf(stderr,
+                 "usage: %s --key key.pem [--pdf FILE] [--server URL] "
+                 "[--ca-file FILE]\n"
+                 "       [--seconds 600] [--window 30] [--warmup 2] "
+                 "[--baseline 2]\n"
+                 "       [--concurrency 16] [--seed 1] [--scratch DIR]\n"
+                 "       [--rss-growth 25] [--latency-growth 100]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::string error;
+  if (!native_core::FileKeySigner::Open(options.key, &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::vector<uint8_t> document;
+  if (!options.pdf.empty()) {
+    std::ifstream in(options.pdf, std::ios::binary);
+    document.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+    if (document.empty()) {
+      std::fprintf(stderr, "cannot read %s\n", options.pdf.c_str());
+      return 1;
+    }
+  }
+
+  // A temporary scratch directory unless one is given; either way it is
+  // emptied first.
+  bool temporary_scratch = options.scratch.empty();
+  if (temporary_scratch) {
+    options.scratch = (std::filesystem::temp_directory_path() /
+                       ("plugin_soak-" + std::to_string(getpid())))
+                          .string();
+  }
+  std::error_code filesystem_error;
+  std::filesystem::remove_all(options.scratch, filesystem_error);
+  std::filesystem::create_directories(options.scratch + "/thumbnails",
+                                      filesystem_error);
+  if (filesystem_error) {
+    std::fprintf(stderr, "cannot create %s\n", options.scratch.c_str());
+    return 1;
+  }
+
+  // The runtime is created on the thread that plays the platform thread.
+  native_core::Runtime::Get();
+  int status;
+  {
+    Soak soak(options, std::move(document));
+    status = soak.Run();
+  }
+  native_core::SetActiveSigner(nullptr);
+  if (temporary_scratch) {
+    std::filesystem::remove_all(options.scratch, filesystem_error);
+  }
+  return status;
+}
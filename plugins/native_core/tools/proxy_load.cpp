@@ -0,0 +1,345 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Drives a proxy, normally proxy_standin, with concurrent simulated users
+// and reports the latency percentiles and throughput of each operation:
+//
+//   proxy_load --server URL --key key.pem [--users 20] [--seconds 30]
+//              [--page-size 20] [--batch 5] [--think-ms 0] [--ca-file FILE]
+//
+// Each user has an HTTP client of its own, as each app instance does, and
+// logs in, then goes round: a page of the request list, the detail and the
+// preview of one request, a batch signature of the signature requests of
+// the page through the triphase engine, an approval of the approval
+// requests and, every tenth round, a rejection. A user whose list runs dry
+// logs out and in again, which the stand-in answers as another user.
+//
+// key.pem holds the RSA private key followed by its certificate.
+#include <native_core/file_key_signer.h>
+#include <native_core/histogram.h>
+#include <native_core/http_client.h>
+#include <native_core/proxy_session.h>
+#include <native_core/triphase_engine.h>
+#include <native_core/xml_request_builder.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Operation {
+  kLogin,
+  kList,
+  kDetail,
+  kPreview,
+  kPresign,
+  kPostsign,
+  kApprove,
+  kReject,
+  kLogout,
+  kOperationCount
+};
+
+constexpr const char* kOperationNames[kOperationCount] = {
+    "login", "list",    "detail", "preview", "presign",
+    "postsign", "approve", "reject", "logout"};
+
+struct OperationStats {
+  native_core::DurationHistogram latency;
+  std::atomic<uint64_t> errors{0};
+};
+
+struct Stats {
+  std::array<OperationStats, kOperationCount> operations;
+  std::atomic<uint64_t> signed_requests{0};
+  std::atomic<uint64_t> failed_requests{0};
+  std::atomic<uint64_t> bytes_received{0};
+
+  void Record(Operation operation, Clock::time_point start, bool ok) {
+    operations[operation].latency.Record(Clock::now() - start);
+    if (!ok) {
+      operations[operation].errors.fetch_add(1);
+    }
+  }
+};
+
+struct Options {
+  std::string server;
+  std::string key;
+  std::string ca_file;
+  int users = 20;
+  int seconds = 30;
+  int page_size = 20;
+  int batch = 5;
+  int think_ms = 0;
+};
+
+// Times the presigns and postsigns the engine sends, by the operation code
+// at the start of the body.
+class TimedTransport : public native_core::TriphaseTransport {
+ public:
+  TimedTransport(native_core::TriphaseTransport* transport, Stats* stats)
+      : transport_(transport), stats_(stats) {}
+
+  int Post(const std::vector<uint8_t>& body, const Sink& sink) override {
+    Operation operation = body.size() > 4 && body[3] == '1' && body[4] == '&'
+                              ? kPostsign
+                              : kPresign;
+    Clock::time_point start = Clock::now();
+    int status = transport_->Post(body, sink);
+    stats_->Record(operation, start, status == 200);
+    return status;
+  }
+
+ private:
+  native_core::TriphaseTransport* transport_;
+  Stats* stats_;
+};
+
+// Posts |body| and reports whether the proxy answered 200 with no <err>.
+bool Call(native_core::TriphaseTransport* transport,
+          const std::vector<uint8_t>& body,
+          Stats* stats) {
+  bool error = false;
+  size_t received = 0;
+  int status = transport->Post(body, [&](const char* data, size_t size) {
+    received += size;
+    error = error || std::string_view(data, size).find("<err") !=
+                         std::string_view::npos;
+  });
+  stats->bytes_received.fetch_add(received);
+  return status == 200 && !error;
+}
+
+void SimulateUser(int number,
+                  const Options& options,
+                  native_core::Pkcs1Signer* signer,
+                  Clock::time_point deadline,
+                  Stats* stats) {
+  native_core::HttpClientOptions client_options;
+  client_options.ca_file = options.ca_file;
+  std::unique_ptr<native_core::HttpClient> client =
+      native_core::HttpClient::Create(client_options);
+  native_core::ProxySession session(client.get(), options.server);
+  TimedTransport timed(session.transport(), stats);
+  native_core::TriphaseEngine engine(&timed, signer);
+  std::mt19937 random(static_cast<unsigned>(number));
+  std::string error;
+
+  while (Clock::now() < deadline) {
+    Clock::time_point start = Clock::now();
+    bool logged_in = session.Login(signer, &error);
+    stats->Record(kLogin, start, logged_in);
+    if (!logged_in) {
+      std::fprintf(stderr, "user %d: %s\n", number, error.c_str());
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      continue;
+    }
+
+    for (int round = 1; Clock::now() < deadline; ++round) {
+      std::vector<native_core::ListedRequest> requests;
+      int total = 0;
+      start = Clock::now();
+      bool listed = session.ListRequests("unresolved", 1, options.page_size,
+                                         &requests, &total, &error);
+      stats->Record(kList, start, listed);
+      if (!listed || requests.empty()) {
+        break;
+      }
+
+      const native_core::ListedRequest& picked =
+          requests[random() % requests.size()];
+      start = Clock::now();
+      stats->Record(kDetail, start,
+                    Call(session.transport(),
+                         native_core::BuildRequestDetailBody("4", picked.id),
+                         stats));
+      if (picked.documents && !picked.documents->empty()) {
+        start = Clock::now();
+        stats->Record(
+            kPreview, start,
+            Call(session.transport(),
+                 native_core::BuildPreviewBody(
+                     "5", picked.documents->front().id),
+                 stats));
+      }
+
+      std::vector<native_core::TriphaseJob> jobs;
+      std::vector<std::string_view> approvals;
+      for (const native_core::ListedRequest& request : requests) {
+        if (request.type == 1) {
+          approvals.push_back(request.id);
+        }
+        else if (request.type == 0 &&
+                 jobs.size() < static_cast<size_t>(options.batch)) {
+          jobs.push_back({request.id, request.documents});
+        }
+      }
+      engine.Run(jobs, [&](const native_core::TriphaseOutcome& outcome) {
+        (outcome.status_ok ? stats->signed_requests : stats->failed_requests)
+            .fetch_add(1);
+      });
+      if (!approvals.empty()) {
+        start = Clock::now();
+        stats->Record(kApprove, start,
+                      Call(session.transport(),
+                           native_core::BuildApproveBody("7", approvals),
+                           stats));
+      }
+      if (round % 10 == 0) {
+        const native_core::ListedRequest& rejected = requests.back();
+        start = Clock::now();
+        stats->Record(
+            kReject, start,
+            Call(session.transport(),
+                 native_core::BuildRejectBody("3", {rejected.id},
+                                              "Rechazo de prueba"),
+                 stats));
+      }
+      if (options.think_ms > 0) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(options.think_ms));
+      }
+    }
+
+    start = Clock::now();
+    session.Logout();
+    stats->Record(kLogout, start, true);
+  }
+}
+
+bool ParseInt(const char* text, int* value) {
+  char* end = nullptr;
+  long parsed = std::strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || parsed < 0 || parsed > 1 << 20) {
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+double Milliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  bool ok = true;
+  for (int i = 1; i < argc && ok; i += 2) {
+    const char* flag = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      ok = false;
+    }
+    else if (std::strcmp(flag, "--server") == 0) {
+      options.server = value;
+    }
+    else if (std::strcmp(flag, "--key") == 0) {
+      options.key = value;
+    }
+    else if (std::strcmp(flag, "--ca-file") == 0) {
+      options.ca_file = value;
+    }
+    else if (std::strcmp(flag, "--users") == 0) {
+      ok = ParseInt(value, &options.users) && options.users > 0;
+    }
+    else if (std::strcmp(flag, "--seconds") == 0) {
+      ok = ParseInt(value, &options.seconds);
+    }
+    else if (std::strcmp(flag, "--page-size") == 0) {
+      ok = ParseInt(value, &options.page_size) && options.page_size > 0;
+    }
+    else if (std::strcmp(flag, "--batch") == 0) {
+      ok = ParseInt(value, &options.batch);
+    }
+    else if (std::strcmp(flag, "--think-ms") == 0) {
+      ok = ParseInt(value, &options.think_ms);
+    }
+    else {
+      ok = false;
+    }
+  }
+  if (!ok || options.server.empty() || options.key.empty()) {
+    std::fprintf(stderr,
+                 "usage: %s --server URL --key key.pem [--users 20] "
+                 "[--seconds 30]\n"
+                 "       [--page-size 20] [--batch 5] [--think-ms 0] "
+                 "[--ca-file FILE]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::string error;
+  std::unique_ptr<native_core::FileKeySigner> signer =
+      native_core::FileKeySigner::Open(options.key, &error);
+  if (!signer) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  Stats stats;
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + std::chrono::seconds(options.seconds);
+  std::vector<std::thread> users;
+  for (int i = 0; i < options.users; ++i) {
+    users.emplace_back(SimulateUser, i, std::cref(options), signer.get(),
+                       deadline, &stats);
+  }
+  for (std::thread& user : users) {
+    user.join();
+  }
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::printf("%d users for %.1f s: %llu requests signed, %llu failed, "
+              "%.1f signatures/s, %.1f MB received\n\n",
+              options.users, seconds,
+              static_cast<unsigned long long>(stats.signed_requests.load()),
+              static_cast<unsigned long long>(stats.failed_requests.load()),
+              stats.signed_requests.load() / seconds,
+              stats.bytes_received.load() / 1e6);
+  std::printf("%-10s %9s %7s %9s %9s %9s %9s %9s\n", "operation", "count",
+              "errors", "per s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+  for (int i = 0; i < kOperationCount; ++i) {
+    const OperationStats& operation = stats.operations[i];
+    if (operation.latency.count() == 0) {
+      continue;
+    }
+    std::printf("%-10s %9llu %7llu %9.1f %9.2f %9.2f %9.2f %9.2f\n",
+                kOperationNames[i],
+                static_cast<unsigned long long>(operation.latency.count()),
+                static_cast<unsigned long long>(operation.errors.load()),
+                operation.latency.count() / seconds,
+                Milliseconds(operation.latency.Percentile(50)),
+                Milliseconds(operation.latency.Percentile(90)),
+                Milliseconds(operation.latency.Percentile(99)),
+                Milliseconds(operation.latency.max()));
+  }
+  return 0;
+}
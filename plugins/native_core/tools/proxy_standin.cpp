@@ -0,0 +1,880 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A stand-in for the portafirmas proxy, for measuring the app, the batch
+// signer and proxy_load end to end without the real one:
+//
+//   proxy_standin [--port 8080] [--users 50] [--requests 1000]
+//                 [--documents 2] [--document-kb 64]
+//                 [--latency-ms 0] [--jitter-ms 0] [--latency OP=MS]...
+//
+// Speaks the op= protocol of Api over HTTP/1.1 with keep-alive, as a form
+// POST or, for the previews, a GET: the login challenge (10, 11), request
+// list paging (2), detail (4), presign (0), postsign (1), approve (7),
+// reject (3), document, signature and report previews (5, 8, 9) and logout
+// (12). Unknown operations get an <err> element, requests without a session
+// a 401.
+//
+// The data is synthetic and generated on demand: |users| users with
+// |requests| requests of |documents| documents each, every fifth one an
+// approval. Signing, approving and rejecting move a request to the signed or
+// rejected list for the rest of the run. Each login is given the next user,
+// round robin, whatever its certificate; signatures are checked for
+// presence, not verified.
+//
+// Every response is delayed by --latency-ms, plus a uniform random part of
+// up to --jitter-ms; --latency OP=MS sets the base delay of one operation.
+//
+// --port 0 serves on a free port. Either way the first line written to
+// standard error ends with the URL served, which is how the tests find it.
+#include <native_core/xml_pull_parser.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kOperations = 13;
+
+// Request states, as listed.
+enum State : uint8_t { kUnresolved, kSigned, kRejected };
+
+struct Config {
+  int port = 8080;
+  int users = 50;
+  int requests = 1000;
+  int documents = 2;
+  int document_kb = 64;
+  int jitter_ms = 0;
+  int latency_ms[kOperations] = {};
+};
+
+struct User {
+  std::mutex mutex;
+  std::vector<State> states;
+};
+
+struct Session {
+  int user = 0;
+  std::string challenge;
+  std::atomic<bool> logged_in{false};
+};
+
+struct Response {
+  int status = 200;
+  std::string content_type = "application/xml";
+  std::string body;
+  std::string set_cookie;
+};
+
+// An element of a request, in document order, with its own text.
+struct Element {
+  std::string name;
+  std::vector<native_core::XmlPullParser::Attribute> attributes;
+  std::string text;
+
+  std::string Attribute(std::string_view name) const {
+    for (const auto& attribute : attributes) {
+      if (attribute.name == name) {
+        return attribute.value;
+      }
+    }
+    return std::string();
+  }
+};
+
+constexpr char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string Base64Encode(const uint8_t* data, size_t size) {
+  std::string encoded;
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    uint32_t bits = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) |
+                    data[i + 2];
+    for (int shift = 18; shift >= 0; shift -= 6) {
+      encoded += kAlphabet[(bits >> shift) & 0x3F];
+    }
+  }
+  if (i < size) {
+    uint32_t bits = uint32_t{data[i]} << 16;
+    if (i + 1 < size) {
+      bits |= uint32_t{data[i + 1]} << 8;
+    }
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += i + 1 < size ? kAlphabet[(bits >> 6) & 0x3F] : '=';
+    encoded += '=';
+  }
+  return encoded;
+}
+
+// The dat parameter: base64 in either alphabet, with the padding written as
+// '=' or "%3D" (Api.base64UrlSafeEncode()).
+bool DecodeData(std::string_view encoded, std::string* data) {
+  data->clear();
+  uint32_t bits = 0;
+  int count = 0;
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    char c = encoded[i];
+    if (c == '=' || c == '%') {
+      break;
+    }
+    int value = c >= 'A' && c <= 'Z'   ? c - 'A'
+                : c >= 'a' && c <= 'z' ? c - 'a' + 26
+                : c >= '0' && c <= '9' ? c - '0' + 52
+                : c == '+' || c == '-' ? 62
+                : c == '/' || c == '_' ? 63
+                                       : -1;
+    if (value < 0) {
+      return false;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    if (++count == 4) {
+      data->push_back(static_cast<char>(bits >> 16));
+      data->push_back(static_cast<char>(bits >> 8));
+      data->push_back(static_cast<char>(bits));
+      bits = 0;
+      count = 0;
+    }
+  }
+  if (count == 1) {
+    return false;
+  }
+  if (count > 1) {
+    bits <<= 6 * (4 - count);
+    data->push_back(static_cast<char>(bits >> 16));
+    if (count == 3) {
+      data->push_back(static_cast<char>(bits >> 8));
+    }
+  }
+  return true;
+}
+
+bool ParseXml(const std::string& xml, std::vector<Element>* elements) {
+  native_core::XmlPullParser parser;
+  parser.Feed(xml.data(), xml.size());
+  parser.Finish();
+  std::vector<size_t> open;
+  while (true) {
+    switch (parser.Next()) {
+      case native_core::XmlPullParser::Event::kStartElement:
+        open.push_back(elements->size());
+        elements->push_back({parser.name(), parser.attributes(), {}});
+        break;
+      case native_core::XmlPullParser::Event::kEndElement:
+        open.pop_back();
+        break;
+      case native_core::XmlPullParser::Event::kText:
+        if (!open.empty()) {
+          (*elements)[open.back()].text += parser.text();
+        }
+        break;
+      case native_core::XmlPullParser::Event::kOther:
+        break;
+      case native_core::XmlPullParser::Event::kEndDocument:
+        return !elements->empty();
+      default:
+        return false;
+    }
+  }
+}
+
+std::string Escape(std::string_view text) {
+  std::string escaped;
+  for (char c : text) {
+    switch (c) {
+      case '<':
+        escaped += "&lt;";
+        break;
+      case '>':
+        escaped += "&gt;";
+        break;
+      case '&':
+        escaped += "&amp;";
+        break;
+      case '"':
+        escaped += "&quot;";
+        break;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+class Proxy {
+ public:
+  explicit Proxy(const Config& config) : config_(config) {
+    for (int i = 0; i < config.users; ++i) {
+      users_.push_back(std::make_unique<User>());
+      users_.back()->states.assign(static_cast<size_t>(config.requests),
+                                   kUnresolved);
+    }
+  }
+
+  // Handles one call. |cookie| is the session id sent by the client.
+  Response Handle(int operation, const std::string& xml,
+                  const std::string& cookie) {
+    Response response;
+    std::vector<Element> elements;
+    if (operation == 10) {
+      return LoginRequest();
+    }
+    if (!ParseXml(xml, &elements)) {
+      return Error("ERR-02", "XML de la petición mal formado");
+    }
+    std::shared_ptr<Session> session = FindSession(cookie);
+    if (!session) {
+      response.status = 401;
+      return response;
+    }
+    if (operation == 11) {
+      return LoginValidation(session.get(), elements);
+    }
+    if (!session->logged_in) {
+      response.status = 401;
+      return response;
+    }
+    User& user = *users_[static_cast<size_t>(session->user)];
+    switch (operation) {
+      case 0:
+        return Presign(session->user, user, elements);
+      case 1:
+        return Postsign(session->user, user, elements);
+      case 2:
+        return List(session->user, user, elements);
+      case 3:
+        return Resolve(session->user, user, elements, "rjct", kRejected);
+      case 4:
+        return Detail(session->user, user, elements);
+      case 5:
+      case 8:
+      case 9:
+        return Preview(operation, elements);
+      case 7:
+        return Resolve(session->user, user, elements, "r", kSigned);
+      case 12: {
+        std::lock_guard<std::mutex> lock(sessions_mutex_);
+        sessions_.erase(cookie);
+        response.body = "<lgorq/>";
+        return response;
+      }
+      default:
+        return Error("ERR-01", "Operación no soportada");
+    }
+  }
+
+  int LatencyMs(int operation) {
+    int latency = operation >= 0 && operation < kOperations
+                      ? config_.latency_ms[operation]
+                      : 0;
+    if (config_.jitter_ms > 0) {
+      std::lock_guard<std::mutex> lock(random_mutex_);
+      latency += std::uniform_int_distribution<int>(0, config_.jitter_ms)(
+          random_);
+    }
+    return latency;
+  }
+
+ private:
+  static Response Error(const char* code, const char* message) {
+    Response response;
+    response.body = std::string("<err cd=\"") + code + "\">" + message +
+                    "</err>";
+    return response;
+  }
+
+  std::string RandomBase64(size_t size) {
+    std::vector<uint8_t> bytes(size);
+    std::lock_guard<std::mutex> lock(random_mutex_);
+    for (uint8_t& byte : bytes) {
+      byte = static_cast<uint8_t>(random_());
+    }
+    return Base64Encode(bytes.data(), bytes.size());
+  }
+
+  std::shared_ptr<Session> FindSession(const std::string& id) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    auto it = sessions_.find(id);
+    return it == sessions_.end() ? nullptr : it->second;
+  }
+
+  Response LoginRequest() {
+    auto session = std::make_shared<Session>();
+    int number = next_session_.fetch_add(1);
+    session->user = number % config_.users;
+    session->challenge = RandomBase64(32);
+    char id[32];
+    std::snprintf(id, sizeof(id), "SID%08d.standin", number);
+    {
+      std::lock_guard<std::mutex> lock(sessions_mutex_);
+      sessions_[id] = session;
+    }
+    Response response;
+    response.set_cookie = std::string("JSESSIONID=") + id + "; Path=/";
+    response.body = std::string("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                                "<lgnrq id=\"") +
+                    id + "\">" + session->challenge + "</lgnrq>";
+    return response;
+  }
+
+  Response LoginValidation(Session* session,
+                           const std::vector<Element>& elements) {
+    bool has_certificate = false;
+    bool has_signature = false;
+    for (const Element& element : elements) {
+      has_certificate |= element.name == "cert" && !element.text.empty();
+      has_signature |= element.name == "pkcs1" && !element.text.empty();
+    }
+    Response response;
+    if (!has_certificate || !has_signature) {
+      response.body = "<vllgnrq ok=\"false\" er=\"Firma no valida\"/>";
+      return response;
+    }
+    session->logged_in = true;
+    char dni[16];
+    std::snprintf(dni, sizeof(dni), "%08d%c", session->user,
+                  "TRWAGMYFPDXBNJZSQVHLCKE"[session->user % 23]);
+    response.body = std::string("<vllgnrq ok=\"true\" dni=\"") + dni + "\"/>";
+    return response;
+  }
+
+  // "U0001R000042" for request 42 of user 1, and "...D1" for its documents.
+  static std::string RequestId(int user, int index) {
+    char id[32];
+    std::snprintf(id, sizeof(id), "U%04dR%06d", user, index);
+    return id;
+  }
+
+  // The index of the request |id| of |user|, or -1.
+  int RequestIndex(int user, const std::string& id) const {
+    int id_user = -1;
+    int index = -1;
+    if (std::sscanf(id.c_str(), "U%dR%d", &id_user, &index) != 2 ||
+        id_user != user || index < 0 || index >= config_.requests) {
+      return -1;
+    }
+    return index;
+  }
+
+  static bool IsApproval(int index) { return index % 5 == 4; }
+
+  static const char* Format(int document) {
+    static const char* const kFormats[] = {"PAdES", "CAdES", "XAdES"};
+    return kFormats[document % 3];
+  }
+
+  void AppendDocuments(int user, int index, std::string* out) const {
+    *out += "<docs>";
+    for (int d = 0; d < config_.documents; ++d) {
+      char document[160];
+      std::snprintf(document, sizeof(document),
+                    "<doc docid=\"%sD%d\"><nm>documento_%d.pdf</nm><sz>%d</sz>"
+                    "<mmtp>application/pdf</mmtp><sigfrmt>%s</sigfrmt>",
+                    RequestId(user, index).c_str(), d, d + 1,
+                    config_.document_kb * 1024, Format(d));
+      *out += document;
+      *out += "<mdalgo>SHA-256</mdalgo><params></params></doc>";
+    }
+    *out += "</docs>";
+  }
+
+  void AppendHeader(int user, int index, const char* element,
+                    std::string* out) const {
+    char header[192];
+    std::snprintf(header, sizeof(header),
+                  "<%s id=\"%s\" priority=\"%d\" workflow=\"false\" "
+                  "forward=\"false\" type=\"%s\">",
+                  element, RequestId(user, index).c_str(), 1 + index % 4,
+                  IsApproval(index) ? "VISTOBUENO" : "FIRMA");
+    *out += header;
+    char subject[96];
+    std::snprintf(subject, sizeof(subject),
+                  "<subj>Solicitud %d del usuario %d</subj>", index, user);
+    *out += subject;
+  }
+
+  static std::string Date(int index) {
+    char date[32];
+    std::snprintf(date, sizeof(date), "%02d/%02d/2022", 1 + index % 28,
+                  1 + index / 28 % 12);
+    return date;
+  }
+
+  Response List(int user_index, User& user,
+                const std::vector<Element>& elements) {
+    const Element& root = elements[0];
+    std::string state_name = root.Attribute("state");
+    State state = state_name == "signed"     ? kSigned
+                  : state_name == "rejected" ? kRejected
+                                             : kUnresolved;
+    int page = std::max(1, std::atoi(root.Attribute("pg").c_str()));
+    int size = std::max(1, std::atoi(root.Attribute("sz").c_str()));
+    std::vector<int> selected;
+    int total = 0;
+    {
+      std::lock_guard<std::mutex> lock(user.mutex);
+      long first = static_cast<long>(page - 1) * size;
+      for (int i = 0; i < config_.requests; ++i) {
+        if (user.states[static_cast<size_t>(i)] != state) {
+          continue;
+        }
+        if (total >= first && total < first + size) {
+          selected.push_back(i);
+        }
+        ++total;
+      }
+    }
+    Response response;
+    response.body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><list n=\"" +
+                    std::to_string(total) + "\">";
+    for (int index : selected) {
+      AppendHeader(user_index, index, "rqt", &response.body);
+      response.body += "<snder>Remitente " + std::to_string(index % 17) +
+                       "</snder><view>" +
+                       (index % 3 == 0 ? "LEIDO" : "NUEVO") + "</view><date>" +
+                       Date(index) + "</date>";
+      AppendDocuments(user_index, index, &response.body);
+      response.body += "</rqt>";
+    }
+    response.body += "</list>";
+    return response;
+  }
+
+  Response Detail(int user_index, User& /*user*/,
+                  const std::vector<Element>& elements) {
+    int index = RequestIndex(user_index, elements[0].Attribute("id"));
+    if (index < 0) {
+      return Error("ERR-03", "Petición desconocida");
+    }
+    Response response;
+    response.body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    AppendHeader(user_index, index, "dtl", &response.body);
+    response.body += "<msg>Mensaje de la solicitud " + std::to_string(index) +
+                     "</msg><snders><snder>Remitente " +
+                     std::to_string(index % 17) + "</snder></snders><date>" +
+                     Date(index) + "</date><app>Stand-in</app><ref>REF-" +
+                     RequestId(user_index, index) +
+                     "</ref><signlinestype>cascada</signlinestype><sgnlines>"
+                     "<sgnline type=\"FIRMA\"><rcvr st=\"false\">Firmante " +
+                     std::to_string(user_index) + "</rcvr></sgnline></sgnlines>";
+    AppendDocuments(user_index, index, &response.body);
+    response.body += "<attachedlist></attachedlist></dtl>";
+    return response;
+  }
+
+  Response Presign(int user_index, User& user,
+                   const std::vector<Element>& elements) {
+    Response response;
+    response.body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><pres>";
+    for (size_t i = 0; i < elements.size(); ++i) {
+      if (elements[i].name != "req") {
+        continue;
+      }
+      std::string id = elements[i].Attribute("id");
+      int index = RequestIndex(user_index, id);
+      bool pending = false;
+      if (index >= 0) {
+        std::lock_guard<std::mutex> lock(user.mutex);
+        pending = user.states[static_cast<size_t>(index)] == kUnresolved;
+      }
+      if (!pending || IsApproval(index)) {
+        response.body += "<req id=\"" + Escape(id) + "\" status=\"KO\"/>";
+        continue;
+      }
+      response.body += "<req id=\"" + id + "\" status=\"OK\">";
+      for (size_t j = i + 1; j < elements.size() && elements[j].name != "req";
+           ++j) {
+        const Element& document = elements[j];
+        if (document.name != "doc") {
+          continue;
+        }
+        response.body += "<doc docid=\"" + Escape(document.Attribute("docid")) +
+                         "\" cop=\"sign\" sigfrmt=\"" +
+                         Escape(document.Attribute("sigfrmt")) +
+                         "\" mdalgo=\"" +
+                         Escape(document.Attribute("mdalgo")) +
+                         "\"><params></params><result><p n=\"PRE\">" +
+                         RandomBase64(64) +
+                         "</p><p n=\"NEED_PRE\">true</p></result></doc>";
+      }
+      response.body += "</req>";
+    }
+    response.body += "</pres>";
+    return response;
+  }
+
+  Response Postsign(int user_index, User& user,
+                    const std::vector<Element>& elements) {
+    // Only the first request is answered, which is all the app sends.
+    for (size_t i = 0; i < elements.size(); ++i) {
+      if (elements[i].name != "req") {
+        continue;
+      }
+      std::string id = elements[i].Attribute("id");
+      int index = RequestIndex(user_index, id);
+      bool signed_ok = index >= 0 && elements[i].Attribute("status") == "OK";
+      size_t documents = 0;
+      size_t signatures = 0;
+      for (size_t j = i + 1; j < elements.size() && elements[j].name != "req";
+           ++j) {
+        documents += elements[j].name == "doc";
+        signatures += elements[j].name == "p" &&
+                      elements[j].Attribute("n") == "PK1" &&
+                      !elements[j].text.empty();
+      }
+      signed_ok = signed_ok && documents > 0 && signatures == documents;
+      if (signed_ok) {
+        std::lock_guard<std::mutex> lock(user.mutex);
+        State& state = user.states[static_cast<size_t>(index)];
+        signed_ok = state == kUnresolved;
+        state = signed_ok ? kSigned : state;
+      }
+      Response response;
+      response.body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><posts>"
+                      "<req id=\"" +
+                      Escape(id) + "\" status=\"" +
+                      (signed_ok ? "OK" : "KO") + "\"/></posts>";
+      return response;
+    }
+    return Error("ERR-02", "Petición de postfirma vacía");
+  }
+
+  // Approve (<r>) and reject (<rjct>): moves every listed request to |to|.
+  Response Resolve(int user_index, User& user,
+                   const std::vector<Element>& elements, const char* element,
+                   State to) {
+    bool reject = to == kRejected;
+    Response response;
+    response.body = reject ? "<rjcts>" : "<apprq>";
+    for (const Element& request : elements) {
+      if (request.name != element) {
+        continue;
+      }
+      std::string id = request.Attribute("id");
+      int index = RequestIndex(user_index, id);
+      bool ok = index >= 0 && (reject || IsApproval(index));
+      if (ok) {
+        std::lock_guard<std::mutex> lock(user.mutex);
+        State& state = user.states[static_cast<size_t>(index)];
+        ok = state == kUnresolved;
+        state = ok ? to : state;
+      }
+      response.body += std::string("<") + element + " id=\"" + Escape(id) +
+                       (reject ? "\" status=\"" : "\" ok=\"") +
+                       (ok ? "OK" : "KO") + "\"/>";
+    }
+    response.body += reject ? "</rjcts>" : "</apprq>";
+    return response;
+  }
+
+  Response Preview(int operation, const std::vector<Element>& elements) {
+    Response response;
+    std::string id = elements[0].Attribute("docid");
+    if (elements[0].name != "rqtprw" || id.empty()) {
+      return Error("ERR-02", "Falta el identificador del documento");
+    }
+    size_t size = static_cast<size_t>(config_.document_kb) * 1024;
+    if (operation == 8) {
+      response.content_type = "application/octet-stream";
+      response.body.assign(std::min<size_t>(size, 8 * 1024), '\x30');
+      return response;
+    }
+    response.content_type = "application/pdf";
+    response.body = "%PDF-1.4\n% " + id + (operation == 9 ? " informe" : "") +
+                    "\n";
+    response.body.resize(std::max(size, response.body.size() + 6), ' ');
+    response.body.replace(response.body.size() - 6, 6, "%%EOF\n");
+    return response;
+  }
+
+  const Config config_;
+  std::vector<std::unique_ptr<User>> users_;
+  std::mutex sessions_mutex_;
+  std::map<std::string, std::shared_ptr<Session>> sessions_;
+  std::atomic<int> next_session_{0};
+  std::mutex random_mutex_;
+  std::mt19937_64 random_{20220101};
+};
+
+std::string Lowercase(std::string text) {
+  for (char& c : text) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  return text;
+}
+
+// The value of |name| in a query string or form body.
+std::string FormValue(std::string_view form, std::string_view name) {
+  size_t start = 0;
+  while (start <= form.size()) {
+    size_t end = std::min(form.find('&', start), form.size());
+    std::string_view pair = form.substr(start, end - start);
+    if (pair.size() > name.size() && pair.substr(0, name.size()) == name &&
+        pair[name.size()] == '=') {
+      return std::string(pair.substr(name.size() + 1));
+    }
+    start = end + 1;
+  }
+  return std::string();
+}
+
+bool SendAll(int socket, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t result = send(socket, data.data() + sent, data.size() - sent,
+                          MSG_NOSIGNAL);
+    if (result <= 0) {
+      return false;
+    }
+    sent += static_cast<size_t>(result);
+  }
+  return true;
+}
+
+// Serves the requests of one connection until the client closes it.
+void Serve(Proxy* proxy, int socket) {
+  std::string buffer;
+  char chunk[64 * 1024];
+  bool open = true;
+  while (open) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+      if (received <= 0 || buffer.size() > (1 << 20)) {
+        close(socket);
+        return;
+      }
+      buffer.append(chunk, static_cast<size_t>(received));
+    }
+    std::string head = buffer.substr(0, header_end);
+    buffer.erase(0, header_end + 4);
+
+    size_t line_end = head.find("\r\n");
+    std::string request_line = head.substr(0, line_end);
+    std::map<std::string, std::string> headers;
+    size_t start = line_end;
+    while (start != std::string::npos && start < head.size()) {
+      start += 2;
+      size_t end = head.find("\r\n", start);
+      std::string line = head.substr(start, end - start);
+      size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        size_t value = line.find_first_not_of(' ', colon + 1);
+        headers[Lowercase(line.substr(0, colon))] =
+            value == std::string::npos ? "" : line.substr(value);
+      }
+      start = end;
+    }
+    size_t length = static_cast<size_t>(
+        std::strtoull(headers["content-length"].c_str(), nullptr, 10));
+    if (length > (64u << 20)) {
+      SendAll(socket, "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\n"
+                      "Connection: close\r\n\r\n");
+      break;
+    }
+    if (Lowercase(headers["expect"]) == "100-continue") {
+      SendAll(socket, "HTTP/1.1 100 Continue\r\n\r\n");
+    }
+    while (buffer.size() < length) {
+      ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+      if (received <= 0) {
+        close(socket);
+        return;
+      }
+      buffer.append(chunk, static_cast<size_t>(received));
+    }
+    std::string body = buffer.substr(0, length);
+    buffer.erase(0, length);
+    open = Lowercase(headers["connection"]) != "close";
+
+    // The previews come as a GET with the form in the query.
+    std::string form = body;
+    size_t query = request_line.find('?');
+    if (request_line.compare(0, 4, "GET ") == 0 && query != std::string::npos) {
+      size_t query_end = request_line.find(' ', query);
+      form = request_line.substr(query + 1, query_end - query - 1);
+    }
+    std::string operation_text = FormValue(form, "op");
+    char* end = nullptr;
+    long operation = std::strtol(operation_text.c_str(), &end, 10);
+    if (operation_text.empty() || *end != '\0') {
+      operation = -1;
+    }
+    std::string cookie = headers["cookie"];
+    size_t session = cookie.find("JSESSIONID=");
+    cookie = session == std::string::npos
+                 ? std::string()
+                 : cookie.substr(session + 11,
+                                 cookie.find(';', session) - session - 11);
+
+    std::string xml;
+    Response response;
+    if (operation < 0 || !DecodeData(FormValue(form, "dat"), &xml)) {
+      response.status = 400;
+    }
+    else {
+      response = proxy->Handle(static_cast<int>(operation), xml, cookie);
+    }
+    int latency = proxy->LatencyMs(static_cast<int>(operation));
+    if (latency > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+    }
+
+    const char* reason = response.status == 200   ? "OK"
+                         : response.status == 401 ? "Unauthorized"
+                                                  : "Bad Request";
+    std::string reply = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                        reason + "\r\nContent-Type: " + response.content_type +
+                        "\r\nContent-Length: " +
+                        std::to_string(response.body.size()) + "\r\n";
+    if (!response.set_cookie.empty()) {
+      reply += "Set-Cookie: " + response.set_cookie + "\r\n";
+    }
+    reply += open ? "\r\n" : "Connection: close\r\n\r\n";
+    reply += response.body;
+    if (!SendAll(socket, reply)) {
+      break;
+    }
+  }
+  close(socket);
+}
+
+bool ParseInt(const char* text, int* value) {
+  char* end = nullptr;
+  long parsed = std::strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || parsed < 0 || parsed > 1 << 24) {
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config config;
+  int latency_ms = 0;
+  std::vector<std::pair<int, int>> overrides;
+  bool ok = true;
+  for (int i = 1; i < argc && ok; i += 2) {
+    const char* flag = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      ok = false;
+    }
+    else if (std::strcmp(flag, "--port") == 0) {
+      ok = ParseInt(value, &config.port);
+    }
+    else if (std::strcmp(flag, "--users") == 0) {
+      ok = ParseInt(value, &config.users) && config.users > 0;
+    }
+    else if (std::strcmp(flag, "--requests") == 0) {
+      ok = ParseInt(value, &config.requests);
+    }
+    else if (std::strcmp(flag, "--documents") == 0) {
+      ok = ParseInt(value, &config.documents) && config.documents > 0;
+    }
+    else if (std::strcmp(flag, "--document-kb") == 0) {
+      ok = ParseInt(value, &config.document_kb);
+    }
+    else if (std::strcmp(flag, "--latency-ms") == 0) {
+      ok = ParseInt(value, &latency_ms);
+    }
+    else if (std::strcmp(flag, "--jitter-ms") == 0) {
+      ok = ParseInt(value, &config.jitter_ms);
+    }
+    else if (std::strcmp(flag, "--latency") == 0) {
+      int operation = -1;
+      int ms = -1;
+      ok = std::sscanf(value, "%d=%d", &operation, &ms) == 2 &&
+           operation >= 0 && operation < kOperations && ms >= 0;
+      overrides.emplace_back(operation, ms);
+    }
+    else {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    std::fprintf(stderr,
+                 "usage: %s [--port 8080] [--users 50] [--requests 1000]\n"
+                 "       [--documents 2] [--document-kb 64]\n"
+                 "       [--latency-ms 0] [--jitter-ms 0] "
+                 "[--latency OP=MS]...\n",
+                 argv[0]);
+    return 2;
+  }
+  for (int& latency : config.latency_ms) {
+    latency = latency_ms;
+  }
+  for (const auto& [operation, ms] : overrides) {
+    config.latency_ms[operation] = ms;
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(static_cast<uint16_t>(config.port));
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+          0 ||
+      listen(listener, 256) != 0) {
+    std::perror("proxy_standin");
+    return 1;
+  }
+  socklen_t address_size = sizeof(address);
+  if (getsockname(listener, reinterpret_cast<sockaddr*>(&address),
+                  &address_size) == 0) {
+    config.port = ntohs(address.sin_port);
+  }
+  std::fprintf(stderr,
+               "Serving %d users x %d requests on http://127.0.0.1:%d/\n",
+               config.users, config.requests, config.port);
+
+  Proxy proxy(config);
+  while (true) {
+    int connection = accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+      continue;
+    }
+    int no_delay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &no_delay,
+               sizeof(no_delay));
+    std::thread(Serve, &proxy, connection).detach();
+  }
+}
@@ -0,0 +1,244 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Measures the throughput of the queues that carry work between threads:
+// MpscQueue and MpscRing against a mutex-guarded deque, and the
+// PlatformDispatcher and WorkerPool built on them, with 1, 2, 4 and 8
+// producers:
+//
+//   queue_benchmark [messages]
+//
+// Each run moves |messages| items (2000000 by default) from the producers to
+// a single consumer, a tenth of them for the pool, and prints millions of
+// items per second, the median of three runs.
+#include <native_core/mpsc_queue.h>
+#include <native_core/mpsc_ring.h>
+#include <native_core/platform_dispatcher.h>
+#include <native_core/wakeup.h>
+#include <native_core/worker_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The baseline the lock-free queues replace.
+class LockedQueue {
+ public:
+  void Push(uint64_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    items_.push_back(value);
+  }
+
+  bool TryPop(uint64_t* value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.empty()) {
+      return false;
+    }
+    *value = items_.front();
+    items_.pop_front();
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<uint64_t> items_;
+};
+
+// Lets the consumer sleep between bursts, as the platform thread does.
+class SleepingWakeup : public native_core::Wakeup {
+ public:
+  void Signal() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    signalled_ = true;
+    changed_.notify_one();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait_for(lock, std::chrono::milliseconds(10),
+                      [this]() { return signalled_; });
+    signalled_ = false;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool signalled_ = false;
+};
+
+// Runs |producers| threads calling |produce(count)| while the calling
+// thread runs |consume(total)|, and returns the seconds it all took.
+double Run(int producers,
+           uint64_t messages,
+           const std::function<void(uint64_t)>& produce,
+           const std::function<void(uint64_t)>& consume) {
+  uint64_t per_producer = messages / static_cast<uint64_t>(producers);
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; i++) {
+    threads.emplace_back([&produce, per_producer]() { produce(per_producer); });
+  }
+  consume(per_producer * static_cast<uint64_t>(producers));
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Spins on |try_pop| until |total| items arrived.
+template <typename TryPop>
+void Spin(uint64_t total, TryPop try_pop) {
+  uint64_t value;
+  for (uint64_t received = 0; received < total;) {
+    if (try_pop(&value)) {
+      received++;
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+void Report(const char* name,
+            uint64_t messages,
+            const std::function<double(int)>& run) {
+  std::printf("%-20s", name);
+  for (int producers : {1, 2, 4, 8}) {
+    std::vector<double> rates;
+    for (int repeat = 0; repeat < 3; repeat++) {
+      rates.push_back(messages / run(producers) / 1e6);
+    }
+    std::printf(" %8.2f", Median(rates));
+  }
+  std::printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint64_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+  std::printf("M items/s, %llu items per run\n",
+              static_cast<unsigned long long>(messages));
+  std::printf("%-20s %8s %8s %8s %8s\n", "producers", "1", "2", "4", "8");
+
+  Report("locked deque", messages, [messages](int producers) {
+    LockedQueue queue;
+    return Run(
+        producers, messages,
+        [&queue](uint64_t count) {
+          for (uint64_t i = 0; i < count; i++) {
+            queue.Push(i);
+          }
+        },
+        [&queue](uint64_t total) {
+          Spin(total,
+               [&queue](uint64_t* value) { return queue.TryPop(value); });
+        });
+  });
+
+  Report("MpscQueue", messages, [messages](int producers) {
+    native_core::MpscQueue<uint64_t> queue;
+    return Run(
+        producers, messages,
+        [&queue](uint64_t count) {
+          for (uint64_t i = 0; i < count; i++) {
+            queue.Push(i);
+          }
+        },
+        [&queue](uint64_t total) {
+          Spin(total,
+               [&queue](uint64_t* value) { return queue.TryPop(value); });
+        });
+  });
+
+  Report("MpscRing(4096)", messages, [messages](int producers) {
+    native_core::MpscRing<uint64_t> ring(4096);
+    return Run(
+        producers, messages,
+        [&ring](uint64_t count) {
+          for (uint64_t i = 0; i < count; i++) {
+            uint64_t value = i;
+            while (!ring.TryPush(value)) {
+              std::this_thread::yield();
+            }
+          }
+        },
+        [&ring](uint64_t total) {
+          Spin(total, [&ring](uint64_t* value) { return ring.TryPop(value); });
+        });
+  });
+
+  // Completions as the plugins post them: a std::function per item, drained
+  // by a consumer that sleeps until woken.
+  Report("PlatformDispatcher", messages, [messages](int producers) {
+    SleepingWakeup wakeup;
+    native_core::PlatformDispatcher dispatcher(&wakeup);
+    uint64_t ran = 0;
+    return Run(
+        producers, messages,
+        [&dispatcher, &ran](uint64_t count) {
+          for (uint64_t i = 0; i < count; i++) {
+            dispatcher.Post([&ran]() { ran++; });
+          }
+        },
+        [&dispatcher, &wakeup, &ran](uint64_t total) {
+          while (ran < total) {
+            wakeup.Wait();
+            dispatcher.Drain();
+          }
+        });
+  });
+
+  // Tasks through the pool, the producers retrying while it is full; the
+  // consumers are the four workers. A tenth of the items, as each takes a
+  // lock and a wake-up.
+  uint64_t tasks = messages / 10;
+  Report("WorkerPool(4, 64)", tasks, [tasks](int producers) {
+    std::atomic<uint64_t> ran{0};
+    native_core::WorkerPool pool(4, 64);
+    return Run(
+        producers, tasks,
+        [&pool, &ran](uint64_t count) {
+          for (uint64_t i = 0; i < count; i++) {
+            while (!pool.TryPost(
+                [&ran]() { ran.fetch_add(1, std::memory_order_relaxed); })) {
+              std::this_thread::yield();
+            }
+          }
+        },
+        [&ran](uint64_t total) {
+          while (ran.load(std::memory_order_relaxed) < total) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+          }
+        });
+  });
+  return 0;
+}
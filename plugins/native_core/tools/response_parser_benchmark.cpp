@@ -0,0 +1,151 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the streaming response parsers on synthetic responses:
+//
+//   response_parser_benchmark [requests] [runs]
+//
+// Builds a request list and a presign response of |requests| requests (10000
+// by default), two documents each, and parses each of them |runs| times (20
+// by default) fed in 16 KiB chunks, as the HTTP client hands the body over.
+// Prints the latency percentiles and the throughput.
+//
+// integration_test/response_parsers_benchmark_test.dart builds the very same
+// responses and times the Dart parsers against these, end to end through the
+// plugin; keep both generators in step.
+#include <native_core/histogram.h>
+#include <native_core/proxy_response_parsers.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kChunkSize = 16 * 1024;
+
+const char* const kSenders[] = {
+    "José García Martínez", "María López Sánchez", "Ángel Pérez Gómez",
+    "Lucía Fernández Jiménez", "Íñigo Muñoz Álvarez", "Begoña Romero Ibáñez",
+};
+
+std::string RequestId(size_t i) { return "REQ" + std::to_string(1000000 + i); }
+
+std::string DocumentId(size_t i, int document) {
+  return "DOC" + std::to_string(1000000 + i) + "-" + std::to_string(document);
+}
+
+// A list of |count| requests as the proxy sends it.
+std::string BuildList(size_t count) {
+  std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><list n=\"" +
+                    std::to_string(count) + "\">";
+  for (size_t i = 0; i < count; i++) {
+    xml += "<rqt id=\"" + RequestId(i) + "\" priority=\"" +
+           std::to_string(1 + i % 3) +
+           "\" workflow=\"false\" forward=\"false\" type=\"" +
+           (i % 5 == 0 ? "VISTOBUENO" : "FIRMA") + "\">";
+    xml += "<subj>Resolución de contratación del expediente " +
+           std::to_string(i) + " &_lt;urgente&_gt;</subj>";
+    xml += std::string("<snder>") + kSenders[i % 6] + "</snder>";
+    xml += "<view>NUEVO</view><date>01/06/2022</date>"
+           "<expdate>30/06/2022</expdate><docs>";
+    for (int document = 1; document <= 2; document++) {
+      xml += "<doc docid=\"" + DocumentId(i, document) + "\"><nm>documento_" +
+             std::to_string(i) + "_" + std::to_string(document) +
+             ".pdf</nm><sz>" + std::to_string(12345 + i) +
+             "</sz><mmtp>application/pdf</mmtp><sigfrmt>PAdES</sigfrmt>"
+             "<mdalgo>SHA-256</mdalgo><params>null</params></doc>";
+    }
+    xml += "</docs></rqt>";
+  }
+  return xml + "</list>";
+}
+
+// A presign response for |count| requests, with a 512-byte PRE parameter
+// standing for the signed attributes.
+std::string BuildPresign(size_t count) {
+  const std::string pre(512, 'Q');
+  std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><pres>";
+  for (size_t i = 0; i < count; i++) {
+    xml += "<req id=\"" + RequestId(i) + "\" status=\"OK\">";
+    for (int document = 1; document <= 2; document++) {
+      xml += "<doc docid=\"" + DocumentId(i, document) +
+             "\" cop=\"firma\" sigfrmt=\"PAdES\" mdalgo=\"SHA-256\">"
+             "<params>bW9kZT1pbXBsaWNpdA==</params><result><p n=\"PRE\">" +
+             pre +
+             "</p><p n=\"NEED_PRE\">true</p>"
+             "<p n=\"TIME\">1654084800000</p></result></doc>";
+    }
+    xml += "</req>";
+  }
+  return xml + "</pres>";
+}
+
+// Parses |xml| |runs| times and prints how long it took. Returns the rows of
+// the first table, for the caller to check.
+size_t Measure(const char* name, native_core::ResponseKind kind,
+               const std::string& xml, size_t runs) {
+  native_core::DurationHistogram histogram;
+  size_t rows = 0;
+  for (size_t run = 0; run < runs; run++) {
+    Clock::time_point start = Clock::now();
+    std::unique_ptr<native_core::ResponseParser> parser =
+        native_core::CreateResponseParser(kind);
+    for (size_t offset = 0; offset < xml.size(); offset += kChunkSize) {
+      parser->Feed(xml.data() + offset,
+                   std::min(kChunkSize, xml.size() - offset));
+    }
+    parser->Finish();
+    histogram.Record(Clock::now() - start);
+    if (parser->has_syntax_error() || parser->has_error()) {
+      std::fprintf(stderr, "%s: %s%s\n", name,
+                   parser->syntax_error().c_str(), parser->error().c_str());
+      return 0;
+    }
+    rows = parser->tables()[0]->rows();
+  }
+  auto ms = [](std::chrono::nanoseconds duration) {
+    return duration.count() / 1e6;
+  };
+  double average = ms(histogram.total()) / static_cast<double>(runs);
+  std::printf("%-8s %6.1f MB  p50 %7.1f ms  p99 %7.1f ms  max %7.1f ms  "
+              "%6.0f MB/s\n",
+              name, xml.size() / 1e6, ms(histogram.Percentile(50)),
+              ms(histogram.Percentile(99)), ms(histogram.max()),
+              xml.size() / 1e6 / (average / 1e3));
+  return rows;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t request_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+  size_t runs = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+  if (runs == 0) {
+    runs = 1;
+  }
+
+  size_t list_rows = Measure("list", native_core::ResponseKind::kRequestList,
+                             BuildList(request_count), runs);
+  size_t presign_rows =
+      Measure("presign", native_core::ResponseKind::kPresign,
+              BuildPresign(request_count), runs);
+  // The list table has a single row; the presign one a row per request.
+  return list_rows == 1 && presign_rows == request_count ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures SearchIndex on a synthetic inbox.
+//
+//   search_index_benchmark [requests] [queries]
+//
+// Indexes |requests| requests (100000 by default) in pages of 50, as the app
+// does while the lists arrive, then runs |queries| queries (10000 by
+// default) of each kind and prints their latency percentiles.
+#include <native_core/histogram.h>
+#include <native_core/search_index.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Words of real request subjects, with the accents they are written with.
+const char* const kWords[] = {
+    "resolución", "contratación", "expediente", "subvención", "convocatoria",
+    "informe", "propuesta", "adjudicación", "licitación", "nómina",
+    "certificación", "anexo", "memoria", "justificación", "autorización",
+    "modificación", "presupuesto", "factura", "liquidación", "tramitación",
+    "servicios", "suministro", "obras", "mantenimiento", "limpieza",
+    "ayuntamiento", "consejería", "dirección", "general", "educación",
+    "sanidad", "hacienda", "función", "pública", "personal", "órgano",
+    "acuerdo", "decreto", "orden", "comisión", "evaluación", "ejecución",
+    "prórroga", "aprobación", "reconocimiento", "obligación", "pago",
+    "señalización", "año", "periodo", "España", "Cádiz", "Málaga", "León",
+};
+const char* const kFirstNames[] = {
+    "José", "María", "Ángel", "Lucía", "Íñigo", "Begoña", "Raúl", "Inés",
+    "Jesús", "Sofía", "Óscar", "Núria", "Álvaro", "Mónica", "Adrián",
+};
+const char* const kSurnames[] = {
+    "García", "Martínez", "López", "Sánchez", "Pérez", "Gómez", "Fernández",
+    "Jiménez", "Muñoz", "Álvarez", "Romero", "Ibáñez", "Peña", "Castaño",
+};
+
+template <typename T, size_t N>
+const char* Pick(T (&values)[N], std::mt19937* random) {
+  return values[(*random)() % N];
+}
+
+void Print(const char* name, const native_core::DurationHistogram& histogram,
+           double average_matches) {
+  auto us = [](std::chrono::nanoseconds duration) {
+    return duration.count() / 1000.0;
+  };
+  std::printf("%-22s p50 %8.1f us  p99 %8.1f us  max %8.1f us  (%.0f matches)\n",
+              name, us(histogram.Percentile(50)), us(histogram.Percentile(99)),
+              us(histogram.max()), average_matches);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t request_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  size_t query_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10000;
+  const char* const states[] = {"unresolved", "signed", "rejected"};
+  std::mt19937 random(42);
+
+  native_core::SearchIndex index;
+  Clock::time_point start = Clock::now();
+  std::vector<std::string> texts(4);
+  std::vector<std::string_view> views;
+  for (size_t i = 0; i < request_count; i++) {
+    std::string id = "REQ" + std::to_string(1000000 + i);
+    texts[0].clear();
+    for (int word = 0; word < 6; word++) {
+      texts[0].append(Pick(kWords, &random)).append(" ");
+    }
+    texts[0].append(std::to_string(random() % 100000));
+    texts[1] = std::string(Pick(kFirstNames, &random)) + " " +
+               Pick(kSurnames, &random) + " " + Pick(kSurnames, &random);
+    texts[2] = std::string(Pick(kWords, &random)) + "_" +
+               std::to_string(i) + ".pdf";
+    texts[3] = std::string(Pick(kWords, &random)) + " firmado.pdf";
+    views.assign({id, texts[0], texts[1], texts[2], texts[3]});
+    index.Add(id, states[i % 3], views);
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  native_core::SearchIndexStats stats = index.stats();
+  std::printf("indexed %zu requests in %.2f s: %zu terms, %zu postings\n",
+              stats.requests, seconds, stats.terms, stats.postings);
+
+  // Queries as typed, one more character at a time, unaccented and in
+  // capitals as often as not.
+  struct Kind {
+    const char* name;
+    size_t prefix;
+    bool two_words;
+    bool state;
+  };
+  const Kind kinds[] = {
+      {"1-char prefix", 1, false, false},
+      {"3-char prefix", 3, false, false},
+      {"whole word", 99, false, false},
+      {"two words", 4, true, false},
+      {"two words in state", 4, true, true},
+      // Typing a request id: every id shares the first few characters.
+      {"id prefix", 6, false, false},
+  };
+  size_t sink = 0;
+  for (const Kind& kind : kinds) {
+    native_core::DurationHistogram histogram;
+    size_t matches = 0;
+    for (size_t i = 0; i < query_count; i++) {
+      std::string word = kind.prefix == 6
+          ? "req" + std::to_string(1000000 + random() % request_count)
+          : native_core::FoldForSearch(Pick(kWords, &random));
+      std::string query = word.substr(0, kind.prefix);
+      if (kind.two_words) {
+        query.append(" ").append(Pick(kSurnames, &random));
+      }
+      if (i % 2) {
+        for (char& c : query) {
+          if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+          }
+        }
+      }
+      Clock::time_point query_start = Clock::now();
+      native_core::SearchResult result =
+          index.Query(query, kind.state ? states[i % 3] : "", 50);
+      histogram.Record(Clock::now() - query_start);
+      matches += result.total;
+      sink += result.ids.size();
+    }
+    Print(kind.name, histogram,
+          static_cast<double>(matches) / static_cast<double>(query_count));
+  }
+  return sink == 0 ? 1 : 0;
+}
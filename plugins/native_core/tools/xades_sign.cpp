@@ -0,0 +1,129 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Signs an XML file with SignXml() and reports how long it took and how much
+// memory it needed, for checking the output with other tools and measuring
+// large documents:
+//
+//   xades_sign key.pem input.xml output.xml [SHA-256] [--detached URI]
+//       [--signing-time SECONDS]
+//   xades_sign --generate megabytes output.xml
+//
+// key.pem holds the RSA private key followed by its certificate. Without
+// --detached the signature is enveloped in the document. With a signing
+// time, in seconds since the epoch, the output is reproducible:
+// tests/data/xades holds signatures made this way, and
+// tests/xades_verify.py checks them with xmlsec1. The second form
+// writes a synthetic document of about |megabytes| MB to sign, with
+// namespaces, attributes and escaped text in every record.
+#include <native_core/file_key_signer.h>
+#include <native_core/xades_signer.h>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+
+namespace {
+
+bool Generate(const char* path, unsigned long long megabytes) {
+  std::FILE* file = std::fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  unsigned long long total = megabytes << 20;
+  unsigned long long position = 0;
+  auto write = [&](const std::string& text) {
+    std::fwrite(text.data(), 1, text.size(), file);
+    position += text.size();
+  };
+  write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<lote xmlns=\"urn:example:lote\" "
+        "xmlns:m=\"urn:example:meta\" version=\"1\">\n");
+  for (unsigned long long i = 0; position < total; ++i) {
+    std::string n = std::to_string(i);
+    write("  <registro id=\"r" + n + "\" m:estado='pendiente' fecha=\"2022-"
+          "06-01\">\r\n    <m:titular nif=\"0000" + n + "X\">Pérez &amp; "
+          "Hijos, S.L.</m:titular>\r\n    <importe moneda=\"EUR\">" + n +
+          ".50</importe>\r\n    <nota><![CDATA[<sin escapar> & ok]]></nota>"
+          "<vacio/>\r\n  </registro>\n");
+  }
+  write("</lote>\n");
+  return std::fclose(file) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc >= 4 && std::strcmp(argv[1], "--generate") == 0) {
+    if (!Generate(argv[3], std::strtoull(argv[2], nullptr, 10))) {
+      std::fprintf(stderr, "Cannot write %s\n", argv[3]);
+      return 1;
+    }
+    return 0;
+  }
+  if (argc < 4) {
+    std::fprintf(stderr,
+                 "usage: %s key.pem input.xml output.xml [digest] "
+                 "[--detached URI] [--signing-time SECONDS]\n"
+                 "       %s --generate megabytes output.xml\n",
+                 argv[0], argv[0]);
+    return 2;
+  }
+  native_core::XadesOptions options;
+  for (int i = 4; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--detached") == 0 && i + 1 < argc) {
+      options.packaging = native_core::XadesOptions::Packaging::kDetached;
+      options.detached_uri = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--signing-time") == 0 && i + 1 < argc) {
+      options.signing_time = std::chrono::system_clock::from_time_t(
+          static_cast<std::time_t>(std::strtoll(argv[++i], nullptr, 10)));
+    }
+    else {
+      options.digest = native_core::DigestAlgorithmFor(argv[i]);
+    }
+  }
+
+  std::string error;
+  std::unique_ptr<native_core::FileKeySigner> signer =
+      native_core::FileKeySigner::Open(argv[1], &error);
+  if (!signer) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  native_core::XadesResult result;
+  if (!native_core::SignXml(signer.get(), argv[2], argv[3], options, &result,
+                            &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  std::printf(
+      "signed %llu bytes in %.2f s (%.0f MB/s), %zu-byte signature, "
+      "peak RSS %ld KB\n",
+      static_cast<unsigned long long>(result.input_size), seconds,
+      result.input_size / seconds / (1 << 20), result.signature_size,
+      usage.ru_maxrss);
+  return 0;
+}
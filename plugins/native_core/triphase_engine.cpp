@@ -0,0 +1,710 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/triphase_engine.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "include/native_core/proxy_response_parsers.h"
+#include "include/native_core/response_parser.h"
+#include "include/native_core/signing_journal.h"
+#include "include/native_core/xml_request_builder.h"
+
+namespace native_core {
+
+namespace {
+
+// Api.operationPresign and Api.operationPostsign.
+constexpr std::string_view kPresignOperation = "0";
+constexpr std::string_view kPostsignOperation = "1";
+
+// TriphaseSignRequestDocument.defaultAlgorithm.
+constexpr std::string_view kDefaultDigestAlgorithm = "SHA-512";
+
+// TriphaseConfigData keys.
+constexpr std::string_view kPreSignKey = "PRE";
+constexpr std::string_view kNeedPreSignKey = "NEED_PRE";
+constexpr std::string_view kPkcs1Key = "PK1";
+
+constexpr char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// base64.encode() in Dart.
+std::string Base64Encode(const std::vector<uint8_t>& data) {
+  std::string encoded;
+  encoded.reserve((data.size() + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 3 <= data.size(); i += 3) {
+    uint32_t bits = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) |
+                    data[i + 2];
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += kAlphabet[(bits >> 6) & 0x3F];
+    encoded += kAlphabet[bits & 0x3F];
+  }
+  size_t remainder = data.size() - i;
+  if (remainder > 0) {
+    uint32_t bits = uint32_t{data[i]} << 16;
+    if (remainder == 2) {
+      bits |= uint32_t{data[i + 1]} << 8;
+    }
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += remainder == 2 ? kAlphabet[(bits >> 6) & 0x3F] : '=';
+    encoded += '=';
+  }
+  return encoded;
+}
+
+int Base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+' || c == '-') return 62;
+  if (c == '/' || c == '_') return 63;
+  return -1;
+}
+
+// base64.decode() in Dart: either alphabet, padding written as '=' or "%3D",
+// and a length that is a multiple of four once the padding is counted.
+bool Base64Decode(std::string_view encoded, std::vector<uint8_t>* data) {
+  data->clear();
+  data->reserve(encoded.size() / 4 * 3);
+  uint32_t bits = 0;
+  size_t count = 0;
+  size_t padding = 0;
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    if (encoded[i] == '=' || encoded.compare(i, 3, "%3D") == 0) {
+      if (encoded[i] == '%') {
+        i += 2;
+      }
+      ++padding;
+      continue;
+    }
+    int value = Base64Value(encoded[i]);
+    if (value < 0 || padding > 0) {
+      return false;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    if (++count % 4 == 0) {
+      data->push_back(static_cast<uint8_t>(bits >> 16));
+      data->push_back(static_cast<uint8_t>(bits >> 8));
+      data->push_back(static_cast<uint8_t>(bits));
+      bits = 0;
+    }
+  }
+  size_t tail = count % 4;
+  if (tail == 1 || (count + padding) % 4 != 0 ||
+      (padding > 0 && tail + padding != 4)) {
+    return false;
+  }
+  if (tail >= 2) {
+    bits <<= 6 * (4 - tail);
+    data->push_back(static_cast<uint8_t>(bits >> 16));
+    if (tail == 3) {
+      data->push_back(static_cast<uint8_t>(bits >> 8));
+    }
+  }
+  return true;
+}
+
+std::string ToLowerAscii(std::string_view value) {
+  std::string lower(value);
+  for (char& c : lower) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  return lower;
+}
+
+// TriphaseConfigData: a map that keeps insertion order.
+class ConfigData {
+ public:
+  const std::string* Find(std::string_view key) const {
+    for (const auto& [name, value] : entries_) {
+      if (name == key) {
+        return &value;
+      }
+    }
+    return nullptr;
+  }
+
+  void Set(std::string_view key, std::string value) {
+    for (auto& entry : entries_) {
+      if (entry.first == key) {
+        entry.second = std::move(value);
+        return;
+      }
+    }
+    entries_.emplace_back(std::string(key), std::move(value));
+  }
+
+  void Remove(std::string_view key) {
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [&](const auto& entry) {
+                                    return entry.first == key;
+                                  }),
+                   entries_.end());
+  }
+
+  const std::vector<std::pair<std::string, std::string>>& entries() const {
+    return entries_;
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>> entries_;
+};
+
+// TriphaseSignRequestDocument.
+struct PresignedDocument {
+  std::optional<std::string> id;
+  std::optional<std::string> crypto_operation;
+  std::optional<std::string> signature_format;
+  std::string message_digest_algorithm;
+  std::optional<std::string> params;
+  ConfigData config;
+};
+
+// TriphaseRequest.
+struct PresignedRequest {
+  std::string ref;
+  bool status_ok = true;
+  std::string exception;
+  std::vector<PresignedDocument> documents;
+};
+
+// A request between phases. |requests| is the presign response, which is
+// signed in place and sent back as the postsign request.
+struct Slot {
+  bool ready = false;
+  // Set when the request already has its outcome.
+  std::optional<TriphaseOutcome> outcome;
+  std::vector<PresignedRequest> requests;
+};
+
+std::optional<std::string> OptionalString(const StringTable& strings,
+                                          int32_t index) {
+  if (index == StringTable::kNull) {
+    return std::nullopt;
+  }
+  int32_t start = index == 0 ? 0 : strings.ends()[index - 1];
+  return strings.bytes().substr(start, strings.ends()[index] - start);
+}
+
+const RecordTable* TableNamed(const ResponseParser& parser,
+                              std::string_view name) {
+  for (const auto& table : parser.tables()) {
+    if (table->name() == name) {
+      return table.get();
+    }
+  }
+  return nullptr;
+}
+
+// Posts |body| and parses the response with |parser|. Returns kNone, or the
+// failure Api reports for this response. |http_error| is how statuses other
+// than 200 and 401 end: a NetworkException in _getParsedResponse (the
+// presign), a parse error of the empty body in _getResponseBody (the
+// postsign). The HTTP status is stored in |http_status| if given.
+TriphaseFailure Exchange(TriphaseTransport* transport,
+                         const std::vector<uint8_t>& body,
+                         ResponseParser* parser,
+                         TriphaseFailure http_error,
+                         std::string* detail,
+                         int* http_status = nullptr) {
+  int status = transport->Post(body, [parser](const char* data, size_t size) {
+    parser->Feed(data, size);
+  });
+  if (http_status) {
+    *http_status = status;
+  }
+  if (status == 0) {
+    *detail = "Sin respuesta del servidor";
+    return TriphaseFailure::kNetwork;
+  }
+  if (status == 401) {
+    *detail = "UnauthorizedException";
+    return TriphaseFailure::kError;
+  }
+  if (status != 200) {
+    *detail = "HTTP " + std::to_string(status);
+    return http_error;
+  }
+  parser->Finish();
+  if (parser->has_proxy_error()) {
+    *detail = parser->proxy_error();
+    return TriphaseFailure::kError;
+  }
+  if (parser->has_syntax_error()) {
+    *detail = parser->syntax_error();
+    return TriphaseFailure::kNetwork;
+  }
+  if (parser->has_error()) {
+    *detail = parser->error();
+    return TriphaseFailure::kError;
+  }
+  return TriphaseFailure::kNone;
+}
+
+// NativeResponseParsers.presign().
+std::vector<PresignedRequest> ReadPresign(const ResponseParser& parser) {
+  const StringTable& strings = parser.strings();
+  const RecordTable* requests = TableNamed(parser, "requests");
+  const RecordTable* documents = TableNamed(parser, "docs");
+  const RecordTable* params = TableNamed(parser, "params");
+  const int32_t* request_cells = requests->cells().data();
+  const int32_t* document_cells = documents->cells().data();
+  const int32_t* param_cells = params->cells().data();
+
+  std::vector<PresignedRequest> presigned(requests->rows());
+  for (size_t i = 0; i < presigned.size(); ++i) {
+    using namespace presign;
+    const int32_t* request = request_cells + i * kRequestStride;
+    PresignedRequest& target = presigned[i];
+    target.ref = OptionalString(strings, request[kReference]).value_or("");
+    target.status_ok = request[kStatusOk] == 1;
+    target.exception = OptionalString(strings, request[kException]).value_or("");
+    if (!target.status_ok) {
+      continue;
+    }
+    for (int32_t d = request[kFirstDocument];
+         d < request[kFirstDocument] + request[kDocumentCount]; ++d) {
+      const int32_t* document = document_cells + d * kDocumentStride;
+      PresignedDocument& doc = target.documents.emplace_back();
+      doc.id = OptionalString(strings, document[kDocumentId]);
+      doc.crypto_operation = OptionalString(strings, document[kCryptoOperation]);
+      doc.signature_format = OptionalString(strings, document[kSignatureFormat]);
+      doc.message_digest_algorithm =
+          OptionalString(strings, document[kMessageDigestAlgorithm])
+              .value_or(std::string(kDefaultDigestAlgorithm));
+      doc.params = OptionalString(strings, document[kParams]);
+      for (int32_t p = document[kFirstParam];
+           p < document[kFirstParam] + document[kParamCount]; ++p) {
+        const int32_t* param = param_cells + p * kParamStride;
+        doc.config.Set(*OptionalString(strings, param[kKey]),
+                       *OptionalString(strings, param[kValue]));
+      }
+    }
+  }
+  return presigned;
+}
+
+std::optional<std::string_view> View(const std::optional<std::string>& value) {
+  return value ? std::optional<std::string_view>(*value) : std::nullopt;
+}
+
+// The postsign request for the signed presign response |requests|.
+std::vector<uint8_t> PostsignBody(
+    const std::vector<PresignedRequest>& requests) {
+  std::vector<PostsignRequest> views(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    views[i].ref = requests[i].ref;
+    views[i].status_ok = requests[i].status_ok;
+    for (const PresignedDocument& document : requests[i].documents) {
+      PostsignDocument& view = views[i].documents.emplace_back();
+      view.id = View(document.id);
+      view.crypto_operation = View(document.crypto_operation);
+      view.signature_format = View(document.signature_format);
+      view.message_digest_algorithm = document.message_digest_algorithm;
+      view.params = View(document.params);
+      for (const auto& [key, value] : document.config.entries()) {
+        view.result.emplace_back(key, value);
+      }
+    }
+  }
+  return BuildPostsignBody(kPostsignOperation, views);
+}
+
+// TriSigner.signPhase3(), for the request |request_id| at |index|. Once the
+// proxy has answered, OK, KO or with an error of its own, the request is
+// marked as posted in |journal| if given. It stays pending if the response
+// was lost, was not a 200 (an expired session, a server error) or did not
+// parse, e.g. a truncated body, since the proxy may not have stored the
+// signature.
+TriphaseOutcome Postsign(TriphaseTransport* transport,
+                         const std::vector<uint8_t>& body,
+                         size_t index,
+                         const std::string& request_id,
+                         SigningJournal* journal,
+                         const std::string& journal_owner) {
+  std::unique_ptr<ResponseParser> parser =
+      CreateResponseParser(ResponseKind::kPostsign);
+  TriphaseOutcome outcome;
+  outcome.index = index;
+  int status = 0;
+  outcome.failure = Exchange(transport, body, parser.get(),
+                             TriphaseFailure::kError, &outcome.detail, &status);
+  // An <err> also fails the content checks of the postsign parser.
+  bool answered = status == 200 && !parser->has_syntax_error() &&
+                  (!parser->has_error() || parser->has_proxy_error());
+  if (journal && answered) {
+    journal->RecordPosted(journal_owner, request_id);
+  }
+  if (outcome.failure != TriphaseFailure::kNone) {
+    outcome.id = request_id;
+    return outcome;
+  }
+  const int32_t* result = TableNamed(*parser, "result")->cells().data();
+  outcome.id = OptionalString(parser->strings(),
+                              result[postsign::kReference]).value_or("");
+  outcome.status_ok = result[postsign::kStatusOk] == 1;
+  return outcome;
+}
+
+// The state of one Run(), shared by its threads.
+class Batch {
+ public:
+  Batch(TriphaseTransport* transport,
+        Pkcs1Signer* signer,
+        const TriphaseOptions& options,
+        const std::vector<TriphaseJob>& jobs,
+        const TriphaseEngine::OutcomeCallback& on_outcome,
+        CancellationToken token)
+      : transport_(transport),
+        signer_(signer),
+        presign_window_(std::max<size_t>(options.presign_window, 1)),
+        postsign_window_(std::max<size_t>(options.postsign_window, 1)),
+        journal_(options.journal),
+        journal_owner_(options.journal_owner),
+        jobs_(jobs),
+        on_outcome_(on_outcome),
+        token_(std::move(token)),
+        slots_(jobs.size()) {}
+
+  void Run() {
+    std::vector<std::thread> threads;
+    size_t presigners = std::min(presign_window_, jobs_.size());
+    size_t postsigners = std::min(postsign_window_, jobs_.size());
+    for (size_t i = 0; i < presigners; ++i) {
+      threads.emplace_back([this]() { PresignLoop(); });
+    }
+    for (size_t i = 0; i < postsigners; ++i) {
+      threads.emplace_back([this]() { PostsignLoop(); });
+    }
+    SignLoop();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  // Presigns requests in order, no further than |presign_window_| ahead of
+  // the one being signed.
+  void PresignLoop() {
+    while (true) {
+      size_t index;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        presign_allowed_.wait(lock, [this]() {
+          return next_presign_ >= jobs_.size() ||
+                 next_presign_ < signing_ + presign_window_;
+        });
+        if (next_presign_ >= jobs_.size()) {
+          return;
+        }
+        index = next_presign_++;
+      }
+      Slot slot = Presign(index);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[index] = std::move(slot);
+        slots_[index].ready = true;
+      }
+      presigned_.notify_all();
+    }
+  }
+
+  // Signs the presigned requests in batch order, journals them and queues
+  // them for the postsign.
+  void SignLoop() {
+    for (size_t index = 0; index < jobs_.size(); ++index) {
+      Slot slot;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        presigned_.wait(lock, [&]() { return slots_[index].ready; });
+        slot = std::move(slots_[index]);
+      }
+      if (!slot.outcome) {
+        Sign(index, &slot);
+      }
+      if (slot.outcome) {
+        Emit(*slot.outcome);
+      }
+      else {
+        std::vector<uint8_t> body = PostsignBody(slot.requests);
+        // Without the record the request is still postsigned, it just
+        // cannot be resumed.
+        if (journal_) {
+          journal_->RecordSigned(journal_owner_, jobs_[index].id, body);
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        postsign_space_.wait(
+            lock, [this]() { return postsign_queue_.size() < postsign_window_; });
+        postsign_queue_.emplace_back(index, std::move(body));
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        signing_ = index + 1;
+      }
+      presign_allowed_.notify_all();
+      postsign_available_.notify_all();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      signing_done_ = true;
+    }
+    postsign_available_.notify_all();
+  }
+
+  void PostsignLoop() {
+    while (true) {
+      std::pair<size_t, std::vector<uint8_t>> item;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        postsign_available_.wait(lock, [this]() {
+          return !postsign_queue_.empty() || signing_done_;
+        });
+        if (postsign_queue_.empty()) {
+          return;
+        }
+        item = std::move(postsign_queue_.front());
+        postsign_queue_.pop_front();
+      }
+      postsign_space_.notify_one();
+      Emit(Postsign(transport_, item.second, item.first, jobs_[item.first].id,
+                    journal_, journal_owner_));
+    }
+  }
+
+  // TriSigner.signPhase1().
+  Slot Presign(size_t index) {
+    const TriphaseJob& job = jobs_[index];
+    Slot slot;
+    if (token_.IsCancelled()) {
+      slot.outcome = Failure(index, TriphaseFailure::kCancelled, "");
+      return slot;
+    }
+
+    std::vector<PresignDocument> documents;
+    if (job.documents) {
+      for (const TriphaseDocument& document : *job.documents) {
+        documents.push_back({document.id, View(document.crypto_operation),
+                             document.signature_format,
+                             document.message_digest_algorithm,
+                             View(document.params)});
+      }
+    }
+    std::vector<uint8_t> body = BuildPresignBody(
+        kPresignOperation, job.id, job.documents ? &documents : nullptr);
+
+    std::unique_ptr<ResponseParser> parser =
+        CreateResponseParser(ResponseKind::kPresign);
+    std::string detail;
+    TriphaseFailure failure = Exchange(transport_, body, parser.get(),
+                                       TriphaseFailure::kNetwork, &detail);
+    if (failure != TriphaseFailure::kNone) {
+      slot.outcome = Failure(index, failure, std::move(detail));
+      return slot;
+    }
+    slot.requests = ReadPresign(*parser);
+    return slot;
+  }
+
+  // The signing loop of TriSigner.doSign(). Sets |slot|->outcome on failure.
+  void Sign(size_t index, Slot* slot) {
+    if (token_.IsCancelled()) {
+      slot->outcome = Failure(index, TriphaseFailure::kCancelled, "");
+      return;
+    }
+    for (PresignedRequest& request : slot->requests) {
+      if (!request.status_ok) {
+        slot->outcome =
+            Failure(index, TriphaseFailure::kPresign, request.exception);
+        return;
+      }
+      for (PresignedDocument& document : request.documents) {
+        std::string detail;
+        TriphaseFailure failure = SignDocument(&document, &detail);
+        if (failure != TriphaseFailure::kNone) {
+          slot->outcome = Failure(index, failure, std::move(detail));
+          return;
+        }
+      }
+    }
+  }
+
+  // TriSigner.signPhase2().
+  TriphaseFailure SignDocument(PresignedDocument* document,
+                               std::string* detail) {
+    // getPreSign() on a missing value fails outside the Exception handlers.
+    const std::string* pre_sign = document->config.Find(kPreSignKey);
+    if (!pre_sign) {
+      *detail = "Sin prefirma";
+      return TriphaseFailure::kError;
+    }
+    std::vector<uint8_t> data;
+    if (!Base64Decode(*pre_sign, &data)) {
+      *detail = "El servidor no ha devuelto la prefirma del documento";
+      return TriphaseFailure::kSignature;
+    }
+
+    std::string algorithm = document->message_digest_algorithm;
+    algorithm.erase(std::remove(algorithm.begin(), algorithm.end(), '-'),
+                    algorithm.end());
+    algorithm += "withRSA";
+    std::vector<uint8_t> signature;
+    if (!signer_->Sign(algorithm, data.data(), data.size(), &signature,
+                       detail)) {
+      return TriphaseFailure::kSignature;
+    }
+
+    document->config.Set(kPkcs1Key, Base64Encode(signature));
+    const std::string* need_pre_sign = document->config.Find(kNeedPreSignKey);
+    if (!need_pre_sign || ToLowerAscii(*need_pre_sign) != "true") {
+      document->config.Remove(kPreSignKey);
+    }
+    return TriphaseFailure::kNone;
+  }
+
+  TriphaseOutcome Failure(size_t index,
+                          TriphaseFailure failure,
+                          std::string detail) const {
+    TriphaseOutcome outcome;
+    outcome.index = index;
+    outcome.id = jobs_[index].id;
+    outcome.status_ok = false;
+    outcome.failure = failure;
+    outcome.detail = std::move(detail);
+    return outcome;
+  }
+
+  void Emit(const TriphaseOutcome& outcome) {
+    std::lock_guard<std::mutex> lock(emit_mutex_);
+    on_outcome_(outcome);
+  }
+
+  TriphaseTransport* transport_;
+  Pkcs1Signer* signer_;
+  const size_t presign_window_;
+  const size_t postsign_window_;
+  SigningJournal* const journal_;
+  const std::string journal_owner_;
+  const std::vector<TriphaseJob>& jobs_;
+  const TriphaseEngine::OutcomeCallback& on_outcome_;
+  const CancellationToken token_;
+
+  std::mutex mutex_;
+  std::condition_variable presign_allowed_;
+  std::condition_variable presigned_;
+  std::condition_variable postsign_available_;
+  std::condition_variable postsign_space_;
+  std::vector<Slot> slots_;
+  size_t next_presign_ = 0;
+  // Index of the request being signed; everything before it is done.
+  size_t signing_ = 0;
+  // Postsign bodies by request index.
+  std::deque<std::pair<size_t, std::vector<uint8_t>>> postsign_queue_;
+  bool signing_done_ = false;
+
+  std::mutex emit_mutex_;
+};
+
+}  // namespace
+
+TriphaseTransport::~TriphaseTransport() = default;
+
+HttpTriphaseTransport::HttpTriphaseTransport(HttpClient* client,
+                                             std::string url,
+                                             const std::string& cookie)
+    : client_(client),
+      url_(std::move(url)),
+      headers_{
+          {"Accept", "application/xml"},
+          {"Content-Type",
+           "application/x-www-form-urlencoded; charset=utf-8"},
+      } {
+  if (!cookie.empty()) {
+    headers_.emplace_back("Cookie", cookie);
+  }
+}
+
+int HttpTriphaseTransport::Post(const std::vector<uint8_t>& body,
+                                const Sink& sink) {
+  return client_->Post(url_, headers_, body, sink).status;
+}
+
+TriphaseEngine::TriphaseEngine(TriphaseTransport* transport,
+                               Pkcs1Signer* signer,
+                               TriphaseOptions options)
+    : transport_(transport), signer_(signer), options_(options) {}
+
+void TriphaseEngine::Run(const std::vector<TriphaseJob>& jobs,
+                         const OutcomeCallback& on_outcome,
+                         CancellationToken token) {
+  Batch batch(transport_, signer_, options_, jobs, on_outcome,
+              std::move(token));
+  batch.Run();
+}
+
+void TriphaseEngine::Resume(const std::vector<JournaledPostsign>& postsigns,
+                            const OutcomeCallback& on_outcome,
+                            CancellationToken token) {
+  std::mutex mutex;
+  size_t next = 0;
+  auto postsign_loop = [&]() {
+    while (true) {
+      size_t index;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (next >= postsigns.size()) {
+          return;
+        }
+        index = next++;
+      }
+      const JournaledPostsign& postsign = postsigns[index];
+      TriphaseOutcome outcome;
+      if (token.IsCancelled()) {
+        outcome.index = index;
+        outcome.id = postsign.request_id;
+        outcome.failure = TriphaseFailure::kCancelled;
+      }
+      else {
+        outcome = Postsign(transport_, postsign.body, index,
+                           postsign.request_id, options_.journal,
+                           options_.journal_owner);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      on_outcome(outcome);
+    }
+  };
+  std::vector<std::thread> threads;
+  size_t postsigners = std::min(std::max<size_t>(options_.postsign_window, 1),
+                                postsigns.size());
+  for (size_t i = 1; i < postsigners; ++i) {
+    threads.emplace_back(postsign_loop);
+  }
+  postsign_loop();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace native_core
@@ -0,0 +1,251 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/winhttp_client.h"
+
+#include <windows.h>
+
+#include <winhttp.h>
+
+#include <algorithm>
+#include <cwctype>
+#include <string_view>
+#include <utility>
+
+#pragma comment(lib, "winhttp.lib")
+
+namespace native_core {
+
+namespace {
+
+// Response bodies are read in chunks of this size.
+constexpr DWORD kReadSize = 64 * 1024;
+
+std::wstring Widen(std::string_view value) {
+  if (value.empty()) {
+    return std::wstring();
+  }
+  int length = MultiByteToWideChar(CP_UTF8, 0, value.data(),
+                                   static_cast<int>(value.size()), NULL, 0);
+  std::wstring wide(length, 0);
+  MultiByteToWideChar(CP_UTF8, 0, value.data(), static_cast<int>(value.size()),
+                      wide.data(), length);
+  return wide;
+}
+
+std::string Narrow(std::wstring_view value) {
+  if (value.empty()) {
+    return std::string();
+  }
+  int length = WideCharToMultiByte(CP_UTF8, 0, value.data(),
+                                   static_cast<int>(value.size()), NULL, 0,
+                                   NULL, NULL);
+  std::string narrow(length, 0);
+  WideCharToMultiByte(CP_UTF8, 0, value.data(), static_cast<int>(value.size()),
+                      narrow.data(), length, NULL, NULL);
+  return narrow;
+}
+
+// Splits the raw response headers into lowercased names and values, skipping
+// the status line.
+void ReadHeaders(HINTERNET request, HttpHeaders* headers) {
+  DWORD size = 0;
+  WinHttpQueryHeaders(request, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                      WINHTTP_HEADER_NAME_BY_INDEX, NULL, &size,
+                      WINHTTP_NO_HEADER_INDEX);
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    return;
+  }
+  std::wstring raw(size / sizeof(wchar_t), 0);
+  if (!WinHttpQueryHeaders(request, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                           WINHTTP_HEADER_NAME_BY_INDEX, raw.data(), &size,
+                           WINHTTP_NO_HEADER_INDEX)) {
+    return;
+  }
+  raw.resize(size / sizeof(wchar_t));
+
+  std::wstring_view rest(raw);
+  bool status_line = true;
+  while (!rest.empty()) {
+    size_t end = rest.find(L"\r\n");
+    std::wstring_view line = rest.substr(0, end);
+    rest.remove_prefix(end == std::wstring_view::npos ? rest.size() : end + 2);
+    size_t colon = line.find(L':');
+    if (status_line || colon == std::wstring_view::npos) {
+      status_line = false;
+      continue;
+    }
+    std::wstring name(line.substr(0, colon));
+    std::transform(name.begin(), name.end(), name.begin(), [](wchar_t c) {
+      return static_cast<wchar_t>(std::towlower(c));
+    });
+    std::wstring_view value = line.substr(colon + 1);
+    while (!value.empty() && (value.front() == L' ' || value.front() == L'\t')) {
+      value.remove_prefix(1);
+    }
+    headers->emplace_back(Narrow(name), Narrow(value));
+  }
+}
+
+}  // namespace
+
+WinHttpClient::WinHttpClient(HttpClientOptions options)
+    : HttpClient(std::move(options)) {
+  HINTERNET session =
+      WinHttpOpen(L"portafirmas", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
+                  WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+  if (!session) {
+    return;
+  }
+  DWORD connections = static_cast<DWORD>(
+      std::max<size_t>(this->options().max_connections_per_host, 1));
+  WinHttpSetOption(session, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &connections,
+                   sizeof(connections));
+  WinHttpSetOption(session, WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER,
+                   &connections, sizeof(connections));
+#if !defined(NATIVE_CORE_HAS_ZLIB) && defined(WINHTTP_OPTION_DECOMPRESSION)
+  // Without zlib in the build, WinHTTP negotiates gzip and deflate and
+  // decodes them itself (Windows 8.1 and later).
+  DWORD decompression = WINHTTP_DECOMPRESSION_FLAG_ALL;
+  decodes_responses_ = WinHttpSetOption(session, WINHTTP_OPTION_DECOMPRESSION,
+                                        &decompression,
+                                        sizeof(decompression)) != FALSE;
+#endif
+#ifdef WINHTTP_PROTOCOL_FLAG_HTTP2
+  // Fails on systems without HTTP/2 support, which keep HTTP/1.1.
+  DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+  WinHttpSetOption(session, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols,
+                   sizeof(protocols));
+#endif
+  session_ = session;
+}
+
+WinHttpClient::~WinHttpClient() {
+  for (auto& [key, connection] : connections_) {
+    WinHttpCloseHandle(connection);
+  }
+  if (session_) {
+    WinHttpCloseHandle(session_);
+  }
+}
+
+void WinHttpClient::Perform(const std::string& url,
+                            const HttpHeaders& headers,
+                            const std::vector<uint8_t>& body,
+                            const Sink& sink,
+                            Exchange* exchange) {
+  std::wstring wide_url = Widen(url);
+  URL_COMPONENTS components = {sizeof(URL_COMPONENTS)};
+  components.dwHostNameLength = static_cast<DWORD>(-1);
+  components.dwUrlPathLength = static_cast<DWORD>(-1);
+  components.dwExtraInfoLength = static_cast<DWORD>(-1);
+  if (!WinHttpCrackUrl(wide_url.c_str(), 0, 0, &components)) {
+    exchange->error = "Invalid URL.";
+    return;
+  }
+  HINTERNET connection = ConnectionFor(
+      std::wstring(components.lpszHostName, components.dwHostNameLength),
+      components.nPort);
+  if (!connection) {
+    exchange->error = "Error in WinHttpConnect.";
+    return;
+  }
+  std::wstring path(components.lpszUrlPath, components.dwUrlPathLength);
+  path.append(components.lpszExtraInfo, components.dwExtraInfoLength);
+  bool secure = components.nScheme == INTERNET_SCHEME_HTTPS;
+  HINTERNET request = WinHttpOpenRequest(
+      connection, L"POST", path.c_str(), NULL, WINHTTP_NO_REFERER,
+      WINHTTP_DEFAULT_ACCEPT_TYPES, secure ? WINHTTP_FLAG_SECURE : 0);
+  if (!request) {
+    exchange->error = "Error in WinHttpOpenRequest.";
+    return;
+  }
+  DWORD disable = WINHTTP_DISABLE_COOKIES;
+  WinHttpSetOption(request, WINHTTP_OPTION_DISABLE_FEATURE, &disable,
+                   sizeof(disable));
+
+  std::wstring header_block;
+  for (const auto& [name, value] : headers) {
+    header_block.append(Widen(name)).append(L": ").append(Widen(value)).append(
+        L"\r\n");
+  }
+  DWORD status = 0;
+  DWORD size = sizeof(status);
+  bool ok =
+      WinHttpSendRequest(request, header_block.c_str(),
+                         static_cast<DWORD>(header_block.size()),
+                         const_cast<uint8_t*>(body.data()),
+                         static_cast<DWORD>(body.size()),
+                         static_cast<DWORD>(body.size()), 0) &&
+      WinHttpReceiveResponse(request, NULL) &&
+      WinHttpQueryHeaders(request,
+                          WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                          WINHTTP_HEADER_NAME_BY_INDEX, &status, &size,
+                          WINHTTP_NO_HEADER_INDEX);
+  if (ok) {
+    exchange->status = static_cast<int>(status);
+    ReadHeaders(request, &exchange->headers);
+    std::vector<char> buffer(kReadSize);
+    while (true) {
+      DWORD read = 0;
+      ok = WinHttpReadData(request, buffer.data(), kReadSize, &read) != FALSE;
+      if (!ok || read == 0) {
+        break;
+      }
+      sink(buffer.data(), read);
+    }
+  }
+  if (!ok) {
+    exchange->status = 0;
+    exchange->headers.clear();
+    exchange->error = "WinHTTP error " + std::to_string(GetLastError()) + ".";
+  }
+
+#if defined(WINHTTP_OPTION_REQUEST_STATS) && \
+    defined(WINHTTP_REQUEST_STAT_FLAG_FIRST_REQUEST)
+  // Only reported by recent versions of Windows 10 and later.
+  WINHTTP_REQUEST_STATS stats = {};
+  DWORD stats_size = sizeof(stats);
+  if (ok && WinHttpQueryOption(request, WINHTTP_OPTION_REQUEST_STATS, &stats,
+                               &stats_size)) {
+    exchange->connection_known = true;
+    exchange->new_connection =
+        (stats.ullFlags & WINHTTP_REQUEST_STAT_FLAG_FIRST_REQUEST) != 0;
+    exchange->tls = secure;
+    exchange->tls_resumed =
+        (stats.ullFlags & WINHTTP_REQUEST_STAT_FLAG_TLS_SESSION_RESUMPTION) != 0;
+  }
+#endif
+  WinHttpCloseHandle(request);
+}
+
+void* WinHttpClient::ConnectionFor(const std::wstring& host,
+                                   unsigned short port) {
+  if (!session_) {
+    return nullptr;
+  }
+  std::wstring key = host + L":" + std::to_wstring(port);
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  auto connection_it = connections_.find(key);
+  if (connection_it != connections_.end()) {
+    return connection_it->second;
+  }
+  // Opens no socket: WinHTTP connects, and reuses connections, per request.
+  HINTERNET connection = WinHttpConnect(session_, host.c_str(), port, 0);
+  if (connection) {
+    connections_[key] = connection;
+  }
+  return connection;
+}
+
+}  // namespace native_core
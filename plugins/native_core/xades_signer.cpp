@@ -0,0 +1,510 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/xades_signer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <initializer_list>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "include/native_core/digest.h"
+#include "include/native_core/mapped_file.h"
+#include "include/native_core/xml_canonicalizer.h"
+
+namespace native_core {
+
+namespace {
+
+using Der = std::vector<uint8_t>;
+
+// Bytes canonicalized, and copied, at a time.
+constexpr size_t kChunk = 1 << 20;
+
+constexpr char kDsNamespace[] = "http://www.w3.org/2000/09/xmldsig#";
+constexpr char kXadesNamespace[] = "http://uri.etsi.org/01903/v1.3.2#";
+constexpr char kExclusiveC14n[] = "http://www.w3.org/2001/10/xml-exc-c14n#";
+constexpr char kEnvelopedSignature[] =
+    "http://www.w3.org/2000/09/xmldsig#enveloped-signature";
+constexpr char kSignedPropertiesType[] =
+    "http://uri.etsi.org/01903#SignedProperties";
+
+// ASN.1 tags.
+constexpr uint8_t kInteger = 0x02;
+constexpr uint8_t kSequence = 0x30;
+constexpr uint8_t kContext0 = 0xa0;
+constexpr uint8_t kContext4 = 0xa4;
+
+constexpr char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+struct AlgorithmUris {
+  const char* digest;
+  const char* signature;
+  // Name for Pkcs1Signer::Sign().
+  const char* name;
+};
+
+// XML Signature 1.1, 6.2 and 6.4, and RFC 6931.
+AlgorithmUris UrisFor(DigestAlgorithm digest) {
+  switch (digest) {
+    case DigestAlgorithm::kSha1:
+      return {"http://www.w3.org/2000/09/xmldsig#sha1",
+              "http://www.w3.org/2000/09/xmldsig#rsa-sha1", "SHA1withRSA"};
+    case DigestAlgorithm::kSha256:
+      return {"http://www.w3.org/2001/04/xmlenc#sha256",
+              "http://www.w3.org/2001/04/xmldsig-more#rsa-sha256",
+              "SHA256withRSA"};
+    case DigestAlgorithm::kSha384:
+      return {"http://www.w3.org/2001/04/xmldsig-more#sha384",
+              "http://www.w3.org/2001/04/xmldsig-more#rsa-sha384",
+              "SHA384withRSA"};
+    case DigestAlgorithm::kSha512:
+      break;
+  }
+  return {"http://www.w3.org/2001/04/xmlenc#sha512",
+          "http://www.w3.org/2001/04/xmldsig-more#rsa-sha512",
+          "SHA512withRSA"};
+}
+
+// Opens a file by its UTF-8 path.
+std::FILE* OpenFile(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, path.c_str(), wide_mode.c_str()) == 0 ? file
+                                                               : nullptr;
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+std::string Base64Encode(const std::vector<uint8_t>& data) {
+  std::string encoded;
+  encoded.reserve((data.size() + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 3 <= data.size(); i += 3) {
+    uint32_t bits = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) |
+                    data[i + 2];
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += kAlphabet[(bits >> 6) & 0x3F];
+    encoded += kAlphabet[bits & 0x3F];
+  }
+  size_t remainder = data.size() - i;
+  if (remainder > 0) {
+    uint32_t bits = uint32_t{data[i]} << 16;
+    if (remainder == 2) {
+      bits |= uint32_t{data[i + 1]} << 8;
+    }
+    encoded += kAlphabet[(bits >> 18) & 0x3F];
+    encoded += kAlphabet[(bits >> 12) & 0x3F];
+    encoded += remainder == 2 ? kAlphabet[(bits >> 6) & 0x3F] : '=';
+    encoded += '=';
+  }
+  return encoded;
+}
+
+// |value| as an attribute value between double quotes, or as text.
+std::string Escape(const std::string& value) {
+  std::string out;
+  out.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '&':
+        out += "&amp;";
+        break;
+      case '<':
+        out += "&lt;";
+        break;
+      case '>':
+        out += "&gt;";
+        break;
+      case '"':
+        out += "&quot;";
+        break;
+      default:
+        out.push_back(c);
+        break;
+    }
+  }
+  return out;
+}
+
+// An xsd:dateTime in UTC.
+std::string DateTime(std::chrono::system_clock::time_point time) {
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  std::tm utc{};
+#ifdef _WIN32
+  gmtime_s(&utc, &seconds);
+#else
+  gmtime_r(&seconds, &utc);
+#endif
+  char text[64];
+  std::snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+                utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour,
+                utc.tm_min, utc.tm_sec);
+  return text;
+}
+
+// Appends a tag, the DER length of |size| and nothing else.
+void AppendHeader(Der* out, uint8_t tag, size_t size) {
+  out->push_back(tag);
+  if (size < 0x80) {
+    out->push_back(static_cast<uint8_t>(size));
+    return;
+  }
+  uint8_t bytes[sizeof(size_t)];
+  int count = 0;
+  for (size_t value = size; value > 0; value >>= 8) {
+    bytes[count++] = static_cast<uint8_t>(value);
+  }
+  out->push_back(static_cast<uint8_t>(0x80 | count));
+  while (count > 0) {
+    out->push_back(bytes[--count]);
+  }
+}
+
+// A constructed value holding |parts| in order.
+Der Tlv(uint8_t tag, std::initializer_list<const Der*> parts) {
+  size_t size = 0;
+  for (const Der* part : parts) {
+    size += part->size();
+  }
+  Der out;
+  out.reserve(size + 6);
+  AppendHeader(&out, tag, size);
+  for (const Der* part : parts) {
+    out.insert(out.end(), part->begin(), part->end());
+  }
+  return out;
+}
+
+// A DER value within a buffer: [begin, end) is its whole encoding and
+// [contents, end) what follows its length.
+struct DerValue {
+  uint8_t tag = 0;
+  const uint8_t* begin = nullptr;
+  const uint8_t* contents = nullptr;
+  const uint8_t* end = nullptr;
+
+  Der Encoding() const { return Der(begin, end); }
+};
+
+// Reads the value at |*position|, before |end|, and moves past it.
+bool ReadValue(const uint8_t** position, const uint8_t* end, DerValue* value) {
+  const uint8_t* p = *position;
+  if (end - p < 2) {
+    return false;
+  }
+  value->begin = p;
+  value->tag = *p++;
+  size_t size = *p++;
+  if (size & 0x80) {
+    size_t count = size & 0x7f;
+    if (count == 0 || count > 4 || static_cast<size_t>(end - p) < count) {
+      return false;
+    }
+    size = 0;
+    while (count-- > 0) {
+      size = (size << 8) | *p++;
+    }
+  }
+  if (static_cast<size_t>(end - p) < size) {
+    return false;
+  }
+  value->contents = p;
+  value->end = p + size;
+  *position = value->end;
+  return true;
+}
+
+// The DER IssuerSerial of a DER X.509 certificate (RFC 5035, 4), the
+// content of IssuerSerialV2 (ETSI EN 319 132-1, 5.2.2.2).
+bool ReadIssuerSerial(const std::vector<uint8_t>& certificate, Der* out) {
+  const uint8_t* position = certificate.data();
+  const uint8_t* end = position + certificate.size();
+  DerValue value;
+  if (!ReadValue(&position, end, &value) || value.tag != kSequence) {
+    return false;
+  }
+  position = value.contents;
+  end = value.end;
+  DerValue tbs;
+  if (!ReadValue(&position, end, &tbs) || tbs.tag != kSequence) {
+    return false;
+  }
+  position = tbs.contents;
+  DerValue field;
+  // version [0] EXPLICIT, absent for v1.
+  if (!ReadValue(&position, tbs.end, &field)) {
+    return false;
+  }
+  if (field.tag == kContext0 && !ReadValue(&position, tbs.end, &field)) {
+    return false;
+  }
+  if (field.tag != kInteger) {
+    return false;
+  }
+  Der serial = field.Encoding();
+  DerValue algorithm;
+  if (!ReadValue(&position, tbs.end, &algorithm) ||
+      !ReadValue(&position, tbs.end, &field) || field.tag != kSequence) {
+    return false;
+  }
+  Der issuer = field.Encoding();
+  Der directory_name = Tlv(kContext4, {&issuer});
+  Der general_names = Tlv(kSequence, {&directory_name});
+  *out = Tlv(kSequence, {&general_names, &serial});
+  return true;
+}
+
+// ds:DigestMethod and ds:DigestValue of a reference.
+std::string DigestElements(const AlgorithmUris& uris,
+                           const std::vector<uint8_t>& digest) {
+  return std::string("<ds:DigestMethod Algorithm=\"") + uris.digest +
+         "\"/><ds:DigestValue>" + Base64Encode(digest) + "</ds:DigestValue>";
+}
+
+}  // namespace
+
+bool SignXml(Pkcs1Signer* signer,
+             const std::string& input_path,
+             const std::string& output_path,
+             const XadesOptions& options,
+             XadesResult* result,
+             std::string* error) {
+  std::error_code same_error;
+  if (std::filesystem::equivalent(std::filesystem::u8path(input_path),
+                                  std::filesystem::u8path(output_path),
+                                  same_error)) {
+    *error = "The signed XML file must be written to another file.";
+    return false;
+  }
+  bool enveloped = options.packaging == XadesOptions::Packaging::kEnveloped;
+  if (!enveloped && options.detached_uri.empty()) {
+    *error = "A detached signature needs the URI of the signed document.";
+    return false;
+  }
+  std::vector<uint8_t> certificate = signer->Certificate();
+  if (certificate.empty()) {
+    *error = "The signing certificate is not available.";
+    return false;
+  }
+  Der issuer_serial;
+  if (!ReadIssuerSerial(certificate, &issuer_serial)) {
+    *error = "The signing certificate cannot be decoded.";
+    return false;
+  }
+  std::unique_ptr<MappedFile> input = MappedFile::Open(input_path);
+  if (!input) {
+    *error = "The XML file cannot be read.";
+    return false;
+  }
+
+  // The document reference: the input canonicalized as it streams, which
+  // for an enveloped signature is also what the enveloped-signature
+  // transform leaves of the output.
+  AlgorithmUris uris = UrisFor(options.digest);
+  Digester document_digester(options.digest);
+  ExclusiveCanonicalizer canonicalizer(
+      [&document_digester](const char* data, size_t size) {
+        document_digester.Update(reinterpret_cast<const uint8_t*>(data),
+                                 size);
+      });
+  const char* data = reinterpret_cast<const char*>(input->data());
+  for (size_t offset = 0; offset < input->size(); offset += kChunk) {
+    size_t size = std::min(kChunk, input->size() - offset);
+    if (!canonicalizer.Feed(data + offset, size)) {
+      break;
+    }
+    input->Release(offset, size);
+  }
+  if (!canonicalizer.Finish()) {
+    *error = "The XML file is not well-formed: " + canonicalizer.error();
+    return false;
+  }
+  std::vector<uint8_t> document_digest = document_digester.Finish();
+
+  std::chrono::system_clock::time_point signing_time =
+      options.signing_time.value_or(std::chrono::system_clock::now());
+  std::string date_time = DateTime(signing_time);
+  std::string id;
+  {
+    Digester id_digester(DigestAlgorithm::kSha256);
+    id_digester.Update(document_digest.data(), document_digest.size());
+    id_digester.Update(reinterpret_cast<const uint8_t*>(date_time.data()),
+                       date_time.size());
+    static constexpr char kHex[] = "0123456789abcdef";
+    id = "Signature-";
+    for (uint8_t byte : id_digester.Finish()) {
+      if (id.size() >= 26) {
+        break;
+      }
+      id += kHex[byte >> 4];
+      id += kHex[byte & 0x0f];
+    }
+  }
+
+  // The parts that are signed are written with their own namespace
+  // declarations and canonicalized on their own, which Exclusive XML
+  // Canonicalization makes the same as in place; their canonical form goes
+  // in the signature as is.
+  std::string signed_properties_xml =
+      std::string("<xades:SignedProperties xmlns:xades=\"") +
+      kXadesNamespace + "\" xmlns:ds=\"" + kDsNamespace + "\" Id=\"" + id +
+      "-SignedProperties\"><xades:SignedSignatureProperties>"
+      "<xades:SigningTime>" + date_time + "</xades:SigningTime>"
+      "<xades:SigningCertificateV2><xades:Cert><xades:CertDigest>" +
+      DigestElements(uris, Digest(options.digest, certificate.data(),
+                                  certificate.size())) +
+      "</xades:CertDigest><xades:IssuerSerialV2>" +
+      Base64Encode(issuer_serial) +
+      "</xades:IssuerSerialV2></xades:Cert></xades:SigningCertificateV2>"
+      "</xades:SignedSignatureProperties><xades:SignedDataObjectProperties>"
+      "<xades:DataObjectFormat ObjectReference=\"#" + id + "-Reference\">"
+      "<xades:MimeType>" + Escape(options.mime_type) + "</xades:MimeType>"
+      "</xades:DataObjectFormat></xades:SignedDataObjectProperties>"
+      "</xades:SignedProperties>";
+  std::string signed_properties;
+  if (!ExclusiveCanonicalizer::Canonicalize(signed_properties_xml,
+                                            &signed_properties, error)) {
+    return false;
+  }
+
+  std::string transforms = "<ds:Transforms>";
+  if (enveloped) {
+    transforms += std::string("<ds:Transform Algorithm=\"") +
+                  kEnvelopedSignature + "\"/>";
+  }
+  transforms += std::string("<ds:Transform Algorithm=\"") + kExclusiveC14n +
+                "\"/></ds:Transforms>";
+  std::string signed_info_xml =
+      std::string("<ds:SignedInfo xmlns:ds=\"") + kDsNamespace + "\">"
+      "<ds:CanonicalizationMethod Algorithm=\"" + kExclusiveC14n + "\"/>"
+      "<ds:SignatureMethod Algorithm=\"" + uris.signature + "\"/>"
+      "<ds:Reference Id=\"" + id + "-Reference\" URI=\"" +
+      (enveloped ? std::string() : Escape(options.detached_uri)) + "\">" +
+      transforms + DigestElements(uris, document_digest) + "</ds:Reference>"
+      "<ds:Reference Type=\"" + kSignedPropertiesType + "\" URI=\"#" + id +
+      "-SignedProperties\"><ds:Transforms><ds:Transform Algorithm=\"" +
+      kExclusiveC14n + "\"/></ds:Transforms>" +
+      DigestElements(uris,
+                     Digest(options.digest,
+                            reinterpret_cast<const uint8_t*>(
+                                signed_properties.data()),
+                            signed_properties.size())) +
+      "</ds:Reference></ds:SignedInfo>";
+  std::string signed_info;
+  if (!ExclusiveCanonicalizer::Canonicalize(signed_info_xml, &signed_info,
+                                            error)) {
+    return false;
+  }
+  std::vector<uint8_t> signature_value;
+  if (!signer->Sign(uris.name,
+                    reinterpret_cast<const uint8_t*>(signed_info.data()),
+                    signed_info.size(), &signature_value, error)) {
+    return false;
+  }
+
+  std::string signature =
+      std::string("<ds:Signature xmlns:ds=\"") + kDsNamespace + "\" Id=\"" +
+      id + "\">" + signed_info + "<ds:SignatureValue Id=\"" + id +
+      "-SignatureValue\">" + Base64Encode(signature_value) +
+      "</ds:SignatureValue><ds:KeyInfo><ds:X509Data><ds:X509Certificate>" +
+      Base64Encode(certificate) +
+      "</ds:X509Certificate></ds:X509Data></ds:KeyInfo><ds:Object>"
+      "<xades:QualifyingProperties xmlns:xades=\"" + kXadesNamespace +
+      "\" Target=\"#" + id + "\">" + signed_properties +
+      "</xades:QualifyingProperties></ds:Object></ds:Signature>";
+
+  // The output: the document with the signature before the end tag of its
+  // root, an empty-element root opened up for it, or the signature alone.
+  std::string before;
+  std::string after;
+  uint64_t head_size = 0;
+  uint64_t tail_offset = input->size();
+  if (enveloped) {
+    head_size = canonicalizer.root_end_begin();
+    tail_offset = canonicalizer.root_end_end();
+    if (canonicalizer.root_empty()) {
+      // Up to the "/>" of the tag.
+      std::string tag(data + head_size,
+                      static_cast<size_t>(tail_offset - head_size - 2));
+      before = tag + ">";
+      after = "</" + canonicalizer.root_name() + ">";
+    }
+    else {
+      tail_offset = head_size;
+    }
+  }
+  else {
+    before = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    after = "\n";
+  }
+
+  std::filesystem::path path = std::filesystem::u8path(output_path);
+  std::FILE* output = OpenFile(path, "wb");
+  if (output == nullptr) {
+    *error = "The signed XML file cannot be created.";
+    return false;
+  }
+  auto fail = [&]() {
+    std::fclose(output);
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+    *error = "The signed XML file cannot be written.";
+    return false;
+  };
+  auto copy = [&](uint64_t begin, uint64_t end) {
+    for (uint64_t offset = begin; offset < end; offset += kChunk) {
+      size_t size = static_cast<size_t>(std::min<uint64_t>(kChunk,
+                                                           end - offset));
+      if (std::fwrite(data + offset, 1, size, output) != size) {
+        return false;
+      }
+      input->Release(static_cast<size_t>(offset), size);
+    }
+    return true;
+  };
+  if (!copy(0, head_size) ||
+      std::fwrite(before.data(), 1, before.size(), output) != before.size() ||
+      std::fwrite(signature.data(), 1, signature.size(), output) !=
+          signature.size() ||
+      std::fwrite(after.data(), 1, after.size(), output) != after.size() ||
+      (enveloped && !copy(tail_offset, input->size())) ||
+      std::fflush(output) != 0) {
+    return fail();
+  }
+  if (std::fclose(output) != 0) {
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+    *error = "The signed XML file cannot be written.";
+    return false;
+  }
+  if (result != nullptr) {
+    result->input_size = input->size();
+    result->output_size = (enveloped ? input->size() - tail_offset : 0) +
+                          head_size + before.size() + signature.size() +
+                          after.size();
+    result->signature_size = signature.size();
+  }
+  return true;
+}
+
+}  // namespace native_core
@@ -0,0 +1,385 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/xml_canonicalizer.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+// Canonical output handed to the sink at a time.
+constexpr size_t kFlushSize = 64 << 10;
+
+// Input parsed at a time by Canonicalize().
+constexpr size_t kFeedChunk = 64 << 10;
+
+constexpr std::string_view kXmlNamespace =
+    "http://www.w3.org/XML/1998/namespace";
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Splits a qualified name at its colon; the prefix is empty if there is
+// none.
+void SplitName(std::string_view name,
+               std::string_view* prefix,
+               std::string_view* local_name) {
+  size_t colon = name.find(':');
+  if (colon == std::string_view::npos) {
+    *prefix = std::string_view();
+    *local_name = name;
+  }
+  else {
+    *prefix = name.substr(0, colon);
+    *local_name = name.substr(colon + 1);
+  }
+}
+
+}  // namespace
+
+ExclusiveCanonicalizer::ExclusiveCanonicalizer(Sink sink)
+    : sink_(std::move(sink)) {
+  parser_.set_normalize_whitespace(true);
+  out_.reserve(kFlushSize + 1024);
+}
+
+ExclusiveCanonicalizer::~ExclusiveCanonicalizer() = default;
+
+bool ExclusiveCanonicalizer::Feed(const char* data, size_t size) {
+  if (failed_) {
+    return false;
+  }
+  parser_.Feed(data, size);
+  return Drain();
+}
+
+bool ExclusiveCanonicalizer::Finish() {
+  if (failed_) {
+    return false;
+  }
+  parser_.Finish();
+  if (!Drain()) {
+    return false;
+  }
+  Flush();
+  return true;
+}
+
+// static
+bool ExclusiveCanonicalizer::Canonicalize(std::string_view xml,
+                                          std::string* out,
+                                          std::string* error) {
+  ExclusiveCanonicalizer canonicalizer(
+      [out](const char* data, size_t size) { out->append(data, size); });
+  for (size_t offset = 0; offset < xml.size(); offset += kFeedChunk) {
+    size_t size = std::min(kFeedChunk, xml.size() - offset);
+    if (!canonicalizer.Feed(xml.data() + offset, size)) {
+      break;
+    }
+  }
+  if (!canonicalizer.Finish()) {
+    *error = canonicalizer.error();
+    return false;
+  }
+  return true;
+}
+
+bool ExclusiveCanonicalizer::Drain() {
+  while (true) {
+    switch (parser_.Next()) {
+      case XmlPullParser::Event::kNeedMoreData:
+      case XmlPullParser::Event::kEndDocument:
+        return true;
+      case XmlPullParser::Event::kStartElement:
+        if (!StartElement()) {
+          return false;
+        }
+        break;
+      case XmlPullParser::Event::kEndElement:
+        EndElement();
+        break;
+      case XmlPullParser::Event::kText:
+        AppendEscaped(parser_.text(), false);
+        break;
+      case XmlPullParser::Event::kOther:
+        Other(parser_.text());
+        break;
+      case XmlPullParser::Event::kError:
+        return Fail(parser_.error());
+    }
+  }
+}
+
+bool ExclusiveCanonicalizer::StartElement() {
+  if (parser_.depth() == 1) {
+    seen_root_ = true;
+    root_name_ = parser_.name();
+    root_begin_ = parser_.token_begin();
+  }
+  declared_marks_.push_back(declared_.size());
+  rendered_marks_.push_back(rendered_.size());
+
+  // Namespace declarations are namespace nodes, not attributes.
+  const std::vector<XmlPullParser::Attribute>& attributes =
+      parser_.attributes();
+  for (const XmlPullParser::Attribute& attribute : attributes) {
+    std::string_view name = attribute.name;
+    if (name == "xmlns") {
+      declared_.push_back({std::string(), attribute.value});
+    }
+    else if (name.compare(0, 6, "xmlns:") == 0) {
+      if (attribute.value.empty()) {
+        return Fail("Empty namespace name for prefix " +
+                    std::string(name.substr(6)));
+      }
+      declared_.push_back({std::string(name.substr(6)), attribute.value});
+    }
+  }
+
+  // Renders the namespaces the element and its attributes visibly use
+  // (Exclusive XML Canonicalization, 3) unless the nearest output ancestor
+  // already did with the same value. An empty default namespace only needs
+  // rendering, as xmlns="", to undo one rendered above.
+  size_t rendered_mark = rendered_.size();
+  auto render = [&](std::string_view prefix) -> bool {
+    const std::string* uri = Find(declared_, prefix);
+    if (uri == nullptr && !prefix.empty()) {
+      return Fail("Undeclared namespace prefix " + std::string(prefix));
+    }
+    std::string_view value = uri != nullptr ? *uri : std::string_view();
+    for (size_t i = rendered_mark; i < rendered_.size(); ++i) {
+      if (rendered_[i].prefix == prefix) {
+        return true;
+      }
+    }
+    const std::string* current = Find(rendered_, prefix);
+    if (current != nullptr ? *current == value : value.empty()) {
+      return true;
+    }
+    rendered_.push_back({std::string(prefix), std::string(value)});
+    return true;
+  };
+
+  std::string_view prefix;
+  std::string_view local_name;
+  SplitName(parser_.name(), &prefix, &local_name);
+  if (prefix == "xml" || prefix == "xmlns") {
+    return Fail("Reserved prefix in <" + parser_.name() + ">");
+  }
+  if (!render(prefix)) {
+    return false;
+  }
+  attributes_.clear();
+  for (const XmlPullParser::Attribute& attribute : attributes) {
+    std::string_view name = attribute.name;
+    if (name == "xmlns" || name.compare(0, 6, "xmlns:") == 0) {
+      continue;
+    }
+    SplitName(name, &prefix, &local_name);
+    std::string_view uri;
+    if (prefix == "xml") {
+      uri = kXmlNamespace;
+    }
+    else if (!prefix.empty()) {
+      if (!render(prefix)) {
+        return false;
+      }
+      uri = *Find(declared_, prefix);
+    }
+    attributes_.push_back({uri, local_name, &attribute});
+  }
+
+  // Namespace nodes sorted by prefix, attributes by namespace and local name.
+  std::sort(rendered_.begin() + rendered_mark, rendered_.end(),
+            [](const Binding& a, const Binding& b) {
+              return a.prefix < b.prefix;
+            });
+  std::sort(attributes_.begin(), attributes_.end(),
+            [](const SortedAttribute& a, const SortedAttribute& b) {
+              return a.uri != b.uri ? a.uri < b.uri
+                                    : a.local_name < b.local_name;
+            });
+
+  Append("<");
+  Append(parser_.name());
+  for (size_t i = rendered_mark; i < rendered_.size(); ++i) {
+    if (rendered_[i].prefix.empty()) {
+      Append(" xmlns=\"");
+    }
+    else {
+      Append(" xmlns:");
+      Append(rendered_[i].prefix);
+      Append("=\"");
+    }
+    AppendEscaped(rendered_[i].uri, true);
+    Append("\"");
+  }
+  for (const SortedAttribute& attribute : attributes_) {
+    Append(" ");
+    Append(attribute.attribute->name);
+    Append("=\"");
+    AppendEscaped(attribute.attribute->value, true);
+    Append("\"");
+  }
+  Append(">");
+  return true;
+}
+
+void ExclusiveCanonicalizer::EndElement() {
+  Append("</");
+  Append(parser_.name());
+  Append(">");
+  declared_.resize(declared_marks_.back());
+  declared_marks_.pop_back();
+  rendered_.resize(rendered_marks_.back());
+  rendered_marks_.pop_back();
+  if (parser_.depth() == 0) {
+    root_end_begin_ = parser_.token_begin();
+    root_end_end_ = parser_.token_end();
+    root_empty_ = root_end_begin_ == root_begin_;
+  }
+}
+
+void ExclusiveCanonicalizer::Other(const std::string& markup) {
+  // Comments are left out, and so is the XML declaration, which is not a
+  // processing instruction.
+  if (markup.compare(0, 2, "<?") != 0) {
+    return;
+  }
+  std::string_view body(markup);
+  body = body.substr(2, body.size() - 4);
+  size_t target_end = 0;
+  while (target_end < body.size() && !IsSpace(body[target_end])) {
+    ++target_end;
+  }
+  std::string_view target = body.substr(0, target_end);
+  if (target == "xml") {
+    return;
+  }
+  size_t data_begin = target_end;
+  while (data_begin < body.size() && IsSpace(body[data_begin])) {
+    ++data_begin;
+  }
+  std::string_view data = body.substr(data_begin);
+
+  // Outside the root element, a line feed separates it from the root.
+  bool after_root = parser_.depth() == 0 && seen_root_;
+  if (after_root) {
+    Append("\n");
+  }
+  Append("<?");
+  Append(target);
+  if (!data.empty()) {
+    Append(" ");
+    // Line ends are normalized in processing instructions too (XML 1.0,
+    // 2.11), which the parser leaves as written.
+    for (size_t i = 0; i < data.size(); ++i) {
+      if (data[i] != '\r') {
+        out_.push_back(data[i]);
+      }
+      else if (i + 1 == data.size() || data[i + 1] != '\n') {
+        out_.push_back('\n');
+      }
+    }
+  }
+  Append("?>");
+  if (parser_.depth() == 0 && !seen_root_) {
+    Append("\n");
+  }
+}
+
+// static
+const std::string* ExclusiveCanonicalizer::Find(
+    const std::vector<Binding>& bindings,
+    std::string_view prefix) {
+  for (auto it = bindings.rbegin(); it != bindings.rend(); ++it) {
+    if (it->prefix == prefix) {
+      return &it->uri;
+    }
+  }
+  return nullptr;
+}
+
+void ExclusiveCanonicalizer::Append(std::string_view data) {
+  out_.append(data.data(), data.size());
+  if (out_.size() >= kFlushSize) {
+    Flush();
+  }
+}
+
+void ExclusiveCanonicalizer::AppendEscaped(std::string_view value,
+                                           bool attribute) {
+  // C14N 1.0, 2.3: text escapes &, <, > and CR; attribute values &, <, ",
+  // tab, line feed and CR.
+  const char* special = attribute ? "&<\"\t\n\r" : "&<>\r";
+  size_t i = 0;
+  while (i < value.size()) {
+    size_t found = value.find_first_of(special, i);
+    if (found == std::string_view::npos) {
+      found = value.size();
+    }
+    out_.append(value.data() + i, found - i);
+    if (found == value.size()) {
+      break;
+    }
+    switch (value[found]) {
+      case '&':
+        out_ += "&amp;";
+        break;
+      case '<':
+        out_ += "&lt;";
+        break;
+      case '>':
+        out_ += "&gt;";
+        break;
+      case '"':
+        out_ += "&quot;";
+        break;
+      case '\t':
+        out_ += "&#x9;";
+        break;
+      case '\n':
+        out_ += "&#xA;";
+        break;
+      default:
+        out_ += "&#xD;";
+        break;
+    }
+    i = found + 1;
+    if (out_.size() >= kFlushSize) {
+      Flush();
+    }
+  }
+  if (out_.size() >= kFlushSize) {
+    Flush();
+  }
+}
+
+void ExclusiveCanonicalizer::Flush() {
+  if (!out_.empty()) {
+    sink_(out_.data(), out_.size());
+    out_.clear();
+  }
+}
+
+bool ExclusiveCanonicalizer::Fail(std::string message) {
+  failed_ = true;
+  error_ = std::move(message);
+  return false;
+}
+
+}  // namespace native_core
@@ -0,0 +1,486 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/xml_pull_parser.h"
+
+#include <cstdint>
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+// Consumed input is dropped from the buffer once it exceeds this size and
+// half of the buffer.
+constexpr size_t kCompactThreshold = 64 * 1024;
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+char ToLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool EqualsIgnoreAsciiCase(std::string_view value,
+                           std::string_view lowercase) {
+  if (value.size() != lowercase.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (ToLowerAscii(value[i]) != lowercase[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsNameStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         c == ':' || (static_cast<unsigned char>(c) >= 0x80);
+}
+
+bool IsNameChar(char c) {
+  return IsNameStart(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Parses the body of a character reference ("#65", "#x41"). Returns false if
+// it is not a valid one.
+bool ParseCharacterReference(std::string_view reference, uint32_t* code_point) {
+  if (reference.size() < 2 || reference[0] != '#') {
+    return false;
+  }
+  uint32_t base = 10;
+  size_t i = 1;
+  if (reference[1] == 'x' || reference[1] == 'X') {
+    base = 16;
+    i = 2;
+  }
+  if (i == reference.size()) {
+    return false;
+  }
+  uint32_t value = 0;
+  for (; i < reference.size(); ++i) {
+    char c = reference[i];
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = static_cast<uint32_t>(c - '0');
+    } else if (base == 16 && c >= 'a' && c <= 'f') {
+      digit = static_cast<uint32_t>(c - 'a' + 10);
+    } else if (base == 16 && c >= 'A' && c <= 'F') {
+      digit = static_cast<uint32_t>(c - 'A' + 10);
+    } else {
+      return false;
+    }
+    value = value * base + digit;
+    if (value > 0x10FFFF) {
+      return false;
+    }
+  }
+  if (value == 0 || (value >= 0xD800 && value <= 0xDFFF)) {
+    return false;
+  }
+  *code_point = value;
+  return true;
+}
+
+}  // namespace
+
+XmlPullParser::XmlPullParser() = default;
+
+void XmlPullParser::Feed(const char* data, size_t size) {
+  if (position_ > kCompactThreshold && position_ > buffer_.size() / 2) {
+    buffer_.erase(0, position_);
+    consumed_ += position_;
+    scanned_ = scanned_ > position_ ? scanned_ - position_ : 0;
+    position_ = 0;
+  }
+  buffer_.append(data, size);
+}
+
+void XmlPullParser::Finish() {
+  finished_ = true;
+}
+
+const XmlPullParser::Attribute* XmlPullParser::FindAttribute(
+    std::string_view lowercase_name) const {
+  for (const Attribute& attribute : attributes_) {
+    if (EqualsIgnoreAsciiCase(attribute.name, lowercase_name)) {
+      return &attribute;
+    }
+  }
+  return nullptr;
+}
+
+XmlPullParser::Event XmlPullParser::Next() {
+  if (failed_) {
+    return Event::kError;
+  }
+  if (pending_end_) {
+    pending_end_ = false;
+    name_ = std::move(open_elements_.back());
+    open_elements_.pop_back();
+    root_closed_ = open_elements_.empty();
+    return Event::kEndElement;
+  }
+  if (position_ == buffer_.size()) {
+    if (!finished_) {
+      return Event::kNeedMoreData;
+    }
+    if (!open_elements_.empty()) {
+      return Fail("Unexpected end of input inside <" + open_elements_.back() +
+                  ">");
+    }
+    if (!seen_root_) {
+      return Fail("Missing root element");
+    }
+    return Event::kEndDocument;
+  }
+  token_begin_ = consumed_ + position_;
+  Event event = buffer_[position_] == '<' ? ReadMarkup() : ReadText();
+  token_end_ = consumed_ + position_;
+  return event;
+}
+
+XmlPullParser::Event XmlPullParser::ReadText() {
+  size_t end = FindFrom(position_, "<");
+  if (end == std::string::npos) {
+    if (!finished_) {
+      return Event::kNeedMoreData;
+    }
+    end = buffer_.size();
+  }
+  std::string_view raw(buffer_.data() + position_, end - position_);
+  if (open_elements_.empty()) {
+    for (char c : raw) {
+      if (!IsSpace(c)) {
+        return Fail("Text outside the root element");
+      }
+    }
+    position_ = end;
+    return Next();
+  }
+  text_.clear();
+  Decode(raw,
+         normalize_whitespace_ ? Normalization::kText : Normalization::kNone,
+         &text_);
+  position_ = end;
+  return Event::kText;
+}
+
+XmlPullParser::Event XmlPullParser::ReadMarkup() {
+  std::string_view rest(buffer_.data() + position_,
+                        buffer_.size() - position_);
+  // Waits until there are enough bytes to tell which construct this is.
+  auto starts_with = [&](std::string_view prefix, bool* incomplete) {
+    size_t n = rest.size() < prefix.size() ? rest.size() : prefix.size();
+    if (rest.compare(0, n, prefix, 0, n) != 0) {
+      return false;
+    }
+    if (n < prefix.size()) {
+      *incomplete = true;
+      return false;
+    }
+    return true;
+  };
+
+  bool incomplete = false;
+  size_t end;
+  if (starts_with("<?", &incomplete)) {
+    end = FindFrom(position_ + 2, "?>");
+    if (end == std::string::npos) {
+      return finished_ ? Fail("Unterminated processing instruction")
+                       : Event::kNeedMoreData;
+    }
+    text_.assign(buffer_, position_, end + 2 - position_);
+    position_ = end + 2;
+    return Event::kOther;
+  }
+  if (starts_with("<!--", &incomplete)) {
+    end = FindFrom(position_ + 4, "-->");
+    if (end == std::string::npos) {
+      return finished_ ? Fail("Unterminated comment") : Event::kNeedMoreData;
+    }
+    text_.assign(buffer_, position_, end + 3 - position_);
+    position_ = end + 3;
+    return Event::kOther;
+  }
+  if (starts_with("<![CDATA[", &incomplete)) {
+    end = FindFrom(position_ + 9, "]]>");
+    if (end == std::string::npos) {
+      return finished_ ? Fail("Unterminated CDATA section")
+                       : Event::kNeedMoreData;
+    }
+    if (open_elements_.empty()) {
+      return Fail("CDATA section outside the root element");
+    }
+    text_.clear();
+    AppendLiteral(
+        std::string_view(buffer_.data() + position_ + 9, end - position_ - 9),
+        normalize_whitespace_ ? Normalization::kText : Normalization::kNone,
+        &text_);
+    position_ = end + 3;
+    return Event::kText;
+  }
+  if (starts_with("<!DOCTYPE", &incomplete)) {
+    // Only a DOCTYPE without internal subset is expected; one with a subset
+    // is skipped up to its closing "]>".
+    size_t close = FindFrom(position_ + 9, ">");
+    if (close == std::string::npos) {
+      return finished_ ? Fail("Unterminated DOCTYPE") : Event::kNeedMoreData;
+    }
+    size_t subset = buffer_.find('[', position_ + 9);
+    if (subset != std::string::npos && subset < close) {
+      close = buffer_.find("]>", subset);
+      if (close == std::string::npos) {
+        return finished_ ? Fail("Unterminated DOCTYPE") : Event::kNeedMoreData;
+      }
+      ++close;
+    }
+    position_ = close + 1;
+    scanned_ = position_;
+    return Next();
+  }
+  if (incomplete) {
+    return finished_ ? Fail("Unterminated markup") : Event::kNeedMoreData;
+  }
+  if (rest.size() < 2) {
+    return finished_ ? Fail("Unterminated markup") : Event::kNeedMoreData;
+  }
+  if (rest[1] == '/') {
+    end = FindFrom(position_ + 2, ">");
+    if (end == std::string::npos) {
+      return finished_ ? Fail("Unterminated end tag") : Event::kNeedMoreData;
+    }
+    return ReadEndTag(end);
+  }
+
+  // A start tag ends at the first '>' outside a quoted attribute value.
+  char quote = 0;
+  for (end = position_ + 1; end < buffer_.size(); ++end) {
+    char c = buffer_[end];
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      }
+    } else if (c == '"' || c == '\'') {
+      quote = c;
+    } else if (c == '>') {
+      break;
+    }
+  }
+  if (end == buffer_.size()) {
+    return finished_ ? Fail("Unterminated start tag") : Event::kNeedMoreData;
+  }
+  return ReadStartTag(end);
+}
+
+XmlPullParser::Event XmlPullParser::ReadStartTag(size_t end) {
+  std::string_view tag(buffer_.data() + position_ + 1, end - position_ - 1);
+  bool empty_element = !tag.empty() && tag.back() == '/';
+  if (empty_element) {
+    tag.remove_suffix(1);
+  }
+
+  size_t i = 0;
+  if (tag.empty() || !IsNameStart(tag[0])) {
+    return Fail("Invalid element name");
+  }
+  while (i < tag.size() && IsNameChar(tag[i])) {
+    ++i;
+  }
+  name_.assign(tag.data(), i);
+
+  attributes_.clear();
+  while (true) {
+    size_t spaces = i;
+    while (i < tag.size() && IsSpace(tag[i])) {
+      ++i;
+    }
+    if (i == tag.size()) {
+      break;
+    }
+    if (i == spaces || !IsNameStart(tag[i])) {
+      return Fail("Invalid attribute in <" + name_ + ">");
+    }
+    size_t name_start = i;
+    while (i < tag.size() && IsNameChar(tag[i])) {
+      ++i;
+    }
+    Attribute attribute;
+    attribute.name.assign(tag.data() + name_start, i - name_start);
+    while (i < tag.size() && IsSpace(tag[i])) {
+      ++i;
+    }
+    if (i == tag.size() || tag[i] != '=') {
+      return Fail("Attribute " + attribute.name + " without value");
+    }
+    ++i;
+    while (i < tag.size() && IsSpace(tag[i])) {
+      ++i;
+    }
+    if (i == tag.size() || (tag[i] != '"' && tag[i] != '\'')) {
+      return Fail("Unquoted value for attribute " + attribute.name);
+    }
+    char quote = tag[i++];
+    size_t value_end = tag.find(quote, i);
+    if (value_end == std::string_view::npos) {
+      return Fail("Unterminated value for attribute " + attribute.name);
+    }
+    std::string_view raw = tag.substr(i, value_end - i);
+    if (raw.find('<') != std::string_view::npos) {
+      return Fail("'<' in the value of attribute " + attribute.name);
+    }
+    Decode(raw,
+           normalize_whitespace_ ? Normalization::kAttribute
+                                 : Normalization::kNone,
+           &attribute.value);
+    attributes_.push_back(std::move(attribute));
+    i = value_end + 1;
+  }
+
+  if (open_elements_.empty() && root_closed_) {
+    return Fail("Content after the root element");
+  }
+  seen_root_ = true;
+  open_elements_.push_back(name_);
+  pending_end_ = empty_element;
+  position_ = end + 1;
+  return Event::kStartElement;
+}
+
+XmlPullParser::Event XmlPullParser::ReadEndTag(size_t end) {
+  std::string_view tag(buffer_.data() + position_ + 2, end - position_ - 2);
+  while (!tag.empty() && IsSpace(tag.back())) {
+    tag.remove_suffix(1);
+  }
+  if (open_elements_.empty() || tag != open_elements_.back()) {
+    return Fail("Unexpected </" + std::string(tag) + ">");
+  }
+  name_ = std::move(open_elements_.back());
+  open_elements_.pop_back();
+  root_closed_ = open_elements_.empty();
+  position_ = end + 1;
+  return Event::kEndElement;
+}
+
+size_t XmlPullParser::FindFrom(size_t from, std::string_view terminator) {
+  // Resumes where the last search for this token stopped, backing up enough
+  // to catch a terminator split across chunks.
+  size_t start = from;
+  if (scanned_ > start + terminator.size()) {
+    start = scanned_ - terminator.size();
+  }
+  size_t found = buffer_.find(terminator.data(), start, terminator.size());
+  scanned_ = found == std::string::npos ? buffer_.size() : 0;
+  return found;
+}
+
+XmlPullParser::Event XmlPullParser::Fail(std::string message) {
+  failed_ = true;
+  error_ = std::move(message);
+  return Event::kError;
+}
+
+// static
+void XmlPullParser::Decode(std::string_view raw,
+                           Normalization normalization,
+                           std::string* out) {
+  out->reserve(out->size() + raw.size());
+  size_t i = 0;
+  while (i < raw.size()) {
+    size_t amp = raw.find('&', i);
+    if (amp == std::string_view::npos) {
+      AppendLiteral(raw.substr(i), normalization, out);
+      return;
+    }
+    AppendLiteral(raw.substr(i, amp - i), normalization, out);
+    size_t semicolon = raw.find(';', amp + 1);
+    // The longest reference we decode is "&#x10FFFF;".
+    if (semicolon == std::string_view::npos || semicolon - amp > 10) {
+      out->push_back('&');
+      i = amp + 1;
+      continue;
+    }
+    std::string_view entity = raw.substr(amp + 1, semicolon - amp - 1);
+    uint32_t code_point;
+    if (entity == "lt") {
+      out->push_back('<');
+    } else if (entity == "gt") {
+      out->push_back('>');
+    } else if (entity == "amp") {
+      out->push_back('&');
+    } else if (entity == "quot") {
+      out->push_back('"');
+    } else if (entity == "apos") {
+      out->push_back('\'');
+    } else if (ParseCharacterReference(entity, &code_point)) {
+      AppendUtf8(code_point, out);
+    } else {
+      // Unknown entity: kept as written.
+      out->push_back('&');
+      i = amp + 1;
+      continue;
+    }
+    i = semicolon + 1;
+  }
+}
+
+// static
+void XmlPullParser::AppendLiteral(std::string_view literal,
+                                  Normalization normalization,
+                                  std::string* out) {
+  if (normalization == Normalization::kNone) {
+    out->append(literal.data(), literal.size());
+    return;
+  }
+  // Line ends become a line feed in character data (2.11), and whitespace a
+  // space in attribute values (3.3.3), a CR LF pair counting as one.
+  bool attribute = normalization == Normalization::kAttribute;
+  const char* special = attribute ? "\r\n\t" : "\r";
+  size_t i = 0;
+  while (true) {
+    size_t found = literal.find_first_of(special, i);
+    if (found == std::string_view::npos) {
+      out->append(literal.data() + i, literal.size() - i);
+      return;
+    }
+    out->append(literal.data() + i, found - i);
+    if (literal[found] == '\r' && found + 1 < literal.size() &&
+        literal[found + 1] == '\n') {
+      ++found;
+    }
+    out->push_back(attribute ? ' ' : '\n');
+    i = found + 1;
+  }
+}
+
+}  // namespace native_core
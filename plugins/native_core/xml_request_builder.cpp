@@ -0,0 +1,363 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/xml_request_builder.h"
+
+#include <algorithm>
+#include <string>
+
+namespace native_core {
+
+namespace {
+
+// The standard alphabet with '+' and '/' replaced by '-' and '_', as both
+// Api.base64UrlSafeEncode() and base64UrlEncode() in Dart do.
+constexpr char kUrlAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Api.base64UrlSafeEncode() also percent-encodes each padding '='.
+constexpr std::string_view kEncodedPadding = "%3D";
+
+constexpr std::string_view kXmlHeader =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+
+// Measuring pass.
+class SizeCounter {
+ public:
+  void Append(std::string_view value) { size_ += value.size(); }
+
+  size_t size() const { return size_; }
+
+ private:
+  size_t size_ = 0;
+};
+
+// Encoding pass: base64-encodes everything appended into a buffer that was
+// sized beforehand.
+class Base64Writer {
+ public:
+  explicit Base64Writer(uint8_t* out) : out_(out) {}
+
+  // Bytes the encoding of |size| bytes takes, padding included.
+  static size_t EncodedSize(size_t size) {
+    size_t remainder = size % 3;
+    return size / 3 * 4 +
+           (remainder == 0 ? 0
+                           : remainder + 1 +
+                                 (3 - remainder) * kEncodedPadding.size());
+  }
+
+  void Append(std::string_view value) {
+    const auto* data = reinterpret_cast<const uint8_t*>(value.data());
+    size_t size = value.size();
+    // Completes a triple left over from the previous call.
+    while (pending_size_ > 0 && pending_size_ < 3 && size > 0) {
+      pending_[pending_size_++] = *data++;
+      --size;
+    }
+    if (pending_size_ == 3) {
+      EncodeTriple(pending_);
+      pending_size_ = 0;
+    }
+    for (; size >= 3; data += 3, size -= 3) {
+      EncodeTriple(data);
+    }
+    for (; size > 0; --size) {
+      pending_[pending_size_++] = *data++;
+    }
+  }
+
+  // Encodes the last partial triple.
+  void Finish() {
+    if (pending_size_ == 0) {
+      return;
+    }
+    uint8_t b0 = pending_[0];
+    uint8_t b1 = pending_size_ > 1 ? pending_[1] : 0;
+    *out_++ = kUrlAlphabet[b0 >> 2];
+    *out_++ = kUrlAlphabet[((b0 & 0x03) << 4) | (b1 >> 4)];
+    if (pending_size_ > 1) {
+      *out_++ = kUrlAlphabet[(b1 & 0x0F) << 2];
+    }
+    for (size_t i = pending_size_; i < 3; ++i) {
+      for (char c : kEncodedPadding) {
+        *out_++ = static_cast<uint8_t>(c);
+      }
+    }
+    pending_size_ = 0;
+  }
+
+ private:
+  void EncodeTriple(const uint8_t* triple) {
+    uint32_t bits = (uint32_t{triple[0]} << 16) | (uint32_t{triple[1]} << 8) |
+                    triple[2];
+    out_[0] = kUrlAlphabet[(bits >> 18) & 0x3F];
+    out_[1] = kUrlAlphabet[(bits >> 12) & 0x3F];
+    out_[2] = kUrlAlphabet[(bits >> 6) & 0x3F];
+    out_[3] = kUrlAlphabet[bits & 0x3F];
+    out_ += 4;
+  }
+
+  uint8_t* out_;
+  uint8_t pending_[3] = {0, 0, 0};
+  size_t pending_size_ = 0;
+};
+
+// Dart interpolation of a String?.
+std::string_view OrNull(const OptionalString& value) {
+  return value ? *value : std::string_view("null");
+}
+
+// Dart's base64UrlEncode(), padding included.
+std::string Base64UrlEncode(std::string_view value) {
+  std::string encoded;
+  encoded.reserve((value.size() + 2) / 3 * 4);
+  const auto* data = reinterpret_cast<const uint8_t*>(value.data());
+  size_t i = 0;
+  for (; i + 3 <= value.size(); i += 3) {
+    uint32_t bits = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) |
+                    data[i + 2];
+    encoded += kUrlAlphabet[(bits >> 18) & 0x3F];
+    encoded += kUrlAlphabet[(bits >> 12) & 0x3F];
+    encoded += kUrlAlphabet[(bits >> 6) & 0x3F];
+    encoded += kUrlAlphabet[bits & 0x3F];
+  }
+  size_t remainder = value.size() - i;
+  if (remainder > 0) {
+    uint32_t bits = uint32_t{data[i]} << 16;
+    if (remainder == 2) {
+      bits |= uint32_t{data[i + 1]} << 8;
+    }
+    encoded += kUrlAlphabet[(bits >> 18) & 0x3F];
+    encoded += kUrlAlphabet[(bits >> 12) & 0x3F];
+    encoded += remainder == 2 ? kUrlAlphabet[(bits >> 6) & 0x3F] : '=';
+    encoded += '=';
+  }
+  return encoded;
+}
+
+// Runs |write| over a SizeCounter and then over a Base64Writer that targets
+// the body buffer, sized exactly from the first pass.
+template <typename Write>
+std::vector<uint8_t> BuildBody(std::string_view operation, Write write) {
+  SizeCounter counter;
+  write(counter);
+
+  constexpr std::string_view kOperation = "op=";
+  constexpr std::string_view kData = "&dat=";
+  std::vector<uint8_t> body(kOperation.size() + operation.size() +
+                            kData.size() +
+                            Base64Writer::EncodedSize(counter.size()));
+  uint8_t* out = body.data();
+  for (std::string_view part : {kOperation, operation, kData}) {
+    for (char c : part) {
+      *out++ = static_cast<uint8_t>(c);
+    }
+  }
+  Base64Writer writer(out);
+  write(writer);
+  writer.Finish();
+  return body;
+}
+
+}  // namespace
+
+std::vector<uint8_t> BuildPresignBody(
+    std::string_view operation,
+    std::string_view request_id,
+    const std::vector<PresignDocument>* documents) {
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<rqttri><reqs><req id=\"");
+    out.Append(request_id);
+    out.Append("\">");
+    if (documents) {
+      for (const PresignDocument& document : *documents) {
+        out.Append("<doc docid=\"");
+        out.Append(document.id);
+        out.Append("\" cop=\"");
+        out.Append(OrNull(document.crypto_operation));
+        out.Append("\" sigfrmt=\"");
+        out.Append(document.signature_format);
+        out.Append("\" mdalgo=\"");
+        out.Append(document.message_digest_algorithm);
+        out.Append("\"><params>");
+        out.Append(document.params.value_or(std::string_view()));
+        out.Append("</params></doc>");
+      }
+    }
+    out.Append("</req></reqs></rqttri>");
+  });
+}
+
+std::vector<uint8_t> BuildPostsignBody(
+    std::string_view operation,
+    const std::vector<PostsignRequest>& requests) {
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<rqttri><reqs>");
+    for (const PostsignRequest& request : requests) {
+      out.Append("<req id=\"");
+      out.Append(request.ref);
+      out.Append(request.status_ok ? "\" status=\"OK\">" : "\" status=\"KO\">");
+      if (request.status_ok) {
+        for (const PostsignDocument& document : request.documents) {
+          out.Append("<doc docid=\"");
+          out.Append(OrNull(document.id));
+          out.Append("\" cop=\"");
+          out.Append(OrNull(document.crypto_operation));
+          out.Append("\" sigfrmt=\"");
+          out.Append(OrNull(document.signature_format));
+          out.Append("\" mdalgo=\"");
+          out.Append(OrNull(document.message_digest_algorithm));
+          out.Append("\"><params>");
+          out.Append(document.params.value_or(std::string_view()));
+          out.Append("</params><result>");
+          for (const auto& [key, value] : document.result) {
+            out.Append("<p n='");
+            out.Append(key);
+            out.Append("'>");
+            out.Append(value);
+            out.Append("</p>");
+          }
+          out.Append("</result></doc>");
+        }
+      }
+      out.Append("</req>");
+    }
+    out.Append("</reqs></rqttri>");
+  });
+}
+
+std::vector<uint8_t> BuildApproveBody(
+    std::string_view operation,
+    const std::vector<std::string_view>& request_ids) {
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<apprv><reqs>");
+    for (std::string_view id : request_ids) {
+      out.Append("<r id=\"");
+      out.Append(id);
+      out.Append("\"/>");
+    }
+    out.Append("</reqs></apprv>");
+  });
+}
+
+std::vector<uint8_t> BuildRejectBody(
+    std::string_view operation,
+    const std::vector<std::string_view>& request_ids,
+    std::string_view reason) {
+  std::string encoded_reason = Base64UrlEncode(reason);
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<reqrjcts>");
+    if (!reason.empty()) {
+      out.Append("<rsn>");
+      out.Append(encoded_reason);
+      out.Append("</rsn>");
+    }
+    out.Append("<rjcts>");
+    for (std::string_view id : request_ids) {
+      out.Append("<rjct id=\"");
+      out.Append(id);
+      out.Append("\"/>");
+    }
+    out.Append("</rjcts></reqrjcts>");
+  });
+}
+
+std::vector<uint8_t> BuildRequestListBody(
+    std::string_view operation,
+    std::string_view state,
+    const std::vector<std::string_view>* filters,
+    int page,
+    int page_size) {
+  std::string page_text = std::to_string(page);
+  std::string page_size_text = std::to_string(page_size);
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<rqtlst state=\"");
+    out.Append(state);
+    out.Append("\" pg=\"");
+    out.Append(page_text);
+    out.Append("\" sz=\"");
+    out.Append(page_size_text);
+    out.Append("\"><fmts>");
+    for (std::string_view format : {"CAdES", "XAdES", "PDF"}) {
+      out.Append("<fmt>");
+      out.Append(format);
+      out.Append("</fmt>");
+    }
+    out.Append("</fmts>");
+    if (filters && !filters->empty()) {
+      out.Append("<fltrs>");
+      for (std::string_view filter : *filters) {
+        size_t equal_pos = std::min(filter.find('='), filter.size());
+        out.Append("<fltr><key>");
+        out.Append(filter.substr(0, equal_pos));
+        out.Append("</key><value>");
+        if (equal_pos + 1 < filter.size()) {
+          out.Append(filter.substr(equal_pos + 1));
+        }
+        out.Append("</value></fltr>");
+      }
+      out.Append("</fltrs>");
+    }
+    out.Append("</rqtlst>");
+  });
+}
+
+std::vector<uint8_t> BuildRequestDetailBody(std::string_view operation,
+                                            std::string_view request_id) {
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<rqtdtl id=\"");
+    out.Append(request_id);
+    out.Append("\"></rqtdtl>");
+  });
+}
+
+std::vector<uint8_t> BuildPreviewBody(std::string_view operation,
+                                      std::string_view document_id) {
+  return BuildBody(operation, [&](auto& out) {
+    out.Append(kXmlHeader);
+    out.Append("<rqtprw docid=\"");
+    out.Append(document_id);
+    out.Append("\"></rqtprw>");
+  });
+}
+
+std::vector<uint8_t> BuildLoginRequestBody(std::string_view operation) {
+  // Api.loginRequest() encodes with base64UrlEncode() rather than
+  // base64UrlSafeEncode(), but nine bytes need no padding, so both agree.
+  return BuildBody(operation, [&](auto& out) { out.Append("<lgnrq />"); });
+}
+
+std::vector<uint8_t> BuildLoginValidationBody(std::string_view operation,
+                                              std::string_view certificate,
+                                              std::string_view pkcs1) {
+  return BuildBody(operation, [&](auto& out) {
+    out.Append("<rqtvl><cert>");
+    out.Append(certificate);
+    out.Append("</cert><pkcs1>");
+    out.Append(pkcs1);
+    out.Append("</pkcs1></rqtvl>");
+  });
+}
+
+std::vector<uint8_t> BuildLogoutBody(std::string_view operation) {
+  return BuildBody(operation, [&](auto& out) { out.Append("<lgorq />"); });
+}
+
+}  // namespace native_core
@@ -0,0 +1,154 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/native_core/xml_subtree.h"
+
+#include <utility>
+
+namespace native_core {
+
+namespace {
+
+std::string ToLowerAscii(std::string_view value) {
+  std::string lower(value);
+  for (char& c : lower) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  return lower;
+}
+
+}  // namespace
+
+void XmlSubtree::Clear() {
+  chars_.clear();
+  nodes_.clear();
+  attributes_.clear();
+  open_.clear();
+}
+
+void XmlSubtree::StartElement(const XmlPullParser& parser) {
+  Node node;
+  node.kind = NodeKind::kElement;
+  node.name = Store(parser.name());
+  node.lowercase_name = Store(ToLowerAscii(parser.name()));
+  node.first_attribute = static_cast<uint32_t>(attributes_.size());
+  node.attribute_count = static_cast<uint32_t>(parser.attributes().size());
+  for (const auto& attribute : parser.attributes()) {
+    AttributeSpans spans;
+    spans.lowercase_name = Store(ToLowerAscii(attribute.name));
+    spans.value = Store(attribute.value);
+    attributes_.push_back(spans);
+  }
+  open_.push_back(Append(node));
+}
+
+void XmlSubtree::EndElement() {
+  nodes_[open_.back()].subtree_end = static_cast<NodeId>(nodes_.size());
+  open_.pop_back();
+}
+
+void XmlSubtree::AddText(std::string_view text) {
+  Node node;
+  node.kind = NodeKind::kText;
+  node.text = Store(text);
+  Append(node);
+}
+
+void XmlSubtree::AddOther() {
+  Node node;
+  node.kind = NodeKind::kOther;
+  Append(node);
+}
+
+std::string_view XmlSubtree::name(NodeId node) const {
+  return View(nodes_[node].name);
+}
+
+std::string_view XmlSubtree::lowercase_name(NodeId node) const {
+  return View(nodes_[node].lowercase_name);
+}
+
+XmlSubtree::NodeId XmlSubtree::FindChild(
+    NodeId node, std::string_view lowercase_name) const {
+  for (NodeId child = nodes_[node].first_child; child != kNone;
+       child = nodes_[child].next_sibling) {
+    if (nodes_[child].kind == NodeKind::kElement &&
+        View(nodes_[child].lowercase_name) == lowercase_name) {
+      return child;
+    }
+  }
+  return kNone;
+}
+
+bool XmlSubtree::FindAttribute(NodeId node, std::string_view lowercase_name,
+                               std::string_view* value) const {
+  const Node& element = nodes_[node];
+  for (uint32_t i = 0; i < element.attribute_count; ++i) {
+    const AttributeSpans& spans = attributes_[element.first_attribute + i];
+    if (View(spans.lowercase_name) == lowercase_name) {
+      *value = View(spans.value);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string XmlSubtree::Text(NodeId node) const {
+  if (nodes_[node].kind == NodeKind::kText) {
+    return std::string(View(nodes_[node].text));
+  }
+  // Nodes are stored in document order, so the descendants of |node| are the
+  // nodes up to the end of its subtree.
+  NodeId end = nodes_[node].subtree_end == kNone
+                   ? static_cast<NodeId>(nodes_.size())
+                   : nodes_[node].subtree_end;
+  std::string text;
+  for (NodeId i = node + 1; i < end; ++i) {
+    if (nodes_[i].kind == NodeKind::kText) {
+      std::string_view part = View(nodes_[i].text);
+      text.append(part.data(), part.size());
+    }
+  }
+  return text;
+}
+
+XmlSubtree::Span XmlSubtree::Store(std::string_view value) {
+  Span span;
+  span.offset = static_cast<uint32_t>(chars_.size());
+  span.length = static_cast<uint32_t>(value.size());
+  chars_.append(value.data(), value.size());
+  return span;
+}
+
+std::string_view XmlSubtree::View(Span span) const {
+  return std::string_view(chars_.data() + span.offset, span.length);
+}
+
+XmlSubtree::NodeId XmlSubtree::Append(Node node) {
+  NodeId id = static_cast<NodeId>(nodes_.size());
+  if (!open_.empty()) {
+    Node& parent = nodes_[open_.back()];
+    if (parent.last_child == kNone) {
+      parent.first_child = id;
+    } else {
+      nodes_[parent.last_child].next_sibling = id;
+    }
+    parent.last_child = id;
+  }
+  nodes_.push_back(node);
+  return id;
+}
+
+}  // namespace native_core
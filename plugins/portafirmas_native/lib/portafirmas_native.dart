@@ -0,0 +1,690 @@
+/*
+    Copyright 2022. Chema Molins.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        https://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+import 'dart:async';
+import 'dart:convert';
+import 'dart:io' show Platform;
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import 'package:flutter/widgets.dart';
+
+const MethodChannel _channel = MethodChannel('portafirmas_native');
+
+/// Whether the native helpers are available on this platform.
+bool get isNativeSupported => !kIsWeb && Platform.isWindows;
+
+/// Code of the [PlatformException] of a call refused because the native
+/// worker pool is saturated. Such a call did nothing and can be made again.
+const String nativeBusyCode = 'busy';
+
+/// Times a call refused as busy is made before giving up.
+const int _busyAttempts = 5;
+
+/// Makes [call] again, after a growing delay, while it is refused with
+/// [nativeBusyCode]. The last refusal is rethrown so that the caller can fall
+/// back.
+Future<T> _retryWhileBusy<T>(Future<T> Function() call) async {
+  Duration delay = const Duration(milliseconds: 20);
+  for (int attempt = 1;; attempt++) {
+    try {
+      return await call();
+    } on PlatformException catch (e) {
+      if (e.code != nativeBusyCode || attempt == _busyAttempts) rethrow;
+    }
+    await Future<void>.delayed(delay);
+    delay *= 2;
+  }
+}
+
+/// Kinds of proxy response understood by [NativeResponseParser]. The indices
+/// match native_core::ResponseKind.
+enum ResponseKind { requestList, requestDetail, presign, postsign }
+
+/// Outcome of a native parse: the error reported, if any, and the record
+/// tables laid out as described in native_core/proxy_response_parsers.h.
+class ParsedResponse {
+  /// Malformed XML.
+  final String? syntaxError;
+
+  /// Text of an <err> element found anywhere in the response.
+  final String? proxyError;
+
+  /// Content rejected with the same message the Dart parsers would use.
+  final String? error;
+
+  final Uint8List _strings;
+  final Int32List _stringEnds;
+
+  /// Tables by name.
+  final Map<String, Int32List> tables;
+
+  ParsedResponse._(this.syntaxError, this.proxyError, this.error, this._strings, this._stringEnds,
+      this.tables);
+
+  factory ParsedResponse._fromMap(Map<Object?, Object?> map) {
+    return ParsedResponse._(
+      map['syntaxError'] as String?,
+      map['proxyError'] as String?,
+      map['error'] as String?,
+      map['strings']! as Uint8List,
+      map['stringEnds']! as Int32List,
+      (map['tables']! as Map<Object?, Object?>)
+          .map((name, cells) => MapEntry(name! as String, cells! as Int32List)),
+    );
+  }
+
+  /// Returns string [index] of a table cell, or null for -1.
+  String? string(int index) {
+    if (index < 0) return null;
+    int start = index == 0 ? 0 : _stringEnds[index - 1];
+    return utf8.decode(Uint8List.sublistView(_strings, start, _stringEnds[index]));
+  }
+}
+
+/// Streaming parser for the proxy responses, run by the native_core library.
+///
+/// The response is fed in chunks as it arrives and tokenized on a native
+/// worker thread, so neither the whole body nor a DOM is ever held in Dart.
+class NativeResponseParser {
+  /// Chunks are coalesced up to this size before crossing the channel.
+  static const int _feedSize = 64 * 1024;
+
+  /// Whether the native parser is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  final int _id;
+
+  NativeResponseParser._(this._id);
+
+  static Future<NativeResponseParser> create(ResponseKind kind) async {
+    int id = (await _channel.invokeMethod<int>('createParser', {'kind': kind.index}))!;
+    return NativeResponseParser._(id);
+  }
+
+  /// Parses the whole of [bytes] as a response of the given [kind].
+  static Future<ParsedResponse> parseStream(ResponseKind kind, Stream<List<int>> bytes) async {
+    NativeResponseParser parser = await create(kind);
+    try {
+      BytesBuilder pending = BytesBuilder(copy: false);
+      await for (List<int> chunk in bytes) {
+        pending.add(chunk);
+        if (pending.length >= _feedSize) {
+          await parser.feed(pending.takeBytes());
+        }
+      }
+      if (pending.isNotEmpty) {
+        await parser.feed(pending.takeBytes());
+      }
+    } catch (e) {
+      await parser.dispose();
+      rethrow;
+    }
+    return parser.finish();
+  }
+
+  /// Feeds the next chunk of the response. Wait for each call to complete
+  /// before making the next one.
+  Future<void> feed(Uint8List data) {
+    return _retryWhileBusy(() => _channel.invokeMethod<void>('feed', {'id': _id, 'data': data}));
+  }
+
+  /// Marks the end of the response and returns the outcome. The parser cannot
+  /// be used afterwards.
+  Future<ParsedResponse> finish() async {
+    Map<Object?, Object?> result = (await _retryWhileBusy(
+        () => _channel.invokeMethod<Map<Object?, Object?>>('finish', {'id': _id})))!;
+    return ParsedResponse._fromMap(result);
+  }
+
+  /// Releases a parser that will not be finished.
+  Future<void> dispose() {
+    return _channel.invokeMethod<void>('disposeParser', {'id': _id});
+  }
+}
+
+/// Response of a [NativeHttpClient] request.
+class NativeHttpResponse {
+  final int statusCode;
+
+  /// Names are lowercased and repeated headers joined with ',', as in
+  /// package:http.
+  final Map<String, String> headers;
+
+  /// The body, for [NativeHttpClient.post], and for
+  /// [NativeHttpClient.postParsed] with `keepBody`.
+  final Uint8List? bodyBytes;
+
+  /// The body as parsed while it arrived, for [NativeHttpClient.postParsed].
+  final ParsedResponse? parsed;
+
+  NativeHttpResponse._(this.statusCode, this.headers, this.bodyBytes, this.parsed);
+
+  factory NativeHttpResponse._fromMap(Map<Object?, Object?> map) {
+    Map<Object?, Object?>? parsed = map['parsed'] as Map<Object?, Object?>?;
+    return NativeHttpResponse._(
+      map['status']! as int,
+      (map['headers']! as Map<Object?, Object?>)
+          .map((name, value) => MapEntry(name! as String, value! as String)),
+      map['body'] as Uint8List?,
+      parsed == null ? null : ParsedResponse._fromMap(parsed),
+    );
+  }
+}
+
+/// HTTP client of the native_core library, shared by the whole application
+/// and by [NativeTriphaseEngine].
+///
+/// Connections to the proxy are kept alive and reused, and new ones resume
+/// the TLS session of earlier ones. The JSESSIONID cookie received from the
+/// proxy is sent with the requests that carry no Cookie header.
+///
+/// Responses are asked for compressed and decoded natively. Request bodies
+/// are only compressed for the servers opted in with [compressRequests].
+///
+/// Requests that get no response fail with a [PlatformException].
+class NativeHttpClient {
+  /// Whether the native client is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// Posts [body] to [url].
+  static Future<NativeHttpResponse> post(Uri url,
+      {required Map<String, String> headers, required Uint8List body}) {
+    return _post({'url': url.toString(), 'headers': headers, 'body': body});
+  }
+
+  /// Posts [body] to [url] and parses the response as a response of the
+  /// given [kind] while it arrives, so that it never crosses the channel.
+  /// A request list parsed without errors is also merged into the
+  /// [NativeRequestListCache] under [cacheKey], and added to the
+  /// [NativeSearchIndex] under [indexState]. With [keepBody] the body is
+  /// also returned, e.g. to log it.
+  static Future<NativeHttpResponse> postParsed(ResponseKind kind, Uri url,
+      {required Map<String, String> headers,
+      required Uint8List body,
+      RequestListCacheKey? cacheKey,
+      String? indexState,
+      bool keepBody = false}) {
+    return _post({
+      'url': url.toString(),
+      'headers': headers,
+      'body': body,
+      'kind': kind.index,
+      'cache': cacheKey?._toMap(),
+      'index': indexState,
+      'keepBody': keepBody,
+    });
+  }
+
+  static Future<NativeHttpResponse> _post(Map<String, Object?> arguments) async {
+    Map<Object?, Object?> result =
+        (await _channel.invokeMethod<Map<Object?, Object?>>('httpPost', arguments))!;
+    return NativeHttpResponse._fromMap(result);
+  }
+
+  /// Request, connection and TLS handshake counters, compressed and decoded
+  /// byte counts, and request times in microseconds for new and reused
+  /// connections.
+  static Future<Map<String, int>> stats() async {
+    Map<String, int>? stats = await _channel.invokeMapMethod<String, int>('httpStats');
+    return stats ?? {};
+  }
+
+  /// Forgets the session cookie, e.g. on logout.
+  static Future<void> clearSession() {
+    return _channel.invokeMethod<void>('httpClearSession');
+  }
+
+  /// Sends the larger request bodies to the server of [url] gzip-compressed,
+  /// or stops doing so. Only for servers known to decode them: a server that
+  /// answers 415 is sent the body again uncompressed, and no compressed one
+  /// after that.
+  static Future<void> compressRequests(Uri url, {bool enabled = true}) {
+    return _channel.invokeMethod<void>(
+        'httpCompressRequests', {'url': url.toString(), 'enabled': enabled});
+  }
+}
+
+/// Identifies a cached request list: the first page of the requests in one
+/// state on one server.
+class RequestListCacheKey {
+  final String server;
+  final String state;
+
+  const RequestListCacheKey(this.server, this.state);
+
+  Map<String, String> _toMap() => {'server': server, 'state': state};
+}
+
+/// On-disk cache of the first page of the request lists, so that the last
+/// known list can be shown at startup before the proxy answers.
+///
+/// Lists are stored by [NativeHttpClient.postParsed]. Only the requests that
+/// changed since the last time are written again.
+class NativeRequestListCache {
+  /// Whether the native cache is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// Keeps the cache files in the existing [directory].
+  static Future<void> open(String directory) {
+    return _channel.invokeMethod<void>('cacheOpen', {'directory': directory});
+  }
+
+  /// The cached list, as parsed from a response, or null if there is none.
+  /// Its requests are also added to the [NativeSearchIndex].
+  static Future<ParsedResponse?> load(RequestListCacheKey key) async {
+    Map<Object?, Object?>? result = await _retryWhileBusy(
+        () => _channel.invokeMethod<Map<Object?, Object?>>('cacheLoad', key._toMap()));
+    return result == null ? null : ParsedResponse._fromMap(result);
+  }
+
+  static Future<void> remove(RequestListCacheKey key) {
+    return _retryWhileBusy(() => _channel.invokeMethod<void>('cacheRemove', key._toMap()));
+  }
+}
+
+/// Requests matching a [NativeSearchIndex.query].
+class NativeSearchResult {
+  /// Ids of the first matches, in the order they were indexed.
+  final List<String> ids;
+
+  /// Number of matches, including those beyond [ids].
+  final int total;
+
+  const NativeSearchResult(this.ids, this.total);
+}
+
+/// In-memory index over the requests of the lists fetched with
+/// [NativeHttpClient.postParsed] and loaded from the
+/// [NativeRequestListCache], for searching as the user types without asking
+/// the proxy.
+///
+/// The id, subject and sender of the requests and the names of their
+/// documents are searched ignoring case and accents. A request matches when
+/// every word of the query starts a word of one of them.
+class NativeSearchIndex {
+  /// Whether the native index is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// The requests in [state] (in any state if null) matching [text], at most
+  /// [limit] of them.
+  static Future<NativeSearchResult> query(String text, {String? state, int limit = 50}) async {
+    Map<Object?, Object?> result = (await _channel.invokeMethod<Map<Object?, Object?>>(
+        'searchQuery', {'text': text, 'state': state, 'limit': limit}))!;
+    return NativeSearchResult(
+        (result['ids'] as List<Object?>).cast<String>(), result['total'] as int);
+  }
+
+  /// Forgets every request, e.g. when the user changes.
+  static Future<void> clear() {
+    return _channel.invokeMethod<void>('searchClear');
+  }
+
+  /// Requests, distinct words and word occurrences indexed.
+  static Future<Map<String, int>> stats() async {
+    Map<String, int>? stats = await _channel.invokeMapMethod<String, int>('searchStats');
+    return stats ?? {};
+  }
+}
+
+/// Journal of the signatures produced by [NativeTriphaseEngine.signBatch],
+/// kept until the proxy answers their postsign, so that a batch interrupted
+/// by a crash or a lost connection can be finished with
+/// [NativeTriphaseEngine.resumeBatch] without signing again.
+///
+/// Requests are journaled per owner, the server and user they were signed
+/// for.
+class NativeSigningJournal {
+  /// Whether the native journal is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// Opens the journal at [path], creating it if needed.
+  static Future<void> open(String path) {
+    return _retryWhileBusy(() => _channel.invokeMethod<void>('journalOpen', {'path': path}));
+  }
+
+  /// Requests of [owner] signed and not postsigned yet.
+  static Future<int> pendingCount(String owner) async {
+    return (await _channel.invokeMethod<int>('journalPending', {'owner': owner}))!;
+  }
+}
+
+/// Log file written natively from a background thread.
+///
+/// [write] only queues the record; records cross the channel in batches,
+/// one call every 50 ms or 64 KiB of text, and are written in the
+/// order they were written. The file is rotated by size: it becomes
+/// "<path>.1" (or "<path>.1.gz"), the previous one "<path>.2" and so on.
+///
+/// What is still queued is sent when the application is paused or detached,
+/// since it may not come back to send it.
+class NativeLogSink {
+  /// Whether the native sink is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  static const Duration _batchDelay = Duration(milliseconds: 50);
+  static const int _batchChars = 64 * 1024;
+
+  static final List<String> _batch = [];
+  static int _batchLength = 0;
+  static Timer? _batchTimer;
+  static _LogSinkLifecycle? _lifecycle;
+
+  /// Opens the log at [path], replacing any open one. With [truncate] the
+  /// file starts empty.
+  static Future<void> open(String path,
+      {bool truncate = false,
+      int maxFileBytes = 8 * 1024 * 1024,
+      int maxRotatedFiles = 3,
+      bool compressRotated = true}) {
+    // Records queued before go to the log open until now.
+    _sendBatch();
+    if (_lifecycle == null) {
+      _lifecycle = _LogSinkLifecycle();
+      WidgetsBinding.instance.addObserver(_lifecycle!);
+    }
+    return _channel.invokeMethod<void>('logOpen', {
+      'path': path,
+      'truncate': truncate,
+      'maxFileBytes': maxFileBytes,
+      'maxRotatedFiles': maxRotatedFiles,
+      'compressRotated': compressRotated,
+    });
+  }
+
+  /// Queues [record], which should end with its own line break. Records
+  /// written before [open] completes are still written to the file.
+  ///
+  /// With [flush], meant for errors, the record and those queued before it
+  /// are sent right away, and the native side writes them to the file before
+  /// it handles any other call.
+  static void write(String record, {bool flush = false}) {
+    _batch.add(record);
+    _batchLength += record.length;
+    if (flush || _batchLength >= _batchChars) {
+      _sendBatch(flush: flush);
+    } else {
+      _batchTimer ??= Timer(_batchDelay, _sendBatch);
+    }
+  }
+
+  /// Completes once every record written so far is in the file.
+  static Future<void> flush() {
+    _sendBatch();
+    return _retryWhileBusy(() => _channel.invokeMethod<void>('logFlush'));
+  }
+
+  static void _sendBatch({bool flush = false}) {
+    _batchTimer?.cancel();
+    _batchTimer = null;
+    if (_batch.isEmpty) {
+      return;
+    }
+    List<String> records = List.of(_batch);
+    _batch.clear();
+    _batchLength = 0;
+    unawaited(_channel.invokeMethod<void>('logWrite', {'records': records, 'flush': flush}));
+  }
+
+  /// Records written and dropped, bytes written, batches and rotations.
+  static Future<Map<String, int>> stats() async {
+    Map<String, int>? stats = await _channel.invokeMapMethod<String, int>('logStats');
+    return stats ?? {};
+  }
+}
+
+/// Sends what [NativeLogSink] still holds when the application is paused or
+/// detached.
+class _LogSinkLifecycle extends WidgetsBindingObserver {
+  @override
+  void didChangeAppLifecycleState(AppLifecycleState state) {
+    if (state == AppLifecycleState.paused || state == AppLifecycleState.detached) {
+      unawaited(NativeLogSink.flush());
+    }
+  }
+}
+
+/// Builds the form bodies ("op=...&dat=...") of the batch requests natively.
+/// The XML is encoded as it is generated, so it is never held as a string;
+/// the result is byte for byte what XmlRequestFactory followed by
+/// Api.base64UrlSafeEncode produce.
+class NativeRequestBuilder {
+  /// Whether the native builder is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// Each document is [id, cop, sigfrmt, mdalgo, params].
+  static Future<Uint8List> presignBody(
+      String operation, String requestId, List<List<String?>>? documents) {
+    return _build('buildPresignBody', {'op': operation, 'id': requestId, 'docs': documents});
+  }
+
+  /// Each request is [ref, statusOk, documents], and each document
+  /// [id, cop, sigfrmt, mdalgo, params, [key, value, key, value...]].
+  static Future<Uint8List> postsignBody(String operation, List<List<Object?>> requests) {
+    return _build('buildPostsignBody', {'op': operation, 'reqs': requests});
+  }
+
+  static Future<Uint8List> approveBody(String operation, List<String> requestIds) {
+    return _build('buildApproveBody', {'op': operation, 'ids': requestIds});
+  }
+
+  static Future<Uint8List> rejectBody(String operation, List<String> requestIds, String reason) {
+    return _build('buildRejectBody', {'op': operation, 'ids': requestIds, 'reason': reason});
+  }
+
+  static Future<Uint8List> _build(String method, Map<String, Object?> arguments) async {
+    return (await _channel.invokeMethod<Uint8List>(method, arguments))!;
+  }
+}
+
+/// CAdES-BES signatures built natively in one pass with the certificate
+/// selected with DigitalCertificates: the CMS structure the proxy builds in
+/// the presign and postsign phases, without asking it.
+class NativeCadesSigner {
+  /// Whether the native signer is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// The DER-encoded CMS SignedData of [data], hashed with [digestAlgorithm]
+  /// ("SHA-256", "SHA-512"...). With [attached] the data is carried in the
+  /// signature; otherwise the signature is detached.
+  static Future<Uint8List> sign(Uint8List data,
+      {String digestAlgorithm = 'SHA-512', bool attached = false}) async {
+    return (await _retryWhileBusy(() => _channel.invokeMethod<Uint8List>(
+        'cadesSign', {'data': data, 'digest': digestAlgorithm, 'attached': attached})))!;
+  }
+}
+
+/// PAdES signatures of PDF files built natively with the certificate selected
+/// with DigitalCertificates, as an incremental update of the file. The file
+/// is streamed from disk, never loaded whole, so its size does not matter.
+class NativePadesSigner {
+  /// Whether the native signer is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// Signs the PDF file at [inputPath] into a new file at [outputPath],
+  /// hashing with [digestAlgorithm] ("SHA-256", "SHA-512"...). [reason] and
+  /// [location] go in the signature dictionary when given.
+  static Future<void> sign(String inputPath, String outputPath,
+      {String digestAlgorithm = 'SHA-256', String? reason, String? location}) {
+    return _retryWhileBusy(() => _channel.invokeMethod<void>('padesSign', {
+          'input': inputPath,
+          'output': outputPath,
+          'digest': digestAlgorithm,
+          'reason': reason,
+          'location': location,
+        }));
+  }
+}
+
+/// Why a request of a [NativeTriphaseEngine] batch failed. The indices match
+/// native_core::TriphaseFailure.
+enum TriphaseFailure {
+  none,
+
+  /// What Api reports as a NetworkException.
+  network,
+
+  /// Any other exception while presigning or postsigning.
+  error,
+
+  /// The presign response marked the request as failed.
+  presign,
+
+  /// Signing one of the documents failed.
+  signature,
+
+  /// The batch was cancelled before the request was sent.
+  cancelled,
+}
+
+/// Outcome of one request of a batch.
+class TriphaseOutcome {
+  /// Position of the request in the batch.
+  final int index;
+
+  /// The request id, or the reference returned by the postsign.
+  final String id;
+
+  final bool statusOk;
+
+  final TriphaseFailure failure;
+
+  /// Description of the failure, for the logs.
+  final String detail;
+
+  TriphaseOutcome._(this.index, this.id, this.statusOk, this.failure, this.detail);
+}
+
+/// Triphase signing of whole batches, run by the native_core library.
+///
+/// The phases overlap across requests: while one request is being signed the
+/// next one is presigned and the previous one postsigned, with at most
+/// [presignWindow] and [postsignWindow] requests in flight for each. Signing
+/// uses the certificate selected with DigitalCertificates.
+class NativeTriphaseEngine {
+  /// Whether the native engine is available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  static final Map<int, StreamController<TriphaseOutcome>> _batches = {};
+  static int _nextBatch = 1;
+
+  /// Signs [requests], each of them [id, documents] with documents as in
+  /// [NativeRequestBuilder.presignBody]. The stream yields one outcome per
+  /// request, in completion order, and fails if the batch cannot be started.
+  /// Cancelling the subscription cancels the requests not presigned yet.
+  ///
+  /// With a [journalOwner], signed requests are kept in the
+  /// [NativeSigningJournal] under it until the proxy answers their postsign.
+  static Stream<TriphaseOutcome> signBatch({
+    required String url,
+    required String cookie,
+    required List<List<Object?>> requests,
+    int presignWindow = 2,
+    int postsignWindow = 2,
+    String? journalOwner,
+  }) {
+    return _start('signBatch', {
+      'url': url,
+      'cookie': cookie,
+      'requests': requests,
+      'presignWindow': presignWindow,
+      'postsignWindow': postsignWindow,
+      'journalOwner': journalOwner,
+    });
+  }
+
+  /// Postsigns the requests of [journalOwner] left pending in the
+  /// [NativeSigningJournal]. Outcomes are reported as in [signBatch], with the
+  /// position of the request among the pending ones as index. Cancelling the
+  /// subscription leaves the requests not sent yet pending.
+  static Stream<TriphaseOutcome> resumeBatch({
+    required String url,
+    required String cookie,
+    required String journalOwner,
+  }) {
+    return _start('resumeBatch', {'url': url, 'cookie': cookie, 'journalOwner': journalOwner});
+  }
+
+  static Stream<TriphaseOutcome> _start(String method, Map<String, Object?> arguments) {
+    _channel.setMethodCallHandler(_handleCall);
+    int batch = _nextBatch++;
+    late StreamController<TriphaseOutcome> controller;
+    controller = StreamController<TriphaseOutcome>(
+      onListen: () {
+        _channel.invokeMethod<void>(method, {
+          'batch': batch,
+          ...arguments,
+          // ignore: avoid_types_on_closure_parameters
+        }).catchError((Object e) {
+          _batches.remove(batch);
+          controller
+            ..addError(e)
+            ..close();
+        });
+      },
+      onCancel: () {
+        if (_batches.remove(batch) != null) {
+          _channel.invokeMethod<void>('cancelBatch', {'batch': batch});
+        }
+      },
+    );
+    _batches[batch] = controller;
+    return controller.stream;
+  }
+
+  static Future<void> _handleCall(MethodCall call) async {
+    Map<Object?, Object?> arguments = call.arguments as Map<Object?, Object?>;
+    StreamController<TriphaseOutcome>? controller = _batches[arguments['batch']];
+    switch (call.method) {
+      case 'triphaseOutcome':
+        controller?.add(TriphaseOutcome._(
+          arguments['index']! as int,
+          arguments['id']! as String,
+          arguments['statusOk']! as bool,
+          TriphaseFailure.values[arguments['failure']! as int],
+          arguments['detail']! as String,
+        ));
+        break;
+      case 'triphaseDone':
+        _batches.remove(arguments['batch']);
+        await controller?.close();
+        break;
+    }
+  }
+}
+
+/// Call counts and times of the methods of the native plugins, collected as
+/// they are dispatched.
+class NativeCallStats {
+  /// Whether the stats are available on this platform.
+  static bool get isSupported => isNativeSupported;
+
+  /// For each method of [channel] called so far: "calls", "errors", and the
+  /// percentiles of the time its handler held the platform thread
+  /// ("handlerP50", "handlerP99", "handlerMax") and of the time until it was
+  /// answered ("answerP50", "answerP99", "answerMax"), in microseconds.
+  /// [channel] is "portafirmas_native" or "digital_certificates".
+  static Future<Map<String, Map<String, int>>> stats(
+      [String channel = 'portafirmas_native']) async {
+    Map<Object?, Object?>? stats =
+        await MethodChannel(channel).invokeMapMethod<Object?, Object?>('callStats');
+    return {
+      for (final entry in (stats ?? {}).entries)
+        entry.key! as String: (entry.value! as Map<Object?, Object?>).cast<String, int>(),
+    };
+  }
+}
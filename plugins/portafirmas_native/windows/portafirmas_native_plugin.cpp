@@ -0,0 +1,1201 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "include/portafirmas_native/portafirmas_native_plugin.h"
+
+#include <windows.h>
+
+#include <flutter/method_channel.h>
+#include <flutter/plugin_registrar.h>
+#include <flutter/standard_method_codec.h>
+#include <native_core/cades_signature.h>
+#include <native_core/cancellation_token.h>
+#include <native_core/http_client.h>
+#include <native_core/lazy.h>
+#include <native_core/log_sink.h>
+#include <native_core/method_dispatch.h>
+#include <native_core/pades_signer.h>
+#include <native_core/pkcs1_signer.h>
+#include <native_core/proxy_response_parsers.h>
+#include <native_core/request_list_cache.h>
+#include <native_core/runtime.h>
+#include <native_core/search_index.h>
+#include <native_core/signing_journal.h>
+#include <native_core/triphase_engine.h>
+#include <native_core/worker_pool.h>
+#include <native_core/xml_request_builder.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+  using flutter::EncodableList;
+  using flutter::EncodableMap;
+  using flutter::EncodableValue;
+
+  // A response being parsed. Calls for one parser are serialized by the Dart
+  // side, so |busy| only guards against misuse.
+  struct ParserSession {
+    std::unique_ptr<native_core::ResponseParser> parser;
+    bool busy = false;
+  };
+
+  // A string that the Dart side reads as null when |present| is false.
+  EncodableValue OptionalString(const std::string& value, bool present) {
+    return present ? EncodableValue(value) : EncodableValue();
+  }
+
+  // Copies the outcome of a finished parse into the channel representation
+  // read by ParsedResponse in lib/portafirmas_native.dart.
+  EncodableValue ToEncodable(const native_core::ResponseParser& parser) {
+    EncodableMap tables;
+    for (const auto& table : parser.tables()) {
+      tables[EncodableValue(table->name())] = EncodableValue(table->cells());
+    }
+    const std::string& bytes = parser.strings().bytes();
+    return EncodableValue(EncodableMap{
+      {EncodableValue("syntaxError"),
+       OptionalString(parser.syntax_error(), parser.has_syntax_error())},
+      {EncodableValue("proxyError"),
+       OptionalString(parser.proxy_error(), parser.has_proxy_error())},
+      {EncodableValue("error"),
+       OptionalString(parser.error(), parser.has_error())},
+      {EncodableValue("strings"),
+       EncodableValue(std::vector<uint8_t>(bytes.begin(), bytes.end()))},
+      {EncodableValue("stringEnds"), EncodableValue(parser.strings().ends())},
+      {EncodableValue("tables"), EncodableValue(std::move(tables))},
+    });
+  }
+
+  // A cached request list, in the same representation as a parse without
+  // errors.
+  EncodableValue ToEncodable(const native_core::RequestListSnapshot& snapshot) {
+    const std::string& bytes = snapshot.strings.bytes();
+    return EncodableValue(EncodableMap{
+      {EncodableValue("syntaxError"), EncodableValue()},
+      {EncodableValue("proxyError"), EncodableValue()},
+      {EncodableValue("error"), EncodableValue()},
+      {EncodableValue("strings"),
+       EncodableValue(std::vector<uint8_t>(bytes.begin(), bytes.end()))},
+      {EncodableValue("stringEnds"), EncodableValue(snapshot.strings.ends())},
+      {EncodableValue("tables"), EncodableValue(EncodableMap{
+        {EncodableValue(snapshot.list.name()), EncodableValue(snapshot.list.cells())},
+        {EncodableValue(snapshot.requests.name()), EncodableValue(snapshot.requests.cells())},
+        {EncodableValue(snapshot.docs.name()), EncodableValue(snapshot.docs.cells())},
+      })},
+    });
+  }
+
+  // Request bodies are built from the arguments in place: the builders only
+  // borrow these views, which point into the method call. A value of the
+  // wrong type fails |arguments|.
+
+  native_core::OptionalString OptionalStringAt(const native_core::MethodArguments& arguments,
+    const EncodableList& list, size_t index) {
+    const auto* value = arguments.Optional<std::string>(list, index);
+    return value ? native_core::OptionalString(*value) : std::nullopt;
+  }
+
+  std::vector<std::string_view> StringViews(const native_core::MethodArguments& arguments,
+    const EncodableList& list) {
+    std::vector<std::string_view> views;
+    views.reserve(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+      views.push_back(arguments.Get<std::string>(list, i));
+    }
+    return views;
+  }
+
+  // [id, cop, sigfrmt, mdalgo, params] lists, as sent by NativeRequestBuilder.
+  std::vector<native_core::PresignDocument> PresignDocuments(
+    const native_core::MethodArguments& arguments, const EncodableList& list) {
+    std::vector<native_core::PresignDocument> documents(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+      const auto& fields = arguments.Get<EncodableList>(list, i);
+      documents[i].id = arguments.Get<std::string>(fields, 0);
+      documents[i].crypto_operation = OptionalStringAt(arguments, fields, 1);
+      documents[i].signature_format = arguments.Get<std::string>(fields, 2);
+      documents[i].message_digest_algorithm = arguments.Get<std::string>(fields, 3);
+      documents[i].params = OptionalStringAt(arguments, fields, 4);
+    }
+    return documents;
+  }
+
+  // [ref, statusOk, documents] lists, each document being
+  // [id, cop, sigfrmt, mdalgo, params, [key, value, key, value...]].
+  std::vector<native_core::PostsignRequest> PostsignRequests(
+    const native_core::MethodArguments& arguments, const EncodableList& list) {
+    std::vector<native_core::PostsignRequest> requests(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+      const auto& fields = arguments.Get<EncodableList>(list, i);
+      requests[i].ref = arguments.Get<std::string>(fields, 0);
+      requests[i].status_ok = arguments.Get<bool>(fields, 1);
+      const auto& documents = arguments.Get<EncodableList>(fields, 2);
+      requests[i].documents.resize(documents.size());
+      for (size_t j = 0; j < documents.size(); j++) {
+        const auto& document_fields = arguments.Get<EncodableList>(documents, j);
+        native_core::PostsignDocument& document = requests[i].documents[j];
+        document.id = OptionalStringAt(arguments, document_fields, 0);
+        document.crypto_operation = OptionalStringAt(arguments, document_fields, 1);
+        document.signature_format = OptionalStringAt(arguments, document_fields, 2);
+        document.message_digest_algorithm = OptionalStringAt(arguments, document_fields, 3);
+        document.params = OptionalStringAt(arguments, document_fields, 4);
+        const auto& result = arguments.Get<EncodableList>(document_fields, 5);
+        for (size_t k = 0; k + 1 < result.size(); k += 2) {
+          document.result.emplace_back(arguments.Get<std::string>(result, k),
+            arguments.Get<std::string>(result, k + 1));
+        }
+      }
+    }
+    return requests;
+  }
+
+  // [id, documents] lists, documents being null or lists of
+  // [id, cop, sigfrmt, mdalgo, params] as in PresignDocuments().
+  std::vector<native_core::TriphaseJob> TriphaseJobs(
+    const native_core::MethodArguments& arguments, const EncodableList& list) {
+    auto optional = [&](const EncodableList& fields, size_t index) {
+      const auto* value = arguments.Optional<std::string>(fields, index);
+      return value ? std::optional<std::string>(*value) : std::nullopt;
+    };
+    std::vector<native_core::TriphaseJob> jobs(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+      const auto& fields = arguments.Get<EncodableList>(list, i);
+      jobs[i].id = arguments.Get<std::string>(fields, 0);
+      const auto* documents = arguments.Optional<EncodableList>(fields, 1);
+      if (!documents) {
+        continue;
+      }
+      jobs[i].documents.emplace();
+      for (size_t j = 0; j < documents->size(); j++) {
+        const auto& document_fields = arguments.Get<EncodableList>(*documents, j);
+        jobs[i].documents->push_back({
+          arguments.Get<std::string>(document_fields, 0),
+          optional(document_fields, 1),
+          arguments.Get<std::string>(document_fields, 2),
+          arguments.Get<std::string>(document_fields, 3),
+          optional(document_fields, 4),
+        });
+      }
+    }
+    return jobs;
+  }
+
+  // A batch being signed by the triphase engine on a thread of its own.
+  struct TriphaseBatch {
+    std::thread thread;
+    native_core::CancellationSource cancellation;
+  };
+
+  // Requests to the proxy in flight at once; also the connections kept alive.
+  constexpr size_t kHttpConnections = 4;
+
+  // Requests allowed to wait for a connection before "httpPost" reports busy.
+  constexpr size_t kHttpQueueCapacity = 64;
+
+  // Answers a call whose work the saturated worker pool refused. Nothing has
+  // been done, so the Dart side may retry it, as it does "httpPost".
+  void ReplyBusy(flutter::MethodResult<EncodableValue>* result) {
+    result->Error("busy", "Demasiadas tareas en curso.");
+  }
+
+  // Counters and request times of the HTTP client, in microseconds, as read
+  // by NativeHttpClient.stats().
+  EncodableValue ToEncodable(const native_core::HttpClient& client) {
+    native_core::HttpStats stats = client.stats();
+    auto count = [](uint64_t value) {
+      return EncodableValue(static_cast<int64_t>(value));
+    };
+    auto micros = [](std::chrono::nanoseconds duration) {
+      return EncodableValue(static_cast<int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    };
+    return EncodableValue(EncodableMap{
+      {EncodableValue("requests"), count(stats.requests)},
+      {EncodableValue("failures"), count(stats.failures)},
+      {EncodableValue("connectionsOpened"), count(stats.connections_opened)},
+      {EncodableValue("connectionsReused"), count(stats.connections_reused)},
+      {EncodableValue("tlsFullHandshakes"), count(stats.tls_full_handshakes)},
+      {EncodableValue("tlsResumedHandshakes"), count(stats.tls_resumed_handshakes)},
+      {EncodableValue("bytesSent"), count(stats.bytes_sent)},
+      {EncodableValue("bytesReceived"), count(stats.bytes_received)},
+      {EncodableValue("encodedResponseBytes"), count(stats.encoded_response_bytes)},
+      {EncodableValue("decodedResponseBytes"), count(stats.decoded_response_bytes)},
+      {EncodableValue("plainRequestBytes"), count(stats.plain_request_bytes)},
+      {EncodableValue("compressedRequestBytes"), count(stats.compressed_request_bytes)},
+      {EncodableValue("newConnectionP50"), micros(client.new_connection_times().Percentile(50))},
+      {EncodableValue("newConnectionP99"), micros(client.new_connection_times().Percentile(99))},
+      {EncodableValue("reusedConnectionP50"), micros(client.reused_connection_times().Percentile(50))},
+      {EncodableValue("reusedConnectionP99"), micros(client.reused_connection_times().Percentile(99))},
+    });
+  }
+
+  EncodableValue ToEncodable(const native_core::LogSinkStats& stats) {
+    auto count = [](uint64_t value) {
+      return EncodableValue(static_cast<int64_t>(value));
+    };
+    return EncodableValue(EncodableMap{
+      {EncodableValue("records"), count(stats.records)},
+      {EncodableValue("dropped"), count(stats.dropped)},
+      {EncodableValue("bytesWritten"), count(stats.bytes_written)},
+      {EncodableValue("batches"), count(stats.batches)},
+      {EncodableValue("rotations"), count(stats.rotations)},
+    });
+  }
+
+  EncodableValue ToEncodable(const native_core::SearchResult& result) {
+    EncodableList ids;
+    ids.reserve(result.ids.size());
+    for (const std::string& id : result.ids) {
+      ids.emplace_back(id);
+    }
+    return EncodableValue(EncodableMap{
+      {EncodableValue("ids"), EncodableValue(std::move(ids))},
+      {EncodableValue("total"), EncodableValue(static_cast<int64_t>(result.total))},
+    });
+  }
+
+  EncodableValue ToEncodable(const native_core::SearchIndexStats& stats) {
+    auto count = [](size_t value) {
+      return EncodableValue(static_cast<int64_t>(value));
+    };
+    return EncodableValue(EncodableMap{
+      {EncodableValue("requests"), count(stats.requests)},
+      {EncodableValue("terms"), count(stats.terms)},
+      {EncodableValue("postings"), count(stats.postings)},
+    });
+  }
+
+  class PortafirmasNativePlugin : public flutter::Plugin {
+
+  public:
+    static void RegisterWithRegistrar(flutter::PluginRegistrar* registrar);
+
+    // Creates a plugin that communicates on the given channel.
+    PortafirmasNativePlugin(
+      std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel);
+
+    virtual ~PortafirmasNativePlugin();
+
+  private:
+    using Arguments = native_core::MethodArguments;
+    using Result = std::unique_ptr<flutter::MethodResult<>>;
+
+    // The methods of the channel and their handlers.
+    static const native_core::MethodDispatcher<PortafirmasNativePlugin>::Table& Methods();
+
+    // Called when a method is called on |channel_|;
+    void HandleMethodCall(
+      const flutter::MethodCall<>& method_call,
+      std::unique_ptr<flutter::MethodResult<>> result);
+
+    // Creates a streaming parser for the "kind" of response and answers its id.
+    void CreateParser(const Arguments& arguments, Result result);
+
+    // Feeds the "data" chunk to the parser with the "id" argument, and
+    // finishes it, answering the parsed response. Both run on the shared pool.
+    void Feed(const Arguments& arguments, Result result);
+    void Finish(const Arguments& arguments, Result result);
+
+    void DisposeParser(const Arguments& arguments, Result result);
+
+    // Returns the session named by the "id" argument, or null after
+    // answering |result| with an error.
+    std::shared_ptr<ParserSession> FindSession(
+      const Arguments& arguments, flutter::MethodResult<>* result);
+
+    // Runs |work| for |session| on the shared pool, then |done| on the
+    // platform thread. The session is not touched on the platform thread
+    // while it is busy. Answers |result| with "busy", running neither, when
+    // the pool is saturated.
+    void RunParser(std::shared_ptr<ParserSession> session,
+      flutter::MethodResult<EncodableValue>* result,
+      std::function<void()> work, std::function<void()> done);
+
+    // Starts signing the batch described by |arguments|. Outcomes are sent
+    // to Dart as "triphaseOutcome" calls, followed by "triphaseDone".
+    void SignBatch(const Arguments& arguments, Result result);
+
+    // Starts postsigning again, as a batch, the requests of the owner in
+    // |arguments| left pending in the signing journal. Reports like
+    // SignBatch().
+    void ResumeBatch(const Arguments& arguments, Result result);
+
+    // Runs |run| as batch |id| on a thread of its own, forwarding the
+    // outcomes it reports to Dart.
+    using BatchRun = std::function<void(
+      const native_core::TriphaseEngine::OutcomeCallback& on_outcome,
+      native_core::CancellationToken token)>;
+    void StartBatch(int64_t id, BatchRun run, flutter::MethodResult<>* result);
+
+    // Requests already signed are still postsigned.
+    void CancelBatch(const Arguments& arguments, Result result);
+
+    void JournalOpen(const Arguments& arguments, Result result);
+    void JournalPending(const Arguments& arguments, Result result);
+
+    // Builds a CAdES-BES signature of the "data" argument with the selected
+    // certificate, without the proxy.
+    void CadesSign(const Arguments& arguments, Result result);
+
+    // Signs the PDF file at the "input" path into the "output" one with a
+    // PAdES signature of the selected certificate, streaming the file.
+    void PadesSign(const Arguments& arguments, Result result);
+
+    // Posts to the proxy through the shared HTTP client. With a "kind"
+    // argument the response is parsed as it arrives instead of returned.
+    // A parsed request list is also merged into the request list cache with a
+    // "cache" argument, and added to the search index with an "index" one.
+    // A true "keepBody" argument returns the body of a parsed response too.
+    void HttpPost(const Arguments& arguments, Result result);
+
+    void HttpStats(const Arguments& arguments, Result result);
+    void HttpClearSession(const Arguments& arguments, Result result);
+
+    // Opts the origin of the "url" argument in or out of gzip-compressed
+    // request bodies, as the "enabled" argument says.
+    void HttpCompressRequests(const Arguments& arguments, Result result);
+
+    // Opens the log file described by |arguments|, replacing any open one.
+    void LogOpen(const Arguments& arguments, Result result);
+
+    // Called for every batch of records sent from Dart, a list of strings, so
+    // it only queues them.
+    void LogWrite(const Arguments& arguments, Result result);
+
+    void LogFlush(const Arguments& arguments, Result result);
+    void LogStats(const Arguments& arguments, Result result);
+
+    void CacheOpen(const Arguments& arguments, Result result);
+
+    // Loads the cached list of the "server" and "state" arguments, adding it
+    // to the search index, or removes it. Both run on the shared pool.
+    void CacheLoad(const Arguments& arguments, Result result);
+    void CacheRemove(const Arguments& arguments, Result result);
+
+    void SearchQuery(const Arguments& arguments, Result result);
+    void SearchClear(const Arguments& arguments, Result result);
+    void SearchStats(const Arguments& arguments, Result result);
+
+    // Build the request bodies sent by NativeRequestBuilder. Even for
+    // batches of hundreds of signatures this takes well under a millisecond,
+    // and the views borrowed from the arguments would not outlive a trip to
+    // the pool, so they run inline.
+    void BuildPresignBody(const Arguments& arguments, Result result);
+    void BuildPostsignBody(const Arguments& arguments, Result result);
+    void BuildApproveBody(const Arguments& arguments, Result result);
+    void BuildRejectBody(const Arguments& arguments, Result result);
+
+    // Answers the body built from |arguments|, or an error if they are not
+    // laid out as expected.
+    void AnswerBody(const Arguments& arguments, std::vector<uint8_t> body,
+      flutter::MethodResult<>* result);
+
+    // Call counts and times of the methods of this channel.
+    void CallStats(const Arguments& arguments, Result result);
+
+    // Parsers by the id handed to Dart by "createParser".
+    std::map<int64_t, std::shared_ptr<ParserSession>> sessions_;
+    int64_t next_session_id_ = 1;
+
+    // Running batches by the id chosen by the Dart side.
+    std::map<int64_t, std::unique_ptr<TriphaseBatch>> batches_;
+
+    // Expires with the plugin; the tasks batches post to the platform thread
+    // hold a weak reference and do nothing once it has gone.
+    std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+
+    // The MethodChannel used for communication with the Flutter engine.
+    std::unique_ptr<flutter::MethodChannel<>> channel_;
+
+    // Routes the calls on |channel_| to the handlers in Methods().
+    native_core::MethodDispatcher<PortafirmasNativePlugin> dispatcher_{
+      "portafirmas_native", &Methods() };
+
+    // The network log, written from a thread of its own.
+    // Shared with the flushes in progress.
+    std::shared_ptr<native_core::LogSink> log_sink_;
+
+    // The last known request lists, once "cacheOpen" has been called. Shared
+    // with the requests and loads in progress.
+    std::shared_ptr<native_core::RequestListCache> request_cache_;
+
+    // The requests of the lists fetched so far, for searching as the user
+    // types. Shared with the requests and loads in progress.
+    std::shared_ptr<native_core::SearchIndex> search_index_ =
+      std::make_shared<native_core::SearchIndex>();
+
+    // The signatures not yet postsigned, once "journalOpen" has been called.
+    // Shared with the batches in progress.
+    std::shared_ptr<native_core::SigningJournal> journal_;
+
+    // Connections to the proxy, kept alive across requests and batches.
+    native_core::Lazy<native_core::HttpClient> http_client_{ []() {
+      native_core::HttpClientOptions options;
+      options.max_connections_per_host = kHttpConnections;
+      return native_core::HttpClient::Create(options);
+    } };
+
+    // Runs the blocking "httpPost" requests. Requests are mostly waiting on
+    // the network, so they get threads of their own rather than holding the
+    // shared pool. Declared last so that it is joined first.
+    native_core::WorkerPool http_pool_{ kHttpConnections, kHttpQueueCapacity };
+  };
+
+  // static
+  void PortafirmasNativePlugin::RegisterWithRegistrar(flutter::PluginRegistrar* registrar) {
+    auto channel =
+      std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
+        registrar->messenger(), "portafirmas_native",
+        &flutter::StandardMethodCodec::GetInstance());
+    auto* channel_pointer = channel.get();
+
+    auto plugin = std::make_unique<PortafirmasNativePlugin>(std::move(channel));
+
+    channel_pointer->SetMethodCallHandler(
+      [plugin_pointer = plugin.get()](const auto& call, auto result) {
+      plugin_pointer->HandleMethodCall(call, std::move(result));
+    });
+
+    registrar->AddPlugin(std::move(plugin));
+  };
+
+  PortafirmasNativePlugin::PortafirmasNativePlugin(
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel)
+    : channel_(std::move(channel)) {
+    // Loading WinHTTP is kept off the startup path.
+    http_client_.WarmAfterFirstFrame();
+  }
+
+  PortafirmasNativePlugin::~PortafirmasNativePlugin() {
+    for (auto& [id, batch] : batches_) {
+      batch->cancellation.Cancel();
+    }
+    for (auto& [id, batch] : batches_) {
+      batch->thread.join();
+    }
+  };
+
+  // static
+  const native_core::MethodDispatcher<PortafirmasNativePlugin>::Table&
+  PortafirmasNativePlugin::Methods() {
+    using Plugin = PortafirmasNativePlugin;
+    static constexpr native_core::MethodDispatcher<Plugin>::Table kMethods = {
+      {"createParser", &Plugin::CreateParser},
+      {"feed", &Plugin::Feed},
+      {"finish", &Plugin::Finish},
+      {"disposeParser", &Plugin::DisposeParser},
+      {"signBatch", &Plugin::SignBatch},
+      {"resumeBatch", &Plugin::ResumeBatch},
+      {"cancelBatch", &Plugin::CancelBatch},
+      {"journalOpen", &Plugin::JournalOpen},
+      {"journalPending", &Plugin::JournalPending},
+      {"cadesSign", &Plugin::CadesSign},
+      {"padesSign", &Plugin::PadesSign},
+      {"httpPost", &Plugin::HttpPost},
+      {"httpStats", &Plugin::HttpStats},
+      {"httpClearSession", &Plugin::HttpClearSession},
+      {"httpCompressRequests", &Plugin::HttpCompressRequests},
+      {"logOpen", &Plugin::LogOpen},
+      {"logWrite", &Plugin::LogWrite},
+      {"logFlush", &Plugin::LogFlush},
+      {"logStats", &Plugin::LogStats},
+      {"cacheOpen", &Plugin::CacheOpen},
+      {"cacheLoad", &Plugin::CacheLoad},
+      {"cacheRemove", &Plugin::CacheRemove},
+      {"searchQuery", &Plugin::SearchQuery},
+      {"searchClear", &Plugin::SearchClear},
+      {"searchStats", &Plugin::SearchStats},
+      {"buildPresignBody", &Plugin::BuildPresignBody},
+      {"buildPostsignBody", &Plugin::BuildPostsignBody},
+      {"buildApproveBody", &Plugin::BuildApproveBody},
+      {"buildRejectBody", &Plugin::BuildRejectBody},
+      {"callStats", &Plugin::CallStats},
+    };
+    return kMethods;
+  }
+
+  void PortafirmasNativePlugin::HandleMethodCall(
+    const flutter::MethodCall<>& method_call,
+    std::unique_ptr<flutter::MethodResult<>> result) {
+    dispatcher_.Dispatch(this, method_call, std::move(result));
+  }
+
+  void PortafirmasNativePlugin::CreateParser(const Arguments& arguments, Result result) {
+    int64_t kind = arguments.Integer("kind");
+    if (!arguments.ok() || kind < 0 ||
+      kind > static_cast<int64_t>(native_core::ResponseKind::kPostsign)) {
+      result->Error("parser_error", "Tipo de respuesta desconocido.");
+      return;
+    }
+    auto session = std::make_shared<ParserSession>();
+    session->parser = native_core::CreateResponseParser(
+      static_cast<native_core::ResponseKind>(kind));
+    int64_t id = next_session_id_++;
+    sessions_[id] = std::move(session);
+    result->Success(EncodableValue(id));
+  }
+
+  std::shared_ptr<ParserSession> PortafirmasNativePlugin::FindSession(
+    const Arguments& arguments, flutter::MethodResult<>* result) {
+    int64_t id = arguments.Integer("id");
+    if (!arguments.ok()) {
+      result->Error("parser_error", "Falta el identificador del analizador.");
+      return nullptr;
+    }
+    auto session_it = sessions_.find(id);
+    if (session_it == sessions_.end()) {
+      result->Error("parser_error", "El analizador no existe o ya ha terminado.");
+      return nullptr;
+    }
+    if (session_it->second->busy) {
+      result->Error("parser_error", "El analizador está ocupado.");
+      return nullptr;
+    }
+    return session_it->second;
+  }
+
+  void PortafirmasNativePlugin::RunParser(std::shared_ptr<ParserSession> session,
+    flutter::MethodResult<EncodableValue>* result,
+    std::function<void()> work, std::function<void()> done) {
+    session->busy = true;
+    if (!native_core::Runtime::Get().RunAsync(work, [done](bool) { done(); })) {
+      session->busy = false;
+      ReplyBusy(result);
+    }
+  }
+
+  void PortafirmasNativePlugin::Feed(const Arguments& arguments, Result result) {
+    std::shared_ptr<ParserSession> session = FindSession(arguments, result.get());
+    if (!session) {
+      return;
+    }
+    const auto& chunk = arguments.Get<std::vector<uint8_t>>("data");
+    if (!arguments.ok()) {
+      result->Error("parser_error", "Faltan los datos.");
+      return;
+    }
+
+    // Tokenizing a large response takes a while, so it runs on the shared
+    // worker pool, with a copy of the chunk that outlives the call.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    auto data = std::make_shared<std::vector<uint8_t>>(chunk);
+    RunParser(session, shared_result.get(), [session, data]() {
+      session->parser->Feed(reinterpret_cast<const char*>(data->data()), data->size());
+    }, [session, shared_result]() {
+      session->busy = false;
+      shared_result->Success();
+    });
+  }
+
+  void PortafirmasNativePlugin::Finish(const Arguments& arguments, Result result) {
+    std::shared_ptr<ParserSession> session = FindSession(arguments, result.get());
+    if (!session) {
+      return;
+    }
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    int64_t id = arguments.Integer("id");
+    auto response = std::make_shared<EncodableValue>();
+    RunParser(session, shared_result.get(), [session, response]() {
+      session->parser->Finish();
+      *response = ToEncodable(*session->parser);
+    }, [this, id, response, shared_result]() {
+      sessions_.erase(id);
+      shared_result->Success(*response);
+    });
+  }
+
+  void PortafirmasNativePlugin::DisposeParser(const Arguments& arguments, Result result) {
+    // A busy parser is kept alive by its pending work.
+    int64_t id = arguments.Integer("id");
+    if (arguments.ok()) {
+      sessions_.erase(id);
+    }
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::SignBatch(const Arguments& arguments, Result result) {
+    std::shared_ptr<native_core::Pkcs1Signer> signer = native_core::GetActiveSigner();
+    if (!signer) {
+      result->Error("signing_error", "No se ha seleccionado ningún certificado.");
+      return;
+    }
+    int64_t id = arguments.Integer("batch");
+    std::string url = arguments.Get<std::string>("url");
+    std::string cookie = arguments.Get<std::string>("cookie");
+    native_core::TriphaseOptions options;
+    options.presign_window = static_cast<size_t>(arguments.Get<int32_t>("presignWindow"));
+    options.postsign_window = static_cast<size_t>(arguments.Get<int32_t>("postsignWindow"));
+    std::vector<native_core::TriphaseJob> jobs =
+      TriphaseJobs(arguments, arguments.Get<EncodableList>("requests"));
+    if (const auto* owner = arguments.Optional<std::string>("journalOwner")) {
+      options.journal_owner = *owner;
+    }
+    if (!arguments.ok()) {
+      result->Error("request_error", "Argumentos del lote no válidos.");
+      return;
+    }
+    std::shared_ptr<native_core::SigningJournal> journal;
+    if (!options.journal_owner.empty()) {
+      journal = journal_;
+      options.journal = journal.get();
+    }
+
+    native_core::HttpClient* client = &http_client_.Get();
+    StartBatch(id, [client, url, cookie, options, signer, journal, jobs = std::move(jobs)](
+      const native_core::TriphaseEngine::OutcomeCallback& on_outcome,
+      native_core::CancellationToken token) {
+      native_core::HttpTriphaseTransport transport(client, url, cookie);
+      native_core::TriphaseEngine engine(&transport, signer.get(), options);
+      engine.Run(jobs, on_outcome, std::move(token));
+    }, result.get());
+  }
+
+  void PortafirmasNativePlugin::ResumeBatch(const Arguments& arguments, Result result) {
+    int64_t id = arguments.Integer("batch");
+    std::string url = arguments.Get<std::string>("url");
+    std::string cookie = arguments.Get<std::string>("cookie");
+    native_core::TriphaseOptions options;
+    options.journal_owner = arguments.Get<std::string>("journalOwner");
+    if (!arguments.ok()) {
+      result->Error("request_error", "Argumentos del lote no válidos.");
+      return;
+    }
+    std::shared_ptr<native_core::SigningJournal> journal = journal_;
+    if (!journal) {
+      result->Error("journal_error", "El diario de firmas no está abierto.");
+      return;
+    }
+    options.journal = journal.get();
+
+    native_core::HttpClient* client = &http_client_.Get();
+    StartBatch(id, [client, url, cookie, options, journal](
+      const native_core::TriphaseEngine::OutcomeCallback& on_outcome,
+      native_core::CancellationToken token) {
+      native_core::HttpTriphaseTransport transport(client, url, cookie);
+      native_core::TriphaseEngine engine(&transport, nullptr, options);
+      engine.Resume(journal->Pending(options.journal_owner), on_outcome, std::move(token));
+    }, result.get());
+  }
+
+  void PortafirmasNativePlugin::StartBatch(
+    int64_t id, BatchRun run, flutter::MethodResult<>* result) {
+    if (batches_.count(id)) {
+      result->Error("request_error", "El lote ya existe.");
+      return;
+    }
+
+    auto batch = std::make_unique<TriphaseBatch>();
+    native_core::CancellationToken token = batch->cancellation.token();
+    native_core::PlatformDispatcher* dispatcher = &native_core::Runtime::Get().dispatcher();
+    // The destructor joins the thread, but what it has posted may still be
+    // queued behind the destruction.
+    std::weak_ptr<bool> alive = alive_;
+    // Blocking network and signing for the whole batch would hold a pool
+    // worker for minutes, so the engine gets a thread of its own.
+    batch->thread = std::thread([this, id, dispatcher, alive, token, run = std::move(run)]() {
+      run([this, id, dispatcher, alive](const native_core::TriphaseOutcome& outcome) {
+        auto values = std::make_shared<EncodableValue>(EncodableMap{
+          {EncodableValue("batch"), EncodableValue(id)},
+          {EncodableValue("index"), EncodableValue(static_cast<int64_t>(outcome.index))},
+          {EncodableValue("id"), EncodableValue(outcome.id)},
+          {EncodableValue("statusOk"), EncodableValue(outcome.status_ok)},
+          {EncodableValue("failure"), EncodableValue(static_cast<int32_t>(outcome.failure))},
+          {EncodableValue("detail"), EncodableValue(outcome.detail)},
+        });
+        dispatcher->Post([this, alive, values]() {
+          if (alive.expired()) {
+            return;
+          }
+          channel_->InvokeMethod("triphaseOutcome", std::make_unique<EncodableValue>(*values));
+        });
+      }, token);
+      dispatcher->Post([this, alive, id]() {
+        if (alive.expired()) {
+          return;
+        }
+        auto batch_it = batches_.find(id);
+        if (batch_it != batches_.end()) {
+          batch_it->second->thread.join();
+          batches_.erase(batch_it);
+        }
+        channel_->InvokeMethod("triphaseDone", std::make_unique<EncodableValue>(
+          EncodableMap{ {EncodableValue("batch"), EncodableValue(id)} }));
+      });
+    });
+    batches_[id] = std::move(batch);
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::CancelBatch(const Arguments& arguments, Result result) {
+    int64_t id = arguments.Integer("batch");
+    if (arguments.ok()) {
+      auto running = batches_.find(id);
+      if (running != batches_.end()) {
+        running->second->cancellation.Cancel();
+      }
+    }
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::JournalOpen(const Arguments& arguments, Result result) {
+    std::string path = arguments.Get<std::string>("path");
+    if (!arguments.ok()) {
+      result->Error("journal_error", "Falta la ruta del diario de firmas.");
+      return;
+    }
+    // Opening compacts the file and waits for the disk, so it runs on the
+    // shared pool.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    auto journal = std::make_shared<std::shared_ptr<native_core::SigningJournal>>();
+    auto work = [path, journal]() {
+      *journal = native_core::SigningJournal::Open(path);
+    };
+    auto done = [this, journal, shared_result](bool) {
+      if (!*journal) {
+        shared_result->Error("journal_error", "No se puede abrir el diario de firmas.");
+        return;
+      }
+      journal_ = std::move(*journal);
+      shared_result->Success();
+    };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      ReplyBusy(shared_result.get());
+    }
+  }
+
+  void PortafirmasNativePlugin::JournalPending(const Arguments& arguments, Result result) {
+    const std::string& owner = arguments.Get<std::string>("owner");
+    if (!arguments.ok()) {
+      result->Error("journal_error", "Falta el propietario de las firmas.");
+      return;
+    }
+    size_t pending = journal_ ? journal_->Pending(owner).size() : 0;
+    result->Success(EncodableValue(static_cast<int64_t>(pending)));
+  }
+
+  void PortafirmasNativePlugin::HttpPost(const Arguments& arguments, Result result) {
+    std::string url = arguments.Get<std::string>("url");
+    native_core::HttpHeaders headers;
+    for (const auto& [name, value] : arguments.Get<EncodableMap>("headers")) {
+      headers.emplace_back(arguments.Get<std::string>(name), arguments.Get<std::string>(value));
+    }
+    const auto& request_body = arguments.Get<std::vector<uint8_t>>("body");
+    const int32_t* kind = arguments.Optional<int32_t>("kind");
+    const EncodableMap* cache_key = arguments.Optional<EncodableMap>("cache");
+    const std::string* index_state = arguments.Optional<std::string>("index");
+    const bool* keep_body_argument = arguments.Optional<bool>("keepBody");
+    std::string cache_server;
+    std::string cache_state;
+    if (cache_key) {
+      cache_server = arguments.Get<std::string>(*cache_key, "server");
+      cache_state = arguments.Get<std::string>(*cache_key, "state");
+    }
+    if (!arguments.ok()) {
+      result->Error("request_error", "Argumentos de la petición no válidos.");
+      return;
+    }
+    bool keep_body = !kind || (keep_body_argument && *keep_body_argument);
+    std::unique_ptr<native_core::ResponseParser> parser;
+    std::shared_ptr<native_core::RequestListCache> cache;
+    std::shared_ptr<native_core::SearchIndex> index;
+    if (kind) {
+      if (*kind < 0 || *kind > static_cast<int32_t>(native_core::ResponseKind::kPostsign)) {
+        result->Error("parser_error", "Tipo de respuesta desconocido.");
+        return;
+      }
+      parser = native_core::CreateResponseParser(static_cast<native_core::ResponseKind>(*kind));
+      if (*kind == static_cast<int32_t>(native_core::ResponseKind::kRequestList)) {
+        if (cache_key) {
+          cache = request_cache_;
+        }
+        if (index_state) {
+          index = search_index_;
+        }
+      }
+    }
+
+    // The body is the only copy of the arguments sent to the pool.
+    auto body = std::make_shared<std::vector<uint8_t>>(request_body);
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    std::shared_ptr<native_core::ResponseParser> shared_parser(std::move(parser));
+    native_core::HttpClient* client = &http_client_.Get();
+    native_core::PlatformDispatcher* dispatcher = &native_core::Runtime::Get().dispatcher();
+    bool posted = http_pool_.TryPost([client, dispatcher, url, headers, body,
+      shared_parser, shared_result, keep_body, cache, cache_server, cache_state, index,
+      index_state = index ? *index_state : std::string()]() {
+      std::vector<uint8_t> response_body;
+      native_core::HttpResponse response = client->Post(url, headers, *body,
+        [&](const char* data, size_t size) {
+        if (shared_parser) {
+          shared_parser->Feed(data, size);
+        }
+        if (keep_body) {
+          response_body.insert(response_body.end(), data, data + size);
+        }
+      });
+      auto values = std::make_shared<EncodableValue>();
+      if (response.status != 0) {
+        EncodableMap response_headers;
+        for (const auto& [name, value] : response.headers) {
+          response_headers[EncodableValue(name)] = EncodableValue(value);
+        }
+        EncodableMap fields{
+          {EncodableValue("status"), EncodableValue(static_cast<int32_t>(response.status))},
+          {EncodableValue("headers"), EncodableValue(std::move(response_headers))},
+        };
+        if (shared_parser) {
+          shared_parser->Finish();
+          fields[EncodableValue("parsed")] = ToEncodable(*shared_parser);
+          // Only lists that parsed cleanly are kept; Merge() checks.
+          if (cache && response.status == 200) {
+            cache->Merge(cache_server, cache_state, *shared_parser);
+          }
+          if (index && response.status == 200) {
+            index->AddRequestList(index_state, *shared_parser);
+          }
+        }
+        if (keep_body) {
+          fields[EncodableValue("body")] = EncodableValue(std::move(response_body));
+        }
+        *values = EncodableValue(std::move(fields));
+      }
+      std::string error = std::move(response.error);
+      dispatcher->Post([values, error, shared_result]() {
+        if (values->IsNull()) {
+          shared_result->Error("http_error", error);
+        }
+        else {
+          shared_result->Success(*values);
+        }
+      });
+    });
+    if (!posted) {
+      shared_result->Error("busy", "Demasiadas peticiones en curso.");
+    }
+  }
+
+  void PortafirmasNativePlugin::CadesSign(const Arguments& arguments, Result result) {
+    std::shared_ptr<native_core::Pkcs1Signer> signer = native_core::GetActiveSigner();
+    if (!signer) {
+      result->Error("signing_error", "No se ha seleccionado ningún certificado.");
+      return;
+    }
+    const auto& document = arguments.Get<std::vector<uint8_t>>("data");
+    native_core::CadesOptions options;
+    options.digest = native_core::DigestAlgorithmFor(arguments.Get<std::string>("digest"));
+    options.attached = arguments.Get<bool>("attached");
+    if (!arguments.ok()) {
+      result->Error("signing_error", "Argumentos de la firma no válidos.");
+      return;
+    }
+    auto data = std::make_shared<std::vector<uint8_t>>(document);
+
+    // Hashing the document and the signature itself, which may ask for a PIN,
+    // run on the shared pool.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    auto signature = std::make_shared<std::vector<uint8_t>>();
+    auto error = std::make_shared<std::string>();
+    auto work = [signer, data, options, signature, error]() {
+      if (!native_core::BuildCadesSignature(signer.get(), signer->Certificate(), data->data(),
+        data->size(), options, signature.get(), error.get())) {
+        signature->clear();
+      }
+    };
+    auto done = [signature, error, shared_result](bool) {
+      if (signature->empty()) {
+        shared_result->Error("signing_error", *error);
+        return;
+      }
+      shared_result->Success(EncodableValue(std::move(*signature)));
+    };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      ReplyBusy(shared_result.get());
+    }
+  }
+
+  void PortafirmasNativePlugin::PadesSign(const Arguments& arguments, Result result) {
+    std::shared_ptr<native_core::Pkcs1Signer> signer = native_core::GetActiveSigner();
+    if (!signer) {
+      result->Error("signing_error", "No se ha seleccionado ningún certificado.");
+      return;
+    }
+    std::string input = arguments.Get<std::string>("input");
+    std::string output = arguments.Get<std::string>("output");
+    native_core::PadesOptions options;
+    options.digest = native_core::DigestAlgorithmFor(arguments.Get<std::string>("digest"));
+    if (const auto* reason = arguments.Optional<std::string>("reason")) {
+      options.reason = *reason;
+    }
+    if (const auto* location = arguments.Optional<std::string>("location")) {
+      options.location = *location;
+    }
+    if (!arguments.ok()) {
+      result->Error("signing_error", "Argumentos de la firma no válidos.");
+      return;
+    }
+
+    // Copying and hashing the document and the signature itself run on the
+    // shared pool.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    auto signed_ok = std::make_shared<bool>(false);
+    auto error = std::make_shared<std::string>();
+    auto work = [signer, input, output, options, signed_ok, error]() {
+      *signed_ok = native_core::SignPdf(signer.get(), input, output, options, nullptr,
+        error.get());
+    };
+    auto done = [signed_ok, error, shared_result](bool) {
+      if (!*signed_ok) {
+        shared_result->Error("signing_error", *error);
+        return;
+      }
+      shared_result->Success();
+    };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      ReplyBusy(shared_result.get());
+    }
+  }
+
+  void PortafirmasNativePlugin::HttpStats(const Arguments&, Result result) {
+    // Nothing to report before the first request.
+    if (!http_client_.IsInitialized()) {
+      result->Success(EncodableValue(EncodableMap()));
+      return;
+    }
+    result->Success(ToEncodable(http_client_.Get()));
+  }
+
+  void PortafirmasNativePlugin::HttpClearSession(const Arguments&, Result result) {
+    if (http_client_.IsInitialized()) {
+      http_client_.Get().ClearSession();
+    }
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::HttpCompressRequests(const Arguments& arguments, Result result) {
+    std::string url = arguments.Get<std::string>("url");
+    bool enabled = arguments.Get<bool>("enabled");
+    if (!arguments.ok()) {
+      result->Error("request_error", "Argumentos no válidos.");
+      return;
+    }
+    http_client_.Get().CompressRequests(url, enabled);
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::LogOpen(const Arguments& arguments, Result result) {
+    native_core::LogSinkOptions options;
+    options.path = arguments.Get<std::string>("path");
+    options.truncate = arguments.Get<bool>("truncate");
+    options.max_file_bytes = static_cast<uint64_t>(arguments.Integer("maxFileBytes"));
+    options.max_rotated_files = static_cast<size_t>(arguments.Get<int32_t>("maxRotatedFiles"));
+    options.compress_rotated = arguments.Get<bool>("compressRotated");
+    if (!arguments.ok()) {
+      result->Error("log_error", "Argumentos del registro no válidos.");
+      return;
+    }
+    // The previous sink writes what it still holds before the new one opens,
+    // unless a flush still holds it.
+    log_sink_.reset();
+    log_sink_ = native_core::LogSink::Open(std::move(options));
+    if (!log_sink_) {
+      result->Error("log_error", "No se puede abrir el fichero de registro.");
+      return;
+    }
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::LogWrite(const Arguments& arguments, Result result) {
+    const auto& records = arguments.Get<EncodableList>("records");
+    const auto* flush = arguments.Optional<bool>("flush");
+    if (log_sink_) {
+      for (size_t i = 0; i < records.size(); i++) {
+        if (const auto* record = arguments.Optional<std::string>(records, i)) {
+          log_sink_->Write(*record);
+        }
+      }
+      // Errors are on disk before the call returns, in case the application
+      // does not get to write anything else. They are rare enough for the
+      // wait on the platform thread not to matter.
+      if (flush && *flush) {
+        log_sink_->Flush();
+      }
+    }
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::LogFlush(const Arguments&, Result result) {
+    if (!log_sink_) {
+      result->Success();
+      return;
+    }
+    // Waits for the writer thread, so it runs on the shared pool.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    std::shared_ptr<native_core::LogSink> sink = log_sink_;
+    auto work = [sink]() { sink->Flush(); };
+    auto done = [shared_result](bool) { shared_result->Success(); };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      ReplyBusy(shared_result.get());
+    }
+  }
+
+  void PortafirmasNativePlugin::LogStats(const Arguments&, Result result) {
+    result->Success(log_sink_ ? ToEncodable(log_sink_->stats()) : EncodableValue(EncodableMap()));
+  }
+
+  void PortafirmasNativePlugin::CacheOpen(const Arguments& arguments, Result result) {
+    const std::string& directory = arguments.Get<std::string>("directory");
+    if (!arguments.ok()) {
+      result->Error("cache_error", "Falta el directorio de la caché.");
+      return;
+    }
+    request_cache_ = std::make_shared<native_core::RequestListCache>(directory);
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::CacheLoad(const Arguments& arguments, Result result) {
+    std::string server = arguments.Get<std::string>("server");
+    std::string state = arguments.Get<std::string>("state");
+    if (!arguments.ok()) {
+      result->Error("cache_error", "Argumentos de la caché no válidos.");
+      return;
+    }
+    if (!request_cache_) {
+      result->Success();
+      return;
+    }
+    // Reading touches the disk, so it runs on the shared pool.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    std::shared_ptr<native_core::RequestListCache> cache = request_cache_;
+    std::shared_ptr<native_core::SearchIndex> index = search_index_;
+    auto response = std::make_shared<EncodableValue>();
+    auto work = [cache, index, server, state, response]() {
+      std::unique_ptr<native_core::RequestListSnapshot> snapshot = cache->Load(server, state);
+      if (snapshot) {
+        // Searchable before the network answers too.
+        index->AddRequestList(state, snapshot->strings, snapshot->requests, snapshot->docs);
+        *response = ToEncodable(*snapshot);
+      }
+    };
+    auto done = [response, shared_result](bool) { shared_result->Success(*response); };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      ReplyBusy(shared_result.get());
+    }
+  }
+
+  void PortafirmasNativePlugin::CacheRemove(const Arguments& arguments, Result result) {
+    std::string server = arguments.Get<std::string>("server");
+    std::string state = arguments.Get<std::string>("state");
+    if (!arguments.ok()) {
+      result->Error("cache_error", "Argumentos de la caché no válidos.");
+      return;
+    }
+    if (!request_cache_) {
+      result->Success();
+      return;
+    }
+    // Removing touches the disk, so it runs on the shared pool.
+    std::shared_ptr<flutter::MethodResult<EncodableValue>> shared_result(std::move(result));
+    std::shared_ptr<native_core::RequestListCache> cache = request_cache_;
+    auto work = [cache, server, state]() { cache->Remove(server, state); };
+    auto done = [shared_result](bool) { shared_result->Success(); };
+    if (!native_core::Runtime::Get().RunAsync(work, done)) {
+      ReplyBusy(shared_result.get());
+    }
+  }
+
+  void PortafirmasNativePlugin::SearchQuery(const Arguments& arguments, Result result) {
+    const std::string& text = arguments.Get<std::string>("text");
+    const std::string* state = arguments.Optional<std::string>("state");
+    int32_t limit = arguments.Get<int32_t>("limit");
+    if (!arguments.ok()) {
+      result->Error("search_error", "Argumentos de la búsqueda no válidos.");
+      return;
+    }
+    // Well under a millisecond even for a hundred thousand requests, so it
+    // runs inline.
+    result->Success(ToEncodable(search_index_->Query(text, state ? *state : std::string(),
+      limit < 0 ? 0 : static_cast<size_t>(limit))));
+  }
+
+  void PortafirmasNativePlugin::SearchClear(const Arguments&, Result result) {
+    search_index_->Clear();
+    result->Success();
+  }
+
+  void PortafirmasNativePlugin::SearchStats(const Arguments&, Result result) {
+    result->Success(ToEncodable(search_index_->stats()));
+  }
+
+  void PortafirmasNativePlugin::BuildPresignBody(const Arguments& arguments, Result result) {
+    const auto* list = arguments.Optional<EncodableList>("docs");
+    std::vector<native_core::PresignDocument> documents;
+    if (list) {
+      documents = PresignDocuments(arguments, *list);
+    }
+    AnswerBody(arguments, native_core::BuildPresignBody(arguments.Get<std::string>("op"),
+      arguments.Get<std::string>("id"), list ? &documents : nullptr), result.get());
+  }
+
+  void PortafirmasNativePlugin::BuildPostsignBody(const Arguments& arguments, Result result) {
+    AnswerBody(arguments, native_core::BuildPostsignBody(arguments.Get<std::string>("op"),
+      PostsignRequests(arguments, arguments.Get<EncodableList>("reqs"))), result.get());
+  }
+
+  void PortafirmasNativePlugin::BuildApproveBody(const Arguments& arguments, Result result) {
+    AnswerBody(arguments, native_core::BuildApproveBody(arguments.Get<std::string>("op"),
+      StringViews(arguments, arguments.Get<EncodableList>("ids"))), result.get());
+  }
+
+  void PortafirmasNativePlugin::BuildRejectBody(const Arguments& arguments, Result result) {
+    AnswerBody(arguments, native_core::BuildRejectBody(arguments.Get<std::string>("op"),
+      StringViews(arguments, arguments.Get<EncodableList>("ids")),
+      arguments.Get<std::string>("reason")), result.get());
+  }
+
+  void PortafirmasNativePlugin::AnswerBody(const Arguments& arguments,
+    std::vector<uint8_t> body, flutter::MethodResult<>* result) {
+    // A body built from missing arguments is dropped; building it anyway
+    // costs less than checking each argument before.
+    if (!arguments.ok()) {
+      result->Error("request_error", "Argumentos de la solicitud no válidos.");
+      return;
+    }
+    result->Success(EncodableValue(std::move(body)));
+  }
+
+  void PortafirmasNativePlugin::CallStats(const Arguments&, Result result) {
+    result->Success(dispatcher_.Stats());
+  }
+
+}  // namespace
+
+void PortafirmasNativePluginRegisterWithRegistrar(
+  FlutterDesktopPluginRegistrarRef registrar) {
+  // The plugin registrar owns the plugin, registered callbacks, etc., so must
+  // remain valid for the life of the application.
+  static auto* plugin_registrar = new flutter::PluginRegistrar(registrar);
+
+  // Registration runs on the platform thread, which is where the shared runtime
+  // must be created.
+  native_core::Runtime::Get();
+
+  PortafirmasNativePlugin::RegisterWithRegistrar(plugin_registrar);
+}
@@ -0,0 +1,567 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Signs every pending request of a user without the app: logs in to the
+// proxy with the challenge-response flow, pages through the request list and
+// runs presign, sign and postsign through the same triphase engine as the
+// plugin, then writes a JSON report of what happened to each request.
+//
+//   batch_signer --server URL (--key key.pem | --certificate THUMBPRINT)
+//                [--state unresolved] [--page-size 50] [--max-requests N]
+//                [--presign-window 2] [--postsign-window 2]
+//                [--connections 4] [--journal FILE] [--ca-file FILE]
+//                [--report FILE]
+//
+// --key reads an RSA key followed by its certificate from a PEM file, where
+// there is no certificate store (Linux); --certificate picks a certificate of
+// the current user's personal store by its SHA-1 thumbprint (Windows).
+//
+// With --journal, signatures are journaled before their postsign, and the
+// postsigns a previous run left unanswered are sent first. Ctrl+C stops
+// presigning; what was signed is still postsigned.
+//
+// Exits with 0 if every request was signed, 1 if some were not, 2 on a usage
+// error and 3 if the login or the request list failed.
+#include <native_core/cancellation_token.h>
+#include <native_core/http_client.h>
+#include <native_core/pkcs1_signer.h>
+#include <native_core/proxy_session.h>
+#include <native_core/signing_journal.h>
+#include <native_core/triphase_engine.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <native_core/certificate_signer.h>
+#else
+#include <native_core/file_key_signer.h>
+#endif
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using native_core::TriphaseFailure;
+using native_core::TriphaseOutcome;
+
+struct Options {
+  std::string server;
+  std::string key;
+  std::string certificate;
+  std::string state = "unresolved";
+  int page_size = 50;
+  // 0 for no limit.
+  int max_requests = 0;
+  int presign_window = 2;
+  int postsign_window = 2;
+  int connections = 4;
+  std::string journal;
+  std::string ca_file;
+  // Standard output if empty.
+  std::string report;
+};
+
+// What happened to one request, for the report.
+struct Result {
+  std::string id;
+  std::string subject;
+  // "signed", "failed", "cancelled", "skipped" or "resumed".
+  std::string outcome;
+  TriphaseFailure failure = TriphaseFailure::kNone;
+  std::string detail;
+};
+
+native_core::CancellationSource* g_cancellation = nullptr;
+
+void OnInterrupt(int /*signal*/) {
+  if (g_cancellation) {
+    g_cancellation->Cancel();
+  }
+}
+
+void PrintUsage() {
+  std::fprintf(
+      stderr,
+      "usage: batch_signer --server URL (--key key.pem | --certificate "
+      "THUMBPRINT)\n"
+      "                    [--state unresolved] [--page-size 50] "
+      "[--max-requests N]\n"
+      "                    [--presign-window 2] [--postsign-window 2]\n"
+      "                    [--connections 4] [--journal FILE] "
+      "[--ca-file FILE]\n"
+      "                    [--report FILE]\n");
+}
+
+bool ParsePositive(const std::string& text, int* value) {
+  char* end = nullptr;
+  long parsed = std::strtol(text.c_str(), &end, 10);
+  if (text.empty() || *end != '\0' || parsed <= 0 || parsed > 1 << 20) {
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+bool ParseOptions(const std::vector<std::string>& args, Options* options) {
+  for (size_t i = 1; i < args.size(); ++i) {
+    const std::string& flag = args[i];
+    if (i + 1 >= args.size()) {
+      std::fprintf(stderr, "Missing value for %s\n", flag.c_str());
+      return false;
+    }
+    const std::string& value = args[++i];
+    bool ok = true;
+    if (flag == "--server") {
+      options->server = value;
+    } else if (flag == "--key") {
+      options->key = value;
+    } else if (flag == "--certificate") {
+      options->certificate = value;
+    } else if (flag == "--state") {
+      options->state = value;
+    } else if (flag == "--page-size") {
+      ok = ParsePositive(value, &options->page_size);
+    } else if (flag == "--max-requests") {
+      ok = ParsePositive(value, &options->max_requests);
+    } else if (flag == "--presign-window") {
+      ok = ParsePositive(value, &options->presign_window);
+    } else if (flag == "--postsign-window") {
+      ok = ParsePositive(value, &options->postsign_window);
+    } else if (flag == "--connections") {
+      ok = ParsePositive(value, &options->connections);
+    } else if (flag == "--journal") {
+      options->journal = value;
+    } else if (flag == "--ca-file") {
+      options->ca_file = value;
+    } else if (flag == "--report") {
+      options->report = value;
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", flag.c_str());
+      return false;
+    }
+    if (!ok) {
+      std::fprintf(stderr, "Invalid value for %s: %s\n", flag.c_str(),
+                   value.c_str());
+      return false;
+    }
+  }
+  if (options->server.empty()) {
+    std::fprintf(stderr, "--server is required\n");
+    return false;
+  }
+#ifdef _WIN32
+  if (options->certificate.empty()) {
+    std::fprintf(stderr, "--certificate is required\n");
+    return false;
+  }
+#else
+  if (options->key.empty()) {
+    std::fprintf(stderr, "--key is required\n");
+    return false;
+  }
+#endif
+  return true;
+}
+
+#ifdef _WIN32
+// The certificate of the current user's personal store whose SHA-1
+// thumbprint is the hexadecimal |thumbprint| (spaces allowed).
+std::unique_ptr<native_core::Pkcs1Signer> OpenSigner(
+    const Options& options,
+    std::string* error) {
+  std::vector<BYTE> hash;
+  int high = -1;
+  for (char c : options.certificate) {
+    int value = c >= '0' && c <= '9'   ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                       : -1;
+    if (value < 0) {
+      if (c == ' ' || c == ':') {
+        continue;
+      }
+      *error = "Huella de certificado no válida";
+      return nullptr;
+    }
+    if (high < 0) {
+      high = value;
+    } else {
+      hash.push_back(static_cast<BYTE>(high << 4 | value));
+      high = -1;
+    }
+  }
+  if (high >= 0 || hash.size() != 20) {
+    *error = "Huella de certificado no válida";
+    return nullptr;
+  }
+  HCERTSTORE store = CertOpenStore(CERT_STORE_PROV_SYSTEM_W, 0, 0,
+                                   CERT_SYSTEM_STORE_CURRENT_USER |
+                                       CERT_STORE_READONLY_FLAG,
+                                   L"MY");
+  if (!store) {
+    *error = "No se puede abrir el almacén de certificados";
+    return nullptr;
+  }
+  CRYPT_HASH_BLOB blob{static_cast<DWORD>(hash.size()), hash.data()};
+  PCCERT_CONTEXT certificate = CertFindCertificateInStore(
+      store, X509_ASN_ENCODING | PKCS_7_ASN_ENCODING, 0, CERT_FIND_HASH,
+      &blob, nullptr);
+  std::unique_ptr<native_core::Pkcs1Signer> signer;
+  if (certificate) {
+    signer = std::make_unique<native_core::CertificateSigner>(certificate);
+    CertFreeCertificateContext(certificate);
+  } else {
+    *error = "No se encuentra el certificado en el almacén personal";
+  }
+  CertCloseStore(store, 0);
+  return signer;
+}
+#else
+std::unique_ptr<native_core::Pkcs1Signer> OpenSigner(const Options& options,
+                                                     std::string* error) {
+  return native_core::FileKeySigner::Open(options.key, error);
+}
+#endif
+
+std::FILE* OpenFile(const std::string& path, const char* mode) {
+#ifdef _WIN32
+  std::FILE* file = nullptr;
+  std::wstring wide_mode(mode, mode + std::strlen(mode));
+  return _wfopen_s(&file, std::filesystem::u8path(path).c_str(),
+                   wide_mode.c_str()) == 0
+             ? file
+             : nullptr;
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+std::string JsonString(const std::string& value) {
+  std::string quoted = "\"";
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        quoted += "\\\"";
+        break;
+      case '\\':
+        quoted += "\\\\";
+        break;
+      case '\n':
+        quoted += "\\n";
+        break;
+      case '\r':
+        quoted += "\\r";
+        break;
+      case '\t':
+        quoted += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          quoted += escaped;
+        } else {
+          quoted += c;
+        }
+    }
+  }
+  return quoted + "\"";
+}
+
+// ISO 8601, in UTC.
+std::string Timestamp(std::chrono::system_clock::time_point time) {
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  std::tm utc{};
+#ifdef _WIN32
+  gmtime_s(&utc, &seconds);
+#else
+  gmtime_r(&seconds, &utc);
+#endif
+  char text[32];
+  std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+  return text;
+}
+
+const char* FailureName(TriphaseFailure failure) {
+  switch (failure) {
+    case TriphaseFailure::kNone:
+      return "none";
+    case TriphaseFailure::kNetwork:
+      return "network";
+    case TriphaseFailure::kError:
+      return "error";
+    case TriphaseFailure::kPresign:
+      return "presign";
+    case TriphaseFailure::kSignature:
+      return "signature";
+    case TriphaseFailure::kCancelled:
+      return "cancelled";
+  }
+  return "error";
+}
+
+// Writes the report to |path|, or to standard output if it is empty.
+bool WriteReport(const std::string& path,
+                 const Options& options,
+                 const std::string& dni,
+                 std::chrono::system_clock::time_point started,
+                 std::chrono::system_clock::time_point finished,
+                 int listed,
+                 const std::vector<Result>& results) {
+  std::string json = "{\n";
+  json += "  \"server\": " + JsonString(options.server) + ",\n";
+  json += "  \"state\": " + JsonString(options.state) + ",\n";
+  json += "  \"dni\": " + JsonString(dni) + ",\n";
+  json += "  \"started\": " + JsonString(Timestamp(started)) + ",\n";
+  json += "  \"finished\": " + JsonString(Timestamp(finished)) + ",\n";
+  json += "  \"seconds\": " +
+          std::to_string(
+              std::chrono::duration<double>(finished - started).count()) +
+          ",\n";
+  json += "  \"listed\": " + std::to_string(listed) + ",\n";
+  json += "  \"results\": [";
+  std::map<std::string, int> counts;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    ++counts[result.outcome];
+    json += i == 0 ? "\n" : ",\n";
+    json += "    {\"id\": " + JsonString(result.id) +
+            ", \"subject\": " + JsonString(result.subject) +
+            ", \"outcome\": " + JsonString(result.outcome) +
+            ", \"failure\": " + JsonString(FailureName(result.failure)) +
+            ", \"detail\": " + JsonString(result.detail) + "}";
+  }
+  json += results.empty() ? "],\n" : "\n  ],\n";
+  json += "  \"summary\": {";
+  bool first = true;
+  for (const char* outcome :
+       {"signed", "resumed", "failed", "cancelled", "skipped"}) {
+    json += first ? "" : ", ";
+    json += JsonString(outcome) + ": " + std::to_string(counts[outcome]);
+    first = false;
+  }
+  json += "}\n}\n";
+
+  std::FILE* file = path.empty() ? stdout : OpenFile(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+  ok = (path.empty() ? std::fflush(file) : std::fclose(file)) == 0 && ok;
+  return ok;
+}
+
+int Run(const std::vector<std::string>& args) {
+  Options options;
+  if (!ParseOptions(args, &options)) {
+    PrintUsage();
+    return 2;
+  }
+  auto started = std::chrono::system_clock::now();
+
+  std::string error;
+  std::unique_ptr<native_core::Pkcs1Signer> signer = OpenSigner(options, &error);
+  if (!signer) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 2;
+  }
+  std::unique_ptr<native_core::SigningJournal> journal;
+  if (!options.journal.empty()) {
+    journal = native_core::SigningJournal::Open(options.journal);
+    if (!journal) {
+      std::fprintf(stderr, "Cannot open the journal %s\n",
+                   options.journal.c_str());
+      return 2;
+    }
+  }
+
+  native_core::HttpClientOptions client_options;
+  client_options.max_connections_per_host =
+      static_cast<size_t>(options.connections);
+  client_options.ca_file = options.ca_file;
+  std::unique_ptr<native_core::HttpClient> client =
+      native_core::HttpClient::Create(client_options);
+  native_core::ProxySession session(client.get(), options.server);
+  if (!session.Login(signer.get(), &error)) {
+    std::fprintf(stderr, "Login failed: %s\n", error.c_str());
+    return 3;
+  }
+  std::fprintf(stderr, "Logged in as %s\n", session.dni().c_str());
+
+  native_core::TriphaseOptions engine_options;
+  engine_options.presign_window = static_cast<size_t>(options.presign_window);
+  engine_options.postsign_window =
+      static_cast<size_t>(options.postsign_window);
+  engine_options.journal = journal.get();
+  engine_options.journal_owner = session.journal_owner();
+  native_core::TriphaseEngine engine(session.transport(), signer.get(),
+                                     engine_options);
+
+  native_core::CancellationSource cancellation;
+  g_cancellation = &cancellation;
+  std::signal(SIGINT, OnInterrupt);
+
+  std::vector<Result> results;
+
+  // Postsigns left unanswered by an earlier run go first, since the proxy
+  // may list their requests as pending until then.
+  std::set<std::string> resumed;
+  if (journal) {
+    std::vector<native_core::JournaledPostsign> pending =
+        journal->Pending(session.journal_owner());
+    if (!pending.empty()) {
+      std::fprintf(stderr, "Resuming %zu journaled postsigns\n",
+                   pending.size());
+      engine.Resume(
+          pending,
+          [&](const TriphaseOutcome& outcome) {
+            Result result;
+            result.id = pending[outcome.index].request_id;
+            result.outcome = outcome.status_ok ? "resumed" : "failed";
+            result.failure = outcome.failure;
+            result.detail = outcome.detail;
+            if (outcome.status_ok) {
+              resumed.insert(result.id);
+            }
+            results.push_back(std::move(result));
+          },
+          cancellation.token());
+    }
+  }
+
+  // The whole list is collected before signing starts: signed requests leave
+  // the "unresolved" state, which would shift the pages still to be read.
+  std::vector<native_core::ListedRequest> listed;
+  std::set<std::string> seen;
+  int total = -1;
+  for (int page = 1;; ++page) {
+    std::vector<native_core::ListedRequest> requests;
+    if (!session.ListRequests(options.state, page, options.page_size,
+                              &requests, &total, &error)) {
+      std::fprintf(stderr, "Cannot list the requests: %s\n", error.c_str());
+      session.Logout();
+      return 3;
+    }
+    for (native_core::ListedRequest& request : requests) {
+      if (seen.insert(request.id).second && !resumed.count(request.id)) {
+        listed.push_back(std::move(request));
+      }
+    }
+    bool limit_reached = options.max_requests > 0 &&
+                         listed.size() >=
+                             static_cast<size_t>(options.max_requests);
+    if (requests.size() < static_cast<size_t>(options.page_size) ||
+        limit_reached ||
+        (total >= 0 && page * options.page_size >= total)) {
+      break;
+    }
+  }
+  if (options.max_requests > 0 &&
+      listed.size() > static_cast<size_t>(options.max_requests)) {
+    listed.resize(static_cast<size_t>(options.max_requests));
+  }
+
+  // Approvals (VISTOBUENO) take no signature and are left to the app.
+  std::vector<native_core::TriphaseJob> jobs;
+  std::vector<const native_core::ListedRequest*> job_requests;
+  for (const native_core::ListedRequest& request : listed) {
+    if (request.type != 0) {
+      Result result;
+      result.id = request.id;
+      result.subject = request.subject;
+      result.outcome = "skipped";
+      result.detail = request.type == 1 ? "Petición de visto bueno"
+                                        : "Tipo de petición desconocido";
+      results.push_back(std::move(result));
+      continue;
+    }
+    jobs.push_back({request.id, request.documents});
+    job_requests.push_back(&request);
+  }
+  std::fprintf(stderr, "Signing %zu of %zu listed requests\n", jobs.size(),
+               listed.size());
+
+  engine.Run(
+      jobs,
+      [&](const TriphaseOutcome& outcome) {
+        const native_core::ListedRequest& request = *job_requests[outcome.index];
+        Result result;
+        result.id = request.id;
+        result.subject = request.subject;
+        result.outcome = outcome.status_ok ? "signed"
+                         : outcome.failure == TriphaseFailure::kCancelled
+                             ? "cancelled"
+                             : "failed";
+        result.failure = outcome.failure;
+        result.detail = outcome.detail;
+        std::fprintf(stderr, "%s %s\n", result.outcome.c_str(),
+                     result.id.c_str());
+        results.push_back(std::move(result));
+      },
+      cancellation.token());
+  std::signal(SIGINT, SIG_DFL);
+  g_cancellation = nullptr;
+
+  std::string dni = session.dni();
+  session.Logout();
+  size_t failures = 0;
+  for (const Result& result : results) {
+    if (result.outcome == "failed" || result.outcome == "cancelled") {
+      ++failures;
+    }
+  }
+  if (!WriteReport(options.report, options, dni, started,
+                   std::chrono::system_clock::now(),
+                   static_cast<int>(listed.size()), results)) {
+    std::fprintf(stderr, "Cannot write the report\n");
+    return 1;
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+}  // namespace
+
+#ifdef _WIN32
+// Arguments arrive as UTF-16 and are handed on as UTF-8, which is what
+// native_core takes for paths.
+int wmain(int argc, wchar_t** argv) {
+  std::vector<std::string> args;
+  for (int i = 0; i < argc; ++i) {
+    int size = WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0,
+                                   nullptr, nullptr);
+    std::string arg(size > 0 ? size - 1 : 0, '\0');
+    if (size > 1) {
+      WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, arg.data(), size, nullptr,
+                          nullptr);
+    }
+    args.push_back(std::move(arg));
+  }
+  return Run(args);
+}
+#else
+int main(int argc, char** argv) {
+  return Run(std::vector<std::string>(argv, argv + argc));
+}
+#endif
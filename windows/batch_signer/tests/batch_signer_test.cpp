@@ -0,0 +1,329 @@
+// Copyright 2022. Chema Molins.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs batch_signer end to end against proxy_standin with a file key, and
+// checks its report, its journal and what the stand-in was sent. ctest passes
+// the daemon in BATCH_SIGNER, the stand-in in PROXY_STANDIN and native_core's
+// tests/data/file_key.pem in TEST_KEY.
+#include <native_core/file_key_signer.h>
+#include <native_core/http_client.h>
+#include <native_core/proxy_session.h>
+#include <native_core/signing_journal.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_support.h"
+
+using native_core::FileKeySigner;
+using native_core::HttpClient;
+using native_core::ListedRequest;
+using native_core::ProxySession;
+using native_core::SigningJournal;
+using native_core_tests::TempDirectory;
+
+namespace {
+
+// Requests of the single user of the stand-in; every fifth one is an
+// approval, which the daemon skips.
+constexpr int kRequests = 10;
+constexpr int kApprovals = 2;
+constexpr int kSignatures = kRequests - kApprovals;
+
+// Starts |path| with |args| and, if |output| is given, a pipe from its
+// standard error. Returns its pid, or -1.
+pid_t Spawn(const char* path, const std::vector<std::string>& args,
+            int* output = nullptr) {
+  int pipe_ends[2] = {-1, -1};
+  if (!path || (output && pipe(pipe_ends) != 0)) {
+    return -1;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (output) {
+      dup2(pipe_ends[1], STDERR_FILENO);
+      close(pipe_ends[0]);
+      close(pipe_ends[1]);
+    }
+    std::vector<char*> argv = {const_cast<char*>(path)};
+    for (const std::string& arg : args) {
+      argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(path, argv.data());
+    _exit(127);
+  }
+  if (output) {
+    close(pipe_ends[1]);
+    *output = pipe_ends[0];
+  }
+  return pid;
+}
+
+// The exit code of |pid|, or -1 if it did not exit by itself.
+int Wait(pid_t pid) {
+  int status = 0;
+  if (pid <= 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+// proxy_standin, run for the life of the object. Its requests start over
+// every time it is started.
+class StandIn {
+ public:
+  // On a free port if |port| is 0. |latency| is passed on as --latency.
+  explicit StandIn(int port = 0, const std::string& latency = "") {
+    std::vector<std::string> args = {
+        "--port",  std::to_string(port), "--users",       "1",
+        "--requests", std::to_string(kRequests), "--documents", "2",
+        "--document-kb", "1"};
+    if (!latency.empty()) {
+      args.insert(args.end(), {"--latency", latency});
+    }
+    int output = -1;
+    pid_ = Spawn(std::getenv("PROXY_STANDIN"), args, &output);
+    if (pid_ <= 0) {
+      return;
+    }
+    // "Serving ... on http://127.0.0.1:PORT/".
+    std::string line;
+    char c = 0;
+    while (line.size() < 256 && read(output, &c, 1) == 1 && c != '\n') {
+      line += c;
+    }
+    close(output);
+    size_t url = line.rfind("http://");
+    if (url != std::string::npos) {
+      url_ = line.substr(url);
+      port_ = std::atoi(url_.c_str() + url_.rfind(':') + 1);
+    }
+  }
+
+  ~StandIn() {
+    if (pid_ > 0) {
+      kill(pid_, SIGTERM);
+      Wait(pid_);
+    }
+  }
+
+  // Prevent copying.
+  StandIn(StandIn const&) = delete;
+  StandIn& operator=(StandIn const&) = delete;
+
+  // Empty if the stand-in did not start.
+  const std::string& url() const { return url_; }
+  int port() const { return port_; }
+
+ private:
+  pid_t pid_ = -1;
+  std::string url_;
+  int port_ = 0;
+};
+
+// A logged in session of the stand-in's user, to see what the daemon did.
+struct Observer {
+  explicit Observer(const std::string& url) : session(client.get(), url) {
+    const char* path = std::getenv("TEST_KEY");
+    std::string error;
+    std::unique_ptr<FileKeySigner> signer =
+        path ? FileKeySigner::Open(path, &error) : nullptr;
+    logged_in = signer && !url.empty() && session.Login(signer.get(), &error);
+  }
+
+  // The ids of the requests listed in |state|.
+  std::set<std::string> List(const std::string& state) {
+    std::vector<ListedRequest> requests;
+    int total = -1;
+    std::string error;
+    std::set<std::string> ids;
+    if (session.ListRequests(state, 1, 100, &requests, &total, &error)) {
+      for (const ListedRequest& request : requests) {
+        ids.insert(request.id);
+      }
+    }
+    return ids;
+  }
+
+  std::unique_ptr<HttpClient> client = HttpClient::Create();
+  ProxySession session;
+  bool logged_in = false;
+};
+
+std::vector<std::string> SignerArgs(const std::string& url,
+                                    const std::string& journal,
+                                    const std::string& report) {
+  const char* key = std::getenv("TEST_KEY");
+  return {"--server", url,     "--key",    key ? key : "", "--journal",
+          journal,    "--report", report, "--page-size", "3"};
+}
+
+std::string ReadAll(const std::string& path) {
+  std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+// The ids of the report's results with |outcome|, one result per line.
+std::set<std::string> Outcomes(const std::string& report,
+                               const std::string& outcome) {
+  std::set<std::string> ids;
+  const std::string id_key = "{\"id\": \"";
+  const std::string outcome_key = "\"outcome\": \"" + outcome + "\"";
+  size_t line = 0;
+  while ((line = report.find(id_key, line)) != std::string::npos) {
+    size_t end = report.find('\n', line);
+    std::string result = report.substr(line, end - line);
+    if (result.find(outcome_key) != std::string::npos) {
+      size_t id = id_key.size();
+      ids.insert(result.substr(id, result.find('"', id) - id));
+    }
+    line = end;
+  }
+  return ids;
+}
+
+// The requests of |owner| the journal at |path| holds as not answered.
+std::set<std::string> Pending(const std::string& path,
+                              const std::string& owner) {
+  std::set<std::string> ids;
+  std::unique_ptr<SigningJournal> journal = SigningJournal::Open(path);
+  if (journal) {
+    for (const native_core::JournaledPostsign& postsign :
+         journal->Pending(owner)) {
+      ids.insert(postsign.request_id);
+    }
+  }
+  return ids;
+}
+
+uintmax_t FileSize(const std::string& path) {
+  std::error_code error;
+  uintmax_t size =
+      std::filesystem::file_size(std::filesystem::u8path(path), error);
+  return error ? 0 : size;
+}
+
+}  // namespace
+
+TEST(SignsEverySignatureRequestOnce) {
+  StandIn standin;
+  ASSERT_TRUE(!standin.url().empty());
+  TempDirectory directory;
+  std::string journal = directory.File("journal");
+  std::string report = directory.File("report.json");
+
+  EXPECT_EQ(Wait(Spawn(std::getenv("BATCH_SIGNER"),
+                       SignerArgs(standin.url(), journal, report))),
+            0);
+  std::string json = ReadAll(report);
+  std::set<std::string> signed_ids = Outcomes(json, "signed");
+  EXPECT_EQ(signed_ids.size(), static_cast<size_t>(kSignatures));
+  EXPECT_EQ(Outcomes(json, "skipped").size(), static_cast<size_t>(kApprovals));
+  EXPECT_TRUE(json.find("\"summary\": {\"signed\": 8, \"resumed\": 0, "
+                        "\"failed\": 0, \"cancelled\": 0, \"skipped\": 2}") !=
+              std::string::npos);
+
+  // The stand-in took every postsign, and the journal has nothing left.
+  Observer observer(standin.url());
+  ASSERT_TRUE(observer.logged_in);
+  EXPECT_TRUE(observer.List("signed") == signed_ids);
+  EXPECT_EQ(observer.List("unresolved").size(),
+            static_cast<size_t>(kApprovals));
+  EXPECT_TRUE(Pending(journal, observer.session.journal_owner()).empty());
+
+  // Run again, there is nothing left to sign.
+  EXPECT_EQ(Wait(Spawn(std::getenv("BATCH_SIGNER"),
+                       SignerArgs(standin.url(), journal, report))),
+            0);
+  json = ReadAll(report);
+  EXPECT_TRUE(Outcomes(json, "signed").empty());
+  EXPECT_TRUE(Outcomes(json, "resumed").empty());
+  EXPECT_EQ(Outcomes(json, "skipped").size(), static_cast<size_t>(kApprovals));
+  EXPECT_EQ(observer.List("signed").size(), static_cast<size_t>(kSignatures));
+}
+
+TEST(InterruptedRunIsResumedWithoutSigningAgain) {
+  TempDirectory directory;
+  std::string journal = directory.File("journal");
+  std::string report = directory.File("report.json");
+  // The size of a journal with nothing in it.
+  SigningJournal::Open(directory.File("empty"));
+  uintmax_t empty = FileSize(directory.File("empty"));
+
+  // Postsigns are held by the stand-in, so the daemon is killed with
+  // signatures journaled and not answered.
+  int port = 0;
+  {
+    StandIn stalled(0, "1=60000");
+    ASSERT_TRUE(!stalled.url().empty());
+    port = stalled.port();
+    pid_t signer = Spawn(std::getenv("BATCH_SIGNER"),
+                         SignerArgs(stalled.url(), journal, report));
+    ASSERT_TRUE(signer > 0);
+    bool journaled = native_core_tests::WaitFor(
+        [&]() { return FileSize(journal) > empty; },
+        std::chrono::seconds(30));
+    // Give the rest of the postsign window time to be journaled too.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    kill(signer, SIGKILL);
+    EXPECT_EQ(Wait(signer), -1);
+    ASSERT_TRUE(journaled);
+  }
+
+  // The same server, started again, had none of them postsigned.
+  StandIn standin(port);
+  ASSERT_TRUE(!standin.url().empty());
+  Observer observer(standin.url());
+  ASSERT_TRUE(observer.logged_in);
+  std::string owner = observer.session.journal_owner();
+  std::set<std::string> pending = Pending(journal, owner);
+  ASSERT_TRUE(!pending.empty());
+  EXPECT_TRUE(pending.size() < static_cast<size_t>(kSignatures));
+  EXPECT_TRUE(observer.List("signed").empty());
+
+  EXPECT_EQ(Wait(Spawn(std::getenv("BATCH_SIGNER"),
+                       SignerArgs(standin.url(), journal, report))),
+            0);
+  std::string json = ReadAll(report);
+  // The journaled ones were postsigned as they were, and left out of the
+  // requests signed.
+  std::set<std::string> resumed = Outcomes(json, "resumed");
+  std::set<std::string> signed_ids = Outcomes(json, "signed");
+  EXPECT_TRUE(resumed == pending);
+  for (const std::string& id : resumed) {
+    EXPECT_EQ(signed_ids.count(id), 0u);
+  }
+  EXPECT_EQ(resumed.size() + signed_ids.size(),
+            static_cast<size_t>(kSignatures));
+  EXPECT_TRUE(Outcomes(json, "failed").empty());
+
+  std::set<std::string> all = resumed;
+  all.insert(signed_ids.begin(), signed_ids.end());
+  EXPECT_TRUE(observer.List("signed") == all);
+  EXPECT_TRUE(Pending(journal, owner).empty());
+}
@@ -9,6 +9,7 @@
 #include <digital_certificates/digital_certificates_plugin.h>
 #include <flutter_downloader_fde/flutter_downloader_plugin.h>
 #include <permission_handler_windows/permission_handler_windows_plugin.h>
+#include <portafirmas_native/portafirmas_native_plugin.h>
 
 void RegisterPlugins(flutter::PluginRegistry* registry) {
   DigitalCertificatesPluginRegisterWithRegistrar(
@@ -17,4 +18,6 @@ void RegisterPlugins(flutter::PluginRegistry* registry) {
       registry->GetRegistrarForPlugin("FlutterDownloaderPlugin"));
   PermissionHandlerWindowsPluginRegisterWithRegistrar(
       registry->GetRegistrarForPlugin("PermissionHandlerWindowsPlugin"));
+  PortafirmasNativePluginRegisterWithRegistrar(
+      registry->GetRegistrarForPlugin("PortafirmasNativePlugin"));
 }
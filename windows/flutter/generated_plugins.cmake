@@ -6,6 +6,7 @@ list(APPEND FLUTTER_PLUGIN_LIST
   digital_certificates
   flutter_downloader_fde
   permission_handler_windows
+  portafirmas_native
 )
 
 list(APPEND FLUTTER_FFI_PLUGIN_LIST
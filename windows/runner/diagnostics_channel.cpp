@@ -0,0 +1,101 @@
+#include "diagnostics_channel.h"
+
+#include <flutter/standard_method_codec.h>
+#include <native_core/first_frame.h>
+
+#include "startup_timeline.h"
+#include "utils.h"
+
+namespace {
+
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
+
+int64_t ToMicroseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+EncodableValue HistogramToValue(
+    const native_core::DurationHistogram& histogram) {
+  return EncodableValue(EncodableMap{
+      {EncodableValue("count"),
+       EncodableValue(static_cast<int64_t>(histogram.count()))},
+      {EncodableValue("p50"),
+       EncodableValue(ToMicroseconds(histogram.Percentile(50)))},
+      {EncodableValue("p90"),
+       EncodableValue(ToMicroseconds(histogram.Percentile(90)))},
+      {EncodableValue("p99"),
+       EncodableValue(ToMicroseconds(histogram.Percentile(99)))},
+      {EncodableValue("max"), EncodableValue(ToMicroseconds(histogram.max()))},
+      {EncodableValue("total"),
+       EncodableValue(ToMicroseconds(histogram.total()))},
+  });
+}
+
+}  // namespace
+
+DiagnosticsChannel::DiagnosticsChannel(flutter::BinaryMessenger* messenger,
+                                       const RunLoop* run_loop)
+    : run_loop_(run_loop),
+      channel_(std::make_unique<flutter::MethodChannel<EncodableValue>>(
+          messenger, "portafirmas/diagnostics",
+          &flutter::StandardMethodCodec::GetInstance())) {
+  channel_->SetMethodCallHandler([this](const auto& call, auto result) {
+    HandleMethodCall(call, std::move(result));
+  });
+}
+
+void DiagnosticsChannel::HandleMethodCall(
+    const flutter::MethodCall<EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<EncodableValue>> result) {
+  const std::string& method = method_call.method_name();
+  if (method == "stallCounts") {
+    EncodableMap counts;
+    if (run_loop_->watchdog()) {
+      for (const auto& [call, count] : run_loop_->watchdog()->StallCounts()) {
+        counts[EncodableValue(call)] =
+            EncodableValue(static_cast<int64_t>(count));
+      }
+    }
+    result->Success(EncodableValue(counts));
+  } else if (method == "loopStats") {
+    const LoopScheduler& scheduler = run_loop_->scheduler();
+    result->Success(EncodableValue(EncodableMap{
+        {EncodableValue("iterations"),
+         EncodableValue(static_cast<int64_t>(scheduler.iterations()))},
+        {EncodableValue("idle"), HistogramToValue(scheduler.idle())},
+        {EncodableValue("busy"), HistogramToValue(scheduler.busy())},
+        {EncodableValue("lateness"), HistogramToValue(scheduler.lateness())},
+    }));
+  } else if (method == "startupPhase") {
+    const auto* phase = std::get_if<std::string>(method_call.arguments());
+    if (!phase) {
+      result->Error("BAD_ARGS", "Expected the phase name");
+      return;
+    }
+    StartupTimeline::Get().Mark(*phase);
+    result->Success();
+  } else if (method == "firstFrame") {
+    StartupTimeline& timeline = StartupTimeline::Get();
+    if (!timeline.IsComplete()) {
+      timeline.Complete("first frame");
+      std::wstring diagnostics_directory = GetDiagnosticsDirectory();
+      if (!diagnostics_directory.empty()) {
+        timeline.WriteTrace(diagnostics_directory + L"\\startup_trace.json");
+      }
+    }
+    result->Success();
+    native_core::NotifyFirstFrame();
+  } else if (method == "startupTimeline") {
+    EncodableList phases;
+    for (const auto& [name, offset] : StartupTimeline::Get().phases()) {
+      phases.push_back(EncodableValue(EncodableList{
+          EncodableValue(name), EncodableValue(ToMicroseconds(offset))}));
+    }
+    result->Success(EncodableValue(phases));
+  } else {
+    result->NotImplemented();
+  }
+}
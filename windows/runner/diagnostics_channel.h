@@ -0,0 +1,41 @@
+#ifndef RUNNER_DIAGNOSTICS_CHANNEL_H_
+#define RUNNER_DIAGNOSTICS_CHANNEL_H_
+
+#include <flutter/binary_messenger.h>
+#include <flutter/encodable_value.h>
+#include <flutter/method_channel.h>
+
+#include <memory>
+
+#include "run_loop.h"
+
+// Answers diagnostics queries from Dart on the "portafirmas/diagnostics"
+// channel:
+//  - stallCounts: map of "channel/method" to the number of platform thread
+//    stalls attributed to it.
+//  - loopStats: run loop iteration count and idle/busy/lateness percentiles,
+//    in microseconds.
+//  - startupPhase(name): marks a Dart-side phase on the startup timeline.
+//  - firstFrame: completes the startup timeline, writes startup_trace.json
+//    and releases the initialization plugins deferred past the first frame.
+//  - startupTimeline: list of [phase, microseconds since process creation].
+class DiagnosticsChannel {
+ public:
+  // |run_loop| must outlive the channel.
+  DiagnosticsChannel(flutter::BinaryMessenger* messenger,
+                     const RunLoop* run_loop);
+
+  // Prevent copying.
+  DiagnosticsChannel(DiagnosticsChannel const&) = delete;
+  DiagnosticsChannel& operator=(DiagnosticsChannel const&) = delete;
+
+ private:
+  void HandleMethodCall(
+      const flutter::MethodCall<flutter::EncodableValue>& method_call,
+      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  const RunLoop* run_loop_;
+  std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
+};
+
+#endif  // RUNNER_DIAGNOSTICS_CHANNEL_H_
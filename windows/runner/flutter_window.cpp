@@ -3,9 +3,11 @@
 #include <optional>
 
 #include "flutter/generated_plugin_registrant.h"
+#include "startup_timeline.h"
 
-FlutterWindow::FlutterWindow(const flutter::DartProject& project)
-    : project_(project) {}
+FlutterWindow::FlutterWindow(RunLoop* run_loop,
+                             const flutter::DartProject& project)
+    : run_loop_(run_loop), project_(project) {}
 
 FlutterWindow::~FlutterWindow() {}
 
@@ -24,13 +26,20 @@ bool FlutterWindow::OnCreate() {
   if (!flutter_controller_->engine() || !flutter_controller_->view()) {
     return false;
   }
+  StartupTimeline::Get().Mark("engine created");
   RegisterPlugins(flutter_controller_->engine());
+  StartupTimeline::Get().Mark("plugins registered");
+  run_loop_->RegisterFlutterInstance(flutter_controller_->engine());
+  diagnostics_channel_ = std::make_unique<DiagnosticsChannel>(
+      flutter_controller_->engine()->messenger(), run_loop_);
   SetChildContent(flutter_controller_->view()->GetNativeWindow());
   return true;
 }
 
 void FlutterWindow::OnDestroy() {
+  diagnostics_channel_ = nullptr;
   if (flutter_controller_) {
+    run_loop_->UnregisterFlutterInstance(flutter_controller_->engine());
     flutter_controller_ = nullptr;
   }
 
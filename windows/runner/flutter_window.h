@@ -6,13 +6,17 @@
 
 #include <memory>
 
+#include "diagnostics_channel.h"
+#include "run_loop.h"
 #include "win32_window.h"
 
 // A window that does nothing but host a Flutter view.
 class FlutterWindow : public Win32Window {
  public:
-  // Creates a new FlutterWindow hosting a Flutter view running |project|.
-  explicit FlutterWindow(const flutter::DartProject& project);
+  // Creates a new FlutterWindow driven by |run_loop|, hosting a
+  // Flutter view running |project|.
+  explicit FlutterWindow(RunLoop* run_loop,
+                         const flutter::DartProject& project);
   virtual ~FlutterWindow();
 
  protected:
@@ -23,11 +27,17 @@ class FlutterWindow : public Win32Window {
                          LPARAM const lparam) noexcept override;
 
  private:
+  // The run loop driving events for this window.
+  RunLoop* run_loop_;
+
   // The project to run.
   flutter::DartProject project_;
 
   // The Flutter instance hosted by this window.
   std::unique_ptr<flutter::FlutterViewController> flutter_controller_;
+
+  // Answers diagnostics queries from Dart.
+  std::unique_ptr<DiagnosticsChannel> diagnostics_channel_;
 };
 
 #endif  // RUNNER_FLUTTER_WINDOW_H_
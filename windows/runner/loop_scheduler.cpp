@@ -0,0 +1,83 @@
+#include "loop_scheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr int64_t kNanosecondsPerMillisecond = 1000000;
+constexpr int64_t kNanosecondsPerTimerTick = 100;
+
+// |value| must not be negative. Does not overflow near the int64_t maximum,
+// where a nanoseconds::max() wait ends up.
+int64_t DivideRoundingUp(int64_t value, int64_t divisor) {
+  return value / divisor + (value % divisor != 0 ? 1 : 0);
+}
+
+}  // namespace
+
+LoopScheduler::LoopScheduler(const LoopClock* clock)
+    : clock_(clock), idle_start_(clock->Now()), busy_start_(idle_start_) {}
+
+void LoopScheduler::SetNextDeadline(TimePoint deadline) {
+  next_deadline_ = deadline;
+}
+
+LoopScheduler::TimePoint LoopScheduler::DeadlineAfter(
+    std::chrono::nanoseconds delay) const {
+  if (delay == std::chrono::nanoseconds::max()) {
+    return TimePoint::max();
+  }
+  return clock_->Now() + std::max(delay, std::chrono::nanoseconds(0));
+}
+
+std::chrono::nanoseconds LoopScheduler::WaitDuration() const {
+  if (next_deadline_ == TimePoint::max()) {
+    return std::chrono::nanoseconds::max();
+  }
+  return std::max(std::chrono::nanoseconds(0),
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      next_deadline_ - clock_->Now()));
+}
+
+// static
+uint32_t LoopScheduler::ToTimeoutMilliseconds(std::chrono::nanoseconds wait) {
+  // Leave room for INFINITE (0xFFFFFFFF), which callers use for "no deadline".
+  constexpr int64_t kLongestTimeout = std::numeric_limits<uint32_t>::max() - 1;
+  if (wait == std::chrono::nanoseconds::max()) {
+    return std::numeric_limits<uint32_t>::max();
+  }
+  int64_t milliseconds =
+      DivideRoundingUp(std::max<int64_t>(wait.count(), 0),
+                       kNanosecondsPerMillisecond);
+  return static_cast<uint32_t>(std::min(milliseconds, kLongestTimeout));
+}
+
+// static
+int64_t LoopScheduler::ToRelativeTimerDueTime(std::chrono::nanoseconds wait) {
+  int64_t ticks = DivideRoundingUp(std::max<int64_t>(wait.count(), 0),
+                                   kNanosecondsPerTimerTick);
+  // A due time of zero means "absolute time zero", i.e. fire immediately,
+  // which is also what a non-positive wait wants.
+  return -ticks;
+}
+
+void LoopScheduler::BeginIdle() {
+  TimePoint now = clock_->Now();
+  busy_.Record(now - busy_start_);
+  idle_start_ = now;
+}
+
+void LoopScheduler::EndIdle() {
+  TimePoint now = clock_->Now();
+  idle_.Record(now - idle_start_);
+  if (next_deadline_ != TimePoint::max() && now >= next_deadline_) {
+    lateness_.Record(now - next_deadline_);
+  }
+  busy_start_ = now;
+  iterations_++;
+}
+
+bool LoopScheduler::IsDeadlineDue() const {
+  return next_deadline_ != TimePoint::max() && clock_->Now() >= next_deadline_;
+}
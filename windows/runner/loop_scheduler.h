@@ -0,0 +1,96 @@
+#ifndef RUNNER_LOOP_SCHEDULER_H_
+#define RUNNER_LOOP_SCHEDULER_H_
+
+#include <native_core/histogram.h>
+
+#include <chrono>
+#include <cstdint>
+
+// Source of time for LoopScheduler, so the scheduling decisions can be
+// driven by a fake clock away from the Win32 message loop.
+class LoopClock {
+ public:
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  virtual ~LoopClock() = default;
+
+  virtual TimePoint Now() const = 0;
+};
+
+// LoopClock backed by std::chrono::steady_clock (QueryPerformanceCounter on
+// Windows).
+class SteadyLoopClock : public LoopClock {
+ public:
+  TimePoint Now() const override { return std::chrono::steady_clock::now(); }
+};
+
+// Platform-independent bookkeeping for RunLoop.
+//
+// Tracks the next time engine tasks are due, turns it into the duration the
+// loop may block for, and records how the loop spends its time:
+//  - idle: time spent blocked waiting for messages or the next deadline.
+//  - busy: time spent servicing one iteration (messages, engine tasks and
+//    plugin completions).
+//  - lateness: how long after a due deadline the loop actually serviced it.
+class LoopScheduler {
+ public:
+  using TimePoint = LoopClock::TimePoint;
+
+  // |clock| must outlive the scheduler.
+  explicit LoopScheduler(const LoopClock* clock);
+
+  // Prevent copying.
+  LoopScheduler(LoopScheduler const&) = delete;
+  LoopScheduler& operator=(LoopScheduler const&) = delete;
+
+  // Records the next deadline reported by the engines at the time of the
+  // call. TimePoint::max() means nothing is scheduled.
+  void SetNextDeadline(TimePoint deadline);
+
+  // Converts a "run again in |delay|" answer from FlutterEngine::
+  // ProcessMessages() into an absolute deadline; nanoseconds::max() means no
+  // pending task.
+  TimePoint DeadlineAfter(std::chrono::nanoseconds delay) const;
+
+  TimePoint next_deadline() const { return next_deadline_; }
+
+  // How long the loop may block before the next deadline. Zero if it is
+  // already due; nanoseconds::max() if there is no deadline.
+  std::chrono::nanoseconds WaitDuration() const;
+
+  // Rounds |wait| up to whole milliseconds for APIs with millisecond
+  // resolution, so the loop never wakes before the deadline and spins.
+  static uint32_t ToTimeoutMilliseconds(std::chrono::nanoseconds wait);
+
+  // Converts |wait| to the negative, relative 100ns count expected by
+  // SetWaitableTimer, rounding up.
+  static int64_t ToRelativeTimerDueTime(std::chrono::nanoseconds wait);
+
+  // Brackets the blocking wait of one iteration. The time between EndIdle()
+  // and the next BeginIdle() is recorded as busy time.
+  void BeginIdle();
+  void EndIdle();
+
+  // True if the deadline has passed and engine tasks should be serviced.
+  bool IsDeadlineDue() const;
+
+  const native_core::DurationHistogram& idle() const { return idle_; }
+  const native_core::DurationHistogram& busy() const { return busy_; }
+  const native_core::DurationHistogram& lateness() const { return lateness_; }
+
+  uint64_t iterations() const { return iterations_; }
+
+ private:
+  const LoopClock* clock_;
+
+  TimePoint next_deadline_ = TimePoint::max();
+  TimePoint idle_start_;
+  TimePoint busy_start_;
+  uint64_t iterations_ = 0;
+
+  native_core::DurationHistogram idle_;
+  native_core::DurationHistogram busy_;
+  native_core::DurationHistogram lateness_;
+};
+
+#endif  // RUNNER_LOOP_SCHEDULER_H_
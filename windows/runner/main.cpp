@@ -3,10 +3,24 @@
 #include <windows.h>
 
 #include "flutter_window.h"
+#include "platform_watchdog.h"
+#include "run_loop.h"
+#include "startup_timeline.h"
 #include "utils.h"
 
+namespace {
+
+// How long the platform thread may stay away from the run loop before the
+// watchdog reports a stall.
+constexpr std::chrono::milliseconds kStallThreshold(2000);
+
+}  // namespace
+
 int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
                       _In_ wchar_t *command_line, _In_ int show_command) {
+  StartupTimeline& startup = StartupTimeline::Get();
+  startup.Mark("process start");
+
   // Attach to console when present (e.g., 'flutter run') or create a
   // new console when running with a debugger.
   if (!::AttachConsole(ATTACH_PARENT_PROCESS) && ::IsDebuggerPresent()) {
@@ -16,6 +30,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
   // Initialize COM, so that it is available for use in the library and/or
   // plugins.
   ::CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+  startup.Mark("CoInitializeEx");
 
   flutter::DartProject project(L"data");
 
@@ -24,19 +39,24 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
 
   project.set_dart_entrypoint_arguments(std::move(command_line_arguments));
 
-  FlutterWindow window(project);
+  RunLoop run_loop;
+  std::wstring diagnostics_directory = GetDiagnosticsDirectory();
+  PlatformWatchdog watchdog(
+      kStallThreshold, diagnostics_directory.empty()
+                           ? std::wstring()
+                           : diagnostics_directory + L"\\stalls.log");
+  run_loop.SetWatchdog(&watchdog);
+
+  FlutterWindow window(&run_loop, project);
   Win32Window::Point origin(10, 10);
   Win32Window::Size size(1280, 720);
   if (!window.CreateAndShow(L"Portafirmas", origin, size)) {
     return EXIT_FAILURE;
   }
   window.SetQuitOnClose(true);
+  startup.Mark("window shown");
 
-  ::MSG msg;
-  while (::GetMessage(&msg, nullptr, 0, 0)) {
-    ::TranslateMessage(&msg);
-    ::DispatchMessage(&msg);
-  }
+  run_loop.Run();
 
   ::CoUninitialize();
   return EXIT_SUCCESS;
@@ -0,0 +1,247 @@
+#include "platform_watchdog.h"
+
+#include <native_core/call_tracker.h>
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "utils.h"
+
+namespace {
+
+constexpr char kUntrackedCall[] = "(none)";
+
+// Frames kept per captured stack.
+constexpr int kMaxFrames = 48;
+
+// How often the watchdog looks at the platform thread, relative to the
+// threshold; also bounded so short thresholds do not spin.
+constexpr int kPollsPerThreshold = 4;
+constexpr std::chrono::milliseconds kMinPollInterval(10);
+
+std::string FormatUtc(std::chrono::system_clock::time_point time) {
+  auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          time.time_since_epoch())
+                          .count() %
+                      1000;
+  std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  std::tm utc{};
+  gmtime_s(&utc, &seconds);
+  std::ostringstream out;
+  out << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S") << '.' << std::setw(3)
+      << std::setfill('0') << milliseconds << 'Z';
+  return out.str();
+}
+
+// Returns "module+0xoffset" for a code address.
+std::string SymbolizeAddress(uintptr_t address) {
+  HMODULE module = nullptr;
+  if (!::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                                GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                            reinterpret_cast<LPCWSTR>(address), &module)) {
+    std::ostringstream out;
+    out << "0x" << std::hex << address;
+    return out.str();
+  }
+  wchar_t path[MAX_PATH];
+  DWORD length = ::GetModuleFileNameW(module, path, MAX_PATH);
+  std::wstring name(path, length);
+  size_t separator = name.find_last_of(L"\\/");
+  if (separator != std::wstring::npos) {
+    name = name.substr(separator + 1);
+  }
+  std::ostringstream out;
+  out << Utf8FromUtf16(name.c_str()) << "+0x" << std::hex
+      << (address - reinterpret_cast<uintptr_t>(module));
+  return out.str();
+}
+
+// Unwinds the stack of the suspended |thread| into |frames|. Returns the number
+// of frames written. Must not allocate; see CapturePlatformStack().
+int WalkSuspendedStack(HANDLE thread, uintptr_t* frames, int max_frames) {
+  int frame_count = 0;
+#if defined(_M_X64)
+  CONTEXT context{};
+  context.ContextFlags = CONTEXT_FULL;
+  if (!::GetThreadContext(thread, &context)) {
+    return 0;
+  }
+  // A corrupt or unusual frame must cost us the rest of the stack, never the
+  // process.
+  __try {
+    while (frame_count < max_frames && context.Rip != 0) {
+      frames[frame_count++] = static_cast<uintptr_t>(context.Rip);
+      DWORD64 image_base = 0;
+      PRUNTIME_FUNCTION function =
+          ::RtlLookupFunctionEntry(context.Rip, &image_base, nullptr);
+      if (function) {
+        PVOID handler_data = nullptr;
+        DWORD64 establisher_frame = 0;
+        ::RtlVirtualUnwind(UNW_FLAG_NHANDLER, image_base, context.Rip,
+                           function, &context, &handler_data,
+                           &establisher_frame, nullptr);
+      } else {
+        // Leaf function: the return address is on top of the stack.
+        context.Rip = *reinterpret_cast<DWORD64*>(context.Rsp);
+        context.Rsp += sizeof(DWORD64);
+      }
+    }
+  } __except (EXCEPTION_EXECUTE_HANDLER) {
+  }
+#else
+  (void)thread;
+  (void)frames;
+  (void)max_frames;
+#endif
+  return frame_count;
+}
+
+}  // namespace
+
+PlatformWatchdog::PlatformWatchdog(std::chrono::milliseconds threshold,
+                                   std::wstring log_path)
+    : threshold_(threshold), log_path_(std::move(log_path)) {
+  ::DuplicateHandle(::GetCurrentProcess(), ::GetCurrentThread(),
+                    ::GetCurrentProcess(), &platform_thread_,
+                    THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT |
+                        THREAD_QUERY_INFORMATION,
+                    FALSE, 0);
+  thread_ = std::thread(&PlatformWatchdog::WatchdogMain, this);
+}
+
+PlatformWatchdog::~PlatformWatchdog() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  stop_requested_.notify_all();
+  thread_.join();
+  if (platform_thread_) {
+    ::CloseHandle(platform_thread_);
+  }
+}
+
+void PlatformWatchdog::EnterBusy() {
+  busy_epoch_.fetch_add(1, std::memory_order_relaxed);
+  busy_since_ns_.store(NowNanoseconds(), std::memory_order_release);
+}
+
+void PlatformWatchdog::ExitBusy() {
+  int64_t since = busy_since_ns_.exchange(0, std::memory_order_acq_rel);
+  if (since != 0) {
+    last_exit_ns_.store(NowNanoseconds(), std::memory_order_release);
+  }
+}
+
+std::map<std::string, uint64_t> PlatformWatchdog::StallCounts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stall_counts_;
+}
+
+void PlatformWatchdog::WatchdogMain() {
+  const auto poll_interval =
+      std::max(std::chrono::duration_cast<std::chrono::milliseconds>(
+                   threshold_ / kPollsPerThreshold),
+               kMinPollInterval);
+  const int64_t threshold_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(threshold_).count();
+
+  bool in_stall = false;
+  int64_t stall_start_ns = 0;
+  Stall stall;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    stop_requested_.wait_for(lock, poll_interval);
+    if (stopping_) {
+      break;
+    }
+    lock.unlock();
+
+    uint64_t epoch = busy_epoch_.load(std::memory_order_relaxed);
+    int64_t since = busy_since_ns_.load(std::memory_order_acquire);
+    int64_t now = NowNanoseconds();
+
+    if (in_stall && (since == 0 || epoch != stall.epoch)) {
+      // The stalled unit finished. Its exit time is exact unless later units
+      // have already finished too, in which case it is an upper bound.
+      int64_t end = last_exit_ns_.load(std::memory_order_acquire);
+      WriteRecord(stall, std::chrono::nanoseconds(end - stall_start_ns),
+                  false);
+      in_stall = false;
+    }
+
+    if (!in_stall && since != 0 && now - since >= threshold_ns) {
+      in_stall = true;
+      stall_start_ns = since;
+      stall.epoch = epoch;
+      if (!native_core::CallTracker::Get().Snapshot(&stall.call)) {
+        stall.call = kUntrackedCall;
+      }
+      stall.started_wall =
+          std::chrono::system_clock::now() -
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              std::chrono::nanoseconds(now - since));
+      stall.stack = CapturePlatformStack();
+      std::lock_guard<std::mutex> counts_lock(mutex_);
+      stall_counts_[stall.call]++;
+    }
+
+    lock.lock();
+  }
+
+  if (in_stall) {
+    lock.unlock();
+    WriteRecord(stall,
+                std::chrono::nanoseconds(NowNanoseconds() - stall_start_ns),
+                true);
+  }
+}
+
+std::vector<std::string> PlatformWatchdog::CapturePlatformStack() {
+  std::vector<std::string> stack;
+  // Nothing may allocate while the platform thread is suspended: it could be
+  // holding the heap lock. Collect raw addresses first, symbolize afterwards.
+  uintptr_t frames[kMaxFrames];
+  if (!platform_thread_ || ::SuspendThread(platform_thread_) == DWORD(-1)) {
+    return stack;
+  }
+  int frame_count = WalkSuspendedStack(platform_thread_, frames, kMaxFrames);
+  ::ResumeThread(platform_thread_);
+
+  stack.reserve(frame_count);
+  for (int i = 0; i < frame_count; i++) {
+    stack.push_back(SymbolizeAddress(frames[i]));
+  }
+  return stack;
+}
+
+void PlatformWatchdog::WriteRecord(const Stall& stall,
+                                   std::chrono::nanoseconds duration,
+                                   bool ongoing) {
+  if (log_path_.empty()) {
+    return;
+  }
+  std::ofstream out(log_path_, std::ios::app);
+  if (!out) {
+    return;
+  }
+  out << FormatUtc(stall.started_wall) << " stall "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+             .count()
+      << " ms" << (ongoing ? " (ongoing at exit)" : "") << " in "
+      << stall.call << '\n';
+  for (const std::string& frame : stall.stack) {
+    out << "    at " << frame << '\n';
+  }
+}
+
+// static
+int64_t PlatformWatchdog::NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
@@ -0,0 +1,84 @@
+#ifndef RUNNER_PLATFORM_WATCHDOG_H_
+#define RUNNER_PLATFORM_WATCHDOG_H_
+
+#include <windows.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Detects when the platform thread stays away from the run loop for longer
+// than a threshold, e.g. a smart card PIN prompt or a slow CSP inside
+// signData.
+//
+// RunLoop brackets every unit of work with EnterBusy()/ExitBusy(). A
+// background thread notices units that overrun the threshold, attributes them
+// to the method-channel call in progress (see native_core::CallTracker),
+// captures the platform thread's stack and, once the unit finishes, appends a
+// record with its duration to the stall log.
+class PlatformWatchdog {
+ public:
+  // Must be constructed on the platform thread. Records are appended to
+  // |log_path|; an empty path keeps only the counters.
+  PlatformWatchdog(std::chrono::milliseconds threshold,
+                   std::wstring log_path);
+  ~PlatformWatchdog();
+
+  // Prevent copying.
+  PlatformWatchdog(PlatformWatchdog const&) = delete;
+  PlatformWatchdog& operator=(PlatformWatchdog const&) = delete;
+
+  // Called by the platform thread around each unit of work.
+  void EnterBusy();
+  void ExitBusy();
+
+  // Number of stalls seen per "channel/method". Stalls outside any tracked
+  // call are counted under "(none)". Thread-safe.
+  std::map<std::string, uint64_t> StallCounts() const;
+
+ private:
+  struct Stall {
+    uint64_t epoch = 0;
+    std::string call;
+    std::chrono::system_clock::time_point started_wall;
+    std::vector<std::string> stack;
+  };
+
+  void WatchdogMain();
+
+  // Suspends the platform thread and returns its symbolized call stack.
+  std::vector<std::string> CapturePlatformStack();
+
+  void WriteRecord(const Stall& stall, std::chrono::nanoseconds duration,
+                   bool ongoing);
+
+  static int64_t NowNanoseconds();
+
+  const std::chrono::milliseconds threshold_;
+  const std::wstring log_path_;
+
+  // Handle to the platform thread, for stack capture.
+  HANDLE platform_thread_ = nullptr;
+
+  // Start of the unit of work in progress, or 0 while the loop is waiting.
+  std::atomic<int64_t> busy_since_ns_{0};
+  // Incremented for every unit of work, so a stall is reported once.
+  std::atomic<uint64_t> busy_epoch_{0};
+  // End of the last finished unit of work.
+  std::atomic<int64_t> last_exit_ns_{0};
+
+  mutable std::mutex mutex_;
+  std::condition_variable stop_requested_;
+  bool stopping_ = false;
+  std::map<std::string, uint64_t> stall_counts_;
+
+  std::thread thread_;
+};
+
+#endif  // RUNNER_PLATFORM_WATCHDOG_H_
@@ -1,45 +1,59 @@
 #include "run_loop.h"
 
-#include <windows.h>
+#include <native_core/runtime.h>
 
 #include <algorithm>
 
-RunLoop::RunLoop() {}
+// Not declared by older Windows SDKs; supported since Windows 10 1803.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
-RunLoop::~RunLoop() {}
+RunLoop::RunLoop() : scheduler_(&clock_) {
+  timer_ = ::CreateWaitableTimerExW(nullptr, nullptr,
+                                    CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                    TIMER_ALL_ACCESS);
+  if (!timer_) {
+    timer_ = ::CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+  }
+}
+
+RunLoop::~RunLoop() {
+  if (timer_) {
+    ::CloseHandle(timer_);
+  }
+}
 
 void RunLoop::Run() {
+  native_core::PlatformDispatcher& plugin_completions =
+      native_core::Runtime::Get().dispatcher();
   bool keep_running = true;
-  TimePoint next_flutter_event_time = TimePoint::clock::now();
+  ProcessFlutterMessages();
   while (keep_running) {
-    std::chrono::nanoseconds wait_duration =
-        std::max(std::chrono::nanoseconds(0),
-                 next_flutter_event_time - TimePoint::clock::now());
-    ::MsgWaitForMultipleObjects(
-        0, nullptr, FALSE, static_cast<DWORD>(wait_duration.count() / 1000),
-        QS_ALLINPUT);
-    bool processed_events = false;
+    WaitForWork();
+
     MSG message;
     // All pending Windows messages must be processed; MsgWaitForMultipleObjects
     // won't return again for items left in the queue after PeekMessage.
     while (::PeekMessage(&message, nullptr, 0, 0, PM_REMOVE)) {
-      processed_events = true;
       if (message.message == WM_QUIT) {
         keep_running = false;
         break;
       }
-      ::TranslateMessage(&message);
-      ::DispatchMessage(&message);
+      RunUnit([&message]() {
+        ::TranslateMessage(&message);
+        ::DispatchMessage(&message);
+      });
       // Allow Flutter to process messages each time a Windows message is
       // processed, to prevent starvation.
-      next_flutter_event_time =
-          std::min(next_flutter_event_time, ProcessFlutterMessages());
-    }
-    // If the PeekMessage loop didn't run, process Flutter messages.
-    if (!processed_events) {
-      next_flutter_event_time =
-          std::min(next_flutter_event_time, ProcessFlutterMessages());
+      if (scheduler_.IsDeadlineDue()) {
+        RunUnit([this]() { ProcessFlutterMessages(); });
+      }
     }
+    RunUnit([this]() { ProcessFlutterMessages(); });
+    // Completions are also delivered through their own window message; this
+    // just avoids waiting for it when we are awake anyway.
+    RunUnit([&plugin_completions]() { plugin_completions.Drain(); });
   }
 }
 
@@ -53,14 +67,43 @@ void RunLoop::UnregisterFlutterInstance(
   flutter_instances_.erase(flutter_instance);
 }
 
-RunLoop::TimePoint RunLoop::ProcessFlutterMessages() {
-  TimePoint next_event_time = TimePoint::max();
+void RunLoop::ProcessFlutterMessages() {
+  // The deadline is recomputed from scratch: once serviced, an old deadline
+  // must not keep the loop from blocking.
+  LoopScheduler::TimePoint next_event_time = LoopScheduler::TimePoint::max();
   for (auto instance : flutter_instances_) {
     std::chrono::nanoseconds wait_duration = instance->ProcessMessages();
-    if (wait_duration != std::chrono::nanoseconds::max()) {
-      next_event_time =
-          std::min(next_event_time, TimePoint::clock::now() + wait_duration);
+    next_event_time =
+        std::min(next_event_time, scheduler_.DeadlineAfter(wait_duration));
+  }
+  scheduler_.SetNextDeadline(next_event_time);
+}
+
+void RunLoop::WaitForWork() {
+  std::chrono::nanoseconds wait_duration = scheduler_.WaitDuration();
+  if (wait_duration == std::chrono::nanoseconds(0)) {
+    // Already due: just pick up whatever input is queued.
+    scheduler_.BeginIdle();
+    scheduler_.EndIdle();
+    return;
+  }
+
+  DWORD handle_count = 0;
+  DWORD timeout = LoopScheduler::ToTimeoutMilliseconds(wait_duration);
+  if (timer_) {
+    if (wait_duration == std::chrono::nanoseconds::max()) {
+      ::CancelWaitableTimer(timer_);
+    } else {
+      LARGE_INTEGER due_time;
+      due_time.QuadPart = LoopScheduler::ToRelativeTimerDueTime(wait_duration);
+      ::SetWaitableTimer(timer_, &due_time, 0, nullptr, nullptr, FALSE);
     }
+    handle_count = 1;
+    timeout = INFINITE;
   }
-  return next_event_time;
+
+  scheduler_.BeginIdle();
+  ::MsgWaitForMultipleObjectsEx(handle_count, &timer_, timeout, QS_ALLINPUT,
+                                MWMO_INPUTAVAILABLE);
+  scheduler_.EndIdle();
 }
@@ -2,12 +2,20 @@
 #define RUNNER_RUN_LOOP_H_
 
 #include <flutter/flutter_engine.h>
+#include <windows.h>
 
 #include <chrono>
 #include <set>
 
+#include "loop_scheduler.h"
+#include "platform_watchdog.h"
+
 // A runloop that will service events for Flutter instances as well
-// as native messages.
+// as native messages and plugin completions.
+//
+// The loop blocks in MsgWaitForMultipleObjectsEx on a high-resolution
+// waitable timer armed for the next Flutter task, so engine tasks are
+// serviced on time instead of on the next millisecond tick (or later).
 class RunLoop {
  public:
   RunLoop();
@@ -28,13 +36,46 @@ class RunLoop {
   void UnregisterFlutterInstance(
       flutter::FlutterEngine* flutter_instance);
 
+  // Reports every unit of work (a dispatched message, a round of engine tasks
+  // or plugin completions) to |watchdog|. May be nullptr.
+  void SetWatchdog(PlatformWatchdog* watchdog) { watchdog_ = watchdog; }
+
+  PlatformWatchdog* watchdog() const { return watchdog_; }
+
+  // Timing statistics of the loop.
+  const LoopScheduler& scheduler() const { return scheduler_; }
+
  private:
-  using TimePoint = std::chrono::steady_clock::time_point;
+  // Processes all currently pending messages for registered Flutter instances
+  // and records when they next need servicing.
+  void ProcessFlutterMessages();
 
-  // Processes all currently pending messages for registered Flutter instances.
-  TimePoint ProcessFlutterMessages();
+  // Blocks until a message arrives or the next Flutter deadline passes.
+  void WaitForWork();
+
+  // Runs |work| as one unit of work for the watchdog.
+  template <typename Work>
+  void RunUnit(Work work) {
+    if (watchdog_) {
+      watchdog_->EnterBusy();
+    }
+    work();
+    if (watchdog_) {
+      watchdog_->ExitBusy();
+    }
+  }
+
+  SteadyLoopClock clock_;
+  LoopScheduler scheduler_;
+
+  // High-resolution waitable timer armed for the next Flutter deadline, or
+  // nullptr if the system cannot create one, in which case the wait falls
+  // back to a millisecond timeout.
+  HANDLE timer_ = nullptr;
 
   std::set<flutter::FlutterEngine*> flutter_instances_;
+
+  PlatformWatchdog* watchdog_ = nullptr;
 };
 
 #endif  // RUNNER_RUN_LOOP_H_
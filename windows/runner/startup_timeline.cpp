@@ -0,0 +1,105 @@
+#include "startup_timeline.h"
+
+#include <windows.h>
+
+#include <cstdint>
+#include <fstream>
+
+namespace {
+
+int64_t FileTimeToTicks(const FILETIME& file_time) {
+  ULARGE_INTEGER ticks;
+  ticks.LowPart = file_time.dwLowDateTime;
+  ticks.HighPart = file_time.dwHighDateTime;
+  return static_cast<int64_t>(ticks.QuadPart);
+}
+
+// Time elapsed since the process was created, from the wall clock. Only used
+// once, to place the monotonic origin; zero if it cannot be determined.
+std::chrono::nanoseconds TimeSinceProcessCreation() {
+  FILETIME creation, exit, kernel, user;
+  if (!::GetProcessTimes(::GetCurrentProcess(), &creation, &exit, &kernel,
+                         &user)) {
+    return std::chrono::nanoseconds(0);
+  }
+  FILETIME now;
+  ::GetSystemTimePreciseAsFileTime(&now);
+  int64_t elapsed_ticks = FileTimeToTicks(now) - FileTimeToTicks(creation);
+  if (elapsed_ticks < 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  // FILETIME ticks are 100 ns.
+  return std::chrono::nanoseconds(elapsed_ticks * 100);
+}
+
+int64_t ToMicroseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+std::string EscapeJson(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+}  // namespace
+
+StartupTimeline& StartupTimeline::Get() {
+  static StartupTimeline timeline;
+  return timeline;
+}
+
+StartupTimeline::StartupTimeline()
+    : origin_(std::chrono::steady_clock::now()),
+      origin_offset_(TimeSinceProcessCreation()) {
+  phases_.reserve(16);
+}
+
+void StartupTimeline::Mark(const std::string& phase) {
+  if (complete_) {
+    return;
+  }
+  phases_.emplace_back(phase, origin_offset_ +
+                                  (std::chrono::steady_clock::now() - origin_));
+}
+
+void StartupTimeline::Complete(const std::string& phase) {
+  Mark(phase);
+  complete_ = true;
+}
+
+bool StartupTimeline::WriteTrace(const std::wstring& path) const {
+  std::ofstream out(path, std::ios::out | std::ios::trunc);
+  if (!out) {
+    return false;
+  }
+  const DWORD pid = ::GetCurrentProcessId();
+  const DWORD tid = ::GetCurrentThreadId();
+
+  // One complete ("X") event per phase, spanning from the end of the previous
+  // phase to its own end.
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  std::chrono::nanoseconds previous(0);
+  for (size_t i = 0; i < phases_.size(); ++i) {
+    const auto& [name, end] = phases_[i];
+    if (i > 0) {
+      out << ",";
+    }
+    out << "\n{\"name\":\"" << EscapeJson(name)
+        << "\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":" << pid
+        << ",\"tid\":" << tid << ",\"ts\":" << ToMicroseconds(previous)
+        << ",\"dur\":" << ToMicroseconds(end - previous) << "}";
+    previous = end;
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,54 @@
+#ifndef RUNNER_STARTUP_TIMELINE_H_
+#define RUNNER_STARTUP_TIMELINE_H_
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Records when each cold start phase completes, from process creation up to
+// the first rendered frame, and writes them out as a Chrome trace
+// (chrome://tracing, Perfetto).
+//
+// Timestamps come from the monotonic clock and are relative to the creation
+// of the process, so the time the loader spends before wWinMain shows up as
+// the first phase.
+class StartupTimeline {
+ public:
+  using Phase = std::pair<std::string, std::chrono::nanoseconds>;
+
+  // The timeline of this process. The first call fixes the monotonic origin,
+  // so it should happen as early as possible in wWinMain.
+  static StartupTimeline& Get();
+
+  // Prevent copying.
+  StartupTimeline(StartupTimeline const&) = delete;
+  StartupTimeline& operator=(StartupTimeline const&) = delete;
+
+  // Records that |phase| has just completed. Phases after Complete() are
+  // ignored. Platform thread only.
+  void Mark(const std::string& phase);
+
+  // Marks the final phase and stops recording.
+  void Complete(const std::string& phase);
+
+  bool IsComplete() const { return complete_; }
+
+  // Completed phases, in order, with their offset from process creation.
+  const std::vector<Phase>& phases() const { return phases_; }
+
+  // Writes the phases to |path| in the Chrome trace event format. Returns
+  // false if the file could not be written.
+  bool WriteTrace(const std::wstring& path) const;
+
+ private:
+  StartupTimeline();
+
+  std::chrono::steady_clock::time_point origin_;
+  // Time between process creation and |origin_|.
+  std::chrono::nanoseconds origin_offset_{0};
+  std::vector<Phase> phases_;
+  bool complete_ = false;
+};
+
+#endif  // RUNNER_STARTUP_TIMELINE_H_
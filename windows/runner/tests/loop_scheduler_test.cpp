@@ -0,0 +1,162 @@
+#include "loop_scheduler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+#include "test_support.h"
+
+using std::chrono::hours;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+
+namespace {
+
+// LoopClock that only moves when the test advances it.
+class FakeLoopClock : public LoopClock {
+ public:
+  TimePoint Now() const override { return now_; }
+
+  void Advance(nanoseconds duration) { now_ += duration; }
+
+ private:
+  TimePoint now_ = TimePoint() + hours(1);
+};
+
+constexpr uint32_t kInfinite = std::numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+TEST(WaitDurationIsMaxWithoutDeadline) {
+  FakeLoopClock clock;
+  LoopScheduler scheduler(&clock);
+  EXPECT_TRUE(scheduler.next_deadline() == LoopScheduler::TimePoint::max());
+  EXPECT_TRUE(scheduler.WaitDuration() == nanoseconds::max());
+  EXPECT_FALSE(scheduler.IsDeadlineDue());
+}
+
+TEST(WaitDurationCountsDownToDeadline) {
+  FakeLoopClock clock;
+  LoopScheduler scheduler(&clock);
+  scheduler.SetNextDeadline(scheduler.DeadlineAfter(microseconds(1500)));
+  EXPECT_EQ(scheduler.WaitDuration().count(), nanoseconds(microseconds(1500)).count());
+  EXPECT_FALSE(scheduler.IsDeadlineDue());
+
+  clock.Advance(microseconds(1000));
+  EXPECT_EQ(scheduler.WaitDuration().count(), nanoseconds(microseconds(500)).count());
+  EXPECT_FALSE(scheduler.IsDeadlineDue());
+
+  clock.Advance(microseconds(500));
+  EXPECT_EQ(scheduler.WaitDuration().count(), 0);
+  EXPECT_TRUE(scheduler.IsDeadlineDue());
+}
+
+TEST(WaitDurationIsZeroWhenOverdue) {
+  FakeLoopClock clock;
+  LoopScheduler scheduler(&clock);
+  scheduler.SetNextDeadline(scheduler.DeadlineAfter(milliseconds(1)));
+  clock.Advance(milliseconds(250));
+  EXPECT_EQ(scheduler.WaitDuration().count(), 0);
+  EXPECT_TRUE(scheduler.IsDeadlineDue());
+}
+
+TEST(DeadlineAfterHandlesZeroNegativeAndMax) {
+  FakeLoopClock clock;
+  LoopScheduler scheduler(&clock);
+  EXPECT_TRUE(scheduler.DeadlineAfter(nanoseconds(0)) == clock.Now());
+  EXPECT_TRUE(scheduler.DeadlineAfter(milliseconds(-5)) == clock.Now());
+  EXPECT_TRUE(scheduler.DeadlineAfter(nanoseconds::max()) ==
+              LoopScheduler::TimePoint::max());
+
+  // A zero delay is due straight away.
+  scheduler.SetNextDeadline(scheduler.DeadlineAfter(nanoseconds(0)));
+  EXPECT_EQ(scheduler.WaitDuration().count(), 0);
+  EXPECT_TRUE(scheduler.IsDeadlineDue());
+
+  // No pending task clears the deadline again.
+  scheduler.SetNextDeadline(scheduler.DeadlineAfter(nanoseconds::max()));
+  EXPECT_TRUE(scheduler.WaitDuration() == nanoseconds::max());
+  EXPECT_FALSE(scheduler.IsDeadlineDue());
+}
+
+TEST(TimeoutMillisecondsRoundsUp) {
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(nanoseconds(0)), 0u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(nanoseconds(1)), 1u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(milliseconds(1)), 1u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(
+                milliseconds(1) + nanoseconds(1)), 2u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(microseconds(1500)), 2u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(milliseconds(16)), 16u);
+}
+
+TEST(TimeoutMillisecondsOfOverdueWaitIsZero) {
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(nanoseconds(-1)), 0u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(hours(-1)), 0u);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(nanoseconds::min()), 0u);
+}
+
+TEST(TimeoutMillisecondsKeepsInfiniteForNoDeadline) {
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(nanoseconds::max()), kInfinite);
+  // Finite waits longer than a DWORD clamp just short of INFINITE, so they
+  // still wake up eventually.
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(hours(24 * 60)), kInfinite - 1);
+  EXPECT_EQ(LoopScheduler::ToTimeoutMilliseconds(nanoseconds::max() - nanoseconds(1)),
+            kInfinite - 1);
+}
+
+TEST(TimerDueTimeIsNegativeAndRoundsUp) {
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds(0)), 0);
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds(1)), -1);
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds(100)), -1);
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds(101)), -2);
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(microseconds(1500)), -15000);
+}
+
+TEST(TimerDueTimeOfOverdueWaitFiresImmediately) {
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds(-1)), 0);
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds::min()), 0);
+}
+
+TEST(TimerDueTimeOfLongestWaitDoesNotOverflow) {
+  int64_t max = nanoseconds::max().count();
+  EXPECT_EQ(LoopScheduler::ToRelativeTimerDueTime(nanoseconds::max()),
+            -(max / 100 + 1));
+}
+
+TEST(EndIdleRecordsLatenessOnlyPastDeadline) {
+  FakeLoopClock clock;
+  LoopScheduler scheduler(&clock);
+  scheduler.SetNextDeadline(scheduler.DeadlineAfter(milliseconds(10)));
+
+  // Woken early by a message: nothing is late.
+  scheduler.BeginIdle();
+  clock.Advance(milliseconds(4));
+  scheduler.EndIdle();
+  EXPECT_EQ(scheduler.lateness().count(), 0u);
+
+  // Woken 3ms after the deadline.
+  clock.Advance(milliseconds(1));
+  scheduler.BeginIdle();
+  clock.Advance(milliseconds(8));
+  scheduler.EndIdle();
+  EXPECT_EQ(scheduler.lateness().count(), 1u);
+  EXPECT_EQ(scheduler.lateness().max().count(), nanoseconds(milliseconds(3)).count());
+
+  EXPECT_EQ(scheduler.iterations(), 2u);
+  EXPECT_EQ(scheduler.idle().count(), 2u);
+  EXPECT_EQ(scheduler.idle().total().count(), nanoseconds(milliseconds(12)).count());
+  // The time before the first wait, and the millisecond between the waits.
+  EXPECT_EQ(scheduler.busy().count(), 2u);
+  EXPECT_EQ(scheduler.busy().total().count(), nanoseconds(milliseconds(1)).count());
+}
+
+TEST(EndIdleWithoutDeadlineRecordsNoLateness) {
+  FakeLoopClock clock;
+  LoopScheduler scheduler(&clock);
+  scheduler.BeginIdle();
+  clock.Advance(hours(2));
+  scheduler.EndIdle();
+  EXPECT_EQ(scheduler.lateness().count(), 0u);
+  EXPECT_EQ(scheduler.idle().count(), 1u);
+}
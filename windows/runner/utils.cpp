@@ -62,3 +62,19 @@ std::string Utf8FromUtf16(const wchar_t* utf16_string) {
   }
   return utf8_string;
 }
+
+std::wstring GetDiagnosticsDirectory() {
+  wchar_t local_app_data[MAX_PATH];
+  DWORD length =
+      ::GetEnvironmentVariableW(L"LOCALAPPDATA", local_app_data, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) {
+    return std::wstring();
+  }
+  std::wstring directory = std::wstring(local_app_data, length) +
+                           L"\\portafirmas";
+  if (!::CreateDirectoryW(directory.c_str(), nullptr) &&
+      ::GetLastError() != ERROR_ALREADY_EXISTS) {
+    return std::wstring();
+  }
+  return directory;
+}
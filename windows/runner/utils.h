@@ -16,4 +16,9 @@ std::string Utf8FromUtf16(const wchar_t* utf16_string);
 // encoded in UTF-8. Returns an empty std::vector<std::string> on failure.
 std::vector<std::string> GetCommandLineArguments();
 
+// Returns the directory where the runner writes its diagnostics (stall log,
+// startup trace), creating it if needed: %LOCALAPPDATA%\portafirmas. Returns
+// an empty string on failure.
+std::wstring GetDiagnosticsDirectory();
+
 #endif  // RUNNER_UTILS_H_